@@ -0,0 +1,383 @@
+//
+//	File:	hzcollcheck.cpp
+//
+//	Desc:	Checks of collection templates under the conditions they meet in the servers.
+//
+//			1)	Several threads insert into and look up a lock-striped map at the same time, racing to create the object for each key with InsertIfAbsent as
+//				Dissemino does for visitor profiles. Each thread must get back the one object that won for each key, and the map must end up with exactly one
+//				entry per key.
+//
+//			2)	ISAM based maps and sets built by bulk insert (BulkInsert and the batch constructors) must be the same as those built by repeated Insert of the
+//				same pairs. This is checked with repeated keys, with an empty batch, with batches merged into populated maps (both above and below the size at
+//				which the merge gives way to key by key insertion) and with batches declared to be already sorted.
+//
+//	Legal Notice: This file is part of the HadronZoo::Bench programs which in turn depend on the HadronZoo C++ Class Library with which they are shipped.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	HadronZoo::Bench is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free
+//	Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is also free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	HadronZoo::Bench is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License along with HadronZoo::Bench. If not, see http://www.gnu.org/licenses.
+//
+
+#include <iostream>
+#include <fstream>
+
+using namespace std ;
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hzBasedefs.h"
+#include "hzProcess.h"
+#include "hzTmplMapS.h"
+#include "hzTmplMapM.h"
+#include "hzTmplSet.h"
+#include "hzTmplMapC.h"
+
+#define	CHECK_MAXTHREADS	64		//	Maximum number of threads
+
+/*
+**	Definitions
+*/
+
+struct	CheckThread
+{
+	//	Per thread data of the concurrent map check
+
+	pthread_t	m_Tid ;				//	Thread id
+	uint32_t*	m_pGot ;			//	Object obtained for each key
+	uint32_t	m_nThread ;			//	Thread number (from 1)
+	uint32_t	m_nWon ;			//	Keys for which the object of this thread was inserted
+	uint32_t	m_nBad ;			//	Lookups that saw an object other than the one obtained
+} ;
+
+/*
+**	Variables
+*/
+
+bool	_hzGlobal_XM = false ;			//	Using/not using operator new/delete override
+bool	_hzGlobal_MT = true ;			//	Program is multi-threaded
+
+global	hzProcess	proc ;				//	hzProcess instance (all Hadronzoo based applications require this)
+
+static	hzMapSC<uint32_t,uint32_t>	s_Map ;		//	The map under test
+static	uint32_t	s_nKeys = 100000 ;			//	Number of keys
+static	uint32_t	s_nSeed = 1 ;				//	Pseudo random number seed (fixed so runs are repeatable)
+
+/*
+**	Functions
+*/
+
+static	void*	_mapThread	(void* pArg)
+{
+	//	Race the other threads to create the object for each key, then look every key up again. The object of a thread for a key is the thread number in the
+	//	top byte and the key in the rest, so the winner of each key can be identified. Threads start at different points so that each key is contended both
+	//	early and late in the run.
+	//
+	//	Arguments:	1)	pArg	The CheckThread
+	//
+	//	Returns:	Null
+
+	CheckThread*	pT ;		//	This thread
+	uint32_t		nKey ;		//	Key
+	uint32_t		nObj ;		//	Object of this thread for the key
+	uint32_t		nWin ;		//	Object in the map for the key
+	uint32_t		n ;			//	Key iterator
+
+	pT = (CheckThread*) pArg ;
+
+	for (n = 0 ; n < s_nKeys ; n++)
+	{
+		nKey = (n + pT->m_nThread * 7919) % s_nKeys ;
+		nObj = (pT->m_nThread << 24) | nKey ;
+
+		if (!s_Map.Lookup(nWin, nKey))
+			nWin = s_Map.InsertIfAbsent(nKey, nObj) ;
+
+		if (nWin == nObj)
+			pT->m_nWon++ ;
+		pT->m_pGot[nKey] = nWin ;
+	}
+
+	for (nKey = 0 ; nKey < s_nKeys ; nKey++)
+	{
+		if (s_Map[nKey] != pT->m_pGot[nKey])
+			pT->m_nBad++ ;
+	}
+
+	return 0 ;
+}
+
+static	bool	_checkMapSC	(uint32_t nThreads)
+{
+	//	Run the threads over the map and check they all agree on the object of each key
+	//
+	//	Arguments:	1)	nThreads	Number of threads
+	//
+	//	Returns:	True	If the map is consistent
+	//				False	Otherwise
+
+	CheckThread	thr[CHECK_MAXTHREADS] ;	//	The threads
+	uint32_t	nWon = 0 ;				//	Total keys won
+	uint32_t	nBad = 0 ;				//	Total bad lookups
+	uint32_t	nDiff = 0 ;				//	Keys on which threads disagree
+	uint32_t	nKey ;					//	Key iterator
+	uint32_t	n ;						//	Thread iterator
+
+	for (n = 0 ; n < nThreads ; n++)
+	{
+		thr[n].m_pGot = new uint32_t[s_nKeys] ;
+		thr[n].m_nThread = n + 1 ;
+		thr[n].m_nWon = thr[n].m_nBad = 0 ;
+		pthread_create(&thr[n].m_Tid, 0, _mapThread, thr + n) ;
+	}
+
+	for (n = 0 ; n < nThreads ; n++)
+		pthread_join(thr[n].m_Tid, 0) ;
+
+	for (n = 0 ; n < nThreads ; n++)
+	{
+		nWon += thr[n].m_nWon ;
+		nBad += thr[n].m_nBad ;
+
+		for (nKey = 0 ; nKey < s_nKeys ; nKey++)
+		{
+			if (thr[n].m_pGot[nKey] != thr[0].m_pGot[nKey] || (thr[n].m_pGot[nKey] & 0xffffff) != nKey)
+				nDiff++ ;
+		}
+	}
+
+	printf("hzMapSC: %u threads, %u keys, %u entries, %u keys won, %u disagreements, %u bad lookups\n", nThreads, s_nKeys, s_Map.Count(), nWon, nDiff, nBad) ;
+
+	for (n = 0 ; n < nThreads ; n++)
+		delete [] thr[n].m_pGot ;
+
+	return s_Map.Count() == s_nKeys && nWon == s_nKeys && !nDiff && !nBad ;
+}
+
+static	uint32_t	_rand	(void)
+{
+	//	Pseudo random number (linear congruential)
+
+	s_nSeed = s_nSeed * 1103515245 + 12345 ;
+	return s_nSeed >> 8 ;
+}
+
+template<class MAP>	static	bool	_sameMap	(const char* test, const MAP& bulk, const MAP& each, const uint32_t* pKeys, uint32_t nKeys)
+{
+	//	Check a map built by bulk insert against one built by repeated Insert, position by position and by lookup of each of the supplied keys
+	//
+	//	Arguments:	1)	test	Name of test (for reporting)
+	//				2)	bulk	Map built by bulk insert
+	//				3)	each	Map built by repeated Insert
+	//				4)	pKeys	Keys to look up
+	//				5)	nKeys	Number of keys to look up
+	//
+	//	Returns:	True	If the maps are the same
+	//				False	Otherwise
+
+	uint32_t	n ;		//	Position/key iterator
+
+	if (bulk.Count() != each.Count())
+		{ printf("%s: Bulk built population %u, by Insert %u\n", test, bulk.Count(), each.Count()) ; return false ; }
+
+	for (n = 0 ; n < bulk.Count() ; n++)
+	{
+		if (bulk.GetKey(n) != each.GetKey(n) || bulk.GetObj(n) != each.GetObj(n))
+		{
+			printf("%s: Position %u bulk built %u/%u, by Insert %u/%u\n", test, n, bulk.GetKey(n), bulk.GetObj(n), each.GetKey(n), each.GetObj(n)) ;
+			return false ;
+		}
+	}
+
+	for (n = 0 ; n < nKeys ; n++)
+	{
+		if (bulk.Exists(pKeys[n]) != each.Exists(pKeys[n]) || bulk[pKeys[n]] != each[pKeys[n]])
+			{ printf("%s: Lookup of key %u differs\n", test, pKeys[n]) ; return false ; }
+	}
+
+	printf("%s: Same (%u elements)\n", test, bulk.Count()) ;
+	return true ;
+}
+
+static	bool	_sameSet	(const char* test, const hzSet<uint32_t>& bulk, const hzSet<uint32_t>& each, const uint32_t* pKeys, uint32_t nKeys)
+{
+	//	As _sameMap() but for sets
+	//
+	//	Arguments:	1)	test	Name of test (for reporting)
+	//				2)	bulk	Set built by bulk insert
+	//				3)	each	Set built by repeated Insert
+	//				4)	pKeys	Keys to look up
+	//				5)	nKeys	Number of keys to look up
+	//
+	//	Returns:	True	If the sets are the same
+	//				False	Otherwise
+
+	uint32_t	n ;		//	Position/key iterator
+
+	if (bulk.Count() != each.Count())
+		{ printf("%s: Bulk built population %u, by Insert %u\n", test, bulk.Count(), each.Count()) ; return false ; }
+
+	for (n = 0 ; n < bulk.Count() ; n++)
+	{
+		if (bulk.GetObj(n) != each.GetObj(n))
+			{ printf("%s: Position %u bulk built %u, by Insert %u\n", test, n, bulk.GetObj(n), each.GetObj(n)) ; return false ; }
+	}
+
+	for (n = 0 ; n < nKeys ; n++)
+	{
+		if (bulk.Exists(pKeys[n]) != each.Exists(pKeys[n]))
+			{ printf("%s: Lookup of key %u differs\n", test, pKeys[n]) ; return false ; }
+	}
+
+	printf("%s: Same (%u elements)\n", test, bulk.Count()) ;
+	return true ;
+}
+
+static	bool	_checkBulk	(uint32_t nItems)
+{
+	//	Build maps and sets by bulk insert and by repeated Insert from the same batches and check they are the same. Keys are drawn from a range of a quarter
+	//	of the batch size so most are repeated. The batch is split into a first part (most of it) and a second part (an eighth of it) to be merged in.
+	//
+	//	Arguments:	1)	nItems	Batch size
+	//
+	//	Returns:	True	If all bulk built collections are the same as their counterparts
+	//				False	Otherwise
+
+	uint32_t*	pKeys ;			//	Batch keys
+	uint32_t*	pObjs ;			//	Batch objects
+	uint32_t*	pSorted ;		//	Keys 0 to nItems-1 in order
+	uint32_t	nFirst ;		//	Size of first part of batch
+	uint32_t	nSmall ;		//	Size of a batch small enough to be inserted key by key
+	uint32_t	n ;				//	Batch iterator
+	bool		bOk = true ;	//	Result
+
+	pKeys = new uint32_t[nItems] ;
+	pObjs = new uint32_t[nItems] ;
+	pSorted = new uint32_t[nItems] ;
+
+	for (n = 0 ; n < nItems ; n++)
+	{
+		pKeys[n] = _rand() % (nItems / 4 + 1) ;
+		pObjs[n] = n + 1 ;
+		pSorted[n] = n ;
+	}
+	nFirst = nItems - nItems / 8 ;
+	nSmall = nItems / 64 ;
+
+	//	Empty batch, both by the batch constructor and into a populated map
+	{
+		hzMapS<uint32_t,uint32_t>	bulk(HZ_NOLOCK, pKeys, pObjs, 0) ;	//	Bulk built
+		hzMapS<uint32_t,uint32_t>	each ;								//	By Insert
+
+		bOk &= _sameMap("hzMapS empty batch", bulk, each, pKeys, nItems) ;
+
+		for (n = 0 ; n < nFirst ; n++)
+			{ bulk.Insert(pKeys[n], pObjs[n]) ; each.Insert(pKeys[n], pObjs[n]) ; }
+		bulk.BulkInsert(pKeys, pObjs, 0) ;
+		bOk &= _sameMap("hzMapS empty batch into populated", bulk, each, pKeys, nItems) ;
+	}
+
+	//	One to one map: Whole batch, then a large and a small batch merged into a populated map, then a sorted batch
+	{
+		hzMapS<uint32_t,uint32_t>	bulk(HZ_NOLOCK, pKeys, pObjs, nFirst) ;	//	Bulk built
+		hzMapS<uint32_t,uint32_t>	each ;									//	By Insert
+
+		for (n = 0 ; n < nFirst ; n++)
+			each.Insert(pKeys[n], pObjs[n]) ;
+		bOk &= _sameMap("hzMapS batch", bulk, each, pKeys, nItems) ;
+
+		bulk.BulkInsert(pKeys + nFirst, pObjs + nFirst, nItems - nFirst) ;
+		for (n = nFirst ; n < nItems ; n++)
+			each.Insert(pKeys[n], pObjs[n]) ;
+		bOk &= _sameMap("hzMapS merge", bulk, each, pKeys, nItems) ;
+
+		bulk.BulkInsert(pKeys, pSorted, nSmall) ;
+		for (n = 0 ; n < nSmall ; n++)
+			each.Insert(pKeys[n], pSorted[n]) ;
+		bOk &= _sameMap("hzMapS small merge", bulk, each, pKeys, nItems) ;
+
+		bulk.BulkInsert(pSorted, pObjs, nItems, true) ;
+		for (n = 0 ; n < nItems ; n++)
+			each.Insert(pSorted[n], pObjs[n]) ;
+		bOk &= _sameMap("hzMapS sorted merge", bulk, each, pSorted, nItems) ;
+	}
+
+	//	One to many map: Objects under a repeated key must stay in order of insertion
+	{
+		hzMapM<uint32_t,uint32_t>	bulk(HZ_NOLOCK, pKeys, pObjs, nFirst) ;	//	Bulk built
+		hzMapM<uint32_t,uint32_t>	each ;									//	By Insert
+
+		for (n = 0 ; n < nFirst ; n++)
+			each.Insert(pKeys[n], pObjs[n]) ;
+		bOk &= _sameMap("hzMapM batch", bulk, each, pKeys, nItems) ;
+
+		bulk.BulkInsert(pKeys + nFirst, pObjs + nFirst, nItems - nFirst) ;
+		for (n = nFirst ; n < nItems ; n++)
+			each.Insert(pKeys[n], pObjs[n]) ;
+		bOk &= _sameMap("hzMapM merge", bulk, each, pKeys, nItems) ;
+
+		bulk.BulkInsert(pKeys, pSorted, nSmall) ;
+		for (n = 0 ; n < nSmall ; n++)
+			each.Insert(pKeys[n], pSorted[n]) ;
+		bOk &= _sameMap("hzMapM small merge", bulk, each, pKeys, nItems) ;
+	}
+
+	//	Set
+	{
+		hzSet<uint32_t>	bulk(HZ_NOLOCK, pKeys, nFirst) ;	//	Bulk built
+		hzSet<uint32_t>	each ;								//	By Insert
+
+		for (n = 0 ; n < nFirst ; n++)
+			each.Insert(pKeys[n]) ;
+		bOk &= _sameSet("hzSet batch", bulk, each, pKeys, nItems) ;
+
+		bulk.BulkInsert(pKeys + nFirst, nItems - nFirst) ;
+		for (n = nFirst ; n < nItems ; n++)
+			each.Insert(pKeys[n]) ;
+		bOk &= _sameSet("hzSet merge", bulk, each, pKeys, nItems) ;
+
+		bulk.BulkInsert(pSorted, nItems, true) ;
+		for (n = 0 ; n < nItems ; n++)
+			each.Insert(pSorted[n]) ;
+		bOk &= _sameSet("hzSet sorted merge", bulk, each, pSorted, nItems) ;
+	}
+
+	delete [] pKeys ;
+	delete [] pObjs ;
+	delete [] pSorted ;
+	return bOk ;
+}
+
+int		main	(int argc, char ** argv)
+{
+	_hzfunc("hzcollcheck::main") ;
+
+	uint32_t	nThreads = 8 ;	//	Threads
+
+	if (argc > 1)
+		nThreads = atoi(argv[1]) ;
+	if (argc > 2)
+		s_nKeys = atoi(argv[2]) ;
+	if (!nThreads || nThreads > CHECK_MAXTHREADS || !s_nKeys || s_nKeys > 0xffffff)
+		{ cout << "Usage: hzcollcheck [threads (1-64)] [keys]\n" ; return 101 ; }
+
+	if (!_checkMapSC(nThreads))
+		{ printf("hzMapSC check FAILED\n") ; return 102 ; }
+
+	if (!_checkBulk(s_nKeys))
+		{ printf("Bulk insert check FAILED\n") ; return 103 ; }
+
+	printf("All checks passed\n") ;
+	return 0 ;
+}
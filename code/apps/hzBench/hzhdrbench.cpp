@@ -0,0 +1,280 @@
+//
+//	File:	hzhdrbench.cpp
+//
+//	Desc:	Microbenchmark of HTTP request header parsing. Compares the former method of hzHttpEvent::ProcessEvent (copying the header byte by byte into a
+//			chain then comparing each line against the header names of interest by chain iterator), with the in-place scan of hzHttpParse (HttpHeaderEnd,
+//			HttpScan and HttpHeaderId). Both are run over a set of captured browser requests, one of which straddles the blocks of the input chain.
+//
+//	Legal Notice: This file is part of the HadronZoo::Bench programs which in turn depend on the HadronZoo C++ Class Library with which they are shipped.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	HadronZoo::Bench is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free
+//	Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is also free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	HadronZoo::Bench is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License along with HadronZoo::Bench. If not, see http://www.gnu.org/licenses.
+//
+
+#include <iostream>
+#include <fstream>
+
+using namespace std ;
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hzBasedefs.h"
+#include "hzChars.h"
+#include "hzChain.h"
+#include "hzProcess.h"
+#include "hzHttpParse.h"
+
+/*
+**	Variables
+*/
+
+static	const char*	s_Requests[] =
+{
+	//	Captured requests (Chrome, Firefox, curl and a form post)
+
+	"GET /index.html?lang=en&theme=dark HTTP/1.1\r\n"
+	"Host: www.hadronzoo.com\r\n"
+	"Connection: keep-alive\r\n"
+	"Cache-Control: max-age=0\r\n"
+	"sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", \"Not=A?Brand\";v=\"99\"\r\n"
+	"sec-ch-ua-mobile: ?0\r\n"
+	"sec-ch-ua-platform: \"Linux\"\r\n"
+	"Upgrade-Insecure-Requests: 1\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+	"Sec-Fetch-Site: same-origin\r\n"
+	"Sec-Fetch-Mode: navigate\r\n"
+	"Sec-Fetch-User: ?1\r\n"
+	"Sec-Fetch-Dest: document\r\n"
+	"Referer: https://www.hadronzoo.com/\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"Accept-Language: en-GB,en-US;q=0.9,en;q=0.8\r\n"
+	"Cookie: _hz=00000000000000000000000012ab34cd; _ga=GA1.1.1234567890.1697000000\r\n"
+	"If-None-Match: \"5f3a-62b1c9e3\"\r\n"
+	"If-Modified-Since: Tue, 17 Oct 2023 09:12:44 GMT\r\n\r\n",
+
+	"GET /img/logo.png HTTP/1.1\r\n"
+	"Host: www.hadronzoo.com\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Ubuntu; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/118.0\r\n"
+	"Accept: image/avif,image/webp,*/*\r\n"
+	"Accept-Language: en-GB,en;q=0.5\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"Connection: keep-alive\r\n"
+	"Referer: https://www.hadronzoo.com/index.html\r\n"
+	"Cookie: _hz=00000000000000000000000012ab34cd\r\n"
+	"Sec-Fetch-Dest: image\r\n"
+	"Sec-Fetch-Mode: no-cors\r\n"
+	"Sec-Fetch-Site: same-origin\r\n"
+	"Pragma: no-cache\r\n"
+	"Cache-Control: no-cache\r\n\r\n",
+
+	"GET /api/status HTTP/1.1\r\n"
+	"Host: 127.0.0.1:18080\r\n"
+	"User-Agent: curl/8.4.0\r\n"
+	"Accept: */*\r\n\r\n",
+
+	"POST /login HTTP/1.1\r\n"
+	"Host: www.hadronzoo.com\r\n"
+	"Connection: keep-alive\r\n"
+	"Content-Length: 29\r\n"
+	"Content-Type: application/x-www-form-urlencoded\r\n"
+	"Origin: https://www.hadronzoo.com\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+	"Referer: https://www.hadronzoo.com/login\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"Accept-Language: en-GB,en-US;q=0.9,en;q=0.8\r\n"
+	"Cookie: _hz=00000000000000000000000012ab34cd\r\n\r\n"
+	"username=fred&password=secret",
+
+	0
+} ;
+
+static	const char*	s_Names[] =
+{
+	//	Header names of interest to the former method (in the order it tested them)
+
+	"Accept", "Accept-Charset", "Accept-Language", "Accept-Encoding", "Authorization", "Cache-Control", "Content-Type", "Client-ip", "Content-Length",
+	"Connection", "Cookie", "From", "Host", "If-Modified-Since", "If-None-Match", "Keep-Alive", "Max-Forwards", "Pragma", "Referer", "User-Agent", "UA-CPU",
+	"Via", "X-Forwarded-For", "X-ProxyUser-IP", "X-Forwarded-Host", "X-Forwarded-Server", 0
+} ;
+
+/*
+**	Functions
+*/
+
+static	uint64_t	_nsNow	(void)
+{
+	//	Monotonic time in nanoseconds
+
+	struct timespec	ts ;	//	Time
+
+	clock_gettime(CLOCK_MONOTONIC, &ts) ;
+	return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec ;
+}
+
+static	uint32_t	_parseOld	(hzChain& ZI, uint32_t& nHdrLen)
+{
+	//	The former method: Copy the header to a chain byte by byte, then compare each line against the names of interest.
+	//
+	//	Arguments:	1)	ZI		The input chain
+	//				2)	nHdrLen	Set to the header length
+	//
+	//	Returns:	Number of header lines of interest
+
+	hzChain		Head ;		//	The header
+	chIter		zi ;		//	Chain iterator
+	chIter		mkA ;		//	Start of line
+	uint32_t	nFound = 0 ;	//	Headers of interest
+	uint32_t	n ;			//	Name iterator
+
+	nHdrLen = 0 ;
+	for (zi = ZI ; !zi.eof() && Head.Size() < 8192 ; zi++)
+	{
+		if (*zi == CHAR_CR && zi == "\r\n\r\n")
+			{ Head << "\r\n\r\n" ; nHdrLen = Head.Size() ; break ; }
+		Head.AddByte(*zi) ;
+	}
+
+	for (zi = Head ; !zi.eof() && *zi != CHAR_NL ; zi++) ;
+	for (zi++ ; !zi.eof() ; zi++)
+	{
+		if (zi == "\r\n")
+			break ;
+
+		for (mkA = zi ; !zi.eof() && *zi != CHAR_NL ; zi++) ;
+
+		for (n = 0 ; s_Names[n] ; n++)
+		{
+			if (mkA.Equiv(s_Names[n]) && mkA[strlen(s_Names[n])] == CHAR_COLON)
+				{ nFound++ ; break ; }
+		}
+	}
+
+	return nFound ;
+}
+
+static	uint32_t	_parseNew	(hzChain& ZI, uint32_t& nHdrLen)
+{
+	//	The in-place method of hzHttpParse
+	//
+	//	Arguments:	1)	ZI		The input chain
+	//				2)	nHdrLen	Set to the header length
+	//
+	//	Returns:	Number of header lines of interest
+
+	static	char	s_buf[8192] ;	//	For headers straddling blocks
+
+	hzChain::BlkIter	bi ;	//	Block iterator
+	chIter				zi ;	//	Chain iterator
+
+	const char*	pHdr ;			//	Start of header
+	const char*	pEnd ;			//	End of header
+	const char*	pEol ;			//	End of line
+	const char*	pColon ;		//	Colon
+	const char*	i ;				//	Line iterator
+	uint32_t	nFound = 0 ;	//	Headers of interest
+
+	nHdrLen = HttpHeaderEnd(ZI, 8192) ;
+	if (!nHdrLen)
+		return 0 ;
+
+	bi = ZI ;
+	if (bi.Size() >= nHdrLen)
+		pHdr = (const char*) bi.Data() ;
+	else
+		{ zi = ZI ; zi.Write(s_buf, nHdrLen) ; pHdr = s_buf ; }
+	pEnd = pHdr + nHdrLen ;
+
+	for (i = HttpScan(pHdr, pEnd, CHAR_NL) + 1 ; i < pEnd && *i != CHAR_CR ; i = pEol + 1)
+	{
+		pEol = HttpScan(i, pEnd, CHAR_NL) ;
+		pColon = HttpScan(i, pEol, CHAR_COLON) ;
+		if (pColon && HttpHeaderId(i, pColon - i) != HTTP_HDR_UNKNOWN)
+			nFound++ ;
+	}
+
+	return nFound ;
+}
+
+int		main	(int argc, char ** argv)
+{
+	_hzfunc("hzhdrbench::main") ;
+
+	hzChain		inputs[8] ;		//	Requests as input chains
+	uint64_t	nsOld ;			//	Time taken, former method
+	uint64_t	nsNew ;			//	Time taken, new method
+	uint64_t	nsStart ;		//	Start time
+	uint64_t	nBytes = 0 ;	//	Header bytes per round
+	uint32_t	nReqs ;			//	Number of requests
+	uint32_t	nRounds = 10000 ;	//	Rounds
+	uint32_t	nOld ;			//	Headers found (former)
+	uint32_t	nNew ;			//	Headers found (new)
+	uint32_t	lenOld ;		//	Header length (former)
+	uint32_t	lenNew ;		//	Header length (new)
+	uint32_t	r ;				//	Round iterator
+	uint32_t	n ;				//	Request iterator
+	uint32_t	sink = 0 ;		//	Defeat optimization
+
+	if (argc > 1)
+		nRounds = atoi(argv[1]) ;
+	if (!nRounds)
+		{ cout << "Usage: hzhdrbench [rounds]\n" ; return 101 ; }
+
+	for (nReqs = 0 ; s_Requests[nReqs] ; nReqs++)
+		inputs[nReqs] << s_Requests[nReqs] ;
+
+	//	Add a request whose header straddles the first block of the chain
+	inputs[nReqs] << "GET /account HTTP/1.1\r\nHost: www.hadronzoo.com\r\nCookie: _hz=00000000000000000000000012ab34cd" ;
+	for (n = 0 ; n < 40 ; n++)
+		inputs[nReqs].Printf("; track%02d=0123456789abcdef0123456789abcdef", n) ;
+	inputs[nReqs] << "\r\nUser-Agent: curl/8.4.0\r\nAccept: */*\r\n\r\n" ;
+	nReqs++ ;
+
+	//	Check both methods agree
+	for (n = 0 ; n < nReqs ; n++)
+	{
+		nOld = _parseOld(inputs[n], lenOld) ;
+		nNew = _parseNew(inputs[n], lenNew) ;
+		nBytes += lenNew ;
+
+		printf("Request %u: Header %u bytes, %u headers of interest (former method %u bytes, %u headers)\n", n, lenNew, nNew, lenOld, nOld) ;
+		if (nOld != nNew || lenOld != lenNew)
+			{ printf("Methods disagree\n") ; return 102 ; }
+	}
+
+	nsStart = _nsNow() ;
+	for (r = 0 ; r < nRounds ; r++)
+	{
+		for (n = 0 ; n < nReqs ; n++)
+			sink += _parseOld(inputs[n], lenOld) ;
+	}
+	nsOld = _nsNow() - nsStart ;
+
+	nsStart = _nsNow() ;
+	for (r = 0 ; r < nRounds ; r++)
+	{
+		for (n = 0 ; n < nReqs ; n++)
+			sink += _parseNew(inputs[n], lenNew) ;
+	}
+	nsNew = _nsNow() - nsStart ;
+
+	printf("Former method: %7.1f ns/request %8.1f MB/s\n", (double) nsOld / (nRounds * nReqs), (double) nBytes * nRounds * 1000.0 / nsOld) ;
+	printf("hzHttpParse:   %7.1f ns/request %8.1f MB/s\n", (double) nsNew / (nRounds * nReqs), (double) nBytes * nRounds * 1000.0 / nsNew) ;
+	printf("Speedup %.1fx (check %u)\n", (double) nsOld / nsNew, sink) ;
+
+	return 0 ;
+}
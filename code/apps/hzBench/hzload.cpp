@@ -0,0 +1,1260 @@
+//
+//	File:	hzload.cpp
+//
+//	Desc:	Load generator for hzIpServer applications. Drives HTTP/1.1 (keep-alive, pipelined or one request per connection), SMTP or POP3 sessions against a
+//			server over a set number of connections from a set number of threads, each with its own epoll loop, and reports throughput and latency percentiles.
+//			Used with hzrefsvr, it allows the serving regimes of hzIpServer to be compared on the one machine.
+//
+//	Legal Notice: This file is part of the HadronZoo::Bench programs which in turn depend on the HadronZoo C++ Class Library with which they are shipped.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	HadronZoo::Bench is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free
+//	Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is also free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	HadronZoo::Bench is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License along with HadronZoo::Bench. If not, see http://www.gnu.org/licenses.
+//
+
+#include <iostream>
+#include <fstream>
+
+using namespace std ;
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <openssl/ssl.h>
+
+#include "hzBasedefs.h"
+#include "hzProcess.h"
+#include "hzMetrics.h"
+
+/*
+**	Definitions
+*/
+
+#define	LOAD_MAXPIPE	64		//	Maximum HTTP pipeline depth
+#define	LOAD_MAXEVENTS	256		//	Epoll events per wait
+
+enum	LoadProto
+{
+	//	Protocol spoken by the load generator
+
+	LOAD_HTTP,		//	HTTP/1.1 GET requests
+	LOAD_SMTP,		//	SMTP mail transactions
+	LOAD_POP3		//	POP3 mailbox queries
+} ;
+
+enum	LoadReply
+{
+	//	Form of reply expected to a step
+
+	REPLY_HTTP,			//	HTTP response (headers then a body by Content-Length, by chunks or to the close of the connection)
+	REPLY_SMTP,			//	SMTP reply (one or more lines, the last having a space after the code)
+	REPLY_POP3,			//	POP3 single line reply
+	REPLY_POP3_MULTI	//	POP3 multi-line reply (ending with a line of a single period)
+} ;
+
+struct	LoadStep
+{
+	//	Step of a protocol script. A step with no command is the wait for the server greeting.
+
+	const char*	m_pSend ;		//	Command to send (null for the greeting)
+	LoadReply	m_eReply ;		//	Reply expected
+} ;
+
+struct	LoadScript
+{
+	//	Protocol script. The steps from m_nLoop up to (not including) m_nQuit are repeated for as long as the connection is kept alive. The final step quits.
+
+	LoadStep*	m_pSteps ;		//	The steps
+	uint32_t	m_nSteps ;		//	Number of steps
+	uint32_t	m_nLoop ;		//	First step repeated
+	uint32_t	m_nQuit ;		//	The quit step
+} ;
+
+struct	LoadConn
+{
+	//	A client connection
+
+	uint64_t	m_nsConnect ;				//	Time connection began
+	uint64_t	m_nsRetry ;					//	Time at which to reconnect (if not connected)
+	uint64_t	m_nsSent[LOAD_MAXPIPE] ;	//	Time each outstanding request was sent (ring)
+	char*		m_pIn ;						//	Input buffer
+	char*		m_pOut ;					//	Output buffer
+	SSL*		m_pSSL ;					//	TLS connection (-tls)
+	SSL_SESSION*	m_pSess ;				//	Session to resume on the next connection (-resume)
+	int32_t		m_nSock ;					//	Socket (-1 if not connected)
+	uint32_t	m_nInLen ;					//	Bytes in input buffer
+	uint32_t	m_nInCap ;					//	Capacity of input buffer
+	uint32_t	m_nOutPos ;					//	Bytes of output written
+	uint32_t	m_nOutLen ;					//	Bytes of output
+	uint32_t	m_nOutCap ;					//	Capacity of output buffer
+	uint32_t	m_nStep ;					//	Step of script awaiting reply (SMTP and POP3)
+	uint32_t	m_nHead ;					//	Requests sent
+	uint32_t	m_nTail ;					//	Replies received
+	uint32_t	m_nDone ;					//	Requests completed on this connection
+	bool		m_bConnecting ;				//	Connection in progress
+	bool		m_bHandshake ;				//	TLS handshake in progress
+	bool		m_bClosing ;				//	Server has said it will close (HTTP) or client has quit
+	bool		m_bUntilClose ;				//	HTTP response body runs to the close of the connection
+} ;
+
+struct	LoadThread
+{
+	//	Load generating thread and its results
+
+	hzLatencyHist	m_Req ;				//	Request latency
+	hzLatencyHist	m_Conn ;			//	Connection latency (connect to greeting or to writable)
+	pthread_t		m_Tid ;				//	Thread id
+	uint64_t		m_nRequests ;		//	Requests completed
+	uint64_t		m_nBytesIn ;		//	Bytes received
+	uint64_t		m_nBytesOut ;		//	Bytes sent
+	uint64_t		m_nConnects ;		//	Connections made
+	uint64_t		m_nErrConnect ;		//	Connections that failed or timed out
+	uint64_t		m_nErrTimeout ;		//	Requests that timed out
+	uint64_t		m_nErrClosed ;		//	Connections closed by the server with requests outstanding
+	uint64_t		m_nRefused ;		//	Connections closed by the server before any reply
+	uint64_t		m_nErrReply ;		//	Replies indicating failure (HTTP 4xx/5xx, SMTP 4xx/5xx, POP3 -ERR)
+	uint64_t		m_nReaped ;			//	Stalled connections closed by the server (-stall)
+	uint64_t		m_nHandshakes ;		//	TLS handshakes completed
+	uint64_t		m_nResumed ;		//	TLS handshakes that resumed an earlier session
+	uint64_t		m_nStatus[6] ;		//	HTTP responses by status class (index 1 to 5)
+	uint32_t		m_nConns ;			//	Connections maintained by the thread
+	int32_t			m_nEpoll ;			//	Epoll instance
+} ;
+
+/*
+**	Variables
+*/
+
+bool	_hzGlobal_XM = false ;			//	Using/not using operator new/delete override
+bool	_hzGlobal_MT = true ;			//	Program is multi-threaded
+
+global	hzProcess	proc ;				//	hzProcess instance (all Hadronzoo based applications require this)
+
+static	LoadStep	s_stepsHTTP[] =
+{
+	{ 0,	REPLY_HTTP },				//	Request text is formed at startup
+} ;
+
+static	LoadStep	s_stepsSMTP[] =
+{
+	{ 0,									REPLY_SMTP },
+	{ "EHLO hzload.test\r\n",				REPLY_SMTP },
+	{ "MAIL FROM:<load@hzload.test>\r\n",	REPLY_SMTP },
+	{ "RCPT TO:<sink@hzrefsvr.test>\r\n",	REPLY_SMTP },
+	{ "DATA\r\n",							REPLY_SMTP },
+	{ 0,									REPLY_SMTP },	//	Message text is formed at startup
+	{ "QUIT\r\n",							REPLY_SMTP },
+} ;
+
+static	LoadStep	s_stepsPOP3[] =
+{
+	{ 0,					REPLY_POP3 },
+	{ "USER load\r\n",		REPLY_POP3 },
+	{ "PASS load\r\n",		REPLY_POP3 },
+	{ "STAT\r\n",			REPLY_POP3 },
+	{ "LIST\r\n",			REPLY_POP3_MULTI },
+	{ "RETR 1\r\n",			REPLY_POP3_MULTI },
+	{ "QUIT\r\n",			REPLY_POP3 },
+} ;
+
+static	LoadScript	s_Script ;					//	Script in use
+static	LoadProto	s_eProto = LOAD_HTTP ;		//	Protocol
+static	struct sockaddr_in	s_Addr ;				//	Server address
+static	struct sockaddr_in	s_Bind ;				//	Local address to connect from (if set by -bind)
+static	SSL_CTX*	s_pCTX ;					//	TLS client context (-tls)
+static	char*		s_pRequest ;				//	HTTP request text
+static	char*		s_pMessage ;				//	SMTP message text
+static	uint32_t	s_nThreads = 2 ;			//	Threads
+static	uint32_t	s_nConns = 16 ;				//	Connections (across all threads)
+static	uint32_t	s_nPipeline = 1 ;			//	HTTP pipeline depth
+static	uint32_t	s_nPerConn = 0 ;			//	Requests per connection (0 for unlimited)
+static	uint32_t	s_nSecs = 10 ;				//	Duration of measurement
+static	uint32_t	s_nWarmup = 1 ;				//	Duration of warmup
+static	uint32_t	s_nMsgSize = 1024 ;			//	SMTP message size
+static	uint64_t	s_nsTimeout = 5000000000 ;	//	Request timeout
+static	bool		s_bStall ;					//	Connections send nothing and wait to be closed by the server
+static	bool		s_bResume ;					//	Connections resume the TLS session of their previous connection
+static	bool		s_bRecord ;					//	Results are being recorded (warmup is over)
+static	bool		s_bStop ;					//	Threads are to stop
+
+/*
+**	Functions
+*/
+
+static	uint64_t	_nsNow	(void)
+{
+	//	Monotonic time in nanoseconds
+
+	struct timespec	ts ;	//	Time
+
+	clock_gettime(CLOCK_MONOTONIC, &ts) ;
+	return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec ;
+}
+
+static	bool	_recording	(void)	{ return __atomic_load_n(&s_bRecord, __ATOMIC_RELAXED) ; }
+
+static	int32_t	_sockRead	(LoadConn* pC, char* pBuf, uint32_t nMax)
+{
+	//	Read from the connection, through TLS if in use
+	//
+	//	Arguments:	1)	pC		The connection
+	//				2)	pBuf	Buffer
+	//				3)	nMax	Buffer space
+	//
+	//	Returns:	Bytes read
+	//				0 if the server has closed the connection (or the read failed)
+	//				-1 with errno EAGAIN if the read must wait for the socket
+
+	int32_t	nRecv ;		//	Bytes read
+
+	if (!pC->m_pSSL)
+		return read(pC->m_nSock, pBuf, nMax) ;
+
+	nRecv = SSL_read(pC->m_pSSL, pBuf, nMax) ;
+	if (nRecv > 0)
+		return nRecv ;
+
+	switch	(SSL_get_error(pC->m_pSSL, nRecv))
+	{
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		errno = EAGAIN ;
+		return -1 ;
+	}
+	return 0 ;
+}
+
+static	int32_t	_sockWrite	(LoadConn* pC, const char* pBuf, uint32_t nLen)
+{
+	//	Write to the connection, through TLS if in use
+	//
+	//	Arguments:	1)	pC		The connection
+	//				2)	pBuf	Data
+	//				3)	nLen	Length of data
+	//
+	//	Returns:	Bytes written
+	//				0 or less if the socket will take no more (or the write failed)
+
+	if (!pC->m_pSSL)
+		return write(pC->m_nSock, pBuf, nLen) ;
+	return SSL_write(pC->m_pSSL, pBuf, nLen) ;
+}
+
+static	int		_newSession	(SSL* pSSL, SSL_SESSION* pSess)
+{
+	//	Keep the latest session issued on a connection, to be resumed when the connection is next made (-resume). Under TLS 1.3, sessions are issued after
+	//	the handshake, in tickets that are processed as the response is read.
+	//
+	//	Arguments:	1)	pSSL	The TLS connection
+	//				2)	pSess	The session
+	//
+	//	Returns:	1 as the session is kept
+
+	LoadConn*	pC ;	//	The connection
+
+	pC = (LoadConn*) SSL_get_app_data(pSSL) ;
+	if (pC->m_pSess)
+		SSL_SESSION_free(pC->m_pSess) ;
+	pC->m_pSess = pSess ;
+	return 1 ;
+}
+
+static	void	_queue	(LoadThread* pT, LoadConn* pC, const char* pData, uint32_t nLen)
+{
+	//	Append to the output buffer of the connection and note the time the request was sent
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+	//				3)	pData	The request
+	//				4)	nLen	Length of request
+
+	if (pC->m_nOutPos == pC->m_nOutLen)
+		pC->m_nOutPos = pC->m_nOutLen = 0 ;
+
+	if (pC->m_nOutLen + nLen > pC->m_nOutCap)
+	{
+		pC->m_nOutCap = (pC->m_nOutLen + nLen) * 2 ;
+		pC->m_pOut = (char*) realloc(pC->m_pOut, pC->m_nOutCap) ;
+	}
+
+	memcpy(pC->m_pOut + pC->m_nOutLen, pData, nLen) ;
+	pC->m_nOutLen += nLen ;
+	pC->m_nsSent[pC->m_nHead % LOAD_MAXPIPE] = _nsNow() ;
+	pC->m_nHead++ ;
+}
+
+static	void	_close	(LoadThread* pT, LoadConn* pC, uint64_t nsRetry)
+{
+	//	Close the connection and set the time at which it is to be reopened
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+	//				3)	nsRetry	Time to reconnect
+
+	if (pC->m_pSSL)
+	{
+		//	Send the close_notify (if the socket will take it) so the server may keep the session for resumption
+		if (!pC->m_bHandshake)
+			SSL_shutdown(pC->m_pSSL) ;
+		SSL_free(pC->m_pSSL) ;
+		pC->m_pSSL = 0 ;
+	}
+
+	if (pC->m_nSock >= 0)
+	{
+		epoll_ctl(pT->m_nEpoll, EPOLL_CTL_DEL, pC->m_nSock, 0) ;
+		close(pC->m_nSock) ;
+	}
+
+	pC->m_nSock = -1 ;
+	pC->m_nsRetry = nsRetry ;
+	pC->m_bConnecting = pC->m_bHandshake = false ;
+}
+
+static	void	_flush	(LoadThread* pT, LoadConn* pC)
+{
+	//	Write out as much of the output buffer as the socket will take, waiting for the socket to become writable if it will not take it all
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+
+	struct epoll_event	ev ;	//	Epoll registration
+	int32_t				nSent ;	//	Bytes written
+
+	while (pC->m_nOutPos < pC->m_nOutLen)
+	{
+		nSent = _sockWrite(pC, pC->m_pOut + pC->m_nOutPos, pC->m_nOutLen - pC->m_nOutPos) ;
+		if (nSent <= 0)
+			break ;
+		pC->m_nOutPos += nSent ;
+		if (_recording())
+			pT->m_nBytesOut += nSent ;
+	}
+
+	ev.data.ptr = pC ;
+	ev.events = EPOLLIN ;
+	if (pC->m_nOutPos < pC->m_nOutLen)
+		ev.events |= EPOLLOUT ;
+	epoll_ctl(pT->m_nEpoll, EPOLL_CTL_MOD, pC->m_nSock, &ev) ;
+}
+
+static	void	_send	(LoadThread* pT, LoadConn* pC)
+{
+	//	Send the command of the current step (SMTP and POP3) or top up the pipeline of requests (HTTP)
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+
+	const char*	pCmd ;		//	Command text
+
+	if (s_eProto == LOAD_HTTP)
+	{
+		while ((pC->m_nHead - pC->m_nTail) < s_nPipeline && !pC->m_bClosing)
+		{
+			if (s_nPerConn && pC->m_nHead >= s_nPerConn)
+				break ;
+			_queue(pT, pC, s_pRequest, strlen(s_pRequest)) ;
+		}
+	}
+	else
+	{
+		pCmd = pC->m_nStep == 5 && s_eProto == LOAD_SMTP ? s_pMessage : s_Script.m_pSteps[pC->m_nStep].m_pSend ;
+		if (!pCmd)
+			return ;
+		_queue(pT, pC, pCmd, strlen(pCmd)) ;
+	}
+
+	_flush(pT, pC) ;
+}
+
+static	void	_connect	(LoadThread* pT, LoadConn* pC)
+{
+	//	Begin a non-blocking connection to the server
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+
+	struct epoll_event	ev ;		//	Epoll registration
+	int32_t				nFlag ;		//	Socket option
+
+	pC->m_nSock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0) ;
+	if (pC->m_nSock < 0)
+		{ pC->m_nsRetry = _nsNow() + 100000000 ; return ; }
+
+	nFlag = 1 ;
+	setsockopt(pC->m_nSock, IPPROTO_TCP, TCP_NODELAY, &nFlag, sizeof(nFlag)) ;
+
+	if (s_Bind.sin_family && bind(pC->m_nSock, (struct sockaddr*) &s_Bind, sizeof(s_Bind)) < 0)
+	{
+		if (_recording())
+			pT->m_nErrConnect++ ;
+		close(pC->m_nSock) ;
+		pC->m_nSock = -1 ;
+		pC->m_nsRetry = _nsNow() + 100000000 ;
+		return ;
+	}
+
+	pC->m_nsConnect = _nsNow() ;
+	pC->m_nInLen = pC->m_nOutPos = pC->m_nOutLen = 0 ;
+	pC->m_nStep = pC->m_nHead = pC->m_nTail = pC->m_nDone = 0 ;
+	pC->m_bClosing = pC->m_bUntilClose = false ;
+	pC->m_bConnecting = true ;
+
+	if (connect(pC->m_nSock, (struct sockaddr*) &s_Addr, sizeof(s_Addr)) < 0 && errno != EINPROGRESS)
+	{
+		if (_recording())
+			pT->m_nErrConnect++ ;
+		close(pC->m_nSock) ;
+		pC->m_nSock = -1 ;
+		pC->m_nsRetry = _nsNow() + 10000000 ;
+		return ;
+	}
+
+	ev.data.ptr = pC ;
+	ev.events = EPOLLIN | EPOLLOUT ;
+	epoll_ctl(pT->m_nEpoll, EPOLL_CTL_ADD, pC->m_nSock, &ev) ;
+}
+
+static	void	_ready	(LoadThread* pT, LoadConn* pC)
+{
+	//	Begin the protocol on a connection that has been made (and where TLS is in use, has completed the handshake). For SMTP and POP3 the greeting is
+	//	awaited, for HTTP the first requests are sent.
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+
+	if (s_eProto == LOAD_HTTP)
+	{
+		if (_recording())
+			pT->m_Conn.Record(_nsNow() - pC->m_nsConnect) ;
+		_send(pT, pC) ;
+		return ;
+	}
+
+	//	Await the greeting. This is timed from the start of the connection.
+	pC->m_nsSent[0] = pC->m_nsConnect ;
+	pC->m_nHead = 1 ;
+	_flush(pT, pC) ;
+}
+
+static	void	_handshake	(LoadThread* pT, LoadConn* pC)
+{
+	//	Advance the TLS handshake, waiting on the socket as OpenSSL requires. Once complete, note whether the session was resumed and begin the protocol.
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+
+	struct epoll_event	ev ;	//	Epoll registration
+	int32_t				nRet ;	//	Return from SSL_connect
+
+	nRet = SSL_connect(pC->m_pSSL) ;
+	if (nRet == 1)
+	{
+		pC->m_bHandshake = false ;
+		if (_recording())
+		{
+			pT->m_nHandshakes++ ;
+			if (SSL_session_reused(pC->m_pSSL))
+				pT->m_nResumed++ ;
+		}
+		_ready(pT, pC) ;
+		return ;
+	}
+
+	switch	(SSL_get_error(pC->m_pSSL, nRet))
+	{
+	case SSL_ERROR_WANT_READ:	ev.events = EPOLLIN ;				break ;
+	case SSL_ERROR_WANT_WRITE:	ev.events = EPOLLIN | EPOLLOUT ;	break ;
+	default:
+		if (_recording())
+			pT->m_nErrConnect++ ;
+		_close(pT, pC, _nsNow() + 10000000) ;
+		return ;
+	}
+
+	ev.data.ptr = pC ;
+	epoll_ctl(pT->m_nEpoll, EPOLL_CTL_MOD, pC->m_nSock, &ev) ;
+}
+
+static	void	_connected	(LoadThread* pT, LoadConn* pC)
+{
+	//	Complete a connection once the socket is writable. Where TLS is in use the handshake is begun, otherwise the protocol.
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+
+	socklen_t	nLen ;		//	Option length
+	int32_t		nErr ;		//	Connection error
+
+	nErr = 0 ;
+	nLen = sizeof(nErr) ;
+	getsockopt(pC->m_nSock, SOL_SOCKET, SO_ERROR, &nErr, &nLen) ;
+	if (nErr)
+	{
+		if (_recording())
+			pT->m_nErrConnect++ ;
+		_close(pT, pC, _nsNow() + 10000000) ;
+		return ;
+	}
+
+	pC->m_bConnecting = false ;
+	if (_recording())
+		pT->m_nConnects++ ;
+
+	if (s_bStall)
+	{
+		//	Send nothing (not even a TLS ClientHello) and wait for the server to close the connection
+		_flush(pT, pC) ;
+		return ;
+	}
+
+	if (s_pCTX)
+	{
+		pC->m_pSSL = SSL_new(s_pCTX) ;
+		if (!pC->m_pSSL)
+		{
+			if (_recording())
+				pT->m_nErrConnect++ ;
+			_close(pT, pC, _nsNow() + 100000000) ;
+			return ;
+		}
+
+		SSL_set_fd(pC->m_pSSL, pC->m_nSock) ;
+		SSL_set_app_data(pC->m_pSSL, pC) ;
+		if (s_bResume && pC->m_pSess)
+			SSL_set_session(pC->m_pSSL, pC->m_pSess) ;
+		pC->m_bHandshake = true ;
+		_handshake(pT, pC) ;
+		return ;
+	}
+
+	_ready(pT, pC) ;
+}
+
+static	uint32_t	_lineEnd	(const char* p, uint32_t nLen, uint32_t nFrom)
+{
+	//	Return the position after the next LF at or beyond nFrom, or 0 if there is none
+
+	const char*	pLF ;	//	Line feed
+
+	if (nFrom >= nLen)
+		return 0 ;
+	pLF = (const char*) memchr(p + nFrom, '\n', nLen - nFrom) ;
+	return pLF ? (pLF - p) + 1 : 0 ;
+}
+
+static	uint32_t	_replyHTTP	(LoadConn* pC, bool& bOK, LoadThread* pT)
+{
+	//	Determine if the input begins with a complete HTTP response
+	//
+	//	Arguments:	1)	pC		The connection
+	//				2)	bOK		Set to false if the status is 400 or above
+	//				3)	pT		The thread (for status counts)
+	//
+	//	Returns:	Length of the response if it is complete
+	//				0 if more input is needed
+
+	const char*	p = pC->m_pIn ;		//	Input
+	const char*	pHdrEnd ;			//	End of headers
+	uint32_t	nLen = pC->m_nInLen ;	//	Input length
+	uint32_t	nHdr ;				//	Length of headers
+	uint32_t	nBody = 0 ;			//	Content length
+	uint32_t	nPosn ;				//	Position
+	uint32_t	nNext ;				//	Next line
+	uint32_t	nChunk ;			//	Chunk size
+	uint32_t	nStatus ;			//	Status code
+	bool		bChunked = false ;	//	Chunked transfer encoding
+	bool		bLength = false ;	//	Content length given
+
+	pHdrEnd = (const char*) memmem(p, nLen, "\r\n\r\n", 4) ;
+	if (!pHdrEnd)
+		return 0 ;
+	nHdr = (pHdrEnd - p) + 4 ;
+
+	nStatus = nLen > 12 ? atoi(p + 9) : 0 ;
+
+	for (nPosn = _lineEnd(p, nHdr, 0) ; nPosn && nPosn < nHdr - 2 ; nPosn = _lineEnd(p, nHdr, nPosn))
+	{
+		if (!strncasecmp(p + nPosn, "Content-Length:", 15))
+			{ nBody = atoi(p + nPosn + 15) ; bLength = true ; }
+		else if (!strncasecmp(p + nPosn, "Transfer-Encoding:", 18) && memmem(p + nPosn, _lineEnd(p, nHdr, nPosn) - nPosn, "chunked", 7))
+			bChunked = true ;
+		else if (!strncasecmp(p + nPosn, "Connection:", 11) && memmem(p + nPosn, _lineEnd(p, nHdr, nPosn) - nPosn, "close", 5))
+			pC->m_bClosing = true ;
+	}
+
+	if (bChunked)
+	{
+		//	Each chunk is a hex size line, the data and a CRLF. A zero size chunk is followed by any trailers and an empty line.
+		for (nPosn = nHdr ;;)
+		{
+			nNext = _lineEnd(p, nLen, nPosn) ;
+			if (!nNext)
+				return 0 ;
+			nChunk = strtoul(p + nPosn, 0, 16) ;
+			if (!nChunk)
+			{
+				for (nPosn = nNext ;; nPosn = nNext)
+				{
+					nNext = _lineEnd(p, nLen, nPosn) ;
+					if (!nNext)
+						return 0 ;
+					if (nNext - nPosn <= 2)
+						break ;
+				}
+				break ;
+			}
+			nPosn = nNext + nChunk + 2 ;
+			if (nPosn > nLen)
+				return 0 ;
+		}
+		nBody = nNext - nHdr ;
+	}
+	else if (!bLength && nStatus >= 200 && nStatus != 204 && nStatus != 304)
+	{
+		//	No length so the body runs to the close of the connection
+		pC->m_bUntilClose = pC->m_bClosing = true ;
+		return 0 ;
+	}
+
+	if (nHdr + nBody > nLen)
+		return 0 ;
+
+	if (_recording() && nStatus >= 100 && nStatus < 600)
+		pT->m_nStatus[nStatus / 100]++ ;
+	bOK = nStatus >= 200 && nStatus < 400 ;
+	return nHdr + nBody ;
+}
+
+static	uint32_t	_reply	(LoadThread* pT, LoadConn* pC, bool& bOK)
+{
+	//	Determine if the input begins with a complete reply of the form expected by the current step
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+	//				3)	bOK		Set to false if the reply indicates failure
+	//
+	//	Returns:	Length of the reply if it is complete
+	//				0 if more input is needed
+
+	const char*	p = pC->m_pIn ;		//	Input
+	const char*	pEnd ;				//	Terminating line
+	uint32_t	nLen = pC->m_nInLen ;	//	Input length
+	uint32_t	nPosn ;				//	Position
+	uint32_t	nNext ;				//	Next line
+
+	bOK = true ;
+
+	switch	(s_Script.m_pSteps[pC->m_nStep].m_eReply)
+	{
+	case REPLY_HTTP:
+		return _replyHTTP(pC, bOK, pT) ;
+
+	case REPLY_SMTP:
+		//	Lines of the form "250-text" continue, "250 text" ends
+		for (nPosn = 0 ; (nNext = _lineEnd(p, nLen, nPosn)) ; nPosn = nNext)
+		{
+			if (nNext - nPosn < 4 || p[nPosn+3] != '-')
+			{
+				bOK = p[0] == '2' || p[0] == '3' ;
+				return nNext ;
+			}
+		}
+		return 0 ;
+
+	case REPLY_POP3:
+		nNext = _lineEnd(p, nLen, 0) ;
+		bOK = nNext && p[0] == '+' ;
+		return nNext ;
+
+	case REPLY_POP3_MULTI:
+		nNext = _lineEnd(p, nLen, 0) ;
+		if (!nNext)
+			return 0 ;
+		if (p[0] != '+')
+			{ bOK = false ; return nNext ; }
+		if (nNext >= 2 && nLen - nNext >= 3 && !memcmp(p + nNext, ".\r\n", 3))
+			return nNext + 3 ;
+		pEnd = (const char*) memmem(p + nNext - 1, nLen - nNext + 1, "\n.\r\n", 4) ;
+		return pEnd ? (pEnd - p) + 4 : 0 ;
+	}
+
+	return 0 ;
+}
+
+static	void	_replied	(LoadThread* pT, LoadConn* pC, bool bOK)
+{
+	//	Account for a complete reply and proceed to the next step
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+	//				3)	bOK		The reply indicates success
+
+	uint64_t	nsNow ;		//	Time now
+	uint64_t	nsSent ;	//	Time request was sent
+	uint32_t	nStep ;		//	Step replied to
+
+	nsNow = _nsNow() ;
+	nsSent = pC->m_nsSent[pC->m_nTail % LOAD_MAXPIPE] ;
+	pC->m_nTail++ ;
+	nStep = pC->m_nStep ;
+
+	if (_recording())
+	{
+		if (!bOK)
+			pT->m_nErrReply++ ;
+
+		if (s_eProto != LOAD_HTTP && nStep == 0)
+			pT->m_Conn.Record(nsNow - nsSent) ;
+		else
+		{
+			pT->m_Req.Record(nsNow - nsSent) ;
+			pT->m_nRequests++ ;
+		}
+	}
+	pC->m_nDone++ ;
+
+	if (s_eProto == LOAD_HTTP)
+	{
+		if (pC->m_bClosing || (s_nPerConn && pC->m_nDone >= s_nPerConn))
+		{
+			if (pC->m_nHead == pC->m_nTail)
+				_close(pT, pC, nsNow) ;
+			return ;
+		}
+		_send(pT, pC) ;
+		return ;
+	}
+
+	if (nStep == s_Script.m_nQuit)
+		{ _close(pT, pC, nsNow) ; return ; }
+
+	//	At the end of a transaction, repeat it unless the connection has done its share
+	nStep++ ;
+	if (nStep == s_Script.m_nQuit && (!s_nPerConn || pC->m_nDone < s_nPerConn))
+		nStep = s_Script.m_nLoop ;
+
+	pC->m_nStep = nStep ;
+	_send(pT, pC) ;
+}
+
+static	void	_read	(LoadThread* pT, LoadConn* pC)
+{
+	//	Read what the server has sent and process any complete replies
+	//
+	//	Arguments:	1)	pT		The thread
+	//				2)	pC		The connection
+
+	uint32_t	nReply ;	//	Length of reply
+	int32_t		nRecv ;		//	Bytes read
+	bool		bOK ;		//	Reply indicates success
+	bool		bEOF ;		//	Server has closed the connection
+
+	for (bEOF = false ;;)
+	{
+		if (pC->m_nInCap - pC->m_nInLen < 4096)
+		{
+			pC->m_nInCap *= 2 ;
+			pC->m_pIn = (char*) realloc(pC->m_pIn, pC->m_nInCap) ;
+		}
+
+		nRecv = _sockRead(pC, pC->m_pIn + pC->m_nInLen, pC->m_nInCap - pC->m_nInLen) ;
+		if (nRecv > 0)
+		{
+			pC->m_nInLen += nRecv ;
+			if (_recording())
+				pT->m_nBytesIn += nRecv ;
+			continue ;
+		}
+
+		//	Stop on EAGAIN or where the server has closed the connection (or the read failed). The final replies may have come with the close.
+		if (nRecv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break ;
+		bEOF = true ;
+		break ;
+	}
+
+	if (s_bStall)
+	{
+		//	Ignore anything sent (such as a greeting) and note the time taken for the server to close the connection
+		pC->m_nInLen = 0 ;
+		if (!bEOF)
+			return ;
+		if (_recording())
+		{
+			pT->m_nReaped++ ;
+			pT->m_Conn.Record(_nsNow() - pC->m_nsConnect) ;
+		}
+		_close(pT, pC, _nsNow()) ;
+		return ;
+	}
+
+	while (pC->m_nSock >= 0 && pC->m_nHead != pC->m_nTail && pC->m_nInLen)
+	{
+		nReply = _reply(pT, pC, bOK) ;
+		if (!nReply)
+			break ;
+
+		//	Consume the reply before proceeding as _replied() may close the connection and reset the buffer
+		pC->m_nInLen -= nReply ;
+		memmove(pC->m_pIn, pC->m_pIn + nReply, pC->m_nInLen) ;
+		_replied(pT, pC, bOK) ;
+	}
+
+	if (!bEOF || pC->m_nSock < 0)
+		return ;
+
+	if (pC->m_bUntilClose)
+	{
+		if (_recording())
+			pT->m_nStatus[2]++ ;
+		pC->m_nInLen = 0 ;
+		_replied(pT, pC, true) ;
+	}
+	else if (pC->m_nHead != pC->m_nTail && _recording())
+	{
+		pT->m_nErrClosed++ ;
+		if (!pC->m_nDone)
+			pT->m_nRefused++ ;
+	}
+	_close(pT, pC, _nsNow()) ;
+}
+
+static	void*	_loadThread	(void* pArg)
+{
+	//	Load generating thread. Maintains the thread's share of the connections until told to stop.
+	//
+	//	Arguments:	1)	pArg	The LoadThread
+	//
+	//	Returns:	Null
+
+	struct epoll_event	events[LOAD_MAXEVENTS] ;	//	Epoll events
+
+	LoadThread*	pT ;		//	This thread
+	LoadConn*	pConns ;	//	The connections
+	LoadConn*	pC ;		//	Connection
+	uint64_t	nsNow ;		//	Time now
+	uint64_t	nsScan ;	//	Time of next timeout scan
+	uint32_t	n ;			//	Connection iterator
+	int32_t		nEvents ;	//	Events returned
+	int32_t		nE ;		//	Event iterator
+
+	pT = (LoadThread*) pArg ;
+	pT->m_nEpoll = epoll_create1(0) ;
+
+	pConns = new LoadConn[pT->m_nConns] ;
+	memset(pConns, 0, pT->m_nConns * sizeof(LoadConn)) ;
+
+	for (n = 0 ; n < pT->m_nConns ; n++)
+	{
+		pC = pConns + n ;
+		pC->m_nInCap = 16384 ;
+		pC->m_pIn = (char*) malloc(pC->m_nInCap) ;
+		pC->m_nOutCap = 4096 ;
+		pC->m_pOut = (char*) malloc(pC->m_nOutCap) ;
+		pC->m_nSock = -1 ;
+		_connect(pT, pC) ;
+	}
+
+	for (nsScan = 0 ; !__atomic_load_n(&s_bStop, __ATOMIC_RELAXED) ;)
+	{
+		nEvents = epoll_wait(pT->m_nEpoll, events, LOAD_MAXEVENTS, 20) ;
+
+		for (nE = 0 ; nE < nEvents ; nE++)
+		{
+			pC = (LoadConn*) events[nE].data.ptr ;
+			if (pC->m_nSock < 0)
+				continue ;
+
+			if (pC->m_bConnecting)
+			{
+				_connected(pT, pC) ;
+				continue ;
+			}
+
+			if (pC->m_bHandshake)
+			{
+				_handshake(pT, pC) ;
+				continue ;
+			}
+
+			if (events[nE].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+				_read(pT, pC) ;
+			if (pC->m_nSock >= 0 && events[nE].events & EPOLLOUT)
+				_flush(pT, pC) ;
+		}
+
+		//	Reopen closed connections and expire those waiting too long
+		nsNow = _nsNow() ;
+		if (nsNow < nsScan)
+			continue ;
+		nsScan = nsNow + 10000000 ;
+
+		for (n = 0 ; n < pT->m_nConns ; n++)
+		{
+			pC = pConns + n ;
+
+			if (pC->m_nSock < 0)
+			{
+				if (nsNow >= pC->m_nsRetry)
+					_connect(pT, pC) ;
+				continue ;
+			}
+
+			if ((pC->m_bConnecting || pC->m_bHandshake) && nsNow - pC->m_nsConnect > s_nsTimeout)
+			{
+				if (_recording())
+					pT->m_nErrConnect++ ;
+				_close(pT, pC, nsNow) ;
+				continue ;
+			}
+
+			if (s_bStall && nsNow - pC->m_nsConnect > s_nsTimeout)
+			{
+				//	The server has left a stalled connection open for longer than it should
+				if (_recording())
+					pT->m_nErrTimeout++ ;
+				_close(pT, pC, nsNow) ;
+				continue ;
+			}
+
+			if (pC->m_nHead != pC->m_nTail && nsNow - pC->m_nsSent[pC->m_nTail % LOAD_MAXPIPE] > s_nsTimeout)
+			{
+				if (_recording())
+					pT->m_nErrTimeout++ ;
+				_close(pT, pC, nsNow) ;
+			}
+		}
+	}
+
+	for (n = 0 ; n < pT->m_nConns ; n++)
+	{
+		pC = pConns + n ;
+		if (pC->m_pSSL)
+			SSL_free(pC->m_pSSL) ;
+		if (pC->m_pSess)
+			SSL_SESSION_free(pC->m_pSess) ;
+		if (pC->m_nSock >= 0)
+			close(pC->m_nSock) ;
+		free(pC->m_pIn) ;
+		free(pC->m_pOut) ;
+	}
+
+	close(pT->m_nEpoll) ;
+	delete [] pConns ;
+	return 0 ;
+}
+
+static	double	_usec	(uint64_t nsVal)	{ return (double) nsVal / 1000.0 ; }
+
+int		main	(int argc, char ** argv)
+{
+	_hzfunc("hzload::main") ;
+
+	LoadThread*		pThreads ;				//	The threads
+	LoadThread		total ;					//	Totals
+	const char*		host = "127.0.0.1" ;	//	Server address
+	const char*		path = "/" ;			//	HTTP resource
+	const char*		hdr = "" ;				//	Additional HTTP request header
+	const char*		tag = 0 ;				//	Label for CSV output
+	const char*		from = 0 ;				//	Local address to connect from
+	const char*		expect = "served" ;		//	Expected outcome (served, refused or limited)
+	uint64_t		nsBegin ;				//	Start of measurement
+	uint64_t		nsEnd ;					//	End of measurement
+	uint64_t		nLast ;					//	Requests at last progress report
+	uint64_t		nNow ;					//	Requests now
+	double			secs ;					//	Duration of measurement
+	uint32_t		nPort = 0 ;				//	Server port
+	uint32_t		nTimeout = 5000 ;		//	Request timeout in milliseconds
+	uint32_t		n ;						//	Thread iterator
+	uint32_t		nSec ;					//	Second iterator
+	uint32_t		nLen ;					//	Length of message text
+	int32_t			nArg ;					//	Argument iterator
+	bool			bClose = false ;		//	One HTTP request per connection
+	bool			bProgress = false ;		//	Report each second
+	bool			bTls = false ;			//	Connect using TLS
+
+	signal(SIGPIPE,	SIG_IGN) ;
+
+	for (nArg = 1 ; nArg < argc ; nArg++)
+	{
+		if		(!strcmp(argv[nArg], "http"))		s_eProto = LOAD_HTTP ;
+		else if (!strcmp(argv[nArg], "smtp"))		s_eProto = LOAD_SMTP ;
+		else if (!strcmp(argv[nArg], "pop3"))		s_eProto = LOAD_POP3 ;
+		else if (!strcmp(argv[nArg], "-close"))		bClose = true ;
+		else if (!strcmp(argv[nArg], "-v"))			bProgress = true ;
+		else if (!strcmp(argv[nArg], "-stall"))		s_bStall = true ;
+		else if (!strcmp(argv[nArg], "-tls"))		bTls = true ;
+		else if (!strcmp(argv[nArg], "-resume"))	s_bResume = true ;
+		else if (!strcmp(argv[nArg], "-host") && nArg+1 < argc)		host = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-port") && nArg+1 < argc)		nPort = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-path") && nArg+1 < argc)		path = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-hdr") && nArg+1 < argc)		hdr = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-threads") && nArg+1 < argc)	s_nThreads = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-conns") && nArg+1 < argc)	s_nConns = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-pipeline") && nArg+1 < argc)	s_nPipeline = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-per") && nArg+1 < argc)		s_nPerConn = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-secs") && nArg+1 < argc)		s_nSecs = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-warmup") && nArg+1 < argc)	s_nWarmup = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-size") && nArg+1 < argc)		s_nMsgSize = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-timeout") && nArg+1 < argc)	nTimeout = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-csv") && nArg+1 < argc)		tag = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-bind") && nArg+1 < argc)		from = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-expect") && nArg+1 < argc)	expect = argv[++nArg] ;
+		else
+		{
+			cout << "Usage: hzload http|smtp|pop3 [-host addr] [-port n] [-threads n] [-conns n] [-secs n] [-warmup n] [-timeout ms]\n"
+					"              [-path resource] [-hdr header] [-pipeline n] [-close] [-per n] [-size bytes] [-bind addr] [-expect outcome]\n"
+					"              [-stall] [-tls [-resume]] [-csv tag] [-v]\n"
+					"  -hdr       HTTP: additional request header, e.g. -hdr \"Cookie: sess=1\" (against hzrefsvr -proxy, checks a proxy-only front\n"
+					"             process accepts requests bearing cookies)\n"
+					"  -conns     Connections across all threads (default 16)\n"
+					"  -pipeline  HTTP requests sent before awaiting responses (default 1)\n"
+					"  -close     HTTP: one request per connection. SMTP/POP3: quit after each transaction\n"
+					"  -per       Requests (HTTP) or transactions (SMTP/POP3) per connection before reconnecting (default unlimited)\n"
+					"  -size      SMTP message size (default 1024)\n"
+					"  -csv       Also print results as a CSV line labelled with the tag\n"
+					"  -bind      Connect from the given local address, e.g. 127.0.0.2 (localhost itself is never blocked or limited by hzIpServer)\n"
+					"  -expect    Outcome for a zero exit status: served (default, requests were completed), refused (none were, and the server\n"
+					"             closed connections before any reply) or limited (both). Against hzrefsvr -mode mt -block 127.0.0.2, hzload\n"
+					"             -bind 127.0.0.2 -expect refused checks the blocklist applies to the accepted address. Against hzrefsvr -mode mt\n"
+					"             -perip 50, hzload -bind 127.0.0.2 -close -expect limited checks the per-address connection rate limit is\n"
+					"             applied to it likewise. reaped (with -stall): the server closed the stalled connections, none outliving -timeout.\n"
+					"             resumed (with -tls -resume): requests were completed and TLS sessions resumed. full (with -tls): requests were\n"
+					"             completed and no TLS session was resumed\n"
+					"  -stall     Connect but send nothing, and time how long the server takes to close each connection. Against the TLS port of\n"
+					"             hzrefsvr -https 18443 -cert file -key file -tlstimeout 2, hzload -port 18443 -stall -timeout 4000 -expect reaped\n"
+					"             checks connections that never complete the TLS handshake are removed within the handshake time limit\n"
+					"  -tls       Connect using TLS (the server certificate is not verified)\n"
+					"  -resume    Offer the TLS session of each connection's previous connection for resumption. Use with -close so connections are\n"
+					"             remade. Against hzrefsvr -https 18443 -cert file -key file -sesscache 0, hzload -port 18443 -tls -resume -close\n"
+					"             -expect resumed checks session tickets are issued and accepted. With hzrefsvr -tickets 0 also, -expect full checks\n"
+					"             that with neither tickets nor the session cache, every handshake is a full one\n"
+					"  Ports default to those of hzrefsvr: HTTP 18080, SMTP 18025, POP3 18110\n" ;
+			return 101 ;
+		}
+	}
+
+	if (!s_nThreads || !s_nConns || !s_nSecs)
+		{ cout << "hzload: threads, conns and secs must be non-zero\n" ; return 102 ; }
+	if (s_nThreads > s_nConns)
+		s_nThreads = s_nConns ;
+	if (!s_nPipeline)
+		s_nPipeline = 1 ;
+	if (s_nPipeline > LOAD_MAXPIPE)
+		s_nPipeline = LOAD_MAXPIPE ;
+	s_nsTimeout = (uint64_t) nTimeout * 1000000 ;
+
+	memset(&s_Addr, 0, sizeof(s_Addr)) ;
+	s_Addr.sin_family = AF_INET ;
+	if (inet_pton(AF_INET, host, &s_Addr.sin_addr) != 1)
+		{ cout << "hzload: Invalid host address " << host << " (give an IPv4 address)\n" ; return 103 ; }
+
+	if (from)
+	{
+		s_Bind.sin_family = AF_INET ;
+		if (inet_pton(AF_INET, from, &s_Bind.sin_addr) != 1)
+			{ cout << "hzload: Invalid local address " << from << " (give an IPv4 address)\n" ; return 103 ; }
+	}
+	if (strcmp(expect, "served") && strcmp(expect, "refused") && strcmp(expect, "limited") && strcmp(expect, "reaped")
+			&& strcmp(expect, "resumed") && strcmp(expect, "full"))
+		{ cout << "hzload: Expected outcome must be served, refused, limited, reaped, resumed or full\n" ; return 102 ; }
+	if (s_bResume && !bTls)
+		{ cout << "hzload: -resume requires -tls\n" ; return 102 ; }
+
+	if (bTls)
+	{
+		SSL_library_init() ;
+		SSL_load_error_strings() ;
+
+		s_pCTX = SSL_CTX_new(SSLv23_client_method()) ;
+		if (!s_pCTX)
+			{ cout << "hzload: Could not create TLS context\n" ; return 103 ; }
+
+		//	Writes may be partial and the output buffer may move (and grow) between attempts
+		SSL_CTX_set_verify(s_pCTX, SSL_VERIFY_NONE, 0) ;
+		SSL_CTX_set_mode(s_pCTX, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER) ;
+
+		//	Sessions are kept per connection rather than in the context, so each connection resumes its own
+		if (s_bResume)
+		{
+			SSL_CTX_set_session_cache_mode(s_pCTX, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE) ;
+			SSL_CTX_sess_set_new_cb(s_pCTX, _newSession) ;
+		}
+	}
+
+	//	Set up the script for the protocol
+	switch	(s_eProto)
+	{
+	case LOAD_HTTP:
+		if (!nPort)	nPort = 18080 ;
+		if (bClose)	{ s_nPerConn = 1 ; s_nPipeline = 1 ; }
+		s_pRequest = (char*) malloc(strlen(path) + strlen(host) + strlen(hdr) + 128) ;
+		sprintf(s_pRequest, "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: hzload\r\n%s%s%s\r\n", path, host, hdr, *hdr ? "\r\n" : "", bClose ? "Connection: close\r\n" : "") ;
+		s_Script.m_pSteps = s_stepsHTTP ;
+		s_Script.m_nSteps = 1 ;
+		s_Script.m_nLoop = s_Script.m_nQuit = 0 ;
+		break ;
+
+	case LOAD_SMTP:
+		if (!nPort)	nPort = 18025 ;
+		if (bClose)	s_nPerConn = 1 ;
+		s_pMessage = (char*) malloc(s_nMsgSize + 128) ;
+		nLen = sprintf(s_pMessage, "Subject: hzload\r\n\r\n") ;
+		for (n = 0 ; n < s_nMsgSize ; n++)
+			s_pMessage[nLen++] = (n % 66) == 64 ? '\r' : (n % 66) == 65 ? '\n' : 'a' + (n % 26) ;
+		strcpy(s_pMessage + nLen, "\r\n.\r\n") ;
+		s_Script.m_pSteps = s_stepsSMTP ;
+		s_Script.m_nSteps = 7 ;
+		s_Script.m_nLoop = 2 ;
+		s_Script.m_nQuit = 6 ;
+		break ;
+
+	case LOAD_POP3:
+		if (!nPort)	nPort = 18110 ;
+		if (bClose)	s_nPerConn = 1 ;
+		s_Script.m_pSteps = s_stepsPOP3 ;
+		s_Script.m_nSteps = 7 ;
+		s_Script.m_nLoop = 3 ;
+		s_Script.m_nQuit = 6 ;
+		break ;
+	}
+	s_Addr.sin_port = htons(nPort) ;
+
+	//	For SMTP and POP3, -per counts transactions. Convert to replies, as counted by the connection, including the greeting and the login.
+	if (s_eProto != LOAD_HTTP && s_nPerConn)
+		s_nPerConn = s_Script.m_nLoop + (s_nPerConn * (s_Script.m_nQuit - s_Script.m_nLoop)) ;
+
+	printf("hzload: %s %s:%u, %u threads, %u connections, %u secs (warmup %u)",
+		s_eProto == LOAD_HTTP ? "HTTP" : s_eProto == LOAD_SMTP ? "SMTP" : "POP3", host, nPort, s_nThreads, s_nConns, s_nSecs, s_nWarmup) ;
+	if (bTls)
+		printf(", TLS%s", s_bResume ? " with resumption" : "") ;
+	if (s_bStall)
+		printf(", stalled") ;
+	else if (s_eProto == LOAD_HTTP)
+		printf(", pipeline %u%s", s_nPipeline, bClose ? ", close" : "") ;
+	printf("\n") ;
+
+	//	Start the threads, dividing the connections between them
+	pThreads = new LoadThread[s_nThreads] ;
+	memset(pThreads, 0, s_nThreads * sizeof(LoadThread)) ;
+	for (n = 0 ; n < s_nThreads ; n++)
+	{
+		pThreads[n].m_nConns = (s_nConns / s_nThreads) + (n < (s_nConns % s_nThreads) ? 1 : 0) ;
+		pthread_create(&pThreads[n].m_Tid, 0, _loadThread, pThreads + n) ;
+	}
+
+	sleep(s_nWarmup) ;
+	__atomic_store_n(&s_bRecord, true, __ATOMIC_RELAXED) ;
+	nsBegin = _nsNow() ;
+
+	for (nSec = 1, nLast = 0 ; nSec <= s_nSecs ; nSec++)
+	{
+		sleep(1) ;
+		if (bProgress)
+		{
+			for (nNow = n = 0 ; n < s_nThreads ; n++)
+				nNow += __atomic_load_n(&pThreads[n].m_nRequests, __ATOMIC_RELAXED) ;
+			printf("  %3us: %lu req/s\n", nSec, (unsigned long) (nNow - nLast)) ;
+			nLast = nNow ;
+		}
+	}
+
+	__atomic_store_n(&s_bRecord, false, __ATOMIC_RELAXED) ;
+	nsEnd = _nsNow() ;
+	__atomic_store_n(&s_bStop, true, __ATOMIC_RELAXED) ;
+
+	//	Merge the results of the threads
+	memset(&total, 0, sizeof(total)) ;
+	for (n = 0 ; n < s_nThreads ; n++)
+	{
+		pthread_join(pThreads[n].m_Tid, 0) ;
+
+		total.m_Req.Merge(pThreads[n].m_Req) ;
+		total.m_Conn.Merge(pThreads[n].m_Conn) ;
+		total.m_nRequests += pThreads[n].m_nRequests ;
+		total.m_nBytesIn += pThreads[n].m_nBytesIn ;
+		total.m_nBytesOut += pThreads[n].m_nBytesOut ;
+		total.m_nConnects += pThreads[n].m_nConnects ;
+		total.m_nErrConnect += pThreads[n].m_nErrConnect ;
+		total.m_nErrTimeout += pThreads[n].m_nErrTimeout ;
+		total.m_nErrClosed += pThreads[n].m_nErrClosed ;
+		total.m_nRefused += pThreads[n].m_nRefused ;
+		total.m_nErrReply += pThreads[n].m_nErrReply ;
+		total.m_nReaped += pThreads[n].m_nReaped ;
+		total.m_nHandshakes += pThreads[n].m_nHandshakes ;
+		total.m_nResumed += pThreads[n].m_nResumed ;
+		for (nSec = 1 ; nSec < 6 ; nSec++)
+			total.m_nStatus[nSec] += pThreads[n].m_nStatus[nSec] ;
+	}
+
+	secs = (double) (nsEnd - nsBegin) / 1000000000.0 ;
+
+	printf("Requests:    %lu in %.2f secs = %.1f req/s\n", (unsigned long) total.m_nRequests, secs, total.m_nRequests / secs) ;
+	printf("Transfer:    in %.2f MB/s, out %.2f MB/s\n", total.m_nBytesIn / secs / 1048576.0, total.m_nBytesOut / secs / 1048576.0) ;
+	printf("Connections: %lu made (%.1f/s), %lu refused\n", (unsigned long) total.m_nConnects, total.m_nConnects / secs, (unsigned long) total.m_nRefused) ;
+	printf("Errors:      connect %lu, timeout %lu, closed %lu, reply %lu\n",
+		(unsigned long) total.m_nErrConnect, (unsigned long) total.m_nErrTimeout, (unsigned long) total.m_nErrClosed, (unsigned long) total.m_nErrReply) ;
+	if (bTls)
+		printf("TLS:         %lu handshakes, %lu resumed\n", (unsigned long) total.m_nHandshakes, (unsigned long) total.m_nResumed) ;
+	if (s_bStall)
+		printf("Stalled:     %lu closed by the server, %lu outlived the timeout\n", (unsigned long) total.m_nReaped, (unsigned long) total.m_nErrTimeout) ;
+	else if (s_eProto == LOAD_HTTP)
+		printf("Status:      1xx %lu, 2xx %lu, 3xx %lu, 4xx %lu, 5xx %lu\n", (unsigned long) total.m_nStatus[1], (unsigned long) total.m_nStatus[2],
+			(unsigned long) total.m_nStatus[3], (unsigned long) total.m_nStatus[4], (unsigned long) total.m_nStatus[5]) ;
+
+	printf("Latency (usec)      mean       p50       p90       p99     p99.9       max\n") ;
+	if (total.m_Req.m_nCount)
+		printf("  Request   %10.1f%10.1f%10.1f%10.1f%10.1f%10.1f\n", _usec(total.m_Req.m_nSum / total.m_Req.m_nCount), _usec(total.m_Req.Quantile(0.5)),
+			_usec(total.m_Req.Quantile(0.9)), _usec(total.m_Req.Quantile(0.99)), _usec(total.m_Req.Quantile(0.999)), _usec(total.m_Req.m_nMax)) ;
+	if (total.m_Conn.m_nCount)
+		printf("  %-8s  %10.1f%10.1f%10.1f%10.1f%10.1f%10.1f\n", s_bStall ? "Reaped" : "Connect",
+			_usec(total.m_Conn.m_nSum / total.m_Conn.m_nCount), _usec(total.m_Conn.Quantile(0.5)),
+			_usec(total.m_Conn.Quantile(0.9)), _usec(total.m_Conn.Quantile(0.99)), _usec(total.m_Conn.Quantile(0.999)), _usec(total.m_Conn.m_nMax)) ;
+
+	if (tag)
+	{
+		printf("csv,tag,proto,threads,conns,pipeline,secs,requests,rps,p50_us,p90_us,p99_us,p999_us,max_us,errors\n") ;
+		printf("csv,%s,%s,%u,%u,%u,%.2f,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%lu\n", tag,
+			s_eProto == LOAD_HTTP ? "http" : s_eProto == LOAD_SMTP ? "smtp" : "pop3", s_nThreads, s_nConns, s_nPipeline, secs,
+			(unsigned long) total.m_nRequests, total.m_nRequests / secs, _usec(total.m_Req.Quantile(0.5)), _usec(total.m_Req.Quantile(0.9)),
+			_usec(total.m_Req.Quantile(0.99)), _usec(total.m_Req.Quantile(0.999)), _usec(total.m_Req.m_nMax),
+			(unsigned long) (total.m_nErrConnect + total.m_nErrTimeout + total.m_nErrClosed + total.m_nErrReply)) ;
+	}
+
+	delete [] pThreads ;
+	if (s_pCTX)
+		SSL_CTX_free(s_pCTX) ;
+
+	if (!strcmp(expect, "refused"))
+		return !total.m_nRequests && total.m_nRefused ? 0 : 1 ;
+	if (!strcmp(expect, "limited"))
+		return total.m_nRequests && total.m_nRefused ? 0 : 1 ;
+	if (!strcmp(expect, "reaped"))
+		return total.m_nReaped && !total.m_nErrTimeout ? 0 : 1 ;
+	if (!strcmp(expect, "resumed"))
+		return total.m_nRequests && total.m_nResumed ? 0 : 1 ;
+	if (!strcmp(expect, "full"))
+		return total.m_nRequests && total.m_nHandshakes && !total.m_nResumed ? 0 : 1 ;
+	return total.m_nRequests ? 0 : 1 ;
+}
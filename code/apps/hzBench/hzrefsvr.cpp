@@ -0,0 +1,432 @@
+//
+//	File:	hzrefsvr.cpp
+//
+//	Desc:	Reference server for benchmarking. Serves HTTP, SMTP and POP3 on local ports with fixed responses so that hzload can measure the serving regime of
+//			hzIpServer (epoll single threaded, epoll multithreaded or io_uring) rather than the cost of any application.
+//
+//	Legal Notice: This file is part of the HadronZoo::Bench programs which in turn depend on the HadronZoo C++ Class Library with which they are shipped.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	HadronZoo::Bench is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free
+//	Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is also free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	HadronZoo::Bench is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//	FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License along with HadronZoo::Bench. If not, see http://www.gnu.org/licenses.
+//
+
+#include <iostream>
+#include <fstream>
+
+using namespace std ;
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "hzBasedefs.h"
+#include "hzChars.h"
+#include "hzChain.h"
+#include "hzProcess.h"
+#include "hzMimetype.h"
+#include "hzUrl.h"
+#include "hzIpServer.h"
+#include "hzHttpServer.h"
+#include "hzHttpProxy.h"
+#include "hzMetrics.h"
+
+/*
+**	Variables
+*/
+
+bool	_hzGlobal_XM = false ;			//	Using/not using operator new/delete override
+bool	_hzGlobal_MT = true ;			//	Program is multi-threaded
+
+global	hzProcess	proc ;				//	hzProcess instance (all Hadronzoo based applications require this)
+global	hzLogger	slog ;				//	Server log
+
+global	hzIpServer*	theServer ;			//	HadronZoo server regime
+
+static	hzChain		s_HttpBody ;		//	Body of every HTTP response
+static	hzChain		s_Pop3Msg ;			//	Message returned by POP3 RETR
+static	uint32_t	s_nPop3Msgs = 10 ;	//	Number of messages in the POP3 mailbox
+
+/*
+**	Session state for the line based protocols
+*/
+
+enum	RefState
+{
+	REF_COMMAND,		//	Expecting a command
+	REF_DATA			//	Expecting message data (SMTP, after DATA)
+} ;
+
+class	RefSession	: public hzIpConnInfo
+{
+	//	Session of an SMTP or POP3 client
+
+public:
+	RefState	m_eState ;		//	Session state
+
+	RefSession	(void)	{ m_eState = REF_COMMAND ; }
+	~RefSession	(void)	{}
+} ;
+
+/*
+**	Functions
+*/
+
+void*	ThreadServeRequests	(void* pVoid)
+{
+	hzProcess	_procA ;
+
+	theServer->ServeRequests() ;
+
+	pthread_exit(pVoid) ;
+	return pVoid ;
+}
+
+void*	ThreadServeResponses	(void* pVoid)
+{
+	hzProcess	_procB ;
+
+	theServer->ServeResponses() ;
+
+	pthread_exit(pVoid) ;
+	return pVoid ;
+}
+
+hzTcpCode	RefHTTP	(hzHttpEvent* pE)
+{
+	//	Respond to any HTTP request with the fixed body
+	//
+	//	Arguments:	1)	pE	The HTTP event
+	//
+	//	Returns:	TCP_KEEPALIVE	Unless the client has asked for the connection to close
+	//				TCP_TERMINATE	If it has
+
+	pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_PLAIN, s_HttpBody, 0, false) ;
+	return pE->Connection() ? TCP_KEEPALIVE : TCP_TERMINATE ;
+}
+
+static	hzTcpCode	_lines	(hzChain& Input, hzIpConnex* pCC, bool (*fnLine)(hzChain&, RefSession*, const char*))
+{
+	//	Pass each complete line of input to the protocol's line function, collecting the replies into a single write. Any incomplete line is retained for the
+	//	next read. Clients may send several commands at once (SMTP pipelining), so a read may contain any number of lines.
+	//
+	//	Arguments:	1)	Input	The input chain of the connection
+	//				2)	pCC		The connection
+	//				3)	fnLine	The line function. This appends any reply to the chain and returns false if the session is to end.
+	//
+	//	Returns:	TCP_INCOMPLETE	If there is no complete line
+	//				TCP_TERMINATE	If the client has quit
+	//				TCP_KEEPALIVE	Otherwise
+
+	chIter			zi ;			//	Input iterator
+	hzChain			R ;				//	Replies
+	hzChain			Rest ;			//	Incomplete line
+	RefSession*		pInfo ;			//	Session
+	uint32_t		nPosn ;			//	Position in input
+	uint32_t		nDone ;			//	Bytes of input consumed
+	uint32_t		nLen ;			//	Length of line
+	bool			bLive = true ;	//	False once the client has quit
+	char			line[1024] ;	//	Line buffer
+
+	pInfo = (RefSession*) pCC->GetInfo() ;
+
+	for (zi = Input, nPosn = nDone = nLen = 0 ; bLive && !zi.eof() ; zi++, nPosn++)
+	{
+		if (*zi == CHAR_NL)
+		{
+			if (nLen && line[nLen-1] == CHAR_CR)
+				nLen-- ;
+			line[nLen] = 0 ;
+			bLive = fnLine(R, pInfo, line) ;
+			nLen = 0 ;
+			nDone = nPosn + 1 ;
+			continue ;
+		}
+
+		if (nLen < 1023)
+			line[nLen++] = *zi ;
+	}
+
+	if (!nDone)
+		return TCP_INCOMPLETE ;
+
+	if (nDone < Input.Size())
+		Rest.AppendSub(Input, nDone, Input.Size() - nDone) ;
+	Input.Clear() ;
+	if (Rest.Size())
+		Input << Rest ;
+
+	if (R.Size())
+		pCC->SendData(R) ;
+	return bLive ? TCP_KEEPALIVE : TCP_TERMINATE ;
+}
+
+static	bool	_smtpLine	(hzChain& R, RefSession* pInfo, const char* line)
+{
+	//	Reply to an SMTP command or data line. All commands are accepted and the message is discarded.
+
+	if (pInfo->m_eState == REF_DATA)
+	{
+		if (line[0] == CHAR_PERIOD && !line[1])
+		{
+			pInfo->m_eState = REF_COMMAND ;
+			R << "250 2.0.0 Message accepted\r\n" ;
+		}
+		return true ;
+	}
+
+	if (!strncasecmp(line, "EHLO", 4))	{ R << "250-hzrefsvr\r\n250-PIPELINING\r\n250-SIZE 4000000\r\n250 8BITMIME\r\n" ; return true ; }
+	if (!strncasecmp(line, "HELO", 4))	{ R << "250 hzrefsvr\r\n" ; return true ; }
+	if (!strncasecmp(line, "MAIL", 4))	{ R << "250 2.1.0 Sender OK\r\n" ; return true ; }
+	if (!strncasecmp(line, "RCPT", 4))	{ R << "250 2.1.5 Recipient OK\r\n" ; return true ; }
+	if (!strncasecmp(line, "DATA", 4))	{ R << "354 Enter message, ending with \".\" on a line by itself\r\n" ; pInfo->m_eState = REF_DATA ; return true ; }
+	if (!strncasecmp(line, "RSET", 4))	{ R << "250 2.0.0 OK\r\n" ; return true ; }
+	if (!strncasecmp(line, "NOOP", 4))	{ R << "250 2.0.0 OK\r\n" ; return true ; }
+	if (!strncasecmp(line, "QUIT", 4))	{ R << "221 2.0.0 Bye\r\n" ; return false ; }
+
+	R << "500 5.5.1 Command unrecognized\r\n" ;
+	return true ;
+}
+
+static	bool	_pop3Line	(hzChain& R, RefSession* pInfo, const char* line)
+{
+	//	Reply to a POP3 command. Any user and password are accepted and the mailbox always holds the same messages.
+
+	uint32_t	n ;		//	Message iterator
+
+	if (!strncasecmp(line, "USER", 4))	{ R << "+OK\r\n" ; return true ; }
+	if (!strncasecmp(line, "PASS", 4))	{ R << "+OK Logged in\r\n" ; return true ; }
+	if (!strncasecmp(line, "STAT", 4))	{ R.Printf("+OK %u %u\r\n", s_nPop3Msgs, s_nPop3Msgs * s_Pop3Msg.Size()) ; return true ; }
+	if (!strncasecmp(line, "NOOP", 4))	{ R << "+OK\r\n" ; return true ; }
+	if (!strncasecmp(line, "RSET", 4))	{ R << "+OK\r\n" ; return true ; }
+	if (!strncasecmp(line, "DELE", 4))	{ R << "+OK Marked\r\n" ; return true ; }
+	if (!strncasecmp(line, "QUIT", 4))	{ R << "+OK Bye\r\n" ; return false ; }
+
+	if (!strncasecmp(line, "LIST", 4))
+	{
+		R.Printf("+OK %u messages\r\n", s_nPop3Msgs) ;
+		for (n = 1 ; n <= s_nPop3Msgs ; n++)
+			R.Printf("%u %u\r\n", n, s_Pop3Msg.Size()) ;
+		R << ".\r\n" ;
+		return true ;
+	}
+
+	if (!strncasecmp(line, "RETR", 4))
+	{
+		R.Printf("+OK %u octets\r\n", s_Pop3Msg.Size()) ;
+		R << s_Pop3Msg ;
+		R << ".\r\n" ;
+		return true ;
+	}
+
+	R << "-ERR Unknown command\r\n" ;
+	return true ;
+}
+
+hzTcpCode	HelloSMTP	(hzIpConnex* pCC)
+{
+	hzChain		Z ;		//	Server hello
+
+	pCC->SetInfo(new RefSession()) ;
+	Z << "220 hzrefsvr ESMTP ready\r\n" ;
+	pCC->SendData(Z) ;
+	return TCP_KEEPALIVE ;
+}
+
+hzTcpCode	HelloPOP3	(hzIpConnex* pCC)
+{
+	hzChain		Z ;		//	Server hello
+
+	pCC->SetInfo(new RefSession()) ;
+	Z << "+OK hzrefsvr POP3 ready\r\n" ;
+	pCC->SendData(Z) ;
+	return TCP_KEEPALIVE ;
+}
+
+hzTcpCode	RefSMTP	(hzChain& Input, hzIpConnex* pCC)	{ return _lines(Input, pCC, _smtpLine) ; }
+hzTcpCode	RefPOP3	(hzChain& Input, hzIpConnex* pCC)	{ return _lines(Input, pCC, _pop3Line) ; }
+
+static	void	_fill	(hzChain& Z, uint32_t nSize, bool bLines)
+{
+	//	Fill a chain with nSize bytes of printable text, broken into lines of 64 characters ending CRLF if bLines is set
+
+	uint32_t	n ;		//	Byte iterator
+
+	for (n = 0 ; n < nSize ; n++)
+	{
+		if (bLines && (n % 66) == 64)		Z.AddByte(CHAR_CR) ;
+		else if (bLines && (n % 66) == 65)	Z.AddByte(CHAR_NL) ;
+		else
+			Z.AddByte('a' + (n % 26)) ;
+	}
+
+	if (bLines)
+		Z << "\r\n" ;
+}
+
+int		main	(int argc, char ** argv)
+{
+	_hzfunc("hzrefsvr::main") ;
+
+	pthread_t		tid ;					//	Thread id
+	const char*		mode = "st" ;			//	Serving regime
+	const char*		logfile = "hzrefsvr.log" ;	//	Log file
+	const char*		block = 0 ;				//	Address to blocklist
+	const char*		cert = 0 ;				//	TLS certificate file (PEM)
+	const char*		key = 0 ;				//	TLS private key file (PEM)
+	hzIpaddr		ipa ;					//	Blocklisted address
+	uint32_t		nPortHTTP = 18080 ;		//	HTTP port
+	uint32_t		nPortHTTPS = 0 ;		//	HTTPS port (0 for none)
+	uint32_t		nPortSMTP = 18025 ;		//	SMTP port
+	uint32_t		nPortPOP3 = 18110 ;		//	POP3 port
+	uint32_t		nPortMetrics = 0 ;		//	Metrics port (0 for none)
+	uint32_t		nPortProxy = 0 ;		//	Reverse proxy port (0 for none)
+	uint32_t		nPortUp = 18080 ;		//	Upstream HTTP port of the reverse proxy
+	uint32_t		nSize = 128 ;			//	Size of HTTP response body
+	uint32_t		nThreads = 2 ;			//	Request threads (MT mode)
+	uint32_t		nMaxConns = 1000 ;		//	Max connections per port
+	uint32_t		nPerIP = 0 ;			//	Connections per second allowed from an address (0 for no limit)
+	uint32_t		nTlsSecs = 0 ;			//	TLS handshake time limit (0 for the hzIpServer default)
+	uint32_t		nSessCache = HZ_TLS_SESS_CACHE ;	//	TLS sessions held in the session cache (0 for no cache)
+	uint32_t		nTicketSecs = HZ_TLS_TICKET_SECS ;	//	TLS session ticket key rotation interval (0 for no tickets)
+	uint32_t		n ;						//	Thread iterator
+	int32_t			nArg ;					//	Argument iterator
+	hzHttpProxy*	pProxy ;				//	Reverse proxy
+	hzUpstreamPool*	pPool ;					//	Upstream pool of the reverse proxy
+	hzEcode			rc ;					//	Return code
+
+	signal(SIGINT,	CatchCtrlC) ;
+	signal(SIGTERM,	CatchCtrlC) ;
+	signal(SIGSEGV,	CatchSegVio) ;
+	signal(SIGPIPE,	SIG_IGN) ;
+
+	for (nArg = 1 ; nArg < argc ; nArg++)
+	{
+		if		(!strcmp(argv[nArg], "-mode") && nArg+1 < argc)	mode = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-http") && nArg+1 < argc)	nPortHTTP = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-smtp") && nArg+1 < argc)	nPortSMTP = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-pop3") && nArg+1 < argc)	nPortPOP3 = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-metrics") && nArg+1 < argc)	nPortMetrics = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-proxy") && nArg+1 < argc)	nPortProxy = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-upstream") && nArg+1 < argc)	nPortUp = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-size") && nArg+1 < argc)	nSize = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-threads") && nArg+1 < argc)	nThreads = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-conns") && nArg+1 < argc)	nMaxConns = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-log") && nArg+1 < argc)	logfile = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-block") && nArg+1 < argc)	block = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-perip") && nArg+1 < argc)	nPerIP = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-https") && nArg+1 < argc)	nPortHTTPS = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-cert") && nArg+1 < argc)	cert = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-key") && nArg+1 < argc)	key = argv[++nArg] ;
+		else if (!strcmp(argv[nArg], "-tlstimeout") && nArg+1 < argc)	nTlsSecs = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-sesscache") && nArg+1 < argc)	nSessCache = atoi(argv[++nArg]) ;
+		else if (!strcmp(argv[nArg], "-tickets") && nArg+1 < argc)	nTicketSecs = atoi(argv[++nArg]) ;
+		else
+		{
+			cout << "Usage: hzrefsvr [-mode st|mt|uring] [-http port] [-smtp port] [-pop3 port] [-metrics port] [-size bytes] [-threads n] [-conns n] [-log file]\n"
+					"                [-proxy port] [-upstream port] [-block addr] [-perip rate] [-https port -cert file -key file] [-tlstimeout secs]\n"
+					"                [-sesscache n] [-tickets secs]\n"
+					"       A port of 0 disables the protocol. Defaults: -mode st -http 18080 -smtp 18025 -pop3 18110 -size 128 -threads 2 -conns 1000\n"
+					"       -proxy relays HTTP requests on the port to 127.0.0.1 at the upstream port (default 18080). Run it as a proxy-only front process\n"
+					"       (-mode mt -http 0 -smtp 0 -pop3 0 -proxy 18081) in front of a second hzrefsvr. The request and the start of the response\n"
+					"       are relayed on a request thread, while the remainder of a large response is polled for by the serving loop.\n"
+					"       -block blocklists the address (not 127.0.0.1, which is never blocked) and -perip limits the connections per second each\n"
+					"       address may make to the HTTP port. Both apply as connections are accepted, see hzload -bind and -expect.\n"
+					"       -https serves HTTP over TLS on the port with the given certificate and key. -tlstimeout sets the time limit for clients to\n"
+					"       complete the TLS handshake (see hzload -stall). -sesscache sets the number of TLS sessions cached for resumption by\n"
+					"       session ID and -tickets the interval at which the session ticket key is replaced. 0 disables either (see hzload -resume).\n" ;
+			return 101 ;
+		}
+	}
+
+	if (strcmp(mode, "st") && strcmp(mode, "mt") && strcmp(mode, "uring"))
+		{ cout << "hzrefsvr: Unknown mode " << mode << " (use st, mt or uring)\n" ; return 102 ; }
+	if (nPortHTTPS && (!cert || !key))
+		{ cout << "hzrefsvr: -https requires -cert and -key\n" ; return 102 ; }
+
+	rc = slog.OpenFile(logfile, LOGROTATE_NEVER) ;
+	if (rc != E_OK)
+		{ cout << "hzrefsvr: logfile [" << logfile << "] could not be opened\n" ; return 103 ; }
+	slog.Verbose(false) ;
+
+	HadronZooInitMimes() ;
+	_fill(s_HttpBody, nSize, false) ;
+	_fill(s_Pop3Msg, 1024, true) ;
+
+	theServer = hzIpServer::GetInstance(&slog) ;
+	if (!theServer)
+		Fatal("%s. No server\n", *_fn) ;
+
+	if (nPortHTTP && theServer->AddPortHTTP(&RefHTTP, 30, nPortHTTP, nMaxConns, false) != E_OK)
+		Fatal("%s. Could not add HTTP port %d\n", *_fn, nPortHTTP) ;
+	if (nPortHTTPS)
+	{
+		//	The certificate serves as its own CA as clients are not verified
+		SetServerSSLResume(nSessCache, 0, nTicketSecs) ;
+		if (InitServerSSL(key, cert, cert, false) != E_OK)
+			Fatal("%s. Could not initialize TLS with certificate %s and key %s\n", *_fn, cert, key) ;
+		if (nTlsSecs)
+			theServer->SetTlsTimeout(nTlsSecs) ;
+		if (theServer->AddPortHTTP(&RefHTTP, 30, nPortHTTPS, nMaxConns, true) != E_OK)
+			Fatal("%s. Could not add HTTPS port %d\n", *_fn, nPortHTTPS) ;
+	}
+	if (nPortSMTP && theServer->AddPortTCP(&RefSMTP, &HelloSMTP, 0, 30, nPortSMTP, nMaxConns, false) != E_OK)
+		Fatal("%s. Could not add SMTP port %d\n", *_fn, nPortSMTP) ;
+	if (nPortPOP3 && theServer->AddPortTCP(&RefPOP3, &HelloPOP3, 0, 30, nPortPOP3, nMaxConns, false) != E_OK)
+		Fatal("%s. Could not add POP3 port %d\n", *_fn, nPortPOP3) ;
+	if (nPerIP && nPortHTTP && theServer->SetRateLimit(nPortHTTP, HZ_RATE_IPCONN, nPerIP, nPerIP) != E_OK)
+		Fatal("%s. Could not limit connections per address on port %d\n", *_fn, nPortHTTP) ;
+	if (block)
+	{
+		if (ipa.SetValue(block) != E_OK)
+			Fatal("%s. Invalid address to block %s\n", *_fn, block) ;
+		SetStatusIP(ipa, HZ_IPSTATUS_BLACK_PROT, 0) ;
+	}
+	if (nPortMetrics && theServer->AddPortMetrics(nPortMetrics) != E_OK)
+		Fatal("%s. Could not add metrics port %d\n", *_fn, nPortMetrics) ;
+
+	if (nPortProxy)
+	{
+		pProxy = hzHttpProxy::GetInstance() ;
+		pPool = pProxy->AddPool("upstream") ;
+		if (!pPool || pPool->AddServer("127.0.0.1", nPortUp) != E_OK || pProxy->AddRoute("", "", "upstream") != E_OK)
+			Fatal("%s. Could not set up proxy to port %d\n", *_fn, nPortUp) ;
+		if (theServer->AddPortHTTP(&ProxyHTTP, 30, nPortProxy, nMaxConns, false) != E_OK)
+			Fatal("%s. Could not add proxy port %d\n", *_fn, nPortProxy) ;
+	}
+
+	if (theServer->Activate() != E_OK)
+		{ cout << "hzrefsvr: Server could not activate\n" ; return 104 ; }
+
+	cout << "hzrefsvr: mode " << mode << " HTTP " << nPortHTTP << " SMTP " << nPortSMTP << " POP3 " << nPortPOP3 << " body " << nSize << " bytes" ;
+	if (nPortHTTPS)
+		cout << " HTTPS " << nPortHTTPS ;
+	if (nPortProxy)
+		cout << " proxy " << nPortProxy << " to " << nPortUp ;
+	cout << "\n" ;
+
+	if (!strcmp(mode, "uring"))
+		theServer->ServeUring() ;
+	else if (!strcmp(mode, "mt"))
+	{
+		for (n = 0 ; n < nThreads ; n++)
+			pthread_create(&tid, 0, &ThreadServeRequests, 0) ;
+		pthread_create(&tid, 0, &ThreadServeResponses, 0) ;
+		theServer->ServeEpollMT() ;
+	}
+	else
+		theServer->ServeEpollST() ;
+
+	slog.Out("hzrefsvr shutdown\n") ;
+	return 0 ;
+}
@@ -0,0 +1,228 @@
+//
+//	File:	hzArena.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzArena_h
+#define hzArena_h
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hzBasedefs.h"
+
+/*
+**	Prototypes
+*/
+
+void	Fatal	(const char* va_alist ...) ;
+
+/*
+**	Definitions
+*/
+
+#define HZ_ARENA_BLKSIZE	16384	//	Size of an arena block (including the block header). Larger allocations are made individually.
+
+/*
+**	The arena
+*/
+
+class	hzArena
+{
+	//	Category:	Memory
+	//
+	//	Bump allocator for memory that all has the same lifetime, such as that of a HTTP request. Allocations are carved in turn from blocks of HZ_ARENA_BLKSIZE
+	//	bytes and are never freed individually. Instead Reset() frees everything at once by rewinding to the first block. The blocks are kept, so once an arena
+	//	has grown to suit the work it is put to, allocation involves no call to the heap. An allocation too large for a block is made separately and released
+	//	by Reset(), so Reset() is O(1) unless oversize allocations were made.
+	//
+	//	Memory from an arena is aligned to 8 bytes and is not initialized. Objects placed in it must not require destruction. An arena is not thread safe and
+	//	is intended to be private to an object which is only in use by one thread at a time.
+
+	struct	_ablk
+	{
+		//	Block header. Allocations follow the header.
+
+		_ablk*		next ;		//	Next block
+		uint32_t	m_nSize ;	//	Size of block including header
+		uint32_t	m_nResv ;	//	Reserved
+	} ;
+
+	_ablk*		m_pFirst ;		//	First block
+	_ablk*		m_pCurr ;		//	Block being carved
+	_ablk*		m_pOver ;		//	Oversize allocations
+	char*		m_pCarve ;		//	Next free byte in current block
+	char*		m_pLimit ;		//	End of current block
+	uint32_t	m_nBlocks ;		//	Number of blocks held
+	uint32_t	m_nOver ;		//	Number of oversize allocations held
+
+	//	Prevent copies
+	hzArena		(const hzArena&) ;
+	hzArena&	operator=	(const hzArena&) ;
+
+	static	uint32_t	_hdrsize	(void)	{ return (sizeof(_ablk) + 7) & ~7 ; }
+
+	void*	_more	(uint32_t nSize)
+	{
+		//	Satisfy an allocation the current block cannot. Move to the next block (adding one if there are no more) or if the allocation would not fit in any
+		//	block, make it separately.
+		//
+		//	Arguments:	1)	nSize	Size required (already rounded up to a multiple of 8)
+		//
+		//	Returns:	Pointer to the allocated memory
+
+		_ablk*	pBlk ;	//	Block
+
+		if (nSize > HZ_ARENA_BLKSIZE - _hdrsize())
+		{
+			pBlk = (_ablk*) malloc(_hdrsize() + nSize) ;
+			if (!pBlk)
+				Fatal("hzArena::_more. Could not allocate %u bytes\n", nSize) ;
+			pBlk->m_nSize = _hdrsize() + nSize ;
+			pBlk->next = m_pOver ;
+			m_pOver = pBlk ;
+			m_nOver++ ;
+			_hzGlobal_Memstats.m_numArenaOver++ ;
+			return (char*) pBlk + _hdrsize() ;
+		}
+
+		if (m_pCurr && m_pCurr->next)
+			pBlk = m_pCurr->next ;
+		else
+		{
+			pBlk = (_ablk*) malloc(HZ_ARENA_BLKSIZE) ;
+			if (!pBlk)
+				Fatal("hzArena::_more. Could not allocate block\n") ;
+			pBlk->m_nSize = HZ_ARENA_BLKSIZE ;
+			pBlk->next = 0 ;
+
+			if (m_pCurr)
+				m_pCurr->next = pBlk ;
+			else
+				m_pFirst = pBlk ;
+			m_nBlocks++ ;
+			_hzGlobal_Memstats.m_numArenaBlks++ ;
+		}
+
+		m_pCurr = pBlk ;
+		m_pCarve = (char*) pBlk + _hdrsize() + nSize ;
+		m_pLimit = (char*) pBlk + pBlk->m_nSize ;
+		return (char*) pBlk + _hdrsize() ;
+	}
+
+	void	_freeOver	(void)
+	{
+		//	Free the oversize allocations
+
+		_ablk*	pBlk ;	//	Allocation
+
+		for (; m_pOver ; m_pOver = pBlk)
+		{
+			pBlk = m_pOver->next ;
+			free(m_pOver) ;
+			_hzGlobal_Memstats.m_numArenaOver-- ;
+		}
+		m_nOver = 0 ;
+	}
+
+public:
+	hzArena	(void)
+	{
+		m_pFirst = m_pCurr = m_pOver = 0 ;
+		m_pCarve = m_pLimit = 0 ;
+		m_nBlocks = m_nOver = 0 ;
+	}
+
+	~hzArena	(void)	{ Free() ; }
+
+	void*	Alloc	(uint32_t nSize)
+	{
+		//	Allocate memory from the arena
+		//
+		//	Arguments:	1)	nSize	Number of bytes required
+		//
+		//	Returns:	Pointer to the allocated memory (8 byte aligned)
+
+		char*	pMem ;	//	Allocated memory
+
+		nSize = (nSize + 7) & ~7 ;
+		_hzGlobal_Memstats.m_numArenaAllocs++ ;
+
+		if (m_pCarve + nSize > m_pLimit)
+			return _more(nSize) ;
+
+		pMem = m_pCarve ;
+		m_pCarve += nSize ;
+		return pMem ;
+	}
+
+	char*	Strdup	(const char* cpStr, uint32_t nLen)
+	{
+		//	Copy a string of known length into the arena and null terminate it
+		//
+		//	Arguments:	1)	cpStr	The string
+		//				2)	nLen	Number of bytes to copy
+		//
+		//	Returns:	Pointer to the copy
+
+		char*	pCopy ;	//	Copy
+
+		pCopy = (char*) Alloc(nLen + 1) ;
+		memcpy(pCopy, cpStr, nLen) ;
+		pCopy[nLen] = 0 ;
+		return pCopy ;
+	}
+
+	void	Reset	(void)
+	{
+		//	Release all allocations. The blocks are retained for reuse.
+
+		if (m_pOver)
+			_freeOver() ;
+
+		m_pCurr = m_pFirst ;
+		if (m_pFirst)
+		{
+			m_pCarve = (char*) m_pFirst + _hdrsize() ;
+			m_pLimit = (char*) m_pFirst + m_pFirst->m_nSize ;
+		}
+	}
+
+	void	Free	(void)
+	{
+		//	Release all allocations and return the blocks to the heap
+
+		_ablk*	pBlk ;	//	Block
+
+		_freeOver() ;
+
+		for (; m_pFirst ; m_pFirst = pBlk)
+		{
+			pBlk = m_pFirst->next ;
+			free(m_pFirst) ;
+			_hzGlobal_Memstats.m_numArenaBlks-- ;
+		}
+
+		m_pCurr = 0 ;
+		m_pCarve = m_pLimit = 0 ;
+		m_nBlocks = 0 ;
+	}
+
+	//	Diagnostics
+	uint32_t	Blocks	(void) const	{ return m_nBlocks ; }
+	uint32_t	Oversize	(void) const	{ return m_nOver ; }
+} ;
+
+#endif	//	hzArena_h
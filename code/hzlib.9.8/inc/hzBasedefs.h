@@ -117,8 +117,8 @@ class	hzSysID
 public:
 	hzSysID	(void)	{ m_Value = 0 ; }
 
-	hzSysID&	operator=	(const hzSysID& op)		{ m_Value = op.m_Value ; }
-	hzSysID&	operator=	(uint64_t val)			{ m_Value = val ; }
+	hzSysID&	operator=	(const hzSysID& op)		{ m_Value = op.m_Value ; return *this ; }
+	hzSysID&	operator=	(uint64_t val)			{ m_Value = val ; return *this ; }
 
 	bool	operator==	(const hzSysID& op) const	{ return m_Value == op.m_Value ? true:false ; }
 	bool	operator<	(const hzSysID& op) const	{ return m_Value < op.m_Value ? true:false ; }
@@ -218,6 +218,10 @@ public:
 	uint32_t	m_ramStrOver ;			//	Total memory allocated to oversized hzStrings
 	uint32_t	m_numStrings ;			//	Number of hzString instances
 
+	//	Operator new/delete calls (whether or not overridden)
+	uint32_t	m_numNew ;				//	Number of calls to operator new
+	uint32_t	m_numDelete ;			//	Number of calls to operator delete
+
 	//	Operator new/delete override
 	uint32_t	m_numMemblkA ;			//	Number of type A memblk instances in RAM (for size A 16 byte objects)
 	uint32_t	m_numMemblkB ;			//	Number of type B memblk instances in RAM (for size B 24 byte objects)
@@ -235,9 +239,12 @@ public:
 	uint32_t	m_numListDC ;			//	Number of hzList instances with data area
 	uint32_t	m_numQues ;				//	Number of hzQue instances
 	uint32_t	m_numStacks ;			//	Number of hzStack instances
+	uint32_t	m_numNodeSlabs ;		//	Number of node slabs held by hzList, hzQue and hzStack node pools
 	uint32_t	m_numSmaps ;			//	Number of hzMapS instances
 	uint32_t	m_numMmaps ;			//	Number of hzMapM instances
 	uint32_t	m_numSpmaps ;			//	Number of hzLookup instances
+	uint32_t	m_numCmaps ;			//	Number of lock-striped (hzMapSC, hzMapMC and hzSetC) instances
+	uint32_t	m_numHmaps ;			//	Number of hzHashMap instances
 	uint32_t	m_numSets ;				//	Number of hzSet instances
 	uint32_t	m_numVectors ;			//	Number of hzVect instances
 	uint32_t	m_numBitmaps ;			//	Number of hzBitmap instances
@@ -247,6 +254,13 @@ public:
 	uint32_t	m_numDocxml ;			//	Number of hzDocXml instances
 	uint32_t	m_numBincron ;			//	Number of hdbBinCron instances
 	uint32_t	m_numBinstore ;			//	Number of hdbBinStore instances
+
+	//	Arenas and pooled HTTP events
+	uint32_t	m_numArenaBlks ;		//	Number of hzArena blocks
+	uint32_t	m_numArenaOver ;		//	Number of hzArena oversize allocations outstanding
+	uint32_t	m_numArenaAllocs ;		//	Number of allocations made from arenas
+	uint32_t	m_numHttpEvents ;		//	Number of hzHttpEvent instances
+	uint32_t	m_numHttpEvPool ;		//	Number of hzHttpEvent instances held in pools
 } ;
 
 /*
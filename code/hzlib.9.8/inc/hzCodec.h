@@ -33,6 +33,23 @@ enum	hzCoding
 	ENCODING_INVALID		//	Invalid encoding
 } ;
 
+enum	hzContentCoding
+{
+	//	Category:	Codec
+	//
+	//	Content codings, as named in the HTTP Accept-Encoding and Content-Encoding headers. Where a client accepts several codings equally, the later in
+	//	this list is preferred.
+
+	CONTENT_IDENTITY,		//	No coding
+	CONTENT_GZIP,			//	gzip (zlib deflate with gzip wrapper)
+	CONTENT_ZSTD,			//	zstd (Zstandard, only if the library is built with HZ_ZSTD)
+	CONTENT_BROTLI,			//	br (Brotli, only if the library is built with HZ_BROTLI)
+	CONTENT_CODINGS			//	Number of content codings (also returned for an unknown coding)
+} ;
+
+//	Encoder or decoder of a content coding. The first argument is the output chain, which is cleared at the outset. The second is the input.
+typedef	hzEcode	(*hzCoderFn)(hzChain& output, const hzChain& input) ;
+
 class	hzMD5
 {
 	//	Category:	Codec
@@ -78,11 +95,33 @@ hzEcode		Base64Decode	(hzChain& Decoded, hzChain& Raw) ;
 hzEcode		QPDecode		(hzChain& Decoded, hzChain& Raw) ;
 
 /*
-**	Section 3:	Zipping & un-zipping (using system call to gzip/gunzip)
+**	Section 3:	Compression (gzip, Brotli and Zstandard)
 */
 
 hzEcode		Gzip	(hzChain& compressed, const hzChain& orig) ;
 hzEcode		Gunzip	(hzChain& orig, const hzChain& compressed) ;
 hzEcode		Punzip	(hzChain& orig, const hzChain& compressed) ;
 
+#if defined(HZ_BROTLI)
+hzEcode		Brotli		(hzChain& compressed, const hzChain& orig) ;
+hzEcode		Unbrotli	(hzChain& orig, const hzChain& compressed) ;
+#endif
+
+#if defined(HZ_ZSTD)
+hzEcode		Zstd	(hzChain& compressed, const hzChain& orig) ;
+hzEcode		Unzstd	(hzChain& orig, const hzChain& compressed) ;
+#endif
+
+/*
+**	Section 4:	Content codings
+*/
+
+hzEcode			SetContentCoder		(hzContentCoding eCoding, hzCoderFn fnEncode, hzCoderFn fnDecode) ;
+bool			ContentCodingOK		(hzContentCoding eCoding) ;
+const char*		ContentCodingName	(hzContentCoding eCoding) ;
+hzContentCoding	ContentCodingId		(const char* pName, uint32_t nLen) ;
+hzEcode			ContentEncode		(hzChain& output, const hzChain& input, hzContentCoding eCoding) ;
+hzEcode			ContentDecode		(hzChain& output, const hzChain& input, hzContentCoding eCoding) ;
+uint32_t		ContentEncodeAll	(hzChain* pCoded, const hzChain& input) ;
+
 #endif	//	hzCodec_h
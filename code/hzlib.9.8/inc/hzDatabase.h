@@ -34,6 +34,7 @@
 #include "hzTmplVect.h"
 #include "hzTmplMapS.h"
 #include "hzTmplMapM.h"
+#include "hzTmplMapH.h"
 #include "hzProcess.h"
 
 /*
@@ -151,9 +152,9 @@ class	hdbADP
 	hzMapS	<hzString,hdbObjRepos*>			m_mapRepositories ;		//	All declared data repositories
 	hzMapS	<hzString,hdbBinRepos*>			m_mapBinRepos ;			//	All hdbBinRepos instances
 
-	hzMapS	<uint16_t,const hdbClass*>		m_mapClsCtxDtId ;		//	Map of data class delta ids to data classes
+	hzHashMap	<uint16_t,const hdbClass*>	m_mapClsCtxDtId ;		//	Map of data class delta ids to data classes
 	hzMapS	<hzString,uint16_t>				m_mapClsCtxName ;		//	Map of classname and classname.membername (if of a data class), to data class delta ids
-	hzMapS	<uint16_t,const hdbMember*>		m_mapMembers ;			//	Map of member IDs to members (all classes)
+	hzHashMap	<uint16_t,const hdbMember*>	m_mapMembers ;			//	Map of member IDs to members (all classes)
 
 	hzArray	<hdbObjRepos*>		m_arrRepositories ;		//	Repositories by Delta id
 
@@ -1530,9 +1531,19 @@ class	hdbIndexUkey : public hdbIndex
 		hzMapS	<uint32_t,uint32_t>*	pSu ;	//	32-bit index
 	} ;
 
-	_ptrset		m_keys ;		//	The key
-	hdbBasetype	m_eBasetype ;	//	The type
-	bool		m_bInit ;		//	Init state
+	_ptrset				m_keys ;		//	The key
+	hzArray<uint64_t>	m_LoadKeys ;	//	Keys deferred while loading (see LoadStart)
+	hzArray<uint32_t>	m_LoadIds ;		//	Object ids deferred while loading
+	hdbBasetype			m_eBasetype ;	//	The type
+	bool				m_bInit ;		//	Init state
+	bool				m_bLoad ;		//	Inserts are deferred to LoadDone()
+
+	bool	_wide	(void) const
+	{
+		//	True if the keys are 64-bit (held in m_keys.pLu), false if 32-bit (held in m_keys.pSu)
+
+		return m_eBasetype == BASETYPE_DOUBLE || m_eBasetype == BASETYPE_XDATE || m_eBasetype == BASETYPE_INT64 || m_eBasetype == BASETYPE_UINT64 ;
+	}
 
 public:
 	hdbIndexUkey		(void)
@@ -1540,6 +1551,7 @@ public:
 		m_keys.pStr = 0 ;
 		m_eBasetype = BASETYPE_UNDEF ;
 		m_bInit = false ;
+		m_bLoad = false ;
 	}
 
 	~hdbIndexUkey	(void)
@@ -1553,6 +1565,10 @@ public:
 	hzEcode	Delete	(const hzAtom& A) ;
 	hzEcode	Select	(uint32_t& objId, const hzAtom& key) ;
 
+	//	Loading (see hdbObjCache::Open)
+	void	LoadStart	(void)	{ m_bLoad = true ; }
+	hzEcode	LoadDone	(void) ;
+
 	hdbBasetype	Basetype	(void)	{ return m_eBasetype ; }
 	hdbIdxtype	Whatami		(void)	{ return HZINDEX_UKEY ; }
 } ;
@@ -1571,6 +1587,7 @@ public:
 	hzEcode	Init	(const hzString& name, const hzString& opdir, const hzString& backup, uint32_t cacheMode) ;
 	hzEcode	Halt	(void) ;
 	hzEcode	Insert	(const hzString& Word, uint32_t docId) ;
+	hzEcode	Insert	(const hzArray<hzString>& Words, const hzArray<uint32_t>& docIds) ;
 	hzEcode	Delete	(const hzString& Word, uint32_t docId) ;
 	hzEcode	Clear	(void) ;
 	hzEcode	Select	(hdbIdset& Result, const hzString& Word) ;
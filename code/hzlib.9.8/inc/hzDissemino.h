@@ -25,6 +25,7 @@
 #include "hzTmplList.h"
 #include "hzTmplSet.h"
 #include "hzTmplMapL.h"
+#include "hzTmplMapC.h"
 #include "hzCodec.h"
 #include "hzDate.h"
 #include "hzStrRepos.h"
@@ -215,7 +216,7 @@ public:
 	hzMapS	<hdsUSL,hzString> 	m_zipItems ;		//	Fixed (non active) HTML from pages, articles and blocks (zipped)
 
 	hzMapS	<hzString,hzString>	m_rawScripts ;		//	Scripts
-	hzMapS	<hzString,hzString>	m_zipScripts ;		//	Scripts zipped
+	hzMapS	<hzString,hzString>	m_zipScripts[CONTENT_CODINGS] ;		//	Scripts in each content coding (by hzContentCoding)
 
 	hzString	m_code ;	//	Language code
 	hzString	m_flag ;	//	URL of the flag image
@@ -742,9 +743,13 @@ public:
 	hzChain		m_rawValue ;	//	The Raw content, unzipped
 	hzChain		m_zipValue ;	//	The zipped content
 	hzString	m_filepath ;	//	Filename (relative to document root)
+	hzString	m_ETag ;		//	Entity tag (for conditional requests)
+	uint32_t	m_nMtime ;		//	Modification time of file (for conditional requests)
 	hzMimetype	m_Mimetype ;	//	File MIME type
 
-	hdsFile		(void)	{ m_Mimetype = HMTYPE_TXT_HTML ; }
+	hdsFile		(void)	{ m_Mimetype = HMTYPE_TXT_HTML ; m_nMtime = 0 ; }
+
+	void		SetValidators	(const char* cpPath) ;
 
 	const char*	TxtURL	(void)	{ return *m_Url ; }
 	hdsRtype	Whatami	(void)	{ return DS_RES_FILE ; }
@@ -1717,6 +1722,7 @@ class	hdsApp
 	//	Scripts
 	hzEcode		MakeNavbarJS		(hzChain& Z, hdsLang* pLang, uint32_t access) ;
 	hzEcode		MakeNavtreeJS		(hzChain& Z, uint32_t access) ;
+	uint32_t	_zipScript			(hdsLang* pLang, const hzString& name, const hzChain& Z) ;
 
 	//	Misc Print Functions
 	void	_doHead		(hzChain& Z, const char* cpPage) ;
@@ -1765,13 +1771,13 @@ public:
 	hzMapS	<hzString,hdsResource*>	m_ResourcesName ;		//	All known pages by name
 
 	hzLookup<hzString>				m_rawScripts ;			//	Scripts
-	hzLookup<hzString>				m_zipScripts ;			//	Scripts zipped
+	hzLookup<hzString>				m_zipScripts[CONTENT_CODINGS] ;	//	Scripts in each content coding (by hzContentCoding)
 	hzLookup<uint32_t>				m_UserAgents ;			//	Collection of all encountered user agents
 
 	hzMapS	<hzString,hdsPage*>		m_Responses ;			//	All known form response and error pages by name
-	hzMapS	<hzSysID,hdsInfo*>		m_SessCookie ;			//	Session cookies by id
+	hzMapSC	<hzSysID,hdsInfo*>		m_SessCookie ;			//	Session cookies by id (lock-striped as consulted on every request)
 	hzMapS	<hzString,hdbBasetype>	m_tmpVarsSess ;			//	Temp map for percent entity validation
-	hzMapS	<hzIpaddr,hdsProfile*>	m_Visitors ;			//	IP addresses of clients
+	hzMapSC	<hzIpaddr,hdsProfile*>	m_Visitors ;			//	IP addresses of clients (lock-striped as consulted on every request)
 	hzSet	<hzString>				m_Links ;				//	All links to other pages
 	hzSet	<hzString>				m_Styles ;				//	All CSS classes
 	hzList	<hzPair>				m_Passives ;			//	List of passive file directives
@@ -1793,13 +1799,13 @@ public:
 	hdsPage*		m_MasterPage ;			//	Admin page 
 	hdsLang*		m_pDfltLang ;			//	Default language
 	hzChain			m_txtCSS ;				//	The stylesheet content (unzipped)
-	hzChain			m_zipCSS ;				//	The stylesheet content (zipped)
-	hzChain			m_zipSitemapTxt ;		//	The sitemap.txt (zipped)
-	hzChain			m_zipSitemapXml ;		//	The sitemap.xml (zipped)
+	hzChain			m_zipCSS[CONTENT_CODINGS] ;			//	The stylesheet content in each content coding (by hzContentCoding)
+	hzChain			m_zipSitemapTxt[CONTENT_CODINGS] ;	//	The sitemap.txt in each content coding
+	hzChain			m_zipSitemapXml[CONTENT_CODINGS] ;	//	The sitemap.xml in each content coding
 	hzChain			m_rawSitemapTxt ;		//	The sitemap.txt (unzipped)
 	hzChain			m_rawSitemapXml ;		//	The sitemap.xml (unzipped)
 	hzChain			m_rawSiteguide ;		//	The siteguide.txt (zipped)
-	hzChain			m_zipSiteguide ;		//	The siteguide.xml (zipped)
+	hzChain			m_zipSiteguide[CONTENT_CODINGS] ;	//	The siteguide.xml in each content coding
 	hzChain			m_cfgErr ;				//	Written to by config read functions associated with key resources
 	hzDomain		m_Domain ;				//	The URL base string (eg www.mydomain.com)
 	hzString		m_BaseDir ;				//	The base dir
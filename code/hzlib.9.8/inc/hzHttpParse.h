@@ -0,0 +1,88 @@
+//
+//	File:	hzHttpParse.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzHttpParse_h
+#define hzHttpParse_h
+
+#include "hzBasedefs.h"
+#include "hzChain.h"
+
+//	Synopsis:	HTTP Header Scanning
+//
+//	These are the primitives by which hzHttpEvent::ProcessEvent parses HTTP request headers. The header is located by HttpHeaderEnd(), which searches the
+//	blocks of the input chain in place for the blank line ending the header, and is then parsed directly from the first block of the chain. Only where the
+//	header straddles blocks is it copied, once, to a contiguous buffer. Lines and the colon ending each header name are found by HttpScan(), which tests 16
+//	bytes at a time with SSE2 (32 with AVX2) where available.
+//
+//	Header names are resolved by HttpHeaderId(), which hashes the length and three characters of the name (case insensitively) into a table in which each of
+//	the known headers has a slot of its own, so a name is identified by a single probe and a single compare. Unknown names cost the same and are rejected.
+//	Headers are added to the table by adding to hzHttpHdr and to the list of names in hzHttpParse.cpp. Should a new name collide with an existing one, the
+//	table is not built and the first lookup is fatal, naming the two headers. The collision must be fixed by retuning the multipliers in _hdrhash.
+
+enum	hzHttpHdr
+{
+	//	Category:	Internet
+	//
+	//	HTTP request headers of interest to hzHttpEvent
+
+	HTTP_HDR_UNKNOWN,			//	Not a header of interest
+	HTTP_HDR_ACCEPT,			//	Accept
+	HTTP_HDR_ACCEPT_CHARSET,	//	Accept-Charset
+	HTTP_HDR_ACCEPT_LANGUAGE,	//	Accept-Language
+	HTTP_HDR_ACCEPT_ENCODING,	//	Accept-Encoding
+	HTTP_HDR_AUTHORIZATION,		//	Authorization
+	HTTP_HDR_CACHE_CONTROL,		//	Cache-Control
+	HTTP_HDR_CLIENT_IP,			//	Client-ip
+	HTTP_HDR_CONNECTION,		//	Connection
+	HTTP_HDR_CONTENT_LENGTH,	//	Content-Length
+	HTTP_HDR_CONTENT_TYPE,		//	Content-Type
+	HTTP_HDR_COOKIE,			//	Cookie
+	HTTP_HDR_FROM,				//	From
+	HTTP_HDR_HOST,				//	Host
+	HTTP_HDR_IF_MODIFIED_SINCE,	//	If-Modified-Since
+	HTTP_HDR_IF_NONE_MATCH,		//	If-None-Match
+	HTTP_HDR_IF_RANGE,			//	If-Range
+	HTTP_HDR_KEEP_ALIVE,		//	Keep-Alive
+	HTTP_HDR_MAX_FORWARDS,		//	Max-Forwards
+	HTTP_HDR_PRAGMA,			//	Pragma
+	HTTP_HDR_RANGE,				//	Range
+	HTTP_HDR_REFERER,			//	Referer
+	HTTP_HDR_SEC_WEBSOCKET_KEY,			//	Sec-WebSocket-Key
+	HTTP_HDR_SEC_WEBSOCKET_PROTOCOL,	//	Sec-WebSocket-Protocol
+	HTTP_HDR_SEC_WEBSOCKET_VERSION,		//	Sec-WebSocket-Version
+	HTTP_HDR_TRANSFER_ENCODING,	//	Transfer-Encoding
+	HTTP_HDR_UA_CPU,			//	UA-CPU
+	HTTP_HDR_UPGRADE,			//	Upgrade
+	HTTP_HDR_USER_AGENT,		//	User-Agent
+	HTTP_HDR_VIA,				//	Via
+	HTTP_HDR_X_FORWARDED_FOR,	//	X-Forwarded-For
+	HTTP_HDR_X_FORWARDED_HOST,	//	X-Forwarded-Host
+	HTTP_HDR_X_FORWARDED_SERVER,	//	X-Forwarded-Server
+	HTTP_HDR_X_PROXYUSER_IP,	//	X-ProxyUser-IP
+	HTTP_HDR_COUNT				//	Number of header ids
+} ;
+
+/*
+**	Prototypes
+*/
+
+const char*	HttpScan		(const char* pStr, const char* pEnd, char c) ;
+uint32_t	HttpHeaderEnd	(const hzChain& Z, uint32_t nMax) ;
+hzHttpHdr	HttpHeaderId	(const char* pName, uint32_t nLen) ;
+const char*	HttpHeaderName	(hzHttpHdr eHdr) ;
+
+#endif	//	hzHttpParse_h
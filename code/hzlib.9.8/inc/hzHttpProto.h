@@ -53,9 +53,13 @@ enum	HttpRC
 
 	HTTPMSG_NULL					= 0,	//	Initial unset value for variables of this type. Not a valid HTTP response code.
 
+	//	Informational
+	HTTPMSG_SWITCHING_PROTOCOLS		= 101,	//	Connection upgraded (to a WebSocket)
+
 	//	Request is granted
 	HTTPMSG_OK						= 200,	//	OK - No error
 	HTTPMSG_NOCONTENT				= 204,	//	OK - No error
+	HTTPMSG_PARTIAL_CONTENT			= 206,	//	OK - Part(s) of the resource as requested by a Range header
 
 	//	Request is OK but no page supplied because ...
 	HTTPMSG_REDIRECT_PERM			= 301,	//	Server is redirecting to another page (permanent redirect)
@@ -76,6 +80,8 @@ enum	HttpRC
 	HTTPMSG_ENTITY_TOO_LARGE		= 413,	//	ErrorDocument 413 /error/HTTP_REQUEST_ENTITY_TOO_LARGE.html.var
 	HTTPMSG_REQUEST_URI_TOO_LARGE	= 414,	//	ErrorDocument 414 /error/HTTP_REQUEST_URI_TOO_LARGE.html.var
 	HTTPMSG_UNSUPPORTED_MEDIA_TYPE	= 415,	//	ErrorDocument 415 /error/HTTP_UNSUPPORTED_MEDIA_TYPE.html.var
+	HTTPMSG_RANGE_NOT_SATISFIABLE	= 416,	//	None of the ranges requested lie within the resource
+	HTTPMSG_UPGRADE_REQUIRED		= 426,	//	WebSocket version not supported (Sec-WebSocket-Version states those that are)
 
 	//	System Errors. Can't help you regardless of how reasonable the request!
 	HTTPMSG_INTERNAL_SERVER_ERROR	= 500,	//	ErrorDocument 500 /error/HTTP_INTERNAL_SERVER_ERROR.html.var
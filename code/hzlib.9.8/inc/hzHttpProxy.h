@@ -0,0 +1,202 @@
+//
+//	File:	hzHttpProxy.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzHttpProxy_h
+#define hzHttpProxy_h
+
+#include "hzBasedefs.h"
+#include "hzChain.h"
+#include "hzLock.h"
+#include "hzTmplVect.h"
+#include "hzTcpClient.h"
+#include "hzHttpServer.h"
+
+//	Synopsis:	Reverse Proxy
+//
+//	hzHttpProxy allows a single front process to spread HTTP requests over a number of upstream servers, typically further instances of Dissemino (or any
+//	other HTTP server) running as worker processes on the same machine. Requests are routed by hostname and/or URL prefix to a pool of upstream servers
+//	(hzUpstreamPool), and within the pool to one server, either in turn (round robin) or to the one with the fewest requests in progress.
+//
+//	Connections to the upstream servers are persistent. Once a response has been relayed in full, the connection is kept for the next request routed to the
+//	same server, so an upstream server is not connected to for each request. A connection found to have been closed by the upstream server while idle is
+//	discarded and replaced.
+//
+//	Upstream servers found not to be responding are taken out of service. This happens when HZ_PROXY_FAILS requests in a row cannot be relayed to it, or
+//	as many health checks in a row fail. If health checks are running (see hzHttpProxy::StartChecks), a server is only returned to service by a successful
+//	check, otherwise it is retried after HZ_PROXY_RETRY seconds.
+//
+//	The request header is relayed as received except for headers pertaining to the connection (Connection, Keep-Alive etc), to which X-Forwarded-For,
+//	X-Forwarded-Host and X-Forwarded-Proto are added. A chunked request body is relayed with a Content-Length. A multipart form submission cannot be
+//	relayed as it is parsed and spilled to disk as it arrives, and is refused. The response header is likewise relayed with the connection headers of the
+//	front server. Where it is not more than HZ_PROXY_BUFFER bytes, the response body is read in full before it is relayed. Beyond that the remainder is
+//	relayed as the client takes it (as a hzOutSource), so a large download to a slow client does not exhaust memory. The upstream socket is then non-blocking
+//	and is polled by the serving loop while it has nothing to hand, so a slow upstream server does not hold up the output of other connections.
+//
+//	Note that the sending of the request and the reading of the response up to HZ_PROXY_BUFFER blocks the thread doing it. The proxy is intended for servers
+//	running ServeEpollMT, where requests are handled by a pool of request threads. Under ServeEpollST, a slow upstream server holds up all connections until
+//	the response starts to be relayed.
+
+#define HZ_PROXY_IDLE		8		//	Idle connections kept per upstream server
+#define HZ_PROXY_HDRMAX		16384	//	Maximum size of an upstream response header
+#define HZ_PROXY_BUFFER		262144	//	Response body read before relaying starts. Only the remainder of a larger body is relayed as the client takes it.
+#define HZ_PROXY_TIMEOUT	30		//	Default timeout of upstream sends and receives (seconds)
+#define HZ_PROXY_FAILS		3		//	Successive failures after which an upstream server is taken out of service
+#define HZ_PROXY_RETRY		10		//	Seconds after which a server out of service is retried (where there are no health checks)
+
+enum	hzBalance
+{
+	//	Category:	Internet
+	//
+	//	Choice of upstream server within a pool
+
+	HZ_BALANCE_ROUNDROBIN,		//	Servers are used in turn
+	HZ_BALANCE_LEASTCONN		//	The server with the fewest requests in progress is used
+} ;
+
+class	hzUpstream
+{
+	//	Category:	Internet
+	//
+	//	An upstream server of a hzUpstreamPool, with its idle persistent connections
+
+	hzLockS			m_Lock ;					//	Lock on idle connections
+	hzTcpClient*	m_Idle[HZ_PROXY_IDLE] ;		//	Idle connections
+	hzString		m_Host ;					//	Hostname or IP address
+	uint32_t		m_nPort ;					//	Port
+	uint32_t		m_nTimeout ;				//	Send and receive timeout (seconds)
+	uint32_t		m_nIdle ;					//	Number of idle connections
+	uint32_t		m_nActive ;					//	Requests in progress
+	uint32_t		m_nFails ;					//	Successive failures
+	uint32_t		m_nDownAt ;					//	Time taken out of service (0 if in service)
+
+	//	Prevent copies
+	hzUpstream	(const hzUpstream&) ;
+	hzUpstream&	operator=	(const hzUpstream&) ;
+
+public:
+	uint64_t	m_nRequests ;		//	Requests relayed
+	uint64_t	m_nErrors ;			//	Requests that could not be relayed
+	uint64_t	m_nConnects ;		//	Connections made
+
+	hzUpstream	(const hzString& host, uint32_t nPort, uint32_t nTimeout) ;
+	~hzUpstream	(void) ;
+
+	hzTcpClient*	Take	(bool& bReused) ;
+	void			Give	(hzTcpClient* pConn, bool bReuse) ;
+
+	void	Failed		(bool bChecking) ;
+	void	Succeeded	(void) ;
+	bool	Check		(const hzString& host, const hzString& path) ;
+
+	bool	Available	(bool bChecking) const ;
+
+	const hzString&	Host	(void) const	{ return m_Host ; }
+	uint32_t		Port	(void) const	{ return m_nPort ; }
+	uint32_t		Active	(void) const	{ return m_nActive ; }
+	uint32_t		Idle	(void) const	{ return m_nIdle ; }
+	bool			IsDown	(void) const	{ return m_nDownAt ? true : false ; }
+} ;
+
+class	hzUpstreamPool
+{
+	//	Category:	Internet
+	//
+	//	A set of interchangeable upstream servers, to which requests are routed by a hzHttpProxy
+
+	hzVect<hzUpstream*>	m_Servers ;		//	The upstream servers
+	hzString	m_Name ;				//	Pool name
+	uint32_t	m_nNext ;				//	Round robin counter
+	uint32_t	m_nTimeout ;			//	Timeout applied to upstream connections (seconds)
+	hzBalance	m_eMode ;				//	Balancing mode
+
+	//	Prevent copies
+	hzUpstreamPool	(const hzUpstreamPool&) ;
+	hzUpstreamPool&	operator=	(const hzUpstreamPool&) ;
+
+public:
+	hzUpstreamPool	(const hzString& name, hzBalance eMode, uint32_t nTimeout) ;
+	~hzUpstreamPool	(void) ;
+
+	hzEcode		AddServer	(const hzString& host, uint32_t nPort) ;
+	hzUpstream*	Select		(bool bChecking) ;
+
+	hzUpstream*		Server	(uint32_t nIndex) const	{ return nIndex < m_Servers.Count() ? m_Servers[nIndex] : 0 ; }
+	uint32_t		Count	(void) const	{ return m_Servers.Count() ; }
+	const hzString&	Name	(void) const	{ return m_Name ; }
+	hzBalance		Mode	(void) const	{ return m_eMode ; }
+} ;
+
+class	hzHttpProxy
+{
+	//	Category:	Internet
+	//
+	//	Reverse proxy routing HTTP requests to pools of upstream servers (see synopsis above). There is one instance per process, obtained by GetInstance().
+	//	Routes and pools must all be set up before the server is activated as they are not protected by locks.
+
+	struct	_route
+	{
+		//	Route from hostname and/or URL prefix to pool
+
+		hzString		m_Host ;	//	Hostname (any if blank)
+		hzString		m_Prefix ;	//	URL prefix (any if blank)
+		hzUpstreamPool*	m_pPool ;	//	Pool
+
+		_route	(void)	{ m_pPool = 0 ; }
+	} ;
+
+	hzVect<_route*>			m_Routes ;		//	Routes in order of precedence
+	hzVect<hzUpstreamPool*>	m_Pools ;		//	All pools
+	hzString	m_CheckHost ;				//	Hostname given in health checks (the upstream server if blank)
+	hzString	m_CheckPath ;				//	Resource requested by health checks
+	uint32_t	m_nInterval ;				//	Seconds between health checks (0 if not running)
+
+	hzHttpProxy	(void) ;
+
+	//	Prevent copies
+	hzHttpProxy	(const hzHttpProxy&) ;
+	hzHttpProxy&	operator=	(const hzHttpProxy&) ;
+
+	hzEcode		_upstream	(bool& bClose, hzHttpEvent* pE, hzUpstream* pUp, const hzChain& Req, const hzChain& Body) ;
+
+	static	void*	_checker	(void* pVoid) ;
+
+public:
+	static	hzHttpProxy*	GetInstance	(void) ;
+
+	~hzHttpProxy	(void) ;
+
+	//	Setup
+	hzUpstreamPool*	AddPool		(const hzString& name, hzBalance eMode = HZ_BALANCE_ROUNDROBIN, uint32_t nTimeout = HZ_PROXY_TIMEOUT) ;
+	hzUpstreamPool*	GetPool		(const hzString& name) const ;
+	hzEcode			AddRoute	(const hzString& host, const hzString& prefix, const hzString& poolName) ;
+	hzEcode			StartChecks	(const hzString& host, const hzString& path, uint32_t nInterval) ;
+
+	//	Operation
+	hzUpstreamPool*	Route	(hzHttpEvent* pE) const ;
+	hzTcpCode		Relay	(hzHttpEvent* pE, hzUpstreamPool* pPool) ;
+	void			Report	(hzChain& Z) const ;
+
+	uint32_t	Routes	(void) const	{ return m_Routes.Count() ; }
+} ;
+
+/*
+**	Prototypes
+*/
+
+hzTcpCode	ProxyHTTP	(hzHttpEvent* pE) ;
+
+#endif	//	hzHttpProxy_h
@@ -29,13 +29,24 @@
 
 #include "hzMimetype.h"
 #include "hzChain.h"
+#include "hzArena.h"
 #include "hzTmplArray.h"
 #include "hzTmplMapS.h"
 #include "hzIpServer.h"
 #include "hzHttpProto.h"
+#include "hzCodec.h"
+#include "hzWebSocket.h"
 
 #define	HZ_MAX_HTTP_HDR		8192	//	Note this is much smaller than that specified by Apache for example. There is no good reason for excessive proprietary
 									//	lines in the HTTP header and use of data submissions are discouraged under Dissemino guidlines.
+#define	HZ_HTTP_KEEPALIVE	15		//	Seconds a persistent connection is kept open (advertised by the Keep-Alive response header)
+#define	HZ_UPLOAD_CHUNK		16384	//	Multipart submissions are parsed in pieces of this size as they arrive (also the limit on the headers of a part)
+#define	HZ_UPLOAD_SPILL		65536	//	Default size above which an uploaded file is written to a temporary file rather than held in memory
+#define	HZ_MAX_HTTP_BODY	0x1000000	//	Largest request body held in memory, by Content-Length or chunked (multipart submissions are exempt as uploads spill)
+#define	HZ_HTTP_CHUNKED		0xffffffff	//	Content length given to _formhead for a response of unknown length, sent in chunks
+#define	HZ_HTTP_STREAM		16384	//	Content built up by a streaming generator is sent as a chunk once it reaches this size
+#define	HZ_HTTP_MAXRANGES	16		//	Requests for more byte ranges than this are answered with the whole resource
+#define	HZ_HTTP_EVPOOL		256		//	Maximum number of free hzHttpEvent instances retained by each serving thread (see hzHttpEvent::Acquire)
 
 class	hzHttpSession
 {
@@ -52,17 +63,22 @@ class	hzHttpFile
 {
 	//	Category:	Internet
 	//
-	//	Support class for hzHttpEvent to handle file uploads
+	//	Support class for hzHttpEvent to handle file uploads. A file no larger than the spill threshold (see hzHttpEvent::SetUploads) is held in m_file but
+	//	a larger file is written to a temporary file as it arrives, leaving m_file empty. Either way the content is obtained by Content() or moved to where
+	//	the application wants it by SaveAs(). Temporary files are deleted when the hzHttpEvent is cleared, i.e. once the request has been handled.
 
 public:
-	hzChain		m_file ;		//	The file itself
+	hzChain		m_file ;		//	The file itself (if held in memory)
+	hzString	m_path ;		//	Temporary file (if spilled to disk)
 	hzString	m_fldname ;		//	Name of field
 	hzString	m_filename ;	//	Name of uploaded file
+	uint32_t	m_nSize ;		//	Size of file
 	int32_t		m_resv ;		//	Reserved
 	hzMimetype	m_mime ;		//	MIME type of content
 
 	hzHttpFile	(void)
 	{
+		m_nSize = 0 ;
 		m_resv = 0 ;
 		m_mime = HMTYPE_INVALID ;
 	}
@@ -70,12 +86,31 @@ public:
 	hzHttpFile&	operator=	(const hzHttpFile& op)
 	{
 		m_file = op.m_file ;
+		m_path = op.m_path ;
 		m_fldname = op.m_fldname ;
 		m_filename = op.m_filename ;
+		m_nSize = op.m_nSize ;
 		m_resv = op.m_resv ;
 		m_mime = op.m_mime ;
 		return *this ;
 	}
+
+	void	Clear	(void)
+	{
+		m_file.Clear() ;
+		m_path.Clear() ;
+		m_fldname.Clear() ;
+		m_filename.Clear() ;
+		m_nSize = 0 ;
+		m_resv = 0 ;
+		m_mime = HMTYPE_INVALID ;
+	}
+
+	uint32_t	Size	(void) const	{ return m_nSize ; }
+	bool		OnDisk	(void) const	{ return m_path.Length() ? true : false ; }
+
+	hzEcode		Content	(hzChain& Z) const ;
+	hzEcode		SaveAs	(const hzString& path) ;
 } ;
 
 class	hzHttpEvent
@@ -86,12 +121,18 @@ class	hzHttpEvent
 	//	and populates a hzHttpEvent instance which initially contains data supplied in the incoming request. Each time this occurs, the hzHttpEvent is
 	//	passed to a user defined 'callback' function which processes it and generates a response. This process may add further data to the hzHttpEvent
 	//	which is used to formulate the header for the outgoing HTTP response.
+	//
+	//	A hzHttpEvent is only attached to a connection while a request is being received and handled. Instances are pooled by each serving thread (see Acquire
+	//	and Release), and the header values and decoded form data of a request are held in a bump arena which Clear() resets in one step. So once the pool and
+	//	the arenas have reached their working size, the handling of a request involves few if any calls to the heap.
 
 	hzIpConnex*		m_pCx ;			//	Connection to TCP server
+	hzHttpEvent*	m_pPoolNext ;	//	Next free instance (while in the pool of a serving thread)
 	hzLogger*		m_pLog ;		//	Log channel (from connection)
 	hzHttpSession*	m_pSession ;	//	HTTP session (set by app)
 
-	char*		m_pBuf ;			//	Buffer for header values
+	hzArena		m_Arena ;			//	Memory of the current request (header values and decoded form data), released by Clear()
+	char*		m_pBuf ;			//	Buffer for header values (in the arena)
 	char*		m_pAccept ;			//	Accept mimetype eg text/plain
 	char*		m_pAcceptCharset ;	//	Accept character set
 	char*		m_pAcceptLang ;		//	Language e.g. US English
@@ -99,7 +140,9 @@ class	hzHttpEvent
 	char*		m_pCacheControl ;	//	Cache Control
 	char*		m_pConnection ;		//	Connection directive
 	char*		m_pContentType ;	//	Content Type
-	char*		m_pETag ;			//	Page ID checking
+	char*		m_pETag ;			//	Page ID checking (If-None-Match)
+	char*		m_pRange ;			//	Byte ranges requested (Range)
+	char*		m_pIfRange ;		//	Condition on byte ranges, an entity tag or a date (If-Range)
 	char*		m_pPragma ;			//	Misc command
 	char*		m_pUserAgent ;		//	Type of browser
 	char*		m_pProcessor ;		//	Type of processor on browser computer
@@ -114,7 +157,12 @@ class	hzHttpEvent
 	char*		m_pReferer ;		//	Email address of person making request (not sure why this is but hey what the heck)
 	char*		m_pReqPATH ;		//	Request path
 	char*		m_pReqFRAG ;		//	Request path fragment
+	char*		m_pUpgrade ;		//	Protocol requested by the Upgrade header
+	char*		m_pWsKey ;			//	WebSocket handshake key (Sec-WebSocket-Key)
+	char*		m_pWsVersion ;		//	WebSocket version (Sec-WebSocket-Version)
+	char*		m_pWsProtocol ;		//	WebSocket subprotocols offered (Sec-WebSocket-Protocol)
 	hzXDate		m_LastMod ;			//	If last modified directive
+	uint32_t	m_nIfModSince ;		//	If last modified directive (epoch time, 0 if none)
 	hzUrl		m_Referer ;			//	Refered from URL.
 	hzSysID		m_CookieSub ;		//	Cookie submitted by the browser
 	hzSysID		m_CookieNew ;		//	New cookie as set by server
@@ -134,10 +182,53 @@ class	hzHttpEvent
 	HttpMethod	m_eMethod ;			//	E.g. GET, HEAD or POST
 	bool		m_bHdrComplete ;	//	False if hit's header incomplete
 	bool		m_bMsgComplete ;	//	False if hit incomplete
-	bool		m_bZipped ;			//	True if Accept-Encoding contains 'gzip'
-
-	uint32_t	_setnvpairs		(hzChain::Iter& cIter) ;
-	hzEcode		_formhead		(hzChain& Z, HttpRC hrc, hzMimetype type, uint32_t nSize, uint32_t nExpires, bool bZip) ;
+	bool		m_bZipped ;			//	True if Accept-Encoding admits gzip
+	uint16_t	m_nCodings ;		//	Content codings acceptable to the client (bit n set for coding n)
+	hzContentCoding	m_eCoding ;		//	Content coding preferred by the client (of those with an encoder)
+
+	//	Multipart submissions (parsed as they arrive)
+	hzHttpFile	m_Part ;			//	Part being received
+	hzString	m_Boundary ;		//	Delimiter of parts (CR/NL, two minus signs and the boundary)
+	uint32_t	m_nConsumed ;		//	Bytes of the request parsed and removed from the input
+	uint32_t	m_nAwait ;			//	Input size at which the request can next be progressed (0 if only when complete)
+	int32_t		m_nPartFd ;			//	Temporary file of part being received (-1 if none)
+	uint16_t	m_nMpState ;		//	Parser state (0 if not a multipart submission)
+	bool		m_bPartFile ;		//	Part being received is a file
+
+	//	Chunked request bodies (decoded as they arrive) and chunked responses
+	hzChain		m_Body ;			//	Decoded body of a chunked request
+	hzChain		m_RawHead ;			//	Header of a chunked request (as it is removed from the input with the body, see RawRequest)
+	hzChain*	m_pStream ;			//	Chain of a streaming generator (see StreamInit)
+	uint32_t	m_nChunkLeft ;		//	Bytes of the current request chunk still to come
+	uint32_t	m_nChunksOut ;		//	Chunks sent in the response
+	uint32_t	m_nStreamExp ;		//	Expiry of streamed response
+	HttpRC		m_eStreamRC ;		//	HTTP return code of streamed response
+	hzMimetype	m_eStreamType ;		//	MIME type of streamed response
+	uint16_t	m_nChState ;		//	Chunked request parser state (0 if the request is not chunked)
+	bool		m_bChunkOut ;		//	Response is being sent in chunks
+	bool		m_bStreamZip ;		//	Streamed response content is zipped
+
+	//	Static resources (conditional and byte range responses, see _sendEntity)
+	hzString	m_ETagOut ;			//	Entity tag of resource (ETag)
+	hzString	m_RangeOut ;		//	Range of resource sent (Content-Range)
+	hzString	m_RangeSep ;		//	Boundary of parts of a multiple range response
+	uint32_t	m_nModOut ;			//	Modification time of resource (Last-Modified)
+
+	uint32_t	_setnvpairs		(hzChain::Iter& cIter, uint32_t nMax) ;
+	hzEcode		_feed			(uint32_t& nDone, const hzChain& Z, uint32_t nStart, uint32_t nAvail, hzEcode (hzHttpEvent::*fnParse)(uint32_t&, const char*, uint32_t)) ;
+	hzEcode		_dechunk		(hzChain& ZI) ;
+	hzEcode		_chparse		(uint32_t& nUsed, const char* pBuf, uint32_t nLen) ;
+	hzEcode		_multipart		(hzChain& ZI) ;
+	hzEcode		_mpparse		(uint32_t& nUsed, const char* pBuf, uint32_t nLen) ;
+	void		_partstart		(const char* pHdr, uint32_t nLen) ;
+	hzEcode		_partdata		(const char* pData, uint32_t nLen) ;
+	hzEcode		_partend		(void) ;
+	void		_acceptcode		(const char* pVal, uint32_t nLen) ;
+	hzEcode		_formhead		(hzChain& Z, HttpRC hrc, hzMimetype type, uint32_t nSize, uint32_t nExpires, hzContentCoding eCoding) ;
+	hzEcode		_formhead		(hzChain& Z, HttpRC hrc, hzMimetype type, uint32_t nSize, uint32_t nExpires, bool bZip)	{ return _formhead(Z, hrc, type, nSize, nExpires, bZip ? CONTENT_GZIP : CONTENT_IDENTITY) ; }
+	bool		_notmodified	(const hzString& etag, uint32_t nMtime) ;
+	bool		_ifrange		(const hzString& etag, uint32_t nMtime) ;
+	hzEcode		_sendEntity		(hzMimetype type, const hzChain* pData, const char* cpPath, uint32_t nSize, const hzString& etag, uint32_t nMtime, uint32_t nExpires, bool bZip) ;
 
 	//	Prevent copies
 	hzHttpEvent		(const hzHttpEvent&) ;
@@ -171,6 +262,16 @@ public:
 
 	void	Clear	(void) ;
 
+	//	Pooled instances (per serving thread)
+	static	hzHttpEvent*	Acquire	(hzIpConnex* pCx) ;
+	static	void			Release	(hzHttpEvent* pE) ;
+
+	//	Location of temporary files for uploads and the size above which uploads are written to them
+	static	hzEcode	SetUploads	(const hzString& tmpDir, uint32_t nSpill) ;
+
+	//	Entity tag of a static resource, from its inode, size and modification time
+	static	hzString	MakeETag	(uint64_t nInode, uint64_t nSize, uint32_t nMtime) ;
+
 	//	Simple Set Functions
 	void	SetLogger	(hzLogger* pLog)	{ m_pLog = pLog ; }
 	void	SetURI		(const char* cpURI)	{ m_Redirect = cpURI ; }
@@ -182,11 +283,17 @@ public:
 	uint32_t	EventNo		(void) const	{ return m_pCx ? m_pCx->EventNo() : 0 ; }
 	uint32_t	CliSocket	(void) const	{ return m_pCx ? m_pCx->CliSocket() : 0 ; }
 	uint32_t	HeaderLen	(void) const	{ return m_nHeaderLen ; }
-	uint32_t	ExpectSize	(void) const	{ return m_nHeaderLen + m_nContentLen ; }
+	uint32_t	ExpectSize	(void) const	{ return m_nHeaderLen + m_nContentLen - m_nConsumed ; }
+	uint32_t	AwaitSize	(void) const	{ return m_nAwait ? m_nAwait : ExpectSize() ; }
 	uint32_t	QueryLen	(void) const	{ return m_nQueryLen ; }
 	bool		HdrComplete	(void) const	{ return m_bHdrComplete ; }
 	bool		MsgComplete	(void) const	{ return m_bMsgComplete ; }
 	bool		Zipped		(void) const	{ return m_bZipped ; }
+	bool		Accepts		(hzContentCoding eCoding) const	{ return eCoding == CONTENT_IDENTITY || m_nCodings & (1 << eCoding) ? true : false ; }
+	hzContentCoding	Coding	(void) const	{ return m_eCoding ; }
+	bool		Chunked		(void) const	{ return m_nChState ? true : false ; }
+	bool		Multipart	(void) const	{ return m_nMpState ? true : false ; }
+	bool		Streaming	(void) const	{ return m_bChunkOut ; }
 
 	hzEcode	GetAt	(hzPair& P, uint32_t nIndex)
 	{
@@ -214,6 +321,7 @@ public:
 	const char*	GetResource	(void) const	{ return m_pReqPATH ; }
 	//const char*	GetQuery	(void) const	{ return m_pReqQURY ; }
 	const char*	GetFragment	(void) const	{ return m_pReqFRAG ; }
+	const char*	WsProtocols	(void) const	{ return m_pWsProtocol ; }
 
 	uint32_t	Connection	(void) const	{ return m_nConnection ; }
 
@@ -239,12 +347,21 @@ public:
 	void		DelSessCookie	(const hzSysID& Cookie)	{ m_CookieOld = Cookie ; }
 	void		SetSession		(hzHttpSession* pSession)	{ m_pSession = pSession ; }
 	hzEcode		ProcessEvent	(hzChain& Z) ;
+	hzEcode		RawRequest		(hzChain& Hdr, hzChain& Body) ;
 	hzEcode		Storeform		(const char* cpPath) ;
-	hzEcode		SendRawChain	(HttpRC hrc, hzMimetype type, const hzChain& Data, uint32_t nExpires, bool bZip) ;
+	hzEcode		SendRawChain	(HttpRC hrc, hzMimetype type, const hzChain& Data, uint32_t nExpires, hzContentCoding eCoding) ;
+	hzEcode		SendRawChain	(HttpRC hrc, hzMimetype type, const hzChain& Data, uint32_t nExpires, bool bZip)	{ return SendRawChain(hrc, type, Data, nExpires, bZip ? CONTENT_GZIP : CONTENT_IDENTITY) ; }
 	hzEcode		SendRawString	(HttpRC hrc, hzMimetype type, const hzString& fixContent, uint32_t nExpires, bool bZip) ;
+	hzEcode		SendChunkHead	(HttpRC hrc, hzMimetype type, uint32_t nExpires, bool bZip) ;
+	hzEcode		SendChunk		(const hzChain& Data) ;
+	hzEcode		SendChunkEnd	(void) ;
+	void		StreamInit		(hzChain& Z, HttpRC hrc, hzMimetype type, uint32_t nExpires, bool bZip) ;
+	hzEcode		Stream			(hzChain& Z) ;
+	hzEcode		StreamEnd		(hzChain& Z) ;
 	hzEcode		SendFilePage	(const char* pDir, const char* cpFilename, uint32_t nExpires, bool bZip) ;
 	hzEcode		SendPageE		(const char* pDir, const char* cpFilename, uint32_t nExpires, bool bZip) ;
 	hzEcode		SendFileHead	(const char* pDir, const char* cpFilename, uint32_t nExpires = 0) ;
+	hzEcode		SendEntity		(hzMimetype type, const hzChain& Data, const hzString& etag, uint32_t nMtime, uint32_t nExpires, bool bZip) ;
 	hzEcode		SendHttpHead	(const hzString& fixContent, hzMimetype type, uint32_t nExpires = 0) ;
 	hzEcode		SendHttpHead	(const hzChain& fixContent, hzMimetype type, uint32_t nExpires = 0) ;
 	hzEcode		Redirect		(const hzUrl& url, uint32_t nExpires, bool bZip) ;
@@ -253,6 +370,10 @@ public:
 	hzEcode		SendAjaxResult	(HttpRC hrc) ;
 	hzEcode		SendAjaxResult	(HttpRC hrc, const char* va_alist ...) ;
 	hzEcode		SendAjaxResult	(HttpRC hrc, hzChain& Z) ;
+
+	//	WebSocket opening handshake (see hzWebSocket.h)
+	bool			IsWebSocket		(void) const ;
+	hzWebSocket*	AcceptWebSocket	(hzTcpCode (*OnMessage)(hzWebSocket*, hzChain&, bool), void* pApp, const char* cpProtocol = 0) ;
 } ;
 
 #endif	//	hzHttpServer_h
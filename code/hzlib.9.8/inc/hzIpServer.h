@@ -57,6 +57,31 @@
 //	message has been assempled and then calls the application specific function supplied by AddPortHTTP. This must return a hzTcpCode and take a pointer to a hzHttpEvent as its
 //	argument.
 //
+//	Output flow control: Responses queued by SendData() are written by the serving loop as soon as the handler returns. Only if the socket will not take all of
+//	it is the connection polled for writability (EPOLLOUT), and the polling is dropped once the queue is empty. A response too large to be sensibly queued all
+//	at once (a file, a stored email message) should be given to SendStream() as a hzOutSource, from which the connection draws more as the socket drains. The
+//	queue of each connection is topped up to a high watermark whenever it falls below a low watermark, and should the total output queued by all connections
+//	exceed a global high watermark, connections are only topped up a chunk at a time until the total falls below the global low watermark. The memory taken
+//	by slow readers is thus bounded. Handlers that produce output of their own accord can test Writable() and hold back while it is false. The watermarks are
+//	set by hzIpServer::SetOutputLimits().
+//
+//	An output source that draws on a socket of its own (such as the relay of a proxied response) need not block the serving thread while that socket has no
+//	data. Fill() then queues nothing and WaitSock() names the socket, which the serving loop polls for readability (as an epoll registration tagged with
+//	HZ_TAG_SOURCE, or an io_uring poll). The output is resumed once the socket is readable.
+//
+//	A handler that sends its response in parts as it is produced (such as a chunked HTTP response) may call Flush() after each part so that under ServeEpollST
+//	the part is written at once. Under ServeEpollMT and ServeUring, output is written by the serving thread once the handler returns, so Flush() does nothing.
+//
+//	A HTTP connection may be upgraded to a WebSocket by the application handler (see hzWebSocket.h). The m_OnIngress function of the connection is then replaced
+//	by HandleWsMsg and the connection is given an m_OnIdle function. When the connection expires while idle, the serving loop calls m_OnIdle which may queue
+//	output (a ping) and return TCP_KEEPALIVE, in which case the output is written and the connection kept open.
+//
+//	Connection tracking: Each connection keeps a record of what befell it (hzTrack), a fixed size ring of the most recent events. Events are recorded as a format
+//	string literal and numeric arguments (plus at most one short text), and are only formatted when the record is reported, so recording costs little more than a
+//	copy. The record is written to the log when the connection terminates, but only if an error was recorded or a sampled request was recorded in full, or where
+//	HZ_DEBUG_SERVER is set in _hzGlobal_Debug, in which case every connection is reported. One request in N may be sampled (see hzTrack::SetSample). Otherwise
+//	requests are not copied into the record.
+//
 //	Where connections are to be handled by a separate thread, the handler must return void* and accept void* as the argument. AddPortSess has one function pointer argument namely
 //	void* (*OnSession)(void*).
 //
@@ -70,6 +95,7 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <openssl/ssl.h>
 
 #include "hzTmplList.h"
@@ -77,6 +103,10 @@
 #include "hzTmplMapS.h"
 #include "hzChain.h"
 #include "hzIpaddr.h"
+#include "hzIpTable.h"
+#include "hzRateLimit.h"
+#include "hzTimerWheel.h"
+#include "hzMetrics.h"
 
 /*
 **	Definitions
@@ -108,7 +138,29 @@ enum	hzCliStatus
 	CLIENT_TERMINATION	= 0x0020,	//	The client has sent a 0-byte formal termination packet
 	CLIENT_WRITING		= 0x0040,	//	A response has been formulated and is in the process of being sent to the client
 	CLIENT_WRITE_WHOLE	= 0x0080,	//	The response has been written to the clinet
-	CLIENT_BAD			= 0x0100	//	Server has deemed the client to be bad and will not send a response
+	CLIENT_BAD			= 0x0100,	//	Server has deemed the client to be bad and will not send a response
+	CLIENT_HANDSHAKE	= 0x0200,	//	The TLS handshake is in progress (no application data may be exchanged)
+	CLIENT_CLOSING		= 0x0400,	//	The connection is to be closed once the outgoing data has been sent
+	CLIENT_KTLS			= 0x0800,	//	The kernel performs TLS encryption of outgoing data (kTLS), so writes need not pass through the SSL library
+	CLIENT_WANTOUT		= 0x1000,	//	The socket is polled for writability as outgoing data is held up (epoll methods)
+	CLIENT_SHUTWR		= 0x2000,	//	The sending side has been shut down pending the close of the connection (ServeEpollMT)
+	CLIENT_WANTSRC		= 0x4000,	//	Output is held up as the output source is waiting on its socket, which is polled for readability
+	CLIENT_REMOVED		= 0x8000	//	The connection is closed and awaits the completion of its outstanding io_uring operations (ServeUring)
+} ;
+
+#define	HZ_REQ_ORPHAN	0x80000000	//	Flag in hzIpConnex::m_nReqHold: The connection was terminated while held by a request thread, which is to release the HTTP event
+
+enum	hzHandshake
+{
+	//	Category:	Internet
+	//
+	//	Outcome of a call to hzIpConnex::Handshake(). The TLS handshake on a secure connection is driven by the epoll loop rather than completed inline at accept
+	//	time, so it is advanced each time the socket is readable (or writable) until it either completes or fails.
+
+	HANDSHAKE_DONE,			//	Handshake complete, connection is ready for application data
+	HANDSHAKE_WANT_READ,	//	Handshake awaits more data from the client
+	HANDSHAKE_WANT_WRITE,	//	Handshake awaits the socket becoming writable
+	HANDSHAKE_FAILED		//	Handshake failed, connection to be terminated
 } ;
 
 enum	hzTcpCode
@@ -126,6 +178,34 @@ enum	hzTcpCode
 #define HZMAX_SERVNAMLEN	64		//	Max domain name?
 #define HZMAX_IPADDRLEN		16		//	IPV-4 Address length
 
+/*
+**	TLS session resumption (see InitServerSSL)
+*/
+
+#define	HZ_TLS_SESS_CACHE	20480	//	Default number of sessions held in the server session cache
+#define	HZ_TLS_SESS_SECS	7200	//	Default lifetime (seconds) of a cached session or session ticket
+#define	HZ_TLS_TICKET_SECS	43200	//	Default interval (seconds) at which the session ticket key is replaced
+#define	HZ_TLS_TICKET_KEYS	3		//	Number of ticket keys held (the current key and those it replaced, which may still decrypt tickets)
+
+/*
+**	Output flow control (see SetOutputLimits)
+*/
+
+#define	HZ_OUT_CONN_HIGH	262144		//	Default per connection high watermark (queue is topped up to this from a hzOutSource)
+#define	HZ_OUT_CONN_LOW		65536		//	Default per connection low watermark (queue is topped up when it falls below this)
+#define	HZ_OUT_GLOBAL_HIGH	67108864	//	Default global high watermark (above this, queues are topped up a chunk at a time)
+#define	HZ_OUT_GLOBAL_LOW	50331648	//	Default global low watermark (below this, queues are again topped up to the high watermark)
+#define	HZ_OUT_CHUNK		16384		//	Amount drawn from a hzOutSource at a time
+#define	HZ_TAG_SOURCE		0x80000000	//	Flag in an epoll event tag, denoting readability of the socket of the output source rather than of the connection
+
+/*
+**	Connection tracking (see hzTrack)
+*/
+
+#define	HZ_TRACK_SLOTS		32		//	Events held per connection. Once all are used, each new event replaces the oldest.
+#define	HZ_TRACK_TEXT		64		//	Text held per event (longer text is truncated)
+#define	HZ_TRACK_ATTACH		4		//	Chains (error reports, sampled requests) held per connection
+
 /*
 **	The ListeningSocket class
 */
@@ -140,6 +220,18 @@ enum	hzTcpCode
 class	hzIpConnex ;
 class	hzHttpEvent ;
 
+enum	hzRateScope
+{
+	//	Category:	Internet
+	//
+	//	Rate limits that may be applied to a listening socket (see hzIpServer::SetRateLimit)
+
+	HZ_RATE_NONE,		//	No limit (connection or message admitted)
+	HZ_RATE_PORT,		//	Connections accepted on the port from all addresses
+	HZ_RATE_IPCONN,		//	Connections accepted on the port from a single address
+	HZ_RATE_IPMSG		//	Messages received on the port from a single address
+} ;
+
 class	hzTcpListen
 {
 	//	Category:	Internet
@@ -158,6 +250,15 @@ class	hzTcpListen
 	uint16_t	m_nCurConnections ;		//	Current number of simultaneous TCP connections on this port
 	uint16_t	m_bOpflags ;			//	Operational flags (HZ_LISTEN_SECURE | HZ_LISTEN_INTERNET | HZ_LISTEN_UDP)
 
+	//	Rate limits (see hzRateLimit.h)
+	hzTokenBucket	m_PortRate ;		//	Connections to the port
+	hzRateLimit		m_IpConnRate ;		//	Connections to the port by address
+	hzRateLimit		m_IpMsgRate ;		//	Messages to the port by address
+	uint32_t		m_nPortRate ;		//	Connections per second allowed to the port (0 for no limit)
+	uint32_t		m_nPortBurst ;		//	Connections allowed to the port at once
+	uint32_t		m_nRefusedConn ;	//	Connections refused by rate limit
+	uint32_t		m_nRefusedMsg ;		//	Messages refused by rate limit
+
 	//	User supplied function. Each end point must have a 'OnIngress'
 	//	function to handle messages comming in on the specific port. Each
 	//	port can have a different handler or the same handler can be used
@@ -185,6 +286,8 @@ public:
 		m_pSSL = 0 ;
 
 		m_bOpflags = 0 ;
+		m_nPortRate = m_nPortBurst = 0 ;
+		m_nRefusedConn = m_nRefusedMsg = 0 ;
 		//m_bSecure = 0 ;
 		//m_bInternet = 0 ;
 	}
@@ -209,6 +312,13 @@ public:
 
 	hzEcode	Activate	(void) ;
 
+	//	Rate limiting
+	hzEcode		SetRateLimit	(hzRateScope eScope, uint32_t nRate, uint32_t nBurst) ;
+	hzRateScope	AdmitConn		(hzIpaddr ipa) ;
+	bool		AdmitMsg		(hzIpaddr ipa) ;
+	uint32_t	RefusedConns	(void) const	{ return m_nRefusedConn ; }
+	uint32_t	RefusedMsgs		(void) const	{ return __atomic_load_n(&m_nRefusedMsg, __ATOMIC_RELAXED) ; }
+
 	//	Get functions
 	hzLogger*	GetLogger			(void) const	{ return m_pLog ; }
 	uint32_t	GetPort				(void) const	{ return m_nPort ; }
@@ -315,17 +425,157 @@ public:
 	hzEcode		Push	(hzPacket& pkt) ;
 	hzEcode		Push	(const hzChain& Z) ;
 
+	hzEcode		Push	(const char* pData, uint32_t nLen) ;
+
 	hzEcode		Pull	(void) ;
 	hzEcode		Clear	(void) ;
 } ;
 
+class	hzOutSource
+{
+	//	Category:	Internet
+	//
+	//	Pure virtual base class for producers of outgoing data too large to be queued all at once (see hzIpConnex::SendStream). The connection calls Fill()
+	//	each time its queue is to be topped up, so data is only read or generated as fast as the client takes it. The connection deletes the source once it is
+	//	exhausted or the connection is terminated. Output sent while a source is in use is itself made into a source and queued behind it, so responses are
+	//	always sent in order.
+
+public:
+	hzOutSource*	m_pNext ;	//	Next source queued on the connection (output queued behind this source)
+
+	hzOutSource	(void)	{ m_pNext = 0 ; }
+	virtual	~hzOutSource	(void)	{}
+
+	//	Append up to about nMax bytes to the queue. Return E_OK if there is more to come, E_NODATA if the source is exhausted, or any other code on error (the
+	//	connection is then terminated as the response cannot be completed).
+	virtual	hzEcode		Fill	(hzPktQue& Q, uint32_t nMax) = 0 ;
+
+	//	Total size of the data the source will produce
+	virtual	uint32_t	Size	(void) const = 0 ;
+
+	//	Socket to be polled for readability before Fill() is called again, where the last Fill() returned E_OK having queued nothing as the data was not yet
+	//	available. Return -1 otherwise (the default, for sources that never wait).
+	virtual	int32_t		WaitSock	(void) const	{ return -1 ; }
+} ;
+
+class	hzOutFile	: public hzOutSource
+{
+	//	Category:	Internet
+	//
+	//	Output source reading a file, or part of a file, from disk
+
+	uint64_t	m_nPosn ;		//	Position of next read
+	uint32_t	m_nLeft ;		//	Bytes remaining
+	uint32_t	m_nSize ;		//	Bytes to send in total
+	int32_t		m_nFd ;			//	File descriptor
+
+	//	Prevent copies
+	hzOutFile	(const hzOutFile&) ;
+	hzOutFile&	operator=	(const hzOutFile&) ;
+
+public:
+	hzOutFile	(void)	{ m_nPosn = 0 ; m_nLeft = m_nSize = 0 ; m_nFd = -1 ; }
+	~hzOutFile	(void) ;
+
+	hzEcode		Open	(const char* cpPath, uint64_t nOffset = 0, uint32_t nBytes = 0) ;
+	hzEcode		Fill	(hzPktQue& Q, uint32_t nMax) ;
+	uint32_t	Size	(void) const	{ return m_nSize ; }
+} ;
+
+class	hzOutChain	: public hzOutSource
+{
+	//	Category:	Internet
+	//
+	//	Output source drawing on a chain. The chain is shared (not copied) and its blocks are queued as the socket drains, so a large chain already in memory
+	//	is not also held in its entirety as queued packets.
+
+	hzChain				m_Data ;	//	The data
+	hzChain::BlkIter	m_Blk ;		//	Next block to queue
+
+public:
+	hzOutChain	(const hzChain& Z)	{ m_Data = Z ; m_Blk = m_Data ; }
+
+	hzEcode		Fill	(hzPktQue& Q, uint32_t nMax) ;
+	uint32_t	Size	(void) const	{ return m_Data.Size() ; }
+} ;
+
+class	hzTrack
+{
+	//	Category:	Internet
+	//
+	//	Record of events on a connection (see synopsis). Events are held in a ring of HZ_TRACK_SLOTS, so the record of a long lived connection is of its most
+	//	recent events. The format of an event must be a string literal as only the pointer is kept. It may contain the directives %d, %u and %x which take the
+	//	numeric arguments in order, and %s which takes the text argument.
+
+	struct	_event
+	{
+		uint64_t	m_nsTime ;				//	Nanosecond Epoch of event
+		const char*	m_pFmt ;				//	Format (null if the event is an attached chain)
+		uint64_t	m_Args[4] ;				//	Numeric arguments
+		char		m_Text[HZ_TRACK_TEXT] ;	//	Text argument
+	} ;
+
+	_event		m_Ring[HZ_TRACK_SLOTS] ;	//	The events
+	hzChain		m_Attach[HZ_TRACK_ATTACH] ;	//	Attached chains
+	uint32_t	m_nEvents ;					//	Events recorded (the next slot is this modulo HZ_TRACK_SLOTS)
+	uint32_t	m_nAttach ;					//	Chains attached
+	bool		m_bReport ;					//	Record to be reported (an error or a sampled request has been recorded)
+	bool		m_bSample ;					//	Current request is sampled
+
+	static	uint32_t	s_nSample ;			//	Sample one request in this many (0 for none)
+	static	uint32_t	s_nSeen ;			//	Requests seen (for sampling)
+
+	//	Prevent copies
+	hzTrack	(const hzTrack&) ;
+	hzTrack&	operator=	(const hzTrack&) ;
+
+	_event*	_slot	(const char* fmt, const char* cpText) ;
+	void	_attach	(const hzChain& Z, const char* cpTitle) ;
+
+public:
+	hzTrack	(void)	{ m_nEvents = m_nAttach = 0 ; m_bReport = m_bSample = false ; }
+
+	static	void	SetSample	(uint32_t nSample)	{ s_nSample = nSample ; }
+
+	//	Structured events, formatted only if reported
+	void	Event	(const char* fmt, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0, uint64_t d = 0) ;
+	void	EventS	(const char* fmt, const char* s, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0) ;
+	void	Error	(const char* fmt, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0, uint64_t d = 0) ;
+	void	ErrorS	(const char* fmt, const char* s, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0) ;
+
+	//	Chains. An error report is always kept, otherwise the chain is only kept if the record is sure to be reported.
+	void	Attach	(const hzChain& Z, bool bError) ;
+
+	//	Request sampling. Sample() is called as each request begins. Payload() records the request in full if it is sampled.
+	bool	Sample	(void) ;
+	void	Payload	(const hzChain& Z) ;
+
+	//	For applications. These format at once (to within HZ_TRACK_TEXT) so are best kept out of frequently run code.
+	void		Printf		(const char* va_alist ...) ;
+	hzTrack&	operator<<	(const hzChain& Z)	{ Attach(Z, false) ; return *this ; }
+	hzTrack&	operator<<	(const char* s)		{ EventS("%s", s) ; return *this ; }
+
+	//	Reporting
+	bool	Verbose	(void) const	{ return m_bSample || (_hzGlobal_Debug & HZ_DEBUG_SERVER) ? true : false ; }
+	bool	Due		(void) const	{ return m_nEvents && (m_bReport || (_hzGlobal_Debug & HZ_DEBUG_SERVER)) ? true : false ; }
+	void	Report	(hzChain& Z) const ;
+	void	Clear	(void) ;
+} ;
+
 class	hzIpConnex
 {
+	friend class	hzConnTable ;
+	friend class	hzIpServer ;
+
 	hzChain			m_Input ;			//	Incomming message chain
+	hzLockS			m_lockIn ;			//	Lock on the input chain (appended to by the epoll thread while a request thread consumes it, under ServeEpollMT)
 	hzChain::Iter	m_MsgStart ;		//	For iteration of pipelined requests
 	hzLogger*		m_pLog ;			//	Log channel
 	hzIpConnInfo*	m_pInfo ;			//	Connection specific information
 	SSL*			m_pSSL ;			//	SSL session info
+	hzIpConnex*		m_pPoolNext ;		//	Next free connection object (while in the pool of hzConnTable)
+	hzTcpListen*	m_pListen ;			//	Listening socket the connection was accepted on
+	hzOutSource*	m_pSource ;			//	Producer of outgoing data still to be queued (if any)
 	hzPktQue		m_Outgoing ;		//	Outgoing message stream
 
 	uint64_t		m_ConnExpires ;		//	Nanosecond Epoch expiry
@@ -334,10 +584,14 @@ class	hzIpConnex
 	uint64_t		m_nsRecvEnd ;		//	Nanosecond Epoch request considered complete
 	uint64_t		m_nsSendBeg ;		//	Nanosecond Epoch response transmission began
 	uint64_t		m_nsSendEnd ;		//	Nanosecond Epoch response transmission ended
+	uint64_t		m_nsHandshake ;		//	Nanosecond Epoch by which the TLS handshake must complete
+	uint64_t		m_nsTTL ;			//	Time to live in nanoseconds (from the listening socket timeout)
+	uint64_t		m_nEvTag ;			//	Epoll event tag (generation and socket, as issued by hzConnTable)
 	SOCKADDRIN		m_CliAddr ;			//	IP Addres of client socket
 	socklen_t		m_nCliLen ;			//	Length of socket address
 	hzIpaddr		m_ClientIP ;		//	IP address of client
 	uint32_t		m_nSock ;			//	Socket of client (note that socket of connection cannot be -1) 
+	uint32_t		m_nSrcSock ;		//	Socket of the output source registered for polling (0 if none)
 	uint32_t		m_nMsgno ;			//	Event/Message number
 	uint32_t		m_nGlitch ;			//	Extent of incomplete write
 	uint32_t		m_nStart ;			//	Start position of current incomming message within chain
@@ -345,18 +599,26 @@ class	hzIpConnex
 	uint32_t		m_nTotalOut ;		//	Total size of outgoing response
 	uint32_t		m_nExpected ;		//	Expected size of incomming request
 	uint32_t		m_bState ;			//	Client state
+	uint32_t		m_nResponses ;		//	Responses completed on this connection
+	uint32_t		m_nUring ;			//	Number of io_uring operations submitted on the connection and yet to complete (ServeUring)
+	uint32_t		m_nReqHold ;		//	Times the connection is queued for or in the hands of a request thread (ServeEpollMT), plus HZ_REQ_ORPHAN once terminated
 	uint16_t		m_nPort ;			//	Incomimg port
 	uint16_t		m_bListen ;			//	Operational flags from listening socket (HZ_LISTEN_SECURE | HZ_LISTEN_INTERNET | HZ_LISTEN_UDP)
+	uint16_t		m_nLsPort ;			//	Port of the listening socket (for metrics)
 	char			m_ipbuf[48] ;		//	Text form of IP address
+	bool			m_bInHeld ;			//	Input lock is held by the request thread (see LockInput)
 
 public:
-	hzChain		m_Track ;				//	Used by application to report on progress during a session. Logged when connection terminated.
+	hzTrack		m_Track ;				//	Record of events on the connection, logged on termination if an error was recorded (see hzTrack)
+	hzTimer		m_Timer ;				//	Expiry timer (armed in the timer wheel of the serving loop)
 	void*		m_appFn ;				//	Application message event handler
 	void*		m_pEventHdl ;			//	HTTP Event instance
+	void*		m_pWsHdl ;				//	WebSocket instance (if the connection has been upgraded, see hzWebSocket.h)
 
 	hzTcpCode	(*m_OnIngress)(hzChain& Input, hzIpConnex* pCx) ;	//	Required: Function to handle messages comming in on the specific port.
 	hzTcpCode	(*m_OnConnect)(hzIpConnex* pCx) ;					//	Optional: Called on connection e.g. Server hello.
 	hzTcpCode	(*m_OnDisconn)(hzIpConnex* pCx) ;					//	Optional: Called on disconnection for any tidying up.
+	hzTcpCode	(*m_OnIdle)(hzIpConnex* pCx) ;						//	Optional: Called on expiry while idle. Returns TCP_KEEPALIVE if output was queued to keep it open.
 
 	//	Constructor and destructor
 	hzIpConnex	(hzLogger* pLog) ;
@@ -364,19 +626,46 @@ public:
 
 	hzEcode	Initialize	(hzTcpListen* pLS, SSL* pSSL, const char* cpIPAddr, uint32_t cliSock, uint32_t cliPort, uint32_t eventNo) ;
 
-	void	Oxygen	(void)	{ m_ConnExpires = RealtimeNano() ; m_ConnExpires += 25000000000 ; }	//	Adds 25 seconds to the time to live
-	void	Hypoxia	(void)	{ m_ConnExpires = 0 ; }												//	Expires the connection
+	void	Oxygen	(void)	{ m_ConnExpires = RealtimeNano() + m_nsTTL ; }	//	Renews the time to live (timeout of listening socket, default 25 seconds)
+	void	Hypoxia	(void)	{ m_ConnExpires = 0 ; }							//	Expires the connection
+
+	uint64_t	Deadline	(void) const
+	{
+		//	The time by which the connection must next make progress. During the TLS handshake this is the handshake limit. While a request is only partly
+		//	received, it is the time the request began plus the time to live, so a client trickling data cannot hold the connection open indefinitely.
+		//	Otherwise it is the expiry set by the last call to Oxygen().
+
+		if (m_bState & CLIENT_HANDSHAKE)
+			return m_nsHandshake ;
+		if (SizeIn() && !_isxmit() && (m_nsRecvBeg + m_nsTTL) < m_ConnExpires)
+			return m_nsRecvBeg + m_nsTTL ;
+		return m_ConnExpires ;
+	}
 
 	void	Terminate	(void) ;	//	Terminate connection
 
+	//	TLS handshake (secure connections only)
+	hzHandshake	Handshake	(void) ;
+	void		SetHandshakeLimit	(uint64_t nsLimit)	{ m_nsHandshake = nsLimit ; }
+	uint64_t	HandshakeExpires	(void) const	{ return m_nsHandshake ; }
+	bool		IsHandshake			(void) const	{ return m_bState & CLIENT_HANDSHAKE ? true : false ; }
+	bool		SslPending			(void) const	{ return m_pSSL && SSL_pending(m_pSSL) > 0 ? true : false ; }
+	bool		IsSecure			(void) const	{ return m_pSSL ? true : false ; }
+	bool		IsResumed			(void) const	{ return m_pSSL && SSL_session_reused(m_pSSL) ? true : false ; }
+	bool		IsKtls				(void) const	{ return m_bState & CLIENT_KTLS ? true : false ; }
+
 	//	Set functions
 	void	SetInfo	(hzIpConnInfo* pInfo)	{ m_pInfo = pInfo ; }
+	void	SetTTL	(uint64_t nsTTL)		{ m_nsTTL = nsTTL ; }	//	A shorter time to live takes effect once the expiry timer next falls due
 
 	//	Get functions
 	hzIpConnInfo*	GetInfo	(void) const	{ return m_pInfo ; }
 
 	hzLogger*	GetLogger	(void) const	{ return m_pLog ; }
 	hzChain&	InputZone	(void)			{ return m_Input ; }
+	void		DropInput	(uint32_t nBytes) ;
+	void		LockInput	(void)	{ if (_hzGlobal_MT) { m_lockIn.Lock() ; m_bInHeld = true ; } }		//	Hold the input still while it is framed (DropInput will not then lock)
+	void		UnlockInput	(void)	{ if (_hzGlobal_MT) { m_bInHeld = false ; m_lockIn.Unlock() ; } }
 	hzIpaddr	ClientIP	(void) const	{ return m_ClientIP ; }
 	const char*	GetClientIP	(void) const	{ return m_ipbuf ; }
 	uint64_t	Expires		(void) const	{ return m_ConnExpires ; }
@@ -384,6 +673,7 @@ public:
 	uint64_t	TimeRecv	(void) const	{ return m_nsRecvEnd - m_nsRecvBeg ; }
 	uint64_t	TimeProc	(void) const	{ return m_nsSendBeg - m_nsRecvEnd ; }
 	uint64_t	TimeXmit	(void) const	{ return m_nsSendEnd - m_nsSendBeg ; }
+	uint64_t	EventTag	(void) const	{ return m_nEvTag ? m_nEvTag : m_nSock ; }
 	uint32_t	EventNo		(void) const	{ return m_nMsgno ; }
 	uint32_t	CliSocket	(void) const	{ return m_nSock ; }
 	uint32_t	CliPort		(void) const	{ return m_nPort ; }
@@ -393,15 +683,45 @@ public:
 	bool		IsVirgin	(void) const	{ return m_bState == CLIENT_INITIALIZED ; }
 	bool		IsCliTerm	(void) const	{ return m_bState & CLIENT_TERMINATION ; }
 	bool		IsCliBad	(void) const	{ return m_bState & CLIENT_BAD ; }
-	bool		_isxmit		(void) const	{ return m_Outgoing.m_pStart ? true : false ; }
+	bool		IsRemoved	(void) const	{ return m_bState & CLIENT_REMOVED ? true : false ; }
+	uint32_t	SizeOut		(void) const	{ return m_Outgoing.Size() ; }
+	bool		_isxmit		(void) const	{ return m_Outgoing.m_pStart || m_pSource ? true : false ; }
 
 	//	Operational functions
 	int32_t		Recv		(hzPacket& Buf) ;
 	hzEcode		SendData	(const hzChain& Hdr, const hzChain& Body) ;
 	hzEcode		SendData	(const hzChain& Z) ;
+	hzEcode		SendStream	(const hzChain& Hdr, hzOutSource* pSrc) ;
+	void		Flush		(void) ;
 	void		SendKill	(void) ;
 	int32_t		_xmit		(hzPacket& buf) ;
 
+	//	Output flow control (see synopsis)
+	bool		Writable	(void) const ;
+	void		_addSource	(hzOutSource* pSrc) ;
+	void		_dropSources	(void) ;
+	int32_t		_refill		(void) ;
+	void		_queued		(void) ;
+	void		_wantWrite	(bool bWant) ;
+	void		_wantSource	(int32_t nSock) ;
+	void		_dropWatch	(void) ;
+
+	//	Data transfer by the io_uring method, where the reads and writes are performed by the kernel rather than by Recv() and _xmit()
+	void		_ingest		(const char* pBuf, int32_t nRecv) ;
+	uint32_t	_xmitPrep	(struct iovec* pIov, uint32_t nMax) ;
+	void		_xmitDone	(uint32_t nSent) ;
+
+	//	Message rate limit of the listening socket (see hzTcpListen::AdmitMsg)
+	bool		_admit		(void) ;
+
+	//	Release of the HTTP event (see Terminate)
+	void		_dropEvent	(void) ;
+
+	//	Metrics (recorded only if hzMetrics is active)
+	void		MetricError		(void) ;
+	void		MetricExpired	(void) ;
+	void		_metricsDone	(void) ;
+
 	//	Message size expectations
 	void		ExpectSize	(uint32_t nBytes)	{ m_nExpected = nBytes ; }
 	uint32_t	ExpectSize	(void)	{ return m_nExpected ; }
@@ -423,6 +743,72 @@ public:
 	}
 } ;
 
+/*
+**	The Connection Table
+*/
+
+class	hzConnTable
+{
+	//	Category:	Internet
+	//
+	//	The hzConnTable class holds the connected clients of a serving loop, indexed by socket. It is a flat array of slots, one per possible file descriptor, so
+	//	lookup is a single array access. It is sized initially from RLIMIT_NOFILE (the soft limit is first raised to the hard limit) and grows by doubling if
+	//	a socket beyond the current size is ever inserted.
+	//
+	//	Each slot has a generation which is advanced every time a new connection is inserted. The generation and socket together form a 64-bit tag which the
+	//	serving loop registers with epoll as the event data, in place of the bare socket. When a socket is closed and the descriptor reused by a new connection,
+	//	any event still carrying the old tag (e.g. from an epoll_ctl call on behalf of the old connection by another thread) is recognized as stale.
+	//
+	//	The table also pools hzIpConnex instances. Acquire() takes an instance from the pool (or allocates one if the pool is empty) and Release() returns it
+	//	after it has been terminated, so in steady state the accepting of connections involves no allocation.
+
+	struct	_slot
+	{
+		hzIpConnex*	m_pCC ;		//	Connected client (null if slot free)
+		uint32_t	m_nGen ;	//	Generation of slot
+		uint32_t	m_nResv ;	//	Reserved
+	} ;
+
+	_slot*		m_pSlots ;		//	Slot array (indexed by socket)
+	hzIpConnex*	m_pPool ;		//	Pool of free connection objects
+	hzLogger*	m_pLog ;		//	Log channel for new connection objects
+	uint32_t	m_nSize ;		//	Number of slots
+	uint32_t	m_nCount ;		//	Number of occupied slots
+	uint32_t	m_nPooled ;		//	Number of objects in the pool
+	uint32_t	m_nPoolMax ;	//	Maximum number of objects to retain in the pool
+
+	hzEcode	_grow	(uint32_t nSock) ;
+
+	//	Prevent copies
+	hzConnTable	(const hzConnTable&) ;
+	hzConnTable&	operator=	(const hzConnTable&) ;
+
+public:
+	hzConnTable		(void) ;
+	~hzConnTable	(void) ;
+
+	hzEcode		Init	(hzLogger* pLog, uint32_t nPoolMax = 4096) ;
+
+	//	Connection objects
+	hzIpConnex*	Acquire	(void) ;
+	void		Release	(hzIpConnex* pCC) ;
+
+	//	Slots
+	uint64_t	Insert	(uint32_t nSock, hzIpConnex* pCC) ;
+	void		Remove	(uint32_t nSock) ;
+	hzIpConnex*	Lookup	(uint64_t nTag) const ;
+	bool		Stale	(uint64_t nTag) const ;
+
+	hzIpConnex*	operator[]	(uint32_t nSock) const	{ return nSock < m_nSize ? m_pSlots[nSock].m_pCC : 0 ; }
+
+	uint32_t	Size	(void) const	{ return m_nSize ; }
+	uint32_t	Count	(void) const	{ return m_nCount ; }
+	uint32_t	Pooled	(void) const	{ return m_nPooled ; }
+
+	static	uint32_t	Socket		(uint64_t nTag)	{ return (uint32_t) (nTag & 0x7fffffff) ; }
+	static	bool		IsSource	(uint64_t nTag)	{ return nTag & HZ_TAG_SOURCE ? true : false ; }
+} ;
+
 /*
 **	The SERVER itself
 */
@@ -476,6 +862,7 @@ class	hzIpServer
 
 	hzList<hzTcpListen*>	m_LS ;		//	Listening sockets
 	hzVect<hzIpConnex*>		m_Inbound ;	//	Connected clients
+	hzConnTable				m_Conns ;	//	Connected clients by socket (epoll methods)
 
 	hzLogger*	m_pLog ;				//	Log channel to use for events
 	hzLogger*	m_pStats ;				//	Log channel to use for stats
@@ -485,9 +872,28 @@ class	hzIpServer
 	uint32_t	m_nTimeout ;			//	Timeout for select
 	uint32_t	m_eError ;				//	Error code
 	uint32_t	m_nMaxSocket ;			//	Highest socket for the select function
+	uint32_t	m_nTlsTimeout ;			//	Time limit (seconds) for a client to complete the TLS handshake
+	uint32_t	m_nTlsBegun ;			//	TLS handshakes started (the TLS counts are updated atomically, see _tlsDone)
+	uint32_t	m_nTlsDone ;			//	TLS handshakes completed
+	uint32_t	m_nTlsFailed ;			//	TLS handshakes failed (protocol error or client disconnect)
+	uint32_t	m_nTlsExpired ;			//	TLS handshakes abandoned because the time limit was exceeded
+	uint32_t	m_nTlsResumed ;			//	TLS handshakes completed by resumption of an earlier session (session cache or ticket)
+	uint32_t	m_nTlsKtls ;			//	TLS connections on which kernel TLS is in use for transmission
+	uint32_t	m_nExpIdle ;			//	Connections expired while idle
+	uint32_t	m_nExpRead ;			//	Connections expired with a request partly received
+	uint32_t	m_nExpWrite ;			//	Connections expired with a response stalled
 	bool		m_bActive ;				//	Socket to start listening
 	bool		m_bShutdown ;			//	Socket to stop listening
 
+	void	_tlsDone	(hzIpConnex* pCC) ;
+
+	//	Support functions for ServeUring()
+	void	_uringArm		(hzIpConnex* pCC) ;
+	void	_uringFlush		(hzIpConnex* pCC) ;
+	void	_uringClose		(hzIpConnex* pCC) ;
+	void	_uringFree		(hzIpConnex* pCC) ;
+	void	_uringIngress	(hzIpConnex* pCC) ;
+
 	/*
 	**	Private constructor for singleton method
 	*/
@@ -501,6 +907,9 @@ class	hzIpServer
 		m_bShutdown = false ;
 		m_nMaxSocket = 0 ;
 		m_nTimeout = 30 ;
+		m_nTlsTimeout = 10 ;
+		m_nTlsBegun = m_nTlsDone = m_nTlsFailed = m_nTlsExpired = m_nTlsResumed = m_nTlsKtls = 0 ;
+		m_nExpIdle = m_nExpRead = m_nExpWrite = 0 ;
 	}
 
 public:
@@ -512,6 +921,31 @@ public:
 	void	SetLogger	(hzLogger* pLog)	{ m_pLog = pLog ; }
 	void	SetStats	(hzLogger* pStats)	{ m_pStats = pStats ; }
 
+	//	TLS handshake time limit and counters
+	void		SetTlsTimeout	(uint32_t nSecs)	{ m_nTlsTimeout = nSecs ; }
+	uint32_t	TlsBegun		(void) const	{ return __atomic_load_n(&m_nTlsBegun, __ATOMIC_RELAXED) ; }
+	uint32_t	TlsDone			(void) const	{ return __atomic_load_n(&m_nTlsDone, __ATOMIC_RELAXED) ; }
+	uint32_t	TlsFailed		(void) const	{ return __atomic_load_n(&m_nTlsFailed, __ATOMIC_RELAXED) ; }
+	uint32_t	TlsExpired		(void) const	{ return __atomic_load_n(&m_nTlsExpired, __ATOMIC_RELAXED) ; }
+	uint32_t	TlsResumed		(void) const	{ return __atomic_load_n(&m_nTlsResumed, __ATOMIC_RELAXED) ; }
+	uint32_t	TlsKtls			(void) const	{ return __atomic_load_n(&m_nTlsKtls, __ATOMIC_RELAXED) ; }
+	uint32_t	TlsPending		(void) const	{ return TlsBegun() - TlsDone() - TlsFailed() - TlsExpired() ; }
+
+	//	Connection expiry counters
+	uint32_t	ExpiredIdle		(void) const	{ return m_nExpIdle ; }
+	uint32_t	ExpiredRead		(void) const	{ return m_nExpRead ; }
+	uint32_t	ExpiredWrite	(void) const	{ return m_nExpWrite ; }
+
+	//	Connection table
+	uint32_t	Connections		(void) const	{ return m_Conns.Count() ; }
+
+	//	Rate limits of a listening port (see hzRateLimit.h)
+	hzEcode		SetRateLimit	(uint32_t nPort, hzRateScope eScope, uint32_t nRate, uint32_t nBurst) ;
+
+	//	Output flow control watermarks (see synopsis) and the total output currently queued
+	hzEcode		SetOutputLimits	(uint32_t nConnHigh, uint32_t nConnLow, uint64_t nGlobalHigh, uint64_t nGlobalLow) ;
+	uint64_t	OutputQueued	(void) const ;
+
 	//	Adds a TCP listening socket for invoking a user defined function that handles general client connections
 	hzEcode	AddPortTCP	(	hzTcpCode	(*OnIngress)(hzChain&, hzIpConnex*),
 							hzTcpCode	(*OnConnect)(hzIpConnex*),
@@ -529,6 +963,9 @@ public:
 							uint32_t	nMaxClients,
 							bool		bSecure = false	) ;
 
+	//	Adds an HTTP listening socket on which the server metrics (see hzMetrics.h) are served in Prometheus text format. This activates metrics if not already.
+	hzEcode	AddPortMetrics	(uint32_t nPort, uint32_t nMaxClients = 8) ;
+
 	//	Adds a TCP listening socket for client connections that are to be managed by a user defined thread handler function.
 	hzEcode	AddPortSess	(	void*		(*OnSession)(void*),
 							uint32_t	nTimeout,
@@ -567,6 +1004,13 @@ public:
 	void	ServeResponses	(void) ;
 	void	ServeEpollMT	(void) ;
 
+	//	ServeUring() is a single threaded alternative to ServeEpollST(), based on io_uring (Linux 6.0 or later). Connections are accepted and read by means of
+	//	multishot operations and responses are written by vectored writes, all submitted to the kernel in batches, so far fewer system calls are made under
+	//	load. The OnIngress, OnConnect and HTTP handler functions are called in the same way so an application can switch between the two by changing the one
+	//	call. UDP ports are not supported by this method.
+
+	void	ServeUring		(void) ;
+
 	void	Halt	(void)	{ m_bShutdown = true ; }
 } ;
 
@@ -605,6 +1049,7 @@ public:
 
 hzEcode		SetupHost		(void) ;
 hzEcode		InitServerSSL	(const char* pvtKey, const char* sslCert, const char* sslCA, bool bVerifyClient) ;
+void		SetServerSSLResume	(uint32_t nCacheSize, uint32_t nSessSecs, uint32_t nRotateSecs) ;
 //void		SetStatusIP		(hzIpaddr ipa, hzIpStatus status) ;
 //uint32_t	GetStatusIP		(hzIpaddr ipa) ;
 
@@ -612,7 +1057,7 @@ hzEcode		InitServerSSL	(const char* pvtKey, const char* sslCert, const char* ssl
 **	Globals
 */
 
-extern	hzMapS	<hzIpaddr,hzIpinfo>	_hzGlobal_StatusIP ;	//	Black and white listed IP addresses
+extern	hzIpTable	_hzGlobal_StatusIP ;		//	Black and white listed IP addresses
 
 extern	hzString	_hzGlobal_Hostname ;		//	String form of actual hostname of this server
 extern	hzString	_hzGlobal_HostIP ;			//	String form of assigned IP address of this server
@@ -0,0 +1,156 @@
+//
+//	File:	hzIpTable.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzIpTable_h
+#define hzIpTable_h
+
+#include <fstream>
+
+#include "hzBasedefs.h"
+#include "hzIpaddr.h"
+#include "hzLock.h"
+
+//	Synopsis:	IP Reputation
+//
+//	hzIpTable holds the status (hzIpStatus) of IP addresses that have been black or white listed, as consulted by hzIpServer on every accepted connection and
+//	updated by the protocol handlers (SMTP, POP3, HTTP) as clients authenticate, fail to authenticate or misbehave. There is one instance, _hzGlobal_StatusIP.
+//
+//	The table is of fixed size and open addressed, with linear probing over slots of 32 bytes (two to a cache line). Lookups take no lock. Each slot has a
+//	sequence number which a writer makes odd while it changes the slot and even again afterwards. A reader reads the sequence, the slot, and the sequence
+//	again, and retries if the sequence has changed or was odd. Writers are serialized by a spinlock but writes are rare (an authentication event) compared
+//	to reads (every connection). The probe is limited to HZ_IPTAB_PROBE slots so a lookup touches at most a few cache lines. Slots are never deleted. Once
+//	the status of an address has lapsed and its offence score has decayed to nothing, its slot may be taken by another address. Until then the address is
+//	retained so that a returning offender is recognised.
+//
+//	Black and white listing is time limited. Each has an expiry (or none) and a white listing overrides a black listing. Addresses also have an offence score
+//	that halves every HZ_IPTAB_HALFLIFE seconds. Offence() adds to the score and black lists the address once the score reaches a threshold, so that an
+//	occasional failed login is forgiven but a burst of them is not.
+//
+//	Ranges of addresses (hzIpRange) may also be black listed. These are held in a sorted array that is replaced in full (and published by a single pointer
+//	store) whenever a range is added or removed, so the ranges are also consulted without a lock. Replaced arrays are retained until the table is destroyed,
+//	as a reader may still be using one. Range changes are expected to be few.
+//
+//	The table is persisted as a journal. Each change is appended as a line of text and on startup, Load() replays the journal and then rewrites it with only
+//	the entries still in force. Lines comprising only an IP address (the format of earlier versions) are taken as indefinite black listings.
+//
+//	Note that IP addresses are IPv4 only, as is hzIpaddr.
+
+#define	HZ_IPTAB_SLOTS		65536	//	Default number of slots (power of 2)
+#define	HZ_IPTAB_PROBE		32		//	Maximum probe length
+#define	HZ_IPTAB_HALFLIFE	600		//	Seconds for an offence score to halve
+#define	HZ_IPTAB_THRESHOLD	8		//	Default offence score at which an address is black listed
+#define	HZ_IPTAB_BLOCKSECS	9000	//	Default duration of black listing by offence score
+
+struct	_hz_ipslot
+{
+	//	Category:	Internet
+	//
+	//	Slot of hzIpTable
+
+	uint32_t	m_nSeq ;		//	Sequence number (odd while the slot is being written)
+	uint32_t	m_nAddr ;		//	IP address (0 if the slot has never been used)
+	uint32_t	m_tBlack ;		//	Epoch time black listing expires (0 if indefinite)
+	uint32_t	m_tWhite ;		//	Epoch time white listing expires (0 if indefinite)
+	uint32_t	m_tScore ;		//	Epoch time offence score was last decayed
+	uint32_t	m_nTotal ;		//	Connection attempts refused since address first black listed
+	uint16_t	m_nSince ;		//	Connection attempts refused since address last black listed
+	uint16_t	m_nScore ;		//	Offence score
+	uint16_t	m_bInfo ;		//	Status (hzIpStatus)
+	uint16_t	m_nResv ;		//	Reserved
+} ;
+
+struct	_hz_iprange
+{
+	//	Category:	Internet
+	//
+	//	Black listed range of IP addresses
+
+	uint32_t	m_nStart ;		//	First address of range
+	uint32_t	m_nEnd ;		//	Last address of range
+	uint32_t	m_nMaxEnd ;		//	Highest last address of this and all preceeding ranges (for lookup where ranges overlap)
+	uint32_t	m_tExpire ;		//	Epoch time black listing expires (0 if indefinite)
+} ;
+
+struct	_hz_iprange_set
+{
+	//	Category:	Internet
+	//
+	//	Immutable array of ranges, in order of first address
+
+	_hz_iprange_set*	m_pPrev ;		//	Replaced array (retained until the table is destroyed)
+	uint32_t			m_nCount ;		//	Number of ranges
+	_hz_iprange			m_Ranges[1] ;	//	The ranges
+} ;
+
+class	hzIpTable
+{
+	//	Category:	Internet
+	//
+	//	IP reputation table (see synopsis above)
+
+	_hz_ipslot*			m_pSlots ;		//	The slots
+	_hz_iprange_set*	m_pRanges ;		//	Black listed ranges
+	std::ofstream		m_Journal ;		//	Journal (if persisted)
+	hzLockS				m_Lock ;		//	Serializes writers
+	uint32_t			m_nSlots ;		//	Number of slots
+	uint32_t			m_nMask ;		//	Slot mask
+	uint32_t			m_nCount ;		//	Number of slots in use
+	uint32_t			m_nThreshold ;	//	Offence score at which Offence() black lists
+	uint32_t			m_nBlockSecs ;	//	Duration of black listing by Offence()
+
+	_hz_ipslot*	_find	(uint32_t nAddr) const ;
+	_hz_ipslot*	_claim	(uint32_t nAddr, uint32_t now) ;
+	bool		_read	(const _hz_ipslot* pSlot, uint32_t nAddr, _hz_ipslot& copy) const ;
+	bool		_inRange	(uint32_t nAddr, uint32_t now) const ;
+	void		_setRanges	(_hz_iprange_set* pSet) ;
+	void		_write		(_hz_ipslot* pSlot, const _hz_ipslot& value) ;
+	void		_journal	(const _hz_ipslot& slot) ;
+	void		_journal	(const _hz_iprange& range) ;
+
+	//	Prevent copies
+	hzIpTable	(const hzIpTable&) ;
+	hzIpTable&	operator=	(const hzIpTable&) ;
+
+public:
+	hzIpTable	(void) ;
+	~hzIpTable	(void) ;
+
+	//	Initialization and persistence
+	hzEcode	Init	(uint32_t nSlots = HZ_IPTAB_SLOTS) ;
+	hzEcode	Load	(const hzString& path) ;
+	void	SetOffence	(uint32_t nThreshold, uint32_t nBlockSecs)	{ m_nThreshold = nThreshold ; m_nBlockSecs = nBlockSecs ; }
+
+	//	Updates (serialized)
+	void		Set		(hzIpaddr ipa, hzIpStatus reason, uint32_t nDelay) ;
+	void		Lift	(hzIpaddr ipa, hzIpStatus reason) ;
+	uint32_t	Offence	(hzIpaddr ipa, hzIpStatus reason, uint32_t nWeight = 1) ;
+	hzEcode		BlockRange		(const hzIpRange& range, uint32_t nDelay) ;
+	hzEcode		UnblockRange	(const hzIpRange& range) ;
+
+	//	Lookups (lock free)
+	bool		Blocked	(hzIpaddr ipa, uint32_t* pAttempts = 0) ;
+	hzIpStatus	Status	(hzIpaddr ipa) const ;
+	bool		Lookup	(hzIpaddr ipa, hzIpinfo& info) const ;
+	bool		Exists	(hzIpaddr ipa) const	{ return _find(ipa) ? true : false ; }
+
+	//	Enumeration (for reporting)
+	uint32_t	Slots	(void) const	{ return m_nSlots ; }
+	uint32_t	Count	(void) const	{ return m_nCount ; }
+	bool		GetSlot	(uint32_t nSlot, hzIpaddr& ipa, hzIpinfo& info) const ;
+} ;
+
+#endif	//	hzIpTable_h
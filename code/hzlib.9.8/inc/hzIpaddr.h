@@ -138,7 +138,8 @@ enum	hzIpStatus
 	HZ_IPSTATUS_BLACK_HTTP	= 0x0040,	//	IP address is blacklisted by a failed HTTP authentication
 	HZ_IPSTATUS_BLACK_DATA	= 0x0080,	//	IP address is blacklisted by a failed data authentication
 	HZ_IPSTATUS_BLACK_PROT	= 0x0100,	//	IP address is blacklisted because of a malformed request
-	HZ_IPSTATUS_BLACK		= 0x01f0,	//	Mask to determine if IP address is blacklisted for any reason
+	HZ_IPSTATUS_BLACK_RANGE	= 0x0200,	//	IP address is blacklisted because it is within a blacklisted range
+	HZ_IPSTATUS_BLACK		= 0x03f0,	//	Mask to determine if IP address is blacklisted for any reason
 } ;
 
 class	hzIpinfo
@@ -151,8 +152,9 @@ public:
 	uint32_t	m_nTotal ;		//	Count of attempts since first block
 	uint16_t	m_nSince ;		//	Count of attempts since last block
 	uint16_t	m_bInfo ;		//	Status of address
+	uint16_t	m_nScore ;		//	Offence score (see hzIpTable)
 
-	hzIpinfo	(void)	{ m_nTotal = m_tBlack = m_tWhite = 0 ; m_nSince = m_bInfo = 0 ; }
+	hzIpinfo	(void)	{ m_nTotal = m_tBlack = m_tWhite = 0 ; m_nSince = m_bInfo = m_nScore = 0 ; }
 } ;
 
 
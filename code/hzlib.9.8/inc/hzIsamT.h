@@ -316,6 +316,12 @@ public:
 	hzEcode		_allocIndxSlot	(_hz_vn_Any* pOld, _hz_vn_Any* pNew) ;
 	void		_expelIndxSlot	(_hz_vn_Idx* pCur, _hz_vn_Any* pChild) ;
 
+	//	Bulk build functions (see _hz_bulk_map and _hz_bulk_set). These do not lock, the caller must hold the write lock.
+	_hz_vn_Dat*	_firstDnode		(void) const ;
+	void		_bulkStart		(void)	{ _clear() ; m_nNodes = 0 ; }
+	_hz_vn_Dat*	_bulkDnode		(_hz_vn_Dat* pPrev, uint32_t nBytes, uint32_t nUsage) ;
+	void		_bulkIndex		(_hz_vn_Dat* pFirst, uint32_t nDnodes, uint32_t nElements) ;
+
 	//	Data Operations
 	_hz_vn_Dat*	InsertPosn	(int32_t& nSlot, uint32_t nPosn) ;
 	hzEcode		DeletePosn	(uint32_t nPosn) ;
@@ -341,6 +347,205 @@ public:
 	hzString	Name		(void) const	{ return m_Name ; }
 } ;
 
+/*
+**	Bulk build
+*/
+
+//	Synopsis:	ISAM Bulk Build
+//
+//	Populating an ISAM by a series of inserts means every key descends the index, shifts the data node slots and from time to time causes a node to split. When
+//	the keys are available as a batch, as is commonly the case when a collection is loaded at startup, it is far cheaper to sort the batch and then construct
+//	the ISAM bottom up. The data nodes are filled in key order, each with HZ_T_ISAMNODE_FULL elements, and then each level of index nodes is built over the
+//	level below, again fully packed, until a level with a single node (the root) is reached. Where the last node in a level would be under half full, it shares
+//	the population of the last two nodes equally with its infra adjacent.
+//
+//	Bulk merge (a batch into a populated ISAM), is done by merging the existing elements (which are read in order from the data nodes), with the sorted batch
+//	and rebuilding. This is linear in the combined population so where the batch is small compared to the existing population, the batch is simply inserted.
+
+inline	_hz_vn_Dat*	_hz_tmpl_ISAM::_firstDnode	(void) const
+{
+	//	Return the lowest data node in the ISAM (or NULL if the ISAM is empty)
+
+	_hz_vn_Any*	pN ;	//	Current node
+
+	for (pN = m_pRoot ; pN && pN->Level() ; pN = ((_hz_vn_Idx*) pN)->m_Ptrs[0]) ;
+	return (_hz_vn_Dat*) pN ;
+}
+
+inline	_hz_vn_Dat*	_hz_tmpl_ISAM::_bulkDnode	(_hz_vn_Dat* pPrev, uint32_t nBytes, uint32_t nUsage)
+{
+	//	Allocate a data node and its (zeroed) element bucket, and place it after the supplied data node.
+	//
+	//	Arguments:	1)	pPrev	The previous data node (NULL if this is the first)
+	//				2)	nBytes	Size of the element bucket
+	//				3)	nUsage	The number of elements the caller will place in the node
+	//
+	//	Returns:	Pointer to the new data node
+
+	_hz_vn_Dat*	pDN ;	//	New data node
+
+	pDN = new _hz_vn_Dat() ;
+	pDN->m_pElements = new uchar[nBytes] ;
+	if (!pDN->m_pElements)
+		Fatal("_hz_tmpl_ISAM::_bulkDnode. ISAM %u Could not allocate element bucket\n", m_isamId) ;
+	memset(pDN->m_pElements, 0, nBytes) ;
+
+	pDN->m_isamId = m_isamId ;
+	pDN->usage = nUsage ;
+
+	if (pPrev)
+	{
+		pPrev->ultra = pDN ;
+		pDN->infra = pPrev ;
+	}
+	m_nNodes++ ;
+	return pDN ;
+}
+
+inline	uint32_t	_hz_bulk_popl	(uint32_t nTotal, uint32_t nNode)
+{
+	//	Return the population of node nNode, in a level of nodes that is to hold nTotal items. All nodes are full except that where the last would be less than
+	//	half full, the last two nodes are equally shared.
+
+	uint32_t	nNodes ;	//	Number of nodes in the level
+	uint32_t	nLast ;		//	Population of last node if fully packed
+
+	nNodes = (nTotal + HZ_T_ISAMNODE_FULL - 1) / HZ_T_ISAMNODE_FULL ;
+	nLast = nTotal - ((nNodes - 1) * HZ_T_ISAMNODE_FULL) ;
+
+	if (nNodes > 1 && nLast < HZ_T_ISAMNODE_HALF)
+	{
+		if (nNode == nNodes - 2)	return (HZ_T_ISAMNODE_FULL + nLast) - ((HZ_T_ISAMNODE_FULL + nLast) / 2) ;
+		if (nNode == nNodes - 1)	return (HZ_T_ISAMNODE_FULL + nLast) / 2 ;
+	}
+
+	return nNode == nNodes - 1 ? nLast : HZ_T_ISAMNODE_FULL ;
+}
+
+inline	void	_hz_tmpl_ISAM::_bulkIndex	(_hz_vn_Dat* pFirst, uint32_t nDnodes, uint32_t nElements)
+{
+	//	Build the index levels over the supplied chain of data nodes and set the root.
+	//
+	//	Arguments:	1)	pFirst		The first data node
+	//				2)	nDnodes		The number of data nodes
+	//				3)	nElements	The total number of elements
+	//
+	//	Returns:	None
+
+	_hz_vn_Any**	pLower ;	//	Nodes in the level below
+	_hz_vn_Any**	pUpper ;	//	Nodes in the level being built
+	_hz_vn_Idx*		pIdx ;		//	Current index node
+	_hz_vn_Idx*		pPrev ;		//	Previous index node in the level
+	_hz_vn_Dat*		pDN ;		//	Data node iterator
+	uint32_t		nLower ;	//	Number of nodes in the level below
+	uint32_t		nUpper ;	//	Number of nodes in the level being built
+	uint32_t		nLevel ;	//	Current level
+	uint32_t		n ;			//	Node iterator
+	uint32_t		x ;			//	Child iterator
+	uint32_t		c ;			//	Child selector
+
+	m_nElements = nElements ;
+	if (!nDnodes)
+		{ m_pRoot = 0 ; return ; }
+
+	pLower = new _hz_vn_Any*[nDnodes] ;
+	for (pDN = pFirst, n = 0 ; pDN && n < nDnodes ; pDN = pDN->ultra, n++)
+		pLower[n] = pDN ;
+
+	for (nLower = nDnodes, nLevel = 1 ; nLower > 1 ; nLevel++)
+	{
+		nUpper = (nLower + HZ_T_ISAMNODE_FULL - 1) / HZ_T_ISAMNODE_FULL ;
+		pUpper = new _hz_vn_Any*[nUpper] ;
+
+		for (pPrev = 0, c = n = 0 ; n < nUpper ; n++)
+		{
+			pIdx = new _hz_vn_Idx() ;
+			pIdx->m_isamId = m_isamId ;
+			pIdx->level = nLevel ;
+			pIdx->usage = _hz_bulk_popl(nLower, n) ;
+
+			for (x = 0 ; x < (uint32_t) pIdx->usage ; x++, c++)
+			{
+				pIdx->m_Ptrs[x] = pLower[c] ;
+				pLower[c]->SetParent(pIdx) ;
+				pIdx->m_nCumulative += pLower[c]->Cumulative() ;
+			}
+
+			if (pPrev)
+			{
+				pPrev->ultra = pIdx ;
+				pIdx->infra = pPrev ;
+			}
+			pPrev = pIdx ;
+			pUpper[n] = pIdx ;
+			m_nNodes++ ;
+		}
+
+		delete [] pLower ;
+		pLower = pUpper ;
+		nLower = nUpper ;
+	}
+
+	m_pRoot = pLower[0] ;
+	delete [] pLower ;
+}
+
+template<class KEY>	void	_hz_bulk_order	(uint32_t* pOrder, const KEY* pKeys, uint32_t nItems)
+{
+	//	Stable sort (bottom up merge sort) of a batch of keys, by means of an array of positions. The keys themselves are not moved. Stability matters as in a
+	//	one to many map, objects under the same key must remain in order of incidence.
+	//
+	//	Arguments:	1)	pOrder	Array of nItems positions, populated by this function in key order
+	//				2)	pKeys	The keys
+	//				3)	nItems	Number of keys
+	//
+	//	Returns:	None
+
+	uint32_t*	pTmp ;		//	Work array
+	uint32_t*	pSrc ;		//	Source run array
+	uint32_t*	pTgt ;		//	Target run array
+	uint32_t*	pSwap ;		//	For swapping arrays
+	uint32_t	nWidth ;	//	Run width
+	uint32_t	nLo ;		//	Start of run pair
+	uint32_t	nMid ;		//	Start of second run
+	uint32_t	nHi ;		//	End of run pair
+	uint32_t	a ;			//	First run iterator
+	uint32_t	b ;			//	Second run iterator
+	uint32_t	n ;			//	Target iterator
+
+	for (n = 0 ; n < nItems ; n++)
+		pOrder[n] = n ;
+	if (nItems < 2)
+		return ;
+
+	pTmp = new uint32_t[nItems] ;
+	pSrc = pOrder ;
+	pTgt = pTmp ;
+
+	for (nWidth = 1 ; nWidth < nItems ; nWidth *= 2)
+	{
+		for (nLo = 0 ; nLo < nItems ; nLo += (2 * nWidth))
+		{
+			nMid = nLo + nWidth < nItems ? nLo + nWidth : nItems ;
+			nHi = nLo + (2 * nWidth) < nItems ? nLo + (2 * nWidth) : nItems ;
+
+			for (a = nLo, b = nMid, n = nLo ; n < nHi ; n++)
+			{
+				if (a < nMid && (b >= nHi || !(pKeys[pSrc[b]] < pKeys[pSrc[a]])))
+					pTgt[n] = pSrc[a++] ;
+				else
+					pTgt[n] = pSrc[b++] ;
+			}
+		}
+
+		pSwap = pSrc ; pSrc = pTgt ; pTgt = pSwap ;
+	}
+
+	if (pSrc != pOrder)
+		memcpy(pOrder, pSrc, nItems * sizeof(uint32_t)) ;
+	delete [] pTmp ;
+}
+
 /*
 **	Standard Function Templates
 */
@@ -389,4 +594,292 @@ template<class KEY, class OBJ> int32_t _tmpl_map_compare	(const void* pKey, cons
 	return *key > pBuck->m_Keys[nSlot] ? 1 : *key < pBuck->m_Keys[nSlot] ? -1 : 0 ;
 }
 
+template<class KEY, class OBJ>	void	_hz_bulk_dropmap	(_hz_tmpl_ISAM& base)
+{
+	//	Destroy the keys and objects held in the data nodes of an ISAM of key/object pairs, ahead of the nodes being freed by _bulkStart(). The element buckets
+	//	are raw memory so freeing them would not release anything the elements hold, such as string references.
+	//
+	//	Arguments:	1)	base	The ISAM (write locked by the caller)
+	//
+	//	Returns:	None
+
+	_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+	_hz_vn_Dat*				pDN ;		//	Data node
+	int32_t					s ;			//	Element slot
+
+	for (pDN = base._firstDnode() ; pDN ; pDN = pDN->ultra)
+	{
+		pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+		for (s = 0 ; s < pDN->usage ; s++)
+		{
+			pBuck->m_Keys[s].~KEY() ;
+			pBuck->m_Objs[s].~OBJ() ;
+		}
+	}
+}
+
+template<class KEY>	void	_hz_bulk_dropset	(_hz_tmpl_ISAM& base)
+{
+	//	Destroy the keys held in the data nodes of an ISAM of keys, ahead of the nodes being freed by _bulkStart() (see _hz_bulk_dropmap)
+	//
+	//	Arguments:	1)	base	The ISAM (write locked by the caller)
+	//
+	//	Returns:	None
+
+	_hz_set_bkt<KEY>*	pBuck ;		//	Data bucket
+	_hz_vn_Dat*			pDN ;		//	Data node
+	int32_t				s ;			//	Element slot
+
+	for (pDN = base._firstDnode() ; pDN ; pDN = pDN->ultra)
+	{
+		pBuck = (_hz_set_bkt<KEY>*) pDN->m_pElements ;
+		for (s = 0 ; s < pDN->usage ; s++)
+			pBuck->m_Keys[s].~KEY() ;
+	}
+}
+
+template<class KEY, class OBJ>	hzEcode	_hz_bulk_map	(_hz_tmpl_ISAM& base, const KEY* pKeys, const OBJ* pObjs, uint32_t nItems, bool bSorted, bool bUnique)
+{
+	//	Bulk insert a batch of key/object pairs into an ISAM of key/object pairs (as used by hzMapS, hzMapM and hzLookup). See synopsis on ISAM Bulk Build.
+	//
+	//	Arguments:	1)	base	The ISAM
+	//				2)	pKeys	Array of nItems keys
+	//				3)	pObjs	Array of nItems objects
+	//				4)	nItems	Number of key/object pairs in the batch
+	//				5)	bSorted	True if the caller guarantees the batch is already in key order
+	//				6)	bUnique	True if keys are unique (the last pair in the batch with a given key, prevails over earlier pairs and any existing pair)
+	//
+	//	Returns:	E_ARGUMENT	If the batch is not supplied
+	//				E_CORRUPT	If an insert failed (small batch only)
+	//				E_OK		If the batch was inserted
+
+	_hzfunc("_hz_bulk_map") ;
+
+	_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+	_hz_vn_Dat*				pDN ;		//	Data node
+	_hz_vn_Dat*				pFirst ;	//	First new data node
+	KEY*					pAllK ;		//	Merged keys
+	OBJ*					pAllO ;		//	Merged objects
+	uint32_t*				pOrder ;	//	Batch in key order
+	uint32_t				nOld ;		//	Existing population
+	uint32_t				nAll ;		//	Merged population
+	uint32_t				nDnodes ;	//	Data nodes built
+	uint32_t				nPop ;		//	Data node population
+	uint32_t				a ;			//	Batch iterator
+	uint32_t				n ;			//	Merge iterator
+	int32_t					nSlot ;		//	Data node slot
+	int32_t					s ;			//	Existing element slot
+	hzEcode					rc = E_OK ;	//	Return code
+
+	if (!nItems)
+		return E_OK ;
+	if (!pKeys || !pObjs)
+		return E_ARGUMENT ;
+
+	//	Put the batch in order
+	pOrder = new uint32_t[nItems] ;
+	if (bSorted)
+		for (a = 0 ; a < nItems ; a++) pOrder[a] = a ;
+	else
+		_hz_bulk_order(pOrder, pKeys, nItems) ;
+
+	//	For unique keys, drop all but the last of any run of equal keys in the batch
+	if (bUnique)
+	{
+		for (a = 1, n = 0 ; a < nItems ; a++)
+		{
+			if (pKeys[pOrder[n]] < pKeys[pOrder[a]])
+				n++ ;
+			pOrder[n] = pOrder[a] ;
+		}
+		nItems = n + 1 ;
+	}
+
+	base.LockWrite() ;
+
+	nOld = base.Count() ;
+
+	//	A small batch into a large ISAM is cheaper inserted
+	if (nOld && nItems < (nOld / HZ_T_ISAMNODE_FULL))
+	{
+		for (a = 0 ; a < nItems ; a++)
+		{
+			pDN = bUnique ? base.InsertKeyU(nSlot, pKeys + pOrder[a]) : base.InsertKeyM(nSlot, pKeys + pOrder[a]) ;
+			if (!pDN)
+				{ rc = E_CORRUPT ; break ; }
+			pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+			pBuck->m_Keys[nSlot] = pKeys[pOrder[a]] ;
+			pBuck->m_Objs[nSlot] = pObjs[pOrder[a]] ;
+		}
+		base.Unlock() ;
+		delete [] pOrder ;
+		if (rc != E_OK)
+			threadLog("%s: Failed to INSERT\n", *_fn) ;
+		return rc ;
+	}
+
+	//	Merge the existing elements with the batch
+	pAllK = new KEY[nOld + nItems] ;
+	pAllO = new OBJ[nOld + nItems] ;
+	nAll = a = 0 ;
+
+	for (pDN = base._firstDnode() ; pDN ; pDN = pDN->ultra)
+	{
+		pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+
+		for (s = 0 ; s < pDN->usage ; s++)
+		{
+			//	Batch keys lower than the existing key go first. For a one to many map, batch keys equal to the existing key go after it.
+			for (; a < nItems && pKeys[pOrder[a]] < pBuck->m_Keys[s] ; a++, nAll++)
+				{ pAllK[nAll] = pKeys[pOrder[a]] ; pAllO[nAll] = pObjs[pOrder[a]] ; }
+
+			if (bUnique && a < nItems && !(pBuck->m_Keys[s] < pKeys[pOrder[a]]))
+				continue ;
+
+			pAllK[nAll] = pBuck->m_Keys[s] ;
+			pAllO[nAll] = pBuck->m_Objs[s] ;
+			nAll++ ;
+		}
+	}
+
+	for (; a < nItems ; a++, nAll++)
+		{ pAllK[nAll] = pKeys[pOrder[a]] ; pAllO[nAll] = pObjs[pOrder[a]] ; }
+	delete [] pOrder ;
+
+	//	Rebuild. The existing elements have been copied into the merge and are destroyed before their nodes are freed.
+	_hz_bulk_dropmap<KEY,OBJ>(base) ;
+	base._bulkStart() ;
+
+	for (pFirst = pDN = 0, nDnodes = n = 0 ; n < nAll ; nDnodes++)
+	{
+		nPop = _hz_bulk_popl(nAll, nDnodes) ;
+		pDN = base._bulkDnode(pDN, sizeof(_hz_map_bkt<KEY,OBJ>), nPop) ;
+		if (!pFirst)
+			pFirst = pDN ;
+
+		pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+		for (s = 0 ; s < (int32_t) nPop ; s++, n++)
+		{
+			pBuck->m_Keys[s] = pAllK[n] ;
+			pBuck->m_Objs[s] = pAllO[n] ;
+		}
+	}
+	base._bulkIndex(pFirst, nDnodes, nAll) ;
+
+	base.Unlock() ;
+
+	delete [] pAllK ;
+	delete [] pAllO ;
+	return E_OK ;
+}
+
+template<class KEY>	hzEcode	_hz_bulk_set	(_hz_tmpl_ISAM& base, const KEY* pKeys, uint32_t nItems, bool bSorted)
+{
+	//	Bulk insert a batch of keys into an ISAM of unique keys (as used by hzSet). See synopsis on ISAM Bulk Build.
+	//
+	//	Arguments:	1)	base	The ISAM
+	//				2)	pKeys	Array of nItems keys
+	//				3)	nItems	Number of keys in the batch
+	//				4)	bSorted	True if the caller guarantees the batch is already in key order
+	//
+	//	Returns:	E_ARGUMENT	If the batch is not supplied
+	//				E_CORRUPT	If an insert failed (small batch only)
+	//				E_OK		If the batch was inserted
+
+	_hz_set_bkt<KEY>*	pBuck ;		//	Data bucket
+	_hz_vn_Dat*			pDN ;		//	Data node
+	_hz_vn_Dat*			pFirst ;	//	First new data node
+	KEY*				pAll ;		//	Merged keys
+	uint32_t*			pOrder ;	//	Batch in key order
+	uint32_t			nOld ;		//	Existing population
+	uint32_t			nAll ;		//	Merged population
+	uint32_t			nDnodes ;	//	Data nodes built
+	uint32_t			nPop ;		//	Data node population
+	uint32_t			a ;			//	Batch iterator
+	uint32_t			n ;			//	Merge iterator
+	int32_t				nSlot ;		//	Data node slot
+	int32_t				s ;			//	Existing element slot
+	hzEcode				rc = E_OK ;	//	Return code
+
+	if (!nItems)
+		return E_OK ;
+	if (!pKeys)
+		return E_ARGUMENT ;
+
+	pOrder = new uint32_t[nItems] ;
+	if (bSorted)
+		for (a = 0 ; a < nItems ; a++) pOrder[a] = a ;
+	else
+		_hz_bulk_order(pOrder, pKeys, nItems) ;
+
+	for (a = 1, n = 0 ; a < nItems ; a++)
+	{
+		if (pKeys[pOrder[n]] < pKeys[pOrder[a]])
+			pOrder[++n] = pOrder[a] ;
+	}
+	nItems = n + 1 ;
+
+	base.LockWrite() ;
+
+	nOld = base.Count() ;
+
+	if (nOld && nItems < (nOld / HZ_T_ISAMNODE_FULL))
+	{
+		for (a = 0 ; a < nItems ; a++)
+		{
+			pDN = base.InsertKeyU(nSlot, pKeys + pOrder[a]) ;
+			if (!pDN)
+				{ rc = E_CORRUPT ; break ; }
+			pBuck = (_hz_set_bkt<KEY>*) pDN->m_pElements ;
+			pBuck->m_Keys[nSlot] = pKeys[pOrder[a]] ;
+		}
+		base.Unlock() ;
+		delete [] pOrder ;
+		return rc ;
+	}
+
+	pAll = new KEY[nOld + nItems] ;
+	nAll = a = 0 ;
+
+	for (pDN = base._firstDnode() ; pDN ; pDN = pDN->ultra)
+	{
+		pBuck = (_hz_set_bkt<KEY>*) pDN->m_pElements ;
+
+		for (s = 0 ; s < pDN->usage ; s++)
+		{
+			for (; a < nItems && pKeys[pOrder[a]] < pBuck->m_Keys[s] ; a++)
+				pAll[nAll++] = pKeys[pOrder[a]] ;
+
+			if (a < nItems && !(pBuck->m_Keys[s] < pKeys[pOrder[a]]))
+				continue ;
+			pAll[nAll++] = pBuck->m_Keys[s] ;
+		}
+	}
+
+	for (; a < nItems ; a++)
+		pAll[nAll++] = pKeys[pOrder[a]] ;
+	delete [] pOrder ;
+
+	_hz_bulk_dropset<KEY>(base) ;
+	base._bulkStart() ;
+
+	for (pFirst = pDN = 0, nDnodes = n = 0 ; n < nAll ; nDnodes++)
+	{
+		nPop = _hz_bulk_popl(nAll, nDnodes) ;
+		pDN = base._bulkDnode(pDN, sizeof(_hz_set_bkt<KEY>), nPop) ;
+		if (!pFirst)
+			pFirst = pDN ;
+
+		pBuck = (_hz_set_bkt<KEY>*) pDN->m_pElements ;
+		for (s = 0 ; s < (int32_t) nPop ; s++, n++)
+			pBuck->m_Keys[s] = pAll[n] ;
+	}
+	base._bulkIndex(pFirst, nDnodes, nAll) ;
+
+	base.Unlock() ;
+
+	delete [] pAll ;
+	return E_OK ;
+}
+
 #endif	//	hzIsamT_h
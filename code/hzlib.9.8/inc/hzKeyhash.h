@@ -0,0 +1,102 @@
+//
+//	File:	hzKeyhash.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzKeyhash_h
+#define hzKeyhash_h
+
+#include "hzBasedefs.h"
+#include "hzString.h"
+#include "hzEmaddr.h"
+#include "hzIpaddr.h"
+
+//	Synopsis:	Key Hashing
+//
+//	Collection class templates that partition or index keys by hash rather than by order, call _hz_keyhash() on the key. This is a set of overloaded inline
+//	functions returning a 64-bit hash. The generic template hashes the bytes of the key and so is only valid for keys that are plain values (integers, IP
+//	addresses, hzSysID etc). Keys that are handles to data held elsewhere (hzString, hzEmaddr), have their own overloads which hash the value rather than the
+//	handle. Applications wishing to use their own classes as keys in hashed collections should supply a _hz_keyhash() overload for them, which must return
+//	the same hash for any two keys the == operator considers equal.
+
+inline	uint64_t	_hz_hashmix	(uint64_t h)
+{
+	//	Final avalanche step (as per the MurmurHash3 64-bit finalizer) so that every bit of the input affects every bit of the hash.
+
+	h ^= h >> 33 ;
+	h *= 0xff51afd7ed558ccdULL ;
+	h ^= h >> 33 ;
+	h *= 0xc4ceb9fe1a85ec53ULL ;
+	h ^= h >> 33 ;
+	return h ;
+}
+
+inline	uint64_t	_hz_hashbytes	(const void* pBuf, uint32_t nLen)
+{
+	//	Hash an arbitrary byte sequence, taking 8 bytes at a time
+	//
+	//	Arguments:	1)	pBuf	The bytes to hash
+	//				2)	nLen	The number of bytes
+	//
+	//	Returns:	64-bit hash value
+
+	const uchar*	i ;		//	Byte iterator
+	uint64_t		h ;		//	Running hash
+	uint64_t		w ;		//	Current 8-byte word
+
+	h = 0x9e3779b97f4a7c15ULL ^ nLen ;
+
+	for (i = (const uchar*) pBuf ; nLen >= 8 ; nLen -= 8, i += 8)
+	{
+		memcpy(&w, i, 8) ;
+		w *= 0x87c37b91114253d5ULL ;
+		w = (w << 31) | (w >> 33) ;
+		w *= 0x4cf5ad432745937fULL ;
+		h ^= w ;
+		h = ((h << 27) | (h >> 37)) * 5 + 0x52dce729 ;
+	}
+
+	if (nLen)
+	{
+		w = 0 ;
+		memcpy(&w, i, nLen) ;
+		w *= 0x87c37b91114253d5ULL ;
+		w = (w << 31) | (w >> 33) ;
+		w *= 0x4cf5ad432745937fULL ;
+		h ^= w ;
+	}
+
+	return _hz_hashmix(h) ;
+}
+
+template<class KEY>	inline	uint64_t	_hz_keyhash	(const KEY& key)
+{
+	//	Generic key hash. Only valid for keys that are plain values.
+
+	uint64_t	v = 0 ;		//	Key as 64-bit value
+
+	if (sizeof(KEY) > 8)
+		return _hz_hashbytes(&key, sizeof(KEY)) ;
+
+	memcpy(&v, &key, sizeof(KEY) < 8 ? sizeof(KEY) : 8) ;
+	return _hz_hashmix(v) ;
+}
+
+inline	uint64_t	_hz_keyhash	(const hzString& key)	{ return _hz_hashbytes(*key, key.Length()) ; }
+inline	uint64_t	_hz_keyhash	(const hzEmaddr& key)	{ return _hz_hashbytes(*key, key.Length()) ; }
+inline	uint64_t	_hz_keyhash	(const hzIpaddr& key)	{ return _hz_hashmix((uint32_t) key) ; }
+inline	uint64_t	_hz_keyhash	(const hzSysID& key)	{ return _hz_hashmix((uint64_t) key) ; }
+
+#endif	//	hzKeyhash_h
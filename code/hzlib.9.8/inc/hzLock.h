@@ -189,9 +189,12 @@ class	hzLocker
 {
 	//	Category:	Synchronization
 	//
-	//	Pure base class for unifying hzLockRW (read/write lock without diagnostics) and hzLockRWD (read/write lock with diagnostics)
+	//	Pure base class for unifying hzLockRW (read/write lock without diagnostics) and hzLockRWD (read/write lock with diagnostics). The destructor is virtual
+	//	as collections hold and delete their locks through a hzLocker pointer.
 
 public:
+	virtual	~hzLocker	(void)	{}
+
 	virtual	hzEcode	LockWrite	(int32_t timeout = -1) = 0 ;
 	virtual	hzEcode	LockRead	(int32_t timeout = -1) = 0 ;
 	virtual	void	Kill		(void) = 0 ;
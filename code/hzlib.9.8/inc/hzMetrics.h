@@ -0,0 +1,175 @@
+//
+//	File:	hzMetrics.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzMetrics_h
+#define hzMetrics_h
+
+#include "hzBasedefs.h"
+#include "hzChain.h"
+
+//	Synopsis:	Server Metrics
+//
+//	hzMetrics aggregates the timings and counts of the connections served by hzIpServer, so that latency (particularly tail latency) and error rates can be
+//	monitored without recourse to the logs. For each listening port there are request, byte, connection and error counters, together with a latency histogram
+//	for each phase of a request as timed by hzIpConnex: accept (connection to first byte), receive, process and transmit.
+//
+//	The histograms (hzLatencyHist) are in the style of HdrHistogram. Values in nanoseconds are placed in buckets which are exact below 32ns and above that, 16
+//	to each power of 2, so the value of any bucket is known to within 1 part in 16 (about 6%) across the whole range of 32ns to about 37 minutes. Recording a
+//	value is a matter of a count leading zeros instruction and three additions.
+//
+//	Recording is lock free. Each thread that records a value claims its own row of hzPortStats blocks (one per port) on first use, so each block only ever has
+//	a single writer and the counters are updated by plain (relaxed atomic) stores. Readers, such as Export(), sum the blocks of all rows for a port. A reader
+//	may see a block part way through an update, so totals taken at the same moment may differ by a request or so. This is of no consequence for monitoring.
+//
+//	Nothing is recorded until hzMetrics::Init() is called, so the cost to a server that does not use metrics is a single test per request. Init() may place
+//	the blocks in a hzShmem segment so that an external process can read them directly. The segment begins with a hzMetricsHdr, followed by m_nRows rows of
+//	m_nPorts hzPortStats blocks. A block is in use if its m_nPort is non-zero. Alternatively, hzIpServer::AddPortMetrics() adds an admin HTTP port on which
+//	the metrics are served in Prometheus text format, as produced by Export().
+
+#define	HZ_METRIC_SUBBITS	4		//	Bits of sub-bucket (16 buckets per power of 2)
+#define	HZ_METRIC_MAXEXP	40		//	Highest power of 2 with buckets (2^41 ns is about 37 minutes)
+#define	HZ_METRIC_BUCKETS	((HZ_METRIC_MAXEXP - HZ_METRIC_SUBBITS + 2) << HZ_METRIC_SUBBITS)
+#define	HZ_METRIC_ROWS		32		//	Maximum number of recording threads
+#define	HZ_METRIC_PORTS		16		//	Maximum number of ports per thread
+#define	HZ_METRIC_MAGIC		"HZMETRIC"
+
+enum	hzMetricPhase
+{
+	//	Category:	Internet
+	//
+	//	Phases of a request, as timed by hzIpConnex
+
+	HZ_PHASE_ACPT,		//	Connection accepted to first byte of first request received (TimeAcpt)
+	HZ_PHASE_RECV,		//	First to last byte of request received (TimeRecv)
+	HZ_PHASE_PROC,		//	Request received to response begun (TimeProc)
+	HZ_PHASE_XMIT,		//	Response begun to response written (TimeXmit)
+	HZ_PHASE_COUNT
+} ;
+
+class	hzLatencyHist
+{
+	//	Category:	System
+	//
+	//	HDR style histogram of nanosecond latencies (see synopsis above). This is a plain structure as it may be placed in shared memory.
+
+public:
+	uint64_t	m_nCount ;						//	Number of values recorded
+	uint64_t	m_nSum ;						//	Sum of values recorded
+	uint64_t	m_nMax ;						//	Highest value recorded
+	uint64_t	m_Buckets[HZ_METRIC_BUCKETS] ;	//	Bucket counts
+
+	static	uint32_t	Bucket	(uint64_t nsVal)
+	{
+		//	Bucket for a value. Values below 2^(SUBBITS+1) have a bucket each. Above that, each power of 2 is divided into 2^SUBBITS buckets.
+
+		uint32_t	nExp ;		//	Highest set bit
+
+		if (nsVal < (2ULL << HZ_METRIC_SUBBITS))
+			return (uint32_t) nsVal ;
+
+		nExp = 63 - __builtin_clzll(nsVal) ;
+		if (nExp > HZ_METRIC_MAXEXP)
+			return HZ_METRIC_BUCKETS - 1 ;
+
+		return ((nExp - HZ_METRIC_SUBBITS + 1) << HZ_METRIC_SUBBITS) + ((nsVal >> (nExp - HZ_METRIC_SUBBITS)) & ((1 << HZ_METRIC_SUBBITS) - 1)) ;
+	}
+
+	static	uint64_t	Lower	(uint32_t nBucket) ;
+
+	void	Record	(uint64_t nsVal)
+	{
+		//	Record a value. There must be only one writer (see synopsis)
+
+		uint32_t	nBkt = Bucket(nsVal) ;	//	Bucket
+
+		__atomic_store_n(&m_Buckets[nBkt], m_Buckets[nBkt] + 1, __ATOMIC_RELAXED) ;
+		__atomic_store_n(&m_nSum, m_nSum + nsVal, __ATOMIC_RELAXED) ;
+		if (nsVal > m_nMax)
+			__atomic_store_n(&m_nMax, nsVal, __ATOMIC_RELAXED) ;
+		__atomic_store_n(&m_nCount, m_nCount + 1, __ATOMIC_RELEASE) ;
+	}
+
+	void		Merge		(const hzLatencyHist& op) ;
+	uint64_t	Quantile	(double q) const ;
+	uint64_t	CountBelow	(uint64_t nsLimit) const ;
+} ;
+
+class	hzPortStats
+{
+	//	Category:	System
+	//
+	//	Counters and phase histograms for one port as recorded by one thread. This is a plain structure as it may be placed in shared memory.
+
+	static	void	_add	(uint64_t& nVar, uint64_t nVal)	{ __atomic_store_n(&nVar, nVar + nVal, __ATOMIC_RELAXED) ; }
+
+public:
+	uint32_t		m_nPort ;					//	Port (0 if block unused)
+	uint32_t		m_nThread ;					//	Recording thread (Linux thread id)
+	uint64_t		m_nConns ;					//	Connections accepted
+	uint64_t		m_nRequests ;				//	Responses completed
+	uint64_t		m_nBytesIn ;				//	Bytes received
+	uint64_t		m_nBytesOut ;				//	Bytes sent
+	uint64_t		m_nErrors ;					//	Failed connections (read/write errors, TLS failures, invalid requests)
+	uint64_t		m_nExpired ;				//	Connections expired
+	hzLatencyHist	m_Phase[HZ_PHASE_COUNT] ;	//	Latency by phase
+
+	void	Conn	(void)			{ _add(m_nConns, 1) ; }
+	void	BytesIn	(uint32_t n)	{ _add(m_nBytesIn, n) ; }
+	void	BytesOut(uint32_t n)	{ _add(m_nBytesOut, n) ; }
+	void	Error	(void)			{ _add(m_nErrors, 1) ; }
+	void	Expired	(void)			{ _add(m_nExpired, 1) ; }
+	void	Request	(void)			{ _add(m_nRequests, 1) ; }
+} ;
+
+struct	hzMetricsHdr
+{
+	//	Category:	System
+	//
+	//	Header of the metrics region (as seen by external readers of the shared memory segment)
+
+	char		m_Magic[8] ;		//	HZ_METRIC_MAGIC
+	uint32_t	m_nVersion ;		//	Layout version (1)
+	uint32_t	m_nRows ;			//	Rows (HZ_METRIC_ROWS)
+	uint32_t	m_nPorts ;			//	Blocks per row (HZ_METRIC_PORTS)
+	uint32_t	m_nBuckets ;		//	Buckets per histogram (HZ_METRIC_BUCKETS)
+	uint32_t	m_nBlockSize ;		//	Size of hzPortStats
+	uint32_t	m_nRowsUsed ;		//	Rows claimed so far
+	uint64_t	m_nsStarted ;		//	Nanosecond epoch of Init()
+} ;
+
+class	hzMetrics
+{
+	//	Category:	System
+	//
+	//	The metrics region and the functions to record and export (see synopsis above). All members are static as there is only the one region per process.
+
+	static	hzMetricsHdr*	s_pHdr ;	//	Start of region
+	static	hzPortStats*	s_pBlocks ;	//	Blocks (row major)
+
+	static	hzPortStats*	_claim	(uint32_t nPort) ;
+
+public:
+	static	hzEcode		Init	(const char* shmName = 0) ;
+	static	bool		Active	(void)	{ return s_pHdr ? true : false ; }
+
+	static	hzPortStats*	Stats	(uint32_t nPort) ;
+
+	static	void	Export	(hzChain& Z) ;
+	static	void	Totals	(hzPortStats& tot, uint32_t nPort) ;
+} ;
+
+#endif	//	hzMetrics_h
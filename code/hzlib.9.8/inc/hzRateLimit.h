@@ -0,0 +1,88 @@
+//
+//	File:	hzRateLimit.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzRateLimit_h
+#define hzRateLimit_h
+
+#include "hzBasedefs.h"
+#include "hzErrcode.h"
+
+//	Synopsis:	Rate Limiting
+//
+//	hzTokenBucket is a token bucket of a given burst (capacity) and refill rate (tokens per second). Each event to be limited takes a token and is refused if
+//	the bucket is empty. The state of the bucket (time of last refill in milliseconds and tokens held in thousandths) is packed into a single 64 bit word and
+//	updated by compare and swap, so a bucket may be shared between threads without a lock. A bucket that has never been used is full.
+//
+//	hzRateLimit applies a token bucket to each of an unbounded population of keys (IP addresses) using bounded memory. In the manner of a count-min sketch,
+//	there are HZ_RATE_DEPTH rows of buckets and each key is hashed to one bucket in each row, by a different hash for each row. An event is allowed only if
+//	every one of the key's buckets has a token. Keys that share a bucket in one row are unlikely to share in another, so a key is only wrongly limited if all
+//	its buckets are shared with busy keys. The memory used is fixed at HZ_RATE_DEPTH * width * 8 bytes no matter how many addresses are seen, so a flood of
+//	connections from spoofed addresses cannot exhaust memory. It can only make limiting stricter for legitimate clients which happen to share buckets.
+//
+//	hzIpServer applies these to each listening socket (see hzIpServer::SetRateLimit) to limit connections to the port, connections from a single address and
+//	messages from a single address.
+
+#define	HZ_RATE_DEPTH	2		//	Rows of the sketch
+#define	HZ_RATE_WIDTH	4096	//	Default buckets per row (power of 2)
+
+class	hzTokenBucket
+{
+	//	Category:	System
+	//
+	//	Lock free token bucket (see synopsis above)
+
+	uint64_t	m_nState ;		//	Time of last refill (msec, upper 32 bits) and milli-tokens held (lower 32 bits). Zero if unused.
+
+public:
+	hzTokenBucket	(void)	{ m_nState = 0 ; }
+
+	void	Reset	(void)	{ __atomic_store_n(&m_nState, 0, __ATOMIC_RELAXED) ; }
+	bool	Take	(uint32_t msNow, uint32_t nRate, uint32_t nBurst, uint32_t nCost = 1) ;
+
+	static	uint32_t	Now	(void) ;
+} ;
+
+class	hzRateLimit
+{
+	//	Category:	System
+	//
+	//	Sketch of token buckets keyed by IP address (see synopsis above)
+
+	hzTokenBucket*	m_pCells ;		//	The buckets (HZ_RATE_DEPTH rows)
+	uint32_t		m_nWidth ;		//	Buckets per row
+	uint32_t		m_nShift ;		//	Hash shift (32 - log2 of width)
+	uint32_t		m_nRate ;		//	Tokens per second
+	uint32_t		m_nBurst ;		//	Bucket capacity
+
+	//	Prevent copies
+	hzRateLimit	(const hzRateLimit&) ;
+	hzRateLimit&	operator=	(const hzRateLimit&) ;
+
+public:
+	hzRateLimit	(void) ;
+	~hzRateLimit	(void) ;
+
+	hzEcode	Init	(uint32_t nRate, uint32_t nBurst, uint32_t nWidth = HZ_RATE_WIDTH) ;
+
+	bool	Take	(uint32_t nKey, uint32_t nCost = 1) ;
+
+	bool		Active	(void) const	{ return m_pCells ? true : false ; }
+	uint32_t	Rate	(void) const	{ return m_nRate ; }
+	uint32_t	Burst	(void) const	{ return m_nBurst ; }
+} ;
+
+#endif	//	hzRateLimit_h
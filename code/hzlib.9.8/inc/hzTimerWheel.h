@@ -0,0 +1,107 @@
+//
+//	File:	hzTimerWheel.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzTimerWheel_h
+#define hzTimerWheel_h
+
+#include "hzBasedefs.h"
+
+//	Synopsis:	Timer Wheel
+//
+//	The hzTimerWheel class manages large numbers of deadlines (such as the expiry times of client connections held by hzIpServer), at a cost that does not
+//	depend on how many deadlines are outstanding. Time is divided into ticks of 2^24 nanoseconds (about 16.8 milliseconds) and the wheel comprises four levels
+//	of 64 slots. Level 0 holds deadlines due within the next 64 ticks (about a second), one slot per tick. Each higher level has slots 64 times as wide as the
+//	level below, so the four levels together span about 78 hours. Deadlines further out are parked in level 3 and re-examined as they come round.
+//
+//	A deadline is represented by a hzTimer, which the owning object embeds so that arming and cancelling involve no allocation. Each slot is a doubly linked
+//	list of hzTimer instances so Arm() and Cancel() are O(1). As time advances (by calls to Expire), the slots of level 0 are visited in turn and whenever the
+//	level 0 index wraps, the next slot of level 1 is cascaded (its timers redistributed to level 0). Level 2 cascades into level 1 in the same way and so on.
+//	Expire() returns the timers that have fallen due as a chain (linked by m_pNext). These are no longer armed and the caller may re-arm them.
+//
+//	NextTimeout() gives the number of milliseconds until the earliest slot that could contain a due timer, which a serving loop can use as the timeout for
+//	its epoll_wait() call. This means an idle server holding many keep-alive connections sleeps until something is actually due.
+//
+//	hzTimerWheel is not thread safe. It is intended to be owned and operated by a single serving thread.
+
+#define	HZ_TWHEEL_SHIFT		24		//	Nanoseconds to ticks (tick = 2^24 ns)
+#define	HZ_TWHEEL_BITS		6		//	Bits of tick per level
+#define	HZ_TWHEEL_SLOTS		64		//	Slots per level
+#define	HZ_TWHEEL_LEVELS	4		//	Number of levels
+
+class	hzTimerWheel ;
+
+class	hzTimer
+{
+	//	Category:	System
+	//
+	//	A single deadline within a hzTimerWheel. Objects needing a deadline embed a hzTimer and set m_pObj so that when the timer falls due, the object can be
+	//	found. A hzTimer that is destructed while armed removes itself from the wheel.
+
+public:
+	hzTimer*		m_pNext ;		//	Next timer in slot (or in the chain returned by Expire)
+	hzTimer*		m_pPrev ;		//	Previous timer in slot
+	hzTimerWheel*	m_pWheel ;		//	Wheel the timer is armed in (null if not armed)
+	void*			m_pObj ;		//	Object the timer belongs to
+	uint64_t		m_nTick ;		//	Tick at which the timer falls due
+	uint16_t		m_nSlot ;		//	Level and slot (level * HZ_TWHEEL_SLOTS + slot) the timer is in
+
+	hzTimer	(void)
+	{
+		m_pNext = m_pPrev = 0 ;
+		m_pWheel = 0 ;
+		m_pObj = 0 ;
+		m_nTick = 0 ;
+		m_nSlot = 0 ;
+	}
+
+	~hzTimer	(void) ;
+
+	bool	Armed	(void) const	{ return m_pWheel ? true : false ; }
+} ;
+
+class	hzTimerWheel
+{
+	//	Category:	System
+	//
+	//	Hierarchical timer wheel (see synopsis above)
+
+	hzTimer*	m_Slots[HZ_TWHEEL_LEVELS][HZ_TWHEEL_SLOTS] ;	//	Slot lists
+
+	uint64_t	m_nNow ;		//	Next tick to be processed
+	uint32_t	m_nCount ;		//	Number of armed timers
+
+	void	_place		(hzTimer* pTm) ;
+	void	_cascade	(uint32_t nLevel) ;
+
+	//	Prevent copies
+	hzTimerWheel	(const hzTimerWheel&) ;
+	hzTimerWheel&	operator=	(const hzTimerWheel&) ;
+
+public:
+	hzTimerWheel	(void) ;
+	~hzTimerWheel	(void) ;
+
+	void		Init		(uint64_t nsNow) ;
+	void		Arm			(hzTimer* pTm, uint64_t nsWhen) ;
+	void		Cancel		(hzTimer* pTm) ;
+	hzTimer*	Expire		(uint64_t nsNow) ;
+	int32_t		NextTimeout	(uint64_t nsNow) const ;
+
+	uint32_t	Count	(void) const	{ return m_nCount ; }
+} ;
+
+#endif	//	hzTimerWheel_h
@@ -18,6 +18,8 @@
 #ifndef hzTmplArray_h
 #define hzTmplArray_h
 
+#include <new>
+
 #include "hzString.h"
 #include "hzLock.h"
 #include "hzProcess.h"
@@ -28,90 +30,421 @@
 
 void	Fatal	(const char* va_alist ...) ;
 
-#define HZ_ARRAY_NODESIZE	8
+/*
+**	Definitions
+*/
 
-template<class OBJ> class hzArray
+#define HZ_ARRAY_CHUNKSIZE	4096	//	Target size in bytes of a chunk (chunked storage mode)
+#define HZ_ARRAY_DIRSIZE	16		//	Initial size of the chunk directory
+#define HZ_ARRAY_CONTIGMIN	16		//	Initial capacity of a contiguous buffer (and number of elements first constructed in the first chunk)
+
+enum	hzStoreMode
+{
+	//	Storage modes for hzArray and hzVect
+
+	HZ_STORE_ISAM,		//	Elements held in an ISAM (hzVect only and the hzVect default)
+	HZ_STORE_CHUNK,		//	Elements held in fixed chunks of HZ_ARRAY_CHUNKSIZE bytes, addressed by a flat directory (the hzArray default)
+	HZ_STORE_CONTIG		//	Elements held in a single contiguous buffer, doubled in size when full
+} ;
+
+/*
+**	The array store
+*/
+
+template<class OBJ> class _hz_array_store
 {
 	//	Category:	Object Collection
 	//
-	//	The hzArray class template facilitates an array of objects. The objects are not stored in an actual array (of continuous memory) but in a tree of blocks
-	//	based on absolute positioning. On the highest level the data blocks comprise only an array of HZ_ARRAY_NODESIZE objects while on the inner levels the index
-	//	blocks comprise nothing but HZ_ARRAY_NODESIZE pointers to the blocks above. With a population of 0 the root of the tree is null and the hzArray has a level
-	//	of zero. With a population between 1 and HZ_ARRAY_NODESIZE, the root points to a single data block and the hzArray now has 1 level. As the population rises
-	//	above HZ_ARRAY_NODESIZE the level goes up to 2 and from now on the root is an index node. A new level is created when the root splits into two nodes, which
-	//	happens when the population goes above HZ_ARRAY_NODESIZE to the power of the current level.
+	//	The _hz_array_store provides the element storage for hzArray, and for hzVect in the array storage modes. Elements are addressed by absolute position and
+	//	are held either in chunks (HZ_STORE_CHUNK), or in a single contiguous buffer (HZ_STORE_CONTIG).
 	//
-	//	Note that hzArray does not support an Insert() or a Delete() method. It is intended only to be aggregated to by a series of appends and then accesses by
-	//	the [] operator. The hzArray is thus an unordered collection.
+	//	In chunked mode, each chunk holds a power of two number of elements, amounting to as close to HZ_ARRAY_CHUNKSIZE bytes as possible (but at least one),
+	//	so the position of an element is resolved by a shift and a mask, and a single lookup in the chunk directory. Chunks never move so element addresses are
+	//	stable. So that small arrays do not each pay for constructing a whole chunk and a directory, the first chunk is reserved as raw memory (m_pBuf) and its
+	//	elements are constructed in place, HZ_ARRAY_CONTIGMIN at first and doubling. Only once the first chunk is full is a directory created, adopting it as
+	//	chunk 0. As the first chunk is never reallocated, element addresses are stable from the first append. In contiguous mode the buffer is doubled (and the
+	//	elements copied) when full, so element addresses are only stable between appends. Sequential access in contiguous mode is as for a plain C array.
+	//
+	//	Writers (Append, Insert, Delete and Clear) are serialized by a simple lock. Readers (InSitu and Count) do not lock. This is safe for appends as the new
+	//	element is in place before the population is advanced, and because when the chunk directory or the contiguous buffer is replaced, the old one is kept
+	//	until Clear() or destruction, so a reader that fetched the old address still reads valid (if stale) memory. Such retired areas sum to no more than the
+	//	current area. In a single threaded program they are freed at once. Insert and Delete shift elements and so are not safe against concurrent readers.
 
-	struct	_hz_ar_data
+	struct	_retired
 	{
-		//	Block of HZ_ARRAY_NODESIZE objects
+		//	Superseded chunk directory or contiguous buffer
 
-		OBJ	m_Objs[HZ_ARRAY_NODESIZE] ;		//	Objects held in the array
+		_retired*	next ;		//	Next retired area
+		OBJ**		m_pDir ;	//	Old chunk directory (chunked mode)
+		OBJ*		m_pBuf ;	//	Old buffer (contiguous mode)
 	} ;
 
-	struct	_hz_ar_indx
-	{
-		//	Array of pointers (to either index or data blocks)
+	OBJ**		m_pDir ;		//	Chunk directory (chunked mode)
+	OBJ*		m_pBuf ;		//	Element buffer (contiguous mode) or first chunk (chunked mode)
+	_retired*	m_pRetired ;	//	Superseded directories or buffers
+	hzLockS		m_Lock ;		//	Writer lock
+	uint32_t	m_nCount ;		//	Population
+	uint32_t	m_nCapacity ;	//	Number of elements that can be held without growth
+	uint32_t	m_nDirSize ;	//	Size of chunk directory
+	uint32_t	m_nChunks ;		//	Number of chunks allocated
+	uint32_t	m_nShift ;		//	Element position to chunk number shift
+	uint32_t	m_nMask ;		//	Element position to chunk slot mask
+	hzStoreMode	m_eMode ;		//	Storage mode
 
-		void*	m_Ptrs[HZ_ARRAY_NODESIZE] ;	//	The pointers
-	} ;
+	//	Prevent copies
+	_hz_array_store	(const _hz_array_store&) ;
+	_hz_array_store&	operator=	(const _hz_array_store&) ;
 
-	struct	_array_ca
+	void	_retire	(OBJ** pDir, OBJ* pBuf)
 	{
-		//	Array control area
+		//	Retire a superseded directory or buffer. This is kept until Clear() if other threads may be reading.
 
-		hzLockRW	m_Lock ;		//	Read/Write lock
-		//hzLocker*	m_pLock ;		//	Locking (off by default)
-		void*		m_pRoot ;		//	Root node
-		uint32_t	m_nFactor ;		//	1 for level 0, HZ_ARRAY_NODESIZE for level 1, HZ_ARRAY_NODESIZE squared for 2 etc
-		uint32_t	m_nNoDN ;		//	Number of data nodes
-		uint32_t	m_nNoIN ;		//	Number of index nodes
-		uint32_t	m_nCount ;		//	Number of items
-		uint32_t	m_nLevel ;		//	The level of the array
-		_m uint32_t	m_nCopy ;		//	Number of copies
-		OBJ			m_Default ;		//	Default (empty) element
-
-		//_array_ca	(void)	{ m_pRoot = 0 ; m_pLock = 0 ; m_nLevel = m_nNoDN = m_nNoIN = m_nCount = m_nCopy = 0 ; m_nFactor = 1 ; }
-		_array_ca	(void)	{ m_pRoot = 0 ; m_nLevel = m_nNoDN = m_nNoIN = m_nCount = m_nCopy = 0 ; m_nFactor = 1 ; }
-		~_array_ca	(void)	{}
+		_retired*	pR ;	//	Retired area
 
-		/*
-		void	SetLock	(hzLockOpt eLock)
+		if (!_hzGlobal_MT)
 		{
-			if (eLock == HZ_ATOMIC)	m_pLock = new hzLockRW() ;
-			if (eLock == HZ_MUTEX)	m_pLock = new hzLockRWD() ;
+			if (pDir)	delete [] pDir ;
+			if (pBuf)	delete [] pBuf ;
+			return ;
 		}
-		*/
 
-		//void	Lock	(void)	{ if (m_pLock) m_pLock->LockWrite() ; }
-		//void	Unlock	(void)	{ if (m_pLock) m_pLock->Unlock() ; }
-		void	Lock	(void)	{ m_Lock.LockWrite() ; }
-		void	Unlock	(void)	{ m_Lock.Unlock() ; }
-	} ;
+		pR = new _retired() ;
+		pR->m_pDir = pDir ;
+		pR->m_pBuf = pBuf ;
+		pR->next = m_pRetired ;
+		m_pRetired = pR ;
+	}
 
-	void	_clear	(void* pN, uint32_t nLevel, uint32_t maxLevel)
+	OBJ*	_at	(uint32_t nPosn) const
 	{
-		_hz_ar_indx*	pIdx ;	//	Current index block pointer
-		_hz_ar_data*	pDN ;	//	Current object block pointer
-		uint32_t		n ;		//	Object block iterator
+		//	Address of element at the given position (which must be within the capacity)
 
-		if (!mx)
+		if (m_eMode == HZ_STORE_CONTIG || !m_nChunks)
+			return m_pBuf + nPosn ;
+		return m_pDir[nPosn >> m_nShift] + (nPosn & m_nMask) ;
+	}
+
+	void	_grow	(void)
+	{
+		//	Increase capacity. In contiguous mode this replaces the buffer with one twice the size. In chunked mode while the array is within its first chunk,
+		//	this constructs further elements in place in the reserved first chunk. Otherwise this adds a chunk (and if needed, replaces the directory with one
+		//	twice the size). The new directory or buffer is published to readers only once populated.
+
+		_hzfunc("_hz_array_store::_grow") ;
+
+		OBJ**		pDir ;	//	New directory
+		OBJ*		pBuf ;	//	New buffer
+		uint32_t	nCap ;	//	New capacity
+		uint32_t	n ;		//	Element or chunk iterator
+
+		if (m_eMode == HZ_STORE_CHUNK && m_nCapacity < (m_nMask + 1))
+		{
+			if (!m_pBuf)
+			{
+				pBuf = (OBJ*) ::operator new (sizeof(OBJ) * (m_nMask + 1)) ;
+				if (!pBuf)
+					Fatal("%s. Could not reserve first chunk\n", *_fn) ;
+				__atomic_store_n(&m_pBuf, pBuf, __ATOMIC_RELEASE) ;
+			}
+
+			nCap = m_nCapacity ? m_nCapacity * 2 : HZ_ARRAY_CONTIGMIN ;
+			if (nCap > (m_nMask + 1))
+				nCap = m_nMask + 1 ;
+
+			for (n = m_nCapacity ; n < nCap ; n++)
+				new (m_pBuf + n) OBJ() ;
+			m_nCapacity = nCap ;
+			return ;
+		}
+
+		if (m_eMode == HZ_STORE_CONTIG)
+		{
+			nCap = m_nCapacity ? m_nCapacity * 2 : HZ_ARRAY_CONTIGMIN ;
+			if (nCap < m_nCapacity)
+				Fatal("%s. Array capacity exceeded\n", *_fn) ;
+
+			pBuf = new OBJ[nCap] ;
+			if (!pBuf)
+				Fatal("%s. Could not allocate buffer of %u elements\n", *_fn, nCap) ;
+
+			for (n = 0 ; n < m_nCount ; n++)
+				pBuf[n] = m_pBuf[n] ;
+
+			if (m_pBuf)
+				_retire(0, m_pBuf) ;
+			__atomic_store_n(&m_pBuf, pBuf, __ATOMIC_RELEASE) ;
+			m_nCapacity = nCap ;
 			return ;
-		if (nLevel < maxLevel)
+		}
+
+		if (m_nChunks == m_nDirSize)
 		{
-			pIdx = (_hz_ar_indx*) pN ;
-			for (n = 0 ; n < HZ_ARRAY_NODESIZE && pIdx->m_Ptrs[n] ; n++)
-				_clear(pIdx->m_Ptrs[n], nLevel+1, maxLevel) ;
+			nCap = m_nDirSize ? m_nDirSize * 2 : HZ_ARRAY_DIRSIZE ;
+			pDir = new OBJ*[nCap] ;
+			if (!pDir)
+				Fatal("%s. Could not allocate directory of %u chunks\n", *_fn, nCap) ;
+
+			for (n = 0 ; n < m_nChunks ; n++)
+				pDir[n] = m_pDir[n] ;
+			for (; n < nCap ; n++)
+				pDir[n] = 0 ;
+
+			//	The first directory adopts the full first chunk. This remains in m_pBuf so readers that have yet to see the directory can still use it.
+			if (!m_nChunks)
+				pDir[0] = m_pBuf ;
+
+			if (m_pDir)
+				_retire(m_pDir, 0) ;
+			__atomic_store_n(&m_pDir, pDir, __ATOMIC_RELEASE) ;
+			m_nDirSize = nCap ;
 		}
-		else
+
+		if (!m_nChunks)
+			m_nChunks = 1 ;
+
+		m_pDir[m_nChunks] = new OBJ[m_nMask + 1] ;
+		if (!m_pDir[m_nChunks])
+			Fatal("%s. Could not allocate chunk\n", *_fn) ;
+		m_nChunks++ ;
+		m_nCapacity += (m_nMask + 1) ;
+	}
+
+	void	_clear	(void)
+	{
+		//	Free all elements, chunks, directories and buffers
+
+		_retired*	pR ;	//	Retired area
+		uint32_t	nCap ;	//	Elements constructed in the first chunk
+		uint32_t	n ;		//	Element or chunk iterator
+
+		if (m_eMode == HZ_STORE_CONTIG)
 		{
-			pDN = (_hz_ar_data*) pN ; //pIdx->m_Ptrs[n] ;
-			delete pDN ;
+			if (m_pBuf)
+				delete [] m_pBuf ;
 		}
+		else if (m_pBuf)
+		{
+			//	The first chunk was reserved as raw memory and its elements constructed in place
+			nCap = m_nChunks ? m_nMask + 1 : m_nCapacity ;
+			for (n = 0 ; n < nCap ; n++)
+				m_pBuf[n].~OBJ() ;
+			::operator delete (m_pBuf) ;
+		}
+
+		for (n = 1 ; n < m_nChunks ; n++)
+			delete [] m_pDir[n] ;
+		if (m_pDir)
+			delete [] m_pDir ;
+
+		for (; m_pRetired ; m_pRetired = pR)
+		{
+			pR = m_pRetired->next ;
+			if (m_pRetired->m_pDir)	delete [] m_pRetired->m_pDir ;
+			if (m_pRetired->m_pBuf)	delete [] m_pRetired->m_pBuf ;
+			delete m_pRetired ;
+		}
+
+		m_pDir = 0 ;
+		m_pBuf = 0 ;
+		m_nCount = m_nCapacity = m_nDirSize = m_nChunks = 0 ;
+	}
+
+public:
+	_hz_array_store	(void)
+	{
+		uint32_t	nPer ;	//	Elements per chunk
+
+		m_pDir = 0 ;
+		m_pBuf = 0 ;
+		m_pRetired = 0 ;
+		m_nCount = m_nCapacity = m_nDirSize = m_nChunks = 0 ;
+		m_eMode = HZ_STORE_CHUNK ;
+
+		nPer = sizeof(OBJ) < HZ_ARRAY_CHUNKSIZE ? HZ_ARRAY_CHUNKSIZE / sizeof(OBJ) : 1 ;
+		for (m_nShift = 0 ; (2u << m_nShift) <= nPer ; m_nShift++) ;
+		m_nMask = (1 << m_nShift) - 1 ;
 	}
 
+	~_hz_array_store	(void)	{ _clear() ; }
+
+	hzEcode	SetMode	(hzStoreMode eMode)
+	{
+		//	Set the storage mode. This is only possible while the store is empty.
+		//
+		//	Arguments:	1)	eMode	Either HZ_STORE_CHUNK or HZ_STORE_CONTIG
+		//
+		//	Returns:	E_ARGUMENT	If the mode is not an array storage mode
+		//				E_SEQUENCE	If the store is not empty
+		//				E_OK		If the mode is set
+
+		if (eMode != HZ_STORE_CHUNK && eMode != HZ_STORE_CONTIG)
+			return E_ARGUMENT ;
+		if (m_nCapacity)
+			return E_SEQUENCE ;
+		m_eMode = eMode ;
+		return E_OK ;
+	}
+
+	void	Clear	(void)
+	{
+		if (_hzGlobal_MT) m_Lock.Lock() ;
+		_clear() ;
+		if (_hzGlobal_MT) m_Lock.Unlock() ;
+	}
+
+	void	Empty	(const OBJ& null)
+	{
+		//	Remove all elements but keep the chunks (or buffer) for reuse. The vacated slots are set to the supplied null value so that the elements release
+		//	anything they hold.
+		//
+		//	Arguments:	1)	null	Value to leave in the vacated slots
+
+		uint32_t	n ;		//	Element iterator
+
+		if (_hzGlobal_MT) m_Lock.Lock() ;
+
+		n = m_nCount ;
+		__atomic_store_n(&m_nCount, 0, __ATOMIC_RELEASE) ;
+		while (n--)
+			*_at(n) = null ;
+
+		if (_hzGlobal_MT) m_Lock.Unlock() ;
+	}
+
+	hzEcode	Append	(const OBJ& obj)
+	{
+		//	Add an element at the end. The population is only advanced once the element is in place.
+		//
+		//	Arguments:	1)	obj	Element to add
+		//
+		//	Returns:	E_OK
+
+		if (_hzGlobal_MT) m_Lock.Lock() ;
+
+		if (m_nCount == m_nCapacity)
+			_grow() ;
+		*_at(m_nCount) = obj ;
+		__atomic_store_n(&m_nCount, m_nCount + 1, __ATOMIC_RELEASE) ;
+
+		if (_hzGlobal_MT) m_Lock.Unlock() ;
+		return E_OK ;
+	}
+
+	hzEcode	Insert	(const OBJ& obj, uint32_t nPosn)
+	{
+		//	Insert an element at the given position, moving all elements at or above the position up by one.
+		//
+		//	Arguments:	1)	obj		Element to add
+		//				2)	nPosn	Position of new element
+		//
+		//	Returns:	E_RANGE	If the position is beyond the end
+		//				E_OK	If the element was inserted
+
+		uint32_t	n ;		//	Element iterator
+
+		if (_hzGlobal_MT) m_Lock.Lock() ;
+
+		if (nPosn > m_nCount)
+		{
+			if (_hzGlobal_MT) m_Lock.Unlock() ;
+			return E_RANGE ;
+		}
+
+		if (m_nCount == m_nCapacity)
+			_grow() ;
+		for (n = m_nCount ; n > nPosn ; n--)
+			*_at(n) = *_at(n-1) ;
+		*_at(nPosn) = obj ;
+		__atomic_store_n(&m_nCount, m_nCount + 1, __ATOMIC_RELEASE) ;
+
+		if (_hzGlobal_MT) m_Lock.Unlock() ;
+		return E_OK ;
+	}
+
+	hzEcode	Delete	(uint32_t nPosn, const OBJ& null)
+	{
+		//	Delete the element at the given position, moving all elements above the position down by one.
+		//
+		//	Arguments:	1)	nPosn	Position of element to delete
+		//				2)	null	Value to leave in the vacated last slot
+		//
+		//	Returns:	E_NOTFOUND	If the position is beyond the end
+		//				E_OK		If the element was deleted
+
+		uint32_t	n ;		//	Element iterator
+
+		if (_hzGlobal_MT) m_Lock.Lock() ;
+
+		if (nPosn >= m_nCount)
+		{
+			if (_hzGlobal_MT) m_Lock.Unlock() ;
+			return E_NOTFOUND ;
+		}
+
+		__atomic_store_n(&m_nCount, m_nCount - 1, __ATOMIC_RELEASE) ;
+		for (n = nPosn ; n < m_nCount ; n++)
+			*_at(n) = *_at(n+1) ;
+		*_at(m_nCount) = null ;
+
+		if (_hzGlobal_MT) m_Lock.Unlock() ;
+		return E_OK ;
+	}
+
+	OBJ*	InSitu	(uint32_t nPosn) const
+	{
+		//	Lock-free read. Return the address of the element at the given position or NULL if out of range.
+
+		OBJ**	pDir ;	//	Chunk directory
+
+		if (nPosn >= __atomic_load_n(&m_nCount, __ATOMIC_ACQUIRE))
+			return 0 ;
+
+		if (m_eMode == HZ_STORE_CONTIG)
+			return __atomic_load_n(&m_pBuf, __ATOMIC_ACQUIRE) + nPosn ;
+
+		//	A chunked array within its first chunk has no directory as yet
+		pDir = __atomic_load_n(&m_pDir, __ATOMIC_ACQUIRE) ;
+		if (!pDir)
+			return __atomic_load_n(&m_pBuf, __ATOMIC_ACQUIRE) + nPosn ;
+		return pDir[nPosn >> m_nShift] + (nPosn & m_nMask) ;
+	}
+
+	//	Diagnostics
+	hzStoreMode	Mode		(void) const	{ return m_eMode ; }
+	uint32_t	Count		(void) const	{ return __atomic_load_n(&m_nCount, __ATOMIC_ACQUIRE) ; }
+	uint32_t	Capacity	(void) const	{ return m_nCapacity ; }
+	uint32_t	Chunks		(void) const	{ return m_nChunks ? m_nChunks : (m_pBuf ? 1 : 0) ; }
+	uint32_t	PerChunk	(void) const	{ return m_eMode == HZ_STORE_CONTIG ? m_nCapacity : m_nMask + 1 ; }
+} ;
+
+/*
+**	The hzArray template
+*/
+
+template<class OBJ> class hzArray
+{
+	//	Category:	Object Collection
+	//
+	//	The hzArray class template facilitates an array of objects, held in an _hz_array_store. By default the objects are held in chunks of around 4K bytes
+	//	addressed by a flat directory, so the position of an object is resolved with a single directory lookup and objects never move. Alternatively, where
+	//	the array is to be traversed sequentially and pointers to objects are not retained across appends, the objects can be held in a contiguous buffer
+	//	(HZ_STORE_CONTIG), doubled in size as needed. In both modes, the [] operator, InSitu() and Count() do not lock.
+	//
+	//	Note that hzArray does not support an Insert() or a Delete() method. It is intended only to be aggregated to by a series of appends and then accesses by
+	//	the [] operator. The hzArray is thus an unordered collection.
+
+	struct	_array_ca
+	{
+		//	Array control area
+
+		_hz_array_store<OBJ>	m_Store ;	//	The objects
+		_m uint32_t				m_nCopy ;	//	Number of copies
+		OBJ						m_Default ;	//	Default (empty) element
+
+		_array_ca	(void)	{ m_nCopy = 0 ; }
+		~_array_ca	(void)	{}
+	} ;
+
 	_array_ca*	mx ;		//	The actual array
 
 	//	Prevent copies
@@ -119,50 +452,50 @@ template<class OBJ> class hzArray
 	hzArray<OBJ>&	operator=	(const hzArray<OBJ>& op) ;
 
 public:
-	//hzArray	(hzLockOpt eLock = HZ_NOLOCK)
 	hzArray	(void)
 	{
 		_hzGlobal_Memstats.m_numArrays++ ;
 		mx = new _array_ca() ;
-		//mx->SetLock(eLock) ;
+		_hzGlobal_Memstats.m_numArrayDA++ ;
+	}
+
+	hzArray	(hzStoreMode eMode)
+	{
+		_hzGlobal_Memstats.m_numArrays++ ;
+		mx = new _array_ca() ;
+		mx->m_Store.SetMode(eMode) ;
+		_hzGlobal_Memstats.m_numArrayDA++ ;
 	}
 		
 	~hzArray	(void)
 	{
-		mx->Lock() ;
 		if (mx->m_nCopy)
-		{
 			mx->m_nCopy-- ;
-			mx->Unlock() ;
-		}
 		else
 		{
-			//Clear() ;
-			if (mx->m_pRoot)
-				_clear(mx->m_pRoot, 1, mx->m_nLevel) ;
-
 			_hzGlobal_Memstats.m_numArrayDA-- ;
-			mx->Unlock() ;
 			delete mx ;
 		}
 		_hzGlobal_Memstats.m_numArrays-- ;
 	}
 
-	void	SetDefault	(OBJ dflt)		{ mx->m_Default = dflt ; }
+	void	SetDefault	(OBJ dflt)				{ mx->m_Default = dflt ; }
+	hzEcode	SetMode		(hzStoreMode eMode)		{ return mx->m_Store.SetMode(eMode) ; }
 
 	void	Clear	(void)
 	{
 		_hzfunc("hzArray::Clear") ;
 
-		//	Clear all nodes
-		mx->Lock() ;
-			if (mx->m_pRoot)
-				_clear(mx->m_pRoot, 1, mx->m_nLevel) ;
+		mx->m_Store.Clear() ;
+	}
+
+	void	Empty	(void)
+	{
+		//	Remove all objects but retain the storage, so an array that is repeatedly filled and emptied does not allocate once it has reached its working size
+
+		_hzfunc("hzArray::Empty") ;
 
-			mx->m_pRoot = 0 ;
-			mx->m_nLevel = 0 ;
-			mx->m_nFactor = 1 ;
-		mx->Unlock() ;
+		mx->m_Store.Empty(mx->m_Default) ;
 	}
 
 	hzEcode	Add	(const OBJ& obj)
@@ -173,156 +506,36 @@ public:
 
 		_hzfunc("hzArray::Add") ;
 
-		_hz_ar_data*	pDN ;	//	Data node
-		_hz_ar_indx*	pIdx ;	//	Index node
-
-		uint32_t	x ;			//	Position so far
-		uint32_t	n ;			//	Offest at current level
-		uint32_t	f ;			//	Division factor
-		uint32_t	dnAddr ;	//	Slot on higest index node for target data node
-		uint32_t	nSlot ;		//	Target slot on data node
-
 		if (!mx)
 			mx = new _array_ca() ;
 
-		mx->Lock() ;
-
-		//	If no root
-		if (!mx->m_pRoot)
-		{
-			mx->m_nNoDN = 1 ;
-			pDN = new _hz_ar_data() ;
-			pDN->m_Objs[0] = obj ;
-			mx->m_pRoot = pDN ;
-			mx->m_nLevel = 1 ;
-			mx->m_nCount = 1 ;
-			mx->Unlock() ;
-			return E_OK ;
-		}
-
-		if (mx->m_nCount < HZ_ARRAY_NODESIZE)
-		{
-			//	If root is a data node
-			pDN = (_hz_ar_data*) mx->m_pRoot ;
-			pDN->m_Objs[mx->m_nCount] = obj ;
-			mx->m_nCount++ ;
-			mx->Unlock() ;
-			return E_OK ;
-		}
-
-		//	Do we need a new level?
-		if (mx->m_nCount == (mx->m_nFactor * HZ_ARRAY_NODESIZE))
-		{
-			mx->m_nNoIN++ ;
-			pIdx = new _hz_ar_indx() ;
-			pIdx->m_Ptrs[0] = mx->m_pRoot ;
-			mx->m_pRoot = pIdx ;
-			mx->m_nLevel++ ;
-			mx->m_nFactor *= HZ_ARRAY_NODESIZE ;
-		}
-
-		//	Go to highest data node
-		pIdx = (_hz_ar_indx*) mx->m_pRoot ;
-
-		for (x = mx->m_nCount, f = mx->m_nFactor ; f >= (HZ_ARRAY_NODESIZE * HZ_ARRAY_NODESIZE) ;)
-		{
-			n = x/f ; x %= f ; f /= HZ_ARRAY_NODESIZE ;
-
-			if (!pIdx->m_Ptrs[n])
-				{ mx->m_nNoIN++ ; pIdx->m_Ptrs[n] = new _hz_ar_indx() ; }
-			pIdx = (_hz_ar_indx*) pIdx->m_Ptrs[n] ;
-		}
-
-		//	Data node 'address' is 
-		dnAddr = x/f ;
-		if (!pIdx->m_Ptrs[dnAddr])
-			{ mx->m_nNoDN++ ; pIdx->m_Ptrs[dnAddr] = new _hz_ar_data() ; }
-		pDN = (_hz_ar_data*) pIdx->m_Ptrs[dnAddr] ;
-
-		//	Data node slot is remainder
-		nSlot = x%f ;
-		pDN->m_Objs[nSlot] = obj ;
-		mx->m_nCount++ ;
-		mx->Unlock() ;
-		return E_OK ;
+		return mx->m_Store.Append(obj) ;
 	}
 
 	OBJ&	operator[]	(uint32_t nPosn) const
 	{
 		_hzfunc("hzArray::operator[]") ;
 
-		_hz_ar_indx*	pIdx ;	//	Index node pointer
-		_hz_ar_data*	pDN ;	//	Index node pointer
-
-		uint32_t	x ;			//	Position reached so far
-		uint32_t	n ;			//	Offest at current level
-		uint32_t	f ;			//	Division factor
-
-		if (nPosn >= mx->m_nCount)
-			return mx->m_Default ;
-
-		f = mx->m_nFactor ;
-
-		if (f == 1)
-		{
-			pDN = (_hz_ar_data*) mx->m_pRoot ;
-			n = nPosn ;
-			return pDN->m_Objs[nPosn] ;
-		}
-
-		pIdx = (_hz_ar_indx*) mx->m_pRoot ;
+		OBJ*	pObj ;	//	Object pointer
 
-		for (x = nPosn, f = mx->m_nFactor ; f >= (HZ_ARRAY_NODESIZE * HZ_ARRAY_NODESIZE) ;)
-		{
-			n = x/f ; x %= f ; f /= HZ_ARRAY_NODESIZE ;
-			pIdx = (_hz_ar_indx*) pIdx->m_Ptrs[n] ;
-		}
-		pDN = (_hz_ar_data*) pIdx->m_Ptrs[x/f] ;
-		return pDN->m_Objs[x%f] ;
+		pObj = mx->m_Store.InSitu(nPosn) ;
+		return pObj ? *pObj : mx->m_Default ;
 	}
 
 	OBJ*	InSitu	(uint32_t nPosn) const
 	{
 		_hzfunc("hzArray::InSitu") ;
 
-		_hz_ar_indx*	pIdx ;	//	Index node pointer
-		_hz_ar_data*	pDN ;	//	Index node pointer
-		OBJ*			pObj ;	//	Object pointer
-
-		uint32_t	x ;			//	Position reached so far
-		uint32_t	n ;			//	Offest at current level
-		uint32_t	f ;			//	Division factor
-
-		if (nPosn >= mx->m_nCount)
-			return 0 ;	//mx->m_Default ;
-
-		f = mx->m_nFactor ;
-
-		if (f == 1)
-		{
-			pDN = (_hz_ar_data*) mx->m_pRoot ;
-			pObj = (OBJ*) pDN->m_Objs ;
-			return pObj + nPosn ;
-		}
-
-		pIdx = (_hz_ar_indx*) mx->m_pRoot ;
-
-		for (x = nPosn, f = mx->m_nFactor ; f >= (HZ_ARRAY_NODESIZE * HZ_ARRAY_NODESIZE) ;)
-		{
-			n = x/f ; x %= f ; f /= HZ_ARRAY_NODESIZE ;
-			pIdx = (_hz_ar_indx*) pIdx->m_Ptrs[n] ;
-		}
-		pDN = (_hz_ar_data*) pIdx->m_Ptrs[x/f] ;
-		pObj = (OBJ*) pDN->m_Objs ;
-		return pObj + (x%f) ;
+		return mx->m_Store.InSitu(nPosn) ;
 	}
 
 	//	Diagnostics
-	uint32_t	Level	(void) const	{ return mx ? mx->m_nLevel : 0 ; }
-	uint32_t	Factor	(void) const	{ return mx ? mx->m_nFactor : 0 ; }
-	uint32_t	dBlocks	(void) const	{ return mx ? mx->m_nNoDN : 0 ; }
-	uint32_t	iBlocks	(void) const	{ return mx ? mx->m_nNoIN : 0 ; }
-	uint32_t	Count	(void) const	{ return mx ? mx->m_nCount : 0 ; }
+	hzStoreMode	Mode	(void) const	{ return mx->m_Store.Mode() ; }
+	uint32_t	Level	(void) const	{ return mx && mx->m_Store.Chunks() ? 1 : 0 ; }
+	uint32_t	Factor	(void) const	{ return mx ? mx->m_Store.PerChunk() : 0 ; }
+	uint32_t	dBlocks	(void) const	{ return mx ? mx->m_Store.Chunks() : 0 ; }
+	uint32_t	iBlocks	(void) const	{ return mx && mx->m_Store.Chunks() ? 1 : 0 ; }
+	uint32_t	Count	(void) const	{ return mx ? mx->m_Store.Count() : 0 ; }
 } ;
 
 #endif	//	hzTmplArray_h
@@ -21,6 +21,7 @@
 #include "hzString.h"
 #include "hzLock.h"
 #include "hzProcess.h"
+#include "hzTmplPool.h"
 
 /*
 **	Prototypes
@@ -74,6 +75,12 @@ template <class OBJ>	class	hzList
 	//	as long as only one iterator is operating on the list but not safe otherwise. Although the deletion takes place within a lock there is no way of knowing
 	//	if another iterator is pointing to the item in question, and no way for the other iterator to know its current item is defunct. A process using the other
 	//	iterator may attempt to perform an operation on a defunct object or seek to advance the other iterator on the basis of a defunct pointer.
+	//
+	//	List elements are held in nodes drawn from a slab pool (see _hz_node_pool) created on the first add, so an empty list costs no pool and adding elements
+	//	does not as a rule, call the heap. A series of objects can be added under a single lock by AddMany(), and the entire content of one list can be appended to another by Splice().
+	//	This relinks the nodes without copying them if the two lists share a pool (see SharePool()), and copies them otherwise.
+
+	typedef	_hz_node_pool< _hz_listitem<OBJ> >	_pool ;
 
 	struct	_list_ca
 	{
@@ -82,17 +89,22 @@ template <class OBJ>	class	hzList
 		_hz_listitem<OBJ>*	m_pList ;		//	Ptr to first element in the list
 		_hz_listitem<OBJ>*	m_pLast ;		//	Ptr to last element in the list
 
+		_pool*		m_pPool ;			//	Node pool
 		hzLockS		m_Lock ;			//	Built in lock
 		uint32_t	m_nCount ;			//	No of elements in the list
 		uint32_t	m_nCopy ;			//	No of copies
 		uint32_t	m_nIter ;			//	No of iterators of this list
 
-		_list_ca	(void)	{ m_pList = m_pLast = 0 ; m_nCount = m_nCopy = m_nIter = 0 ; _hzGlobal_Memstats.m_numListDC++ ; }
-		~_list_ca	(void)	{ Clear() ; _hzGlobal_Memstats.m_numListDC-- ; }
+		_list_ca	(void)	{ m_pList = m_pLast = 0 ; m_nCount = m_nCopy = m_nIter = 0 ; m_pPool = 0 ; _hzGlobal_Memstats.m_numListDC++ ; }
+		~_list_ca	(void)	{ Clear() ; if (m_pPool && m_pPool->Drop()) delete m_pPool ; _hzGlobal_Memstats.m_numListDC-- ; }
 
 		void	Lock		(void)	{ if (_hzGlobal_MT) m_Lock.Lock() ; }
 		void	Unlock		(void)	{ if (_hzGlobal_MT) m_Lock.Unlock() ; }
 
+		_pool*	Pool	(void)	{ if (!m_pPool) m_pPool = new _pool() ; return m_pPool ; }
+
+		_hz_listitem<OBJ>*	_node	(const OBJ& obj)	{ return new (Pool()->Take()) _hz_listitem<OBJ>(obj) ; }
+
 		void	Clear	(void)
 		{
 			//	Clear all list contents.
@@ -105,8 +117,17 @@ template <class OBJ>	class	hzList
 					m_nCopy-- ;
 				else
 				{
+					//	A private pool is simply reset, a shared pool has the nodes given back one by one
 					for (pC = m_pList ; pC ; pC = pN)
-						{ pN = pC->next ; delete pC ; }
+					{
+						pN = pC->next ;
+						if (m_pPool->Shared())
+							m_pPool->Give(pC) ;
+						else
+							pC->~_hz_listitem<OBJ>() ;
+					}
+					if (m_pPool && !m_pPool->Shared())
+						m_pPool->Reset() ;
 					m_pList = m_pLast = 0 ;
 					m_nCount = 0 ;
 				}
@@ -123,10 +144,8 @@ template <class OBJ>	class	hzList
 
 			_hz_listitem<OBJ>*	pTL ;	//	List element pointer
 
-			if (!(pTL = new _hz_listitem<OBJ>(obj)))
-				Fatal("_list_ca::_add. Link allocation failure") ;
-
 			Lock() ;
+				pTL = _node(obj) ;
 				if (m_pList == 0)
 					m_pList = m_pLast = pTL ;
 				else
@@ -156,22 +175,29 @@ template <class OBJ>	class	hzList
 			_hz_listitem<OBJ>*	marker ;	//	List element pointer
 			_hz_listitem<OBJ>*	newlink ;	//	List element pointer
 
-			if (!(newlink = new _hz_listitem<OBJ>(obj)))
-				Fatal("_list_ca::_add. Link allocation failure") ;
-
 			Lock() ;
+				if (m_pList && !currlink)
+					{ Unlock() ; return E_NOINIT ; }
+
+				newlink = _node(obj) ;
+
 				if (m_pList == 0)
 					m_pList = m_pLast = newlink ;
 				else
 				{
-					if (!currlink)
-						return E_NOINIT ;
 
 					if (bAfter)
 					{
 						//	To insert after currlink
 						newlink->next = currlink->next ;
 						currlink->next = newlink ;
+						if (currlink == m_pLast)
+							m_pLast = newlink ;
+					}
+					else if (currlink == m_pList)
+					{
+						newlink->next = currlink ;
+						m_pList = newlink ;
 					}
 					else
 					{
@@ -182,7 +208,7 @@ template <class OBJ>	class	hzList
 						}
 
 						if (!marker)
-							return E_NOTFOUND ;
+							{ m_pPool->Give(newlink) ; Unlock() ; return E_NOTFOUND ; }
 
 						newlink->next = currlink ;
 						marker->next = newlink ;
@@ -226,7 +252,7 @@ template <class OBJ>	class	hzList
 
 					//	Sanity check, if null prev then exit
 					if (!prev)
-						return E_NOTFOUND ;
+						{ Unlock() ; return E_NOTFOUND ; }
 				}
 
 				//	If the item is the last
@@ -237,7 +263,7 @@ template <class OBJ>	class	hzList
 				if (prev)
 					prev->next = pTL->next ;
 
-				delete pTL ;
+				m_pPool->Give(pTL) ;
 				m_nCount-- ;
 			Unlock() ;
 			return E_OK ;
@@ -279,7 +305,7 @@ public:
 
 			if (!m_pHandle || !m_pCurr)
 				return E_NOINIT ;
-			return mx->_insert(m_pCurr, bAfter) ;
+			return m_pHandle->_insert(obj, m_pCurr, bAfter) ;
 		}
 
 		hzEcode	Delete	(void)
@@ -371,9 +397,9 @@ public:
 
 		if (op.mx)
 		{
+			mx = op.mx ;
 			mx->Lock() ;
 			mx->m_nCopy++ ;
-			mx = op.mx ;
 			mx->Unlock() ;
 		}
 	}
@@ -436,15 +462,150 @@ public:
 		return mx->_add(obj) ;
 	}
 
+	hzEcode	AddMany	(const OBJ* pObjs, uint32_t nObjs)
+	{
+		//	Add a series of objects to the end of the list, in order, under a single lock
+		//
+		//	Arguments:	1)	pObjs	Array of objects
+		//				2)	nObjs	Number of objects
+		//
+		//	Returns:	E_ARGUMENT	If no array is supplied
+		//				E_OK		If the objects were added
+
+		_hzfunc_ct("hzList::AddMany") ;
+
+		_hz_listitem<OBJ>*	pTL ;	//	List element pointer
+		uint32_t			n ;		//	Object iterator
+
+		if (!nObjs)
+			return E_OK ;
+		if (!pObjs)
+			return E_ARGUMENT ;
+
+		if (!mx)
+		{
+			if (!(mx = new _list_ca()))
+				Fatal("hzList::AddMany. Container allocation failure") ;
+		}
+
+		mx->Lock() ;
+			for (n = 0 ; n < nObjs ; n++)
+			{
+				pTL = mx->_node(pObjs[n]) ;
+				if (mx->m_pList == 0)
+					mx->m_pList = mx->m_pLast = pTL ;
+				else
+				{
+					mx->m_pLast->next = pTL ;
+					mx->m_pLast = pTL ;
+				}
+			}
+			mx->m_nCount += nObjs ;
+		mx->Unlock() ;
+		return E_OK ;
+	}
+
+	hzEcode	SharePool	(hzList<OBJ>& other)
+	{
+		//	Adopt the node pool of another list so that Splice() between the two moves nodes rather than copying them. This list must be empty.
+		//
+		//	Arguments:	1)	other	The list whose pool is to be shared
+		//
+		//	Returns:	E_SEQUENCE	If this list is not empty
+		//				E_OK		If the pool is now shared
+
+		if (Count())
+			return E_SEQUENCE ;
+
+		if (!other.mx)
+			other.mx = new _list_ca() ;
+		if (!mx)
+			mx = new _list_ca() ;
+
+		if (mx->m_pPool != other.mx->Pool())
+		{
+			mx->Lock() ;
+				if (mx->m_pPool && mx->m_pPool->Drop())
+					delete mx->m_pPool ;
+				mx->m_pPool = other.mx->m_pPool->Share() ;
+			mx->Unlock() ;
+		}
+		return E_OK ;
+	}
+
+	hzEcode	Splice	(hzList<OBJ>& src)
+	{
+		//	Move the entire content of the supplied list to the end of this list, leaving the supplied list empty. Where the lists share a pool, this is done by
+		//	relinking and costs the same regardless of the number of objects. Otherwise the objects are copied.
+		//
+		//	Arguments:	1)	src		The list to be emptied into this list
+		//
+		//	Returns:	E_ARGUMENT	If the supplied list is this list
+		//				E_CONFLICT	If the supplied list has iterators or copies
+		//				E_OK		If the content was moved
+
+		_hz_listitem<OBJ>*	pTL ;	//	Object-link iterator
+		_hz_listitem<OBJ>*	pNL ;	//	Next link
+		_hz_listitem<OBJ>*	pNew ;	//	Copied link
+
+		if (!src.mx || !src.mx->m_pList)
+			return E_OK ;
+		if (src.mx == mx)
+			return E_ARGUMENT ;
+		if (src.mx->m_nIter || src.mx->m_nCopy)
+			return E_CONFLICT ;
+
+		if (!mx)
+			mx = new _list_ca() ;
+
+		//	Lock in a consistent order
+		if (mx < src.mx)
+			{ mx->Lock() ; src.mx->Lock() ; }
+		else
+			{ src.mx->Lock() ; mx->Lock() ; }
+
+		if (mx->m_pPool == src.mx->m_pPool)
+		{
+			if (mx->m_pList)
+				mx->m_pLast->next = src.mx->m_pList ;
+			else
+				mx->m_pList = src.mx->m_pList ;
+			mx->m_pLast = src.mx->m_pLast ;
+		}
+		else
+		{
+			for (pTL = src.mx->m_pList ; pTL ; pTL = pNL)
+			{
+				pNL = pTL->next ;
+				pNew = mx->_node(pTL->m_Obj) ;
+
+				if (mx->m_pList)
+					mx->m_pLast->next = pNew ;
+				else
+					mx->m_pList = pNew ;
+				mx->m_pLast = pNew ;
+				src.mx->m_pPool->Give(pTL) ;
+			}
+		}
+
+		mx->m_nCount += src.mx->m_nCount ;
+		src.mx->m_pList = src.mx->m_pLast = 0 ;
+		src.mx->m_nCount = 0 ;
+
+		src.mx->Unlock() ;
+		mx->Unlock() ;
+		return E_OK ;
+	}
+
 	void	Clear	(void)
 	{
-		//	Clear:	Empty the list
+		//	Clear:	Empty the list. The data area (and with it the node pool) is deleted unless other copies of the list share it.
 		if (mx)
 		{
 			if (mx->m_nCopy > 0)
 				mx->m_nCopy-- ;
 			else
-				mx->Clear() ;
+				delete mx ;
 		}
 		mx = 0 ;
 	}
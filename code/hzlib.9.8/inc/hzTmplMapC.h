@@ -0,0 +1,930 @@
+//
+//	File:	hzTmplMapC.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzTmplMapC_h
+#define hzTmplMapC_h
+
+#include <stdio.h>
+
+#include "hzString.h"
+#include "hzLock.h"
+#include "hzProcess.h"
+#include "hzIsamT.h"
+#include "hzKeyhash.h"
+#include "hzTmplArray.h"
+
+//	Synopsis:	Lock-striped Collections
+//
+//	A hzMapS, hzMapM or hzSet with locking switched on has a single lock for the whole collection. Where the collection is shared by many threads, such as a
+//	map of session cookies consulted on every HTTP request, that single lock becomes a point at which all threads serialize. The lock-striped templates set
+//	out here (hzMapSC, hzMapMC and hzSetC), address this by partitioning the keys by hash across a number of independent ISAMs (shards), each with its own
+//	read/write lock. A lookup only locks the one shard the key hashes to, so lookups on different keys rarely contend and read-mostly collections scale with
+//	the number of cores.
+//
+//	The price is that the collection as a whole is no longer in key order. Positional access by GetKey()/GetObj() remains available for enumeration but the
+//	positions are in shard order, not key order. Where key order is needed, the Cursor subclass provides an ordered iteration by merging the shards. Note that
+//	as cursors lock only one shard at a time, they do not give a point in time snapshot of the collection.
+//
+//	Because a reference to an element would outlive the shard lock, the lookup methods and the [] operator return copies of objects rather than references.
+//	The number of shards must be a power of 2 and is fixed at construction.
+
+#define HZ_MAPC_SHARDS		16		//	Default number of shards
+#define HZ_MAPC_MAXSHARDS	1024	//	Maximum number of shards
+
+/*
+**	Shards
+*/
+
+class	_hz_mapc_shard
+{
+	//	Category:	Collection Support
+	//
+	//	A single partition of a lock-striped collection, comprising an ISAM and the read/write lock that protects it. The ISAM's own lock is not used.
+
+	_hz_mapc_shard	(const _hz_mapc_shard&) ;
+	_hz_mapc_shard&	operator=	(const _hz_mapc_shard&) ;
+
+public:
+	_hz_tmpl_ISAM	base ;		//	ISAM of keys (or key/object pairs) that hash to this shard
+	hzLocker*		m_pLock ;	//	Shard lock (null if no locking)
+	hzLockOpt		m_eLock ;	//	Lock type
+
+	_hz_mapc_shard	(void)	{ m_pLock = 0 ; m_eLock = HZ_NOLOCK ; }
+
+	~_hz_mapc_shard	(void)
+	{
+		base.Clear() ;
+		_droplock() ;
+	}
+
+	void	_droplock	(void)
+	{
+		//	Delete the lock (if any) and revert to no locking
+
+		delete m_pLock ;
+		m_pLock = 0 ;
+		m_eLock = HZ_NOLOCK ;
+	}
+
+	void	SetLock	(hzLockOpt eLock, const char* name)
+	{
+		//	Set the lock type. Where this is HZ_MUTEX the lock is named (for contention reporting) by the supplied name.
+
+		_droplock() ;
+		m_eLock = eLock ;
+
+		if (eLock == HZ_MUTEX)
+			m_pLock = name && name[0] ? new hzLockRWD(name) : new hzLockRWD() ;
+		else if (eLock == HZ_ATOMIC)
+			m_pLock = new hzLockRW() ;
+		else
+			m_eLock = HZ_NOLOCK ;
+	}
+
+	void	LockRead	(void)	{ if (m_pLock) m_pLock->LockRead() ; }
+	void	LockWrite	(void)	{ if (m_pLock) m_pLock->LockWrite() ; }
+	void	Unlock		(void)	{ if (m_pLock) m_pLock->Unlock() ; }
+} ;
+
+class	_hz_mapc_base
+{
+	//	Category:	Collection Support
+	//
+	//	Shard array common to all the lock-striped collection templates
+
+	_hz_mapc_base	(const _hz_mapc_base&) ;
+	_hz_mapc_base&	operator=	(const _hz_mapc_base&) ;
+
+public:
+	_hz_mapc_shard*	m_pShards ;		//	The shards
+	hzString		m_Name ;		//	Collection name
+	uint32_t		m_nShards ;		//	Number of shards (power of 2)
+	uint32_t		m_nMask ;		//	Shard selection mask
+	hzLockOpt		m_eLock ;		//	Lock type for all shards
+
+	_hz_mapc_base	(void)	{ m_pShards = 0 ; m_nShards = m_nMask = 0 ; m_eLock = HZ_NOLOCK ; }
+	~_hz_mapc_base	(void)	{ if (m_pShards) delete [] m_pShards ; }
+
+	void	Init	(hzLockOpt eLock, uint32_t nShards, uint32_t nSizeKey, uint32_t nSizeObj, int32_t (*cmpfn)(const void*, const _hz_vn_Dat*, uint32_t))
+	{
+		//	Allocate the shards. The requested number of shards is rounded up to a power of 2.
+		//
+		//	Arguments:	1)	eLock		Lock type to apply to each shard
+		//				2)	nShards		Requested number of shards
+		//				3)	nSizeKey	Key size
+		//				4)	nSizeObj	Object size (0 for sets)
+		//				5)	cmpfn		ISAM key compare function
+		//
+		//	Returns:	None
+
+		uint32_t	n ;		//	Shard iterator
+
+		if (nShards < 1)					nShards = 1 ;
+		if (nShards > HZ_MAPC_MAXSHARDS)	nShards = HZ_MAPC_MAXSHARDS ;
+
+		for (m_nShards = 1 ; m_nShards < nShards ; m_nShards <<= 1) ;
+		m_nMask = m_nShards - 1 ;
+		m_eLock = eLock ;
+
+		m_pShards = new _hz_mapc_shard[m_nShards] ;
+		if (!m_pShards)
+			Fatal("_hz_mapc_base::Init. Could not allocate %u shards\n", m_nShards) ;
+
+		for (n = 0 ; n < m_nShards ; n++)
+		{
+			m_pShards[n].base.Start(nSizeKey, nSizeObj) ;
+			m_pShards[n].base.SetLock(HZ_NOLOCK) ;
+			m_pShards[n].base.m_compare = cmpfn ;
+		}
+		_setlocks() ;
+	}
+
+	void	_setlocks	(void)
+	{
+		//	(Re)create the shard locks, naming them after the collection for contention reporting
+
+		char		buf[16] ;	//	Lock name
+		uint32_t	n ;			//	Shard iterator
+
+		for (n = 0 ; n < m_nShards ; n++)
+		{
+			if (m_Name)
+				snprintf(buf, 16, "%.10s#%u", *m_Name, n) ;
+			else
+				snprintf(buf, 16, "mapc#%u", n) ;
+			m_pShards[n].SetLock(m_eLock, buf) ;
+			m_pShards[n].base.SetName(m_Name) ;
+		}
+	}
+
+	void	SetName	(const hzString& name)	{ m_Name = name ; _setlocks() ; }
+	void	SetLock	(hzLockOpt eLock)		{ m_eLock = eLock ; _setlocks() ; }
+
+	_hz_mapc_shard&	Shard	(uint64_t hash) const
+	{
+		//	Select shard by the high bits of the hash, leaving the low bits free for any hashing done within the shard
+
+		return m_pShards[(uint32_t) (hash >> 40) & m_nMask] ;
+	}
+
+	uint32_t	Count	(void) const
+	{
+		//	Total population. Note that no locks are taken so under concurrent update this is only a snapshot.
+
+		uint32_t	n ;			//	Shard iterator
+		uint32_t	total = 0 ;	//	Running total
+
+		for (n = 0 ; n < m_nShards ; n++)
+			total += m_pShards[n].base.Count() ;
+		return total ;
+	}
+
+	_hz_mapc_shard*	Locate	(int32_t& nSlot, _hz_vn_Dat*& pDN, uint32_t nPosn) const
+	{
+		//	Find the shard and data node slot of the element at the supplied overall position (in shard order). If found, the shard is returned read
+		//	locked and the caller must unlock it.
+		//
+		//	Arguments:	1)	nSlot	Data node slot (set by this function)
+		//				2)	pDN		Data node (set by this function)
+		//				3)	nPosn	Overall position
+		//
+		//	Returns:	Pointer to the read locked shard if the position exists
+		//				NULL otherwise
+
+		_hz_mapc_shard*	pS ;	//	Current shard
+		uint32_t		n ;		//	Shard iterator
+		uint32_t		c ;		//	Shard population
+
+		for (n = 0 ; n < m_nShards ; n++)
+		{
+			pS = m_pShards + n ;
+			pS->LockRead() ;
+			c = pS->base.Count() ;
+			if (nPosn < c)
+			{
+				pDN = pS->base._findDnodeByPos(nSlot, nPosn, false) ;
+				if (pDN)
+					return pS ;
+				pS->Unlock() ;
+				return 0 ;
+			}
+			pS->Unlock() ;
+			nPosn -= c ;
+		}
+		return 0 ;
+	}
+
+	void	Clear	(void)
+	{
+		uint32_t	n ;		//	Shard iterator
+
+		for (n = 0 ; n < m_nShards ; n++)
+		{
+			m_pShards[n].LockWrite() ;
+				m_pShards[n].base.Clear() ;
+			m_pShards[n].Unlock() ;
+		}
+	}
+} ;
+
+/*
+**	The hzMapSC template
+*/
+
+template<class KEY, class OBJ>	class	hzMapSC
+{
+	//	Category:	Object Collection
+	//
+	//	The hzMapSC template is the lock-striped counterpart of hzMapS. It provides a memory resident one to one map of keys to objects in which keys must
+	//	be unique. See the synopsis on lock-striped collections.
+
+	_hz_mapc_base	m_Base ;		//	The shards
+	KEY				m_NullKey ;		//	Null key
+	OBJ				m_NullObj ;		//	Null object
+
+	//	Prevent copies
+	hzMapSC<KEY,OBJ>	(const hzMapSC<KEY,OBJ>&) ;
+	hzMapSC<KEY,OBJ>&	operator=	(const hzMapSC<KEY,OBJ>&) ;
+
+	void	_init	(hzLockOpt eLock, uint32_t nShards)
+	{
+		m_Base.Init(eLock, nShards, sizeof(KEY), sizeof(OBJ), _tmpl_map_compare<KEY,OBJ>) ;
+		m_NullKey = KEY() ;
+		m_NullObj = OBJ() ;
+		_hzGlobal_Memstats.m_numCmaps++ ;
+	}
+
+public:
+	class	Cursor
+	{
+		//	Ordered iteration over a hzMapSC. Each shard is in key order so the cursor keeps a position and a copy of the head key in each shard, and each
+		//	step yields the least of the head keys (a k-way merge). Only the shard yielding the element is locked and only for the duration of the step. The
+		//	cursor is not a snapshot: Keys inserted or deleted in a shard while the cursor is active may be missed or seen twice.
+
+		const hzMapSC<KEY,OBJ>*	m_pMap ;	//	Map being iterated
+		uint32_t*	m_pPosn ;				//	Position within each shard
+		KEY*		m_pHead ;				//	Copy of the next key in each shard
+		bool*		m_pLive ;				//	True if the shard has a head key
+		KEY			m_Key ;					//	Current key (copy)
+		OBJ			m_Obj ;					//	Current object (copy)
+		bool		m_bValid ;				//	Cursor is on an element
+
+		Cursor	(const Cursor&) ;
+		Cursor&	operator=	(const Cursor&) ;
+
+		void	_head	(uint32_t nShard)
+		{
+			//	Refresh the head key of the given shard
+
+			_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+			_hz_mapc_shard*			pS ;		//	Shard
+			_hz_vn_Dat*				pDN ;		//	Data node
+			int32_t					nSlot ;		//	Data node slot
+
+			pS = m_pMap->m_Base.m_pShards + nShard ;
+			m_pLive[nShard] = false ;
+
+			pS->LockRead() ;
+				pDN = pS->base._findDnodeByPos(nSlot, m_pPosn[nShard], false) ;
+				if (pDN)
+				{
+					pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+					m_pHead[nShard] = pBuck->m_Keys[nSlot] ;
+					m_pLive[nShard] = true ;
+				}
+			pS->Unlock() ;
+		}
+
+		void	_clear	(void)
+		{
+			if (m_pPosn)	delete [] m_pPosn ;
+			if (m_pHead)	delete [] m_pHead ;
+			if (m_pLive)	delete [] m_pLive ;
+			m_pPosn = 0 ;
+			m_pHead = 0 ;
+			m_pLive = 0 ;
+			m_pMap = 0 ;
+			m_bValid = false ;
+		}
+
+	public:
+		Cursor	(void)	{ m_pMap = 0 ; m_pPosn = 0 ; m_pHead = 0 ; m_pLive = 0 ; m_bValid = false ; }
+		~Cursor	(void)	{ _clear() ; }
+
+		bool	First	(const hzMapSC<KEY,OBJ>& map)
+		{
+			//	Position the cursor on the lowest key in the map
+			//
+			//	Arguments:	1)	map		The map to iterate
+			//
+			//	Returns:	True	If the map has at least one element
+			//				False	If the map is empty
+
+			uint32_t	n ;		//	Shard iterator
+
+			_clear() ;
+			m_pMap = &map ;
+			m_pPosn = new uint32_t[map.m_Base.m_nShards] ;
+			m_pHead = new KEY[map.m_Base.m_nShards] ;
+			m_pLive = new bool[map.m_Base.m_nShards] ;
+
+			for (n = 0 ; n < map.m_Base.m_nShards ; n++)
+			{
+				m_pPosn[n] = 0 ;
+				_head(n) ;
+			}
+			return Next() ;
+		}
+
+		bool	Next	(void)
+		{
+			//	Advance the cursor to the next key in order
+			//
+			//	Arguments:	None
+			//
+			//	Returns:	True	If the cursor is on an element
+			//				False	If there are no more elements
+
+			_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+			_hz_mapc_shard*			pS ;		//	Shard
+			_hz_vn_Dat*				pDN ;		//	Data node
+			int32_t					nSlot ;		//	Data node slot
+			uint32_t				n ;			//	Shard iterator
+			uint32_t				best ;		//	Shard with the least head key
+
+			m_bValid = false ;
+			if (!m_pMap)
+				return false ;
+
+			for (best = HZ_T_BADSLOT, n = 0 ; n < m_pMap->m_Base.m_nShards ; n++)
+			{
+				if (!m_pLive[n])
+					continue ;
+				if (best == HZ_T_BADSLOT || m_pHead[n] < m_pHead[best])
+					best = n ;
+			}
+
+			if (best == HZ_T_BADSLOT)
+				return false ;
+
+			pS = m_pMap->m_Base.m_pShards + best ;
+			pS->LockRead() ;
+				pDN = pS->base._findDnodeByPos(nSlot, m_pPosn[best], false) ;
+				if (pDN)
+				{
+					pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+					m_Key = pBuck->m_Keys[nSlot] ;
+					m_Obj = pBuck->m_Objs[nSlot] ;
+					m_bValid = true ;
+				}
+			pS->Unlock() ;
+
+			m_pPosn[best]++ ;
+			_head(best) ;
+
+			return m_bValid ? true : Next() ;
+		}
+
+		bool		Valid	(void) const	{ return m_bValid ; }
+		const KEY&	Key		(void) const	{ return m_Key ; }
+		const OBJ&	Obj		(void) const	{ return m_Obj ; }
+	} ;
+
+	hzMapSC	(void)								{ _init(HZ_ATOMIC, HZ_MAPC_SHARDS) ; }
+	hzMapSC	(hzLockOpt eLock)					{ _init(eLock, HZ_MAPC_SHARDS) ; }
+	hzMapSC	(hzLockOpt eLock, uint32_t nShards)	{ _init(eLock, nShards) ; }
+
+	hzMapSC	(hzLockOpt eLock, const hzString& name)
+	{
+		m_Base.m_Name = name ;
+		_init(eLock, HZ_MAPC_SHARDS) ;
+	}
+
+	~hzMapSC	(void)	{ _hzGlobal_Memstats.m_numCmaps-- ; }
+
+	//	Init functions
+	void	SetName	(const hzString& name)	{ m_Base.SetName(name) ; }
+	void	SetLock	(hzLockOpt eLock)		{ m_Base.SetLock(eLock) ; }
+	void	Clear	(void)					{ m_Base.Clear() ; }
+
+	//	Insert and delete by key
+	hzEcode	Insert	(const KEY& key, const OBJ& obj)
+	{
+		_hzfunc("hzMapSC::Insert") ;
+
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockWrite() ;
+			pDN = S.base.InsertKeyU(nSlot, &key) ;
+			if (pDN)
+			{
+				pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+				pBuck->m_Keys[nSlot] = key ;
+				pBuck->m_Objs[nSlot] = obj ;
+			}
+		S.Unlock() ;
+
+		if (pDN)
+			return E_OK ;
+		threadLog("%s: Failed to INSERT\n", *_fn) ;
+		return E_CORRUPT ;
+	}
+
+	OBJ	InsertIfAbsent	(const KEY& key, const OBJ& obj)
+	{
+		//	Insert the supplied object for the key only if the key does not already exist. As the test and the insert are made under the one shard lock, of
+		//	several threads doing this for the same key at the same time, only one will insert and all will get back the same object.
+		//
+		//	Arguments:	1)	key		The key
+		//				2)	obj		The object to insert should the key not exist
+		//
+		//	Returns:	Copy of the object now in the map for the key. This is the supplied object unless the key already existed (or the insert failed).
+
+		_hzfunc("hzMapSC::InsertIfAbsent") ;
+
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+		OBJ						winner ;	//	Object in the map for the key
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockWrite() ;
+			pDN = S.base._findDnodeByKey(nSlot, &key, HZ_ISAMSRCH_LO) ;
+			if (pDN)
+			{
+				pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+				winner = pBuck->m_Objs[nSlot] ;
+			}
+			else
+			{
+				pDN = S.base.InsertKeyU(nSlot, &key) ;
+				if (pDN)
+				{
+					pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+					pBuck->m_Keys[nSlot] = key ;
+					pBuck->m_Objs[nSlot] = obj ;
+					winner = obj ;
+				}
+				else
+					winner = m_NullObj ;
+			}
+		S.Unlock() ;
+
+		if (!pDN)
+			threadLog("%s: Failed to INSERT\n", *_fn) ;
+		return winner ;
+	}
+
+	hzEcode	Delete	(const KEY& key)
+	{
+		_hzfunc("hzMapSC::Delete") ;
+
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockWrite() ;
+			pDN = S.base._findDnodeByKey(nSlot, &key, HZ_ISAMSRCH_LO) ;
+			if (pDN)
+			{
+				pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+				pBuck->m_Keys[nSlot] = m_NullKey ;
+				pBuck->m_Objs[nSlot] = m_NullObj ;
+				S.base.DeleteKey(nSlot, &key) ;
+			}
+		S.Unlock() ;
+
+		return pDN ? E_OK : E_NOTFOUND ;
+	}
+
+	//	Locate elements by value
+	bool	Exists	(const KEY& key) const
+	{
+		_hz_vn_Dat*	pDN ;		//	Data node
+		int32_t		nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockRead() ;
+			pDN = S.base._findDnodeByKey(nSlot, &key, HZ_ISAMSRCH_LO) ;
+		S.Unlock() ;
+		return pDN ? true : false ;
+	}
+
+	bool	Lookup	(OBJ& obj, const KEY& key) const
+	{
+		//	Copy out the object for the supplied key
+		//
+		//	Arguments:	1)	obj		The object found (set to the null object if not found)
+		//				2)	key		The key to lookup
+		//
+		//	Returns:	True	If the key exists
+		//				False	Otherwise
+
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockRead() ;
+			pDN = S.base._findDnodeByKey(nSlot, &key, HZ_ISAMSRCH_LO) ;
+			if (pDN)
+			{
+				pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+				obj = pBuck->m_Objs[nSlot] ;
+			}
+			else
+				obj = m_NullObj ;
+		S.Unlock() ;
+		return pDN ? true : false ;
+	}
+
+	OBJ	operator[]	(const KEY& key) const
+	{
+		//	Return a copy of the object for the supplied key, or the null object if the key does not exist
+
+		OBJ	obj ;	//	Object found
+
+		Lookup(obj, key) ;
+		return obj ;
+	}
+
+	//	Locate keys or objects by position (shard order)
+	OBJ	GetObj	(uint32_t nPosn) const
+	{
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_mapc_shard*			pS ;		//	Shard
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+		OBJ						obj ;		//	Object found
+
+		pS = m_Base.Locate(nSlot, pDN, nPosn) ;
+		if (!pS)
+			return m_NullObj ;
+
+		pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+		obj = pBuck->m_Objs[nSlot] ;
+		pS->Unlock() ;
+		return obj ;
+	}
+
+	KEY	GetKey	(uint32_t nPosn) const
+	{
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_mapc_shard*			pS ;		//	Shard
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+		KEY						key ;		//	Key found
+
+		pS = m_Base.Locate(nSlot, pDN, nPosn) ;
+		if (!pS)
+			return m_NullKey ;
+
+		pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+		key = pBuck->m_Keys[nSlot] ;
+		pS->Unlock() ;
+		return key ;
+	}
+
+	//	Diagnostics
+	uint32_t	Shards	(void) const	{ return m_Base.m_nShards ; }
+	uint32_t	Count	(void) const	{ return m_Base.Count() ; }
+} ;
+
+/*
+**	The hzMapMC template
+*/
+
+template<class KEY, class OBJ>	class	hzMapMC
+{
+	//	Category:	Object Collection
+	//
+	//	The hzMapMC template is the lock-striped counterpart of hzMapM. It provides a memory resident one to many map of keys to objects. As all objects
+	//	under a given key hash to the same shard, they remain in order of incidence within that shard. See the synopsis on lock-striped collections.
+
+	_hz_mapc_base	m_Base ;		//	The shards
+	KEY				m_NullKey ;		//	Null key
+	OBJ				m_NullObj ;		//	Null object
+
+	//	Prevent copies
+	hzMapMC<KEY,OBJ>	(const hzMapMC<KEY,OBJ>&) ;
+	hzMapMC<KEY,OBJ>&	operator=	(const hzMapMC<KEY,OBJ>&) ;
+
+	void	_init	(hzLockOpt eLock, uint32_t nShards)
+	{
+		m_Base.Init(eLock, nShards, sizeof(KEY), sizeof(OBJ), _tmpl_map_compare<KEY,OBJ>) ;
+		m_NullKey = KEY() ;
+		m_NullObj = OBJ() ;
+		_hzGlobal_Memstats.m_numCmaps++ ;
+	}
+
+public:
+	hzMapMC	(void)								{ _init(HZ_ATOMIC, HZ_MAPC_SHARDS) ; }
+	hzMapMC	(hzLockOpt eLock)					{ _init(eLock, HZ_MAPC_SHARDS) ; }
+	hzMapMC	(hzLockOpt eLock, uint32_t nShards)	{ _init(eLock, nShards) ; }
+
+	hzMapMC	(hzLockOpt eLock, const hzString& name)
+	{
+		m_Base.m_Name = name ;
+		_init(eLock, HZ_MAPC_SHARDS) ;
+	}
+
+	~hzMapMC	(void)	{ _hzGlobal_Memstats.m_numCmaps-- ; }
+
+	//	Init functions
+	void	SetName	(const hzString& name)	{ m_Base.SetName(name) ; }
+	void	SetLock	(hzLockOpt eLock)		{ m_Base.SetLock(eLock) ; }
+	void	Clear	(void)					{ m_Base.Clear() ; }
+
+	//	Insert and delete by key
+	hzEcode	Insert	(const KEY& key, const OBJ& obj)
+	{
+		_hzfunc("hzMapMC::Insert") ;
+
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockWrite() ;
+			pDN = S.base.InsertKeyM(nSlot, &key) ;
+			if (pDN)
+			{
+				pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+				pBuck->m_Keys[nSlot] = key ;
+				pBuck->m_Objs[nSlot] = obj ;
+			}
+		S.Unlock() ;
+
+		if (pDN)
+			return E_OK ;
+		threadLog("%s: Failed to INSERT\n", *_fn) ;
+		return E_CORRUPT ;
+	}
+
+	hzEcode	Delete	(const KEY& key)
+	{
+		//	Delete the first object found under the key
+
+		_hzfunc("hzMapMC::Delete") ;
+
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockWrite() ;
+			pDN = S.base._findDnodeByKey(nSlot, &key, HZ_ISAMSRCH_LO) ;
+			if (pDN)
+			{
+				pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+				pBuck->m_Keys[nSlot] = m_NullKey ;
+				pBuck->m_Objs[nSlot] = m_NullObj ;
+				S.base.DeleteKey(nSlot, &key) ;
+			}
+		S.Unlock() ;
+
+		return pDN ? E_OK : E_NOTFOUND ;
+	}
+
+	//	Locate elements by value
+	bool	Exists	(const KEY& key) const
+	{
+		_hz_vn_Dat*	pDN ;		//	Data node
+		int32_t		nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockRead() ;
+			pDN = S.base._findDnodeByKey(nSlot, &key, HZ_ISAMSRCH_LO) ;
+		S.Unlock() ;
+		return pDN ? true : false ;
+	}
+
+	uint32_t	Fetch	(hzArray<OBJ>& objs, const KEY& key) const
+	{
+		//	Append all objects found under the supplied key to the supplied array, in order of incidence.
+		//
+		//	Arguments:	1)	objs	Array of objects found
+		//				2)	key		The key to lookup
+		//
+		//	Returns:	Number of objects found
+
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_vn_Dat*				pDN ;		//	Data node
+		uint32_t				nLo ;		//	Position of first instance of key
+		uint32_t				nHi ;		//	Position of last instance of key
+		uint32_t				nFound ;	//	Objects found
+		int32_t					nSlot ;		//	Data node slot
+
+		nFound = 0 ;
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockRead() ;
+			if (S.base._findAllByKey(nSlot, nLo, &key, HZ_ISAMSRCH_LO) && S.base._findAllByKey(nSlot, nHi, &key, HZ_ISAMSRCH_HI))
+			{
+				for (nLo &= 0x7fffffff, nHi &= 0x7fffffff ; nLo <= nHi ; nLo++)
+				{
+					pDN = S.base._findDnodeByPos(nSlot, nLo, false) ;
+					if (!pDN)
+						break ;
+					pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+					objs.Add(pBuck->m_Objs[nSlot]) ;
+					nFound++ ;
+				}
+			}
+		S.Unlock() ;
+		return nFound ;
+	}
+
+	//	Locate keys or objects by position (shard order)
+	OBJ	GetObj	(uint32_t nPosn) const
+	{
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_mapc_shard*			pS ;		//	Shard
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+		OBJ						obj ;		//	Object found
+
+		pS = m_Base.Locate(nSlot, pDN, nPosn) ;
+		if (!pS)
+			return m_NullObj ;
+
+		pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+		obj = pBuck->m_Objs[nSlot] ;
+		pS->Unlock() ;
+		return obj ;
+	}
+
+	KEY	GetKey	(uint32_t nPosn) const
+	{
+		_hz_map_bkt<KEY,OBJ>*	pBuck ;		//	Data bucket
+		_hz_mapc_shard*			pS ;		//	Shard
+		_hz_vn_Dat*				pDN ;		//	Data node
+		int32_t					nSlot ;		//	Data node slot
+		KEY						key ;		//	Key found
+
+		pS = m_Base.Locate(nSlot, pDN, nPosn) ;
+		if (!pS)
+			return m_NullKey ;
+
+		pBuck = (_hz_map_bkt<KEY,OBJ>*) pDN->m_pElements ;
+		key = pBuck->m_Keys[nSlot] ;
+		pS->Unlock() ;
+		return key ;
+	}
+
+	//	Diagnostics
+	uint32_t	Shards	(void) const	{ return m_Base.m_nShards ; }
+	uint32_t	Count	(void) const	{ return m_Base.Count() ; }
+} ;
+
+/*
+**	The hzSetC template
+*/
+
+template<class KEY>	class	hzSetC
+{
+	//	Category:	Object Collection
+	//
+	//	The hzSetC template is the lock-striped counterpart of hzSet, a memory resident set of unique keys. See the synopsis on lock-striped collections.
+
+	_hz_mapc_base	m_Base ;		//	The shards
+	KEY				m_Null ;		//	Null key
+
+	//	Prevent copies
+	hzSetC<KEY>		(const hzSetC<KEY>&) ;
+	hzSetC<KEY>&	operator=	(const hzSetC<KEY>&) ;
+
+	void	_init	(hzLockOpt eLock, uint32_t nShards)
+	{
+		m_Base.Init(eLock, nShards, sizeof(KEY), 0, _tmpl_set_compare<KEY>) ;
+		m_Null = KEY() ;
+		_hzGlobal_Memstats.m_numCmaps++ ;
+	}
+
+public:
+	hzSetC	(void)								{ _init(HZ_ATOMIC, HZ_MAPC_SHARDS) ; }
+	hzSetC	(hzLockOpt eLock)					{ _init(eLock, HZ_MAPC_SHARDS) ; }
+	hzSetC	(hzLockOpt eLock, uint32_t nShards)	{ _init(eLock, nShards) ; }
+
+	hzSetC	(const hzString& name)
+	{
+		m_Base.m_Name = name ;
+		_init(HZ_ATOMIC, HZ_MAPC_SHARDS) ;
+	}
+
+	hzSetC	(hzLockOpt eLock, const hzString& name)
+	{
+		m_Base.m_Name = name ;
+		_init(eLock, HZ_MAPC_SHARDS) ;
+	}
+
+	~hzSetC	(void)	{ _hzGlobal_Memstats.m_numCmaps-- ; }
+
+	//	Init functions
+	void	SetName	(const hzString& name)	{ m_Base.SetName(name) ; }
+	void	SetLock	(hzLockOpt eLock)		{ m_Base.SetLock(eLock) ; }
+	void	Clear	(void)					{ m_Base.Clear() ; }
+
+	//	Data operations
+	hzEcode	Insert	(const KEY& key)
+	{
+		_hz_set_bkt<KEY>*	pBuck ;		//	Data bucket
+		_hz_vn_Dat*			pDN ;		//	Data node
+		int32_t				nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockWrite() ;
+			pDN = S.base.InsertKeyU(nSlot, &key) ;
+			if (pDN)
+			{
+				pBuck = (_hz_set_bkt<KEY>*) pDN->m_pElements ;
+				pBuck->m_Keys[nSlot] = key ;
+			}
+		S.Unlock() ;
+		return pDN ? E_OK : E_CORRUPT ;
+	}
+
+	hzEcode	Delete	(const KEY& key)
+	{
+		_hz_set_bkt<KEY>*	pBuck ;		//	Data bucket
+		_hz_vn_Dat*			pDN ;		//	Data node
+		int32_t				nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockWrite() ;
+			pDN = S.base._findDnodeByKey(nSlot, &key, HZ_ISAMSRCH_LO) ;
+			if (pDN)
+			{
+				pBuck = (_hz_set_bkt<KEY>*) pDN->m_pElements ;
+				pBuck->m_Keys[nSlot] = m_Null ;
+				S.base.DeleteKey(nSlot, &key) ;
+			}
+		S.Unlock() ;
+		return pDN ? E_OK : E_NOTFOUND ;
+	}
+
+	bool	Exists	(const KEY& key) const
+	{
+		_hz_vn_Dat*	pDN ;		//	Data node
+		int32_t		nSlot ;		//	Data node slot
+
+		_hz_mapc_shard&	S = m_Base.Shard(_hz_keyhash(key)) ;
+
+		S.LockRead() ;
+			pDN = S.base._findDnodeByKey(nSlot, &key, HZ_ISAMSRCH_LO) ;
+		S.Unlock() ;
+		return pDN ? true : false ;
+	}
+
+	KEY	GetObj	(uint32_t nPosn) const
+	{
+		_hz_set_bkt<KEY>*	pBuck ;		//	Data bucket
+		_hz_mapc_shard*		pS ;		//	Shard
+		_hz_vn_Dat*			pDN ;		//	Data node
+		int32_t				nSlot ;		//	Data node slot
+		KEY					key ;		//	Key found
+
+		pS = m_Base.Locate(nSlot, pDN, nPosn) ;
+		if (!pS)
+			return m_Null ;
+
+		pBuck = (_hz_set_bkt<KEY>*) pDN->m_pElements ;
+		key = pBuck->m_Keys[nSlot] ;
+		pS->Unlock() ;
+		return key ;
+	}
+
+	//	Diagnostics
+	uint32_t	Shards	(void) const	{ return m_Base.m_nShards ; }
+	uint32_t	Count	(void) const	{ return m_Base.Count() ; }
+} ;
+
+#endif	//	hzTmplMapC_h
@@ -0,0 +1,507 @@
+//
+//	File:	hzTmplMapH.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+
+#ifndef hzTmplMapH_h
+#define hzTmplMapH_h
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hzString.h"
+#include "hzLock.h"
+#include "hzProcess.h"
+#include "hzKeyhash.h"
+
+//	Synopsis:	Hash Maps
+//
+//	The ISAM based maps (hzMapS, hzMapM, hzSet and hzLookup) keep their keys in order and so support range and positional lookups, but a lookup by key costs
+//	a descent of the index and a binary search of a data node. Where a map is only ever consulted by key (session cookies, MIME types, class and member names
+//	etc), order is an unnecessary expense. hzHashMap provides a one to one map of unique keys to objects with constant time lookup, by means of an open
+//	addressing hash table of the 'Swiss table' variety.
+//
+//	The table is an array of slots, each with a one byte control value that is either EMPTY, DELETED or (if the slot is in use), the low 7 bits of the key
+//	hash. The remaining hash bits select the slot at which probing begins. Probing examines 16 control bytes at a time (with a single SSE2 compare where this
+//	is available), so that only slots whose control byte matches the 7 hash bits need have their keys compared. Almost all lookups are resolved within the
+//	first group of 16. The table is kept no more than 7/8 full.
+//
+//	The slots do not hold the keys and objects directly. Instead they hold the position of the key/object pair in dense arrays of keys and objects. This
+//	keeps the table compact, means that growing the table does not copy any keys or objects, and allows keys and objects to be enumerated by position with
+//	GetKey() and GetObj() as with the ISAM maps. Positions are in order of insertion except that Delete() moves the last pair into the vacated position.
+//
+//	Keys are hashed by _hz_keyhash() (see hzKeyhash.h), which is defined for the plain value types and for hzString, hzEmaddr, hzIpaddr and hzSysID. Keys
+//	must also support the == operator.
+
+#define HZ_HMAP_GROUP		16			//	Control bytes examined per probe
+#define HZ_HMAP_MINSLOTS	16			//	Minimum table size
+#define HZ_HMAP_EMPTY		((int8_t) 0x80)	//	Control value for an unused slot
+#define HZ_HMAP_DELETED		((int8_t) 0xFE)	//	Control value for a slot whose key has been deleted
+
+/*
+**	Control byte group matching
+*/
+
+inline	uint32_t	_hz_hmap_match	(const int8_t* pCtrl, int8_t h2)
+{
+	//	Return a bitmap of the control bytes in the group starting at pCtrl which are equal to h2
+
+#if defined(__SSE2__)
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) pCtrl), _mm_set1_epi8(h2))) ;
+#else
+	uint32_t	bits = 0 ;	//	Result
+	uint32_t	n ;			//	Control byte iterator
+
+	for (n = 0 ; n < HZ_HMAP_GROUP ; n++)
+		{ if (pCtrl[n] == h2) bits |= (1 << n) ; }
+	return bits ;
+#endif
+}
+
+inline	uint32_t	_hz_hmap_free	(const int8_t* pCtrl)
+{
+	//	Return a bitmap of the control bytes in the group starting at pCtrl which are either EMPTY or DELETED (these are the ones with the top bit set)
+
+#if defined(__SSE2__)
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) pCtrl)) ;
+#else
+	uint32_t	bits = 0 ;	//	Result
+	uint32_t	n ;			//	Control byte iterator
+
+	for (n = 0 ; n < HZ_HMAP_GROUP ; n++)
+		{ if (pCtrl[n] < 0) bits |= (1 << n) ; }
+	return bits ;
+#endif
+}
+
+/*
+**	The hzHashMap template
+*/
+
+template<class KEY, class OBJ>	class	hzHashMap
+{
+	//	Category:	Object Collection
+	//
+	//	The hzHashMap template provides a memory resident one to one map of keys to objects, held in a hash table. Lookup, insertion and deletion by key are of
+	//	constant time but the keys are not in order. See synopsis on Hash Maps.
+
+	int8_t*			m_pCtrl ;		//	Control bytes (slots plus HZ_HMAP_GROUP bytes mirroring the first group)
+	uint32_t*		m_pSlots ;		//	Slot to dense array position
+	KEY*			m_pKeys ;		//	Dense array of keys
+	OBJ*			m_pObjs ;		//	Dense array of objects
+	hzLocker*		m_pLock ;		//	Locking (off by default)
+	hzLockOpt		m_eLock ;		//	Lock type
+	hzString		m_Name ;		//	Map name
+	uint32_t		m_nSlots ;		//	Number of slots (power of 2)
+	uint32_t		m_nMask ;		//	Slot mask
+	uint32_t		m_nCount ;		//	Number of keys
+	uint32_t		m_nDeleted ;	//	Number of slots marked DELETED
+	uint32_t		m_nDense ;		//	Capacity of the dense arrays
+	KEY				m_NullKey ;		//	Null key
+	OBJ				m_NullObj ;		//	Null object
+	mutable KEY		m_DefaultKey ;	//	Default key (effectively NULL)
+	mutable OBJ		m_DefaultObj ;	//	Default object (effectively NULL)
+
+	//	Prevent copies
+	hzHashMap<KEY,OBJ>	(const hzHashMap<KEY,OBJ>&) ;
+	hzHashMap<KEY,OBJ>&	operator=	(const hzHashMap<KEY,OBJ>&) ;
+
+	void	_init	(void)
+	{
+		m_pCtrl = 0 ;
+		m_pSlots = 0 ;
+		m_pKeys = 0 ;
+		m_pObjs = 0 ;
+		m_pLock = 0 ;
+		m_eLock = HZ_NOLOCK ;
+		m_nSlots = m_nMask = m_nCount = m_nDeleted = m_nDense = 0 ;
+		memset(&m_NullKey, 0, sizeof(KEY)) ;
+		memset(&m_NullObj, 0, sizeof(OBJ)) ;
+		_hzGlobal_Memstats.m_numHmaps++ ;
+	}
+
+	void	_setctrl	(uint32_t nSlot, int8_t val)
+	{
+		//	Set a control byte, and its mirror if in the first group
+
+		m_pCtrl[nSlot] = val ;
+		if (nSlot < HZ_HMAP_GROUP)
+			m_pCtrl[m_nSlots + nSlot] = val ;
+	}
+
+	int32_t	_find	(const KEY& key, uint64_t hash) const
+	{
+		//	Find the slot holding the key
+		//
+		//	Arguments:	1)	key		The key
+		//				2)	hash	The key hash
+		//
+		//	Returns:	Slot number or -1 if not found
+
+		uint32_t	nPosn ;		//	Start of group
+		uint32_t	nStep ;		//	Probe step
+		uint32_t	bits ;		//	Match bitmap
+		uint32_t	nSlot ;		//	Candidate slot
+		int8_t		h2 ;		//	Control value sought
+
+		if (!m_nCount)
+			return -1 ;
+
+		h2 = hash & 0x7f ;
+		nPosn = (hash >> 7) & m_nMask ;
+
+		for (nStep = 0 ; nStep <= m_nSlots ;)
+		{
+			for (bits = _hz_hmap_match(m_pCtrl + nPosn, h2) ; bits ; bits &= (bits - 1))
+			{
+				nSlot = (nPosn + __builtin_ctz(bits)) & m_nMask ;
+				if (m_pKeys[m_pSlots[nSlot]] == key)
+					return nSlot ;
+			}
+
+			if (_hz_hmap_match(m_pCtrl + nPosn, HZ_HMAP_EMPTY))
+				return -1 ;
+
+			nStep += HZ_HMAP_GROUP ;
+			nPosn = (nPosn + nStep) & m_nMask ;
+		}
+		return -1 ;
+	}
+
+	uint32_t	_freeslot	(uint64_t hash) const
+	{
+		//	Find the first EMPTY or DELETED slot on the probe sequence for the hash. There is always one as the table is never full.
+
+		uint32_t	nPosn ;		//	Start of group
+		uint32_t	nStep ;		//	Probe step
+		uint32_t	bits ;		//	Free bitmap
+
+		nPosn = (hash >> 7) & m_nMask ;
+
+		for (nStep = 0 ;; )
+		{
+			bits = _hz_hmap_free(m_pCtrl + nPosn) ;
+			if (bits)
+				return (nPosn + __builtin_ctz(bits)) & m_nMask ;
+
+			nStep += HZ_HMAP_GROUP ;
+			nPosn = (nPosn + nStep) & m_nMask ;
+		}
+	}
+
+	void	_rehash	(uint32_t nSlots)
+	{
+		//	Rebuild the slot table at the given size from the dense arrays. This purges DELETED slots. No keys or objects are moved.
+
+		uint64_t	hash ;	//	Key hash
+		uint32_t	n ;		//	Dense array iterator
+		uint32_t	nSlot ;	//	Slot
+
+		if (m_pCtrl)	delete [] m_pCtrl ;
+		if (m_pSlots)	delete [] m_pSlots ;
+
+		m_nSlots = nSlots ;
+		m_nMask = nSlots - 1 ;
+		m_nDeleted = 0 ;
+		m_pCtrl = new int8_t[m_nSlots + HZ_HMAP_GROUP] ;
+		m_pSlots = new uint32_t[m_nSlots] ;
+		if (!m_pCtrl || !m_pSlots)
+			Fatal("hzHashMap::_rehash. Could not allocate %u slots\n", m_nSlots) ;
+		memset(m_pCtrl, HZ_HMAP_EMPTY, m_nSlots + HZ_HMAP_GROUP) ;
+
+		for (n = 0 ; n < m_nCount ; n++)
+		{
+			hash = _hz_keyhash(m_pKeys[n]) ;
+			nSlot = _freeslot(hash) ;
+			_setctrl(nSlot, hash & 0x7f) ;
+			m_pSlots[nSlot] = n ;
+		}
+	}
+
+	void	_dense	(uint32_t nCap)
+	{
+		//	Grow the dense arrays to the given capacity
+
+		KEY*		pKeys ;	//	New keys
+		OBJ*		pObjs ;	//	New objects
+		uint32_t	n ;		//	Iterator
+
+		pKeys = new KEY[nCap] ;
+		pObjs = new OBJ[nCap] ;
+		if (!pKeys || !pObjs)
+			Fatal("hzHashMap::_dense. Could not allocate %u elements\n", nCap) ;
+
+		for (n = 0 ; n < m_nCount ; n++)
+		{
+			pKeys[n] = m_pKeys[n] ;
+			pObjs[n] = m_pObjs[n] ;
+		}
+
+		if (m_pKeys)	delete [] m_pKeys ;
+		if (m_pObjs)	delete [] m_pObjs ;
+		m_pKeys = pKeys ;
+		m_pObjs = pObjs ;
+		m_nDense = nCap ;
+	}
+
+	void	_reserve	(uint32_t nKeys)
+	{
+		//	Ensure capacity for the given number of keys without exceeding the 7/8 load limit
+
+		uint32_t	nSlots ;	//	Required slots
+
+		if (nKeys > m_nDense)
+			_dense(nKeys > m_nDense * 2 ? nKeys : (m_nDense ? m_nDense * 2 : HZ_HMAP_MINSLOTS)) ;
+
+		if ((nKeys + m_nDeleted) * 8 <= m_nSlots * 7)
+			return ;
+
+		for (nSlots = m_nSlots ? m_nSlots : HZ_HMAP_MINSLOTS ; nKeys * 8 > nSlots * 7 ; nSlots *= 2) ;
+		_rehash(nSlots) ;
+	}
+
+	void	_droplock	(void)
+	{
+		//	Delete the lock (if any) and revert to no locking
+
+		delete m_pLock ;
+		m_pLock = 0 ;
+		m_eLock = HZ_NOLOCK ;
+	}
+
+	void	_clear	(void)
+	{
+		if (m_pCtrl)	delete [] m_pCtrl ;
+		if (m_pSlots)	delete [] m_pSlots ;
+		if (m_pKeys)	delete [] m_pKeys ;
+		if (m_pObjs)	delete [] m_pObjs ;
+
+		m_pCtrl = 0 ;
+		m_pSlots = 0 ;
+		m_pKeys = 0 ;
+		m_pObjs = 0 ;
+		m_nSlots = m_nMask = m_nCount = m_nDeleted = m_nDense = 0 ;
+	}
+
+public:
+	hzHashMap	(void)								{ _init() ; }
+	hzHashMap	(hzLockOpt eLock)					{ _init() ; SetLock(eLock) ; }
+	hzHashMap	(const hzString& name)				{ _init() ; m_Name = name ; }
+	hzHashMap	(hzLockOpt eLock, const hzString& name)	{ _init() ; m_Name = name ; SetLock(eLock) ; }
+
+	~hzHashMap	(void)
+	{
+		_clear() ;
+		_droplock() ;
+		_hzGlobal_Memstats.m_numHmaps-- ;
+	}
+
+	//	Init functions
+	void	SetName	(const hzString& name)	{ m_Name = name ; }
+
+	void	SetLock	(hzLockOpt eLock)
+	{
+		_droplock() ;
+		m_eLock = eLock ;
+
+		if (eLock == HZ_ATOMIC)
+			m_pLock = new hzLockRW() ;
+		else if (eLock == HZ_MUTEX)
+			m_pLock = m_Name.Length() ? new hzLockRWD(*m_Name) : new hzLockRWD() ;
+		else
+			m_eLock = HZ_NOLOCK ;
+	}
+
+	void	LockRead	(void) const	{ if (m_pLock) m_pLock->LockRead() ; }
+	void	LockWrite	(void) const	{ if (m_pLock) m_pLock->LockWrite() ; }
+	void	Unlock		(void) const	{ if (m_pLock) m_pLock->Unlock() ; }
+
+	void	Clear	(void)
+	{
+		LockWrite() ;
+		_clear() ;
+		Unlock() ;
+	}
+
+	void	Reserve	(uint32_t nKeys)
+	{
+		//	Size the map to hold the given number of keys without further growth
+
+		LockWrite() ;
+		_reserve(nKeys) ;
+		Unlock() ;
+	}
+
+	//	Insert and delete by key
+	hzEcode	Insert	(const KEY& key, const OBJ& obj)
+	{
+		//	Insert a key/object pair. As with hzMapS::Insert, if the key already exists its object is replaced by the one supplied.
+		//
+		//	Arguments:	1)	key		The key
+		//				2)	obj		The object
+		//
+		//	Returns:	E_OK		If the key/object pair was inserted or the object replaced
+
+		_hzfunc("hzHashMap::Insert") ;
+
+		uint64_t	hash ;		//	Key hash
+		uint32_t	nSlot ;		//	Target slot
+		int32_t		nFound ;	//	Slot of existing key
+
+		hash = _hz_keyhash(key) ;
+
+		LockWrite() ;
+
+		nFound = _find(key, hash) ;
+		if (nFound >= 0)
+		{
+			m_pObjs[m_pSlots[nFound]] = obj ;
+			Unlock() ;
+			return E_OK ;
+		}
+
+		_reserve(m_nCount + 1) ;
+
+		nSlot = _freeslot(hash) ;
+		if (m_pCtrl[nSlot] == HZ_HMAP_DELETED)
+			m_nDeleted-- ;
+		_setctrl(nSlot, hash & 0x7f) ;
+		m_pSlots[nSlot] = m_nCount ;
+		m_pKeys[m_nCount] = key ;
+		m_pObjs[m_nCount] = obj ;
+		m_nCount++ ;
+
+		Unlock() ;
+		return E_OK ;
+	}
+
+	hzEcode	Delete	(const KEY& key)
+	{
+		//	Delete the key and its object. The last key/object pair in the dense arrays is moved into the vacated position.
+		//
+		//	Arguments:	1)	key		The key
+		//
+		//	Returns:	E_NOTFOUND	If the key does not exist
+		//				E_OK		If the key was deleted
+
+		_hzfunc("hzHashMap::Delete") ;
+
+		uint32_t	nPosn ;		//	Dense array position of the deleted key
+		uint32_t	nLast ;		//	Dense array position of the last key
+		int32_t		nSlot ;		//	Slot of the key
+		int32_t		nMove ;		//	Slot of the last key
+
+		LockWrite() ;
+
+		nSlot = _find(key, _hz_keyhash(key)) ;
+		if (nSlot < 0)
+			{ Unlock() ; return E_NOTFOUND ; }
+
+		nPosn = m_pSlots[nSlot] ;
+		nLast = m_nCount - 1 ;
+
+		if (nPosn != nLast)
+		{
+			nMove = _find(m_pKeys[nLast], _hz_keyhash(m_pKeys[nLast])) ;
+			m_pKeys[nPosn] = m_pKeys[nLast] ;
+			m_pObjs[nPosn] = m_pObjs[nLast] ;
+			m_pSlots[nMove] = nPosn ;
+		}
+
+		m_pKeys[nLast] = m_NullKey ;
+		m_pObjs[nLast] = m_NullObj ;
+		_setctrl(nSlot, HZ_HMAP_DELETED) ;
+		m_nDeleted++ ;
+		m_nCount-- ;
+
+		Unlock() ;
+		return E_OK ;
+	}
+
+	//	Locate keys or objects by position
+	OBJ&	GetObj	(uint32_t nIndex) const
+	{
+		if (nIndex >= m_nCount)
+		{
+			m_DefaultObj = m_NullObj ;
+			return m_DefaultObj ;
+		}
+		return m_pObjs[nIndex] ;
+	}
+
+	KEY&	GetKey	(uint32_t nIndex) const
+	{
+		if (nIndex >= m_nCount)
+		{
+			m_DefaultKey = m_NullKey ;
+			return m_DefaultKey ;
+		}
+		return m_pKeys[nIndex] ;
+	}
+
+	//	Locate elements by value
+	bool	Exists	(const KEY& key) const
+	{
+		int32_t	nSlot ;		//	Slot of the key
+
+		LockRead() ;
+		nSlot = _find(key, _hz_keyhash(key)) ;
+		Unlock() ;
+		return nSlot >= 0 ;
+	}
+
+	bool	Lookup	(OBJ& obj, const KEY& key) const
+	{
+		//	Copy the object for the key (if found) while the map is locked
+		//
+		//	Arguments:	1)	obj		The object found (set to null if not found)
+		//				2)	key		The key
+		//
+		//	Returns:	True if the key exists, false otherwise
+
+		int32_t	nSlot ;		//	Slot of the key
+
+		LockRead() ;
+		nSlot = _find(key, _hz_keyhash(key)) ;
+		obj = nSlot < 0 ? m_NullObj : m_pObjs[m_pSlots[nSlot]] ;
+		Unlock() ;
+		return nSlot >= 0 ;
+	}
+
+	OBJ&	operator[]	(const KEY& key) const
+	{
+		int32_t	nSlot ;		//	Slot of the key
+
+		LockRead() ;
+		nSlot = _find(key, _hz_keyhash(key)) ;
+		Unlock() ;
+
+		if (nSlot < 0)
+		{
+			m_DefaultObj = m_NullObj ;
+			return m_DefaultObj ;
+		}
+		return m_pObjs[m_pSlots[nSlot]] ;
+	}
+
+	//	Diagnostics
+	uint32_t	Count	(void) const	{ return m_nCount ; }
+	uint32_t	Slots	(void) const	{ return m_nSlots ; }
+	hzString	Name	(void) const	{ return m_Name ; }
+} ;
+
+#endif	//	hzTmplMapH_h
@@ -150,6 +150,24 @@ public:
 		return E_OK ;
 	}
 
+	//	Bulk insert
+	hzEcode	BulkInsert	(const hzString* pKeys, const OBJ* pObjs, uint32_t nItems, bool bSorted = false)
+	{
+		//	Insert a batch of string/object pairs, sorting the batch (unless bSorted is set) and building the lookup bottom up. If the lookup is already
+		//	populated, the batch is merged with the existing pairs. Where strings are repeated, the last pair in the batch with the string prevails.
+		//
+		//	Arguments:	1)	pKeys	Array of nItems strings
+		//				2)	pObjs	Array of nItems objects
+		//				3)	nItems	Number of string/object pairs
+		//				4)	bSorted	Set if the batch is already in order
+		//
+		//	Returns:	E_ARGUMENT	If either array is not supplied
+		//				E_CORRUPT	If the lookup is corrupted
+		//				E_OK		If the batch was inserted
+
+		return _hz_bulk_map(base, pKeys, pObjs, nItems, bSorted, true) ;
+	}
+
 	//	Locate keys or objects by position
 	OBJ&	GetObj	(int32_t nIndex) const
 	{
@@ -88,6 +88,19 @@ public:
 		_hzGlobal_Memstats.m_numSmaps++ ;
 	}
 
+	hzMapM	(hzLockOpt eLock, const KEY* pKeys, const OBJ* pObjs, uint32_t nItems, bool bSorted = false)
+	{
+		//	Construct and bulk load from a batch (see BulkInsert)
+
+		base.Start(sizeof(KEY), sizeof(OBJ)) ;
+		base.SetLock(eLock) ;
+		base.m_compare = _tmpl_map_compare<KEY,OBJ> ;
+		memset(&m_NullKey, 0, sizeof(KEY)) ;
+		memset(&m_NullObj, 0, sizeof(OBJ)) ;
+		_hzGlobal_Memstats.m_numMmaps++ ;
+		BulkInsert(pKeys, pObjs, nItems, bSorted) ;
+	}
+
 	~hzMapM	(void)	{ _hzGlobal_Memstats.m_numMmaps-- ; }
 
 	//	Init functions
@@ -160,6 +173,25 @@ public:
 		return base.DeletePosn(nPosn) ;
 	}
 
+	//	Bulk insert
+	hzEcode	BulkInsert	(const KEY* pKeys, const OBJ* pObjs, uint32_t nItems, bool bSorted = false)
+	{
+		//	Insert a batch of key/object pairs. The batch is sorted (unless bSorted is set to indicate the caller has already done this), and the map is
+		//	then built bottom up, with data and index nodes fully packed. If the map is already populated, the batch is merged with the existing pairs.
+		//	Objects under the same key remain in order of incidence, with those in the batch following those already present.
+		//
+		//	Arguments:	1)	pKeys	Array of nItems keys
+		//				2)	pObjs	Array of nItems objects
+		//				3)	nItems	Number of key/object pairs
+		//				4)	bSorted	Set if the batch is already in key order
+		//
+		//	Returns:	E_ARGUMENT	If either array is not supplied
+		//				E_CORRUPT	If the map is corrupted
+		//				E_OK		If the batch was inserted
+
+		return _hz_bulk_map(base, pKeys, pObjs, nItems, bSorted, false) ;
+	}
+
 	//	Locate keys or objects by position
 	OBJ&	GetObj	(uint32_t nIndex) const
 	{
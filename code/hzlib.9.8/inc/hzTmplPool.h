@@ -0,0 +1,204 @@
+//
+//	File:	hzTmplPool.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+
+#ifndef hzTmplPool_h
+#define hzTmplPool_h
+
+#include <new>
+
+#include "hzBasedefs.h"
+#include "hzLock.h"
+#include "hzProcess.h"
+
+/*
+**	Prototypes
+*/
+
+void	Fatal	(const char* va_alist ...) ;
+
+/*
+**	Definitions
+*/
+
+#define HZ_CACHELINE		64		//	Cache line size assumed for slab alignment
+#define HZ_POOL_MINSLAB		4		//	Nodes in the first slab of a pool
+#define HZ_POOL_MAXSLAB		256		//	Maximum nodes in a slab
+
+/*
+**	The node pool
+*/
+
+template <class NODE>	class	_hz_node_pool
+{
+	//	Category:	Collection Support
+	//
+	//	Slab allocator for the nodes of the linked collection templates, hzList, hzQue and hzStack. Nodes are carved from slabs which are aligned to, and sized
+	//	in multiples of, the cache line, so nodes that are adjacent in a list are usually adjacent in memory. Released nodes go on a free list and are reused
+	//	before any further carving. Slabs are only returned to the heap when the pool is Reset() or destroyed, which the collection does on Clear().
+	//
+	//	Because collections are often numerous and short, the first slab is small (HZ_POOL_MINSLAB nodes) and each subsequent slab is double the size of the
+	//	last, up to HZ_POOL_MAXSLAB nodes.
+	//
+	//	A pool is normally private to a collection and protected by the collection's own lock. A pool may however be shared by collections (of the same type),
+	//	so that nodes can be spliced from one to another without copying. The pool is reference counted and once shared, Take() and Give() lock the pool
+	//	and the pool is only reset when the last collection using it is destroyed.
+
+	struct	_slab
+	{
+		//	Slab header. Nodes follow the header, starting on the next cache line.
+
+		_slab*		next ;		//	Next slab in pool
+		uint32_t	m_nNodes ;	//	Nodes in this slab
+	} ;
+
+	_slab*		m_pSlabs ;		//	Slabs allocated
+	NODE*		m_pFree ;		//	Released nodes (linked by the node's next pointer)
+	uchar*		m_pCarve ;		//	Next uncarved node in the current slab
+	uchar*		m_pLimit ;		//	End of current slab
+	hzLockS		m_Lock ;		//	Lock (only used when shared)
+	uint32_t	m_nRefs ;		//	Number of collections using the pool
+	uint32_t	m_nNext ;		//	Number of nodes in the next slab
+	uint32_t	m_nLive ;		//	Number of nodes currently taken
+	bool		m_bShared ;		//	Set once the pool is shared (and never cleared)
+
+	//	Prevent copies
+	_hz_node_pool	(const _hz_node_pool&) ;
+	_hz_node_pool&	operator=	(const _hz_node_pool&) ;
+
+	static	uint32_t	_nodesize	(void)	{ return (sizeof(NODE) + 7) & ~7 ; }
+	static	uint32_t	_hdrsize	(void)	{ return (sizeof(_slab) + HZ_CACHELINE - 1) & ~(HZ_CACHELINE - 1) ; }
+
+	void	_addslab	(void)
+	{
+		//	Allocate a new slab and make it the current slab for carving
+
+		_slab*		pSlab ;		//	New slab
+		void*		pMem = 0 ;	//	Slab memory
+		uint32_t	nBytes ;	//	Slab size
+
+		nBytes = _hdrsize() + (m_nNext * _nodesize()) ;
+		nBytes = (nBytes + HZ_CACHELINE - 1) & ~(HZ_CACHELINE - 1) ;
+
+		if (posix_memalign(&pMem, HZ_CACHELINE, nBytes))
+		{
+			Fatal("_hz_node_pool::_addslab. Could not allocate slab of %u nodes\n", m_nNext) ;
+			return ;
+		}
+
+		pSlab = (_slab*) pMem ;
+		pSlab->m_nNodes = (nBytes - _hdrsize()) / _nodesize() ;
+		pSlab->next = m_pSlabs ;
+		m_pSlabs = pSlab ;
+
+		m_pCarve = (uchar*) pMem + _hdrsize() ;
+		m_pLimit = m_pCarve + (pSlab->m_nNodes * _nodesize()) ;
+
+		if (m_nNext < HZ_POOL_MAXSLAB)
+			m_nNext *= 2 ;
+		_hzGlobal_Memstats.m_numNodeSlabs++ ;
+	}
+
+	void	_lock	(void)	{ if (m_bShared && _hzGlobal_MT) m_Lock.Lock() ; }
+	void	_unlock	(void)	{ if (m_bShared && _hzGlobal_MT) m_Lock.Unlock() ; }
+
+public:
+	_hz_node_pool	(void)
+	{
+		m_pSlabs = 0 ;
+		m_pFree = 0 ;
+		m_pCarve = m_pLimit = 0 ;
+		m_nRefs = 1 ;
+		m_nNext = HZ_POOL_MINSLAB ;
+		m_nLive = 0 ;
+		m_bShared = false ;
+	}
+
+	~_hz_node_pool	(void)	{ Reset() ; }
+
+	void*	Take	(void)
+	{
+		//	Obtain memory for a node. The caller constructs the node with placement new.
+		//
+		//	Arguments:	None
+		//	Returns:	Pointer to uninitialized node memory
+
+		void*	pMem ;	//	Node memory
+
+		_lock() ;
+		if (m_pFree)
+		{
+			pMem = m_pFree ;
+			m_pFree = m_pFree->next ;
+		}
+		else
+		{
+			if (m_pCarve >= m_pLimit)
+				_addslab() ;
+			pMem = m_pCarve ;
+			m_pCarve += _nodesize() ;
+		}
+		m_nLive++ ;
+		_unlock() ;
+		return pMem ;
+	}
+
+	void	Give	(NODE* pNode)
+	{
+		//	Destruct a node and return its memory to the free list
+		//
+		//	Arguments:	1)	pNode	The node, which must have been obtained from this pool
+		//	Returns:	None
+
+		pNode->~NODE() ;
+
+		_lock() ;
+		pNode->next = m_pFree ;
+		m_pFree = pNode ;
+		m_nLive-- ;
+		_unlock() ;
+	}
+
+	void	Reset	(void)
+	{
+		//	Free all slabs. The caller must first have destructed any nodes still live, and must not call Reset() on a shared pool.
+
+		_slab*	pSlab ;		//	Slab iterator
+
+		for (; m_pSlabs ; m_pSlabs = pSlab)
+		{
+			pSlab = m_pSlabs->next ;
+			free(m_pSlabs) ;
+			_hzGlobal_Memstats.m_numNodeSlabs-- ;
+		}
+
+		m_pFree = 0 ;
+		m_pCarve = m_pLimit = 0 ;
+		m_nNext = HZ_POOL_MINSLAB ;
+		m_nLive = 0 ;
+	}
+
+	//	Sharing
+	_hz_node_pool*	Share	(void)	{ m_bShared = true ; __sync_add_and_fetch(&m_nRefs, 1) ; return this ; }
+	bool			Drop	(void)	{ return __sync_sub_and_fetch(&m_nRefs, 1) == 0 ; }
+	bool			Shared	(void) const	{ return m_bShared ; }
+
+	//	Diagnostics
+	uint32_t	Live	(void) const	{ return m_nLive ; }
+} ;
+
+#endif	//	hzTmplPool_h
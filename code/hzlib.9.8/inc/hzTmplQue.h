@@ -21,6 +21,7 @@
 #include "hzString.h"
 #include "hzLock.h"
 #include "hzProcess.h"
+#include "hzTmplPool.h"
 
 /*
 **	Prototypes
@@ -47,6 +48,12 @@ template <class OBJ>	class	hzQue
 	//
 	//	The hzQue class template faciliates a memory resident que of objects. A que is characterized by PUSH and POP operations in which new
 	//	objects are injected at the back of the que (pushed) and objects are removed from the front of the que (pulled).
+	//
+	//	Que elements are held in nodes drawn from a slab pool (see _hz_node_pool) created on the first push, so pushing does not as a rule, call the heap. Objects
+	//	can be pushed and pulled in batches under a single lock with PushMany() and PullMany(). The entire content of one que can be appended to another with
+	//	Splice(). This moves the nodes without copying where the two ques share a pool (see SharePool()), and copies them otherwise.
+
+	typedef	_hz_node_pool< _hz_queitem<OBJ> >	_pool ;
 
 private:
 	struct	_que_ca
@@ -56,14 +63,15 @@ private:
 		_hz_queitem<OBJ>*	m_pList ;	//	Start of que
 		_hz_queitem<OBJ>*	m_pLast ;	//	End of que
 
+		_pool*			m_pPool ;		//	Node pool
 		hzLocker*		m_pLock ;		//	Locking (off by default)
 		hzString		m_Name ;		//	Diagnostics & reports
 		uint32_t		m_nCount ;		//	Population
 		_m uint32_t		m_nCopy ;		//	Copy count
 		OBJ				m_Default ;		//	Default (null) element
 
-		_que_ca		(void)	{ memset(&m_Default, 0, sizeof(OBJ)) ; m_pList = m_pLast = 0 ; m_pLock = 0 ; m_nCount = m_nCopy = 0 ; }
-		~_que_ca	(void)	{}
+		_que_ca		(void)	{ memset(&m_Default, 0, sizeof(OBJ)) ; m_pList = m_pLast = 0 ; m_pLock = 0 ; m_nCount = m_nCopy = 0 ; m_pPool = 0 ; }
+		~_que_ca	(void)	{ if (m_pPool && m_pPool->Drop()) delete m_pPool ; delete m_pLock ; }
 
 		void	SetLock	(hzLockOpt eLock)
 		{
@@ -74,6 +82,33 @@ private:
 		void	LockRead	(void)	{ if (m_pLock) m_pLock->LockRead() ; }
 		void	LockWrite	(void)	{ if (m_pLock) m_pLock->LockWrite() ; }
 		void	Unlock		(void)	{ if (m_pLock) m_pLock->Unlock() ; }
+
+		_pool*	Pool	(void)	{ if (!m_pPool) m_pPool = new _pool() ; return m_pPool ; }
+
+		_hz_queitem<OBJ>*	_node	(const OBJ& obj)	{ return new (Pool()->Take()) _hz_queitem<OBJ>(obj) ; }
+
+		void	_clear	(void)
+		{
+			//	Release all nodes. A private pool is simply reset, a shared pool has the nodes given back one by one.
+
+			_hz_queitem<OBJ>*	pC ;	//	Current list item
+			_hz_queitem<OBJ>*	pN ;	//	Next list item
+
+			for (pC = m_pList ; pC ; pC = pN)
+			{
+				pN = pC->next ;
+				if (m_pPool->Shared())
+					m_pPool->Give(pC) ;
+				else
+					pC->~_hz_queitem<OBJ>() ;
+			}
+
+			if (m_pPool && !m_pPool->Shared())
+				m_pPool->Reset() ;
+
+			m_pList = m_pLast = 0 ;
+			m_nCount = 0 ;
+		}
 	} ;
 
 	_que_ca*	mx ;	//	Pointer to internal content
@@ -102,38 +137,33 @@ public:
 
 	void	Clear	(void)
 	{
-		_hz_queitem<OBJ>*	pC ;	//	Curreent list item
-		_hz_queitem<OBJ>*	pN ;	//	Next list item
-
-		for (pC = mx->m_pList ; pC ; pC = pN)
-		{
-			pN = pC->next ;
-			delete pC ;
-		}
-
-		mx->m_pList = mx->m_pLast = 0 ;
-		mx->m_nCount = 0 ;
+		mx->LockWrite() ;
+		mx->_clear() ;
+		mx->Unlock() ;
 	}
 
-	//	Assignment operator
-	/*
-	const hzQue<OBJ>&	operator=	(const hzQue<OBJ>& op)
+	hzEcode	SharePool	(hzQue<OBJ>& other)
 	{
-		//	If this control area is the same as that of the operand, do nothing. Otherwise decouple from or clear the control area and adopt that of the operand.
-		if (mx == op.mx)
-			return *this ;
-
-			//	If there is an existing list, clear it.
-		if (mx->m_nCopy)
-			mx->m_nCopy-- ;
-		else
-			mx->Clear() ;
-
-		mx = op.mx ;
-		mx->m_nCopy++ ;
-		return *this ;
+		//	Adopt the node pool of another que so that Splice() between the two moves nodes rather than copying them. This que must be empty.
+		//
+		//	Arguments:	1)	other	The que whose pool is to be shared
+		//
+		//	Returns:	E_SEQUENCE	If this que is not empty
+		//				E_OK		If the pool is now shared
+
+		if (mx->m_pPool == other.mx->Pool())
+			return E_OK ;
+
+		mx->LockWrite() ;
+		if (mx->m_nCount)
+			{ mx->Unlock() ; return E_SEQUENCE ; }
+
+		if (mx->m_pPool && mx->m_pPool->Drop())
+			delete mx->m_pPool ;
+		mx->m_pPool = other.mx->m_pPool->Share() ;
+		mx->Unlock() ;
+		return E_OK ;
 	}
-	*/
 
 	uint32_t	Count	(void)
 	{
@@ -147,40 +177,180 @@ public:
 
 		_hz_queitem<OBJ>*	pTL ;	//	List item to accomodate new object
 
-		if (!(pTL = new _hz_queitem<OBJ>(obj)))
-			Fatal("Could not allocate new que element") ;
+		mx->LockWrite() ;
+
+		pTL = mx->_node(obj) ;
 
 		if (mx->m_pList == 0)
 			mx->m_pList = mx->m_pLast = pTL ;
 		else
 		{
-			//mx->m_pLast->m_pNext = pTL ;
 			mx->m_pLast->next = pTL ;
 			mx->m_pLast = pTL ;
 		}
 
 		mx->m_nCount++ ;
+		mx->Unlock() ;
+		return E_OK ;
+	}
+
+	hzEcode	PushMany	(const OBJ* pObjs, uint32_t nObjs)
+	{
+		//	Push a series of objects onto the queue, in order, under a single lock
+		//
+		//	Arguments:	1)	pObjs	Array of objects
+		//				2)	nObjs	Number of objects
+		//
+		//	Returns:	E_ARGUMENT	If no array is supplied
+		//				E_OK		If the objects were pushed
+
+		_hz_queitem<OBJ>*	pTL ;	//	List item to accomodate new object
+		uint32_t			n ;		//	Object iterator
+
+		if (!nObjs)
+			return E_OK ;
+		if (!pObjs)
+			return E_ARGUMENT ;
+
+		mx->LockWrite() ;
+
+		for (n = 0 ; n < nObjs ; n++)
+		{
+			pTL = mx->_node(pObjs[n]) ;
+
+			if (mx->m_pList == 0)
+				mx->m_pList = mx->m_pLast = pTL ;
+			else
+			{
+				mx->m_pLast->next = pTL ;
+				mx->m_pLast = pTL ;
+			}
+		}
+
+		mx->m_nCount += nObjs ;
+		mx->Unlock() ;
 		return E_OK ;
 	}
 
-	OBJ&	Pull	(void)
+	OBJ	Pull	(void)
 	{
 		//	Pull an object from the queue
+		//
+		//	Arguments:	None
+		//	Returns:	Copy of the object at the front of the que (or the default object if the que is empty). The copy is returned by value as
+		//				several threads may pull at once.
+
+		_hz_queitem<OBJ>*	pTL ;	//	Object-link iterator
+		OBJ					obj ;	//	Object pulled
+
+		mx->LockWrite() ;
+
+		if (!(pTL = mx->m_pList))
+		{
+			mx->Unlock() ;
+			return mx->m_Default ;
+		}
+
+		obj = pTL->m_Obj ;
+		mx->m_pList = pTL->next ;
+		if (!mx->m_pList)
+			mx->m_pLast = 0 ;
+		mx->m_pPool->Give(pTL) ;
+		mx->m_nCount-- ;
+
+		mx->Unlock() ;
+		return obj ;
+	}
+
+	uint32_t	PullMany	(OBJ* pObjs, uint32_t nMax)
+	{
+		//	Pull up to nMax objects from the front of the queue, under a single lock
+		//
+		//	Arguments:	1)	pObjs	Array to receive the objects
+		//				2)	nMax	Size of the array
+		//
+		//	Returns:	Number of objects pulled
 
 		_hz_queitem<OBJ>*	pTL ;	//	Object-link iterator
+		uint32_t			n ;		//	Objects pulled
 
-		OBJ		obj ;				//	Current object-link
+		if (!pObjs)
+			return 0 ;
 
-		if ((pTL = mx->m_pList))
+		mx->LockWrite() ;
+
+		for (n = 0 ; n < nMax && (pTL = mx->m_pList) ; n++)
 		{
-			obj = mx->m_pList->m_Obj ;
-			//mx->m_pList = mx->m_pList->m_pNext ;
-			mx->m_pList = mx->m_pList->next ;
-			delete pTL ;
-			mx->m_nCount-- ;
+			pObjs[n] = pTL->m_Obj ;
+			mx->m_pList = pTL->next ;
+			mx->m_pPool->Give(pTL) ;
 		}
 
-		return mx->m_Default ;
+		if (!mx->m_pList)
+			mx->m_pLast = 0 ;
+		mx->m_nCount -= n ;
+
+		mx->Unlock() ;
+		return n ;
+	}
+
+	hzEcode	Splice	(hzQue<OBJ>& src)
+	{
+		//	Move the entire content of the supplied que to the back of this que, leaving the supplied que empty. Where the ques share a pool, this is done by
+		//	relinking and costs the same regardless of the number of objects. Otherwise the objects are copied.
+		//
+		//	Arguments:	1)	src		The que to be emptied into this que
+		//
+		//	Returns:	E_ARGUMENT	If the supplied que is this que
+		//				E_OK		If the content was moved
+
+		_hz_queitem<OBJ>*	pTL ;	//	Object-link iterator
+		_hz_queitem<OBJ>*	pNL ;	//	Next link
+		_hz_queitem<OBJ>*	pNew ;	//	Copied link
+
+		if (src.mx == mx)
+			return E_ARGUMENT ;
+
+		//	Lock in a consistent order
+		if (mx < src.mx)
+			{ mx->LockWrite() ; src.mx->LockWrite() ; }
+		else
+			{ src.mx->LockWrite() ; mx->LockWrite() ; }
+
+		if (src.mx->m_pList)
+		{
+			if (mx->m_pPool == src.mx->m_pPool)
+			{
+				if (mx->m_pList)
+					mx->m_pLast->next = src.mx->m_pList ;
+				else
+					mx->m_pList = src.mx->m_pList ;
+				mx->m_pLast = src.mx->m_pLast ;
+			}
+			else
+			{
+				for (pTL = src.mx->m_pList ; pTL ; pTL = pNL)
+				{
+					pNL = pTL->next ;
+					pNew = mx->_node(pTL->m_Obj) ;
+
+					if (mx->m_pList)
+						mx->m_pLast->next = pNew ;
+					else
+						mx->m_pList = pNew ;
+					mx->m_pLast = pNew ;
+					src.mx->m_pPool->Give(pTL) ;
+				}
+			}
+
+			mx->m_nCount += src.mx->m_nCount ;
+			src.mx->m_pList = src.mx->m_pLast = 0 ;
+			src.mx->m_nCount = 0 ;
+		}
+
+		src.mx->Unlock() ;
+		mx->Unlock() ;
+		return E_OK ;
 	}
 
 	hzEcode	Delete	(const OBJ& obj)
@@ -194,14 +364,15 @@ public:
 
 		//	match obj pointer to one on list
 
+		mx->LockWrite() ;
+
 		pPL = 0 ;
-		for (pTL = mx->m_pList ; pTL ; pTL = pTL->m_pNext)
+		for (pTL = mx->m_pList ; pTL ; pTL = pTL->next)
 		{
 			if (pTL->m_Obj == obj)
 			{
 				//	found item to delete
 				if (pTL == mx->m_pList)
-					//mx->m_pList = mx->m_pList->m_pNext ;
 					mx->m_pList = mx->m_pList->next ;
 
 				//	If the item is the last
@@ -210,10 +381,9 @@ public:
 
 				//	tie adjacent items together
 				if (pPL)
-					//pPL->m_pNext = pTL->m_pNext;
 					pPL->next = pTL->next;
 
-				delete pTL ;
+				mx->m_pPool->Give(pTL) ;
 				mx->m_nCount-- ;
 				rc = E_OK ;
 				break ;
@@ -222,6 +392,7 @@ public:
 			pPL = pTL ;
 		}
 
+		mx->Unlock() ;
 		return rc ;
 	}
 } ;
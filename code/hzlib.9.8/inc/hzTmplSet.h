@@ -81,6 +81,18 @@ public:
 		_hzGlobal_Memstats.m_numSets++ ;
 	}
 
+	hzSet	(hzLockOpt eLock, const KEY* pKeys, uint32_t nItems, bool bSorted = false)
+	{
+		//	Construct and bulk load from a batch (see BulkInsert)
+
+		base.Start(sizeof(KEY), 0) ;
+		base.SetLock(eLock) ;
+		base.m_compare = _tmpl_set_compare<KEY> ;
+		memset(&m_Null, 0, sizeof(KEY)) ;
+		_hzGlobal_Memstats.m_numSets++ ;
+		BulkInsert(pKeys, nItems, bSorted) ;
+	}
+
 	~hzSet	(void)	{ _hzGlobal_Memstats.m_numSets-- ; }
 
 	//	Inits
@@ -128,6 +140,24 @@ public:
 		return E_OK ;
 	}
 
+	//	Bulk insert
+	hzEcode	BulkInsert	(const KEY* pKeys, uint32_t nItems, bool bSorted = false)
+	{
+		//	Insert a batch of keys. The batch is sorted (unless bSorted is set to indicate the caller has already done this), and the set is then built
+		//	bottom up, with data and index nodes fully packed. If the set is already populated, the batch is merged with the existing keys. Repeated keys
+		//	are ignored.
+		//
+		//	Arguments:	1)	pKeys	Array of nItems keys
+		//				2)	nItems	Number of keys
+		//				3)	bSorted	Set if the batch is already in order
+		//
+		//	Returns:	E_ARGUMENT	If the array is not supplied
+		//				E_CORRUPT	If the set is corrupted
+		//				E_OK		If the batch was inserted
+
+		return _hz_bulk_set(base, pKeys, nItems, bSorted) ;
+	}
+
 	//	Lookup
 	bool	Exists	(const KEY& key) const
 	{
@@ -21,6 +21,7 @@
 #include "hzString.h"
 #include "hzLock.h"
 #include "hzProcess.h"
+#include "hzTmplPool.h"
 
 /*
 **	Prototypes
@@ -52,23 +53,29 @@ template <class OBJ>	class	hzStack
 	//	The hzStack class template faciliates a memory resident stack of objects. A stack is characterized by PUSH and PULL operations in which new
 	//	objects are injected at the front of the stack (pushed) and objects are removed from the front of the stack (pulled). This provides a LIFO
 	//	(last-in, first-out) operation. This differs from a que (hzQue) in which new objects are placed at the back of a que and popped in order.
+	//
+	//	As with hzQue, stack elements are held in nodes drawn from a slab pool (see _hz_node_pool), objects can be pushed and pulled in batches with PushMany()
+	//	and PullMany(), and the entire content of one stack can be placed on top of another with Splice().
+
+	typedef	_hz_node_pool< _hz_stackitem<OBJ> >	_pool ;
 
 private:
 	struct	_stack_ca
 	{
 		//	Struct to hold actual content (avoid hard copying)
 
-		_hz_stackitem<OBJ>*	m_pList ;	//	Start of list of objects in stack
-		_hz_stackitem<OBJ>*	m_pLast ;	//	Pointer to last object in the stack
+		_hz_stackitem<OBJ>*	m_pList ;	//	Top of the stack
+		_hz_stackitem<OBJ>*	m_pLast ;	//	Bottom of the stack
 
+		_pool*			m_pPool ;		//	Node pool
 		hzLocker*		m_pLock ;		//	Locking (off by default)
 		hzString		m_Name ;		//	Diagnostics & reports
 		uint32_t		m_nCount ;		//	Population
 		mutable int32_t	m_nCopy ;		//	Copy count
 		OBJ				m_Default ;		//	Default (null) element
 
-		_stack_ca	(void)	{ memset(&m_Default, 0, sizeof(OBJ)) ; m_pList = m_pLast = 0 ; m_pLock = 0 ; m_nCount = m_nCopy = 0 ; }
-		~_stack_ca	(void)	{ delete m_pLock ; }
+		_stack_ca	(void)	{ memset(&m_Default, 0, sizeof(OBJ)) ; m_pList = m_pLast = 0 ; m_pLock = 0 ; m_nCount = m_nCopy = 0 ; m_pPool = 0 ; }
+		~_stack_ca	(void)	{ if (m_pPool && m_pPool->Drop()) delete m_pPool ; delete m_pLock ; }
 
 		void	SetLock	(hzLockOpt eLock)
 		{
@@ -79,6 +86,21 @@ private:
 		void	LockRead	(void)	{ if (m_pLock) m_pLock->LockRead() ; }
 		void	LockWrite	(void)	{ if (m_pLock) m_pLock->LockWrite() ; }
 		void	Unlock		(void)	{ if (m_pLock) m_pLock->Unlock() ; }
+
+		_pool*	Pool	(void)	{ if (!m_pPool) m_pPool = new _pool() ; return m_pPool ; }
+
+		_hz_stackitem<OBJ>*	_node	(const OBJ& obj)	{ return new (Pool()->Take()) _hz_stackitem<OBJ>(obj) ; }
+
+		void	_push	(_hz_stackitem<OBJ>* pTL)
+		{
+			//	Place a node on top of the stack
+
+			pTL->next = m_pList ;
+			m_pList = pTL ;
+			if (!m_pLast)
+				m_pLast = pTL ;
+			m_nCount++ ;
+		}
 	} ;
 
 	_stack_ca*	mx ;	//	Pointer to internal content
@@ -91,7 +113,6 @@ public:
 	//	Constructor
 	hzStack	(hzLockOpt eLock = HZ_NOLOCK)	{ mx = new _stack_ca() ; mx->SetLock(eLock) ; }
 	hzStack	(const hzString name)			{ mx = new _stack_ca() ; mx->m_Name = name ; mx->SetLock(HZ_MUTEX) ; }
-	//hzStack	(const hzStack<OBJ>& op)		{ mx = op.mx ; mx->m_nCopy++ ; }
 
 	//	Destructor
 	~hzStack	(void)
@@ -107,39 +128,54 @@ public:
 
 	uint32_t	Count	(void)	{ return mx->m_nCount ; }
 
-	/*
-	const hzStack<OBJ>&	operator=	(const hzStack<OBJ>& op)
-	{
-		//	If this control area is the same as that of the operand, do nothing. Otherwise decouple from or clear the control area and adopt that of the operand.
-		if (mx == op.mx)
-			return *this ;
-
-		if (mx->m_nCopy)
-			mx->m_nCopy-- ;
-		else
-			mx->Clear() ;
-
-		mx = op.mx ;
-		mx->m_nCopy++ ;
-		return *this ;
-	}
-	*/
-
 	void	Clear	(void)
 	{
-		//	Delete all objects from the stack
+		//	Delete all objects from the stack. A private pool is simply reset, a shared pool has the nodes given back one by one.
 
 		_hz_stackitem<OBJ>*	pC ;	//	Current object pointer
 		_hz_stackitem<OBJ>*	pN ;	//	Next object in series
 
+		mx->LockWrite() ;
+
 		for (pC = mx->m_pList ; pC ; pC = pN)
 		{
 			pN = pC->next ;
-			delete pC ;
+			if (mx->m_pPool->Shared())
+				mx->m_pPool->Give(pC) ;
+			else
+				pC->~_hz_stackitem<OBJ>() ;
 		}
 
+		if (mx->m_pPool && !mx->m_pPool->Shared())
+			mx->m_pPool->Reset() ;
+
 		mx->m_pList = mx->m_pLast = 0 ;
 		mx->m_nCount = 0 ;
+
+		mx->Unlock() ;
+	}
+
+	hzEcode	SharePool	(hzStack<OBJ>& other)
+	{
+		//	Adopt the node pool of another stack so that Splice() between the two moves nodes rather than copying them. This stack must be empty.
+		//
+		//	Arguments:	1)	other	The stack whose pool is to be shared
+		//
+		//	Returns:	E_SEQUENCE	If this stack is not empty
+		//				E_OK		If the pool is now shared
+
+		if (mx->m_pPool == other.mx->Pool())
+			return E_OK ;
+
+		mx->LockWrite() ;
+		if (mx->m_nCount)
+			{ mx->Unlock() ; return E_SEQUENCE ; }
+
+		if (mx->m_pPool && mx->m_pPool->Drop())
+			delete mx->m_pPool ;
+		mx->m_pPool = other.mx->m_pPool->Share() ;
+		mx->Unlock() ;
+		return E_OK ;
 	}
 
 	void	Push	(const OBJ obj)
@@ -151,45 +187,160 @@ public:
 
 		_hzfunc_ct("hzStack::Push") ;
 
-		_hz_stackitem<OBJ>*	pTL ;	//	New object pointer
+		mx->LockWrite() ;
+		mx->_push(mx->_node(obj)) ;
+		mx->Unlock() ;
+	}
 
-		if (!(pTL = new _hz_stackitem<OBJ>(obj)))
-			Fatal("hzStack::Push. Allocaction failure") ;
+	hzEcode	PushMany	(const OBJ* pObjs, uint32_t nObjs)
+	{
+		//	Push a series of objects onto the stack, in order (so the last in the series is on top), under a single lock
+		//
+		//	Arguments:	1)	pObjs	Array of objects
+		//				2)	nObjs	Number of objects
+		//
+		//	Returns:	E_ARGUMENT	If no array is supplied
+		//				E_OK		If the objects were pushed
 
-		if (mx->m_pList == 0)
-			mx->m_pList = mx->m_pLast = pTL ;
-		else
-		{
-			//mx->m_pLast->m_pNext = pTL ;
-			mx->m_pLast->next = pTL ;
-			mx->m_pLast = pTL ;
-		}
+		uint32_t	n ;		//	Object iterator
 
-		mx->m_nCount++ ;
+		if (!nObjs)
+			return E_OK ;
+		if (!pObjs)
+			return E_ARGUMENT ;
+
+		mx->LockWrite() ;
+		for (n = 0 ; n < nObjs ; n++)
+			mx->_push(mx->_node(pObjs[n])) ;
+		mx->Unlock() ;
+		return E_OK ;
 	}
 
 	//	Return element
-	OBJ&	Pull	(void)
+	OBJ	Pull	(void)
 	{
 		//	Pull an object from the stack
 		//
 		//	Arguments:	None
-		//	Returns:	Referenece to last object placed on stack
+		//	Returns:	Copy of the last object placed on stack (or the default object if the stack is empty). The copy is returned by value as
+		//				several threads may pull at once.
+
+		_hz_stackitem<OBJ>*	pTL ;	//	Object-link iterator
+		OBJ					obj ;	//	Object pulled
+
+		mx->LockWrite() ;
+
+		if (!(pTL = mx->m_pList))
+		{
+			mx->Unlock() ;
+			return mx->m_Default ;
+		}
+
+		obj = pTL->m_Obj ;
+		mx->m_pList = pTL->next ;
+		if (!mx->m_pList)
+			mx->m_pLast = 0 ;
+		mx->m_pPool->Give(pTL) ;
+		mx->m_nCount-- ;
+
+		mx->Unlock() ;
+		return obj ;
+	}
+
+	uint32_t	PullMany	(OBJ* pObjs, uint32_t nMax)
+	{
+		//	Pull up to nMax objects from the top of the stack, under a single lock. The first object in the array is the one that was on top.
+		//
+		//	Arguments:	1)	pObjs	Array to receive the objects
+		//				2)	nMax	Size of the array
+		//
+		//	Returns:	Number of objects pulled
 
 		_hz_stackitem<OBJ>*	pTL ;	//	Object-link iterator
+		uint32_t			n ;		//	Objects pulled
 
-		OBJ		obj ;				//	Target object
+		if (!pObjs)
+			return 0 ;
 
-		if ((pTL = mx->m_pList))
+		mx->LockWrite() ;
+
+		for (n = 0 ; n < nMax && (pTL = mx->m_pList) ; n++)
 		{
-			obj = mx->m_pList->m_Obj ;
-			//mx->m_pList = mx->m_pList->m_pNext ;
-			mx->m_pList = mx->m_pList->next ;
-			delete pTL ;
-			mx->m_nCount-- ;
+			pObjs[n] = pTL->m_Obj ;
+			mx->m_pList = pTL->next ;
+			mx->m_pPool->Give(pTL) ;
 		}
 
-		return mx->m_Default ;
+		if (!mx->m_pList)
+			mx->m_pLast = 0 ;
+		mx->m_nCount -= n ;
+
+		mx->Unlock() ;
+		return n ;
+	}
+
+	hzEcode	Splice	(hzStack<OBJ>& src)
+	{
+		//	Move the entire content of the supplied stack onto the top of this stack, leaving the supplied stack empty. The order of the moved objects is kept
+		//	so the top of the supplied stack becomes the top of this stack. Where the stacks share a pool, this is done by relinking and costs the same regardless
+		//	of the number of objects. Otherwise the objects are copied.
+		//
+		//	Arguments:	1)	src		The stack to be emptied onto this stack
+		//
+		//	Returns:	E_ARGUMENT	If the supplied stack is this stack
+		//				E_OK		If the content was moved
+
+		_hz_stackitem<OBJ>*	pTL ;	//	Object-link iterator
+		_hz_stackitem<OBJ>*	pNL ;	//	Next link
+		_hz_stackitem<OBJ>*	pTop ;	//	Top of copied series
+		_hz_stackitem<OBJ>*	pEnd ;	//	Bottom of copied series
+		_hz_stackitem<OBJ>*	pNew ;	//	Copied link
+
+		if (src.mx == mx)
+			return E_ARGUMENT ;
+
+		//	Lock in a consistent order
+		if (mx < src.mx)
+			{ mx->LockWrite() ; src.mx->LockWrite() ; }
+		else
+			{ src.mx->LockWrite() ; mx->LockWrite() ; }
+
+		if (src.mx->m_pList)
+		{
+			if (mx->m_pPool == src.mx->m_pPool)
+			{
+				pTop = src.mx->m_pList ;
+				pEnd = src.mx->m_pLast ;
+			}
+			else
+			{
+				for (pTop = pEnd = 0, pTL = src.mx->m_pList ; pTL ; pTL = pNL)
+				{
+					pNL = pTL->next ;
+					pNew = mx->_node(pTL->m_Obj) ;
+
+					if (pEnd)
+						pEnd->next = pNew ;
+					else
+						pTop = pNew ;
+					pEnd = pNew ;
+					src.mx->m_pPool->Give(pTL) ;
+				}
+			}
+
+			pEnd->next = mx->m_pList ;
+			if (!mx->m_pLast)
+				mx->m_pLast = pEnd ;
+			mx->m_pList = pTop ;
+
+			mx->m_nCount += src.mx->m_nCount ;
+			src.mx->m_pList = src.mx->m_pLast = 0 ;
+			src.mx->m_nCount = 0 ;
+		}
+
+		src.mx->Unlock() ;
+		mx->Unlock() ;
+		return E_OK ;
 	}
 
 	hzEcode	Delete	(const OBJ& obj)
@@ -208,14 +359,15 @@ public:
 
 		//	match obj pointer to one on list
 
+		mx->LockWrite() ;
+
 		pPL = 0 ;
-		for (pTL = mx->m_pList ; pTL ; pTL = pTL->m_pNext)
+		for (pTL = mx->m_pList ; pTL ; pTL = pTL->next)
 		{
 			if (pTL->m_Obj == obj)
 			{
 				//	found item to delete
 				if (pTL == mx->m_pList)
-					//mx->m_pList = mx->m_pList->m_pNext ;
 					mx->m_pList = mx->m_pList->next ;
 
 				//	If the item is the last
@@ -224,10 +376,9 @@ public:
 
 				//	tie adjacent items together
 				if (pPL)
-					//pPL->m_pNext = pTL->m_pNext;
 					pPL->next = pTL->next;
 
-				delete pTL ;
+				mx->m_pPool->Give(pTL) ;
 				mx->m_nCount-- ;
 				rc = E_OK ;
 				break ;
@@ -236,6 +387,7 @@ public:
 			pPL = pTL ;
 		}
 
+		mx->Unlock() ;
 		return rc ;
 	}
 } ;
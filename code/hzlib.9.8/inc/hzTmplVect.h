@@ -22,6 +22,7 @@
 #include "hzLock.h"
 #include "hzProcess.h"
 #include "hzIsamT.h"
+#include "hzTmplArray.h"
 
 /*
 **	The Vector Template
@@ -29,9 +30,18 @@
 
 template	<class OBJ>	class	hzVect
 {
-	_hz_tmpl_ISAM	base ;			//	The base index
-	OBJ				m_Null ;		//	NULL Object
-	mutable OBJ		m_Default ;		//	Default (null) object
+	//	Category:	Object Collection
+	//
+	//	The hzVect template provides a vector of objects, accessed by position. By default (HZ_STORE_ISAM), the objects are held in an ISAM so that Insert()
+	//	and Delete() at arbitrary positions are of logarithmic cost. Where a vector is populated mainly by Add() and then accessed by position, as with token
+	//	lists and directory listings, it is better to hold the objects in an array store, either chunked (HZ_STORE_CHUNK) or contiguous (HZ_STORE_CONTIG). In
+	//	these modes the [] operator does not lock or descend an index, but Insert() and Delete() must move all objects above the position.
+
+	_hz_tmpl_ISAM			base ;			//	The base index (ISAM mode)
+	_hz_array_store<OBJ>	m_Store ;		//	The array store (chunked and contiguous modes)
+	hzStoreMode				m_eMode ;		//	Storage mode
+	OBJ						m_Null ;		//	NULL Object
+	mutable OBJ				m_Default ;		//	Default (null) object
 
 	//	Prevent copies
 	hzVect<OBJ>	(const hzVect<OBJ>&) ;
@@ -42,6 +52,7 @@ public:
 	{
 		base.Start(sizeof(OBJ), 0) ;
 		base.SetLock(HZ_NOLOCK) ;
+		m_eMode = HZ_STORE_ISAM ;
 		memset(&m_Null, 0, sizeof(OBJ)) ;
 		_hzGlobal_Memstats.m_numVectors++ ;
 	} 
@@ -50,6 +61,17 @@ public:
 	{
 		base.Start(sizeof(OBJ), 0) ;
 		base.SetLock(eLock) ;
+		m_eMode = HZ_STORE_ISAM ;
+		memset(&m_Null, 0, sizeof(OBJ)) ;
+		_hzGlobal_Memstats.m_numVectors++ ;
+	} 
+
+	hzVect	(hzStoreMode eMode)
+	{
+		base.Start(sizeof(OBJ), 0) ;
+		base.SetLock(HZ_NOLOCK) ;
+		m_eMode = HZ_STORE_ISAM ;
+		SetMode(eMode) ;
 		memset(&m_Null, 0, sizeof(OBJ)) ;
 		_hzGlobal_Memstats.m_numVectors++ ;
 	} 
@@ -59,6 +81,7 @@ public:
 		base.Start(sizeof(OBJ), 0) ;
 		base.SetLock(HZ_NOLOCK) ;
 		base.SetName(name) ;
+		m_eMode = HZ_STORE_ISAM ;
 		memset(&m_Null, 0, sizeof(OBJ)) ;
 		_hzGlobal_Memstats.m_numVectors++ ;
 	}
@@ -68,6 +91,7 @@ public:
 		base.Start(sizeof(OBJ), 0) ;
 		base.SetLock(eLock) ;
 		base.SetName(name) ;
+		m_eMode = HZ_STORE_ISAM ;
 		memset(&m_Null, 0, sizeof(OBJ)) ;
 		_hzGlobal_Memstats.m_numVectors++ ;
 	}
@@ -84,12 +108,31 @@ public:
 	void	LockWrite	(void)					{ base.LockWrite() ; }
 	void	Unlock		(void)					{ base.Unlock() ; }
 
+	hzEcode	SetMode		(hzStoreMode eMode)
+	{
+		//	Set the storage mode. This is only possible while the vector is empty.
+		//
+		//	Arguments:	1)	eMode	Storage mode
+		//
+		//	Returns:	E_SEQUENCE	If the vector is not empty
+		//				E_OK		If the mode is set
+
+		if (Count())
+			return E_SEQUENCE ;
+
+		if (eMode != HZ_STORE_ISAM && m_Store.SetMode(eMode) != E_OK)
+			return E_SEQUENCE ;
+		m_eMode = eMode ;
+		return E_OK ;
+	}
+
 	//	Get functions
-	uint32_t	Count	(void) const	{ return base.Count() ; }
-	uint32_t	Nodes	(void) const	{ return base.Nodes() ; }
-	uint32_t	Level	(void) const	{ return base.Level() ; }
+	hzStoreMode	Mode	(void) const	{ return m_eMode ; }
+	uint32_t	Count	(void) const	{ return m_eMode == HZ_STORE_ISAM ? base.Count() : m_Store.Count() ; }
+	uint32_t	Nodes	(void) const	{ return m_eMode == HZ_STORE_ISAM ? base.Nodes() : m_Store.Chunks() ; }
+	uint32_t	Level	(void) const	{ return m_eMode == HZ_STORE_ISAM ? base.Level() : m_Store.Chunks() ? 1 : 0 ; }
 	uint32_t	IsamId	(void) const	{ return base.IsamId() ; }
-	uint32_t	Name	(void) const	{ return base.Name() ; }
+	hzString	Name	(void) const	{ return base.Name() ; }
 
 	//	Modify data functions
 	hzEcode	Add		(OBJ key)
@@ -101,6 +144,9 @@ public:
 		_hz_vn_Dat*	pDN ;
 		int32_t		nSlot ;
 
+		if (m_eMode != HZ_STORE_ISAM)
+			return m_Store.Append(key) ;
+
 		pDN = base.InsertPosn(nSlot, Count()) ;
 		if (pDN)
 		{
@@ -120,6 +166,9 @@ public:
 		_hz_vn_Dat*	pDN ;
 		int32_t		nSlot ;
 
+		if (m_eMode != HZ_STORE_ISAM)
+			return m_Store.Insert(key, nPosn) ;
+
 		pDN = base.InsertPosn(nSlot, nPosn) ;
 		if (pDN)
 		{
@@ -139,6 +188,9 @@ public:
 		_hz_vn_Dat*	pDN ;
 		int32_t		nSlot ;
 
+		if (m_eMode != HZ_STORE_ISAM)
+			return m_Store.Delete(nPosn, m_Null) ;
+
 		pDN = base._findDnodeByPos(nSlot, nPosn, false) ;
 		if (pDN)
 		{
@@ -149,15 +201,31 @@ public:
 		return base.DeletePosn(nPosn) ;
 	}
 
-	void	Clear	(void)		{ base.Clear() ; }
+	void	Clear	(void)
+	{
+		if (m_eMode == HZ_STORE_ISAM)
+			base.Clear() ;
+		else
+			m_Store.Clear() ;
+	}
 
 	OBJ&	operator[]	(uint32_t nIndex) const
 	{
 		_hz_set_bkt<OBJ>*	pBuck ;
 
 		_hz_vn_Dat*	pDN ;
+		OBJ*		pObj ;
 		int32_t		nSlot ;
 
+		if (m_eMode != HZ_STORE_ISAM)
+		{
+			pObj = m_Store.InSitu(nIndex) ;
+			if (pObj)
+				return *pObj ;
+			m_Default = m_Null ;
+			return m_Default ;
+		}
+
 		pDN = base._findDnodeByPos(nSlot, nIndex, false) ;
 		if (!pDN)
 		{
@@ -0,0 +1,118 @@
+//
+//	File:	hzUring.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzUring_h
+#define hzUring_h
+
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "hzBasedefs.h"
+#include "hzErrcode.h"
+
+//	Synopsis:	io_uring
+//
+//	The hzUring class is a thin wrapper around a Linux io_uring instance, as used by hzIpServer::ServeUring(). It talks to the kernel directly by means of the
+//	io_uring_setup, io_uring_enter and io_uring_register system calls and the shared ring memory, so there is no dependency on liburing.
+//
+//	An io_uring comprises a submission queue (SQ) and a completion queue (CQ), both shared between the process and the kernel. Operations (accept, recv, send
+//	etc) are described by submission queue entries (SQEs) which are obtained by GetSqe(), filled in by one of the Prep functions and passed to the kernel in
+//	batches by Submit(). Results come back as completion queue entries (CQEs), each bearing the 64-bit user data value given in the SQE, which are read with
+//	PeekCqe() and released with SeenCqe(). A single call to Submit() can both pass any number of new operations and wait for completions, so a busy server
+//	makes far fewer system calls than with epoll where every read and write is a call in its own right.
+//
+//	Multishot operations post a CQE each time they produce a result (a new connection, data received) while remaining armed. The CQE has IORING_CQE_F_MORE
+//	set for as long as the operation remains armed. Multishot receives draw on a ring of provided buffers, registered with the kernel under a buffer group.
+//	Each buffer is the size of a hzChain block (HZ_MAXPACKET) and is returned to the ring by ReturnBuffer() once its content has been consumed.
+//
+//	Each SQE has a small array of iovec structures (HZ_URING_IOV) for vectored writes. The kernel copies the iovec array when the SQE is submitted, so these
+//	only need remain valid until the next call to Submit().
+//
+//	hzUring is not thread safe. It is intended to be owned and operated by a single serving thread.
+
+#define	HZ_URING_IOV		16		//	Iovecs per SQE (for writev)
+#define	HZ_URING_BGID		0		//	Buffer group ID of the provided buffer ring
+
+class	hzUring
+{
+	//	Category:	System
+	//
+	//	Linux io_uring instance (see synopsis above)
+
+	struct io_uring_sqe*		m_pSqes ;		//	Submission queue entries
+	struct io_uring_cqe*		m_pCqes ;		//	Completion queue entries
+	struct io_uring_buf_ring*	m_pBufRing ;	//	Provided buffer ring
+	struct iovec*				m_pIov ;		//	Iovec arrays (HZ_URING_IOV per SQE)
+	char*			m_pBufs ;			//	Provided buffer space
+	void*			m_pSqMap ;			//	Submission ring mapping
+	void*			m_pCqMap ;			//	Completion ring mapping (if separate)
+	uint32_t*		m_pSqHead ;			//	Submission queue head (advanced by kernel)
+	uint32_t*		m_pSqTail ;			//	Submission queue tail (advanced by us)
+	uint32_t*		m_pSqArray ;		//	Submission queue index array
+	uint32_t*		m_pCqHead ;			//	Completion queue head (advanced by us)
+	uint32_t*		m_pCqTail ;			//	Completion queue tail (advanced by kernel)
+	uint64_t		m_nSqMap ;			//	Size of submission ring mapping
+	uint64_t		m_nCqMap ;			//	Size of completion ring mapping
+	uint64_t		m_nSqeMap ;			//	Size of SQE array mapping
+	uint64_t		m_nBufMap ;			//	Size of buffer ring mapping
+	uint32_t		m_nSqMask ;			//	Submission queue mask
+	uint32_t		m_nSqEntries ;		//	Submission queue size
+	uint32_t		m_nCqMask ;			//	Completion queue mask
+	uint32_t		m_nSqLocal ;		//	Local submission tail (SQEs obtained but not yet submitted)
+	uint32_t		m_nBufs ;			//	Number of provided buffers
+	uint32_t		m_nBufTail ;		//	Local buffer ring tail
+	uint32_t		m_nFeatures ;		//	Features reported by kernel
+	uint32_t		m_nSubmits ;		//	Number of io_uring_enter calls
+	int32_t			m_nFd ;				//	The io_uring file descriptor
+
+	//	Prevent copies
+	hzUring		(const hzUring&) ;
+	hzUring&	operator=	(const hzUring&) ;
+
+public:
+	hzUring		(void) ;
+	~hzUring	(void) ;
+
+	hzEcode	Init	(uint32_t nEntries, uint32_t nBufs) ;
+	void	Close	(void) ;
+
+	//	Submission
+	struct io_uring_sqe*	GetSqe	(void) ;
+	struct iovec*			SqeIov	(struct io_uring_sqe* pSqe)	{ return m_pIov + ((pSqe - m_pSqes) * HZ_URING_IOV) ; }
+
+	int32_t	Submit	(uint32_t nWait, int32_t nMillisecs) ;
+
+	//	Completion
+	struct io_uring_cqe*	PeekCqe	(void) ;
+	void					SeenCqe	(void) ;
+
+	//	Provided buffers
+	const char*	Buffer			(uint32_t nBid) const	{ return m_pBufs + ((uint64_t) nBid * HZ_MAXPACKET) ; }
+	void		ReturnBuffer	(uint32_t nBid) ;
+
+	//	Preparation of SQEs
+	void	PrepAcceptMulti	(struct io_uring_sqe* pSqe, int32_t nSock, uint64_t nData) ;
+	void	PrepRecvMulti	(struct io_uring_sqe* pSqe, int32_t nSock, uint64_t nData) ;
+	void	PrepWritev		(struct io_uring_sqe* pSqe, int32_t nSock, uint32_t nIov, uint64_t nData) ;
+	void	PrepPoll		(struct io_uring_sqe* pSqe, int32_t nSock, uint32_t nMask, bool bMulti, uint64_t nData) ;
+	void	PrepCancelFd	(struct io_uring_sqe* pSqe, int32_t nSock, uint64_t nData) ;
+
+	int32_t		Fd		(void) const	{ return m_nFd ; }
+	uint32_t	Submits	(void) const	{ return m_nSubmits ; }
+} ;
+
+#endif	//	hzUring_h
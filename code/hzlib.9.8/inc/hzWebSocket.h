@@ -0,0 +1,135 @@
+//
+//	File:	hzWebSocket.h
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#ifndef hzWebSocket_h
+#define hzWebSocket_h
+
+#include <string.h>
+
+#include "hzBasedefs.h"
+#include "hzString.h"
+#include "hzChain.h"
+#include "hzLock.h"
+#include "hzIpServer.h"
+
+//	Synopsis:	WebSockets (RFC 6455)
+//
+//	A WebSocket begins life as a HTTP request on a port added by AddPortHTTP. ProcessEvent notes the Upgrade, Connection and Sec-WebSocket-* headers and
+//	hzHttpEvent::IsWebSocket() reports whether the request is a valid opening handshake. The application handler accepts it by calling AcceptWebSocket(),
+//	which sends the 101 response and attaches a hzWebSocket to the connection, together with the function to be called with each message. From then on the
+//	connection no longer carries HTTP. Its input is passed to HandleWsMsg rather than HandleHttpMsg, which decodes the frames in place in the input chain and
+//	removes them once decoded.
+//
+//	Fragmented messages are reassembled and passed to the message function once complete. Text messages are checked to be valid UTF-8. Pings are answered
+//	with pongs and a close frame from the client is echoed before the connection is closed. Protocol errors are answered by a close frame with the applicable
+//	status code, as are messages exceeding the maximum message size. Frames are sent unmasked, each message in a single frame.
+//
+//	Keep-alive is driven by the expiry timers of the serving loop. The time to live of the connection is set to the ping interval, and when it expires with
+//	the connection idle, a ping is sent and the connection kept alive for another interval. If nothing has been heard from the client by the time the next
+//	interval expires, the connection is closed.
+
+#define	HZ_WS_MAXMSG	1048576		//	Default maximum size of a message (fragments included)
+#define	HZ_WS_PING		30			//	Seconds of inactivity after which the client is pinged
+
+enum	hzWsOpcode
+{
+	//	Category:	Internet
+	//
+	//	WebSocket frame opcodes
+
+	WS_OP_CONT		= 0,	//	Continuation of a fragmented message
+	WS_OP_TEXT		= 1,	//	Text message (UTF-8)
+	WS_OP_BINARY	= 2,	//	Binary message
+	WS_OP_CLOSE		= 8,	//	Close
+	WS_OP_PING		= 9,	//	Ping
+	WS_OP_PONG		= 10	//	Pong
+} ;
+
+enum	hzWsStatus
+{
+	//	Category:	Internet
+	//
+	//	WebSocket close status codes (those used by hzWebSocket)
+
+	WS_CLOSE_NORMAL		= 1000,	//	Normal closure
+	WS_CLOSE_GOINGAWAY	= 1001,	//	Server going down
+	WS_CLOSE_PROTOCOL	= 1002,	//	Protocol error
+	WS_CLOSE_BADDATA	= 1007,	//	Text message not valid UTF-8
+	WS_CLOSE_TOOBIG		= 1009	//	Message too big
+} ;
+
+class	hzWebSocket
+{
+	//	Category:	Internet
+	//
+	//	A WebSocket connection (see synopsis). The hzWebSocket is created by hzHttpEvent::AcceptWebSocket and belongs to the connection, which deletes it when
+	//	it is next initialized or destroyed. It remains valid until then, so the application may send messages on it from any thread, but should not do so
+	//	after it has been notified of the closure.
+
+	hzIpConnex*	m_pCx ;			//	Connection
+	void*		m_pApp ;		//	Application data
+	hzChain		m_Msg ;			//	Message being received (fragments so far)
+	hzLockS		m_lockOut ;		//	Keeps the frames of different threads from interleaving
+	uint64_t	m_nsPing ;		//	Time ping sent (0 if none outstanding)
+	uint32_t	m_nMaxMsg ;		//	Maximum message size
+	uint16_t	m_eMsgOp ;		//	Opcode of fragmented message being received (0 if none)
+	bool		m_bCloseSent ;	//	Close frame sent
+	bool		m_bClosed ;		//	Application notified of the closure
+
+	hzTcpCode	(*m_OnMessage)(hzWebSocket* pWs, hzChain& Msg, bool bBinary) ;	//	Called with each message
+	void		(*m_OnClose)(hzWebSocket* pWs) ;								//	Called when the connection closes (optional)
+
+	hzEcode		_send	(hzWsOpcode eOp, const char* pData, uint32_t nLen, const hzChain* pMsg) ;
+	hzTcpCode	_fail	(hzWsStatus eCode, const char* cpReason) ;
+
+	//	Prevent copies
+	hzWebSocket		(const hzWebSocket&) ;
+	hzWebSocket&	operator=	(const hzWebSocket&) ;
+
+public:
+	hzWebSocket		(hzIpConnex* pCx, hzTcpCode (*OnMessage)(hzWebSocket*, hzChain&, bool), void* pApp) ;
+	~hzWebSocket	(void) ;
+
+	void	SetOnClose		(void (*OnClose)(hzWebSocket*))	{ m_OnClose = OnClose ; }
+	void	SetMaxMessage	(uint32_t nMax)	{ m_nMaxMsg = nMax ; }
+	void	SetAppData		(void* pApp)	{ m_pApp = pApp ; }
+
+	hzIpConnex*	GetConnex	(void) const	{ return m_pCx ; }
+	void*		GetAppData	(void) const	{ return m_pApp ; }
+	bool		IsClosing	(void) const	{ return m_bCloseSent ; }
+
+	hzEcode		SendText	(const hzChain& Msg)	{ return _send(WS_OP_TEXT, 0, 0, &Msg) ; }
+	hzEcode		SendText	(const char* cpMsg)		{ return _send(WS_OP_TEXT, cpMsg, cpMsg ? strlen(cpMsg) : 0, 0) ; }
+	hzEcode		SendBinary	(const hzChain& Msg)	{ return _send(WS_OP_BINARY, 0, 0, &Msg) ; }
+	hzEcode		SendPing	(void) ;
+	hzEcode		Close		(hzWsStatus eCode, const char* cpReason = 0) ;
+
+	//	Called by the server
+	hzTcpCode	ProcessFrames	(hzChain& Input) ;
+	hzTcpCode	Idle			(void) ;
+	void		Closed			(void) ;
+} ;
+
+/*
+**	Prototypes
+*/
+
+hzTcpCode	HandleWsMsg	(hzChain& Input, hzIpConnex* pCx) ;
+hzTcpCode	HandleWsIdle	(hzIpConnex* pCx) ;
+hzString	WebSocketAccept	(const char* cpKey) ;
+
+#endif	//	hzWebSocket_h
@@ -1412,6 +1412,8 @@ void	hdbADP::Report	(hzChain& Z)
 
 	_hzfunc("hdbADP::Report") ;
 
+	hzMapS<uint16_t,const hdbClass*>	byId ;	//	Data classes in order of delta ID
+
 	const hdbDatatype*	pDT ;		//	Data type
 	const hdbClass*		pClass ;	//	Data class
 	const hdbMember*	pMbr ;		//	Data class member
@@ -1463,11 +1465,15 @@ void	hdbADP::Report	(hzChain& Z)
 		}
 	}
 
-	Z.Printf(" -- Class Delta ID assignments\n") ;
+	//	The class delta ID map is a hash map so it is in order of insertion. The assignments are listed in order of ID.
 	for (x = 0 ; x < m_mapClsCtxDtId.Count() ; x++)
+		byId.Insert(m_mapClsCtxDtId.GetKey(x), m_mapClsCtxDtId.GetObj(x)) ;
+
+	Z.Printf(" -- Class Delta ID assignments\n") ;
+	for (x = 0 ; x < byId.Count() ; x++)
 	{
-		y = m_mapClsCtxDtId.GetKey(x) ;
-		pClass = m_mapClsCtxDtId.GetObj(x) ;
+		y = byId.GetKey(x) ;
+		pClass = byId.GetObj(x) ;
 
 		Z.Printf("\t\t -- [%d] %s\n", y, pClass->TxtTypename()) ;
 	}
@@ -825,7 +825,8 @@ void	hdbIndexUkey::Halt	(void)
 
 hzEcode	hdbIndexUkey::Insert	(const hzAtom& A, uint32_t objId)
 {
-	//	Insert an atomic-value/object-id pair into the unique key index.
+	//	Insert an atomic-value/object-id pair into the unique key index. Between LoadStart() and LoadDone(), the pair is only noted and is inserted along with
+	//	the other pairs noted, by LoadDone().
 	//
 	//	Arguments:	1)	A		The atomic value
 	//				2)	objId	The object identifier
@@ -839,9 +840,7 @@ hzEcode	hdbIndexUkey::Insert	(const hzAtom& A, uint32_t objId)
 
 	_hzfunc("hdbIndexUkey::Insert") ;
 
-	uint64_t	lval ;			//	8 byte value
-	uint32_t	sval ;			//	4 byte value
-	hzEcode		rc = E_OK ;		//	Return code
+	uint64_t	lval ;			//	Key value
 
 	if (!m_bInit)
 		hzerr(_fn, HZ_ERROR, E_NOINIT) ;
@@ -854,36 +853,98 @@ hzEcode	hdbIndexUkey::Insert	(const hzAtom& A, uint32_t objId)
 
 	switch (m_eBasetype)
 	{
-	case BASETYPE_DOMAIN:	sval = _hzGlobal_FST_Domain->Locate(*A.Str()) ;
-							rc = m_keys.pSu->Insert(sval, objId) ;
+	case BASETYPE_DOMAIN:	lval = _hzGlobal_FST_Domain->Locate(*A.Str()) ;
 							break ;
 
-	case BASETYPE_EMADDR:	sval = _hzGlobal_FST_Emaddr->Locate(*A.Str()) ;
-							rc = m_keys.pSu->Insert(sval, objId) ;
+	case BASETYPE_EMADDR:	lval = _hzGlobal_FST_Emaddr->Locate(*A.Str()) ;
 							break ;
 
 	case BASETYPE_STRING:	
-	case BASETYPE_URL:		sval = _hzGlobal_StringTable->Locate(*A.Str()) ;
-							rc = m_keys.pSu->Insert(sval, objId) ;
+	case BASETYPE_URL:		lval = _hzGlobal_StringTable->Locate(*A.Str()) ;
 							break ;
 
 	case BASETYPE_DOUBLE:
 	case BASETYPE_XDATE:
 	case BASETYPE_INT64:
 	case BASETYPE_UINT64:	lval = A.Unt64() ;
-							rc = m_keys.pLu->Insert(lval, objId) ;
 							break ;
 
 	case BASETYPE_IPADDR:
 	case BASETYPE_TIME:
 	case BASETYPE_SDATE:
 	case BASETYPE_INT32:
-	case BASETYPE_UINT32:	sval = A.Unt32() ;
-							rc = m_keys.pSu->Insert(sval, objId) ;
+	case BASETYPE_UINT32:	lval = A.Unt32() ;
 							break ;
+
+	default:
+		return E_OK ;
 	}
 
-	return rc ;
+	if (m_bLoad)
+	{
+		m_LoadKeys.Add(lval) ;
+		m_LoadIds.Add(objId) ;
+		return E_OK ;
+	}
+
+	if (_wide())
+		return m_keys.pLu->Insert(lval, objId) ;
+	return m_keys.pSu->Insert((uint32_t) lval, objId) ;
+}
+
+hzEcode	hdbIndexUkey::LoadDone	(void)
+{
+	//	Insert the key/object-id pairs noted since LoadStart() as a single batch, by the bulk insert of the underlying map (see hzMapS::BulkInsert), and resume
+	//	inserting pairs as they are supplied. This is for the loading of a repository from its data file, where a large number of pairs are inserted at once. As
+	//	with repeated calls to Insert(), where a key occurs more than once, the last pair prevails.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	E_CORRUPT	If the map is corrupted
+	//				E_OK		If the operation was successful
+
+	_hzfunc("hdbIndexUkey::LoadDone") ;
+
+	uint64_t*	pLu ;			//	64-bit keys
+	uint32_t*	pSu ;			//	32-bit keys
+	uint32_t*	pIds ;			//	Object ids
+	uint32_t	nItems ;		//	Number of pairs
+	uint32_t	n ;				//	Pair iterator
+	hzEcode		rc = E_OK ;		//	Return code
+
+	m_bLoad = false ;
+	nItems = m_LoadKeys.Count() ;
+	if (!nItems)
+		return E_OK ;
+
+	pIds = new uint32_t[nItems] ;
+	for (n = 0 ; n < nItems ; n++)
+		pIds[n] = m_LoadIds[n] ;
+
+	if (_wide())
+	{
+		pLu = new uint64_t[nItems] ;
+		for (n = 0 ; n < nItems ; n++)
+			pLu[n] = m_LoadKeys[n] ;
+		rc = m_keys.pLu->BulkInsert(pLu, pIds, nItems) ;
+		delete [] pLu ;
+	}
+	else
+	{
+		pSu = new uint32_t[nItems] ;
+		for (n = 0 ; n < nItems ; n++)
+			pSu[n] = (uint32_t) m_LoadKeys[n] ;
+		rc = m_keys.pSu->BulkInsert(pSu, pIds, nItems) ;
+		delete [] pSu ;
+	}
+
+	delete [] pIds ;
+	m_LoadKeys.Clear() ;
+	m_LoadIds.Clear() ;
+
+	if (rc != E_OK)
+		return hzerr(_fn, HZ_ERROR, rc, "Index %s: Could not load %u keys", *m_Name, nItems) ;
+	return E_OK ;
 }
 
 hzEcode	hdbIndexUkey::Delete	(const hzAtom& key)
@@ -1087,6 +1148,71 @@ hzEcode	hdbIndexText::Insert	(const hzString& word, uint32_t docId)
 	return rc ;
 }
 
+hzEcode	hdbIndexText::Insert	(const hzArray<hzString>& words, const hzArray<uint32_t>& docIds)
+{
+	//	Insert a batch of word/document pairs, such as all the words of a set of documents being indexed at once. The words are put in order and the document
+	//	ids of each distinct word gathered into its bitmap (that of the index if the word is already there), then the map of words is loaded by bulk insert.
+	//
+	//	Arguments:	1)	words	The words
+	//				2)	docIds	The document id of each word
+	//
+	//	Returns:	E_ARGUMENT	If the arrays differ in size
+	//				E_CORRUPT	If the map of words is corrupted
+	//				E_OK		If the operation was successful
+
+	_hzfunc("hdbIndexText::Insert(batch)") ;
+
+	hzString*	pWords ;		//	The words in lower case
+	hzString*	pKeys ;			//	Distinct words in order
+	hdbIdset*	pSets ;			//	Bitmap of each distinct word
+	uint32_t*	pOrder ;		//	The words in order
+	uint32_t	nItems ;		//	Number of pairs
+	uint32_t	nKeys ;			//	Number of distinct words
+	uint32_t	n ;				//	Pair iterator
+	hzEcode		rc ;			//	Return code
+
+	nItems = words.Count() ;
+	if (docIds.Count() != nItems)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "%u words but %u document ids", nItems, docIds.Count()) ;
+	if (!nItems)
+		return E_OK ;
+
+	pWords = new hzString[nItems] ;
+	for (n = 0 ; n < nItems ; n++)
+	{
+		pWords[n] = words[n] ;
+		pWords[n].ToLower() ;
+	}
+
+	pOrder = new uint32_t[nItems] ;
+	_hz_bulk_order(pOrder, pWords, nItems) ;
+
+	pKeys = new hzString[nItems] ;
+	pSets = new hdbIdset[nItems] ;
+	for (nKeys = n = 0 ; n < nItems ; n++)
+	{
+		if (!nKeys || pKeys[nKeys-1] < pWords[pOrder[n]])
+		{
+			pKeys[nKeys] = pWords[pOrder[n]] ;
+			if (m_Keys.Exists(pKeys[nKeys]))
+				pSets[nKeys] = m_Keys[pKeys[nKeys]] ;
+			nKeys++ ;
+		}
+		pSets[nKeys-1].Insert(docIds[pOrder[n]]) ;
+	}
+
+	rc = m_Keys.BulkInsert(pKeys, pSets, nKeys, true) ;
+
+	delete [] pSets ;
+	delete [] pKeys ;
+	delete [] pOrder ;
+	delete [] pWords ;
+
+	if (rc != E_OK)
+		return hzerr(_fn, HZ_ERROR, rc, "Failed to insert %u words", nKeys) ;
+	return E_OK ;
+}
+
 #if 0
 hzEcode	hdbIndexText::Insert	(const hzString& word, const hzSet<uint32_t>& idset)
 hzEcode	hdbIndexText::InsSeg	(const hzString& word, const hzBitseg& seg, uint32_t segNo)
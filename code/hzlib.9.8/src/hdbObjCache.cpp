@@ -1114,6 +1114,14 @@ hzEcode	hdbObjCache::Open	(void)
 			break ;
 	}
 
+	//	The unique key indexes are built in one go once all the data is read, rather than key by key
+	for (mbrNo = 0 ; mbrNo < m_pClass->MbrCount() ; mbrNo++)
+	{
+		pIdx = m_Indexes[mbrNo] ;
+		if (pIdx && pIdx->Whatami() == HZINDEX_UKEY)
+			((hdbIndexUkey*) pIdx)->LoadStart() ;
+	}
+
 	//	Now read in the rest of the data (in delta notation)
 	for (; rc == E_OK ; nLine++)
 	{
@@ -1293,6 +1301,17 @@ hzEcode	hdbObjCache::Open	(void)
 	}
 	is.close() ;
 
+	for (mbrNo = 0 ; mbrNo < m_pClass->MbrCount() ; mbrNo++)
+	{
+		pIdx = m_Indexes[mbrNo] ;
+		if (pIdx && pIdx->Whatami() == HZINDEX_UKEY)
+		{
+			pIdxU = (hdbIndexUkey*) pIdx ;
+			if (pIdxU->LoadDone() != E_OK && rc == E_OK)
+				rc = E_CORRUPT ;
+		}
+	}
+
 	//	Now open file for writing
 	if (rc == E_OK)
 	{
@@ -255,7 +255,7 @@ hzEcode	hdsApp::_readScript	(hzXmlNode* pN)
 
 	ifstream		is ;			//	For reading in script file (if applicable)
 	hzChain			Z ;				//	Script content
-	hzChain			X ;				//	Script content (zipped)
+	uint32_t		nZip ;			//	Size of script gzipped
 	hzAttrset		ai ;			//	Attribute iterator
 	hzString		name ;			//	Name of script
 	hzString		fname ;			//	Filename of script (if applicable)
@@ -297,11 +297,9 @@ hzEcode	hdsApp::_readScript	(hzXmlNode* pN)
 
 	S = Z ;
 	m_rawScripts.Insert(name, S) ;
-	Gzip(X, Z) ;
-	S = X ;
-	m_zipScripts.Insert(name, S) ;
+	nZip = _zipScript(0, name, Z) ;
 
-	m_pLog->Out("%s. Added script %s of %d bytes (%d zipped)\n", *_fn, *name, Z.Size(), X.Size()) ;
+	m_pLog->Out("%s. Added script %s of %d bytes (%d zipped)\n", *_fn, *name, Z.Size(), nZip) ;
 
 	return rc ;
 }
@@ -532,7 +530,7 @@ hzEcode	hdsApp::_readCSS	(hzXmlNode* pN)
 		m_txtCSS << pN->m_fixContent ;
 
 	m_txtCSS << "-->\n</style>\n" ;
-	Gzip(m_zipCSS, m_txtCSS) ;
+	ContentEncodeAll(m_zipCSS, m_txtCSS) ;
 
 	return E_OK ;
 }
@@ -2630,6 +2628,31 @@ hdsVE*	hdsApp::_readTable	(hzXmlNode* pN, hdsResource* pPage)
 	return rc == E_OK ? thisVE : 0 ;
 }
 
+void	hdsFile::SetValidators	(const char* cpPath)
+{
+	//	Category:	Page and Article Config Read Functions
+	//
+	//	Set the entity tag and modification time of a passive file, by which conditional requests for it are answered. These are taken from the file the
+	//	content was loaded from or where the content was given in the config, from the content size and the time of loading.
+	//
+	//	Arguments:	1)	cpPath	Pathname of file (null if the content was given in the config)
+	//
+	//	Returns:	None
+
+	FSTAT	fs ;	//	File status
+
+	if (cpPath && cpPath[0] && stat(cpPath, &fs) == 0)
+	{
+		m_ETag = hzHttpEvent::MakeETag(fs.st_ino, fs.st_size, fs.st_mtime) ;
+		m_nMtime = fs.st_mtime ;
+	}
+	else
+	{
+		m_nMtime = time(0) ;
+		m_ETag = hzHttpEvent::MakeETag(0, m_rawValue.Size(), m_nMtime) ;
+	}
+}
+
 hzEcode	hdsApp::_readFixDir	(hzXmlNode* pN)
 {
 	//	Category:	Tables and Dirlist Config Read Functions
@@ -2714,6 +2737,7 @@ hzEcode	hdsApp::_readFixDir	(hzXmlNode* pN)
 		{
 			pFix->m_rawValue << is ;
 			is.close() ;
+			pFix->SetValidators(*pFix->m_filepath) ;
 			m_pLog->Out("%s. File %s Line %d <xfixdir> Content file %s opened and has %d bytes\n", *_fn, pN->Fname(), ln, *pFix->m_filepath, pFix->m_rawValue.Size()) ;
 		}
 		is.clear() ;
@@ -5606,6 +5630,9 @@ hzEcode	hdsApp::LoadPassives	(void)
 	hzString	S ;					//	Current criteria
 	hzString	path ;				//	Current path
 	hzString	fpath ;				//	Current full path (docroot + path)
+	hzString*	pPaths ;			//	Paths of the passive files matching the current criteria
+	hdsResource**	pFiles ;		//	The passive files matching the current criteria
+	uint32_t	nFiles ;			//	Number of passive files matching the current criteria
 	uint32_t	n ;					//	File iterator
 	hzEcode		rc ;				//	Return code
 
@@ -5630,7 +5657,10 @@ hzEcode	hdsApp::LoadPassives	(void)
 			break ;
 		}
 
-		for (n = 0 ; n < files.Count() ; n++)
+		pPaths = new hzString[files.Count()] ;
+		pFiles = new hdsResource*[files.Count()] ;
+
+		for (nFiles = n = 0 ; n < files.Count() ; n++)
 		{
 			S = files[n] ;
 			is.open(*S) ;
@@ -5649,16 +5679,24 @@ hzEcode	hdsApp::LoadPassives	(void)
 				pFile->m_Mimetype = Str2Mimetype(p.value) ;
 
 				pFile->m_rawValue = Z ;
+				pFile->SetValidators(*S) ;
 				if (pFile->m_Mimetype == HMTYPE_TXT_HTML)
 					Gzip(pFile->m_zipValue, Z) ;
 
 				//m_Fixed.Insert(pFile->m_filepath, pFile) ;
-				m_ResourcesPath.Insert(pFile->m_filepath, pFile) ;
+				pPaths[nFiles] = pFile->m_filepath ;
+				pFiles[nFiles] = pFile ;
+				nFiles++ ;
 				m_pLog->Out("Added passive file %s (%d,%d)\n", *pFile->m_filepath, pFile->m_rawValue.Size(), pFile->m_zipValue.Size()) ;
 			}
 
 			Z.Clear() ;
 		}
+
+		//	The files matching the criteria are added to the resource map as one batch
+		m_ResourcesPath.BulkInsert(pPaths, pFiles, nFiles) ;
+		delete [] pPaths ;
+		delete [] pFiles ;
 	}
 
 	return rc ;
@@ -5735,6 +5773,7 @@ hzEcode	hdsApp::_readFixFile	(hzXmlNode* pN)
 
 	if (rc == E_OK)
 	{
+		pFix->SetValidators(*pFix->m_filepath) ;
 		now = RealtimeNano() ;
 		Gzip(pFix->m_zipValue, pFix->m_rawValue) ;
 		then = RealtimeNano() ;
@@ -6195,8 +6234,8 @@ hzEcode	hdsApp::CheckProject	(void)
 
 		m_rawSitemapXml << "</urlset>\r\n" ;
 
-		Gzip(m_zipSitemapTxt, m_rawSitemapTxt) ;
-		Gzip(m_zipSitemapXml, m_rawSitemapXml) ;
+		ContentEncodeAll(m_zipSitemapTxt, m_rawSitemapTxt) ;
+		ContentEncodeAll(m_zipSitemapXml, m_rawSitemapXml) ;
 	}
 
 	if (m_OpFlags & DS_APP_GUIDE)
@@ -6234,7 +6273,7 @@ hzEcode	hdsApp::CheckProject	(void)
 		}
 		m_rawSiteguide << "</body>\n</html>\n" ;
 
-		Gzip(m_zipSiteguide, m_rawSiteguide) ;
+		ContentEncodeAll(m_zipSiteguide, m_rawSiteguide) ;
 	}
 
 	/*
@@ -485,6 +485,7 @@ hzEcode	hdsExec::Extract	(hzChain& errorReport, hzHttpEvent* pE)
 
 	hzDocXml		xdoc ;		//	Unzipped docx file loader
 	hzHttpFile		hf ;		//	File meta data from event
+	hzChain			F ;			//	Submitted file content
 	hzChain			Z ;			//	Unzipped docx file
 	hzChain			D ;			//	Part of docx within and including <w:document> tags
 	hzChain			E ;			//	For export of XML doc
@@ -515,11 +516,13 @@ hzEcode	hdsExec::Extract	(hzChain& errorReport, hzHttpEvent* pE)
 	{
 		hf = pE->m_Uploads[fldname] ;
 
-		errorReport.Printf("%s. Found input (fld %s file %s of %d bytes) mime=%d\n", *_fn, *hf.m_fldname, *hf.m_filename, hf.m_file.Size(), hf.m_mime) ;
+		errorReport.Printf("%s. Found input (fld %s file %s of %d bytes) mime=%d\n", *_fn, *hf.m_fldname, *hf.m_filename, hf.Size(), hf.m_mime) ;
 
 		if (hf.m_mime == HMTYPE_APP_OPEN_DOCX)
 		{
-			Punzip(Z, hf.m_file) ;
+			if (hf.Content(F) != E_OK)
+				return E_NODATA ;
+			Punzip(Z, F) ;
 
 			for (zi = Z ; !zi.eof() ; zi++)
 			{
@@ -1132,14 +1135,17 @@ hzEcode	hdsExec::Exec	(hzChain& errorReport, hzHttpEvent* pE)
 				if (pE->m_Uploads.Exists(param4))
 				{
 					hzHttpFile	hf ;	//	External document/binary file
+					hzChain		F ;		//	File content
 
 					hf = pE->m_Uploads[param4] ;
 
 					strVal = m_pApp->ConvertText(param4, pE) ;
 
 					errorReport.Printf("%s. Step %s=%s (fld %s file %s of %d bytes) mime=%d\n",
-						*_fn, *param3, *param4, *hf.m_fldname, *hf.m_filename, hf.m_file.Size(), hf.m_mime) ;
-					rc = pCurObj->SetBinary(param3, hf.m_file) ;
+						*_fn, *param3, *param4, *hf.m_fldname, *hf.m_filename, hf.Size(), hf.m_mime) ;
+					rc = hf.Content(F) ;
+					if (rc == E_OK)
+						rc = pCurObj->SetBinary(param3, F) ;
 				}
 
 				if (pE->m_mapChains.Exists(param4))
@@ -236,7 +236,7 @@ void	hdsApp::SendErrorPage	(hzHttpEvent* pE, HttpRC rv, const char* func, const
 
 	pConn = pE->GetConnex() ;
 	if (pConn)
-		pConn->m_Track << E ;
+		pConn->m_Track.Attach(E, true) ;
 	else
 	{
 		m_pLog->Record("%d: ", rv) ;
@@ -272,7 +272,7 @@ void	hdsApp::SendErrorPage	(hzHttpEvent* pE, HttpRC rv, const char* func, hzChai
 
 	pConn = pE->GetConnex() ;
 	if (pConn)
-		pConn->m_Track << error ;
+		pConn->m_Track.Attach(error, true) ;
 	else
 		m_pLog->Out(error) ;
 
@@ -512,6 +512,7 @@ void	hdsDirlist::Generate	(hzChain& C, hzHttpEvent* pE, uint32_t& nLine)
 					C << "<td>&nbsp;</td>" ;
 			}
 			C << "\t</tr>\n" ;
+	pE->Stream(C) ;
 		}
 
 		//	Do table rows (files)
@@ -543,6 +544,7 @@ void	hdsDirlist::Generate	(hzChain& C, hzHttpEvent* pE, uint32_t& nLine)
 					C << "<td>&nbsp;</td>" ;
 			}
 			C << "\t</tr>\n" ;
+	pE->Stream(C) ;
 		}
 		C << "\t</table>\n</table>\n" ;
 	}
@@ -629,6 +631,7 @@ void	hdsTable::Generate	(hzChain& C, hzHttpEvent* pE, uint32_t& nLine)
 					C.Printf("<td>%s</td>", *value) ;	//atom.Str()) ;
 			}
 			C << "</tr>\n" ;
+			pE->Stream(C) ;
 		}
 		C << "</table>\n" ;
 	}
@@ -2190,6 +2193,8 @@ void	hdsArticleStd::Generate	(hzChain& C, hzHttpEvent* pE)
 	for (nV = 0 ; nV < m_VEs.Count() ; nV++)
 	{
 		pVE = m_VEs[nV] ; pVE->Generate(C, pE, relLn) ;
+		if (pE)
+			pE->Stream(C) ;
 	}
 }
 
@@ -2418,17 +2423,19 @@ void	hdsPage::Display	(hzHttpEvent* pE)
 	if (m_Resize) C.Printf(" onresize=\"%s\"", *m_Resize) ;
 	C << ">\n" ;
 
-	//	Now construct the page elements
+	//	Now construct the page elements. The page is streamed, so once large enough it is sent in chunks as the elements are generated (see hzHttpEvent::Stream)
 	relLn = m_Line ;
+	pE->StreamInit(C, HTTPMSG_OK, HMTYPE_TXT_HTML, 0, false) ;
 
 	for (nV = 0 ; nV < m_VEs.Count() ; nV++)
 	{
 		pVE = m_VEs[nV] ; pVE->Generate(C, pE, relLn) ;
+		pE->Stream(C) ;
 	}
 
 	//	End page construction
 	C << "</body>\n</html>\n" ;
 
-	//	Send out page. Note all generated pages are sent out raw, not zipped
-	rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_HTML, C, 0, false) ;
+	//	Send out page (or the remainder of it). Note all generated pages are sent out raw, not zipped
+	rc = pE->StreamEnd(C) ;
 }
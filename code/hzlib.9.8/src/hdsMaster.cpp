@@ -926,10 +926,12 @@ hzEcode	_masterBanned	(hzChain& C, hdsArticleCIF* pArtCIF, hzHttpEvent* pE)
 	hzEcode		rc ;		//	Return code
 
 	//	Re-order blacklist by number of attempts
-	for (n = 0 ; n < _hzGlobal_StatusIP.Count() ; n++)
+	for (n = 0 ; n < _hzGlobal_StatusIP.Slots() ; n++)
 	{
-		ipa = _hzGlobal_StatusIP.GetKey(n) ;
-		ipi = _hzGlobal_StatusIP.GetObj(n) ;
+		if (!_hzGlobal_StatusIP.GetSlot(n, ipa, ipi))
+			continue ;
+		if (!(ipi.m_bInfo & HZ_IPSTATUS_BLACK))
+			continue ;
 
 		mapTmp.Insert(ipi.m_nSince, ipa) ;
 	}
@@ -1513,14 +1515,14 @@ void	hdsApp::MasterArticle	(hzHttpEvent* pE)
 
 	if (!pE->QueryLen())
 	{
-		pConnex->m_Track.Printf("%s: Called with no arguments\n", *_fn) ;
+		pConnex->m_Track.Event("MasterArticle: Called with no arguments") ;
 		pE->SendAjaxResult(HTTPMSG_NOTFOUND, "No such path") ;
 		return ;
 	}
 
 	argA = pE->m_mapStrings.GetKey(0) ;
 	argB = pE->m_mapStrings.GetObj(0) ;
-	pConnex->m_Track.Printf("%s: Called with %s=%s\n", *_fn, *argA, *argB) ;
+	pConnex->m_Track.EventS("MasterArticle: Called with %s", *argA) ;
 
 
 	if (argA == "editfile")
@@ -70,16 +70,19 @@ extern	hzString	_dsmScript_navtree ;		//	Navtree script
 
 hzEcode	hdsApp::IndexPages	(void)
 {
-	//	Go through all pages found in the config files and index them
+	//	Go through all pages found in the config files and index them. The words of every page are gathered first and then inserted into the index as one batch.
 	//
 	//	Arguments:	None
 	//
 	//	Returns:	E_FORMAT	If any page could not be tokenized
+	//				E_CORRUPT	If the index could not be populated
 	//				E_OK		If the pages were indexed
 
 	_hzfunc("hdsApp::IndexPages") ;
 
-	hzVect<hzToken>	toks ;			//	Token list
+	hzVect<hzToken>		toks ;		//	Token list
+	hzArray<hzString>	words ;		//	Words of all pages
+	hzArray<uint32_t>	docIds ;	//	Document number of each word
 
 	hzChain			pageVal ;		//	Extract content from tags into chain, then tokenize to get words to index
 	hzToken			T ;				//	Tokens
@@ -123,19 +126,24 @@ hzEcode	hdsApp::IndexPages	(void)
 			break ;
 		}
 
-		for (nDone = nCount = 0 ; rc == E_OK && nCount < toks.Count() ; nCount++)
+		for (nDone = nCount = 0 ; nCount < toks.Count() ; nCount++)
 		{
 			T = toks[nCount] ;
 			if (!T.Value())
 				continue ;
 
 			nDone++ ;
-			rc = m_PageIndex.Insert(T.Value(), nD) ;
+			words.Add(T.Value()) ;
+			docIds.Add(nD) ;
 		}
 
 		m_pLog->Out("Indexing page %s (%s), %d of %d tokens\n", *pPage->m_Url, *pPage->m_Title, nDone, toks.Count()) ;
 	}
 
+	//	The words of all the pages tokenized are indexed in one go
+	if (m_PageIndex.Insert(words, docIds) != E_OK && rc == E_OK)
+		rc = E_CORRUPT ;
+
 	return rc ;
 }
 
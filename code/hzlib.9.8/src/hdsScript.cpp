@@ -710,10 +710,42 @@ hzEcode	hdsApp::MakeNavbarJS	(hzChain& Z, hdsLang* pLang, uint32_t access)
 	return E_OK ;
 }
 
+uint32_t	hdsApp::_zipScript	(hdsLang* pLang, const hzString& name, const hzChain& Z)
+{
+	//	Store a script in every available content coding (see ContentEncodeAll), in the language dependent scripts of the supplied language or if no language
+	//	is supplied, in the application wide scripts.
+	//
+	//	Arguments:	1)	pLang	The language (NULL if the script is not language dependent)
+	//				2)	name	Name of script
+	//				3)	Z		The script
+	//
+	//	Returns:	Size of the script gzipped (0 if not stored gzipped)
+
+	hzChain		X[CONTENT_CODINGS] ;	//	Script in each content coding
+	hzString	S ;						//	Script in a content coding (as stored)
+	uint32_t	n ;						//	Content coding iterator
+
+	ContentEncodeAll(X, Z) ;
+
+	for (n = CONTENT_GZIP ; n < CONTENT_CODINGS ; n++)
+	{
+		if (!X[n].Size())
+			continue ;
+
+		S = X[n] ;
+		if (pLang)
+			pLang->m_zipScripts[n].Insert(name, S) ;
+		else
+			m_zipScripts[n].Insert(name, S) ;
+	}
+
+	return X[CONTENT_GZIP].Size() ;
+}
+
 void	hdsApp::SetupScripts	(void)
 {
 	//	This is run as part of the hdsApp initislization sequence. It adds the navbar handler script and the user dependent navbar menu scripts.
-	//	These are places in m_rawScripts (the unzipped versions) and m_zipScripts (the zipped versions).
+	//	These are placed in m_rawScripts (the unzipped versions) and m_zipScripts (the versions in each content coding).
 	//
 	//	Note. As the navigation bar is multi-lingual, this function must be called after the language files have been imported.
 	//
@@ -723,7 +755,6 @@ void	hdsApp::SetupScripts	(void)
 	_hzfunc("hdsApp::setupScripts") ;
 
 	hzChain		Z ;			//	Script chain
-	hzChain		X ;			//	Zipped version
 	hdsLang*	pLang ;		//	Language
 	hdsTree*	pAG ;		//	Article group
 	//hdsUsertype	ut ;		//	User types
@@ -731,6 +762,7 @@ void	hdsApp::SetupScripts	(void)
 	hzString	tmpStr ;	//	Temp string
 	uint32_t	n ;			//	User type iterator
 	uint32_t	x ;			//	User type iterator
+	uint32_t	nZip ;		//	Size of script gzipped
 
 	if (!this)
 		hzerr(_fn, HZ_ERROR, E_CORRUPT, "No instance") ;
@@ -742,19 +774,15 @@ void	hdsApp::SetupScripts	(void)
 	//	General script
 	name = "navhdl.js" ;
 	Z = _dsmScript_navbarMenu2 ;
-	Gzip(X, Z) ;
-	tmpStr = X ;
 	m_rawScripts.Insert(name, _dsmScript_navbarMenu2) ;
-	m_zipScripts.Insert(name, tmpStr) ;
-	m_pLog->Out("%s. Created script %s of sizes %d and %d\n", *_fn, *name, Z.Size(), X.Size()) ;
+	nZip = _zipScript(0, name, Z) ;
+	m_pLog->Out("%s. Created script %s of sizes %d and %d\n", *_fn, *name, Z.Size(), nZip) ;
 
 	name = "navhdl3.js" ;
 	Z = _dsmScript_navbarMenu3 ;
-	Gzip(X, Z) ;
-	tmpStr = X ;
 	m_rawScripts.Insert(name, _dsmScript_navbarMenu3) ;
-	m_zipScripts.Insert(name, tmpStr) ;
-	m_pLog->Out("%s. Created script %s of sizes %d and %d\n", *_fn, *name, Z.Size(), X.Size()) ;
+	nZip = _zipScript(0, name, Z) ;
+	m_pLog->Out("%s. Created script %s of sizes %d and %d\n", *_fn, *name, Z.Size(), nZip) ;
 
 	//	Language dependent data scripts
 	for (n = 0 ; n < m_Languages.Count() ; n++)
@@ -765,11 +793,9 @@ void	hdsApp::SetupScripts	(void)
 		MakeNavbarJS(Z, pLang, ACCESS_PUBLIC) ;
 		tmpStr = Z ;
 		pLang->m_rawScripts.Insert(name, tmpStr) ;
-		Gzip(X, Z) ;
-		tmpStr = X ;
-		pLang->m_zipScripts.Insert(name, tmpStr) ;
+		nZip = _zipScript(pLang, name, Z) ;
 
-		//	m_pLog->Out("%s. Created script %s->%s of sizes %d and %d\n[", *_fn, *pLang->m_code, *name, Z.Size(), X.Size()) ;
+		//	m_pLog->Out("%s. Created script %s->%s of sizes %d and %d\n[", *_fn, *pLang->m_code, *name, Z.Size(), nZip) ;
 		//	m_pLog->Out(Z) ;
 		//	m_pLog->Out("]\n") ;
 
@@ -777,11 +803,9 @@ void	hdsApp::SetupScripts	(void)
 		MakeNavbarJS(Z, pLang, ACCESS_ADMIN) ;
 		tmpStr = Z ;
 		pLang->m_rawScripts.Insert(name, tmpStr) ;
-		Gzip(X, Z) ;
-		tmpStr = X ;
-		pLang->m_zipScripts.Insert(name, tmpStr) ;
+		nZip = _zipScript(pLang, name, Z) ;
 
-		//	m_pLog->Out("%s. Created script %s->%s of sizes %d and %d\n[", *_fn, *pLang->m_code, *name, Z.Size(), X.Size()) ;
+		//	m_pLog->Out("%s. Created script %s->%s of sizes %d and %d\n[", *_fn, *pLang->m_code, *name, Z.Size(), nZip) ;
 		//	m_pLog->Out(Z) ;
 		//	m_pLog->Out("]\n") ;
 
@@ -794,11 +818,9 @@ void	hdsApp::SetupScripts	(void)
 			MakeNavbarJS(Z, pLang, m_UserTypes.GetObj(x)) ;	//ut.m_Access) ;
 			tmpStr = Z ;
 			pLang->m_rawScripts.Insert(name, tmpStr) ;
-			Gzip(X, Z) ;
-			tmpStr = X ;
-			pLang->m_zipScripts.Insert(name, tmpStr) ;
+			nZip = _zipScript(pLang, name, Z) ;
 
-			//	m_pLog->Out("%s. Created script %s->%s of sizes %d and %d\n[", *_fn, *pLang->m_code, *name, Z.Size(), X.Size()) ;
+			//	m_pLog->Out("%s. Created script %s->%s of sizes %d and %d\n[", *_fn, *pLang->m_code, *name, Z.Size(), nZip) ;
 			//	m_pLog->Out(Z) ;
 			//	m_pLog->Out("]\n") ;
 
@@ -810,11 +832,9 @@ void	hdsApp::SetupScripts	(void)
 	//	Email checker
 	name = "ckExists.js" ;
 	Z = _dsmScript_ckExists ;
-	Gzip(X, Z) ;
-	tmpStr = X ;
 	m_rawScripts.Insert(name, _dsmScript_ckExists) ;
-	m_zipScripts.Insert(name, tmpStr) ;
-	m_pLog->Out("%s. Created script ckExists.js of sizes %d and %d\n", *_fn, Z.Size(), X.Size()) ;
+	nZip = _zipScript(0, name, Z) ;
+	m_pLog->Out("%s. Created script ckExists.js of sizes %d and %d\n", *_fn, Z.Size(), nZip) ;
 
 	/*
 	**	NAVIGATION TREES
@@ -822,19 +842,15 @@ void	hdsApp::SetupScripts	(void)
 
 	name = "tog.js" ;
 	Z = _dsmScript_tog ;
-	Gzip(X, Z) ;
-	tmpStr = X ;
 	m_rawScripts.Insert(name, _dsmScript_tog) ;
-	m_zipScripts.Insert(name, tmpStr) ;
-	m_pLog->Out("%s. Created script tog.js of sizes %d and %d\n", *_fn, Z.Size(), X.Size()) ;
+	nZip = _zipScript(0, name, Z) ;
+	m_pLog->Out("%s. Created script tog.js of sizes %d and %d\n", *_fn, Z.Size(), nZip) ;
 
 	name = "loadArticle.js" ;
 	Z = _dsmScript_loadArticle ;
-	Gzip(X, Z) ;
-	tmpStr = X ;
 	m_rawScripts.Insert(name, _dsmScript_loadArticle) ;
-	m_zipScripts.Insert(name, tmpStr) ;
-	m_pLog->Out("%s. Created script loadArticle.js of sizes %d and %d\n", *_fn, Z.Size(), X.Size()) ;
+	nZip = _zipScript(0, name, Z) ;
+	m_pLog->Out("%s. Created script loadArticle.js of sizes %d and %d\n", *_fn, Z.Size(), nZip) ;
 
 	for (n = 0 ; n < m_ArticleGroups.Count() ; n++)
 	{
@@ -850,10 +866,8 @@ void	hdsApp::SetupScripts	(void)
 		Z.Printf("makeTree('%s');\n", *pAG->m_Groupname) ;
 		tmpStr = Z ;
 		m_rawScripts.Insert(name, tmpStr) ;
-		Gzip(X, Z) ;
-		tmpStr = X ;
-		m_zipScripts.Insert(name, tmpStr) ;
-		m_pLog->Out("%s. Created script %s of sizes %d and %d\n", *_fn, *name, Z.Size(), X.Size()) ;
+		nZip = _zipScript(0, name, Z) ;
+		m_pLog->Out("%s. Created script %s of sizes %d and %d\n", *_fn, *name, Z.Size(), nZip) ;
 	}
 
 	//	Do the admin navtree
@@ -862,9 +876,7 @@ void	hdsApp::SetupScripts	(void)
 	Z << "makeTree(\"adm_dme\");\n" ;
 	tmpStr = Z ;
 	m_rawScripts.Insert(name, tmpStr) ;
-	Gzip(X, Z) ;
-	tmpStr = X ;
-	m_zipScripts.Insert(name, tmpStr) ;
+	nZip = _zipScript(0, name, Z) ;
 
 	//	Report
 	m_pLog->Out("%s. Script Summary\n", *_fn) ;
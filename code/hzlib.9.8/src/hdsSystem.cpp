@@ -726,12 +726,13 @@ hzEcode	hdsApp::PcEntConv	(hzAtom& atom, const hzString& v, hzHttpEvent* pE)
 				rc = atom.SetValue(BASETYPE_STRING, hf.m_filename) ;
 			else if (extn == "data")
 			{
-				m_pLog->Out("%s. Have file %s of %d bytes\n", *_fn, *hf.m_filename, hf.m_file.Size()) ;
-				if (hf.m_file.Size())
-					{ rc = E_OK ; atom = hf.m_file ; }
-				else
+				hzChain	F ;		//	File content (read back if spilled to disk)
+
+				m_pLog->Out("%s. Have file %s of %d bytes\n", *_fn, *hf.m_filename, hf.Size()) ;
+				if (!hf.Size())
 					rc = E_NODATA ;
-				m_pLog->Out("%s. Have file %s of %d bytes\n", *_fn, *hf.m_filename, hf.m_file.Size()) ;	//atom.Chain().Size()) ;
+				else if ((rc = hf.Content(F)) == E_OK)
+					atom = F ;
 			}
 			else
 				rc = E_BADVALUE ;
@@ -1695,6 +1696,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 	hzChain			Z ;					//	Outgoing chain
 	hzIpConnex*		pConnex ;			//	Client Connection
 	hdsProfile*		pVP ;				//	Visitor profle
+	hdsProfile*		pNew ;				//	Visitor profile created for an address not yet seen
 	hzAtom			sv ;				//	Session value
 	hdsInfo*		pInfo = 0 ;			//	Session
 	hdsLang*		pLang ;				//	Language selected
@@ -1711,7 +1713,6 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 	hdsArticleCIF*	pArtCIF = 0 ;		//	C-Interface article
 	const char*		pReq ;				//	Requested resource
 	const char*		i ;					//	Resource iterator
-	hzIpinfo		ipi ;				//	IP test address (blocking)
 	hzSysID			cookie ;			//	The cookie
 	hzString		iplocn ;			//	IP location of client
 	hzString		currRef ;			//	Referer
@@ -1724,6 +1725,8 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 	hzIpaddr		ipa ;				//	Client IP address
 	hzEcode			rc ;				//	Function returns codes
 	hzTcpCode		trc ;				//	TCP return code (of this function)
+	hzContentCoding	eCoding ;			//	Content coding preferred by the client
+	bool			bReport ;			//	Compile reports on the request
 	char			argbuf[100] ;		//	For language codes
 	hzRecep32		r32 ;				//	For USL text value
 
@@ -1747,23 +1750,23 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 	switch	(pE->Method())
 	{
 	case HTTP_GET:		rc = E_OK ;
-						pConnex->m_Track.Printf("START ProcHTTP (GET) %s\n", pE->Hostname()) ;
+						pConnex->m_Track.EventS("ProcHTTP: START (GET) %s", pE->Hostname()) ;
 						break ;
 
 	case HTTP_HEAD:		rc = E_OK ;
-						pConnex->m_Track.Printf("START ProcHTTP (HEAD) %s\n", pE->Hostname()) ;
+						pConnex->m_Track.EventS("ProcHTTP: START (HEAD) %s", pE->Hostname()) ;
 						break ;
 
 	case HTTP_POST:		rc = E_OK ;
-						pConnex->m_Track.Printf("START ProcHTTP (POST) %s\n", pE->Hostname()) ;
+						pConnex->m_Track.EventS("ProcHTTP: START (POST) %s", pE->Hostname()) ;
 						break ;
 
-	case HTTP_OPTIONS:	pConnex->m_Track.Printf("START ProcHTTP (OPTIONS) %s\n", pE->Hostname()) ;	break ;
-	case HTTP_PUT:		pConnex->m_Track.Printf("START ProcHTTP (PUT) %s\n", pE->Hostname()) ;		break ;
-	case HTTP_DELETE:	pConnex->m_Track.Printf("START ProcHTTP (DELETE) %s\n", pE->Hostname()) ;	break ;
-	case HTTP_TRACE:	pConnex->m_Track.Printf("START ProcHTTP (TRACE) %s\n", pE->Hostname()) ;	break ;
-	case HTTP_CONNECT:	pConnex->m_Track.Printf("START ProcHTTP (CONNECT) %s\n", pE->Hostname()) ;	break ;
-	case HTTP_INVALID:	pConnex->m_Track.Printf("START ProcHTTP (INVALID) %s\n", pE->Hostname()) ;	break ;
+	case HTTP_OPTIONS:	pConnex->m_Track.EventS("ProcHTTP: START (OPTIONS) %s", pE->Hostname()) ;	break ;
+	case HTTP_PUT:		pConnex->m_Track.EventS("ProcHTTP: START (PUT) %s", pE->Hostname()) ;		break ;
+	case HTTP_DELETE:	pConnex->m_Track.EventS("ProcHTTP: START (DELETE) %s", pE->Hostname()) ;	break ;
+	case HTTP_TRACE:	pConnex->m_Track.EventS("ProcHTTP: START (TRACE) %s", pE->Hostname()) ;	break ;
+	case HTTP_CONNECT:	pConnex->m_Track.EventS("ProcHTTP: START (CONNECT) %s", pE->Hostname()) ;	break ;
+	case HTTP_INVALID:	pConnex->m_Track.EventS("ProcHTTP: START (INVALID) %s", pE->Hostname()) ;	break ;
 	}
 
 	/*
@@ -1777,22 +1780,17 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 		return TCP_TERMINATE ;
 	}
 
-	if (_hzGlobal_StatusIP.Exists(ipa))
+	if (_hzGlobal_StatusIP.Status(ipa) & HZ_IPSTATUS_BLACK_HTTP)
 	{
 		//	Banned IP? Kill connection
-		ipi = _hzGlobal_StatusIP[ipa] ;
-
-		if (ipi.m_bInfo & HZ_IPSTATUS_BLACK_HTTP)
-		{
-			pConnex->m_Track.Printf("BLOCKED IP ADDRESS %s - Killing Connection\n", *ipa.Str()) ;
-			pConnex->SendKill() ;
-			return TCP_TERMINATE ;
-		}
+		pConnex->m_Track.ErrorS("ProcHTTP: BLOCKED IP ADDRESS %s - Killing Connection", *ipa.Str()) ;
+		pConnex->SendKill() ;
+		return TCP_TERMINATE ;
 	}
 
 	if (rc != E_OK)
 	{
-		pConnex->m_Track.Printf("BLOCKING IP ADDRESS %s - Killing Connection\n", *ipa.Str()) ;
+		pConnex->m_Track.ErrorS("ProcHTTP: BLOCKING IP ADDRESS %s - Killing Connection", *ipa.Str()) ;
 		SetStatusIP(ipa, HZ_IPSTATUS_BLACK_PROT, 9000) ;
 		pConnex->SendKill() ;
 		return TCP_TERMINATE ;
@@ -1807,31 +1805,42 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 	pReq = pE->GetResource() ;
 	currRef = pE->Referer() ;
 
+	//	Reports on the request are only compiled if the connection record is sure to be reported (see hzTrack)
+	bReport = pConnex->m_Track.Verbose() ;
+
 	if (!pE->Cookie())
-		pE->m_Report.Printf("Supplied Cookie: [0] info 0\n") ;
+	{
+		if (bReport)
+			pE->m_Report.Printf("Supplied Cookie: [0] info 0\n") ;
+	}
 	else
 	{
 		//	There is a cookie so get the session
 		pInfo = m_SessCookie[pE->Cookie()] ;
-		pE->m_Report.Printf("Supplied Cookie: [%016X] info %p\n", pE->Cookie(), pInfo) ;
+		if (bReport)
+			pE->m_Report.Printf("Supplied Cookie: [%016X] info %p\n", pE->Cookie(), pInfo) ;
 
 		if (!pInfo)
 			pE->DelSessCookie(pE->Cookie()) ;
 		else
 		{
 			pE->SetSession(pInfo) ;
-			pE->m_Report.Printf("Access:        %d\n", pInfo->m_Access) ;
-			pE->m_Report.Printf("Subscriber ID: %d\n", pInfo->m_SubId) ;
-			pE->m_Report.Printf("User ID:       %d\n", pInfo->m_UserId) ;
-			pE->m_Report.Printf("Curr Object:   %d\n", pInfo->m_CurrObj) ;
 
-			for (n = 0 ; n < pInfo->m_Sessvals.Count() ; n++)
+			if (bReport)
 			{
-				pE->m_Report.Printf("Sesion var: %s=%s\n", *pInfo->m_Sessvals.GetKey(n), *pInfo->m_Sessvals.GetObj(n).Str()) ;
+				pE->m_Report.Printf("Access:        %d\n", pInfo->m_Access) ;
+				pE->m_Report.Printf("Subscriber ID: %d\n", pInfo->m_SubId) ;
+				pE->m_Report.Printf("User ID:       %d\n", pInfo->m_UserId) ;
+				pE->m_Report.Printf("Curr Object:   %d\n", pInfo->m_CurrObj) ;
+
+				for (n = 0 ; n < pInfo->m_Sessvals.Count() ; n++)
+				{
+					pE->m_Report.Printf("Sesion var: %s=%s\n", *pInfo->m_Sessvals.GetKey(n), *pInfo->m_Sessvals.GetObj(n).Str()) ;
+				}
 			}
 		}
 
-		pConnex->m_Track << pE->m_Report ;
+		pConnex->m_Track.Attach(pE->m_Report, false) ;
 		pE->m_Report.Clear() ;
 	}
 
@@ -1846,13 +1855,18 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 		}
 	}
 
-	//	Obtain basic profile on visitor from IP address
+	//	Obtain basic profile on visitor from IP address. Another request thread may be creating a profile for the same address at the same time, in which
+	//	case only one is inserted and the other is deleted.
 	pVP = m_Visitors[ipa] ;
 	if (!pVP)
 	{
-		pVP = new hdsProfile() ;
-		pVP->m_addr = ipa ;
-		m_Visitors.Insert(ipa, pVP) ;
+		pNew = new hdsProfile() ;
+		pNew->m_addr = ipa ;
+		pVP = m_Visitors.InsertIfAbsent(ipa, pNew) ;
+		if (!pVP)
+			pVP = pNew ;
+		else if (pVP != pNew)
+			delete pNew ;
 	}
 
 	/*
@@ -1910,11 +1924,14 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 			ProcForm(pE, pFormref, pFhdl) ;
 		}
 
-		pE->m_Report.Printf("\n%s POST: %s (%s, %s) ", *pE->m_Occur.Str(), *ipa.Str(), *iplocn, *m_pDfltLang->m_code) ;
-		pE->m_Report.Printf("[cook=%016X info=%p] (%s) %s\n", pE->Cookie(), pInfo, *currRef, pE->GetResource()) ;
-		pE->m_Report.Printf("<rbot=%d fav=%d art=%d, pg=%d scr=%d img=%d sp=%d fix=%d post=%d G404=%d P404=%d>\n",
-			pVP->m_robot, pVP->m_favicon, pVP->m_art, pVP->m_page, pVP->m_scr, pVP->m_img, pVP->m_spec, pVP->m_fix, pVP->m_post, pVP->m_G404, pVP->m_P404) ;
-		pConnex->m_Track << pE->m_Report ;
+		if (bReport)
+		{
+			pE->m_Report.Printf("\n%s POST: %s (%s, %s) ", *pE->m_Occur.Str(), *ipa.Str(), *iplocn, *m_pDfltLang->m_code) ;
+			pE->m_Report.Printf("[cook=%016X info=%p] (%s) %s\n", pE->Cookie(), pInfo, *currRef, pE->GetResource()) ;
+			pE->m_Report.Printf("<rbot=%d fav=%d art=%d, pg=%d scr=%d img=%d sp=%d fix=%d post=%d G404=%d P404=%d>\n",
+				pVP->m_robot, pVP->m_favicon, pVP->m_art, pVP->m_page, pVP->m_scr, pVP->m_img, pVP->m_spec, pVP->m_fix, pVP->m_post, pVP->m_G404, pVP->m_P404) ;
+		}
+		pConnex->m_Track.Attach(pE->m_Report, false) ;
 		pE->m_Report.Clear() ;
 		return trc ;
 	}
@@ -1935,7 +1952,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 	{
 		rc = pE->SendRawString(HTTPMSG_OK, HMTYPE_TXT_PLAIN, m_Robot, 43200, false) ;
 		if (rc != E_OK)
-			pConnex->m_Track << pE->m_Error ;
+			pConnex->m_Track.Attach(pE->m_Error, true) ;
 		pVP->m_robot++ ;
 		goto get_end ;
 	}
@@ -1943,7 +1960,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 	{
 		rc = pE->SendPageE(*m_Images, pReq + 1, 86400, false) ;
 		if (rc != E_OK)
-			pConnex->m_Track << pE->m_Error ;
+			pConnex->m_Track.Attach(pE->m_Error, true) ;
 		pVP->m_favicon++ ;
 		goto get_end ;
 	}
@@ -1954,8 +1971,9 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 			SendErrorPage(pE, HTTPMSG_NOTFOUND, __func__, "No such page as %s", pE->GetResource()) ;
 		else
 		{
-			if (pE->Zipped() && m_zipSitemapTxt.Size())
-				rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_PLAIN, m_zipSitemapTxt, 43200, true) ;
+			eCoding = pE->Coding() ;
+			if (m_zipSitemapTxt[eCoding].Size())
+				rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_PLAIN, m_zipSitemapTxt[eCoding], 43200, eCoding) ;
 			else
 				rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_PLAIN, m_rawSitemapTxt, 43200, false) ;
 		}
@@ -1968,8 +1986,9 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 			SendErrorPage(pE, HTTPMSG_NOTFOUND, __func__, "No such page as %s", pE->GetResource()) ;
 		else
 		{
-			if (pE->Zipped() && m_zipSitemapXml.Size())
-				rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_APP_XML, m_zipSitemapXml, 43200, true) ;
+			eCoding = pE->Coding() ;
+			if (m_zipSitemapXml[eCoding].Size())
+				rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_APP_XML, m_zipSitemapXml[eCoding], 43200, eCoding) ;
 			else
 				rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_APP_XML, m_rawSitemapXml, 43200, false) ;
 		}
@@ -1982,8 +2001,9 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 			SendErrorPage(pE, HTTPMSG_NOTFOUND, __func__, "No such page as %s", pE->GetResource()) ;
 		else
 		{
-			if (pE->Zipped() && m_zipSiteguide.Size())
-				rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_HTML, m_zipSiteguide, 43200, true) ;
+			eCoding = pE->Coding() ;
+			if (m_zipSiteguide[eCoding].Size())
+				rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_HTML, m_zipSiteguide[eCoding], 43200, eCoding) ;
 			else
 				rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_HTML, m_rawSiteguide, 43200, false) ;
 		}
@@ -2094,20 +2114,16 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 					{
 						if (pArtStd->m_flagVE & VE_ACTIVE)
 						{
+							//	Active articles are streamed as generated (see hzHttpEvent::Stream)
+							pE->StreamInit(Z, HTTPMSG_OK, HMTYPE_TXT_HTML, 0, false) ;
 							pArtStd->Generate(Z, pE) ;
 
-							if (!Z.Size())
+							rc = pE->StreamEnd(Z) ;
+							if (rc == E_NODATA)
 							{
 								pE->m_Error.Printf("AJAX case 2\n") ;
 								pE->SendAjaxResult(HTTPMSG_NOCONTENT, "Article is a heading only") ;
 							}
-							else
-							{
-								if (pE->Zipped())
-									rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_HTML, Z, 0, true) ;
-								else
-									rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_HTML, Z, 0, false) ;
-							}
 						}
 						else
 						{
@@ -2153,7 +2169,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 		if (rc != E_OK || pE->m_Error.Size())
 		{
 			if (pE->m_Error.Size())
-				pConnex->m_Track << pE->m_Error ;
+				pConnex->m_Track.Attach(pE->m_Error, true) ;
 			trc = TCP_TERMINATE ;
 		}
 
@@ -2196,7 +2212,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 				else
 					reqPath = pReq + preset_js.Length() + 2 ;
 
-				pConnex->m_Track.Printf("Serving script [%s]\n", *reqPath) ;
+				pConnex->m_Track.EventS("ProcHTTP: Serving script [%s]", *reqPath) ;
 
 				if (m_rawScripts.Exists(reqPath))
 				{
@@ -2207,12 +2223,13 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 						pE->SendHttpHead(m_rawScripts[reqPath], HMTYPE_TXT_JS, 86400) ;
 					else
 					{
-						if (pE->Zipped())
+						eCoding = pE->Coding() ;
+						if (m_zipScripts[eCoding].Exists(reqPath))
 						{
-							Z = m_zipScripts[reqPath] ;
-							rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_JS, Z, 86400, true) ;
+							Z = m_zipScripts[eCoding][reqPath] ;
+							rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_JS, Z, 86400, eCoding) ;
 							if (rc != E_OK)
-								pConnex->m_Track << pE->m_Error ;
+								pConnex->m_Track.Attach(pE->m_Error, true) ;
 						}
 						else
 						{
@@ -2220,7 +2237,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 							rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_JS, Z, 86400, false) ;
 							if (rc != E_OK)
 							{
-								pConnex->m_Track << pE->m_Error ;
+								pConnex->m_Track.Attach(pE->m_Error, true) ;
 								//m_pLog->Out("[\n") ;
 								//m_pLog->Out(m_rawScripts[reqPath]) ;
 								//m_pLog->Out("\n]\n") ;
@@ -2239,19 +2256,20 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 						pE->SendHttpHead(pLang->m_rawScripts[reqPath], HMTYPE_TXT_JS, 86400) ;
 					else
 					{
-						if (pE->Zipped())
+						eCoding = pE->Coding() ;
+						if (pLang->m_zipScripts[eCoding].Exists(reqPath))
 						{
-							Z = pLang->m_zipScripts[reqPath] ;
-							rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_JS, Z, 86400, true) ;
+							Z = pLang->m_zipScripts[eCoding][reqPath] ;
+							rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_JS, Z, 86400, eCoding) ;
 							if (rc != E_OK)
-								pConnex->m_Track << pE->m_Error ;
+								pConnex->m_Track.Attach(pE->m_Error, true) ;
 						}
 						else
 						{
 							Z = pLang->m_rawScripts[reqPath] ;
 							rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_JS, Z, 86400, false) ;
 							if (rc != E_OK)
-								pConnex->m_Track << pE->m_Error ;
+								pConnex->m_Track.Attach(pE->m_Error, true) ;
 								//{ m_pLog->Out(pE->m_Error) ; m_pLog->Out("[\n") ; m_pLog->Out(pLang->m_rawScripts[reqPath]) ; m_pLog->Out("\n]\n") ; }
 						}
 					}
@@ -2266,7 +2284,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 			if (argA == preset_img)
 			{
 				pVP->m_img++ ;
-				pConnex->m_Track.Printf("Serving image [%s]\n", pReq + 5) ;
+				pConnex->m_Track.EventS("ProcHTTP: Serving image [%s]", pReq + 5) ;
 
 				if (pE->Method() == HTTP_HEAD)
 					pE->SendFileHead(*m_Images, pReq + 5) ;
@@ -2280,7 +2298,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 			{
 				pVP->m_spec++ ;
 				reqPath = pReq + preset_textpg.Length() + 1 ;
-				pConnex->m_Track.Printf("Serving textpg [%s]\n", *reqPath) ;
+				pConnex->m_Track.EventS("ProcHTTP: Serving textpg [%s]", *reqPath) ;
 				pE->SendPageE(*m_Docroot, pReq, 43200, false) ;
 				goto get_end ;
 			}
@@ -2304,12 +2322,13 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 				pE->SendHttpHead(m_txtCSS, HMTYPE_TXT_CSS, 86400) ;
 			else
 			{
-				if (pE->Zipped())
-					rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_CSS, m_zipCSS, 86400, true) ;
+				eCoding = pE->Coding() ;
+				if (m_zipCSS[eCoding].Size())
+					rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_CSS, m_zipCSS[eCoding], 86400, eCoding) ;
 				else
 					rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_CSS, m_txtCSS, 86400, false) ;
 				if (rc != E_OK)
-					pConnex->m_Track << pE->m_Error ;
+					pConnex->m_Track.Attach(pE->m_Error, true) ;
 			}
 			goto get_end ;
 		}
@@ -2331,7 +2350,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 			reqPath = m_Docroot + sv.Str() ;
 			reqPath = ConvertText(reqPath, pE) ;
 
-			pConnex->m_Track.Printf("Serving userfile [%s/%s]\n", *reqPath, pReq + preset_userdir.Length() + 2) ;
+			pConnex->m_Track.EventS("ProcHTTP: Serving userfile [%s]", pReq + preset_userdir.Length() + 2) ;
 			rc = pE->SendFilePage(*reqPath, pReq + preset_userdir.Length() + 2, 0, false) ;
 			if (rc != E_OK)
 				SendErrorPage(pE, HTTPMSG_NOTFOUND, __func__, "No such page as %s", pE->GetResource()) ;
@@ -2391,11 +2410,11 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 		if (pInfo)
 		{
 			//	pInfo->m_Access &= ACCESS_ADMIN ;
-			pConnex->m_Track.Printf("%s. Deleting cookie %016x\n", *_fn, pE->Cookie()) ;
+			pConnex->m_Track.Event("ProcHTTP: Deleting cookie %x", pE->Cookie()) ;
 
 			m_SessCookie.Delete(pE->Cookie()) ;
 			pE->SetSession(0) ;
-			pConnex->m_Track.Printf("%s. Deleting cookie %016x\n", *_fn, pE->Cookie()) ;
+			pConnex->m_Track.Event("ProcHTTP: Deleting cookie %x", pE->Cookie()) ;
 		}
 	}
 
@@ -2405,16 +2424,16 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 	pCIF = m_AltFuncs[reqPath] ;
 	if (pCIF)
 	{
-		pConnex->m_Track.Printf("%s. Serving C-Interface function %s\n", *_fn, *reqPath) ;
+		pConnex->m_Track.EventS("ProcHTTP: Serving C-Interface function %s", *reqPath) ;
 		rc = pCIF->m_pFunc(pE) ;
-		pConnex->m_Track.Printf("%s. Done C-Interface returned %s\n", *_fn, Err2Txt(rc)) ;
+		pConnex->m_Track.EventS("ProcHTTP: Done C-Interface returned %s", Err2Txt(rc)) ;
 		goto get_end ;
 	}
 
 	pFix = m_Fixed[reqPath] ;
 	if (pFix)
 	{
-		pConnex->m_Track.Printf("Serving fixed page [%s]\n", *reqPath) ;
+		pConnex->m_Track.EventS("ProcHTTP: Serving fixed page [%s]", *reqPath) ;
 		pVP->m_fix++ ;
 		if (pE->Zipped() && pFix->m_zipValue.Size())
 			rc = pE->SendRawChain(HTTPMSG_OK, pFix->m_Mimetype, pFix->m_zipValue, 86400, true) ;
@@ -2422,7 +2441,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 			rc = pE->SendRawChain(HTTPMSG_OK, pFix->m_Mimetype, pFix->m_rawValue, 86400, false) ;
 
 		if (rc != E_OK)
-			pConnex->m_Track << pE->m_Error ;
+			pConnex->m_Track.Attach(pE->m_Error, true) ;
 			//{ m_pLog->Out("[") ; m_pLog->Out(pE->m_Error) ; m_pLog->Out("]\n") ; }
 		goto get_end ;
 	}
@@ -2430,7 +2449,7 @@ hzTcpCode	hdsApp::ProcHTTP	(hzHttpEvent* pE)
 
 proc_std_request:
 	pResource = m_ResourcesPath[reqPath] ;
-	pConnex->m_Track.Printf("Got resource %p from request %s\n", pResource, *reqPath) ;
+	pConnex->m_Track.EventS("ProcHTTP: Got resource %x from request %s", *reqPath, (uint64_t) pResource) ;
 
 	if (!pResource)
 	{
@@ -2441,7 +2460,7 @@ proc_std_request:
 
 	if (!pResource)
 	{
-		//pConnex->m_Track.Printf("No page case 2: Serving page with arg [%s]\n", *reqPath) ;
+		//pConnex->m_Track.EventS("ProcHTTP: No page case 2: Serving page with arg [%s]", *reqPath) ;
 
 		if (!pInfo && m_MasterPath == pReq)
 		{
@@ -2458,16 +2477,16 @@ proc_std_request:
 			argB = m_Docroot + reqPath ;
 			rc = TestFile(*argB) ;
 			if (rc != E_OK)
-				pConnex->m_Track.Printf("Cannot find normal page [%s]\n", *argB) ;
+				pConnex->m_Track.EventS("ProcHTTP: Cannot find normal page [%s]", *argB) ;
 			else
 			{
-				pConnex->m_Track.Printf("Serving normal page [%s]\n", *argB) ;
+				pConnex->m_Track.EventS("ProcHTTP: Serving normal page [%s]", *argB) ;
 				pE->SendFilePage(*m_Docroot, *reqPath, 0, false) ;
 				goto get_end ;
 			}
 		}
 
-		pConnex->m_Track.Printf("Non-exist page [%s]\n", *reqPath) ;
+		pConnex->m_Track.EventS("ProcHTTP: Non-exist page [%s]", *reqPath) ;
 		pVP->m_G404++ ;
 		if (pVP->m_G404 > 1000 || (!pVP->m_art && pVP->m_page && pVP->m_G404 > 20))
 		{
@@ -2480,7 +2499,7 @@ proc_std_request:
 		else
 			SendErrorPage(pE, HTTPMSG_NOTFOUND, __func__, "No such page as %s (info %p)", pE->GetResource(), pInfo) ;
 
-		//pConnex->m_Track.Printf("Served non-exist page [%s]\n", *reqPath) ;
+		//pConnex->m_Track.EventS("ProcHTTP: Served non-exist page [%s]", *reqPath) ;
 	}
 	else
 	{
@@ -2492,7 +2511,7 @@ proc_std_request:
 		{
 			if ((pPage = dynamic_cast<hdsPage*>(pResource)))
 			{
-				pConnex->m_Track.Printf("Serving page [%s] (%s)\n", *reqPath, *pPage->m_Title) ;
+				pConnex->m_Track.EventS("ProcHTTP: Serving page [%s]", *reqPath) ;
 
 				if (pE->Method() == HTTP_HEAD)
 					pPage->Head(pE) ;
@@ -2513,7 +2532,7 @@ proc_std_request:
 							if (Z.Size())
 								rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_HTML, Z, 43200, true) ;
 							else
-								pConnex->m_Track.Printf("Cmd: Could not locate page zip data %s\n", pPage->m_USL.Txt(r32)) ;
+								pConnex->m_Track.ErrorS("ProcHTTP: Could not locate page zip data %s", pPage->m_USL.Txt(r32)) ;
 						}
 						else
 						{
@@ -2522,7 +2541,7 @@ proc_std_request:
 							if (Z.Size())
 								rc = pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_HTML, Z, 43200, false) ;
 							else
-								pConnex->m_Track.Printf("Cmd: Could not locate page raw data %s\n", pPage->m_USL.Txt(r32)) ;
+								pConnex->m_Track.ErrorS("ProcHTTP: Could not locate page raw data %s", pPage->m_USL.Txt(r32)) ;
 						}
 					}
 				}
@@ -2530,15 +2549,15 @@ proc_std_request:
 
 			if ((pFix = dynamic_cast<hdsFile*>(pResource)))
 			{
-				pConnex->m_Track.Printf("Serving fixed page [%s]\n", *reqPath) ;
+				pConnex->m_Track.EventS("ProcHTTP: Serving fixed page [%s]", *reqPath) ;
 				pVP->m_fix++ ;
 				if (pE->Zipped() && pFix->m_zipValue.Size())
-					rc = pE->SendRawChain(HTTPMSG_OK, pFix->m_Mimetype, pFix->m_zipValue, 86400, true) ;
+					rc = pE->SendEntity(pFix->m_Mimetype, pFix->m_zipValue, pFix->m_ETag, pFix->m_nMtime, 86400, true) ;
 				else
-					rc = pE->SendRawChain(HTTPMSG_OK, pFix->m_Mimetype, pFix->m_rawValue, 86400, false) ;
+					rc = pE->SendEntity(pFix->m_Mimetype, pFix->m_rawValue, pFix->m_ETag, pFix->m_nMtime, 86400, false) ;
 
 				if (rc != E_OK)
-					pConnex->m_Track << pE->m_Error ;
+					pConnex->m_Track.Attach(pE->m_Error, true) ;
 					//{ m_pLog->Out("[") ; m_pLog->Out(pE->m_Error) ; m_pLog->Out("]\n") ; }
 					//goto get_end ;
 			}
@@ -2548,11 +2567,11 @@ proc_std_request:
 				pCIF = dynamic_cast<hdsCIFunc*>(pResource) ;
 				if (pCIF)
 				{
-					pConnex->m_Track.Printf("Serving C-Interface Function [%s]\n", *reqPath) ;
+					pConnex->m_Track.EventS("ProcHTTP: Serving C-Interface Function [%s]", *reqPath) ;
 					pCIF->m_pFunc(pE) ;
 				}
 				else
-					pConnex->m_Track.Printf("NOT Serving C-Interface Function [%s]\n", *reqPath) ;
+					pConnex->m_Track.EventS("ProcHTTP: NOT Serving C-Interface Function [%s]", *reqPath) ;
 				//m_pLog->Out("Serving C-Interface Function [%s] (%s)\n", *reqPath, *pPage->m_Title) ;
 			}
 		}
@@ -2563,10 +2582,13 @@ proc_std_request:
 get_end:
 	if (pE->m_Report.Size())
 	{
-		pConnex->m_Track << pE->m_Report ;
+		pConnex->m_Track.Attach(pE->m_Report, false) ;
 		pE->m_Report.Clear() ;
 	}
 
+	if (!bReport)
+		return trc ;
+
 	pE->m_Report.Printf("%s ev=%d sk=%d ", *pE->m_Occur.Str(), pE->EventNo(), pE->CliSocket()) ;
 
 	if (pE->Connection())
@@ -2588,7 +2610,7 @@ get_end:
 		pE->m_Report.Printf("[cook=%016X info=%p] (%s) %s\n", pE->Cookie(), pInfo, *currRef, pE->GetResource()) ;
 	else
 		pE->m_Report.Printf("[cook=%016X info=0] (%s) %s\n", pE->Cookie(), *currRef, pE->GetResource()) ;
-	pConnex->m_Track << pE->m_Report ;
+	pConnex->m_Track.Attach(pE->m_Report, false) ;
 	return trc ;
 }
 
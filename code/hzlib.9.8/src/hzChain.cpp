@@ -202,9 +202,8 @@ void	hzChain::Clear	(void)
 
     if (_hzGlobal_MT)
     {
-        __sync_add_and_fetch((uint32_t*)&(cx->m_copy), -1) ;
-
-        if (cx->m_copy)
+		//	The count must be tested as returned by the decrement, as another thread may release its copy between the decrement and a later read
+        if (__sync_add_and_fetch((uint32_t*)&(cx->m_copy), -1))
 			return ;
     }
     else
@@ -21,9 +21,17 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 //#include <stdio.h>
 #include <crypt.h>
 #include <zlib.h>
+#if defined(HZ_BROTLI)
+#include <brotli/encode.h>
+#include <brotli/decode.h>
+#endif
+#if defined(HZ_ZSTD)
+#include <zstd.h>
+#endif
 #include <sys/stat.h>
 
 #include "hzBasedefs.h"
@@ -544,7 +552,7 @@ hzEcode	QPDecode	(hzChain& Decoded, hzChain& Raw)
 }
 
 /*
-**	SECTION 3:	gzip encoding/decoding
+**	SECTION 3:	Compression (gzip, Brotli and Zstandard)
 */
  
 hzEcode	Gzip	(hzChain& gzipped, const hzChain& orig)
@@ -566,6 +574,7 @@ hzEcode	Gzip	(hzChain& gzipped, const hzChain& orig)
 	z_stream	defstream;	//	The zlib struct
 	char*		tmp ;		//	A string to convert chain to contiguous memory
 	char*		buf ;		//	Buffer to construct gzipped content
+	uint32_t	nMax ;		//	Size of buffer
 	int32_t		err ;		//	Return code from init
 
 	gzipped.Clear() ;
@@ -577,22 +586,6 @@ hzEcode	Gzip	(hzChain& gzipped, const hzChain& orig)
 	defstream.zfree		= Z_NULL;
 	defstream.opaque	= Z_NULL;
 
-	// setup tmp as the input and buf as the compressed output
-	tmp = new char[orig.Size()+1] ;
-	buf = new char[orig.Size()] ;
-
-	//	for (n = 0, zi = orig ; !zi.eof() ; n++, zi++)
-	//		tmp[n] = *zi ;
-	//	tmp[n] = 0 ;
-	zi = orig ;
-	zi.Write(tmp, orig.Size()) ;
-	tmp[orig.Size()] = 0 ;
-
-	defstream.avail_in	= (uInt) orig.Size() ;
-	defstream.next_in	= (Bytef*) tmp;
-	defstream.avail_out	= (uInt) orig.Size() ;
-	defstream.next_out	= (Bytef*) buf;
-
 	//	Initialize the zlib deflation (i.e. compression) internals with deflateInit2(). 
 	//	The parameters are as follows: 
 	//
@@ -614,6 +607,20 @@ hzEcode	Gzip	(hzChain& gzipped, const hzChain& orig)
 	if (err != Z_OK)  
 		return hzerr(_fn, HZ_ERROR, E_NOINIT, "Could not run deflate process") ;
 
+	//	Setup tmp as the input and buf as the compressed output. The output is sized by deflateBound() as small or incompressible input will grow.
+	nMax = deflateBound(&defstream, orig.Size()) ;
+	tmp = new char[orig.Size()+1] ;
+	buf = new char[nMax] ;
+
+	zi = orig ;
+	zi.Write(tmp, orig.Size()) ;
+	tmp[orig.Size()] = 0 ;
+
+	defstream.avail_in	= (uInt) orig.Size() ;
+	defstream.next_in	= (Bytef*) tmp;
+	defstream.avail_out	= (uInt) nMax ;
+	defstream.next_out	= (Bytef*) buf;
+
 	// the actual compression work.
 	deflate(&defstream, Z_FINISH);
 	deflateEnd(&defstream);
@@ -621,8 +628,8 @@ hzEcode	Gzip	(hzChain& gzipped, const hzChain& orig)
 	//	for (n = 0 ; n < defstream.total_out ; n++)
 	//		gzipped.AddByte(buf[n]) ;
 	gzipped.Append(buf, defstream.total_out) ;
-	delete tmp ;
-	delete buf ;
+	delete [] tmp ;
+	delete [] buf ;
 
 	if (!gzipped.Size())
 		return hzerr(_fn, HZ_ERROR, E_NODATA, "Input %d bytes but no output", orig.Size()) ;
@@ -634,19 +641,16 @@ hzEcode	Gunzip	(hzChain& orig, const hzChain& gzipped)
 {
 	//	Category:	Codec
 	//
-	//	On the presumption that the supplied data is zipped by gzip, this functions writes the date to a temporary file, calls 'gunzip'
-	//	via a system call on this file and reads in the unziped data. The temporary file and it's unziped associate are then unlinked.
+	//	On the presumption that the supplied data is zipped by gzip, inflate it into the supplied output chain. The output is produced a buffer at a time
+	//	so there is no limit on its size.
 	//
-	//	Arguments:	1)	orig	The chain to be populated with the unzipped data
+	//	Arguments:	1)	orig	The chain to be populated with the unzipped data. Any pre-existing contents of this are cleared at the outset.
 	//				2)	gzipped	The chain containing the original (zipped) data
 	//
 	//	Returns:	E_NODATA	If there is nothing to do
-	//				E_WRITEFAIL	If the original data could not be written out to the temporary file
-	//				E_SYSERROR	If the gunzip command could not be found or failed to process the data
-	//				E_READFIAL	If the unzipped data could not be read back from the temporary file
+	//				E_NOINIT	If the inflate process could not be started
+	//				E_FORMAT	If the data is not gzipped or is truncated
 	//				E_OK		If the operation was successful
-	//
-	//	Note:	Do not unzip files that contain multiple files and/or accross mutiple directories. It won't work and will leave a mess!
 
 	_hzfunc(__func__) ;
 
@@ -654,36 +658,49 @@ hzEcode	Gunzip	(hzChain& orig, const hzChain& gzipped)
 	chIter		zi ;			//	Chain iterator
 	char*		tmp ;			//	Zipped buffer
 	char*		buf ;			//	Unzipped buffer
-	uint32_t	n ;				//	Buffer iterator
-
-	tmp = new char[gzipped.Size()+1] ;
-	buf = new char[20480] ;
+	int32_t		err ;			//	Return code from inflate
 
-	for (n = 0, zi = gzipped ; !zi.eof() ; n++, zi++)
-		tmp[n] = *zi ;
+	orig.Clear() ;
+	if (!gzipped.Size())
+		return E_NODATA ;
 
 	infstream.zalloc = Z_NULL;
 	infstream.zfree = Z_NULL;
 	infstream.opaque = Z_NULL;
+	infstream.avail_in = 0 ;
+	infstream.next_in = Z_NULL ;
 
-	// setup "b" as the input and "c" as the compressed output
-	infstream.avail_in = (uInt) gzipped.Size() ;	//((char*)defstream.next_out - b); // size of input
-	infstream.next_in = (Bytef*)tmp ;				// input char array
-	infstream.avail_out = 20480 ;					//	(uInt)sizeof(c); // size of output
-	infstream.next_out = (Bytef*)buf ;				// output char array
+	if (inflateInit2(&infstream, 31) != Z_OK)
+		return hzerr(_fn, HZ_ERROR, E_NOINIT, "Could not run inflate process") ;
+
+	tmp = new char[gzipped.Size()] ;
+	buf = new char[20480] ;
+
+	zi = gzipped ;
+	zi.Write(tmp, gzipped.Size()) ;
+
+	infstream.avail_in = (uInt) gzipped.Size() ;
+	infstream.next_in = (Bytef*)tmp ;
 
 	// the actual DE-compression work.
-	if (inflateInit2(&infstream, 31) != Z_OK)
-		return E_NOINIT ;
+	do
+	{
+		infstream.avail_out = 20480 ;
+		infstream.next_out = (Bytef*)buf ;
 
-	inflate(&infstream, Z_NO_FLUSH);
-	inflateEnd(&infstream);
+		err = inflate(&infstream, Z_NO_FLUSH);
+		if (err != Z_OK && err != Z_STREAM_END)
+			break ;
+		orig.Append(buf, 20480 - infstream.avail_out) ;
+	}
+	while (err == Z_OK) ;
 
-	for (n = 0 ; n < infstream.total_out ; n++)
-		orig.AddByte(buf[n]) ;
-	delete tmp ;
-	delete buf ;
+	inflateEnd(&infstream);
+	delete [] tmp ;
+	delete [] buf ;
 
+	if (err != Z_STREAM_END)
+		return hzerr(_fn, HZ_WARNING, E_FORMAT, "Data of %d bytes is not gzipped or is truncated", gzipped.Size()) ;
 	return E_OK ;
 }
 
@@ -729,8 +746,480 @@ hzEcode	Punzip	(hzChain& orig, const hzChain& zipped)
 	return E_OK ;
 }
 
+#if defined(HZ_BROTLI)
+hzEcode	Brotli	(hzChain& compressed, const hzChain& orig)
+{
+	//	Category:	Codec
+	//
+	//	Perform a Brotli compression (RFC 7932) of the supplied chain. The input is fed to the encoder a block of the chain at a time so it is not copied.
+	//	Maximum quality is used as Brotli is applied to static content, compressed once and served many times.
+	//
+	//	Arguments:	1)	compressed	The hzChain reference that will contain the result. Any pre-existing contents of this are cleared at the outset.
+	//				2)	orig		The original hzChain. This is not altered by this operation.
+	//
+	//	Returns:	E_NODATA	If the original is empty
+	//				E_NOINIT	If the encoder could not be created
+	//				E_FORMAT	If the encoder failed
+	//				E_OK		If the operation is successful
+
+	_hzfunc(__func__) ;
+
+	hzChain::BlkIter	bi ;	//	Block iterator for input
+
+	BrotliEncoderState*	pState ;	//	Encoder
+	const uint8_t*		pIn ;		//	Next input byte
+	uint8_t*			pOut ;		//	Next output byte
+	uint8_t*			buf ;		//	Output buffer
+	size_t				nIn ;		//	Input bytes remaining in block
+	size_t				nOut ;		//	Output space remaining
+	BROTLI_BOOL			bOK ;		//	Encoder return
+
+	compressed.Clear() ;
+	if (!orig.Size())
+		return hzerr(_fn, HZ_WARNING, E_NODATA, "No input data provided") ;
+
+	pState = BrotliEncoderCreateInstance(0, 0, 0) ;
+	if (!pState)
+		return hzerr(_fn, HZ_ERROR, E_NOINIT, "Could not create encoder") ;
+
+	BrotliEncoderSetParameter(pState, BROTLI_PARAM_QUALITY, BROTLI_MAX_QUALITY) ;
+	BrotliEncoderSetParameter(pState, BROTLI_PARAM_SIZE_HINT, orig.Size()) ;
+
+	buf = new uint8_t[20480] ;
+	bOK = BROTLI_TRUE ;
+
+	for (bi = orig ; bOK && bi.Data() ; bi.Advance())
+	{
+		pIn = (const uint8_t*) bi.Data() ;
+		nIn = bi.Size() ;
+
+		while (bOK && nIn)
+		{
+			pOut = buf ;
+			nOut = 20480 ;
+			bOK = BrotliEncoderCompressStream(pState, BROTLI_OPERATION_PROCESS, &nIn, &pIn, &nOut, &pOut, 0) ;
+			compressed.Append(buf, 20480 - nOut) ;
+		}
+	}
+
+	for (nIn = 0 ; bOK && !BrotliEncoderIsFinished(pState) ;)
+	{
+		pOut = buf ;
+		nOut = 20480 ;
+		bOK = BrotliEncoderCompressStream(pState, BROTLI_OPERATION_FINISH, &nIn, &pIn, &nOut, &pOut, 0) ;
+		compressed.Append(buf, 20480 - nOut) ;
+	}
+
+	BrotliEncoderDestroyInstance(pState) ;
+	delete [] buf ;
+
+	if (!bOK)
+	{
+		compressed.Clear() ;
+		return hzerr(_fn, HZ_ERROR, E_FORMAT, "Encoder failed on input of %d bytes", orig.Size()) ;
+	}
+
+	return E_OK ;
+}
+
+hzEcode	Unbrotli	(hzChain& orig, const hzChain& compressed)
+{
+	//	Category:	Codec
+	//
+	//	Decompress Brotli encoded data, a block of the input chain at a time.
+	//
+	//	Arguments:	1)	orig		The chain to be populated with the decompressed data. Any pre-existing contents of this are cleared at the outset.
+	//				2)	compressed	The chain containing the Brotli encoded data
+	//
+	//	Returns:	E_NODATA	If there is nothing to do
+	//				E_NOINIT	If the decoder could not be created
+	//				E_FORMAT	If the data is not valid Brotli or is truncated
+	//				E_OK		If the operation was successful
+
+	_hzfunc(__func__) ;
+
+	hzChain::BlkIter	bi ;	//	Block iterator for input
+
+	BrotliDecoderState*	pState ;	//	Decoder
+	BrotliDecoderResult	res ;		//	Decoder return
+	const uint8_t*		pIn ;		//	Next input byte
+	uint8_t*			pOut ;		//	Next output byte
+	uint8_t*			buf ;		//	Output buffer
+	size_t				nIn ;		//	Input bytes remaining in block
+	size_t				nOut ;		//	Output space remaining
+
+	orig.Clear() ;
+	if (!compressed.Size())
+		return E_NODATA ;
+
+	pState = BrotliDecoderCreateInstance(0, 0, 0) ;
+	if (!pState)
+		return hzerr(_fn, HZ_ERROR, E_NOINIT, "Could not create decoder") ;
+
+	buf = new uint8_t[20480] ;
+	res = BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT ;
+
+	for (bi = compressed ; res == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT && bi.Data() ; bi.Advance())
+	{
+		pIn = (const uint8_t*) bi.Data() ;
+		nIn = bi.Size() ;
+
+		do
+		{
+			pOut = buf ;
+			nOut = 20480 ;
+			res = BrotliDecoderDecompressStream(pState, &nIn, &pIn, &nOut, &pOut, 0) ;
+			orig.Append(buf, 20480 - nOut) ;
+		}
+		while (res == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) ;
+	}
+
+	BrotliDecoderDestroyInstance(pState) ;
+	delete [] buf ;
+
+	if (res != BROTLI_DECODER_RESULT_SUCCESS)
+		return hzerr(_fn, HZ_WARNING, E_FORMAT, "Data of %d bytes is not Brotli encoded or is truncated", compressed.Size()) ;
+	return E_OK ;
+}
+#endif	//	HZ_BROTLI
+
+#if defined(HZ_ZSTD)
+hzEcode	Zstd	(hzChain& compressed, const hzChain& orig)
+{
+	//	Category:	Codec
+	//
+	//	Perform a Zstandard compression (RFC 8878) of the supplied chain, a block of the chain at a time. As with Brotli a high compression level is used as
+	//	the content is expected to be static.
+	//
+	//	Arguments:	1)	compressed	The hzChain reference that will contain the result. Any pre-existing contents of this are cleared at the outset.
+	//				2)	orig		The original hzChain. This is not altered by this operation.
+	//
+	//	Returns:	E_NODATA	If the original is empty
+	//				E_NOINIT	If the compression context could not be created
+	//				E_FORMAT	If the compression failed
+	//				E_OK		If the operation is successful
+
+	_hzfunc(__func__) ;
+
+	hzChain::BlkIter	bi ;	//	Block iterator for input
+
+	ZSTD_CCtx*		pCtx ;		//	Compression context
+	ZSTD_inBuffer	zIn ;		//	Input
+	ZSTD_outBuffer	zOut ;		//	Output
+	char*			buf ;		//	Output buffer
+	size_t			nRem ;		//	Return of ZSTD_compressStream2 (bytes still to flush or error)
+
+	compressed.Clear() ;
+	if (!orig.Size())
+		return hzerr(_fn, HZ_WARNING, E_NODATA, "No input data provided") ;
+
+	pCtx = ZSTD_createCCtx() ;
+	if (!pCtx)
+		return hzerr(_fn, HZ_ERROR, E_NOINIT, "Could not create compression context") ;
+
+	ZSTD_CCtx_setParameter(pCtx, ZSTD_c_compressionLevel, 19) ;
+	ZSTD_CCtx_setPledgedSrcSize(pCtx, orig.Size()) ;
+
+	buf = new char[20480] ;
+	nRem = 0 ;
+
+	for (bi = orig ; !ZSTD_isError(nRem) && bi.Data() ; bi.Advance())
+	{
+		zIn.src = bi.Data() ;
+		zIn.size = bi.Size() ;
+		zIn.pos = 0 ;
+
+		while (!ZSTD_isError(nRem) && zIn.pos < zIn.size)
+		{
+			zOut.dst = buf ; zOut.size = 20480 ; zOut.pos = 0 ;
+			nRem = ZSTD_compressStream2(pCtx, &zOut, &zIn, ZSTD_e_continue) ;
+			compressed.Append(buf, zOut.pos) ;
+		}
+	}
+
+	zIn.src = 0 ; zIn.size = zIn.pos = 0 ;
+	for (nRem = ZSTD_isError(nRem) ? nRem : 1 ; nRem && !ZSTD_isError(nRem) ;)
+	{
+		zOut.dst = buf ; zOut.size = 20480 ; zOut.pos = 0 ;
+		nRem = ZSTD_compressStream2(pCtx, &zOut, &zIn, ZSTD_e_end) ;
+		compressed.Append(buf, zOut.pos) ;
+	}
+
+	ZSTD_freeCCtx(pCtx) ;
+	delete [] buf ;
+
+	if (ZSTD_isError(nRem))
+	{
+		compressed.Clear() ;
+		return hzerr(_fn, HZ_ERROR, E_FORMAT, "Compression failed (%s)", ZSTD_getErrorName(nRem)) ;
+	}
+
+	return E_OK ;
+}
+
+hzEcode	Unzstd	(hzChain& orig, const hzChain& compressed)
+{
+	//	Category:	Codec
+	//
+	//	Decompress Zstandard encoded data, a block of the input chain at a time.
+	//
+	//	Arguments:	1)	orig		The chain to be populated with the decompressed data. Any pre-existing contents of this are cleared at the outset.
+	//				2)	compressed	The chain containing the Zstandard encoded data
+	//
+	//	Returns:	E_NODATA	If there is nothing to do
+	//				E_NOINIT	If the decompression context could not be created
+	//				E_FORMAT	If the data is not valid Zstandard or is truncated
+	//				E_OK		If the operation was successful
+
+	_hzfunc(__func__) ;
+
+	hzChain::BlkIter	bi ;	//	Block iterator for input
+
+	ZSTD_DCtx*		pCtx ;		//	Decompression context
+	ZSTD_inBuffer	zIn ;		//	Input
+	ZSTD_outBuffer	zOut ;		//	Output
+	char*			buf ;		//	Output buffer
+	size_t			nRem ;		//	Return of ZSTD_decompressStream (0 when a frame is complete, or error)
+
+	orig.Clear() ;
+	if (!compressed.Size())
+		return E_NODATA ;
+
+	pCtx = ZSTD_createDCtx() ;
+	if (!pCtx)
+		return hzerr(_fn, HZ_ERROR, E_NOINIT, "Could not create decompression context") ;
+
+	buf = new char[20480] ;
+	nRem = 1 ;
+
+	for (bi = compressed ; !ZSTD_isError(nRem) && bi.Data() ; bi.Advance())
+	{
+		zIn.src = bi.Data() ;
+		zIn.size = bi.Size() ;
+		zIn.pos = 0 ;
+
+		do
+		{
+			zOut.dst = buf ; zOut.size = 20480 ; zOut.pos = 0 ;
+			nRem = ZSTD_decompressStream(pCtx, &zOut, &zIn) ;
+			if (ZSTD_isError(nRem))
+				break ;
+			orig.Append(buf, zOut.pos) ;
+		}
+		while (zIn.pos < zIn.size || zOut.pos == zOut.size) ;
+	}
+
+	ZSTD_freeDCtx(pCtx) ;
+	delete [] buf ;
+
+	if (nRem)
+		return hzerr(_fn, HZ_WARNING, E_FORMAT, "Data of %d bytes is not Zstandard encoded or is truncated", compressed.Size()) ;
+	return E_OK ;
+}
+#endif	//	HZ_ZSTD
+
+/*
+**	SECTION 4:	Content codings
+*/
+
+struct	_contentCoder
+{
+	//	Category:	Codec
+	//
+	//	Encoder and decoder of a content coding
+
+	const char*	m_pName ;		//	Name of coding as it appears in HTTP headers
+	hzCoderFn	m_fnEncode ;	//	Encoder (NULL if not available)
+	hzCoderFn	m_fnDecode ;	//	Decoder (NULL if not available)
+} ;
+
+static	_contentCoder	s_Coders[CONTENT_CODINGS] =
+{
+	//	The content codings (in order of hzContentCoding). These may be replaced by SetContentCoder()
+
+	{ "identity",	0,		0 },
+	{ "gzip",		Gzip,	Gunzip },
+#if defined(HZ_ZSTD)
+	{ "zstd",		Zstd,	Unzstd },
+#else
+	{ "zstd",		0,		0 },
+#endif
+#if defined(HZ_BROTLI)
+	{ "br",			Brotli,	Unbrotli }
+#else
+	{ "br",			0,		0 }
+#endif
+} ;
+
+hzEcode	SetContentCoder	(hzContentCoding eCoding, hzCoderFn fnEncode, hzCoderFn fnDecode)
+{
+	//	Category:	Codec
+	//
+	//	Install, replace or remove (by supplying NULL functions) the encoder and decoder of a content coding. As the table of coders is consulted without a
+	//	lock, this should only be called during initialization, before any content is encoded or any HTTP requests are served.
+	//
+	//	Arguments:	1)	eCoding		The content coding
+	//				2)	fnEncode	The encoder
+	//				3)	fnDecode	The decoder
+	//
+	//	Returns:	E_ARGUMENT	If the coding is not one that can be set
+	//				E_OK		If the coder is set
+
+	_hzfunc(__func__) ;
+
+	if (eCoding <= CONTENT_IDENTITY || eCoding >= CONTENT_CODINGS)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Invalid content coding %d", eCoding) ;
+
+	s_Coders[eCoding].m_fnEncode = fnEncode ;
+	s_Coders[eCoding].m_fnDecode = fnDecode ;
+	return E_OK ;
+}
+
+bool	ContentCodingOK	(hzContentCoding eCoding)
+{
+	//	Category:	Codec
+	//
+	//	Determine if content can be encoded in the supplied coding. The identity coding is always available.
+	//
+	//	Arguments:	1)	eCoding	The content coding
+	//
+	//	Returns:	True	If the coding has an encoder
+	//				False	Otherwise
+
+	if (eCoding == CONTENT_IDENTITY)
+		return true ;
+	return eCoding > CONTENT_IDENTITY && eCoding < CONTENT_CODINGS && s_Coders[eCoding].m_fnEncode ? true : false ;
+}
+
+const char*	ContentCodingName	(hzContentCoding eCoding)
+{
+	//	Category:	Codec
+	//
+	//	Return the name of a content coding as it appears in the Accept-Encoding and Content-Encoding headers
+	//
+	//	Arguments:	1)	eCoding	The content coding
+	//
+	//	Returns:	Pointer to the name (empty string if the coding is invalid)
+
+	return eCoding >= CONTENT_IDENTITY && eCoding < CONTENT_CODINGS ? s_Coders[eCoding].m_pName : "" ;
+}
+
+hzContentCoding	ContentCodingId	(const char* pName, uint32_t nLen)
+{
+	//	Category:	Codec
+	//
+	//	Identify a content coding by name (case insensitive). The name x-gzip is taken as gzip.
+	//
+	//	Arguments:	1)	pName	The name (need not be null terminated)
+	//				2)	nLen	Length of name
+	//
+	//	Returns:	Enum value of the coding
+	//				CONTENT_CODINGS	If the name is not that of a known coding
+
+	uint32_t	n ;		//	Coding iterator
+
+	if (!pName)
+		return CONTENT_CODINGS ;
+
+	if (nLen == 6 && !strncasecmp(pName, "x-gzip", 6))
+		return CONTENT_GZIP ;
+
+	for (n = CONTENT_IDENTITY ; n < CONTENT_CODINGS ; n++)
+	{
+		if (strlen(s_Coders[n].m_pName) == nLen && !strncasecmp(s_Coders[n].m_pName, pName, nLen))
+			return (hzContentCoding) n ;
+	}
+
+	return CONTENT_CODINGS ;
+}
+
+hzEcode	ContentEncode	(hzChain& output, const hzChain& input, hzContentCoding eCoding)
+{
+	//	Category:	Codec
+	//
+	//	Encode the input in the supplied content coding. The identity coding copies the input.
+	//
+	//	Arguments:	1)	output	The chain to contain the encoded data. Any pre-existing contents of this are cleared at the outset.
+	//				2)	input	The data to encode
+	//				3)	eCoding	The content coding
+	//
+	//	Returns:	E_NOTFOUND	If the coding has no encoder
+	//				E_NODATA	If the input is empty
+	//				Other		Error codes of the encoder
+	//				E_OK		If the operation was successful
+
+	_hzfunc(__func__) ;
+
+	if (eCoding == CONTENT_IDENTITY)
+		{ output = input ; return E_OK ; }
+
+	if (!ContentCodingOK(eCoding))
+		{ output.Clear() ; return hzerr(_fn, HZ_ERROR, E_NOTFOUND, "No encoder for content coding %d", eCoding) ; }
+
+	return s_Coders[eCoding].m_fnEncode(output, input) ;
+}
+
+hzEcode	ContentDecode	(hzChain& output, const hzChain& input, hzContentCoding eCoding)
+{
+	//	Category:	Codec
+	//
+	//	Decode input in the supplied content coding. The identity coding copies the input.
+	//
+	//	Arguments:	1)	output	The chain to contain the decoded data. Any pre-existing contents of this are cleared at the outset.
+	//				2)	input	The encoded data
+	//				3)	eCoding	The content coding
+	//
+	//	Returns:	E_NOTFOUND	If the coding has no decoder
+	//				E_NODATA	If the input is empty
+	//				Other		Error codes of the decoder
+	//				E_OK		If the operation was successful
+
+	_hzfunc(__func__) ;
+
+	if (eCoding == CONTENT_IDENTITY)
+		{ output = input ; return E_OK ; }
+
+	if (eCoding <= CONTENT_IDENTITY || eCoding >= CONTENT_CODINGS || !s_Coders[eCoding].m_fnDecode)
+		{ output.Clear() ; return hzerr(_fn, HZ_ERROR, E_NOTFOUND, "No decoder for content coding %d", eCoding) ; }
+
+	return s_Coders[eCoding].m_fnDecode(output, input) ;
+}
+
+uint32_t	ContentEncodeAll	(hzChain* pCoded, const hzChain& input)
+{
+	//	Category:	Codec
+	//
+	//	Encode the input in every available content coding. This is for static content that is encoded once and then served in whichever coding the client
+	//	prefers. The supplied array is indexed by hzContentCoding. The identity entry is left alone (the caller has the input), as are the entries of codings
+	//	with no encoder, which are cleared. An entry is also left empty where encoding fails or would not make the content any smaller.
+	//
+	//	Arguments:	1)	pCoded	Array of CONTENT_CODINGS chains to receive the encoded content
+	//				2)	input	The content
+	//
+	//	Returns:	Bitmap of the codings populated (bit n set for coding n)
+
+	uint32_t	n ;			//	Coding iterator
+	uint32_t	nDone ;		//	Codings populated
+
+	if (!pCoded)
+		return 0 ;
+
+	for (nDone = 0, n = CONTENT_GZIP ; n < CONTENT_CODINGS ; n++)
+	{
+		pCoded[n].Clear() ;
+		if (!input.Size() || !ContentCodingOK((hzContentCoding) n))
+			continue ;
+
+		if (ContentEncode(pCoded[n], input, (hzContentCoding) n) != E_OK || pCoded[n].Size() >= input.Size())
+			{ pCoded[n].Clear() ; continue ; }
+		nDone |= (1 << n) ;
+	}
+
+	return nDone ;
+}
+
 /*
-**	SECTION 4:	MD5 Digest
+**	SECTION 5:	MD5 Digest
 */
 
 /*
@@ -1117,7 +1606,7 @@ hzEcode	hzMD5::CalcMD5	(const char* cstr)
 }
 
 /*
-**	SECTION 5:	Endian Conversions
+**	SECTION 6:	Endian Conversions
 */
 
 //	FnSet:		GetNByte
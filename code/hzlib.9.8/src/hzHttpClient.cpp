@@ -190,6 +190,7 @@ hzEcode	hzHttpClient::_procHttpResponse	(hzMapS<hzString,hzCookie>& cookies, Htt
 	bool		duHast = false ;	//	Have read a chunking directive or have a content len
 	bool		bTerm = false ;		//	Terminate chunking (only set upon a 0 value on a line by itself
 	hzEcode		sRet = E_OK ;		//	Return code
+	hzContentCoding	eCoding ;		//	Content coding of response
 	char		numBuf[4] ;			//	For HTTP return code
 
 	//	Clear variables
@@ -556,16 +557,17 @@ hzEcode	hzHttpClient::_procHttpResponse	(hzMapS<hzString,hzCookie>& cookies, Htt
 	{
 		//	Must apply appropiate decoding to content
 
-		if (m_ContEncoding == "gzip")
+		eCoding = ContentCodingId(*m_ContEncoding, m_ContEncoding.Length()) ;
+		if (eCoding > CONTENT_IDENTITY && eCoding < CONTENT_CODINGS)
 		{
 			X = m_Content ;
 			m_Content.Clear() ;
 
-			m_Error.Printf("doing gunzip\n") ;
-			sRet = Gunzip(m_Content, X) ;
+			m_Error.Printf("doing %s decoding\n", ContentCodingName(eCoding)) ;
+			sRet = ContentDecode(m_Content, X, eCoding) ;
 
 			if (sRet != E_OK)
-				m_Error.Printf("%s. Gunzip failed\n", *_fn) ;
+				m_Error.Printf("%s. Decoding of %s content failed\n", *_fn, ContentCodingName(eCoding)) ;
 		}
 	}
 
@@ -0,0 +1,285 @@
+//
+//	File:	hzHttpParse.cpp
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+//
+//	HTTP request header scanning (see synopsis in hzHttpParse.h)
+//
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <string.h>
+#include <strings.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "hzChars.h"
+#include "hzHttpParse.h"
+#include "hzProcess.h"
+
+using namespace std ;
+
+/*
+**	Definitions
+*/
+
+#define	HTTP_HDR_SLOTS	128		//	Header name table size (power of 2)
+
+struct	_hdrName
+{
+	//	Category:	Internet
+	//
+	//	Known header name
+
+	const char*	m_pName ;	//	Header name
+	uint32_t	m_nLen ;	//	Length of name
+	hzHttpHdr	m_eHdr ;	//	Header id
+} ;
+
+static	const _hdrName	s_hdrNames[] =
+{
+	//	The known headers (in order of hzHttpHdr)
+
+	{ "",					0,	HTTP_HDR_UNKNOWN },
+	{ "Accept",				6,	HTTP_HDR_ACCEPT },
+	{ "Accept-Charset",		14,	HTTP_HDR_ACCEPT_CHARSET },
+	{ "Accept-Language",	15,	HTTP_HDR_ACCEPT_LANGUAGE },
+	{ "Accept-Encoding",	15,	HTTP_HDR_ACCEPT_ENCODING },
+	{ "Authorization",		13,	HTTP_HDR_AUTHORIZATION },
+	{ "Cache-Control",		13,	HTTP_HDR_CACHE_CONTROL },
+	{ "Client-ip",			9,	HTTP_HDR_CLIENT_IP },
+	{ "Connection",			10,	HTTP_HDR_CONNECTION },
+	{ "Content-Length",		14,	HTTP_HDR_CONTENT_LENGTH },
+	{ "Content-Type",		12,	HTTP_HDR_CONTENT_TYPE },
+	{ "Cookie",				6,	HTTP_HDR_COOKIE },
+	{ "From",				4,	HTTP_HDR_FROM },
+	{ "Host",				4,	HTTP_HDR_HOST },
+	{ "If-Modified-Since",	17,	HTTP_HDR_IF_MODIFIED_SINCE },
+	{ "If-None-Match",		13,	HTTP_HDR_IF_NONE_MATCH },
+	{ "If-Range",			8,	HTTP_HDR_IF_RANGE },
+	{ "Keep-Alive",			10,	HTTP_HDR_KEEP_ALIVE },
+	{ "Max-Forwards",		12,	HTTP_HDR_MAX_FORWARDS },
+	{ "Pragma",				6,	HTTP_HDR_PRAGMA },
+	{ "Range",				5,	HTTP_HDR_RANGE },
+	{ "Referer",			7,	HTTP_HDR_REFERER },
+	{ "Sec-WebSocket-Key",	17,	HTTP_HDR_SEC_WEBSOCKET_KEY },
+	{ "Sec-WebSocket-Protocol",	22,	HTTP_HDR_SEC_WEBSOCKET_PROTOCOL },
+	{ "Sec-WebSocket-Version",	21,	HTTP_HDR_SEC_WEBSOCKET_VERSION },
+	{ "Transfer-Encoding",	17,	HTTP_HDR_TRANSFER_ENCODING },
+	{ "UA-CPU",				6,	HTTP_HDR_UA_CPU },
+	{ "Upgrade",			7,	HTTP_HDR_UPGRADE },
+	{ "User-Agent",			10,	HTTP_HDR_USER_AGENT },
+	{ "Via",				3,	HTTP_HDR_VIA },
+	{ "X-Forwarded-For",	15,	HTTP_HDR_X_FORWARDED_FOR },
+	{ "X-Forwarded-Host",	16,	HTTP_HDR_X_FORWARDED_HOST },
+	{ "X-Forwarded-Server",	18,	HTTP_HDR_X_FORWARDED_SERVER },
+	{ "X-ProxyUser-IP",		14,	HTTP_HDR_X_PROXYUSER_IP }
+} ;
+
+static	uint8_t	s_hdrSlots[HTTP_HDR_SLOTS] ;	//	Table of header ids by hash of name
+
+/*
+**	Functions
+*/
+
+const char*	HttpScan	(const char* pStr, const char* pEnd, char c)
+{
+	//	Category:	Internet
+	//
+	//	Find the first occurence of a character in a buffer
+	//
+	//	Arguments:	1)	pStr	Start of buffer
+	//				2)	pEnd	End of buffer (one past the last byte)
+	//				3)	c		Character to find
+	//
+	//	Returns:	Pointer to the character if found
+	//				NULL	If the character does not occur before the end
+
+#if defined(__SSE2__)
+	uint32_t	bits ;		//	Bitmap of matching bytes
+#endif
+
+#if defined(__AVX2__)
+	__m256i		wide ;		//	Character to find (32 copies)
+
+	wide = _mm256_set1_epi8(c) ;
+	for (; (pStr + 32) <= pEnd ; pStr += 32)
+	{
+		bits = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) pStr), wide)) ;
+		if (bits)
+			return pStr + __builtin_ctz(bits) ;
+	}
+#endif
+
+#if defined(__SSE2__)
+	__m128i		narrow ;	//	Character to find (16 copies)
+
+	narrow = _mm_set1_epi8(c) ;
+	for (; (pStr + 16) <= pEnd ; pStr += 16)
+	{
+		bits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) pStr), narrow)) ;
+		if (bits)
+			return pStr + __builtin_ctz(bits) ;
+	}
+#endif
+
+	for (; pStr < pEnd ; pStr++)
+	{
+		if (*pStr == c)
+			return pStr ;
+	}
+
+	return 0 ;
+}
+
+uint32_t	HttpHeaderEnd	(const hzChain& Z, uint32_t nMax)
+{
+	//	Category:	Internet
+	//
+	//	Establish the length of the HTTP header at the start of the supplied chain, by searching the blocks of the chain in place for the CR/NL/CR/NL sequence
+	//	ending the header. The sequence may straddle blocks so the last three bytes of each block are carried over to the next.
+	//
+	//	Arguments:	1)	Z		The chain (input of the connection)
+	//				2)	nMax	Maximum header length
+	//
+	//	Returns:	Length of the header including the terminating blank line
+	//				0	If the header end is not found within the first nMax bytes
+
+	hzChain::BlkIter	bi ;	//	Block iterator
+
+	const char*	pBlk ;			//	Block data
+	const char*	pEnd ;			//	End of block data
+	const char*	i ;				//	Newline found
+	uint32_t	nBase ;			//	Offset of block in chain
+	uint32_t	nOset ;			//	Offset of newline in block
+	char		tail[3] ;		//	Last 3 bytes of previous block(s)
+	char		a ;				//	3rd byte before newline
+	char		b ;				//	2nd byte before newline
+	char		c ;				//	Byte before newline
+
+	tail[0] = tail[1] = tail[2] = 0 ;
+
+	for (bi = Z, nBase = 0 ; bi.Data() && nBase < nMax ; nBase += bi.Size(), bi.Advance())
+	{
+		pBlk = (const char*) bi.Data() ;
+		pEnd = pBlk + bi.Size() ;
+
+		for (i = pBlk ; (i = HttpScan(i, pEnd, CHAR_NL)) ; i++)
+		{
+			nOset = i - pBlk ;
+			if ((nBase + nOset) >= nMax)
+				return 0 ;
+
+			if (nOset >= 3)
+				{ a = i[-3] ; b = i[-2] ; c = i[-1] ; }
+			else
+			{
+				a = tail[nOset] ;
+				b = nOset >= 2 ? i[-2] : tail[nOset + 1] ;
+				c = nOset >= 1 ? i[-1] : tail[2] ;
+			}
+
+			if (a == CHAR_CR && b == CHAR_NL && c == CHAR_CR)
+				return nBase + nOset + 1 ;
+		}
+
+		for (i = (pEnd - pBlk) > 3 ? pEnd - 3 : pBlk ; i < pEnd ; i++)
+			{ tail[0] = tail[1] ; tail[1] = tail[2] ; tail[2] = *i ; }
+	}
+
+	return 0 ;
+}
+
+static	inline	uint32_t	_hdrhash	(const char* pName, uint32_t nLen)
+{
+	//	Hash a header name (case insensitive) by its length and its first, middle and last characters. The multipliers are chosen so that no two of the known
+	//	headers share a slot, making this a perfect hash over s_hdrNames. Any header added to s_hdrNames must keep it so, and _hdrinit will not start otherwise.
+
+	return (nLen + 6 * (pName[0] | 0x20) + 12 * (pName[nLen - 1] | 0x20) + 12 * (pName[nLen / 2] | 0x20)) & (HTTP_HDR_SLOTS - 1) ;
+}
+
+static	bool	_hdrinit	(void)
+{
+	//	Populate the header name table. As _hdrhash is a perfect hash over the known headers, each header is placed in its own slot without probing. Should two
+	//	headers collide, the table cannot identify them both so this is fatal, naming the two headers. The multipliers in _hdrhash must then be retuned.
+	//
+	//	Arguments:	None
+	//	Returns:	True	If every known header has a slot of its own
+	//				False	If two known headers collide (after the Fatal call)
+
+	uint32_t	n ;		//	Header iterator
+	uint32_t	h ;		//	Slot
+
+	memset(s_hdrSlots, 0, HTTP_HDR_SLOTS) ;
+
+	for (n = 1 ; n < HTTP_HDR_COUNT ; n++)
+	{
+		h = _hdrhash(s_hdrNames[n].m_pName, s_hdrNames[n].m_nLen) ;
+		if (s_hdrSlots[h])
+		{
+			Fatal("_hdrinit. Headers %s and %s share slot %u of the header table. Retune _hdrhash\n", s_hdrNames[s_hdrSlots[h]].m_pName, s_hdrNames[n].m_pName, h) ;
+			return false ;
+		}
+		s_hdrSlots[h] = n ;
+	}
+
+	return true ;
+}
+
+hzHttpHdr	HttpHeaderId	(const char* pName, uint32_t nLen)
+{
+	//	Category:	Internet
+	//
+	//	Identify a HTTP header by name (case insensitive)
+	//
+	//	Arguments:	1)	pName	Header name (need not be null terminated)
+	//				2)	nLen	Length of name
+	//
+	//	Returns:	Enum value of header (HTTP_HDR_UNKNOWN if not a header of interest)
+
+	static	bool	s_bInit = _hdrinit() ;	//	Table populated on first use
+
+	uint32_t	h ;		//	Slot
+	uint32_t	n ;		//	Header id
+
+	if (!s_bInit || !pName || !nLen)
+		return HTTP_HDR_UNKNOWN ;
+
+	//	One probe: the only known header that can match is the one in the slot
+	h = _hdrhash(pName, nLen) ;
+	n = s_hdrSlots[h] ;
+	if (n && s_hdrNames[n].m_nLen == nLen && !strncasecmp(s_hdrNames[n].m_pName, pName, nLen))
+		return s_hdrNames[n].m_eHdr ;
+
+	return HTTP_HDR_UNKNOWN ;
+}
+
+const char*	HttpHeaderName	(hzHttpHdr eHdr)
+{
+	//	Category:	Internet
+	//
+	//	Return the name of a known header
+	//
+	//	Arguments:	1)	eHdr	Header id
+	//
+	//	Returns:	Pointer to header name (empty string if not a known header)
+
+	return eHdr > HTTP_HDR_UNKNOWN && eHdr < HTTP_HDR_COUNT ? s_hdrNames[eHdr].m_pName : "" ;
+}
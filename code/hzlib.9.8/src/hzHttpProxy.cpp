@@ -0,0 +1,1365 @@
+//
+//	File:	hzHttpProxy.cpp
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "hzChars.h"
+#include "hzErrcode.h"
+#include "hzProcess.h"
+#include "hzUrl.h"
+#include "hzHttpParse.h"
+#include "hzHttpProxy.h"
+
+using namespace std ;
+
+/*
+**	Variables
+*/
+
+static	hzHttpProxy*	s_pTheProxy = 0 ;		//	The one and only proxy
+
+/*
+**	Non member functions
+*/
+
+static	hzEcode	_sendall	(uint32_t nSock, const hzChain& Z)
+{
+	//	Write the whole of a chain to an upstream connection. This is done by send() with MSG_NOSIGNAL, so an upstream server closing the connection results
+	//	in an error rather than SIGPIPE.
+	//
+	//	Arguments:	1)	nSock	The socket
+	//				2)	Z		The data to send
+	//
+	//	Returns:	E_SENDFAIL	If the data could not all be sent
+	//				E_OK		If the data was sent
+
+	hzChain::BlkIter	bi ;	//	Block iterator
+
+	const char*	pData ;		//	Block data
+	uint32_t	nLen ;		//	Bytes of block remaining
+	int32_t		nSent ;		//	Bytes sent by a call to send()
+
+	for (bi = Z ; bi.Data() ; bi.Advance())
+	{
+		pData = (const char*) bi.Data() ;
+		for (nLen = bi.Size() ; nLen ; nLen -= nSent, pData += nSent)
+		{
+			nSent = send(nSock, pData, nLen, MSG_NOSIGNAL) ;
+			if (nSent <= 0)
+			{
+				if (nSent < 0 && errno == EINTR)
+					{ nSent = 0 ; continue ; }
+				return E_SENDFAIL ;
+			}
+		}
+	}
+
+	return E_OK ;
+}
+
+static	bool	_hastoken	(const char* pVal, uint32_t nLen, const char* cpToken)
+{
+	//	Determine if a header value (a comma separated list) includes the given token (case insensitive)
+	//
+	//	Arguments:	1)	pVal	The header value (need not be null terminated)
+	//				2)	nLen	Length of value
+	//				3)	cpToken	The token sought
+	//
+	//	Returns:	True	If the token is found
+	//				False	Otherwise
+
+	uint32_t	nTok ;		//	Length of token
+	uint32_t	n ;			//	Offset into value
+
+	nTok = strlen(cpToken) ;
+	for (n = 0 ; n + nTok <= nLen ; n++)
+	{
+		if (strncasecmp(pVal + n, cpToken, nTok))
+			continue ;
+		if ((n == 0 || pVal[n-1] == CHAR_COMMA || pVal[n-1] == CHAR_SPACE) && (n + nTok == nLen || pVal[n+nTok] == CHAR_COMMA || pVal[n+nTok] == CHAR_SPACE))
+			return true ;
+	}
+	return false ;
+}
+
+static	bool	_hopbyhop	(const char* pName, uint32_t nLen)
+{
+	//	Determine if a header pertains only to the connection it arrives on and so must not be relayed. Of these, Connection, Keep-Alive and Upgrade are known
+	//	to the header table, the rest are tested by name.
+	//
+	//	Arguments:	1)	pName	Header name (need not be null terminated)
+	//				2)	nLen	Length of name
+	//
+	//	Returns:	True	If the header is not to be relayed
+	//				False	Otherwise
+
+	switch	(HttpHeaderId(pName, nLen))
+	{
+	case HTTP_HDR_CONNECTION:
+	case HTTP_HDR_KEEP_ALIVE:
+	case HTTP_HDR_UPGRADE:
+		return true ;
+	default:
+		break ;
+	}
+
+	if (nLen == 2 && !strncasecmp(pName, "TE", 2))					return true ;
+	if (nLen == 7 && !strncasecmp(pName, "Trailer", 7))				return true ;
+	if (nLen == 16 && !strncasecmp(pName, "Proxy-Connection", 16))	return true ;
+	return false ;
+}
+
+static	const char*	_hdrfield	(const char*& pName, uint32_t& nName, const char*& pVal, uint32_t& nVal, const char* pLine, const char* pEnd)
+{
+	//	Delimit the name and value of a header line
+	//
+	//	Arguments:	1)	pName	Set to the header name
+	//				2)	nName	Set to the length of the name
+	//				3)	pVal	Set to the value (leading and trailing whitespace excluded)
+	//				4)	nVal	Set to the length of the value
+	//				5)	pLine	Start of header line
+	//				6)	pEnd	End of header
+	//
+	//	Returns:	Pointer to the start of the next line (after the newline)
+	//				NULL	If the line is not terminated before the end of the header
+
+	const char*	pEol ;		//	Newline ending line
+	const char*	pColon ;	//	Colon ending name
+	const char*	pVEnd ;		//	End of value
+
+	if (!(pEol = HttpScan(pLine, pEnd, CHAR_NL)))
+		return 0 ;
+
+	pName = pLine ;
+	nName = nVal = 0 ;
+	pVal = pEol ;
+
+	if (!(pColon = HttpScan(pLine, pEol, CHAR_COLON)))
+		return pEol + 1 ;
+
+	nName = pColon - pLine ;
+	for (pVal = pColon + 1 ; pVal < pEol && (*pVal == CHAR_SPACE || *pVal == CHAR_TAB) ; pVal++) ;
+	for (pVEnd = pEol ; pVEnd > pVal && (pVEnd[-1] == CHAR_CR || pVEnd[-1] == CHAR_SPACE || pVEnd[-1] == CHAR_TAB) ; pVEnd--) ;
+	nVal = pVEnd - pVal ;
+
+	return pEol + 1 ;
+}
+
+/*
+**	The relay of response bodies
+*/
+
+enum	_hzRelayMode
+{
+	//	How the end of an upstream response body is known
+
+	RELAY_NONE,			//	No body (HEAD request, 1xx, 204 and 304 responses)
+	RELAY_LENGTH,		//	Body of given Content-Length
+	RELAY_CHUNKED,		//	Chunked body (relayed as is)
+	RELAY_CLOSE			//	Body ended by the upstream server closing the connection
+} ;
+
+enum	_hzRelayChunk
+{
+	//	State of the chunk scanner
+
+	RCH_SIZE,			//	Chunk size
+	RCH_EXT,			//	Rest of chunk size line
+	RCH_DATA,			//	Chunk data
+	RCH_DATAEND,		//	CR/NL ending chunk data
+	RCH_TRAILER			//	Trailer lines, ended by a blank line
+} ;
+
+class	_hzRelay	: public hzOutSource
+{
+	//	Output source relaying a response body from an upstream connection. The body is relayed as it is received, but it must be scanned to find where it
+	//	ends as the upstream connection is persistent. On deletion (by hzIpConnex, once the source is exhausted or the client connection is terminated), the
+	//	upstream connection is returned to the upstream server for reuse if the body was relayed in full, and otherwise closed.
+	//
+	//	Once handed to the client connection (see Stream), the upstream socket is non-blocking. Should it have nothing to hand, Fill() queues nothing and the
+	//	socket is given by WaitSock() for the serving loop to poll, so a slow upstream server does not hold up the serving thread.
+
+	hzUpstream*		m_pUp ;			//	Upstream server
+	hzTcpClient*	m_pConn ;		//	Upstream connection
+	uint32_t		m_nLeft ;		//	Bytes of body (RELAY_LENGTH) or of current chunk (RELAY_CHUNKED) still to come
+	uint32_t		m_nSize ;		//	Total size of body if known, otherwise bytes relayed so far
+	uint32_t		m_nLine ;		//	Length of current trailer line
+	_hzRelayMode	m_eMode ;		//	How the end of the body is known
+	_hzRelayChunk	m_eChunk ;		//	Chunk scanner state
+	bool			m_bDone ;		//	Body relayed in full
+	bool			m_bReuse ;		//	Connection may be reused once the body is relayed
+	bool			m_bBad ;		//	Malformed chunked body
+	bool			m_bNoBlock ;	//	Upstream socket has been made non-blocking
+	bool			m_bWait ;		//	Last receive found no data (non-blocking socket only)
+
+	//	Prevent copies
+	_hzRelay	(const _hzRelay&) ;
+	_hzRelay&	operator=	(const _hzRelay&) ;
+
+public:
+	_hzRelay	(hzUpstream* pUp, hzTcpClient* pConn, _hzRelayMode eMode, uint32_t nLen, bool bReuse)
+	{
+		m_pUp = pUp ;
+		m_pConn = pConn ;
+		m_eMode = eMode ;
+		m_eChunk = RCH_SIZE ;
+		m_nLeft = eMode == RELAY_LENGTH ? nLen : 0 ;
+		m_nSize = m_nLeft ;
+		m_nLine = 0 ;
+		m_bDone = eMode == RELAY_NONE || (eMode == RELAY_LENGTH && !nLen) ? true : false ;
+		m_bReuse = eMode == RELAY_CLOSE ? false : bReuse ;
+		m_bBad = false ;
+		m_bNoBlock = m_bWait = false ;
+	}
+
+	~_hzRelay	(void) ;
+
+	uint32_t	Scan	(const char* pBuf, uint32_t nLen) ;
+	int32_t		Pull	(char* pBuf, uint32_t nMax) ;
+	hzEcode		Stream	(void) ;
+
+	hzEcode		Fill	(hzPktQue& Q, uint32_t nMax) ;
+	uint32_t	Size	(void) const	{ return m_nSize ; }
+	int32_t		WaitSock	(void) const	{ return m_bWait ? m_pConn->Sock() : -1 ; }
+	bool		Done	(void) const	{ return m_bDone ; }
+} ;
+
+_hzRelay::~_hzRelay	(void)
+{
+	int32_t	flags ;		//	Socket flags
+
+	//	A connection kept for reuse is used by Relay() for the next request, which expects a blocking socket
+	if (m_bNoBlock && m_bDone && m_bReuse)
+	{
+		flags = fcntl(m_pConn->Sock(), F_GETFL, 0) ;
+		if (flags == -1 || fcntl(m_pConn->Sock(), F_SETFL, flags & ~O_NONBLOCK) == -1)
+			m_bReuse = false ;
+	}
+
+	m_pUp->Give(m_pConn, m_bDone && m_bReuse) ;
+}
+
+uint32_t	_hzRelay::Scan	(const char* pBuf, uint32_t nLen)
+{
+	//	Advance over bytes received from the upstream server, to establish how many of them belong to the body and whether the body is now complete. Anything
+	//	beyond the end of the body should not be there, and the connection is then not reused.
+	//
+	//	Arguments:	1)	pBuf	Bytes received
+	//				2)	nLen	Number of bytes
+	//
+	//	Returns:	Number of bytes belonging to the body
+
+	uint32_t	n ;			//	Bytes scanned
+	uint32_t	nData ;		//	Bytes of chunk data
+	char		c ;			//	Byte scanned
+
+	if (m_bDone)
+	{
+		if (nLen)
+			m_bReuse = false ;
+		return 0 ;
+	}
+
+	switch	(m_eMode)
+	{
+	case RELAY_CLOSE:
+		m_nSize += nLen ;
+		return nLen ;
+
+	case RELAY_LENGTH:
+		if (nLen >= m_nLeft)
+		{
+			if (nLen > m_nLeft)
+				m_bReuse = false ;
+			nLen = m_nLeft ;
+			m_bDone = true ;
+		}
+		m_nLeft -= nLen ;
+		return nLen ;
+
+	default:
+		break ;
+	}
+
+	//	Chunked body
+	for (n = 0 ; n < nLen && !m_bDone ;)
+	{
+		if (m_eChunk == RCH_DATA)
+		{
+			nData = nLen - n ;
+			if (nData > m_nLeft)
+				nData = m_nLeft ;
+			n += nData ;
+			m_nLeft -= nData ;
+			if (!m_nLeft)
+				m_eChunk = RCH_DATAEND ;
+			continue ;
+		}
+
+		c = pBuf[n++] ;
+
+		switch	(m_eChunk)
+		{
+		case RCH_SIZE:
+			if (IsHex(c))
+			{
+				if (m_nLeft > 0x07ffffff)
+					m_bBad = true ;
+				m_nLeft = (m_nLeft << 4) | (IsDigit(c) ? c - '0' : (c | 0x20) - 'a' + 10) ;
+				break ;
+			}
+			m_eChunk = RCH_EXT ;
+
+			//	Fall through
+		case RCH_EXT:
+			if (c == CHAR_NL)
+				{ m_eChunk = m_nLeft ? RCH_DATA : RCH_TRAILER ; m_nLine = 0 ; }
+			break ;
+
+		case RCH_DATAEND:
+			if (c == CHAR_NL)
+				{ m_eChunk = RCH_SIZE ; m_nLeft = 0 ; }
+			break ;
+
+		case RCH_TRAILER:
+			if (c == CHAR_NL)
+			{
+				if (!m_nLine)
+					m_bDone = true ;
+				m_nLine = 0 ;
+			}
+			else if (c != CHAR_CR)
+				m_nLine++ ;
+			break ;
+
+		default:
+			break ;
+		}
+	}
+
+	if (n < nLen)
+		m_bReuse = false ;
+	m_nSize += n ;
+	return n ;
+}
+
+int32_t	_hzRelay::Pull	(char* pBuf, uint32_t nMax)
+{
+	//	Receive more of the body from the upstream server. Until the source is handed to the client connection, this blocks until something arrives or the
+	//	receive timeout of the connection expires. Thereafter the socket is non-blocking and where nothing has arrived, m_bWait is set.
+	//
+	//	Arguments:	1)	pBuf	Buffer to receive into
+	//				2)	nMax	Size of buffer
+	//
+	//	Returns:	Number of body bytes received (0 if the body is complete or nothing has arrived)
+	//				-1	If the connection failed or timed out before the body was complete, or the chunked body was malformed
+
+	int32_t		nRecv ;		//	Bytes received
+
+	m_bWait = false ;
+
+	if (m_bDone)
+		return 0 ;
+
+	//	Where the length is known, read no further than the end of the body
+	if (m_eMode == RELAY_LENGTH && nMax > m_nLeft)
+		nMax = m_nLeft ;
+
+	do
+		nRecv = recv(m_pConn->Sock(), pBuf, nMax, 0) ;
+	while (nRecv < 0 && errno == EINTR) ;
+
+	if (nRecv < 0)
+	{
+		if (m_bNoBlock && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{ m_bWait = true ; return 0 ; }
+		return -1 ;
+	}
+
+	if (nRecv == 0)
+	{
+		//	Closure of the connection only ends the body where nothing else does
+		if (m_eMode != RELAY_CLOSE)
+			return -1 ;
+		m_bDone = true ;
+		return 0 ;
+	}
+
+	nRecv = Scan(pBuf, nRecv) ;
+	return m_bBad ? -1 : nRecv ;
+}
+
+hzEcode	_hzRelay::Stream	(void)
+{
+	//	Make the upstream socket non-blocking, as the source is about to be handed to the client connection and further receives are made by the serving loop
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	E_NOSOCKET	If the socket flags could not be set
+	//				E_OK		If the socket is now non-blocking
+
+	int32_t	flags ;		//	Socket flags
+
+	flags = fcntl(m_pConn->Sock(), F_GETFL, 0) ;
+	if (flags == -1 || fcntl(m_pConn->Sock(), F_SETFL, flags | O_NONBLOCK) == -1)
+		return E_NOSOCKET ;
+
+	m_bNoBlock = true ;
+	return E_OK ;
+}
+
+hzEcode	_hzRelay::Fill	(hzPktQue& Q, uint32_t nMax)
+{
+	//	Receive up to nMax bytes (limited to HZ_OUT_CHUNK) of the body from the upstream server and append them to the queue
+	//
+	//	Arguments:	1)	Q		The outgoing queue
+	//				2)	nMax	Bytes wanted
+	//
+	//	Returns:	E_NODATA	If the body has been relayed in full
+	//				E_RECVFAIL	If the body could not be received
+	//				E_OK		If data was queued, or none has arrived as yet (WaitSock then gives the socket to poll)
+
+	char	buf[HZ_OUT_CHUNK] ;		//	Receive buffer
+	int32_t	nRecv ;					//	Body bytes received
+
+	if (nMax > HZ_OUT_CHUNK)
+		nMax = HZ_OUT_CHUNK ;
+
+	nRecv = Pull(buf, nMax) ;
+	if (nRecv < 0)
+	{
+		threadLog("_hzRelay::Fill. Upstream %s:%u failed part way through a response\n", *m_pUp->Host(), m_pUp->Port()) ;
+		return E_RECVFAIL ;
+	}
+
+	if (nRecv)
+		Q.Push(buf, nRecv) ;
+	return m_bDone ? E_NODATA : E_OK ;
+}
+
+/*
+**	hzUpstream members
+*/
+
+hzUpstream::hzUpstream	(const hzString& host, uint32_t nPort, uint32_t nTimeout)
+{
+	m_Host = host ;
+	m_nPort = nPort ;
+	m_nTimeout = nTimeout ;
+	m_nIdle = m_nActive = m_nFails = m_nDownAt = 0 ;
+	m_nRequests = m_nErrors = m_nConnects = 0 ;
+	memset(m_Idle, 0, sizeof(m_Idle)) ;
+}
+
+hzUpstream::~hzUpstream	(void)
+{
+	for (; m_nIdle ; m_nIdle--)
+		delete m_Idle[m_nIdle-1] ;
+}
+
+hzTcpClient*	hzUpstream::Take	(bool& bReused)
+{
+	//	Obtain a connection to the upstream server for a request. An idle connection is used if there is one the upstream server has not closed in the mean
+	//	time (it will then read as at end of file), otherwise a new connection is made.
+	//
+	//	Arguments:	1)	bReused		Set true if the connection is an idle one, false if it is new
+	//
+	//	Returns:	Pointer to the connection
+	//				NULL	If the upstream server could not be connected to
+
+	_hzfunc("hzUpstream::Take") ;
+
+	hzTcpClient*	pConn ;		//	Connection
+	int32_t			nPeek ;		//	Return from recv()
+	char			c ;			//	Peeked byte
+
+	bReused = false ;
+
+	for (;;)
+	{
+		pConn = 0 ;
+
+		if (_hzGlobal_MT)
+			m_Lock.Lock() ;
+		if (m_nIdle)
+			pConn = m_Idle[--m_nIdle] ;
+		if (_hzGlobal_MT)
+			m_Lock.Unlock() ;
+
+		if (!pConn)
+			break ;
+
+		//	An idle connection should have nothing to read
+		nPeek = recv(pConn->Sock(), &c, 1, MSG_PEEK | MSG_DONTWAIT) ;
+		if (nPeek < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{ bReused = true ; break ; }
+		delete pConn ;
+	}
+
+	if (!pConn)
+	{
+		pConn = new hzTcpClient() ;
+		if (pConn->ConnectStd(*m_Host, m_nPort, m_nTimeout, m_nTimeout) != E_OK)
+		{
+			hzerr(_fn, HZ_WARNING, E_HOSTFAIL, "Could not connect to upstream %s:%u", *m_Host, m_nPort) ;
+			delete pConn ;
+			return 0 ;
+		}
+		__sync_add_and_fetch(&m_nConnects, 1) ;
+	}
+
+	__sync_add_and_fetch(&m_nActive, 1) ;
+	return pConn ;
+}
+
+void	hzUpstream::Give	(hzTcpClient* pConn, bool bReuse)
+{
+	//	Return a connection obtained by Take() once the request is complete. It is kept for reuse if possible, otherwise closed.
+	//
+	//	Arguments:	1)	pConn	The connection
+	//				2)	bReuse	True if the response was received in full and the connection remains open
+	//
+	//	Returns:	None
+
+	if (!pConn)
+		return ;
+
+	__sync_sub_and_fetch(&m_nActive, 1) ;
+
+	if (bReuse)
+	{
+		if (_hzGlobal_MT)
+			m_Lock.Lock() ;
+		if (m_nIdle < HZ_PROXY_IDLE)
+			{ m_Idle[m_nIdle++] = pConn ; pConn = 0 ; }
+		if (_hzGlobal_MT)
+			m_Lock.Unlock() ;
+	}
+
+	if (pConn)
+		delete pConn ;
+}
+
+void	hzUpstream::Failed	(bool bChecking)
+{
+	//	Note a failure of the upstream server, either to respond to a request or a health check. After HZ_PROXY_FAILS successive failures the server is taken
+	//	out of service. Where health checks are not running, each failure of a retry puts off the next retry.
+	//
+	//	Arguments:	1)	bChecking	True if health checks are running
+	//
+	//	Returns:	None
+
+	if (__sync_add_and_fetch(&m_nFails, 1) < HZ_PROXY_FAILS)
+		return ;
+
+	if (!m_nDownAt)
+		threadLog("hzUpstream::Failed. Upstream %s:%u taken out of service\n", *m_Host, m_nPort) ;
+
+	if (!m_nDownAt || !bChecking)
+		m_nDownAt = time(0) ;
+}
+
+void	hzUpstream::Succeeded	(void)
+{
+	//	Note a successful response from the upstream server, returning it to service if it was out of service
+
+	m_nFails = 0 ;
+
+	if (m_nDownAt)
+	{
+		m_nDownAt = 0 ;
+		threadLog("hzUpstream::Succeeded. Upstream %s:%u returned to service\n", *m_Host, m_nPort) ;
+	}
+}
+
+bool	hzUpstream::Available	(bool bChecking) const
+{
+	//	Determine if requests may be routed to the upstream server
+	//
+	//	Arguments:	1)	bChecking	True if health checks are running (only a check can then return a server to service)
+	//
+	//	Returns:	True	If the server is in service or is due to be retried
+	//				False	Otherwise
+
+	if (!m_nDownAt)
+		return true ;
+	if (bChecking)
+		return false ;
+	return (time(0) - m_nDownAt) >= HZ_PROXY_RETRY ? true : false ;
+}
+
+bool	hzUpstream::Check	(const hzString& host, const hzString& path)
+{
+	//	Perform a health check on the upstream server. This is a GET request for the given resource on a new connection. The server passes if it answers with
+	//	a 2xx or 3xx status.
+	//
+	//	Arguments:	1)	host	Hostname for the Host header (the upstream server if blank)
+	//				2)	path	The resource to request
+	//
+	//	Returns:	True	If the server passed
+	//				False	Otherwise
+
+	hzTcpClient	conn ;			//	Connection to upstream server
+	hzChain		Req ;			//	Request
+	char		buf[16] ;		//	Start of status line
+	uint32_t	nHave = 0 ;		//	Bytes of status line received
+	int32_t		nRecv ;			//	Return from recv()
+	bool		bPass = false ;	//	Result
+
+	if (conn.ConnectStd(*m_Host, m_nPort, m_nTimeout, m_nTimeout) == E_OK)
+	{
+		Req.Printf("GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n", *path, !host ? *m_Host : *host) ;
+
+		if (_sendall(conn.Sock(), Req) == E_OK)
+		{
+			for (; nHave < 12 ; nHave += nRecv)
+			{
+				nRecv = recv(conn.Sock(), buf + nHave, 12 - nHave, 0) ;
+				if (nRecv <= 0)
+					break ;
+			}
+
+			if (nHave == 12 && !memcmp(buf, "HTTP/1.", 7) && (buf[9] == '2' || buf[9] == '3'))
+				bPass = true ;
+		}
+	}
+
+	if (bPass)
+		Succeeded() ;
+	else
+		Failed(true) ;
+	return bPass ;
+}
+
+/*
+**	hzUpstreamPool members
+*/
+
+hzUpstreamPool::hzUpstreamPool	(const hzString& name, hzBalance eMode, uint32_t nTimeout)
+{
+	m_Servers.SetMode(HZ_STORE_CONTIG) ;
+	m_Name = name ;
+	m_eMode = eMode ;
+	m_nTimeout = nTimeout ;
+	m_nNext = 0 ;
+}
+
+hzUpstreamPool::~hzUpstreamPool	(void)
+{
+	uint32_t	n ;		//	Server iterator
+
+	for (n = 0 ; n < m_Servers.Count() ; n++)
+		delete m_Servers[n] ;
+}
+
+hzEcode	hzUpstreamPool::AddServer	(const hzString& host, uint32_t nPort)
+{
+	//	Add an upstream server to the pool
+	//
+	//	Arguments:	1)	host	Hostname or IP address
+	//				2)	nPort	Port
+	//
+	//	Returns:	E_ARGUMENT	If the host or port is not supplied
+	//				E_DUPLICATE	If the server is already in the pool
+	//				E_OK		If the server was added
+
+	_hzfunc("hzUpstreamPool::AddServer") ;
+
+	hzUpstream*	pUp ;	//	Upstream server
+	uint32_t	n ;		//	Server iterator
+
+	if (!host || !nPort)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Pool %s: No host or port supplied", *m_Name) ;
+
+	for (n = 0 ; n < m_Servers.Count() ; n++)
+	{
+		pUp = m_Servers[n] ;
+		if (pUp->Host() == host && pUp->Port() == nPort)
+			return hzerr(_fn, HZ_ERROR, E_DUPLICATE, "Pool %s: Server %s:%u already added", *m_Name, *host, nPort) ;
+	}
+
+	pUp = new hzUpstream(host, nPort, m_nTimeout) ;
+	return m_Servers.Add(pUp) ;
+}
+
+hzUpstream*	hzUpstreamPool::Select	(bool bChecking)
+{
+	//	Choose the upstream server for a request. In round robin mode this is the next server in turn that is in service. In least connections mode it is the
+	//	server in service with the fewest requests in progress, ties being broken in turn so that idle servers share the load.
+	//
+	//	Arguments:	1)	bChecking	True if health checks are running
+	//
+	//	Returns:	Pointer to the upstream server
+	//				NULL	If no server in the pool is in service
+
+	hzUpstream*	pUp ;			//	Upstream server
+	hzUpstream*	pBest = 0 ;		//	Least busy server
+	uint32_t	nCount ;		//	Number of servers
+	uint32_t	nStart ;		//	Position to start from
+	uint32_t	n ;				//	Server iterator
+
+	nCount = m_Servers.Count() ;
+	if (!nCount)
+		return 0 ;
+
+	nStart = __sync_fetch_and_add(&m_nNext, 1) ;
+
+	for (n = 0 ; n < nCount ; n++)
+	{
+		pUp = m_Servers[(nStart + n) % nCount] ;
+		if (!pUp->Available(bChecking))
+			continue ;
+
+		if (m_eMode == HZ_BALANCE_ROUNDROBIN)
+			return pUp ;
+
+		if (!pBest || pUp->Active() < pBest->Active())
+			pBest = pUp ;
+	}
+
+	return pBest ;
+}
+
+/*
+**	hzHttpProxy members
+*/
+
+hzHttpProxy::hzHttpProxy	(void)
+{
+	m_nInterval = 0 ;
+}
+
+hzHttpProxy::~hzHttpProxy	(void)
+{
+	uint32_t	n ;		//	Route/pool iterator
+
+	for (n = 0 ; n < m_Routes.Count() ; n++)
+		delete m_Routes[n] ;
+	for (n = 0 ; n < m_Pools.Count() ; n++)
+		delete m_Pools[n] ;
+}
+
+hzHttpProxy*	hzHttpProxy::GetInstance	(void)
+{
+	//	Obtain the one and only proxy, creating it on the first call
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	Pointer to the hzHttpProxy instance
+
+	if (!s_pTheProxy)
+		s_pTheProxy = new hzHttpProxy() ;
+	return s_pTheProxy ;
+}
+
+hzUpstreamPool*	hzHttpProxy::AddPool	(const hzString& name, hzBalance eMode, uint32_t nTimeout)
+{
+	//	Add a pool of upstream servers. The servers are then added by hzUpstreamPool::AddServer.
+	//
+	//	Arguments:	1)	name		Pool name (as given to AddRoute)
+	//				2)	eMode		Balancing mode
+	//				3)	nTimeout	Timeout of upstream sends and receives (seconds)
+	//
+	//	Returns:	Pointer to the new pool
+	//				NULL	If the name is not supplied or a pool of the name already exists
+
+	_hzfunc("hzHttpProxy::AddPool") ;
+
+	hzUpstreamPool*	pPool ;		//	New pool
+
+	if (!name)
+		{ hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No pool name supplied") ; return 0 ; }
+	if (GetPool(name))
+		{ hzerr(_fn, HZ_ERROR, E_DUPLICATE, "Pool %s already exists", *name) ; return 0 ; }
+
+	pPool = new hzUpstreamPool(name, eMode, nTimeout ? nTimeout : HZ_PROXY_TIMEOUT) ;
+	m_Pools.Add(pPool) ;
+	return pPool ;
+}
+
+hzUpstreamPool*	hzHttpProxy::GetPool	(const hzString& name) const
+{
+	//	Find a pool by name
+	//
+	//	Arguments:	1)	name	Pool name
+	//
+	//	Returns:	Pointer to the pool
+	//				NULL	If there is no pool of the name
+
+	uint32_t	n ;		//	Pool iterator
+
+	for (n = 0 ; n < m_Pools.Count() ; n++)
+	{
+		if (m_Pools[n]->Name() == name)
+			return m_Pools[n] ;
+	}
+	return 0 ;
+}
+
+hzEcode	hzHttpProxy::AddRoute	(const hzString& host, const hzString& prefix, const hzString& poolName)
+{
+	//	Route requests for the given hostname and/or URL prefix to a pool. The routes are kept in order of precedence, so that a request is routed by the most
+	//	specific route that matches it. Routes naming a host precede those that do not, and among these, routes with longer prefixes precede those with shorter
+	//	prefixes.
+	//
+	//	Arguments:	1)	host		Hostname (blank for any)
+	//				2)	prefix		URL prefix (blank for any)
+	//				3)	poolName	Name of pool
+	//
+	//	Returns:	E_NOTFOUND	If the pool does not exist
+	//				E_DUPLICATE	If the route has already been added
+	//				E_OK		If the route was added
+
+	_hzfunc("hzHttpProxy::AddRoute") ;
+
+	_route*		pR ;		//	New route
+	_route*		pX ;		//	Existing route
+	uint32_t	n ;			//	Route iterator
+
+	pR = new _route() ;
+	pR->m_Host = host ;
+	pR->m_Prefix = prefix ;
+	pR->m_pPool = GetPool(poolName) ;
+
+	if (!pR->m_pPool)
+	{
+		delete pR ;
+		return hzerr(_fn, HZ_ERROR, E_NOTFOUND, "No such pool as %s", *poolName) ;
+	}
+
+	for (n = 0 ; n < m_Routes.Count() ; n++)
+	{
+		pX = m_Routes[n] ;
+
+		if (pX->m_Host == host && pX->m_Prefix == prefix)
+		{
+			delete pR ;
+			return hzerr(_fn, HZ_ERROR, E_DUPLICATE, "Route %s%s already added", *host, *prefix) ;
+		}
+
+		if (!pX->m_Host && !!host)
+			break ;
+		if (!pX->m_Host == !host && pX->m_Prefix.Length() < prefix.Length())
+			break ;
+	}
+
+	return m_Routes.Insert(pR, n) ;
+}
+
+hzEcode	hzHttpProxy::StartChecks	(const hzString& host, const hzString& path, uint32_t nInterval)
+{
+	//	Start health checks of all upstream servers. These are run in a thread of their own, which requests the given resource from each server in turn every
+	//	nInterval seconds. Once checks are running, a server taken out of service is only returned to service by passing a check.
+	//
+	//	Arguments:	1)	host		Hostname for the Host header of the checks (the upstream server if blank)
+	//				2)	path		Resource to request (e.g. /health)
+	//				3)	nInterval	Seconds between checks
+	//
+	//	Returns:	E_ARGUMENT	If the resource or the interval is not supplied
+	//				E_SEQUENCE	If the checks are already running
+	//				E_INITFAIL	If the thread could not be started
+	//				E_OK		If the checks were started
+
+	_hzfunc("hzHttpProxy::StartChecks") ;
+
+	pthread_attr_t	tattr ;		//	Thread attribute
+	pthread_t		tid ;		//	Thread id
+
+	if (!path || (*path)[0] != CHAR_FWSLASH || !nInterval)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "A resource path and an interval are required") ;
+	if (m_nInterval)
+		return hzerr(_fn, HZ_ERROR, E_SEQUENCE, "Health checks already running") ;
+
+	m_CheckHost = host ;
+	m_CheckPath = path ;
+	m_nInterval = nInterval ;
+
+	pthread_attr_init(&tattr) ;
+	pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED) ;
+	if (pthread_create(&tid, &tattr, &_checker, this))
+	{
+		m_nInterval = 0 ;
+		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "Could not start health check thread (errno %d)", errno) ;
+	}
+
+	return E_OK ;
+}
+
+void*	hzHttpProxy::_checker	(void* pVoid)
+{
+	//	Main function of the health check thread (see StartChecks)
+	//
+	//	Arguments:	1)	pVoid	The proxy
+	//
+	//	Returns:	None (does not return)
+
+	hzProcess		_theChecker ;		//	Thread initializer
+	hzHttpProxy*	pProxy ;			//	The proxy
+	hzUpstreamPool*	pPool ;				//	Pool being checked
+	uint32_t		nPool ;				//	Pool iterator
+	uint32_t		nSvr ;				//	Server iterator
+
+	pProxy = (hzHttpProxy*) pVoid ;
+
+	for (;;)
+	{
+		for (nPool = 0 ; nPool < pProxy->m_Pools.Count() ; nPool++)
+		{
+			pPool = pProxy->m_Pools[nPool] ;
+			for (nSvr = 0 ; nSvr < pPool->Count() ; nSvr++)
+				pPool->Server(nSvr)->Check(pProxy->m_CheckHost, pProxy->m_CheckPath) ;
+		}
+
+		sleep(pProxy->m_nInterval) ;
+	}
+
+	return pVoid ;
+}
+
+hzUpstreamPool*	hzHttpProxy::Route	(hzHttpEvent* pE) const
+{
+	//	Find the pool to which a request is to be relayed, if any
+	//
+	//	Arguments:	1)	pE	The HTTP event
+	//
+	//	Returns:	Pointer to the pool
+	//				NULL	If no route matches the request
+
+	_route*		pR ;		//	Route
+	const char*	cpHost ;	//	Requested host
+	const char*	cpPath ;	//	Requested resource
+	uint32_t	n ;			//	Route iterator
+
+	if (!pE)
+		return 0 ;
+
+	cpHost = pE->Hostname() ;
+	cpPath = pE->GetResource() ;
+
+	for (n = 0 ; n < m_Routes.Count() ; n++)
+	{
+		pR = m_Routes[n] ;
+
+		if (!!pR->m_Host && (!cpHost || strcasecmp(cpHost, *pR->m_Host)))
+			continue ;
+		if (!!pR->m_Prefix && (!cpPath || strncmp(cpPath, *pR->m_Prefix, pR->m_Prefix.Length())))
+			continue ;
+		return pR->m_pPool ;
+	}
+
+	return 0 ;
+}
+
+hzEcode	hzHttpProxy::_upstream	(bool& bClose, hzHttpEvent* pE, hzUpstream* pUp, const hzChain& Req, const hzChain& Body)
+{
+	//	Relay a request to an upstream server and its response to the client. The response header is read and rewritten here, as is the body up to a size of
+	//	HZ_PROXY_BUFFER. Any remainder is relayed as the client takes it by an output source (_hzRelay), which will return the upstream connection for reuse
+	//	on completion.
+	//
+	//	Where a persistent connection turns out to have been closed by the upstream server (nothing is received in response), the request is sent again on a
+	//	new connection, unless it is a POST which the upstream server may have acted upon.
+	//
+	//	Arguments:	1)	bClose	Set true if the client connection is to be closed after the response
+	//				2)	pE		The HTTP event
+	//				3)	pUp		The upstream server
+	//				4)	Req		The rewritten request header
+	//				5)	Body	The request body
+	//
+	//	Returns:	E_HOSTFAIL	If the upstream server could not be connected to
+	//				E_SENDFAIL	If the request could not be sent
+	//				E_RECVFAIL	If the response was not received. Nothing has been sent to the client.
+	//				E_PROTOCOL	If the response header was malformed or too large
+	//				E_WRITEFAIL	If the response could not be sent to the client
+	//				E_OK		If the response was relayed
+
+	_hzfunc("hzHttpProxy::_upstream") ;
+
+	hzChain			Out ;			//	Response header to client
+	hzChain			Z ;				//	Response body read so far
+	hzTcpClient*	pConn ;			//	Upstream connection
+	_hzRelay*		pSrc ;			//	Relay of response body
+	const char*		pLine ;			//	Header line
+	const char*		pNext ;			//	Next header line
+	const char*		pEnd ;			//	End of header
+	const char*		pName ;			//	Header name
+	const char*		pVal ;			//	Header value
+	_hzRelayMode	eMode ;			//	How the end of the body is known
+	uint32_t		nName ;			//	Length of header name
+	uint32_t		nVal ;			//	Length of header value
+	uint32_t		nHave ;			//	Bytes received
+	uint32_t		nHdr ;			//	Length of response header
+	uint32_t		nLen = 0 ;		//	Content-Length of response
+	uint32_t		nStatus ;		//	Response status
+	uint32_t		nTry ;			//	Attempts
+	int32_t			nRecv ;			//	Return from recv()
+	bool			bReused ;		//	Connection was an idle one
+	bool			bLength ;		//	Response has a Content-Length
+	bool			bChunked ;		//	Response is chunked
+	bool			bKeep ;			//	Upstream server will keep the connection open
+	hzEcode			rc ;			//	Return code
+	char			buf[HZ_PROXY_HDRMAX] ;	//	Receive buffer
+
+	bClose = false ;
+
+	for (nTry = 0 ;; nTry++)
+	{
+		pConn = pUp->Take(bReused) ;
+		if (!pConn)
+			return E_HOSTFAIL ;
+
+		rc = _sendall(pConn->Sock(), Req) ;
+		if (rc == E_OK && Body.Size())
+			rc = _sendall(pConn->Sock(), Body) ;
+
+		//	Receive the response header
+		nHave = nHdr = 0 ;
+		if (rc == E_OK)
+		{
+			rc = E_RECVFAIL ;
+			while (nHave < HZ_PROXY_HDRMAX)
+			{
+				nRecv = recv(pConn->Sock(), buf + nHave, HZ_PROXY_HDRMAX - nHave, 0) ;
+				if (nRecv < 0 && errno == EINTR)
+					continue ;
+				if (nRecv <= 0)
+					break ;
+				nHave += nRecv ;
+
+				for (pLine = buf ; (pNext = HttpScan(pLine, buf + nHave, CHAR_NL)) ; pLine = pNext + 1)
+				{
+					if (pNext == pLine || (pNext == pLine + 1 && pLine[0] == CHAR_CR))
+						{ nHdr = (pNext + 1) - buf ; break ; }
+				}
+
+				if (nHdr)
+					{ rc = E_OK ; break ; }
+			}
+
+			if (nHave == HZ_PROXY_HDRMAX)
+				rc = E_PROTOCOL ;
+		}
+
+		if (rc == E_OK)
+			break ;
+
+		pUp->Give(pConn, false) ;
+		if (bReused && !nHave && pE->Method() != HTTP_POST && nTry < HZ_PROXY_IDLE)
+			continue ;
+		return rc ;
+	}
+
+	//	Parse the status line
+	if (nHdr < 12 || memcmp(buf, "HTTP/1.", 7))
+	{
+		pUp->Give(pConn, false) ;
+		return E_PROTOCOL ;
+	}
+	nStatus = atoi(buf + 9) ;
+	bKeep = buf[7] == '1' ? true : false ;
+	bLength = bChunked = false ;
+
+	pEnd = buf + nHdr ;
+	pLine = HttpScan(buf, pEnd, CHAR_NL) + 1 ;
+	Out.Append(buf, pLine - buf) ;
+
+	//	Relay the headers, other than those of the upstream connection
+	for (; pLine < pEnd ; pLine = pNext)
+	{
+		pNext = _hdrfield(pName, nName, pVal, nVal, pLine, pEnd) ;
+		if (!nName)
+			continue ;
+
+		if (_hopbyhop(pName, nName))
+		{
+			if (HttpHeaderId(pName, nName) == HTTP_HDR_CONNECTION)
+			{
+				if (_hastoken(pVal, nVal, "close"))
+					bKeep = false ;
+				else if (_hastoken(pVal, nVal, "keep-alive"))
+					bKeep = true ;
+			}
+			continue ;
+		}
+
+		switch	(HttpHeaderId(pName, nName))
+		{
+		case HTTP_HDR_CONTENT_LENGTH:		bLength = true ; nLen = atoi(pVal) ;				break ;
+		case HTTP_HDR_TRANSFER_ENCODING:	bChunked = _hastoken(pVal, nVal, "chunked") ;		break ;
+		default:
+			break ;
+		}
+
+		Out.Append(pLine, pNext - pLine) ;
+	}
+
+	//	Establish how the end of the body will be known
+	if (pE->Method() == HTTP_HEAD || nStatus < 200 || nStatus == 204 || nStatus == 304)
+		eMode = RELAY_NONE ;
+	else if (bChunked)
+		eMode = RELAY_CHUNKED ;
+	else if (bLength)
+		eMode = RELAY_LENGTH ;
+	else
+		eMode = RELAY_CLOSE ;
+
+	bClose = !pE->Connection() || eMode == RELAY_CLOSE ? true : false ;
+	if (bClose)
+		Out << "Connection: close\r\n" ;
+	else
+	{
+		Out << "Connection: keep-alive\r\n" ;
+		Out.Printf("Keep-Alive: timeout=%u\r\n", pE->Connection()) ;
+	}
+	Out << "\r\n" ;
+
+	pUp->Succeeded() ;
+	__sync_add_and_fetch(&pUp->m_nRequests, 1) ;
+
+	//	Read the body up to HZ_PROXY_BUFFER. Nothing has been sent to the client so far, so a failure here can still be answered with an error.
+	pSrc = new _hzRelay(pUp, pConn, eMode, nLen, bKeep) ;
+	Z.Append(buf + nHdr, pSrc->Scan(buf + nHdr, nHave - nHdr)) ;
+
+	while (!pSrc->Done() && Z.Size() < HZ_PROXY_BUFFER)
+	{
+		nRecv = pSrc->Pull(buf, HZ_PROXY_HDRMAX) ;
+		if (nRecv < 0)
+		{
+			delete pSrc ;
+			return E_RECVFAIL ;
+		}
+		Z.Append(buf, nRecv) ;
+	}
+
+	if (pSrc->Done())
+	{
+		delete pSrc ;
+		rc = pE->GetConnex()->SendData(Out, Z) ;
+	}
+	else
+	{
+		if (pSrc->Stream() != E_OK)
+		{
+			delete pSrc ;
+			return E_RECVFAIL ;
+		}
+		Out += Z ;
+		rc = pE->GetConnex()->SendStream(Out, pSrc) ;
+	}
+
+	if (rc != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Response from %s:%u not sent to client (sock=%d)", *pUp->Host(), pUp->Port(), pE->CliSocket()) ;
+	return E_OK ;
+}
+
+hzTcpCode	hzHttpProxy::Relay	(hzHttpEvent* pE, hzUpstreamPool* pPool)
+{
+	//	Relay a request to a server of the given pool (as found by Route) and the response back to the client. If the chosen server cannot be connected to, or
+	//	does not respond to a request other than a POST, the request is tried on another server of the pool. Where no server responds, the client is sent a
+	//	502 (Bad Gateway) response, or a 503 (Service Unavailable) response if no server in the pool is in service.
+	//
+	//	Arguments:	1)	pE		The HTTP event
+	//				2)	pPool	The pool
+	//
+	//	Returns:	TCP_KEEPALIVE	If the client connection is to be kept open
+	//				TCP_TERMINATE	If the client connection is to be closed
+
+	_hzfunc("hzHttpProxy::Relay") ;
+
+	hzChain			Hdr ;			//	Request header as received
+	hzChain			Body ;			//	Request body
+	hzChain			Req ;			//	Request header to upstream server
+	hzChain::Iter	zi ;			//	Header iterator
+	hzIpConnex*		pCx ;			//	Client connection
+	hzUpstream*		pUp ;			//	Upstream server
+	const char*		pLine ;			//	Header line
+	const char*		pNext ;			//	Next header line
+	const char*		pEnd ;			//	End of header
+	const char*		pName ;			//	Header name
+	const char*		pVal ;			//	Header value
+	const char*		pFwrd = 0 ;		//	X-Forwarded-For value received
+	uint32_t		nName ;			//	Length of header name
+	uint32_t		nVal ;			//	Length of header value
+	uint32_t		nFwrd = 0 ;		//	Length of X-Forwarded-For value
+	uint32_t		nLen ;			//	Length of header
+	uint32_t		nTry ;			//	Servers tried
+	bool			bFwrdHost ;		//	X-Forwarded-Host received
+	bool			bTried = false ;	//	A server was tried
+	bool			bLength ;		//	Content-Length received
+	bool			bClose ;		//	Close client connection after response
+	hzEcode			rc ;			//	Return code
+	char			buf[HZ_MAX_HTTP_HDR + 4] ;	//	Request header (contiguous)
+
+	if (!pE || !(pCx = pE->GetConnex()))
+		return TCP_TERMINATE ;
+
+	if (!pPool)
+	{
+		pE->SendError(HTTPMSG_NOTFOUND, "No route for %s", pE->GetResource()) ;
+		return pE->Connection() ? TCP_KEEPALIVE : TCP_TERMINATE ;
+	}
+
+	rc = pE->RawRequest(Hdr, Body) ;
+	if (rc != E_OK)
+	{
+		pCx->m_Track.ErrorS("Relay: Request cannot be relayed (%s)", Err2Txt(rc)) ;
+		pE->SendError(HTTPMSG_NOT_IMPLEMENTED, "This request cannot be relayed to the server") ;
+		return TCP_TERMINATE ;
+	}
+
+	//	Rewrite the request header
+	zi = Hdr ;
+	nLen = Hdr.Size() ;
+	if (!nLen || nLen > HZ_MAX_HTTP_HDR)
+		return TCP_TERMINATE ;
+	zi.Write(buf, nLen) ;
+	pEnd = buf + nLen ;
+
+	pLine = HttpScan(buf, pEnd, CHAR_NL) ;
+	if (!pLine)
+		return TCP_TERMINATE ;
+	pLine++ ;
+	Req.Append(buf, pLine - buf) ;
+
+	bFwrdHost = bLength = false ;
+	for (; pLine < pEnd ; pLine = pNext)
+	{
+		if (!(pNext = _hdrfield(pName, nName, pVal, nVal, pLine, pEnd)))
+			break ;
+		if (!nName)
+			continue ;
+		if (_hopbyhop(pName, nName))
+			continue ;
+
+		switch	(HttpHeaderId(pName, nName))
+		{
+		case HTTP_HDR_CONTENT_LENGTH:
+		case HTTP_HDR_TRANSFER_ENCODING:
+			bLength = true ;
+			continue ;
+		case HTTP_HDR_X_FORWARDED_FOR:
+			pFwrd = pVal ;
+			nFwrd = nVal ;
+			continue ;
+		case HTTP_HDR_X_FORWARDED_HOST:
+			bFwrdHost = true ;
+			break ;
+		default:
+			break ;
+		}
+
+		Req.Append(pLine, pNext - pLine) ;
+	}
+
+	if (bLength || Body.Size())
+		Req.Printf("Content-Length: %u\r\n", Body.Size()) ;
+	Req << "Connection: keep-alive\r\n" ;
+
+	Req << "X-Forwarded-For: " ;
+	if (nFwrd)
+		{ Req.Append(pFwrd, nFwrd) ; Req << ", " ; }
+	Req << pCx->GetClientIP() << "\r\n" ;
+
+	if (!bFwrdHost && pE->Hostname())
+		Req << "X-Forwarded-Host: " << pE->Hostname() << "\r\n" ;
+	Req << "X-Forwarded-Proto: " << (pCx->IsSecure() ? "https" : "http") << "\r\n\r\n" ;
+
+	//	Relay to a server of the pool, trying another if the first does not respond
+	for (nTry = 0 ; nTry < pPool->Count() ; nTry++)
+	{
+		pUp = pPool->Select(m_nInterval ? true : false) ;
+		if (!pUp)
+			break ;
+
+		bTried = true ;
+		rc = _upstream(bClose, pE, pUp, Req, Body) ;
+		if (rc == E_OK)
+			return bClose ? TCP_TERMINATE : TCP_KEEPALIVE ;
+		if (rc == E_WRITEFAIL)
+			return TCP_TERMINATE ;
+
+		__sync_add_and_fetch(&pUp->m_nErrors, 1) ;
+		pUp->Failed(m_nInterval ? true : false) ;
+		pCx->m_Track.ErrorS("Relay: Upstream on port %u failed (%s)", Err2Txt(rc), pUp->Port()) ;
+
+		if (rc != E_HOSTFAIL && pE->Method() == HTTP_POST)
+			break ;
+	}
+
+	if (!bTried)
+		pE->SendError(HTTPMSG_SERVICE_UNAVAILABLE, "No server is available to handle this request") ;
+	else
+		pE->SendError(HTTPMSG_BAD_GATEWAY, "The server did not respond") ;
+	return pE->Connection() ? TCP_KEEPALIVE : TCP_TERMINATE ;
+}
+
+void	hzHttpProxy::Report	(hzChain& Z) const
+{
+	//	Report the state of the pools and upstream servers, as HTML table rows
+	//
+	//	Arguments:	1)	Z	The chain to append the report to
+	//
+	//	Returns:	None
+
+	hzUpstreamPool*	pPool ;		//	Pool
+	hzUpstream*		pUp ;		//	Upstream server
+	uint32_t		nPool ;		//	Pool iterator
+	uint32_t		nSvr ;		//	Server iterator
+
+	Z << "<tr><th>Pool</th><th>Server</th><th>State</th><th>Active</th><th>Idle</th><th>Requests</th><th>Errors</th><th>Connects</th></tr>\n" ;
+
+	for (nPool = 0 ; nPool < m_Pools.Count() ; nPool++)
+	{
+		pPool = m_Pools[nPool] ;
+
+		for (nSvr = 0 ; nSvr < pPool->Count() ; nSvr++)
+		{
+			pUp = pPool->Server(nSvr) ;
+			Z.Printf("<tr><td>%s</td><td>%s:%u</td><td>%s</td><td>%u</td><td>%u</td><td>%lu</td><td>%lu</td><td>%lu</td></tr>\n",
+				*pPool->Name(), *pUp->Host(), pUp->Port(), pUp->IsDown() ? "down" : "up", pUp->Active(), pUp->Idle(), pUp->m_nRequests, pUp->m_nErrors, pUp->m_nConnects) ;
+		}
+	}
+}
+
+hzTcpCode	ProxyHTTP	(hzHttpEvent* pE)
+{
+	//	Category:	Internet Server
+	//
+	//	HTTP callback function relaying all requests by the routes of the proxy (see hzHttpProxy). This may be given to hzIpServer::AddPortHTTP where the server
+	//	is purely a front to upstream servers. Where only some requests are to be relayed, the application callback should instead call hzHttpProxy::Route and
+	//	where this finds a pool, hzHttpProxy::Relay.
+	//
+	//	Arguments:	1)	pE	The HTTP event
+	//
+	//	Returns:	TCP_KEEPALIVE	If the client connection is to be kept open
+	//				TCP_TERMINATE	If the client connection is to be closed
+
+	hzHttpProxy*	pProxy ;	//	The proxy
+
+	pProxy = hzHttpProxy::GetInstance() ;
+	return pProxy->Relay(pE, pProxy->Route(pE)) ;
+}
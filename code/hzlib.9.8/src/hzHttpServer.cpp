@@ -23,6 +23,7 @@
 
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <netdb.h>
 #include <openssl/ssl.h>
@@ -34,6 +35,7 @@
 #include "hzCodec.h"
 #include "hzDirectory.h"
 #include "hzHttpServer.h"
+#include "hzHttpParse.h"
 #include "hzProcess.h"
 #include "hzDissemino.h"
 
@@ -50,6 +52,54 @@ global	hzMapS<hzString,hzChain*>	s_PageStore ;		//	Stored pages
 
 global	hzString	_hzGlobal_runstart ;				//	Date string (of time of first serve this runtime)
 
+static	hzString	s_uploadDir = "/tmp" ;				//	Directory for temporary files of uploads
+static	uint32_t	s_nUploadSpill = HZ_UPLOAD_SPILL ;	//	Size above which uploaded files are written to temporary files
+
+enum	_mpState
+{
+	//	Category:	Internet
+	//
+	//	Multipart submission parser states (see hzHttpEvent::_mpparse)
+
+	MP_NONE,		//	Not a multipart submission
+	MP_PREAMBLE,	//	Seeking the first delimiter
+	MP_BOUNDARY,	//	Delimiter found, expecting either CR/NL to start the next part or two minus signs to end the submission
+	MP_HEADERS,		//	Reading the headers of a part
+	MP_DATA,		//	Reading the data of a part
+	MP_EPILOGUE		//	All parts received
+} ;
+
+enum	_chState
+{
+	//	Category:	Internet
+	//
+	//	Chunked request body parser states (see hzHttpEvent::_chparse)
+
+	CH_NONE,		//	Request body is not chunked
+	CH_SIZE,		//	Reading the line giving the size of the next chunk
+	CH_DATA,		//	Reading the data of a chunk
+	CH_DATAEND,		//	Expecting the CR/NL ending the data of a chunk
+	CH_TRAILER,		//	Reading trailer lines following the last (zero length) chunk
+	CH_DONE			//	Body complete
+} ;
+
+struct	_pageTag
+{
+	//	Category:	Internet
+	//
+	//	Validators of a page held in the page store (see hzHttpEvent::SendPageE)
+
+	hzString	m_ETag ;	//	Entity tag
+	uint32_t	m_nMtime ;	//	Modification time of file
+
+	_pageTag	(void)	{ m_nMtime = 0 ; }
+} ;
+
+static	hzMapS<hzString,_pageTag>	s_PageTags ;	//	Validators of stored pages
+
+static	__thread hzHttpEvent*	s_pEvPool = 0 ;		//	Free hzHttpEvent instances of this thread (see hzHttpEvent::Acquire)
+static	__thread uint32_t		s_nEvPool = 0 ;		//	Number of free instances
+
 /*
 **	Non member functions
 */
@@ -89,6 +139,132 @@ static	uint32_t	_hexconvert	(char* pStr, uint32_t nLen)
 	return nValue ;
 }
 
+static	uint32_t	_httpdate	(const char* cpDate)
+{
+	//	Convert a HTTP date (as given in If-Modified-Since and If-Range headers) to an epoch time. Only the RFC 1123 form is accepted, as this is the only
+	//	form a client is permitted to send and in practice the only form sent.
+	//
+	//	Arguments:	1)	cpDate	The date string
+	//
+	//	Returns:	Epoch time
+	//				0	If the date is not in the RFC 1123 form
+
+	struct tm	t ;		//	Broken down time
+
+	if (!cpDate || !cpDate[0])
+		return 0 ;
+
+	memset(&t, 0, sizeof(t)) ;
+	if (!strptime(cpDate, "%a, %d %b %Y %H:%M:%S GMT", &t))
+		return 0 ;
+
+	return timegm(&t) ;
+}
+
+static	void	_httpdatestr	(hzChain& Z, uint32_t nEpoch)
+{
+	//	Append an epoch time to the supplied chain as a HTTP date (RFC 1123 form, always GMT)
+	//
+	//	Arguments:	1)	Z		The chain to append to
+	//				2)	nEpoch	The epoch time
+	//
+	//	Returns:	None
+
+	struct tm	t ;			//	Broken down time
+	time_t		tt ;		//	Epoch time
+	char		buf[40] ;	//	Formatted date
+
+	tt = nEpoch ;
+	gmtime_r(&tt, &t) ;
+	strftime(buf, 40, "%a, %d %b %Y %H:%M:%S GMT", &t) ;
+	Z << buf ;
+}
+
+struct	_byteRange
+{
+	//	Category:	Internet
+	//
+	//	A byte range of a static resource (see _ranges)
+
+	uint32_t	m_nStart ;	//	Offset of first byte
+	uint32_t	m_nLen ;	//	Number of bytes
+} ;
+
+static	int32_t	_ranges	(_byteRange* pRanges, const char* cpRange, uint32_t nSize)
+{
+	//	Parse the value of a Range header, of the form bytes=a-b,c-,-n (first to last byte inclusive, first to end, last n bytes) against a resource of the
+	//	given size. Ranges lying beyond the end of the resource are dropped and those overrunning it are cut short.
+	//
+	//	Arguments:	1)	pRanges	Array of at least HZ_HTTP_MAXRANGES ranges, populated by this function
+	//				2)	cpRange	Value of the Range header
+	//				3)	nSize	Size of resource
+	//
+	//	Returns:	-1	If the header is malformed, has more than HZ_HTTP_MAXRANGES ranges or the ranges add up to more than the resource. In all these cases the
+	//					header is to be ignored and the whole resource sent.
+	//				0	If none of the ranges can be satisfied
+	//				Number of ranges otherwise
+
+	const char*	i ;				//	Range iterator
+	uint64_t	nA ;			//	First byte of range (or suffix length)
+	uint64_t	nB ;			//	Last byte of range
+	uint64_t	nTotal = 0 ;	//	Sum of range lengths
+	uint32_t	nCount = 0 ;	//	Number of ranges found
+	int32_t		nRanges = 0 ;	//	Number of satisfiable ranges
+	bool		bFrom ;			//	First byte given
+	bool		bTo ;			//	Last byte given
+
+	if (!cpRange || strncasecmp(cpRange, "bytes=", 6))
+		return -1 ;
+
+	for (i = cpRange + 6 ;;)
+	{
+		for (; *i == CHAR_SPACE || *i == CHAR_TAB ; i++) ;
+
+		nA = nB = 0 ;
+		for (bFrom = false ; IsDigit(*i) && nA < 0xffffffffff ; bFrom = true, i++)
+			nA = (nA * 10) + (*i - '0') ;
+		if (*i != CHAR_MINUS)
+			return -1 ;
+		for (i++, bTo = false ; IsDigit(*i) && nB < 0xffffffffff ; bTo = true, i++)
+			nB = (nB * 10) + (*i - '0') ;
+		if ((!bFrom && !bTo) || (bFrom && bTo && nB < nA))
+			return -1 ;
+
+		if (++nCount > HZ_HTTP_MAXRANGES)
+			return -1 ;
+
+		if (!bFrom)
+		{
+			//	Suffix range (the last nB bytes)
+			if (nB && nSize)
+			{
+				pRanges[nRanges].m_nStart = nB >= nSize ? 0 : nSize - nB ;
+				pRanges[nRanges].m_nLen = nSize - pRanges[nRanges].m_nStart ;
+				nTotal += pRanges[nRanges++].m_nLen ;
+			}
+		}
+		else if (nA < nSize)
+		{
+			if (!bTo || nB >= nSize)
+				nB = nSize - 1 ;
+			pRanges[nRanges].m_nStart = nA ;
+			pRanges[nRanges].m_nLen = nB - nA + 1 ;
+			nTotal += pRanges[nRanges++].m_nLen ;
+		}
+
+		for (; *i == CHAR_SPACE || *i == CHAR_TAB ; i++) ;
+		if (!*i)
+			break ;
+		if (*i != CHAR_COMMA)
+			return -1 ;
+		i++ ;
+	}
+
+	if (nTotal > nSize)
+		return -1 ;
+	return nRanges ;
+}
+
 hzHttpEvent::hzHttpEvent	(hzChain& ZI, hzIpConnex* pCx)
 {
 	m_Occur.SysDateTime() ;
@@ -99,8 +275,11 @@ hzHttpEvent::hzHttpEvent	(hzChain& ZI, hzIpConnex* pCx)
 		m_ClientIP = m_pCx->ClientIP() ;
 	}
 	m_pContextApp = m_pContextLang = m_pContextForm = m_pContextObj = 0 ;
+	m_pPoolNext = 0 ;
 	m_pBuf = 0 ;
+	m_nPartFd = -1 ;
 	Clear() ;
+	_hzGlobal_Memstats.m_numHttpEvents++ ;
 }
 
 hzHttpEvent::hzHttpEvent	(void)
@@ -109,12 +288,16 @@ hzHttpEvent::hzHttpEvent	(void)
 	m_pLog = 0 ;
 	m_pCx = 0 ; 
 	m_pContextApp = m_pContextLang = m_pContextForm = m_pContextObj = 0 ;
+	m_pPoolNext = 0 ;
 	m_pBuf = 0 ;
+	m_nPartFd = -1 ;
 	Clear() ;
+	_hzGlobal_Memstats.m_numHttpEvents++ ;
 }
 
 hzHttpEvent::~hzHttpEvent	(void)
 {
+	_hzGlobal_Memstats.m_numHttpEvents-- ;
 	m_pLog = 0 ;
 	m_pCx = 0 ;
 	m_pSession = 0 ;
@@ -124,28 +307,80 @@ hzHttpEvent::~hzHttpEvent	(void)
 
 void	hzHttpEvent::Clear	(void)
 {
+	uint32_t	n ;		//	Upload iterator
+
 	m_ClientIP.Clear() ;	// = (char*) 0 ;
 
-	if (m_pBuf)
-		delete m_pBuf ;
-	//m_CookieNew = 0 ;
-	//m_CookieOld = 0 ;
+	//	Remove the temporary files of uploads, including that of any part left incomplete
+	if (m_nPartFd >= 0)
+		close(m_nPartFd) ;
+	m_nPartFd = -1 ;
+	if (m_Part.OnDisk())
+		unlink(*m_Part.m_path) ;
+	m_Part.Clear() ;
+
+	for (n = 0 ; n < m_Uploads.Count() ; n++)
+	{
+		if (m_Uploads.GetObj(n).OnDisk())
+			unlink(*m_Uploads.GetObj(n).m_path) ;
+	}
+
+	//	Release the memory of the request in one step
+	m_Arena.Reset() ;
+	m_pBuf = 0 ;
+	m_CookieNew = 0 ;
+	m_CookieOld = 0 ;
 	m_Referer = 0 ;
 	m_Redirect = 0 ;
 	m_Auth = 0 ;
-	//m_CookieSub = 0 ;
+	m_CookieSub = 0 ;
+
+	//	The event is reused for each request on a persistent connection, so data of the last request must not carry over
+	m_mapStrings.Clear() ;
+	m_mapChains.Clear() ;
+	m_Uploads.Clear() ;
+	m_ObjIds.Clear() ;
+	m_Inputs.Empty() ;
+	m_HdrsResponse.Clear() ;
+	m_Resarg = 0 ;
+	m_appError = 0 ;
+	m_Error.Clear() ;
+	m_Report.Clear() ;
 
 	m_pAccept = m_pAcceptCharset = m_pAcceptLang = m_pAcceptCode = m_pCacheControl = m_pConnection = m_pContentType = m_pETag = m_pPragma = 0 ;
+	m_pRange = m_pIfRange = 0 ;
 	m_pUserAgent = m_pProcessor = m_pVia = m_pCliIP = m_pHost = m_pXost = m_pFwrdIP = m_pProxIP = m_pServer = m_pFrom = m_pReferer = 0 ;
 	//m_pReqPATH = m_pReqQURY = m_pReqFRAG = 0 ;
 	m_pReqPATH = m_pReqFRAG = 0 ;
+	m_pUpgrade = m_pWsKey = m_pWsVersion = m_pWsProtocol = 0 ;
 
 	m_LastMod.Clear() ;
+	m_nIfModSince = 0 ;
 	m_CookieExpire.Clear() ;
 
 	m_pSession = 0 ;
 	m_nHeaderLen = 0 ;
 	m_nContentLen = 0 ;
+	m_nConsumed = 0 ;
+	m_nAwait = 0 ;
+	m_nMpState = MP_NONE ;
+	m_bPartFile = false ;
+	m_Boundary.Clear() ;
+	m_Body.Clear() ;
+	m_RawHead.Clear() ;
+	m_pStream = 0 ;
+	m_nChunkLeft = 0 ;
+	m_nChunksOut = 0 ;
+	m_nStreamExp = 0 ;
+	m_eStreamRC = HTTPMSG_OK ;
+	m_eStreamType = HMTYPE_INVALID ;
+	m_nChState = CH_NONE ;
+	m_bChunkOut = false ;
+	m_bStreamZip = false ;
+	m_ETagOut.Clear() ;
+	m_RangeOut.Clear() ;
+	m_RangeSep.Clear() ;
+	m_nModOut = 0 ;
 	m_nQueryLen = 0 ;
 	m_nMaxForwards = 0 ;
 	m_eRetCode = HTTPMSG_OK ;
@@ -153,25 +388,92 @@ void	hzHttpEvent::Clear	(void)
 	m_bHdrComplete = false ;
 	m_bMsgComplete = false ;
 	m_bZipped = false ;
+	m_nCodings = 0 ;
+	m_eCoding = CONTENT_IDENTITY ;
+	m_nVersion = 0 ;
 	m_nConnection = 0 ;
 }
 
-uint32_t	hzHttpEvent::_setnvpairs	(chIter& ci)
+hzHttpEvent*	hzHttpEvent::Acquire	(hzIpConnex* pCx)
+{
+	//	Obtain a hzHttpEvent for a connection on which a request is arriving, from the pool of the calling thread if possible. The pool is private to the thread
+	//	so no locking is needed. An instance acquired by one thread may be released by another, in which case it simply joins the pool of that thread.
+	//
+	//	Arguments:	1)	pCx		The connection
+	//
+	//	Returns:	Pointer to the (clear) HTTP event
+
+	hzHttpEvent*	pE ;	//	The HTTP event
+
+	if (!s_pEvPool)
+		pE = new hzHttpEvent() ;
+	else
+	{
+		pE = s_pEvPool ;
+		s_pEvPool = pE->m_pPoolNext ;
+		pE->m_pPoolNext = 0 ;
+		s_nEvPool-- ;
+		_hzGlobal_Memstats.m_numHttpEvPool-- ;
+	}
+
+	pE->m_pCx = pCx ;
+	pE->m_pLog = pCx ? pCx->GetLogger() : 0 ;
+	pE->m_Occur.SysDateTime() ;
+	return pE ;
+}
+
+void	hzHttpEvent::Release	(hzHttpEvent* pE)
+{
+	//	Return a hzHttpEvent to the pool of the calling thread once the connection has no request in progress. The event is cleared so nothing of the request
+	//	can carry over to another connection. If the pool is full the event is deleted.
+	//
+	//	Arguments:	1)	pE	The HTTP event
+	//
+	//	Returns:	None
+
+	if (!pE)
+		return ;
+
+	pE->Clear() ;
+	pE->m_pCx = 0 ;
+	pE->m_pLog = 0 ;
+	pE->m_pContextApp = pE->m_pContextLang = pE->m_pContextForm = pE->m_pContextObj = 0 ;
+
+	if (s_nEvPool >= HZ_HTTP_EVPOOL)
+		{ delete pE ; return ; }
+
+	pE->m_pPoolNext = s_pEvPool ;
+	s_pEvPool = pE ;
+	s_nEvPool++ ;
+	_hzGlobal_Memstats.m_numHttpEvPool++ ;
+}
+
+uint32_t	hzHttpEvent::_setnvpairs	(chIter& ci, uint32_t nMax)
 {
-	//	Gather up the submitted data as a set of name-value pairs. Advance the supplied iterator to the end of the header.
+	//	Gather up the submitted data as a set of name-value pairs. Advance the supplied iterator to the end of the header. The names and values are decoded
+	//	into a single buffer in the arena, each null terminated. As decoding never lengthens the data and the equal sign and ampersand that end the name and
+	//	value of a pair are replaced by the terminators, a buffer of the raw length (plus two) suffices.
 	//
-	//	Arguments:	1)	ci	Chain iterator to process submission data
+	//	Arguments:	1)	ci		Chain iterator to process submission data
+	//				2)	nMax	Maximum number of bytes to process (the remainder of the header for a query, the content length for a submission)
 	//
 	//	Returns:	Number of places iterator has advanced
 
 	_hzfunc("hzHttpEvent::_setnvpairs") ;
 
-	hzChain		C ;			//	For building names/values
+	hzChain		C ;			//	For values too large to hold as strings
 	hzPair		P ;			//	Name value pair
+	char*		pBuf ;		//	Decoded names and values (in arena)
+	char*		pName ;		//	Start of current name
+	char*		pVal ;		//	Start of current value (0 until the equal sign is found)
+	char*		j ;			//	Next free byte in buffer
 	uint32_t	nCount ;	//	Counter
 	char		hex[4] ;	//	For hex conversion
 
-	for (nCount = 0 ; !ci.eof() && *ci != CHAR_SPACE && *ci != CHAR_HASH ; nCount++, ci++)
+	j = pName = pBuf = (char*) m_Arena.Alloc(nMax + 2) ;
+	pVal = 0 ;
+
+	for (nCount = 0 ; nCount < nMax && !ci.eof() && *ci != CHAR_SPACE && *ci != CHAR_HASH ; nCount++, ci++)
 	{
 		//	Consider hex encoding first
 
@@ -182,31 +484,41 @@ uint32_t	hzHttpEvent::_setnvpairs	(chIter& ci)
 			hex[2] = 0 ;
 			nCount += 2 ;
 
-			C.AddByte(_hexconvert(hex, 2)) ;
+			*j++ = _hexconvert(hex, 2) ;
 			continue ;
 		}
 
 		//	Hex encoding safe
 
-		if (*ci == CHAR_EQUAL)
+		if (*ci == CHAR_EQUAL && !pVal)
 		{
-			P.name = C ;
-			C.Clear() ;
+			*j++ = 0 ;
+			pVal = j ;
 			continue ;
 		}
 
 		if (*ci == CHAR_AMPSAND || *ci <= CHAR_SPACE)
 		{
-			if (C.Size() > 4000)
+			*j++ = 0 ;
+			if (!pVal)
+				{ pVal = pName ; pName = 0 ; }
+
+			if ((j - pVal) > 4001)
+			{
+				P.name = pName ;
+				C.Append(pVal, j - pVal - 1) ;
 				m_mapChains.Insert(P.name, C) ;
+				C.Clear() ;
+			}
 			else
 			{
-				P.value = C ;
+				P.name = pName ;
+				P.value = pVal ;
 				m_Inputs.Add(P) ;
 				m_mapStrings.Insert(P.name, P.value) ;
-				P.Clear() ;
 			}
-			C.Clear() ;
+			pName = j ;
+			pVal = 0 ;
 
 			if (*ci == CHAR_AMPSAND)
 				continue ;
@@ -215,14 +527,19 @@ uint32_t	hzHttpEvent::_setnvpairs	(chIter& ci)
 		}
 
 		if (*ci == CHAR_PLUS)
-			C.AddByte(CHAR_SPACE) ;
+			*j++ = CHAR_SPACE ;
 		else
-			C.AddByte(*ci) ;
+			*j++ = *ci ;
 	}
 
-	if (C.Size())
+	if (pVal ? j > pVal : j > pName)
 	{
-		P.value = C ;
+		*j++ = 0 ;
+		if (!pVal)
+			{ pVal = pName ; pName = 0 ; }
+
+		P.name = pName ;
+		P.value = pVal ;
 		m_Inputs.Add(P) ;
 		m_mapStrings.Insert(P.name, P.value) ;
 	}
@@ -259,6 +576,71 @@ void	hzHttpEvent::SetPermCookie	(const hzSysID& Cookie, hzSDate& expires)
 	m_CookieExpire = expires ;
 }
 
+static	inline	char*	_hdrcopy	(char*& ph, const char* pVal, uint32_t nLen)
+{
+	//	Copy a header value to the next free space in the header value buffer and null terminate it
+	//
+	//	Arguments:	1)	ph		Next free space in buffer (advanced by the call)
+	//				2)	pVal	The value
+	//				3)	nLen	Length of value
+	//
+	//	Returns:	Pointer to the copied value
+
+	char*	pStart = ph ;	//	Start of copy
+
+	memcpy(ph, pVal, nLen) ;
+	ph += nLen ;
+	*ph++ = 0 ;
+	return pStart ;
+}
+
+static	int32_t	_tecoding	(const char* pVal, uint32_t nLen)
+{
+	//	Examine the comma separated list of codings in a Transfer-Encoding header. Only chunked is supported and it must be the final coding, as otherwise the
+	//	end of the body cannot be determined. Requests that leave any doubt as to where the body ends are rejected outright, as a proxy in front of the server
+	//	might otherwise read the framing differently (request smuggling).
+	//
+	//	Arguments:	1)	pVal	The header value
+	//				2)	nLen	Length of value
+	//
+	//	Returns:	1	If the list comprises chunked alone
+	//				0	If chunked is not the final coding or appears more than once
+	//				-1	If chunked is the final coding but is preceded by codings that are not supported
+
+	const char*	pEnd = pVal + nLen ;	//	End of value
+	const char*	i ;						//	Start of coding
+	const char*	j ;						//	End of coding
+	uint32_t	nChunked = 0 ;			//	Occurrences of chunked
+	uint32_t	nOther = 0 ;			//	Occurrences of other codings
+	bool		bLast = false ;			//	The last coding is chunked
+
+	for (i = pVal ; i < pEnd ; i = j + 1)
+	{
+		for (; i < pEnd && (*i == CHAR_SPACE || *i == CHAR_TAB) ; i++) ;
+		for (j = i ; j < pEnd && *j != CHAR_COMMA ; j++) ;
+
+		//	Empty list elements are permitted and ignored
+		if (j == i)
+			continue ;
+
+		bLast = (j - i) >= 7 && !strncasecmp(i, "chunked", 7) ;
+		if (bLast)
+		{
+			for (i += 7 ; i < j && (*i == CHAR_SPACE || *i == CHAR_TAB) ; i++) ;
+			bLast = i == j ;
+		}
+
+		if (bLast)
+			nChunked++ ;
+		else
+			nOther++ ;
+	}
+
+	if (!bLast || nChunked > 1)
+		return 0 ;
+	return nOther ? -1 : 1 ;
+}
+
 hzEcode	hzHttpEvent::ProcessEvent	(hzChain& ZI)
 {
 	//	Purpose:	Process a HTTP event (an incoming HTTP GET or POST request)
@@ -273,122 +655,100 @@ hzEcode	hzHttpEvent::ProcessEvent	(hzChain& ZI)
 
 	hzChain::BlkIter	bi ;		//	To get directly at input chain inner buffer
 
-	hzChain			Head ;			//	The HTTP header
 	hzChain			Word ;			//	For building tokens
 	chIter			zi ;			//	Chain iterator
-	chIter			xi ;			//	Chain iterator
-	chIter			mkA ;			//	1st part of header line
-	chIter			mkB ;			//	2nd part of header line
-	chIter			mkC ;			//	End 2nd part of header line
-	hzHttpFile		upload ;		//	To cope with file uploads
-	hzPair			Pair ;			//	Name value pair
+	const char*		pHdr ;			//	Start of HTTP header (contiguous)
+	const char*		pHdrEnd ;		//	End of HTTP header
+	const char*		pEol ;			//	End of header line
+	const char*		pColon ;		//	Colon ending header name
+	const char*		pVal ;			//	Header value
+	const char*		pVEnd ;			//	End of header value
 	const char*		i ;				//	Loop control
 	char*			j ;				//	For string iteration
 	char*			ph ;			//	Offset into m_pBuf ;
 	uint64_t		cookie ;		//	Cookie value
-	hzString		S ;				//	Temp string
-	hzString		boundary ;		//	MIME boundary for multipart
 	uint32_t		nLine = 0 ;		//	Header line number
 	uint32_t		bErr = 0 ;		//	Format error
-	uint32_t		hSofar ;		//	For header value extraction
-	uint32_t		n ;				//	For cookie extraction
-	uint32_t		len ;			//	Offset into buffer
-	uint32_t		nFst ;			//	No of colon-space sequences in header
-	uint32_t		nSnd ;			//	No of CR-NL sequences in header (excluding the last pair)
+	uint32_t		n ;				//	For cookie extraction and Content-Length
+	uint32_t		len ;			//	Length of header value
+	bool			bCLen = false ;	//	Content-Length given
+	char			hdrBuf[HZ_MAX_HTTP_HDR] ;	//	For headers that straddle blocks of the input chain
 
 	if (!this)		Fatal("%s. No Instance\n", *_fn) ;
 	if (!m_pLog)	Fatal("%s. Cannot process requests. No logfile\n", *_fn) ;
 	if (!m_pCx)		Fatal("%s. Cannot process requests. No client info\n", *_fn) ;
 
-	//	If we already have completed header part, skip
-	m_pCx->m_Track.Printf("%s: Called with input chain of %d bytes\n", *_fn, ZI.Size()) ;
-	m_pCx->m_Track << ZI ;
+	//	If we already have completed header part, skip. Note the input is not copied to the connection record unless the request is sampled (see below).
+	m_pCx->m_Track.Event("ProcessEvent: Called with input chain of %u bytes", ZI.Size()) ;
 
 	if (m_bHdrComplete)
 	{
-		//if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-			m_pCx->m_Track.Printf("HTTP HEADER COMPLETE: Goto stage 2 with Header of %d bytes (conn=%p)\n", bi.Data(), m_nHeaderLen, m_pCx) ;
+		m_pCx->m_Track.Event("ProcessEvent: HTTP HEADER COMPLETE: Goto stage 2 with Header of %u bytes", m_nHeaderLen) ;
 		goto stage_two ;
 	}
 
-	if (ZI.Size() < 80)
+	//	Establish header size. The input chain is searched in place for the blank line ending the header. If this is not yet found, wait for more data unless
+	//	the input already exceeds the maximum header size.
+	if (!m_nHeaderLen)
+		m_nHeaderLen = HttpHeaderEnd(ZI, HZ_MAX_HTTP_HDR) ;
+
+	if (!m_nHeaderLen)
 	{
-		//	If size too small, check for illegal methods but if OK, return and wait for more data
+		//	Check for illegal methods but if OK, return and wait for more data
 		zi = ZI ;
 
 		if (!(*zi >= 'A' && *zi <= 'Z') || zi == "CONNECT ")
 		{
-			m_pCx->m_Track << "Invalid Header [" << ZI << "]\n" ;
+			m_pCx->m_Track.Error("ProcessEvent: Invalid Header (%u bytes)", ZI.Size()) ;
+			m_pCx->m_Track.Attach(ZI, true) ;
 			SetStatusIP(m_pCx->ClientIP(), HZ_IPSTATUS_BLACK_HTTP, 9000) ;
 			return E_FORMAT ;
 		}
 
-		m_pCx->m_Track << "Incomplete Header [" << ZI << "]\n" ;
-		return E_OK ;
+		if (ZI.Size() < HZ_MAX_HTTP_HDR)
+		{
+			m_pCx->m_Track.Event("ProcessEvent: Incomplete Header (%u bytes)", ZI.Size()) ;
+			return E_OK ;
+		}
+
+		m_Occur.SysDateTime() ;
+		m_pCx->m_Track.Error("ProcessEvent: REJECTED REQUEST (header too large, %u bytes)", ZI.Size()) ;
+		SendError(HTTPMSG_ENTITY_TOO_LARGE, "Excessive HTTP Header\n") ;
+		return E_RANGE ;
 	}
 
 	m_ClientIP = m_pCx->ClientIP() ;
 	m_Occur.SysDateTime() ;
 
-	//	Establish header size
-	if (!m_nHeaderLen)
 	{
-		//	Read up to end of first line to measure length required to accommodate the request path and any query or fragment
-		nFst = nSnd = hSofar = 0 ;
-		for (zi = ZI ; !zi.eof() && Head.Size() < HZ_MAX_HTTP_HDR ; zi++)
-		{
-			if (*zi == CHAR_CR && zi == "\r\n")
-				{ Head << "\r\n" ; zi += 2 ; break ; }
-			Head.AddByte(*zi) ;
-		}
-		hSofar = Head.Size() ;
-
-		//	Then get rest of HTTP header
-		for (; !zi.eof() && Head.Size() < HZ_MAX_HTTP_HDR ; zi++)
-		{
-			if (*zi == CHAR_CR && zi == "\r\n\r\n")
-				{ Head << "\r\n\r\n" ; m_nHeaderLen = Head.Size() ; break ; }
-
-			if (zi == ": ")
-				{ nFst++ ; hSofar++ ; }
-			if (nFst > nSnd)
-				hSofar++ ;
-			if (zi == "\r\n")
-				nSnd++ ;
-			Head.AddByte(*zi) ;
-		}
-
-		if (!m_nHeaderLen)
-		{
-			m_pCx->m_Track.Printf("\n%s: REJECTED REQUEST (No header end)\n", *m_Occur.Str()) ;
-			SendError(HTTPMSG_NOTFOUND, "Excessive HTTP Header\n") ;
-			return E_RANGE ;
-		}
-
-		if (m_nHeaderLen >= HZ_MAX_HTTP_HDR)
-		{
-			m_pCx->m_Track.Printf("\n%s: REJECTED REQUEST (too large)\n", *m_Occur.Str()) ;
-			SendError(HTTPMSG_ENTITY_TOO_LARGE, "Excessive HTTP Header\n") ;
-			return E_RANGE ;
-		}
-
 		/*
-		**	Extract HTTP header values
+		**	Extract HTTP header values. The header is parsed directly from the first block of the input chain unless it straddles blocks, in which case it is
+		**	copied once to a local buffer. Values of interest are copied to m_pBuf (in the arena) as null terminated strings. As no value can be longer than the line which
+		**	contains it, a buffer of the header length (plus terminators for path and fragment) suffices.
 		*/
 
-		if (hSofar < 1024)
-			hSofar = 1024 ;
-		ph = m_pBuf = new char[hSofar] ;
-		zi = Head ;
-
-		if		(zi == "GET ")		{ zi += 4 ; m_eMethod = HTTP_GET ; }
-		else if (zi == "HEAD ")		{ zi += 5 ; m_eMethod = HTTP_HEAD ; }
-		else if (zi == "POST ")		{ zi += 5 ; m_eMethod = HTTP_POST ; }
-		else if (zi == "OPTIONS ")	{ zi += 8 ; m_eMethod = HTTP_OPTIONS ; }
-		else if (zi == "PUT ")		{ zi += 4 ; m_eMethod = HTTP_PUT ; }
-		else if (zi == "DELETE ")	{ zi += 7 ; m_eMethod = HTTP_DELETE ; }
-		else if (zi == "TRACE ")	{ zi += 6 ; m_eMethod = HTTP_TRACE ; }
-		else if (zi == "CONNECT ")	{ zi += 8 ; m_eMethod = HTTP_CONNECT ; }
+		bi = ZI ;
+		if (bi.Size() >= m_nHeaderLen)
+			pHdr = (const char*) bi.Data() ;
+		else
+		{
+			zi = ZI ;
+			zi.Write(hdrBuf, m_nHeaderLen) ;
+			pHdr = hdrBuf ;
+		}
+		pHdrEnd = pHdr + m_nHeaderLen ;
+
+		ph = m_pBuf = (char*) m_Arena.Alloc(m_nHeaderLen + 16) ;
+		i = pHdr ;
+
+		if		(!memcmp(i, "GET ", 4))		{ i += 4 ; m_eMethod = HTTP_GET ; }
+		else if (!memcmp(i, "HEAD ", 5))	{ i += 5 ; m_eMethod = HTTP_HEAD ; }
+		else if (!memcmp(i, "POST ", 5))	{ i += 5 ; m_eMethod = HTTP_POST ; }
+		else if (!memcmp(i, "OPTIONS ", 8))	{ i += 8 ; m_eMethod = HTTP_OPTIONS ; }
+		else if (!memcmp(i, "PUT ", 4))		{ i += 4 ; m_eMethod = HTTP_PUT ; }
+		else if (!memcmp(i, "DELETE ", 7))	{ i += 7 ; m_eMethod = HTTP_DELETE ; }
+		else if (!memcmp(i, "TRACE ", 6))	{ i += 6 ; m_eMethod = HTTP_TRACE ; }
+		else if (!memcmp(i, "CONNECT ", 8))	{ i += 8 ; m_eMethod = HTTP_CONNECT ; }
 		else
 			bErr |= 0x01 ;
 
@@ -396,166 +756,174 @@ hzEcode	hzHttpEvent::ProcessEvent	(hzChain& ZI)
 		if (!bErr)
 		{
 			//	Get the requested path first
-			for (m_pReqPATH = ph ; !zi.eof() && *zi != CHAR_SPACE && *zi != CHAR_QUERY && *zi != CHAR_HASH ; ph++, zi++)
-				*ph = *zi ;
+			for (m_pReqPATH = ph ; i < pHdrEnd && *i != CHAR_SPACE && *i != CHAR_QUERY && *i != CHAR_HASH && *i != CHAR_CR ; i++)
+				*ph++ = *i ;
 			*ph++ = 0 ;
 
-			if (*zi == CHAR_QUERY)
+			if (*i == CHAR_QUERY)
 			{
-				//	Read until either a SPACE or a HASH
-				zi++ ;
-				m_nQueryLen = _setnvpairs(zi) ;
+				//	The query is decoded from the input chain. Then read until either a SPACE or a HASH
+				i++ ;
+				zi = ZI ;
+				zi += (i - pHdr) ;
+				m_nQueryLen = _setnvpairs(zi, pHdrEnd - i) ;
+				for (; i < pHdrEnd && *i != CHAR_SPACE && *i != CHAR_HASH && *i != CHAR_CR ; i++) ;
 			}
 
-			if (*zi == CHAR_HASH)
+			if (*i == CHAR_HASH)
 			{
 				//	Read until a SPACE
-				for (m_pReqFRAG = ph ; !zi.eof() && *zi == CHAR_SPACE ; ph++, zi++)
-					*ph = *zi ;
+				for (m_pReqFRAG = ph, i++ ; i < pHdrEnd && *i != CHAR_SPACE && *i != CHAR_CR ; i++)
+					*ph++ = *i ;
 				*ph++ = 0 ;
 			}
 
-			if (*zi != CHAR_SPACE)
+			if (*i != CHAR_SPACE)
 				bErr |= 0x02 ;
 			if (!m_pReqPATH[0])
 				bErr |= 0x02 ;
-			zi++ ;
+			i++ ;
 		}
 
-		//	Obtain the HTTP version
+		//	Obtain the HTTP version. The "HTTP/" prefix and the "n.n\r\n" version that follows need 10 bytes before the end of the header.
 		if (!bErr)
 		{
-			if (zi != "HTTP/")
+			if ((pHdrEnd - i) < 10 || memcmp(i, "HTTP/", 5))
 				bErr |= 0x04 ;
 			else
 			{
-				zi += 5 ;
+				i += 5 ;
 
-				if		(zi == "1.0\r\n")	{ zi += 5 ; m_nVersion = 0 ; }
-				else if (zi == "1.1\r\n")	{ zi += 5 ; m_nVersion = 1 ; }
-				else if (zi == "2.0\r\n")	{ zi += 5 ; m_nVersion = 2 ; }
+				if		(!memcmp(i, "1.0\r\n", 5))	{ i += 5 ; m_nVersion = 0 ; }
+				else if (!memcmp(i, "1.1\r\n", 5))	{ i += 5 ; m_nVersion = 1 ; }
+				else if (!memcmp(i, "2.0\r\n", 5))	{ i += 5 ; m_nVersion = 2 ; }
 				else
 					bErr |= 0x08 ;
 			}
+
+			//	Connections are persistent by default from HTTP/1.1 but not before. Either may be overriden by the Connection header.
+			m_nConnection = m_nVersion ? HZ_HTTP_KEEPALIVE : 0 ;
 		}
 
 		/*
 		**	Now grab the other headers of interest. Note headers not of interest are ignored. The main objective is to reject HTTP requests that are malformed. The process assumes
-		**	each header is in it's own line and is of the form "header_name: value\r\n".
+		**	each header is in it's own line and is of the form "header_name: value\r\n". Header names are identified by HttpHeaderId() with a single table lookup.
 		*/
 
-		//for (nLine = 2 ; !zi.eof() && !bErr && nLine <= nSnd ; nLine++)
-		for (nLine = 2 ; !zi.eof() && !bErr ; nLine++)
+		for (nLine = 2 ; i < pHdrEnd && !bErr ; nLine++, i = pEol + 1)
 		{
 			//	Should be at the start of a line so establish line contents
-			if (zi == "\r\n")
-				break ;
-
-			//	Discover 1st half of header line (upto colon and space)
-			for (mkA = mkB = mkC = zi ; !zi.eof() ; zi++)
-			{
-				if (*zi == CHAR_COLON && zi[1] == CHAR_SPACE)
-				{
-					//	Discover 2nd part of line (from colon and space to end of line)
-					zi += 2 ;
-					for (len = 0, mkB = zi ; !zi.eof() ; len++, zi++)
-					{
-						if (*zi == CHAR_CR && zi[1] == CHAR_NL)
-							{ mkC = zi ; zi += 2 ; break ; }
-					}
-					if (!len)
-						bErr |= 0x10 ;
-					break ;
-				}
-			}
-
-			//	Now have a complete line
-			switch	(toupper(*mkA))
-			{
-			case 'A':
-
-				if (mkA.Equiv("Accept"))			{ for (m_pAccept = ph,			xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-				if (mkA.Equiv("Accept-Charset"))	{ for (m_pAcceptCharset = ph,	xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-				if (mkA.Equiv("Accept-Language"))	{ for (m_pAcceptLang = ph,		xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-				if (mkA.Equiv("Accept-Encoding"))	{ for (m_pAcceptCode = ph,		xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-
-				if (mkA.Equiv("Authorization: basic"))
-					{ for (j = ph, xi = mkB ; xi != mkC ; j++, xi++) *j = *xi ; *j++ = 0 ; m_Auth = Base64Decode(ph) ; }
+			if (*i == CHAR_CR)
 				break ;
 
-			case 'C':
+			pEol = HttpScan(i, pHdrEnd, CHAR_NL) ;
+			pColon = HttpScan(i, pEol, CHAR_COLON) ;
+			if (!pColon)
+				{ bErr |= 0x10 ; break ; }
 
-				if (mkA.Equiv("Cache-Control"))		{ for (m_pCacheControl = ph,	xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-				if (mkA.Equiv("Content-Type"))		{ for (m_pContentType = ph,		xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-				if (mkA.Equiv("Client-ip"))			{ for (m_pCliIP = ph,			xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-				if (mkA.Equiv("Content-Length"))	{ for (j = ph, xi = mkB ; xi != mkC ; j++, xi++) *j = *xi ; *j++ = 0 ; m_nContentLen = *ph ? atoi(ph) : 0 ; break ; }
-				if (mkA.Equiv("Connection"))		{ m_nConnection = mkB.Equiv("keep-alive") ? 0 : 15 ; break ; }
+			//	Isolate the value (without leading and trailing whitespace)
+			for (pVal = pColon + 1 ; pVal < pEol && (*pVal == CHAR_SPACE || *pVal == CHAR_TAB) ; pVal++) ;
+			for (pVEnd = pEol ; pVEnd > pVal && pVEnd[-1] <= CHAR_SPACE ; pVEnd--) ;
+			len = pVEnd - pVal ;
 
-				if (mkA.Equiv("Cookie"))
-				{
-					//	Only interested in cookies with names matching the application name
-					for (xi = mkB ; *xi ; xi++)
-					{
-						//if (xi == _hzGlobal_HtmlApp->m_CookieName)
-						if (xi == _hzGlobal_Dissemino->m_CookieName)
-						{
-							//	Found a cookie begining with _hz so copy upto the semicolon
-							//xi += _hzGlobal_HtmlApp->m_CookieName.Length() + 1 ;
-							xi += _hzGlobal_Dissemino->m_CookieName.Length() + 1 ;
-							for (j = ph, n = 0 ; *xi && n < 32 && *xi > CHAR_SPACE && *xi != CHAR_SCOLON ; j++, xi++, n++)
-								*j = *xi ;
-							*j++ = 0 ;
-							IsHexnum(cookie, ph) ;
-							m_CookieSub = cookie ;
-							break ;
-						}
-					}
-				}
-				break ;
-
-			case 'F':	if (mkA.Equiv("From"))	{ for (m_pFrom = ph, xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; }	break ;
-
-			case 'H':	if (mkA.Equiv("Host"))
-						{
-							for (m_pHost = ph, xi = mkB ; *xi != CHAR_COLON && xi != mkC ; ph++, xi++)
-								*ph = *xi ;
-							*ph++ = 0 ;
-						}
-						if (xi == CHAR_COLON)
-							for (; xi != mkC ; xi++) ;
-						break ;
-
-			case 'I':	if (mkA.Equiv("If-Modified-Since"))	{ for (j = ph, xi = mkB ; xi != mkC ; j++, xi++) *j = *xi ; *j++ = 0 ; m_LastMod = ph ; break ; }
-						if (mkA.Equiv("If-None-Match"))		{ for (m_pETag = ph, xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; }
-						break ;
-
-			case 'K':	if (mkA.Equiv("Keep-Alive"))
-							m_nConnection = 15 ;
-						break ;
-
-			case 'M':	if (mkA.Equiv("Max-Forwards"))	{ for (j = ph, xi = mkB ; xi != mkC ; j++, xi++) *j = *xi ; *j++ = 0 ; m_nMaxForwards = *ph ? atoi(ph) : 0 ; }	break ;
-			case 'P':	if (mkA.Equiv("Pragma"))		{ for (m_pPragma = ph,	xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; }	break ;
-			case 'R':	if (mkA.Equiv("Referer"))		{ for (m_pReferer = ph,	xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; m_Referer = m_pReferer ; }	break ;
-
-			case 'U':	if (mkA.Equiv("User-Agent"))	{ for (m_pUserAgent = ph, xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-						if (mkA.Equiv("UA-CPU"))		{ for (m_pProcessor = ph, xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; }
-						break ;
-
-			case 'V':	if (mkA.Equiv("Via"))
-							{ for (m_pVia = ph, xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; }
-						break ;
-
-			case 'x':
-			case 'X':
-
-				if (mkA.Equiv("X-Forwarded-For"))		{ for (m_pFwrdIP = ph,	xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-				if (mkA.Equiv("X-ProxyUser-IP"))		{ for (m_pProxIP = ph,	xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-				if (mkA.Equiv("X-Forwarded-Host"))		{ for (m_pXost = ph,	xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; break ; }
-				if (mkA.Equiv("X-Forwarded-Server"))	{ for (m_pServer = ph,	xi = mkB ; xi != mkC ; ph++, xi++) *ph = *xi ; *ph++ = 0 ; }
-				break ;
+			switch	(HttpHeaderId(i, pColon - i))
+			{
+			case HTTP_HDR_ACCEPT:				m_pAccept = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_ACCEPT_CHARSET:		m_pAcceptCharset = _hdrcopy(ph, pVal, len) ;	break ;
+			case HTTP_HDR_ACCEPT_LANGUAGE:		m_pAcceptLang = _hdrcopy(ph, pVal, len) ;		break ;
+			case HTTP_HDR_ACCEPT_ENCODING:		m_pAcceptCode = _hdrcopy(ph, pVal, len) ;
+												_acceptcode(pVal, len) ;
+												break ;
+			case HTTP_HDR_CACHE_CONTROL:		m_pCacheControl = _hdrcopy(ph, pVal, len) ;		break ;
+			case HTTP_HDR_CONTENT_TYPE:			m_pContentType = _hdrcopy(ph, pVal, len) ;		break ;
+			case HTTP_HDR_CLIENT_IP:			m_pCliIP = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_FROM:					m_pFrom = _hdrcopy(ph, pVal, len) ;				break ;
+			case HTTP_HDR_IF_NONE_MATCH:		m_pETag = _hdrcopy(ph, pVal, len) ;				break ;
+			case HTTP_HDR_IF_RANGE:				m_pIfRange = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_RANGE:				m_pRange = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_PRAGMA:				m_pPragma = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_USER_AGENT:			m_pUserAgent = _hdrcopy(ph, pVal, len) ;		break ;
+			case HTTP_HDR_UA_CPU:				m_pProcessor = _hdrcopy(ph, pVal, len) ;		break ;
+			case HTTP_HDR_VIA:					m_pVia = _hdrcopy(ph, pVal, len) ;				break ;
+			case HTTP_HDR_X_FORWARDED_FOR:		m_pFwrdIP = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_X_PROXYUSER_IP:		m_pProxIP = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_X_FORWARDED_HOST:		m_pXost = _hdrcopy(ph, pVal, len) ;				break ;
+			case HTTP_HDR_X_FORWARDED_SERVER:	m_pServer = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_UPGRADE:				m_pUpgrade = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_SEC_WEBSOCKET_KEY:	m_pWsKey = _hdrcopy(ph, pVal, len) ;			break ;
+			case HTTP_HDR_SEC_WEBSOCKET_VERSION:	m_pWsVersion = _hdrcopy(ph, pVal, len) ;	break ;
+			case HTTP_HDR_SEC_WEBSOCKET_PROTOCOL:	m_pWsProtocol = _hdrcopy(ph, pVal, len) ;	break ;
+
+			case HTTP_HDR_REFERER:				m_pReferer = _hdrcopy(ph, pVal, len) ;
+												m_Referer = m_pReferer ;
+												break ;
+
+			case HTTP_HDR_CONTENT_LENGTH:		//	Must be all digits and repeated Content-Length headers must agree
+												for (j = (char*) pVal ; j < pVEnd && IsDigit(*j) ; j++) ;
+												n = atoi(pVal) ;
+												if (!len || j != pVEnd || (bCLen && n != m_nContentLen))
+													bErr |= 0x80 ;
+												m_nContentLen = n ;
+												bCLen = true ;
+												break ;
+			case HTTP_HDR_MAX_FORWARDS:			m_nMaxForwards = len ? atoi(pVal) : 0 ;			break ;
+			case HTTP_HDR_TRANSFER_ENCODING:	//	Only chunked is supported, once and as the final coding (see _tecoding)
+												switch (m_nChState ? 0 : _tecoding(pVal, len))
+												{
+												case 1:		m_nChState = CH_SIZE ;	break ;
+												case 0:		bErr |= 0x80 ;			break ;
+												default:	bErr |= 0x100 ;			break ;
+												}
+												break ;
+			case HTTP_HDR_KEEP_ALIVE:			//	Only parameters of a persistent connection (requested by the Connection header)
+												break ;
+
+			case HTTP_HDR_CONNECTION:			//	A list of options of which only close and keep-alive are of interest
+												m_pConnection = _hdrcopy(ph, pVal, len) ;
+												if (strcasestr(m_pConnection, "close"))
+													m_nConnection = 0 ;
+												else if (strcasestr(m_pConnection, "keep-alive"))
+													m_nConnection = HZ_HTTP_KEEPALIVE ;
+												break ;
+
+			case HTTP_HDR_IF_MODIFIED_SINCE:	j = _hdrcopy(ph, pVal, len) ;
+												m_LastMod = j ;
+												m_nIfModSince = _httpdate(j) ;
+												break ;
+
+			case HTTP_HDR_AUTHORIZATION:		//	Only basic authorization is supported
+												if (len > 6 && !strncasecmp(pVal, "basic ", 6))
+												{
+													for (pVal += 6 ; pVal < pVEnd && *pVal == CHAR_SPACE ; pVal++) ;
+													j = _hdrcopy(ph, pVal, pVEnd - pVal) ;
+													m_Auth = Base64Decode(j) ;
+												}
+												break ;
+
+			case HTTP_HDR_HOST:					//	Host is recorded without the port
+												for (pVEnd = pVal ; pVEnd < pVal + len && *pVEnd != CHAR_COLON ; pVEnd++) ;
+												m_pHost = _hdrcopy(ph, pVal, pVEnd - pVal) ;
+												break ;
+
+			case HTTP_HDR_COOKIE:				//	Only interested in cookies with names matching the application name. A process with no Dissemino
+												//	instance (such as a proxy-only front process) has no session cookies.
+												if (!_hzGlobal_Dissemino)
+													break ;
+												n = _hzGlobal_Dissemino->m_CookieName.Length() ;
+												for (j = (char*) pVal ; j + n < pVal + len ; j++)
+												{
+													if (j[n] == CHAR_EQUAL && !memcmp(j, *_hzGlobal_Dissemino->m_CookieName, n))
+													{
+														//	Found the cookie so copy upto the semicolon (max 32 hex digits)
+														for (pVal = j += n + 1 ; j < pVEnd && (j - pVal) < 32 && *j > CHAR_SPACE && *j != CHAR_SCOLON ; j++) ;
+														IsHexnum(cookie, _hdrcopy(ph, pVal, j - pVal)) ;
+														m_CookieSub = cookie ;
+														break ;
+													}
+												}
+												break ;
 
 			default:
-				m_pCx->m_Track.Printf("None of the above line %d\n", nLine) ;
 				break ;
 			}
 		}
@@ -585,21 +953,31 @@ hzEcode	hzHttpEvent::ProcessEvent	(hzChain& ZI)
 		if (!m_pHost)
 			bErr |= 0x40 ;
 
+		//	A request with both Content-Length and Transfer-Encoding is rejected, rather than disregarding the Content-Length as RFC 7230 allows, because
+		//	another server on the path may not
+		if (bCLen && m_nChState)
+			bErr |= 0x80 ;
+
 		if (bErr)
 		{
 			m_bMsgComplete = true ;
-
-			m_pCx->m_Track.Printf("%s: %s Sock %d/%d REQUEST [\n", *_fn, *m_Occur.Str(), m_pCx->CliSocket(), m_pCx->CliPort()) ;
-			m_pCx->m_Track << ZI ;
-			m_pCx->m_Track << "]\n" ;
-
-			if (bErr & 0x01)	m_pCx->m_Track.Printf("Line 1: Failed to find HTTP Method\n") ;
-			if (bErr & 0x02)	m_pCx->m_Track.Printf("Line 1: Malformed HTTP resource request\n") ;
-			if (bErr & 0x04)	m_pCx->m_Track.Printf("Line 1: Invalid HTTP Version\n") ;
-			if (bErr & 0x08)	m_pCx->m_Track.Printf("Line %d: No space after colon\n", nLine) ;
-			if (bErr & 0x10)	m_pCx->m_Track.Printf("Line %d: Could not evaluate line\n", nLine) ;
-			if (bErr & 0x20)	m_pCx->m_Track.Printf("Could not detect client IP\n") ;
-			if (bErr & 0x40)	m_pCx->m_Track.Printf("No Host header supplied\n") ;
+			m_nConnection = 0 ;
+
+			//	The header is kept as an error report
+			Word.AppendSub(ZI, 0, m_nHeaderLen) ;
+			m_pCx->m_Track.Error("ProcessEvent: Sock %u/%u REQUEST header rejected", m_pCx->CliSocket(), m_pCx->CliPort()) ;
+			m_pCx->m_Track.Attach(Word, true) ;
+			Word.Clear() ;
+
+			if (bErr & 0x01)	m_pCx->m_Track.Event("Line 1: Failed to find HTTP Method") ;
+			if (bErr & 0x02)	m_pCx->m_Track.Event("Line 1: Malformed HTTP resource request") ;
+			if (bErr & 0x04)	m_pCx->m_Track.Event("Line 1: Invalid HTTP Version") ;
+			if (bErr & 0x08)	m_pCx->m_Track.Event("Line %u: No space after colon", nLine) ;
+			if (bErr & 0x10)	m_pCx->m_Track.Event("Line %u: Could not evaluate line", nLine) ;
+			if (bErr & 0x20)	m_pCx->m_Track.Event("Could not detect client IP") ;
+			if (bErr & 0x40)	m_pCx->m_Track.Event("No Host header supplied") ;
+			if (bErr & 0x80)	m_pCx->m_Track.Event("Ambiguous body length (Content-Length and Transfer-Encoding conflict)") ;
+			if (bErr & 0x100)	m_pCx->m_Track.Event("Transfer-Encoding other than chunked") ;
 
 			if (m_eMethod == HTTP_CONNECT && (!m_pHost || m_pHost != _hzGlobal_Hostname))
 			{
@@ -612,664 +990,1902 @@ hzEcode	hzHttpEvent::ProcessEvent	(hzChain& ZI)
 				}
 			}
 
-			if (m_pBuf)				m_pCx->m_Track.Printf("m_pBuf           = %s\n", m_pBuf) ;
-			if (m_pAccept)			m_pCx->m_Track.Printf("m_pAccept        = %s\n", m_pAccept) ;
-			if (m_pAcceptCharset)	m_pCx->m_Track.Printf("m_pAcceptCharset = %s\n", m_pAcceptCharset) ;
-			if (m_pAcceptLang)		m_pCx->m_Track.Printf("m_pAcceptLang    = %s\n", m_pAcceptLang) ;
-			if (m_pAcceptCode)		m_pCx->m_Track.Printf("m_pAcceptCode    = %s\n", m_pAcceptCode) ;
-			if (m_pCacheControl)	m_pCx->m_Track.Printf("m_pCacheControl  = %s\n", m_pCacheControl) ;
-			if (m_pConnection)		m_pCx->m_Track.Printf("m_pConnection    = %s\n", m_pConnection) ;
-			if (m_pContentType)		m_pCx->m_Track.Printf("m_pContentType   = %s\n", m_pContentType) ;
-			if (m_pETag)			m_pCx->m_Track.Printf("m_pETag          = %s\n", m_pETag) ;
-			if (m_pPragma)			m_pCx->m_Track.Printf("m_pPragma        = %s\n", m_pPragma) ;
-			if (m_pUserAgent)		m_pCx->m_Track.Printf("m_pUserAgent     = %s\n", m_pUserAgent) ;
-			if (m_pProcessor)		m_pCx->m_Track.Printf("m_pProcessor     = %s\n", m_pProcessor) ;
-			if (m_pVia)				m_pCx->m_Track.Printf("m_pVia           = %s\n", m_pVia) ;
-			if (m_pCliIP)			m_pCx->m_Track.Printf("m_pCliIP         = %s\n", m_pCliIP) ;
-			if (m_pHost)			m_pCx->m_Track.Printf("m_pHost          = %s\n", m_pHost) ;
-			if (m_pXost)			m_pCx->m_Track.Printf("m_pXost          = %s\n", m_pXost) ;
-			if (m_pFwrdIP)			m_pCx->m_Track.Printf("m_pFwrdIP        = %s\n", m_pFwrdIP) ;
-			if (m_pProxIP)			m_pCx->m_Track.Printf("m_pProxIP        = %s\n", m_pProxIP) ;
-			if (m_pServer)			m_pCx->m_Track.Printf("m_pServer        = %s\n", m_pServer) ;
-			if (m_pFrom)			m_pCx->m_Track.Printf("m_pFrom          = %s\n", m_pFrom) ;
-			if (m_pReferer)			m_pCx->m_Track.Printf("m_pReferer       = %s\n", m_pReferer) ;
-			if (m_pReqPATH)			m_pCx->m_Track.Printf("m_pReqPATH       = %s\n", m_pReqPATH) ;
-			if (m_pReqFRAG)			m_pCx->m_Track.Printf("m_pReqFRAG       = %s\n", m_pReqFRAG) ;
-
-
-			SendError(HTTPMSG_NOTFOUND, "SORRY! INTERNAL ERROR\n") ;
+			if (bErr & 0x100)
+				SendError(HTTPMSG_NOT_IMPLEMENTED, "Transfer-Encoding not supported\n") ;
+			else if (bErr & 0x80)
+				SendError(HTTPMSG_BAD_REQUEST, "Ambiguous request body length\n") ;
+			else
+				SendError(HTTPMSG_NOTFOUND, "SORRY! INTERNAL ERROR\n") ;
 			return E_FORMAT ;
 		}
 
 		if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
 		{
-			m_pCx->m_Track.Printf("%s: %s Sock %d/%d REQUEST [\n", *_fn, *m_Occur.Str(), m_pCx->CliSocket(), m_pCx->CliPort()) ;
-			m_pCx->m_Track << ZI ;
-			m_pCx->m_Track << "]\n" ;
+			Word.AppendSub(ZI, 0, m_nHeaderLen) ;
+			m_pCx->m_Track.Event("ProcessEvent: Sock %u/%u REQUEST", m_pCx->CliSocket(), m_pCx->CliPort()) ;
+			m_pCx->m_Track.Attach(Word, false) ;
+			Word.Clear() ;
 		}
 	}
 
 	//	Header complete
 	m_bHdrComplete = true ;
+	if (m_nChState)
+		m_nContentLen = 0 ;
+
+	//	The header has been processed and the content-length is known. The whole hit may not be in but we can test the header. A multipart submission
+	//	is parsed as it arrives (see _multipart) so that uploaded files need not be held in memory, so establish the delimiter of the parts.
+	if (m_eMethod == HTTP_POST && (m_nContentLen || m_nChState) && m_pContentType && strcasestr(m_pContentType, "multipart/form-data"))
+	{
+		if ((i = strstr(m_pContentType, "boundary=")))
+		{
+			for (Word << "\r\n--", i += 9 ; *i > CHAR_SPACE && *i != CHAR_SCOLON ; i++)
+			{
+				if (*i != CHAR_DQUOTE)
+					Word.AddByte(*i) ;
+			}
 
-	//	The header has been processed and the content-length is known. The whole hit may not be in but we can test the header.
+			if (Word.Size() > 4)
+			{
+				m_Boundary = Word ;
+				m_nMpState = MP_PREAMBLE ;
+			}
+			Word.Clear() ;
+		}
+	}
 
+	//	Bodies other than multipart submissions are held in memory, so are limited in size. A chunked body is limited as it is decoded (see _chparse).
+	if (!m_nChState && !m_nMpState && m_nContentLen > HZ_MAX_HTTP_BODY)
+	{
+		m_bMsgComplete = true ;
+		m_nConnection = 0 ;
+		m_pCx->m_Track.Error("ProcessEvent: REJECTED REQUEST (body too large, %u bytes)", m_nContentLen) ;
+		SendError(HTTPMSG_ENTITY_TOO_LARGE, "Excessive HTTP Body\n") ;
+		return E_RANGE ;
+	}
 
 	//m_Resource.UrlDecode() ;
 
 stage_two:
+	if (m_nChState)
+		return _dechunk(ZI) ;
+	if (m_nMpState)
+		return _multipart(ZI) ;
+
 	//	We now can test that the hit has been sent in full
 	if (ZI.Size() < (m_nHeaderLen + m_nContentLen))
 	{
-		m_pCx->m_Track.Printf("%s. Not recv in full. Hdr %d, cont %d, actual %d\n", *_fn, m_nHeaderLen, m_nContentLen, ZI.Size()) ;
+		m_pCx->m_Track.Event("ProcessEvent: Not recv in full. Hdr %u, cont %u, actual %u", m_nHeaderLen, m_nContentLen, ZI.Size()) ;
 		return E_OK ;
 	}
 
-	if (ZI.Size() > (m_nHeaderLen + m_nContentLen))
-		m_pCx->m_Track.Printf("%s. Msg over: Hdr %d, cont %d, actual %d\n", *_fn, m_nHeaderLen, m_nContentLen, ZI.Size()) ;
 	m_bMsgComplete = true ;
 
-	//	Obtain POST data if applicable
-	zi = ZI ;
-	zi += m_nHeaderLen ;
-
-	if (m_eMethod == HTTP_POST)
+	//	Record the request in full if it is sampled (see hzTrack)
+	if (m_pCx->m_Track.Sample())
 	{
-		if (m_pContentType)
-		{
-			for (n = 0, i = m_pContentType ; *i ; i++)
-			{
-				if (*i == CHAR_SCOLON)
-					{ n = 1 ; continue ; }
-
-				if (n)
-				{
-					if (!memcmp(i, "boundary=", 9))
-						{ i += 9 ; boundary = i ; break ; }
-				}
-			}
-		}
-
-		if (!boundary)
-			_setnvpairs(zi) ;
-		else
-		{
-			for (; !zi.eof() ;)
-			{
-				if (zi != boundary)
-					{ zi++ ; continue ; }
-
-				/*
-				**	In the general case, data occurs in the form:-
-				**		boundary\nContent-Disposition: form-data; name="fldname"
-				**		data
-				**		blank line.
-				**	Note that in the empty field case, there are two blank lines (3 \r\n sequences)
-				**
-				**	In the file upload case in the form:-
-				**		boundary\nContent-Disposition: form-data; name="fldname"; filename="filename"
-				**		Content-Type: ...
-				**		blank line
-				**		filedata
-				**	Note that the filedata is terminated by the appearence of the boundary on a line by itself and that the whole submission is
-				**	terminated by the boundary followed directly by two minus signs.
-				*/
-
-				zi += boundary.Length() ;
-				if (zi == "--")
-					break ;
-
-				zi.Skipwhite() ;
-
-				if (zi != "Content-Disposition: form-data; name=\"")
-				{
-					m_pCx->m_Track.Printf("Malformed multipart form submission (case 1)\n") ;
-					for (; !zi.eof() && *zi != CHAR_NL ; zi++) ;
-					break ;
-				}
+		Word.AppendSub(ZI, 0, m_nHeaderLen + m_nContentLen) ;
+		m_pCx->m_Track.Payload(Word) ;
+		Word.Clear() ;
+	}
 
-				//	Get name part of name-value pair
-				for (zi += 38 ; !zi.eof() && *zi != CHAR_DQUOTE ; zi++)
-					Word.AddByte(*zi) ;
-				zi++ ;
-				Pair.name = Word ;
-				Word.Clear() ;
+	//	Obtain POST data if applicable. Where further (pipelined) requests follow this one, decoding stops at the content length so cannot read beyond.
+	if (ZI.Size() > (m_nHeaderLen + m_nContentLen))
+		m_pCx->m_Track.Event("ProcessEvent: Msg over: Hdr %u, cont %u, actual %u (pipelined)", m_nHeaderLen, m_nContentLen, ZI.Size()) ;
 
-				//	Get value part of name-value pair
-				if (*zi == CHAR_SCOLON)
-				{
-					//	Now expect [; filename="filename"]
-					if (zi != "; filename=\"")
-					{
-						m_pCx->m_Track.Printf("Malformed multipart form submission (case 2)\n") ;
-						for (; !zi.eof() && *zi != CHAR_NL ; zi++) ;
-						break ;
-					}
-
-					for (zi += 12 ; !zi.eof() && *zi != CHAR_DQUOTE ; zi++)
-						Word.AddByte(*zi) ;
-					zi++ ;
-					Pair.value = Word ;
-					Word.Clear() ;
-
-					upload.m_fldname = Pair.name ;
-					upload.m_filename = Pair.value ;
-
-					//	Now get file content
-					zi.Skipwhite() ;
-					if (zi != "Content-Type: ")
-					{
-						m_pCx->m_Track.Printf("%s. Expected Content-Type for submitted file\n", *_fn) ;
-						break ;
-					}
-					for (zi += 14 ; !zi.eof() && *zi != CHAR_NL ; zi++)
-					{
-						if (*zi == CHAR_CR)
-							continue ;
-						if (*zi == CHAR_NL)
-							break ;
-						Word.AddByte(*zi) ;
-					}
-					S = Word ;
-					Word.Clear() ;
-					upload.m_mime = Str2Mimetype(S) ;
-					if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-						threadLog("%s. MIME type of %s is %d (%s)\n", *_fn, *Pair.value, upload.m_mime, *S) ;
-
-					zi++ ;
-					if (zi == "\r\n")
-						zi += 2 ;
-
-					for (; !zi.eof() ; zi++)
-					{
-						if (zi == "\r\n--")
-						{
-							zi += 4 ;
-							if (zi == boundary)
-								break ;
-							upload.m_file << "\r\n--" ;
-							continue ;
-						}
-						upload.m_file.AddByte(*zi) ;
-					}
-					//m_Files.Add(W) ;
-					m_Inputs.Add(Pair) ;
-					m_mapStrings.Insert(Pair.name, Pair.value) ;
-					m_pCx->m_Track.Printf("%s. Field name/value %s=%s\n", *_fn, *Pair.name, *Pair.value) ;
-					m_Uploads.Insert(upload.m_fldname, upload) ;
-					m_pCx->m_Track.Printf("%s. Got file of %d bytes\n", *_fn, upload.m_file.Size()) ;
-				}
-				else
-				{
-					//	Expect \r\n then a line of data terminated by \r\n\r\n
-					if (*zi != CHAR_CR)
-						m_pCx->m_Track.Printf("%s. Warning fld not at CR, char=%c instead\n", *_fn, *zi) ;
-
-					zi.Skipwhite() ;
-					for (; !zi.eof() ; zi++)
-					{
-						if (zi == "\r\n")
-						{
-							zi += 2 ;
-							if (zi == "--")
-							{
-								zi += 2 ;
-								if (zi == boundary)
-									break ;
-							}
-
-							Word.AddByte(CHAR_NL) ;
-							continue ;
-						}
-						Word.AddByte(*zi) ;
-					}
-					Pair.value = Word ;
-					Word.Clear() ;
-					m_Inputs.Add(Pair) ;
-					m_mapStrings.Insert(Pair.name, Pair.value) ;
-					m_pCx->m_Track.Printf("%s. Field name/value %s=%s\n", *_fn, *Pair.name, *Pair.value) ;
-				}
-			}
-		}
+	if (m_eMethod == HTTP_POST && m_nContentLen)
+	{
+		zi = ZI ;
+		zi += m_nHeaderLen ;
+		_setnvpairs(zi, m_nContentLen) ;
 	}
 
 	return E_OK ;
 }
 
-hzEcode	hzHttpEvent::Storeform	(const char* cpPath)
+hzEcode	hzHttpEvent::RawRequest	(hzChain& Hdr, hzChain& Body)
 {
-	//	Appends submitted forms to a file of the supplied pathname. This is quite separate from any processing of the form by the application.
-	//	This can be convient for diagnostics or even serve as a rudimantry form of backup.
+	//	Obtain the current request as it was received, so it can be relayed to another server (see hzHttpProxy). This may only be called by the callback
+	//	function while the request is still in the input of the connection. The header is exactly as sent by the client. The body is as sent except that a
+	//	chunked body is supplied decoded (the header still says it is chunked, so the caller must reframe it).
 	//
-	//	Arguments:	1)	cpPath	Filename to store form submissions
+	//	A multipart form submission cannot be supplied as it is parsed and removed from the input as it arrives, with any uploaded files spilled to disk.
 	//
-	//	Returns:	E_ARGUMENT	If the pathname is not supplied
-	//				E_OPENFAIL	If the store form file cannot be opened for writing
-	//				E_WRITEFAIL	If a write error occurs
-	//				E_OK		If the form submission was stored
+	//	Arguments:	1)	Hdr		The chain to receive the request header (including the terminating blank line)
+	//				2)	Body	The chain to receive the request body (if any)
+	//
+	//	Returns:	E_SEQUENCE	If the request is not complete
+	//				E_NODATA	If the request was a multipart submission and so is no longer available
+	//				E_OK		If the request was supplied
 
-	_hzfunc("hzHttpEvent::Storeform") ;
+	Hdr.Clear() ;
+	Body.Clear() ;
 
-	static	char cvLine [80] ;	//	Buffer for time stamp and field id
+	if (!m_bMsgComplete || !m_pCx)
+		return E_SEQUENCE ;
+	if (m_nMpState)
+		return E_NODATA ;
 
-	std::ofstream	os ;		//	Output file for form submission storage
+	if (m_nChState)
+	{
+		Hdr = m_RawHead ;
+		Body = m_Body ;
+		return E_OK ;
+	}
 
-	hzPair		P ;				//	Field name/value pair
-	hzXDate		now ;			//	System time stamp
-	uint32_t	nIndex ;		//	Field iterator
+	Hdr.AppendSub(m_pCx->InputZone(), 0, m_nHeaderLen) ;
+	if (m_nContentLen)
+		Body.AppendSub(m_pCx->InputZone(), m_nHeaderLen, m_nContentLen) ;
+	return E_OK ;
+}
 
-	if (!cpPath || !cpPath[0])
-		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No pathname supplied\n") ;
+hzEcode	hzHttpEvent::_feed(uint32_t& nDone, const hzChain& Z, uint32_t nStart, uint32_t nAvail, hzEcode (hzHttpEvent::*fnParse)(uint32_t&, const char*, uint32_t))
+{
+	//	Present a stretch of a chain to a parsing function in pieces of up to HZ_UPLOAD_CHUNK bytes. The parsing function states how much of each piece it
+	//	has parsed and any bytes it could not parse (such as a line cut short by the end of the piece) are presented again at the start of the next piece.
+	//	This is the means by which request bodies are parsed as they arrive, by _mpparse() for multipart submissions and _chparse() for chunked bodies.
+	//
+	//	Arguments:	1)	nDone	Set to the number of bytes parsed
+	//				2)	Z		The chain
+	//				3)	nStart	Offset of the stretch in the chain
+	//				4)	nAvail	Length of the stretch
+	//				5)	fnParse	The parsing function
+	//
+	//	Returns:	E_FORMAT	If the parsing function could not parse a full piece (the line or header being parsed is overlong)
+	//				Any error returned by the parsing function
+	//				E_OK		If the stretch was parsed as far as possible
 
-	os.open(cpPath, std::ios::app) ;
-	if (os.fail())
-		return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Could not open file (%s) for writing\n", cpPath) ;
+	_hzfunc("hzHttpEvent::_feed") ;
 
-	now.SysDateTime() ;
-	sprintf(cvLine, "@Date: %04d%02d%02d\n", now.Year(), now.Month(), now.Day()) ;
-	os << cvLine ;
+	hzChain::BlkIter	bi ;	//	Chain block iterator
 
-	sprintf(cvLine, "@Time: %02d%02d%02d\n", now.Hour(), now.Min(), now.Sec()) ;
-	os << cvLine ;
+	uint32_t	nTaken ;		//	Bytes copied from the chain
+	uint32_t	nHeld ;			//	Bytes in buffer
+	uint32_t	nOset ;			//	Offset into current block
+	uint32_t	nCopy ;			//	Bytes to copy from current block
+	uint32_t	nUsed ;			//	Bytes of buffer parsed
+	hzEcode		rc ;			//	Return code
+	char		buf[HZ_UPLOAD_CHUNK] ;	//	Working buffer
 
-	for (nIndex = 0 ; GetAt(P, nIndex) == E_OK ; nIndex++)
+	nDone = 0 ;
+	for (bi = Z, nOset = nStart ; bi.Data() && nOset >= bi.Size() ; nOset -= bi.Size(), bi.Advance()) ;
+
+	for (nTaken = nHeld = 0 ;;)
 	{
-		if (P.name && P.value)
-			os << "@" << P.name << ":\t" << P.value << "\n" ;
+		//	Top up the buffer from the chain
+		for (; nHeld < HZ_UPLOAD_CHUNK && nTaken < nAvail && bi.Data() ;)
+		{
+			nCopy = bi.Size() - nOset ;
+			if (nCopy > (HZ_UPLOAD_CHUNK - nHeld))
+				nCopy = HZ_UPLOAD_CHUNK - nHeld ;
+			if (nCopy > (nAvail - nTaken))
+				nCopy = nAvail - nTaken ;
+
+			memcpy(buf + nHeld, (const char*) bi.Data() + nOset, nCopy) ;
+			nHeld += nCopy ;
+			nTaken += nCopy ;
+			nOset += nCopy ;
+			if (nOset == bi.Size())
+				{ bi.Advance() ; nOset = 0 ; }
+		}
 
-		if (os.fail())
+		if (!nHeld)
+			break ;
+
+		rc = (this->*fnParse)(nUsed, buf, nHeld) ;
+		if (rc != E_OK)
+			return rc ;
+
+		if (!nUsed)
 		{
-			os.close() ;
-			return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "_storeform: Write error on file (%s)\n", cpPath) ;
+			//	Nothing more can be parsed until more arrives. A chunked body that is complete takes nothing further. If the buffer is full, a line is overlong.
+			if (m_nChState == CH_DONE && fnParse == &hzHttpEvent::_chparse)
+				break ;
+			if (nHeld == HZ_UPLOAD_CHUNK)
+			{
+				m_pCx->m_Track.Error("_feed: Malformed request body (line or part header too long)") ;
+				return E_FORMAT ;
+			}
+			if (nTaken == nAvail || !bi.Data())
+				break ;
+			continue ;
 		}
+
+		nDone += nUsed ;
+		nHeld -= nUsed ;
+		if (nHeld)
+			memmove(buf, buf + nUsed, nHeld) ;
 	}
 
-	os << "@end:\n\n" ;
-	os.close() ;
 	return E_OK ;
 }
 
-hzEcode	_storeform	(hzHttpEvent* pE, FILE* fp)
+hzEcode	hzHttpEvent::_multipart	(hzChain& ZI)
 {
-	//	This stores forms submitted by HTTP clients in the supplied file. This is essentially for diagnostics and more formal mathods
-	//	are recomended for the operation of an Internet based application.
+	//	Parse as much of a multipart form submission as has arrived and remove it from the input. This is called by ProcessEvent each time more of the
+	//	request arrives, once the header is complete. The body is copied from the input in pieces of up to HZ_UPLOAD_CHUNK bytes and parsed by _mpparse().
+	//	Only bytes that could be the start of a delimiter cut short by the end of the input, or an incomplete part header, are left in the input. As file
+	//	parts are written to temporary files once over the spill threshold, the memory used by an upload is bounded irrespective of the size of the file.
 	//
-	//	Arguments:	1)	cpPath	Filename to store form submissions
-	//				2)	fp		FILE pointer (to open file)
+	//	As the parsed bytes are removed, ExpectSize() is reduced accordingly and is 0 once the request is complete. AwaitSize() gives the input size at
+	//	which there is another piece to parse, so the connection need not wait for the whole request before calling again.
 	//
-	//	Returns:	E_NOTOPEN	If the store form file pointer is not supplied
-	//				E_WRITEFAIL	If a write error occurs
-	//				E_OK		If the form submission was stored
+	//	Arguments:	1)	ZI	The input chain of the connection. On the first call this starts with the header, thereafter with any bytes left unparsed by
+	//						the last call.
+	//
+	//	Returns:	E_FORMAT	If the submission is malformed
+	//				E_OPENFAIL	If a temporary file could not be created
+	//				E_WRITEFAIL	If an uploaded file could not be written to a temporary file
+	//				E_OK		If the input was parsed. The request is complete if MsgComplete() is true.
 
-	_hzfunc("_storeform") ;
+	_hzfunc("hzHttpEvent::_multipart") ;
 
-	hzPair		P ;				//	Field name/value pair
-	hzXDate		now ;			//	System time stamp
-	uint32_t	nIndex ;		//	Field iterator
+	uint32_t	nSkip ;			//	Header bytes at start of input (first call only)
+	uint32_t	nAvail ;		//	Bytes of the body in the input
+	uint32_t	nDone ;			//	Bytes of body parsed
+	hzEcode		rc ;			//	Return code
 
-	if (!fp)
-		return E_NOTOPEN ;
+	nSkip = m_nConsumed ? 0 : m_nHeaderLen ;
+	nAvail = ExpectSize() - nSkip ;
+	if ((ZI.Size() - nSkip) < nAvail)
+		nAvail = ZI.Size() - nSkip ;
 
-	now.SysDateTime() ;
-	if (fprintf(fp, "%04d%02d%02d-%02d%02d%02d\n", now.Year(), now.Month(), now.Day(), now.Hour(), now.Min(), now.Sec()) == -1)
-		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "_storeform: Write error on file (1)") ;
+	rc = _feed(nDone, ZI, nSkip, nAvail, &hzHttpEvent::_mpparse) ;
+	if (rc != E_OK)
+		return rc ;
 
-	for (nIndex = 1 ; pE->GetAt(P, nIndex) == E_OK ; nIndex++)
+	//	If the whole request is in, anything left unparsed is discarded
+	if ((nSkip + nAvail) == ExpectSize())
 	{
-		if (fprintf(fp, "@%s:\t%s\n", *P.name, *P.value) == -1)
-			return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "_storeform: Write error on file (2)") ;
+		if (m_nMpState != MP_EPILOGUE)
+			m_pCx->m_Track.Error("_multipart: Malformed multipart form submission (unterminated, %u bytes discarded)", nAvail - nDone) ;
+		nDone = nAvail ;
+		m_bMsgComplete = true ;
+	}
+
+	//	Remove what has been parsed from the input
+	nDone += nSkip ;
+	if (nDone)
+	{
+		m_pCx->DropInput(nDone) ;
+		m_nConsumed += nDone ;
+	}
+
+	m_nAwait = 0 ;
+	if (!m_bMsgComplete)
+	{
+		m_nAwait = ZI.Size() + HZ_UPLOAD_CHUNK ;
+		if (m_nAwait > ExpectSize())
+			m_nAwait = ExpectSize() ;
 	}
 
-	fflush(fp) ;
 	return E_OK ;
 }
 
-hzEcode	hzHttpEvent::SetHdr	(const hzString& name, const hzString& value)
+hzEcode	hzHttpEvent::_dechunk	(hzChain& ZI)
 {
-	//	Set a variable to be transmitted as a name/value pair in the header of the HTTP response. With suitable JavaScript in the response page or article, this
-	//	variable can influence what is displayed.
+	//	Decode as much of a chunked request body (Transfer-Encoding: chunked) as has arrived and remove it from the input. This is called by ProcessEvent each
+	//	time more of the request arrives, once the header is complete. The chunks are decoded by _chparse() into m_Body. Where the body is a multipart form
+	//	submission, the decoded body is in turn parsed by _mpparse() as it is decoded, so uploaded files are spilled to disk as they are where the length is
+	//	given by Content-Length. Otherwise the body is held in m_Body until complete and then treated as with any other POST.
 	//
-	//	This allows a page that is otherwise fixed, to have different manifestations to different users. Normally, the only way to do this is by having the page
-	//	generated each time it is requested. A fixed content page or article can be pre-zipped so is quicker to serve and consumes less bandwidth.
+	//	As the length of a chunked body is not known in advance, Content-Length is taken to be the number of body bytes removed so far. ExpectSize() is thus
+	//	always 0 and AwaitSize() is set to call again as soon as anything more arrives.
 	//
-	//	Arguments:	1)	name	The header parameter name.
-	//				2)	value	The header parameter value.
+	//	Arguments:	1)	ZI	The input chain of the connection. On the first call this starts with the header, thereafter with any bytes left unparsed by
+	//						the last call.
 	//
-	//	Returns:	E_ARGUMENT	If provided with blank variable name.
-	//				E_NODATA	If no value is supplied..
-	//				E_OK		If operation successful.
+	//	Returns:	E_FORMAT	If the chunked encoding or a multipart submission within it is malformed
+	//				E_RANGE		If the decoded body (other than a multipart submission) exceeds HZ_MAX_HTTP_BODY. A 413 response is sent.
+	//				E_OPENFAIL	If a temporary file could not be created for an upload
+	//				E_WRITEFAIL	If an uploaded file could not be written to a temporary file
+	//				E_OK		If the input was parsed. The request is complete if MsgComplete() is true.
 
-	_hzfunc("hzHttpEvent::SetHdr") ;
+	_hzfunc("hzHttpEvent::_dechunk") ;
 
-	hzPair	p ;		//	Header name/value pair
+	chIter		zi ;		//	Body iterator (for name-value pairs)
+	hzChain		Rest ;		//	Decoded body not yet parsed as multipart
+	uint32_t	nSkip ;		//	Header bytes at start of input (first call only)
+	uint32_t	nDone ;		//	Bytes parsed
+	hzEcode		rc ;		//	Return code
 
-	if (!name)
-		return E_ARGUMENT ;
-	if (!value)
-		return E_NODATA ;
+	nSkip = m_nConsumed ? 0 : m_nHeaderLen ;
 
-	p.name = name ;
-	p.value = value ;
-	m_HdrsResponse.Add(p) ;
+	//	The header is about to leave the input, so keep it for RawRequest()
+	if (nSkip)
+		m_RawHead.AppendSub(ZI, 0, nSkip) ;
+
+	rc = _feed(nDone, ZI, nSkip, ZI.Size() - nSkip, &hzHttpEvent::_chparse) ;
+	if (rc == E_RANGE)
+	{
+		m_bMsgComplete = true ;
+		m_nConnection = 0 ;
+		SendError(HTTPMSG_ENTITY_TOO_LARGE, "Excessive HTTP Body\n") ;
+		return rc ;
+	}
+	if (rc != E_OK)
+		return rc ;
+
+	nDone += nSkip ;
+	if (nDone)
+	{
+		m_pCx->DropInput(nDone) ;
+		m_nConsumed += nDone ;
+	}
+	m_nContentLen = m_nConsumed - m_nHeaderLen ;
+
+	//	Parse the decoded body of a multipart submission so far
+	if (m_nMpState && m_Body.Size())
+	{
+		rc = _feed(nDone, m_Body, 0, m_Body.Size(), &hzHttpEvent::_mpparse) ;
+		if (rc != E_OK)
+			return rc ;
+
+		if (nDone)
+		{
+			if (nDone < m_Body.Size())
+				Rest.AppendSub(m_Body, nDone, m_Body.Size() - nDone) ;
+			m_Body = Rest ;
+		}
+	}
+
+	if (m_nChState != CH_DONE)
+	{
+		m_nAwait = ZI.Size() + 1 ;
+		return E_OK ;
+	}
+
+	m_nAwait = 0 ;
+	m_bMsgComplete = true ;
+
+	//	Record the request in full if it is sampled (see hzTrack). The body is recorded as decoded. A multipart submission is not recorded as its parts have
+	//	been dealt with as they arrived.
+	if (!m_nMpState && m_pCx->m_Track.Sample())
+	{
+		Rest << m_RawHead ;
+		Rest << m_Body ;
+		m_pCx->m_Track.Payload(Rest) ;
+		Rest.Clear() ;
+	}
+
+	if (m_nMpState)
+	{
+		if (m_nMpState != MP_EPILOGUE)
+			m_pCx->m_Track.Error("_dechunk: Malformed multipart form submission (unterminated, %u bytes discarded)", m_Body.Size()) ;
+		m_Body.Clear() ;
+	}
+	else if (m_eMethod == HTTP_POST)
+	{
+		zi = m_Body ;
+		_setnvpairs(zi, m_Body.Size()) ;
+	}
 
 	return E_OK ;
 }
 
-hzEcode	hzHttpEvent::SetVarString	(const hzString& name, const hzString& value)
+hzEcode	hzHttpEvent::_chparse	(uint32_t& nUsed, const char* pBuf, uint32_t nLen)
 {
-	//	Sets a string value to the supplied value and places it in the hzHttpEvent's map of string values. Note that if there is a chain value
-	//	of the same name, this is not allowed.
+	//	Parse a piece of a chunked request body. A chunked body takes the form:-
 	//
-	//	Note that the hzHttpEvent is very short lived. An instance is populated by a HTTP request, passed to the event handler ProcHTTP(), which processes it to
-	//	formulate a response. Then one of its member functions is called to write out that response to the client socket. The only purpose in setting a value in
-	//	the event's m_mapStrings member, is to influence the output by means of a percent-entity of the form [%e:var_name;] that is assumed to exist in the page
-	//	template being served.
+	//		hex-size [;extensions] CR/NL data CR/NL hex-size CR/NL data CR/NL ... 0 CR/NL [trailer lines] CR/NL
 	//
-	//	Arguments:	1)	name	The variable name.
-	//				2)	value	The variable value as a string
+	//	The data of each chunk is appended to m_Body. Chunk extensions and trailer lines are disregarded. Parsing stops short of the end of the piece where
+	//	it ends with an incomplete line, and stops altogether once the body is complete as anything beyond it is the next (pipelined) request.
 	//
-	//	Returns:	E_ARGUMENT	If the name is not supplied
-	//				E_DUPLICATE	If the name is already used
-	//				E_OK		If the variable was added
+	//	Arguments:	1)	nUsed	Set to the number of bytes parsed
+	//				2)	pBuf	The piece
+	//				3)	nLen	Length of piece
+	//
+	//	Returns:	E_FORMAT	If the chunked encoding is malformed
+	//				E_RANGE		If the decoded body would exceed HZ_MAX_HTTP_BODY (multipart submissions excepted, as they are parsed as decoded)
+	//				E_OK		If the piece was parsed
 
-	_hzfunc("hzHttpEvent::SetVariable[2]") ;
+	_hzfunc("hzHttpEvent::_chparse") ;
 
-	if (!name)
-		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Blank variable names are not allowed") ;
+	const char*	p ;			//	Start of unparsed bytes
+	const char*	i ;			//	Line end
+	uint32_t	n ;			//	Number of unparsed bytes
+	uint32_t	nDigits ;	//	Hex digits in chunk size
+	uint64_t	nSize ;		//	Chunk size
 
-	if (m_mapStrings.Exists(name))
-		m_mapStrings[name] = value ;
-	else
+	for (nUsed = 0 ; nUsed < nLen ;)
 	{
-		if (m_mapChains.Exists(name))
-			return hzerr(_fn, HZ_ERROR, E_DUPLICATE, "Cannot assign value to an existing chain") ;
+		p = pBuf + nUsed ;
+		n = nLen - nUsed ;
 
-		if (m_mapStrings.Insert(name, value) != E_OK)
-			return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not insert variable %s", *name) ;
+		switch (m_nChState)
+		{
+		case CH_SIZE:		//	Chunk size in hex, optionally followed by extensions
+			if (!(i = HttpScan(p, p + n, CHAR_NL)))
+				return E_OK ;
+
+			for (nSize = nDigits = 0 ; p < i && IsHex(*p) && nSize <= 0xffffffff ; p++, nDigits++)
+				nSize = (nSize << 4) | (IsDigit(*p) ? *p - '0' : (*p | 0x20) - 'a' + 10) ;
+
+			if (!nDigits || nSize > 0x7fffffff || (p < i && *p != CHAR_SCOLON && *p != CHAR_SPACE && *p != CHAR_TAB && *p != CHAR_CR))
+			{
+				m_pCx->m_Track.Error("_chparse: Malformed chunked request body (bad chunk size)") ;
+				return E_FORMAT ;
+			}
+
+			nUsed += (i - (pBuf + nUsed)) + 1 ;
+			m_nChunkLeft = nSize ;
+			m_nChState = nSize ? CH_DATA : CH_TRAILER ;
+			break ;
+
+		case CH_DATA:		//	Chunk data
+			if (n > m_nChunkLeft)
+				n = m_nChunkLeft ;
+			if (!m_nMpState && (m_Body.Size() + n) > HZ_MAX_HTTP_BODY)
+			{
+				m_pCx->m_Track.Error("_chparse: REJECTED REQUEST (chunked body exceeds %u bytes)", HZ_MAX_HTTP_BODY) ;
+				return E_RANGE ;
+			}
+			m_Body.Append(p, n) ;
+			nUsed += n ;
+			m_nChunkLeft -= n ;
+			if (!m_nChunkLeft)
+				m_nChState = CH_DATAEND ;
+			break ;
+
+		case CH_DATAEND:	//	CR/NL ending the chunk data
+			if (p[0] == CHAR_NL)
+				{ nUsed++ ; m_nChState = CH_SIZE ; break ; }
+			if (n < 2)
+				return E_OK ;
+			if (p[0] != CHAR_CR || p[1] != CHAR_NL)
+			{
+				m_pCx->m_Track.Error("_chparse: Malformed chunked request body (chunk data overruns size)") ;
+				return E_FORMAT ;
+			}
+			nUsed += 2 ;
+			m_nChState = CH_SIZE ;
+			break ;
+
+		case CH_TRAILER:	//	Trailer lines, ended by a blank line
+			if (!(i = HttpScan(p, p + n, CHAR_NL)))
+				return E_OK ;
+			nUsed += (i - p) + 1 ;
+			if (i == p || (i == p + 1 && p[0] == CHAR_CR))
+				m_nChState = CH_DONE ;
+			break ;
+
+		default:			//	Body complete
+			return E_OK ;
+		}
 	}
 
 	return E_OK ;
 }
 
-hzEcode	hzHttpEvent::SetVarChain	(const hzString& name, const hzChain& Z)
+static	void	_mpparam	(const char*& i, const char* pEnd, hzString& val)
 {
-	//	Sets a chain value to the supplied chain and places it in the hzHttpEvent's map of chain values. Note that if there is a string value
-	//	of the same name, this is not allowed.
+	//	Obtain the value of a parameter in a Content-Disposition header, either quoted or a token. The iterator is left at the closing quote or the byte
+	//	after the token.
 	//
-	//	Note that the hzHttpEvent is very short lived. An instance is populated by a HTTP request, passed to the event handler ProcHTTP(), which processes it to
-	//	formulate a response. Then one of its member functions is called to write out that response to the client socket. The only purpose in setting a value in
-	//	the event's m_mapChains member, is to influence the output by means of a percent-entity of the form [%e:var_name;] that is assumed to exist in the page
-	//	template being served.
+	//	Arguments:	1)	i		Start of the value (advanced by the call)
+	//				2)	pEnd	End of the header line
+	//				3)	val		The value
 	//
-	//	Arguments:	1)	name	The variable name.
-	//				2)	value	The variable value as a string
+	//	Returns:	None
+
+	hzChain		W ;		//	For building the value
+
+	if (i < pEnd && *i == CHAR_DQUOTE)
+	{
+		for (i++ ; i < pEnd && *i != CHAR_DQUOTE ; i++)
+			W.AddByte(*i) ;
+	}
+	else
+	{
+		for (; i < pEnd && *i > CHAR_SPACE && *i != CHAR_SCOLON ; i++)
+			W.AddByte(*i) ;
+	}
+	val = W ;
+}
+
+void	hzHttpEvent::_partstart	(const char* pHdr, uint32_t nLen)
+{
+	//	Begin a part of a multipart form submission. In the general case the part headers amount to a single line of the form:-
 	//
-	//	Returns:	E_ARGUMENT	If the name is not supplied
-	//				E_DUPLICATE	If the name is already used
-	//				E_OK		If the variable was added
+	//		Content-Disposition: form-data; name="fldname"
+	//
+	//	In the file upload case the Content-Disposition header has '; filename="filename"' added and is followed by a Content-Type header.
+	//
+	//	Arguments:	1)	pHdr	The part headers
+	//				2)	nLen	Length of part headers (including the CR/NL ending the last)
+	//
+	//	Returns:	None
 
-	_hzfunc("hzHttpEvent::SetVar(chain)") ;
+	_hzfunc("hzHttpEvent::_partstart") ;
 
-	if (!name)
-		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Blank variable names are not allowed") ;
+	const char*	pEnd ;		//	End of part headers
+	const char*	pEol ;		//	End of line
+	const char*	i ;			//	Line iterator
+	hzChain		W ;			//	For building MIME type
+	hzString	S ;			//	MIME type
 
-	if (m_mapChains.Exists(name))
+	m_Part.Clear() ;
+	m_bPartFile = false ;
+
+	for (pEnd = pHdr + nLen ; pHdr < pEnd ; pHdr = pEol + 1)
 	{
-		m_mapChains[name].Clear() ;
-		m_mapChains[name] = Z ;
+		if (!(pEol = HttpScan(pHdr, pEnd, CHAR_NL)))
+			pEol = pEnd ;
+
+		if ((pEol - pHdr) > 20 && !strncasecmp(pHdr, "Content-Disposition:", 20))
+		{
+			for (i = pHdr + 20 ; i < pEol ;)
+			{
+				if (*i++ != CHAR_SCOLON)
+					continue ;
+
+				for (; i < pEol && *i == CHAR_SPACE ; i++) ;
+
+				if ((pEol - i) > 5 && !strncasecmp(i, "name=", 5))
+					{ i += 5 ; _mpparam(i, pEol, m_Part.m_fldname) ; }
+				else if ((pEol - i) > 9 && !strncasecmp(i, "filename=", 9))
+					{ i += 9 ; _mpparam(i, pEol, m_Part.m_filename) ; m_bPartFile = true ; }
+			}
+			continue ;
+		}
+
+		if ((pEol - pHdr) > 13 && !strncasecmp(pHdr, "Content-Type:", 13))
+		{
+			for (i = pHdr + 13 ; i < pEol && *i == CHAR_SPACE ; i++) ;
+			for (; i < pEol && *i > CHAR_SPACE ; i++)
+				W.AddByte(*i) ;
+			S = W ;
+			m_Part.m_mime = Str2Mimetype(S) ;
+		}
+	}
+
+	if (!m_Part.m_fldname)
+		m_pCx->m_Track.Error("_partstart: Malformed multipart form submission (part has no name)") ;
+}
+
+hzEcode	hzHttpEvent::_partdata	(const char* pData, uint32_t nLen)
+{
+	//	Add data to the part being received. A file is held in memory until it exceeds the spill threshold, whereupon it is written to a temporary file to
+	//	which the rest of the file is then written directly.
+	//
+	//	Arguments:	1)	pData	The data
+	//				2)	nLen	Length of data
+	//
+	//	Returns:	E_OPENFAIL	If the temporary file could not be created
+	//				E_WRITEFAIL	If the temporary file could not be written to
+	//				E_OK		If the data was added
+
+	_hzfunc("hzHttpEvent::_partdata") ;
+
+	hzChain::BlkIter	bi ;	//	For writing out the part so far
+
+	char	path[HZ_MAXPATHLEN] ;	//	Temporary file path
+
+	if (!nLen)
+		return E_OK ;
+	m_Part.m_nSize += nLen ;
+
+	if (m_nPartFd >= 0)
+	{
+		if (write(m_nPartFd, pData, nLen) != (ssize_t) nLen)
+			return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Could not write upload to %s", *m_Part.m_path) ;
+		return E_OK ;
+	}
+
+	m_Part.m_file.Append(pData, nLen) ;
+	if (!m_bPartFile || m_Part.m_nSize <= s_nUploadSpill)
+		return E_OK ;
+
+	//	Spill to a temporary file
+	snprintf(path, HZ_MAXPATHLEN, "%s/hzupload.XXXXXX", *s_uploadDir) ;
+	if ((m_nPartFd = mkstemp(path)) < 0)
+		return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Could not create temporary file for upload in %s", *s_uploadDir) ;
+	m_Part.m_path = path ;
+
+	for (bi = m_Part.m_file ; bi.Data() ; bi.Advance())
+	{
+		if (write(m_nPartFd, bi.Data(), bi.Size()) != (ssize_t) bi.Size())
+			return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Could not write upload to %s", path) ;
+	}
+	m_Part.m_file.Clear() ;
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::_partend	(void)
+{
+	//	Complete the part being received. A file is added to the uploads with its filename as the value of the field. The value of any other field has
+	//	its line ends reduced to newlines.
+	//
+	//	Arguments:	None
+	//	Returns:	E_OK
+
+	_hzfunc("hzHttpEvent::_partend") ;
+
+	chIter		zi ;		//	Field value iterator
+	hzChain		W ;			//	For building field value
+	hzPair		Pair ;		//	Name value pair
+
+	Pair.name = m_Part.m_fldname ;
+
+	if (m_bPartFile)
+	{
+		if (m_nPartFd >= 0)
+			close(m_nPartFd) ;
+		m_nPartFd = -1 ;
+
+		Pair.value = m_Part.m_filename ;
+		m_Uploads.Insert(m_Part.m_fldname, m_Part) ;
+		m_pCx->m_Track.EventS("_partend: Got file %s of %u bytes (on disk %u)", *m_Part.m_filename, m_Part.m_nSize, m_Part.OnDisk() ? 1 : 0) ;
 	}
 	else
 	{
-		if (m_mapStrings.Exists(name))
-			return hzerr(_fn, HZ_ERROR, E_DUPLICATE, "Cannot assign value to an existing string") ;
+		for (zi = m_Part.m_file ; !zi.eof() ; zi++)
+		{
+			if (*zi == CHAR_CR && zi == "\r\n")
+				continue ;
+			W.AddByte(*zi) ;
+		}
+		Pair.value = W ;
+	}
 
-		if (m_mapChains.Insert(name, Z) != E_OK)
-			return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not insert variable %s", *name) ;
+	m_Inputs.Add(Pair) ;
+	m_mapStrings.Insert(Pair.name, Pair.value) ;
+	m_pCx->m_Track.EventS("_partend: Field %s", *Pair.name) ;
+
+	m_Part.Clear() ;
+	m_bPartFile = false ;
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::_mpparse	(uint32_t& nUsed, const char* pBuf, uint32_t nLen)
+{
+	//	Parse a piece of a multipart form submission. A submission takes the form:-
+	//
+	//		--boundary CR/NL part-headers CR/NL CR/NL part-data CR/NL --boundary CR/NL part-headers ... part-data CR/NL --boundary--
+	//
+	//	Parsing stops short of the end of the piece where the piece ends with what could be the start of a delimiter, or with incomplete part headers. The
+	//	bytes not parsed are presented again at the start of the next piece.
+	//
+	//	Arguments:	1)	nUsed	Set to the number of bytes parsed
+	//				2)	pBuf	The piece
+	//				3)	nLen	Length of piece
+	//
+	//	Returns:	E_FORMAT	If the submission is malformed
+	//				E_OPENFAIL	If a temporary file could not be created
+	//				E_WRITEFAIL	If an uploaded file could not be written to a temporary file
+	//				E_OK		If the piece was parsed
+
+	_hzfunc("hzHttpEvent::_mpparse") ;
+
+	const char*	p ;			//	Start of unparsed bytes
+	const char*	i ;			//	Delimiter or line end
+	uint32_t	n ;			//	Number of unparsed bytes
+	uint32_t	nDelim ;	//	Length of delimiter
+	hzEcode		rc ;		//	Return code
+
+	nDelim = m_Boundary.Length() ;
+
+	for (nUsed = 0 ; nUsed < nLen ;)
+	{
+		p = pBuf + nUsed ;
+		n = nLen - nUsed ;
+
+		switch (m_nMpState)
+		{
+		case MP_PREAMBLE:	//	The first delimiter usually starts the body and so lacks the leading CR/NL
+			if ((i = (const char*) memmem(p, n, *m_Boundary + 2, nDelim - 2)))
+				{ nUsed += (i - p) + nDelim - 2 ; m_nMpState = MP_BOUNDARY ; break ; }
+			if (n >= (nDelim - 2))
+				nUsed += n - (nDelim - 3) ;
+			return E_OK ;
+
+		case MP_BOUNDARY:	//	Two minus signs mark the last delimiter, otherwise expect CR/NL
+			if (n < 2)
+				return E_OK ;
+			if (p[0] == CHAR_MINUS && p[1] == CHAR_MINUS)
+				{ nUsed += 2 ; m_nMpState = MP_EPILOGUE ; break ; }
+			if (!(i = HttpScan(p, p + n, CHAR_NL)))
+			{
+				if (n < 80)
+					return E_OK ;
+				m_pCx->m_Track.Error("_mpparse: Malformed multipart form submission (delimiter)") ;
+				return E_FORMAT ;
+			}
+			nUsed += (i - p) + 1 ;
+			m_nMpState = MP_HEADERS ;
+			break ;
+
+		case MP_HEADERS:	//	The part headers end with a blank line
+			if (n < 2)
+				return E_OK ;
+			if (p[0] == CHAR_CR && p[1] == CHAR_NL)
+				i = p - 2 ;
+			else if (!(i = (const char*) memmem(p, n, "\r\n\r\n", 4)))
+				return E_OK ;
+
+			_partstart(p, (i - p) + 2) ;
+			nUsed += (i - p) + 4 ;
+			m_nMpState = MP_DATA ;
+			break ;
+
+		case MP_DATA:		//	The part data ends with the delimiter
+			if ((i = (const char*) memmem(p, n, *m_Boundary, nDelim)))
+			{
+				if ((rc = _partdata(p, i - p)) != E_OK)
+					return rc ;
+				if ((rc = _partend()) != E_OK)
+					return rc ;
+				nUsed += (i - p) + nDelim ;
+				m_nMpState = MP_BOUNDARY ;
+				break ;
+			}
+
+			if (n >= nDelim)
+			{
+				if ((rc = _partdata(p, n - (nDelim - 1))) != E_OK)
+					return rc ;
+				nUsed += n - (nDelim - 1) ;
+			}
+			return E_OK ;
+
+		default:			//	Anything after the last delimiter is ignored
+			nUsed = nLen ;
+			return E_OK ;
+		}
 	}
 
 	return E_OK ;
 }
 
-hzEcode	hzHttpEvent::GetVar	(hzChain& Z, const hzString& name)
+hzEcode	hzHttpEvent::SetUploads	(const hzString& tmpDir, uint32_t nSpill)
 {
-	//	Append the supplied chain assumed to be HTML output, with the value found in the variable of the supplied name
+	//	Category:	Internet
 	//
-	//	Arguments:	1)	Z		The chain to be aggregated with the variable's value
-	//				2)	name	Of the variable to evaluate
+	//	Set the directory for temporary files of uploads and the size above which uploaded files are written to them rather than held in memory. This
+	//	applies to all HTTP connections and should be called before serving begins.
 	//
-	//	Returns:	E_ARGUMENT	If a variable name is not supplied
-	//				E_NOTFOUND	If the named varaible is not found in the event handler's maps
-	//				E_OK		If the named variable is appended to the HTML output
+	//	Arguments:	1)	tmpDir	Directory for temporary files (default /tmp)
+	//				2)	nSpill	Size above which uploaded files are spilled (default HZ_UPLOAD_SPILL)
+	//
+	//	Returns:	E_ARGUMENT	If no directory is supplied
+	//				E_NOTFOUND	If the directory does not exist
+	//				E_OK		If the settings are applied
 
-	_hzfunc("hzHttpEvent::GetVar") ;
+	_hzfunc("hzHttpEvent::SetUploads") ;
 
-	if (!name)
-		return E_ARGUMENT ;
+	struct stat	fs ;	//	File status
 
-	if (m_mapStrings.Exists(name))	{ Z << m_mapStrings[name] ; return E_OK ; }
-	if (m_mapChains.Exists(name))	{ Z << m_mapChains[name] ; return E_OK ; }
+	if (!tmpDir)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No directory supplied") ;
+	if (stat(*tmpDir, &fs) < 0 || !S_ISDIR(fs.st_mode))
+		return hzerr(_fn, HZ_ERROR, E_NOTFOUND, "No such directory as %s", *tmpDir) ;
+
+	s_uploadDir = tmpDir ;
+	s_nUploadSpill = nSpill ;
+	return E_OK ;
+}
+
+hzEcode	hzHttpFile::Content	(hzChain& Z) const
+{
+	//	Category:	Internet
+	//
+	//	Obtain the content of an uploaded file, reading it from the temporary file if it was spilled to disk.
+	//
+	//	Arguments:	1)	Z	The chain populated with the file content
+	//
+	//	Returns:	E_OPENFAIL	If the temporary file could not be read
+	//				E_OK		If the content was obtained
+
+	_hzfunc("hzHttpFile::Content") ;
+
+	ifstream	is ;	//	Temporary file
+
+	Z.Clear() ;
+	if (!m_path)
+		{ Z = m_file ; return E_OK ; }
+
+	is.open(*m_path) ;
+	if (is.fail())
+		return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Could not open upload %s", *m_path) ;
+	Z << is ;
+	is.close() ;
+	return E_OK ;
+}
+
+hzEcode	hzHttpFile::SaveAs	(const hzString& path)
+{
+	//	Category:	Internet
+	//
+	//	Write an uploaded file to the supplied path. A file spilled to disk is moved there if possible rather than copied. Note that once moved, the file
+	//	content is no longer available from this hzHttpFile.
+	//
+	//	Arguments:	1)	path	Full pathname of target file
+	//
+	//	Returns:	E_ARGUMENT	If no path is supplied
+	//				E_OPENFAIL	If the target could not be opened or the temporary file read
+	//				E_WRITEFAIL	If the target could not be written
+	//				E_OK		If the file was saved
+
+	_hzfunc("hzHttpFile::SaveAs") ;
+
+	ofstream	os ;	//	Target file
+	hzChain		Z ;		//	Content (if copied)
+	hzEcode		rc ;	//	Return code
+
+	if (!path)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No path supplied") ;
+
+	if (m_path && rename(*m_path, *path) == 0)
+		{ m_path.Clear() ; return E_OK ; }
+
+	if ((rc = Content(Z)) != E_OK)
+		return rc ;
+
+	os.open(*path) ;
+	if (os.fail())
+		return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Could not open %s for writing", *path) ;
+	os << Z ;
+	if (os.fail())
+		rc = hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Could not write %s", *path) ;
+	os.close() ;
+	return rc ;
+}
+
+hzEcode	hzHttpEvent::Storeform	(const char* cpPath)
+{
+	//	Appends submitted forms to a file of the supplied pathname. This is quite separate from any processing of the form by the application.
+	//	This can be convient for diagnostics or even serve as a rudimantry form of backup.
+	//
+	//	Arguments:	1)	cpPath	Filename to store form submissions
+	//
+	//	Returns:	E_ARGUMENT	If the pathname is not supplied
+	//				E_OPENFAIL	If the store form file cannot be opened for writing
+	//				E_WRITEFAIL	If a write error occurs
+	//				E_OK		If the form submission was stored
+
+	_hzfunc("hzHttpEvent::Storeform") ;
+
+	static	char cvLine [80] ;	//	Buffer for time stamp and field id
+
+	std::ofstream	os ;		//	Output file for form submission storage
+
+	hzPair		P ;				//	Field name/value pair
+	hzXDate		now ;			//	System time stamp
+	uint32_t	nIndex ;		//	Field iterator
+
+	if (!cpPath || !cpPath[0])
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No pathname supplied\n") ;
+
+	os.open(cpPath, std::ios::app) ;
+	if (os.fail())
+		return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Could not open file (%s) for writing\n", cpPath) ;
+
+	now.SysDateTime() ;
+	sprintf(cvLine, "@Date: %04d%02d%02d\n", now.Year(), now.Month(), now.Day()) ;
+	os << cvLine ;
+
+	sprintf(cvLine, "@Time: %02d%02d%02d\n", now.Hour(), now.Min(), now.Sec()) ;
+	os << cvLine ;
+
+	for (nIndex = 0 ; GetAt(P, nIndex) == E_OK ; nIndex++)
+	{
+		if (P.name && P.value)
+			os << "@" << P.name << ":\t" << P.value << "\n" ;
+
+		if (os.fail())
+		{
+			os.close() ;
+			return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "_storeform: Write error on file (%s)\n", cpPath) ;
+		}
+	}
+
+	os << "@end:\n\n" ;
+	os.close() ;
+	return E_OK ;
+}
+
+hzEcode	_storeform	(hzHttpEvent* pE, FILE* fp)
+{
+	//	This stores forms submitted by HTTP clients in the supplied file. This is essentially for diagnostics and more formal mathods
+	//	are recomended for the operation of an Internet based application.
+	//
+	//	Arguments:	1)	cpPath	Filename to store form submissions
+	//				2)	fp		FILE pointer (to open file)
+	//
+	//	Returns:	E_NOTOPEN	If the store form file pointer is not supplied
+	//				E_WRITEFAIL	If a write error occurs
+	//				E_OK		If the form submission was stored
+
+	_hzfunc("_storeform") ;
+
+	hzPair		P ;				//	Field name/value pair
+	hzXDate		now ;			//	System time stamp
+	uint32_t	nIndex ;		//	Field iterator
+
+	if (!fp)
+		return E_NOTOPEN ;
+
+	now.SysDateTime() ;
+	if (fprintf(fp, "%04d%02d%02d-%02d%02d%02d\n", now.Year(), now.Month(), now.Day(), now.Hour(), now.Min(), now.Sec()) == -1)
+		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "_storeform: Write error on file (1)") ;
+
+	for (nIndex = 1 ; pE->GetAt(P, nIndex) == E_OK ; nIndex++)
+	{
+		if (fprintf(fp, "@%s:\t%s\n", *P.name, *P.value) == -1)
+			return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "_storeform: Write error on file (2)") ;
+	}
+
+	fflush(fp) ;
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::SetHdr	(const hzString& name, const hzString& value)
+{
+	//	Set a variable to be transmitted as a name/value pair in the header of the HTTP response. With suitable JavaScript in the response page or article, this
+	//	variable can influence what is displayed.
+	//
+	//	This allows a page that is otherwise fixed, to have different manifestations to different users. Normally, the only way to do this is by having the page
+	//	generated each time it is requested. A fixed content page or article can be pre-zipped so is quicker to serve and consumes less bandwidth.
+	//
+	//	Arguments:	1)	name	The header parameter name.
+	//				2)	value	The header parameter value.
+	//
+	//	Returns:	E_ARGUMENT	If provided with blank variable name.
+	//				E_NODATA	If no value is supplied..
+	//				E_OK		If operation successful.
+
+	_hzfunc("hzHttpEvent::SetHdr") ;
+
+	hzPair	p ;		//	Header name/value pair
+
+	if (!name)
+		return E_ARGUMENT ;
+	if (!value)
+		return E_NODATA ;
+
+	p.name = name ;
+	p.value = value ;
+	m_HdrsResponse.Add(p) ;
+
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::SetVarString	(const hzString& name, const hzString& value)
+{
+	//	Sets a string value to the supplied value and places it in the hzHttpEvent's map of string values. Note that if there is a chain value
+	//	of the same name, this is not allowed.
+	//
+	//	Note that the hzHttpEvent is very short lived. An instance is populated by a HTTP request, passed to the event handler ProcHTTP(), which processes it to
+	//	formulate a response. Then one of its member functions is called to write out that response to the client socket. The only purpose in setting a value in
+	//	the event's m_mapStrings member, is to influence the output by means of a percent-entity of the form [%e:var_name;] that is assumed to exist in the page
+	//	template being served.
+	//
+	//	Arguments:	1)	name	The variable name.
+	//				2)	value	The variable value as a string
+	//
+	//	Returns:	E_ARGUMENT	If the name is not supplied
+	//				E_DUPLICATE	If the name is already used
+	//				E_OK		If the variable was added
+
+	_hzfunc("hzHttpEvent::SetVariable[2]") ;
+
+	if (!name)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Blank variable names are not allowed") ;
+
+	if (m_mapStrings.Exists(name))
+		m_mapStrings[name] = value ;
+	else
+	{
+		if (m_mapChains.Exists(name))
+			return hzerr(_fn, HZ_ERROR, E_DUPLICATE, "Cannot assign value to an existing chain") ;
+
+		if (m_mapStrings.Insert(name, value) != E_OK)
+			return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not insert variable %s", *name) ;
+	}
+
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::SetVarChain	(const hzString& name, const hzChain& Z)
+{
+	//	Sets a chain value to the supplied chain and places it in the hzHttpEvent's map of chain values. Note that if there is a string value
+	//	of the same name, this is not allowed.
+	//
+	//	Note that the hzHttpEvent is very short lived. An instance is populated by a HTTP request, passed to the event handler ProcHTTP(), which processes it to
+	//	formulate a response. Then one of its member functions is called to write out that response to the client socket. The only purpose in setting a value in
+	//	the event's m_mapChains member, is to influence the output by means of a percent-entity of the form [%e:var_name;] that is assumed to exist in the page
+	//	template being served.
+	//
+	//	Arguments:	1)	name	The variable name.
+	//				2)	value	The variable value as a string
+	//
+	//	Returns:	E_ARGUMENT	If the name is not supplied
+	//				E_DUPLICATE	If the name is already used
+	//				E_OK		If the variable was added
+
+	_hzfunc("hzHttpEvent::SetVar(chain)") ;
+
+	if (!name)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Blank variable names are not allowed") ;
+
+	if (m_mapChains.Exists(name))
+	{
+		m_mapChains[name].Clear() ;
+		m_mapChains[name] = Z ;
+	}
+	else
+	{
+		if (m_mapStrings.Exists(name))
+			return hzerr(_fn, HZ_ERROR, E_DUPLICATE, "Cannot assign value to an existing string") ;
+
+		if (m_mapChains.Insert(name, Z) != E_OK)
+			return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not insert variable %s", *name) ;
+	}
+
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::GetVar	(hzChain& Z, const hzString& name)
+{
+	//	Append the supplied chain assumed to be HTML output, with the value found in the variable of the supplied name
+	//
+	//	Arguments:	1)	Z		The chain to be aggregated with the variable's value
+	//				2)	name	Of the variable to evaluate
+	//
+	//	Returns:	E_ARGUMENT	If a variable name is not supplied
+	//				E_NOTFOUND	If the named varaible is not found in the event handler's maps
+	//				E_OK		If the named variable is appended to the HTML output
+
+	_hzfunc("hzHttpEvent::GetVar") ;
+
+	if (!name)
+		return E_ARGUMENT ;
+
+	if (m_mapStrings.Exists(name))	{ Z << m_mapStrings[name] ; return E_OK ; }
+	if (m_mapChains.Exists(name))	{ Z << m_mapChains[name] ; return E_OK ; }
+
+	return E_NOTFOUND ;
+}
+
+void	hzHttpEvent::_acceptcode	(const char* pVal, uint32_t nLen)
+{
+	//	Establish from the Accept-Encoding header, the content codings acceptable to the client and which of these to prefer. Each coding listed may have a
+	//	quality value (q=0 to q=1, default 1) and one of 0 excludes it. An asterisk stands for any coding not listed. The coding preferred is the acceptable
+	//	one with the highest quality value that has an encoder. Where there is a tie, the later coding in hzContentCoding is preferred, so br before zstd and
+	//	zstd before gzip.
+	//
+	//	Arguments:	1)	pVal	The header value (need not be null terminated)
+	//				2)	nLen	Length of value
+	//
+	//	Returns:	None
+
+	const char*	pEnd ;						//	End of header value
+	const char*	pTok ;						//	Start of coding name
+	uint32_t	qval[CONTENT_CODINGS] ;		//	Quality values (in thousandths) of codings listed
+	uint32_t	nStar ;						//	Quality value of the asterisk (if listed)
+	uint32_t	nTok ;						//	Length of coding name
+	uint32_t	q ;							//	Quality value of coding
+	uint32_t	nBest ;						//	Highest quality value found
+	uint32_t	n ;							//	Coding iterator
+	uint32_t	x ;							//	Digit count
+	hzContentCoding	eCoding ;				//	Coding listed
+
+	for (n = 0 ; n < CONTENT_CODINGS ; n++)
+		qval[n] = 0xffffffff ;
+	nStar = 0xffffffff ;
+
+	for (pEnd = pVal + nLen ; pVal < pEnd ;)
+	{
+		//	Coding name
+		for (; pVal < pEnd && (*pVal == CHAR_SPACE || *pVal == CHAR_TAB || *pVal == CHAR_COMMA) ; pVal++) ;
+		for (pTok = pVal ; pVal < pEnd && *pVal > CHAR_SPACE && *pVal != CHAR_COMMA && *pVal != CHAR_SCOLON ; pVal++) ;
+		nTok = pVal - pTok ;
+
+		//	Parameters of which only q is of interest
+		for (q = 1000 ; pVal < pEnd && *pVal != CHAR_COMMA ; pVal++)
+		{
+			if (*pVal != CHAR_SCOLON)
+				continue ;
+			for (pVal++ ; pVal < pEnd && (*pVal == CHAR_SPACE || *pVal == CHAR_TAB) ; pVal++) ;
+			if ((pEnd - pVal) < 3 || (pVal[0] | 0x20) != 'q' || pVal[1] != CHAR_EQUAL || !IsDigit(pVal[2]))
+				continue ;
+
+			q = pVal[2] == '0' ? 0 : 1000 ;
+			pVal += 3 ;
+			if (pVal < pEnd && *pVal == CHAR_PERIOD && !q)
+			{
+				for (pVal++, x = 100 ; x && pVal < pEnd && IsDigit(*pVal) ; pVal++, x /= 10)
+					q += (*pVal - '0') * x ;
+			}
+			pVal-- ;
+		}
+
+		if (!nTok)
+			continue ;
+
+		if (nTok == 1 && *pTok == CHAR_ASTERISK)
+			nStar = q ;
+		else
+		{
+			eCoding = ContentCodingId(pTok, nTok) ;
+			if (eCoding < CONTENT_CODINGS)
+				qval[eCoding] = q ;
+		}
+	}
+
+	//	Codings not listed are acceptable only by the asterisk, except for the identity which is acceptable (at the lowest preference) unless excluded
+	m_nCodings = 0 ;
+	m_eCoding = CONTENT_IDENTITY ;
+
+	for (nBest = 0, n = CONTENT_IDENTITY ; n < CONTENT_CODINGS ; n++)
+	{
+		q = qval[n] != 0xffffffff ? qval[n] : nStar != 0xffffffff ? nStar : n == CONTENT_IDENTITY ? 1 : 0 ;
+		if (!q)
+			continue ;
+
+		m_nCodings |= (1 << n) ;
+		if (q >= nBest && ContentCodingOK((hzContentCoding) n))
+			{ nBest = q ; m_eCoding = (hzContentCoding) n ; }
+	}
+
+	m_bZipped = m_nCodings & (1 << CONTENT_GZIP) ? true : false ;
+}
+
+hzEcode	hzHttpEvent::_formhead	(hzChain& Z, HttpRC hrc, hzMimetype mtype, uint32_t nSize, uint32_t nExpires, hzContentCoding eCoding)
+{
+	//	Formulate HTTP header for outgoing response.
+	//
+	//	Arguments:	1) Z			The chain to aggregate to
+	//				2) hrc			The HTTP return code
+	//				3) mtype		The MIME type
+	//				4) nSize		The size (content length) or HZ_HTTP_CHUNKED if the content is to be sent in chunks (see SendChunkHead)
+	//				5) nExpires		The number of seconds the page should be considered valid for by the browser (if any)
+	//				6) eCoding		The content coding of the yet to be attached content
+	//
+	//	Returns:	E_ARGUMENT	If sent an invalid HTTP return code
+	//				E_OK			If the operation was successful
+
+	_hzfunc("hzHttpEvent::_formhead") ;
+
+	hzXDate		now ;	//	For header dates
+	hzString	S ;		//	Temp string
+
+	Z.Clear() ;
+
+	switch	(hrc)
+	{
+	case HTTPMSG_SWITCHING_PROTOCOLS:		Z << "HTTP/1.1 101 Switching Protocols\r\n" ;		break ;
+	case HTTPMSG_OK:						Z << "HTTP/1.1 200 OK\r\n" ;						break ;
+	case HTTPMSG_NOCONTENT:					Z << "HTTP/1.1 204 OK\r\n" ;						break ;
+	case HTTPMSG_PARTIAL_CONTENT:			Z << "HTTP/1.1 206 Partial Content\r\n" ;			break ;
+
+	//	Request is OK but no page supplied because ...
+	case HTTPMSG_REDIRECT_PERM:				Z << "HTTP/1.1 301 Temp Redirect\r\n" ;				break ;
+	case HTTPMSG_FOUND_GOTO:				Z << "HTTP/1.1 301 Found\r\n" ;						break ;
+	case HTTPMSG_NOT_MODIFIED:				Z << "HTTP/1.1 304 Not Modified\r\n" ;				break ;
+	case HTTPMSG_REDIRECT_TEMP:				Z << "HTTP/1.1 307 Temp Redirect\r\n" ;				break ;
+
+	//	Errors in Request (not found or otherwise denied)
+	case HTTPMSG_BAD_REQUEST:				Z << "HTTP/1.1 400 Bad Request\r\n" ;				break ;
+	case HTTPMSG_UNAUTHORIZED:				Z << "HTTP/1.1 401 Unauthorized\r\n" ;				break ;
+	case HTTPMSG_FORBIDDEN:					Z << "HTTP/1.1 403 Forbidden\r\n" ;					break ;
+	case HTTPMSG_NOTFOUND:					Z << "HTTP/1.1 404 Not found\r\n" ;					break ;
+	case HTTPMSG_METHOD_NOT_ALLOWED:		Z << "HTTP/1.1 405 Not Allowed\r\n" ;				break ;
+	case HTTPMSG_REQUEST_TIME_OUT:			Z << "HTTP/1.1 408 Request Timed Out\r\n" ;			break ;
+	case HTTPMSG_GONE:						Z << "HTTP/1.1 410 Page Gone\r\n" ;					break ;
+	case HTTPMSG_LENGTH_REQUIRED:			Z << "HTTP/1.1 411 Length Required\r\n" ;			break ;
+	case HTTPMSG_PRECONDITION_FAILED:		Z << "HTTP/1.1 412 Precondition Failed\r\n" ;		break ;
+	case HTTPMSG_ENTITY_TOO_LARGE:			Z << "HTTP/1.1 413 Entity Too Large\r\n" ;			break ;
+	case HTTPMSG_REQUEST_URI_TOO_LARGE:		Z << "HTTP/1.1 414 URI Too Large\r\n" ;				break ;
+	case HTTPMSG_UNSUPPORTED_MEDIA_TYPE:	Z << "HTTP/1.1 415 Unsupported Media Type\r\n" ;	break ;
+	case HTTPMSG_RANGE_NOT_SATISFIABLE:		Z << "HTTP/1.1 416 Range Not Satisfiable\r\n" ;	break ;
+	case HTTPMSG_UPGRADE_REQUIRED:			Z << "HTTP/1.1 426 Upgrade Required\r\n" ;		break ;
+
+	//	System Errors. Can't help you regardless of how reasonable the request!
+	case HTTPMSG_INTERNAL_SERVER_ERROR:		Z << "HTTP/1.1 500 Internal Server Error\r\n" ;		break ;
+	case HTTPMSG_NOT_IMPLEMENTED:			Z << "HTTP/1.1 501 Not Implimented\r\n" ;			break ;
+	case HTTPMSG_BAD_GATEWAY:				Z << "HTTP/1.1 502 Bad Gateway\r\n" ;				break ;
+	case HTTPMSG_SERVICE_UNAVAILABLE:		Z << "HTTP/1.1 503 Service Unavailable\r\n" ;		break ;
+	case HTTPMSG_VARIANT_ALSO_VARIES:		Z << "HTTP/1.1 506 Variant Also Varies\r\n" ;		break ;
+
+	default:
+		m_Error.Printf("Invalid HTTP return code (%d)\n", (uint32_t) hrc) ;
+		return E_ARGUMENT ;
+	} ;
+
+	now.SysDateTime() ;
+	S = now.Str(FMT_DT_INET) ;
+
+	if (!_hzGlobal_runstart)
+		_hzGlobal_runstart = S ;
+
+	Z << "Date: " << S << "\r\n" ;
+	Z << "Server: HTTP/1.1 (HadronZoo::Dissemino 9.7, Linux)\r\n" ;
+
+	//	Static resources (see _sendEntity) have a modification time of their own, otherwise the content is deemed to have been modified at startup
+	if (m_nModOut)
+		{ Z << "Last-Modified: " ; _httpdatestr(Z, m_nModOut) ; Z << "\r\n" ; }
+	else
+		Z << "Last-Modified: " << _hzGlobal_runstart << "\r\n" ;
+
+	if (!nExpires)
+	{
+		Z << "Pragma: No-cache\r\n" ;
+		Z << "Cache-Control: no-cache\r\n" ;
+		Z << "Expires: 0\r\n" ;
+	}
+	else
+	{
+		now.altdate(SECOND, nExpires) ;
+		S = now.Str(FMT_DT_INET) ;
+		Z.Printf("Expires: %s\r\n", *S) ;
+	}
+	now.altdate(SECOND, -10000000) ;
+
+	//	If there is a cookie being sent by the browser which is no longer in use this is deleted by DelSessCookie() which sets m_CookieOld to the redundant
+	//	submited cookie. Thus if m_CookieOld is set we tell the browser to delete it here
+	if (m_CookieOld && _hzGlobal_Dissemino)
+	{
+		if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+			threadLog("Expiring old cookie %016X\n", m_CookieOld) ;
+		//Z.Printf("Set-Cookie: %s=%016X; path=/; expires: %s\r\n", *_hzGlobal_HtmlApp->m_CookieName, m_CookieOld, *now.Str(FMT_DT_INET)) ;
+		Z.Printf("Set-Cookie: %s=%016X; path=/; expires: %s\r\n", *_hzGlobal_Dissemino->m_CookieName, m_CookieOld, *now.Str(FMT_DT_INET)) ;
+	}
+
+	//	Send a new session cookie
+	if (m_CookieNew && _hzGlobal_Dissemino)
+	{
+		//	If there is a cookie from the browser and it does not agree with a new cookie from the server, give the directive to the browser to delete it.
+		if (m_CookieSub && (m_CookieNew != m_CookieSub))
+		{
+			if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+				threadLog("Expiring cookie %016X and setting cookie %016x\n", m_CookieSub, m_CookieNew) ;
+			//Z.Printf("Set-Cookie: %s=%016X; path=/; expires: %s\r\n", *_hzGlobal_HtmlApp->m_CookieName, m_CookieOld, *now.Str(FMT_DT_INET)) ;
+			Z.Printf("Set-Cookie: %s=%016X; path=/; expires: %s\r\n", *_hzGlobal_Dissemino->m_CookieName, m_CookieOld, *now.Str(FMT_DT_INET)) ;
+		}
+		//Z.Printf("Set-Cookie: %s=%016X; path=/\r\n", *_hzGlobal_HtmlApp->m_CookieName, m_CookieNew) ;
+		Z.Printf("Set-Cookie: %s=%016X; path=/\r\n", *_hzGlobal_Dissemino->m_CookieName, m_CookieNew) ;
+	}
+
+	//	Send the content location if app has set URI
+	if (m_Redirect)
+	{
+		if (hrc == HTTPMSG_FOUND_GOTO)
+			Z.Printf("Location: %s\r\n", *m_Redirect) ;
+		else
+			Z.Printf("Content-Location: %s\r\n", *m_Redirect) ;
+	}
+
+	Z << "Accept-Ranges: bytes\r\n" ;
+
+	if (m_ETagOut)
+		Z << "ETag: " << m_ETagOut << "\r\n" ;
+	if (m_RangeOut)
+		Z << "Content-Range: " << m_RangeOut << "\r\n" ;
+
+	if (eCoding != CONTENT_IDENTITY)
+	{
+		Z << "Content-Encoding: " << ContentCodingName(eCoding) << "\r\n" ;
+		Z << "Vary: Accept-Encoding\r\n" ;
+	}
+
+	//	A response of unknown length is sent in chunks, except to a HTTP/1.0 client which can only be told the response is complete by closing the connection.
+	//	A 304 response has no body and so no length.
+	if (hrc != HTTPMSG_NOT_MODIFIED)
+	{
+		if (nSize != HZ_HTTP_CHUNKED)
+			Z.Printf("Content-Length: %d\r\n", nSize) ;
+		else if (m_nVersion)
+			Z << "Transfer-Encoding: chunked\r\n" ;
+		else
+			m_nConnection = 0 ;
+	}
+
+	if (m_LangCode)
+		Z.Printf("Content-Language: %s\r\n", *m_LangCode) ;
+	else
+		Z.Printf("Content-Language: en-US\r\n") ;
+
+	if (m_HdrsResponse.Count())
+	{
+		hzList<hzPair>::Iter	ip ;	//	Resident headers iterator
+
+		for (ip = m_HdrsResponse ; ip.Valid() ; ip++)
+		{
+			Z << ip.Element().name ;
+			Z << ": " ;
+			Z << ip.Element().value ;
+			Z << "\r\n" ;
+		}
+	}
+
+	if (!m_nConnection)
+		Z << "Connection: close\r\n" ;
+	else
+	{
+		Z << "Connection: keep-alive\r\n" ;
+		Z.Printf("Keep-Alive: timeout=%u\r\n", m_nConnection) ;
+	}
+
+	if (m_RangeSep)
+		Z << "Content-Type: multipart/byteranges; boundary=" << m_RangeSep << "\r\n" ;
+	else
+		Z << "Content-Type: " << Mimetype2Txt(mtype) << "\r\n" ;
+	Z << "X-Powered-By: HadronZoo::Dissemino 9.6\r\n\r\n" ;
+
+	if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+		threadLog(Z) ;
+
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::SendRawChain	(HttpRC hrc, hzMimetype type, const hzChain& Data, uint32_t nExpires, hzContentCoding eCoding)
+{
+	//	Compile a send a HTML response to the HTTP client. The HTML page content is supplied as a hzChain
+	//
+	//	Arguments:	1)	hrc			The HTTP return code to appear in the header.
+	//				2)	type		The MIME type of HTTP message
+	//				3)	Data		The page content
+	//				4)	nExpires	The expiry time for the page
+	//				5)	eCoding		The content coding of the page content (as stored, this function does not encode). It sets the Content-Encoding header.
+	//
+	//	Returns:	E_ARGUMENT	If any of the arguments are invalid
+	//				E_WRITEFAIL	If the HTTP response could not be sent to the browser.
+	//				E_OK		If the operation was successful.
+	//
+
+	_hzfunc("hzHttpEvent::SendRawChain") ;
+
+	hzChain	Z ;		//	For building header
+	hzEcode	rc ;	//	Return code
+
+	rc = _formhead(Z, hrc, type, Data.Size(), nExpires, eCoding) ;
+	if (rc != E_OK)
+		return hzerr(_fn, HZ_ERROR, rc, "Could not formulate HTTP header (sock=%d)", m_pCx->CliSocket()) ;
+
+	//Z << Data ;
+	if (m_pCx->SendData(Z, Data) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Event %p Failed to send response (size=%d + %d, sock=%d)", this, Z.Size(), Data.Size(), m_pCx->CliSocket()) ;
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::SendRawString	(HttpRC hrc, hzMimetype type, const hzString& Content, uint32_t nExpires, bool bZip)
+{
+	//	Compile a send a HTML response to the HTTP client. The HTML page content is supplied as a hzString
+	//
+	//	Arguments:	1)	hrc			The HTTP return code to appear in the header.
+	//				2)	type		The MIME type of HTTP message
+	//				3)	Contyent	The page content
+	//				4)	nExpires	The expiry time for the page
+	//				5)	bZip		A boolean flag to indicate if the content has been zipped. It sets an indicator in the outgoing header.
+	//
+	//	Returns:	E_ARGUMENT	If any of the arguments are invalid
+	//				E_WRITEFAIL	If the HTTP response could not be sent to the browser.
+	//				E_OK		If the operation was successful.
+	//
+	//	Note:		This function is deprecated. Please use hzHttpEvent::SendRawChain instead
+
+	_hzfunc("hzHttpEvent::SendRawString") ;
+
+	hzChain	Z ;		//	For building header
+	hzEcode	rc ;	//	Return code
+
+	rc = _formhead(Z, hrc, type, Content.Length(), nExpires, bZip) ;
+	if (rc != E_OK)
+		return hzerr(_fn, HZ_ERROR, rc, "Could not formulate HTTP header (sock=%d)", m_pCx->CliSocket()) ;
+
+	Z << Content ;
+
+	if (m_pCx->SendData(Z) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "hzHttpEvent %p Failed to send response (size=%d, sock=%d)", this, Z.Size(), m_pCx->CliSocket()) ;
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::SendChunkHead	(HttpRC hrc, hzMimetype type, uint32_t nExpires, bool bZip)
+{
+	//	Begin a response of unknown length, to be sent in chunks (Transfer-Encoding: chunked) by SendChunk() and ended by SendChunkEnd(). This allows output to
+	//	be sent as it is produced rather than all at once when complete, which is of benefit where the output is large and slow to produce. As a HTTP/1.0
+	//	client does not understand chunks, in that case the content is sent as it is and the connection closed to end the response.
+	//
+	//	Arguments:	1)	hrc			The HTTP return code to appear in the header.
+	//				2)	type		The MIME type of HTTP message
+	//				3)	nExpires	The expiry time for the page
+	//				4)	bZip		A boolean flag to indicate if the content has been zipped. It sets an indicator in the outgoing header.
+	//
+	//	Returns:	E_ARGUMENT	If any of the arguments are invalid
+	//				E_SEQUENCE	If a chunked response is already in progress
+	//				E_WRITEFAIL	If the HTTP header could not be sent to the browser.
+	//				E_OK		If the operation was successful.
+
+	_hzfunc("hzHttpEvent::SendChunkHead") ;
+
+	hzChain	Z ;		//	For building header
+	hzEcode	rc ;	//	Return code
+
+	if (m_bChunkOut)
+		return hzerr(_fn, HZ_ERROR, E_SEQUENCE, "Chunked response already begun (sock=%d)", m_pCx->CliSocket()) ;
+
+	rc = _formhead(Z, hrc, type, HZ_HTTP_CHUNKED, nExpires, bZip) ;
+	if (rc != E_OK)
+		return hzerr(_fn, HZ_ERROR, rc, "Could not formulate HTTP header (sock=%d)", m_pCx->CliSocket()) ;
+
+	if (m_pCx->SendData(Z) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Event %p Failed to send response header (sock=%d)", this, m_pCx->CliSocket()) ;
+
+	m_bChunkOut = true ;
+	m_nChunksOut = 0 ;
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::SendChunk	(const hzChain& Data)
+{
+	//	Send the next chunk of a response begun by SendChunkHead(). The CR/NL ending each chunk is sent ahead of the size of the next, so the size line and the
+	//	data are the only two pieces queued per chunk. Empty data is not sent, as a zero length chunk would end the response.
+	//
+	//	Arguments:	1)	Data	The chunk content
+	//
+	//	Returns:	E_SEQUENCE	If no chunked response is in progress
+	//				E_WRITEFAIL	If the chunk could not be sent to the browser (so the generator need go no further).
+	//				E_OK		If the operation was successful.
+
+	_hzfunc("hzHttpEvent::SendChunk") ;
+
+	hzChain	Z ;		//	For building chunk size line
+
+	if (!m_bChunkOut)
+		return hzerr(_fn, HZ_ERROR, E_SEQUENCE, "No chunked response begun (sock=%d)", m_pCx->CliSocket()) ;
+
+	if (!Data.Size())
+		return E_OK ;
+
+	if (m_pCx->IsCliBad())
+		return E_WRITEFAIL ;
+
+	if (m_nVersion)
+	{
+		if (m_nChunksOut)
+			Z << "\r\n" ;
+		Z.Printf("%x\r\n", Data.Size()) ;
+	}
+	m_nChunksOut++ ;
+
+	if (m_pCx->SendData(Z, Data) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Event %p Failed to send chunk %u (size=%d, sock=%d)", this, m_nChunksOut, Data.Size(), m_pCx->CliSocket()) ;
+
+	m_pCx->Flush() ;
+	return E_OK ;
+}
+
+hzEcode	hzHttpEvent::SendChunkEnd	(void)
+{
+	//	End a response begun by SendChunkHead() by sending the zero length chunk. Nothing is sent to a HTTP/1.0 client as the connection is to be closed.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	E_SEQUENCE	If no chunked response is in progress
+	//				E_WRITEFAIL	If the last chunk could not be sent to the browser.
+	//				E_OK		If the operation was successful.
+
+	_hzfunc("hzHttpEvent::SendChunkEnd") ;
+
+	hzChain	Z ;		//	For building last chunk
+
+	if (!m_bChunkOut)
+		return hzerr(_fn, HZ_ERROR, E_SEQUENCE, "No chunked response begun (sock=%d)", m_pCx->CliSocket()) ;
+	m_bChunkOut = false ;
+
+	if (!m_nVersion)
+		return E_OK ;
+
+	if (m_nChunksOut)
+		Z << "\r\n" ;
+	Z << "0\r\n\r\n" ;
+
+	if (m_pCx->SendData(Z) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Event %p Failed to send last chunk (sock=%d)", this, m_pCx->CliSocket()) ;
+	return E_OK ;
+}
+
+void	hzHttpEvent::StreamInit	(hzChain& Z, HttpRC hrc, hzMimetype type, uint32_t nExpires, bool bZip)
+{
+	//	Nominate the chain in which a generator builds a response, so that the response can be sent as it is built (see Stream). Nothing is sent at this
+	//	stage. A response that turns out to be small is sent whole by StreamEnd() with a Content-Length, exactly as by SendRawChain().
+	//
+	//	Arguments:	1)	Z			The chain the response is built in
+	//				2)	hrc			The HTTP return code to appear in the header.
+	//				3)	type		The MIME type of HTTP message
+	//				4)	nExpires	The expiry time for the page
+	//				5)	bZip		A boolean flag to indicate if the content has been zipped. It sets an indicator in the outgoing header.
+	//
+	//	Returns:	None
+
+	m_pStream = &Z ;
+	m_eStreamRC = hrc ;
+	m_eStreamType = type ;
+	m_nStreamExp = nExpires ;
+	m_bStreamZip = bZip ;
+}
+
+hzEcode	hzHttpEvent::Stream	(hzChain& Z)
+{
+	//	Send what has been built of a streamed response once it amounts to HZ_HTTP_STREAM bytes or more. The first time this happens the response is begun as
+	//	a chunked response. The chain is then cleared for the generator to continue. Generators of potentially large output (such as the rows of a table) may
+	//	call this freely as they go, as it does nothing unless the supplied chain is that nominated by StreamInit(). So output built in a chain that will be
+	//	wrapped or otherwise processed by the caller is never sent prematurely.
+	//
+	//	Arguments:	1)	Z	The chain the response is being built in
+	//
+	//	Returns:	E_WRITEFAIL	If the response could not be sent to the browser.
+	//				E_OK		If the operation was successful or nothing was sent.
+
+	_hzfunc("hzHttpEvent::Stream") ;
+
+	hzEcode	rc ;	//	Return code
+
+	if (&Z != m_pStream || Z.Size() < HZ_HTTP_STREAM)
+		return E_OK ;
+
+	if (!m_bChunkOut)
+	{
+		rc = SendChunkHead(m_eStreamRC, m_eStreamType, m_nStreamExp, m_bStreamZip) ;
+		if (rc != E_OK)
+			return rc ;
+	}
+
+	rc = SendChunk(Z) ;
+	Z.Clear() ;
+	return rc ;
+}
+
+hzEcode	hzHttpEvent::StreamEnd	(hzChain& Z)
+{
+	//	Complete a streamed response. If nothing has yet been sent, the response is sent whole. Otherwise the remainder is sent as the last chunk. Where the
+	//	generator produced nothing at all, nothing is sent so that the caller may send some other response.
+	//
+	//	Arguments:	1)	Z	The chain the response has been built in
+	//
+	//	Returns:	E_NODATA	If there is no response to send
+	//				E_WRITEFAIL	If the response could not be sent to the browser.
+	//				E_OK		If the operation was successful.
+
+	_hzfunc("hzHttpEvent::StreamEnd") ;
+
+	hzEcode	rc ;	//	Return code
+
+	m_pStream = 0 ;
+
+	if (!m_bChunkOut)
+	{
+		if (!Z.Size())
+			return E_NODATA ;
+		return SendRawChain(m_eStreamRC, m_eStreamType, Z, m_nStreamExp, m_bStreamZip) ;
+	}
+
+	rc = SendChunk(Z) ;
+	Z.Clear() ;
+	if (rc != E_OK)
+		return rc ;
+	return SendChunkEnd() ;
+}
+
+hzString	hzHttpEvent::MakeETag	(uint64_t nInode, uint64_t nSize, uint32_t nMtime)
+{
+	//	Category:	Internet
+	//
+	//	Form the entity tag of a static resource from the inode, size and modification time of the file it was read from. The tag changes whenever the file
+	//	is replaced or rewritten, so it can be used to validate copies cached by clients without reading the file.
+	//
+	//	Arguments:	1)	nInode	Inode number of file
+	//				2)	nSize	Size of file
+	//				3)	nMtime	Modification time of file
+	//
+	//	Returns:	Instance of hzString by value being the quoted entity tag
+
+	hzString	S ;			//	Entity tag
+	char		buf[64] ;	//	Formatted tag
+
+	sprintf(buf, "\"%llx-%llx-%x\"", (unsigned long long) nInode, (unsigned long long) nSize, nMtime) ;
+	S = buf ;
+	return S ;
+}
+
+bool	hzHttpEvent::_notmodified	(const hzString& etag, uint32_t nMtime)
+{
+	//	Determine if a GET or HEAD of a static resource is to be answered with 304 Not Modified. If-None-Match takes precedence over If-Modified-Since and
+	//	is matched by weak comparison, i.e. disregarding any W/ prefix of the tags listed by the client.
+	//
+	//	Arguments:	1)	etag	Entity tag of resource (quoted, may be empty)
+	//				2)	nMtime	Modification time of resource (0 if unknown)
+	//
+	//	Returns:	True	If the copy held by the client is current
+	//				False	Otherwise
+
+	const char*	i ;		//	If-None-Match iterator
+	const char*	j ;		//	End of tag
+
+	if (m_eMethod != HTTP_GET && m_eMethod != HTTP_HEAD)
+		return false ;
+
+	if (m_pETag)
+	{
+		if (!etag)
+			return false ;
+
+		for (i = m_pETag ; *i ;)
+		{
+			for (; *i == CHAR_SPACE || *i == CHAR_TAB || *i == CHAR_COMMA ; i++) ;
+			if (*i == CHAR_ASTERISK)
+				return true ;
+			if ((i[0] == 'W' || i[0] == 'w') && i[1] == CHAR_FWSLASH)
+				i += 2 ;
+
+			if (*i != CHAR_DQUOTE)
+			{
+				for (; *i && *i != CHAR_COMMA ; i++) ;
+				continue ;
+			}
+
+			j = strchr(i + 1, CHAR_DQUOTE) ;
+			if (!j)
+				break ;
+			j++ ;
+
+			if ((uint32_t) (j - i) == etag.Length() && !memcmp(i, *etag, j - i))
+				return true ;
+			i = j ;
+		}
+		return false ;
+	}
 
-	return E_NOTFOUND ;
+	return m_nIfModSince && nMtime && nMtime <= m_nIfModSince ;
 }
 
-hzEcode	hzHttpEvent::_formhead	(hzChain& Z, HttpRC hrc, hzMimetype mtype, uint32_t nSize, uint32_t nExpires, bool bZip)
+bool	hzHttpEvent::_ifrange	(const hzString& etag, uint32_t nMtime)
 {
-	//	Formulate HTTP header for outgoing response.
+	//	Determine if the Range header of a request is to be honoured. If the request has an If-Range header, the ranges only apply if the resource has not
+	//	changed since the client obtained the part it holds. If-Range gives either an entity tag, which must match by strong comparison, or a date which must
+	//	match the modification time exactly.
 	//
-	//	Arguments:	1) Z			The chain to aggregate to
-	//				2) hrc			The HTTP return code
-	//				3) mtype		The MIME type
-	//				4) nSize		The size (content length)
-	//				5) nExpires		The number of seconds the page should be considered valid for by the browser (if any)
-	//				6) bZip			A boolean directive to state if the yet to be attached content is zipped
+	//	Arguments:	1)	etag	Entity tag of resource (quoted, may be empty)
+	//				2)	nMtime	Modification time of resource (0 if unknown)
 	//
-	//	Returns:	E_ARGUMENT	If sent an invalid HTTP return code
-	//				E_OK			If the operation was successful
-
-	_hzfunc("hzHttpEvent::_formhead") ;
+	//	Returns:	True	If the ranges apply
+	//				False	If the whole resource is to be sent
 
-	hzXDate		now ;	//	For header dates
-	hzString	S ;		//	Temp string
-
-	Z.Clear() ;
+	if (!m_pIfRange)
+		return true ;
 
-	switch	(hrc)
-	{
-	case HTTPMSG_OK:						Z << "HTTP/1.1 200 OK\r\n" ;						break ;
-	case HTTPMSG_NOCONTENT:					Z << "HTTP/1.1 204 OK\r\n" ;						break ;
+	if (m_pIfRange[0] == CHAR_DQUOTE)
+		return etag && !strcmp(*etag, m_pIfRange) ;
 
-	//	Request is OK but no page supplied because ...
-	case HTTPMSG_REDIRECT_PERM:				Z << "HTTP/1.1 301 Temp Redirect\r\n" ;				break ;
-	case HTTPMSG_FOUND_GOTO:				Z << "HTTP/1.1 301 Found\r\n" ;						break ;
-	case HTTPMSG_NOT_MODIFIED:				Z << "HTTP/1.1 304 Not Modified\r\n" ;				break ;
-	case HTTPMSG_REDIRECT_TEMP:				Z << "HTTP/1.1 307 Temp Redirect\r\n" ;				break ;
+	return nMtime && _httpdate(m_pIfRange) == nMtime ;
+}
 
-	//	Errors in Request (not found or otherwise denied)
-	case HTTPMSG_BAD_REQUEST:				Z << "HTTP/1.1 400 Bad Request\r\n" ;				break ;
-	case HTTPMSG_UNAUTHORIZED:				Z << "HTTP/1.1 401 Unauthorized\r\n" ;				break ;
-	case HTTPMSG_FORBIDDEN:					Z << "HTTP/1.1 403 Forbidden\r\n" ;					break ;
-	case HTTPMSG_NOTFOUND:					Z << "HTTP/1.1 404 Not found\r\n" ;					break ;
-	case HTTPMSG_METHOD_NOT_ALLOWED:		Z << "HTTP/1.1 405 Not Allowed\r\n" ;				break ;
-	case HTTPMSG_REQUEST_TIME_OUT:			Z << "HTTP/1.1 408 Request Timed Out\r\n" ;			break ;
-	case HTTPMSG_GONE:						Z << "HTTP/1.1 410 Page Gone\r\n" ;					break ;
-	case HTTPMSG_LENGTH_REQUIRED:			Z << "HTTP/1.1 411 Length Required\r\n" ;			break ;
-	case HTTPMSG_PRECONDITION_FAILED:		Z << "HTTP/1.1 412 Precondition Failed\r\n" ;		break ;
-	case HTTPMSG_ENTITY_TOO_LARGE:			Z << "HTTP/1.1 413 Entity Too Large\r\n" ;			break ;
-	case HTTPMSG_REQUEST_URI_TOO_LARGE:		Z << "HTTP/1.1 414 URI Too Large\r\n" ;				break ;
-	case HTTPMSG_UNSUPPORTED_MEDIA_TYPE:	Z << "HTTP/1.1 415 Unsupported Media Type\r\n" ;	break ;
+hzEcode	hzHttpEvent::_sendEntity	(hzMimetype type, const hzChain* pData, const char* cpPath, uint32_t nSize, const hzString& etag, uint32_t nMtime, uint32_t nExpires, bool bZip)
+{
+	//	Send a static resource, either held in memory or to be drawn from a file, honouring conditional requests and byte ranges:-
+	//
+	//		1)	A GET or HEAD whose If-None-Match lists the entity tag, or failing an If-None-Match header, whose If-Modified-Since is no earlier than the
+	//			modification time, is answered with 304 and no body.
+	//
+	//		2)	A GET with a Range header (and an If-Range header if any, that is satisfied) is answered with 206 and the requested range, or where several
+	//			ranges are requested, with a multipart/byteranges body. A Range header in which no range lies within the resource is answered with 416.
+	//			Malformed Range headers and those asking for more than HZ_HTTP_MAXRANGES ranges or for more bytes than the resource has, are ignored.
+	//
+	//		3)	Otherwise the whole resource is sent with 200.
+	//
+	//	Byte ranges do not apply to zipped content, as they would be ranges of the zipped rather than the original bytes. The zipped content has an entity
+	//	tag of its own, formed by adding -gz to that of the resource, so it is not confused with the resource in caches.
+	//
+	//	Arguments:	1)	type		MIME type of resource
+	//				2)	pData		Content of resource (null if it is to be drawn from a file)
+	//				3)	cpPath		Pathname of file (null if the resource is in memory). If both pData and cpPath are null, only the header is sent.
+	//				4)	nSize		Size of resource
+	//				5)	etag		Entity tag of resource (may be empty)
+	//				6)	nMtime		Modification time of resource (0 if unknown)
+	//				7)	nExpires	Expiry time for the resource (for browser use only)
+	//				8)	bZip		Content is zipped
+	//
+	//	Returns:	E_OPENFAIL	If the file could not be opened
+	//				E_WRITEFAIL	If the response could not be sent
+	//				E_OK		If the response was sent
 
-	//	System Errors. Can't help you regardless of how reasonable the request!
-	case HTTPMSG_INTERNAL_SERVER_ERROR:		Z << "HTTP/1.1 500 Internal Server Error\r\n" ;		break ;
-	case HTTPMSG_NOT_IMPLEMENTED:			Z << "HTTP/1.1 501 Not Implimented\r\n" ;			break ;
-	case HTTPMSG_BAD_GATEWAY:				Z << "HTTP/1.1 502 Bad Gateway\r\n" ;				break ;
-	case HTTPMSG_SERVICE_UNAVAILABLE:		Z << "HTTP/1.1 503 Service Unavailable\r\n" ;		break ;
-	case HTTPMSG_VARIANT_ALSO_VARIES:		Z << "HTTP/1.1 506 Variant Also Varies\r\n" ;		break ;
+	_hzfunc("hzHttpEvent::_sendEntity") ;
 
-	default:
-		m_Error.Printf("Invalid HTTP return code (%d)\n", (uint32_t) hrc) ;
-		return E_ARGUMENT ;
-	} ;
+	_byteRange		ranges[HZ_HTTP_MAXRANGES] ;		//	Ranges requested
+	hzOutFile*		files[HZ_HTTP_MAXRANGES] ;		//	File sources of ranges
+	hzChain			parts[HZ_HTTP_MAXRANGES] ;		//	Headers of parts (multiple ranges)
 
-	now.SysDateTime() ;
-	S = now.Str(FMT_DT_INET) ;
+	hzChain		Z ;				//	Response header
+	hzChain		B ;				//	Response body (resource in memory)
+	hzChain		F ;				//	Content of small file
+	hzChain		W ;				//	Working chain
+	hzString	tag ;			//	Entity tag sent
+	HttpRC		hrc ;			//	HTTP return code
+	int32_t		nRanges = -1 ;	//	Number of ranges (-1 for the whole resource)
+	int32_t		n ;				//	Range iterator
+	uint32_t	nLen ;			//	Content length
+	hzEcode		rc ;			//	Return code
+
+	//	The zipped content is a different entity to the resource
+	tag = etag ;
+	if (bZip && tag.Length() > 1)
+	{
+		W.Append(*tag, tag.Length() - 1) ;
+		W << "-gz\"" ;
+		tag = W ;
+		W.Clear() ;
+	}
 
-	if (!_hzGlobal_runstart)
-		_hzGlobal_runstart = S ;
+	hrc = HTTPMSG_OK ;
+	nLen = nSize ;
 
-	Z << "Date: " << S << "\r\n" ;
-	Z << "Server: HTTP/1.1 (HadronZoo::Dissemino 9.7, Linux)\r\n" ;
-	Z << "Last-Modified: " << _hzGlobal_runstart << "\r\n" ;
+	if (_notmodified(tag, nMtime))
+		{ hrc = HTTPMSG_NOT_MODIFIED ; nLen = 0 ; }
+	else if (m_pRange && m_eMethod == HTTP_GET && !bZip && _ifrange(tag, nMtime))
+		nRanges = _ranges(ranges, m_pRange, nSize) ;
 
-	if (!nExpires)
+	if (nRanges == 0)
 	{
-		Z << "Pragma: No-cache\r\n" ;
-		Z << "Cache-Control: no-cache\r\n" ;
-		Z << "Expires: 0\r\n" ;
+		hrc = HTTPMSG_RANGE_NOT_SATISFIABLE ;
+		nLen = 0 ;
+		W.Printf("bytes */%u", nSize) ;
+		m_RangeOut = W ;
+		W.Clear() ;
 	}
-	else
+	else if (nRanges == 1)
 	{
-		now.altdate(SECOND, nExpires) ;
-		S = now.Str(FMT_DT_INET) ;
-		Z.Printf("Expires: %s\r\n", *S) ;
+		hrc = HTTPMSG_PARTIAL_CONTENT ;
+		nLen = ranges[0].m_nLen ;
+		W.Printf("bytes %u-%u/%u", ranges[0].m_nStart, ranges[0].m_nStart + ranges[0].m_nLen - 1, nSize) ;
+		m_RangeOut = W ;
+		W.Clear() ;
 	}
-	now.altdate(SECOND, -10000000) ;
-
-	//	If there is a cookie being sent by the browser which is no longer in use this is deleted by DelSessCookie() which sets m_CookieOld to the redundant
-	//	submited cookie. Thus if m_CookieOld is set we tell the browser to delete it here
-	if (m_CookieOld)
+	else if (nRanges > 1)
 	{
-		if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-			threadLog("Expiring old cookie %016X\n", m_CookieOld) ;
-		//Z.Printf("Set-Cookie: %s=%016X; path=/; expires: %s\r\n", *_hzGlobal_HtmlApp->m_CookieName, m_CookieOld, *now.Str(FMT_DT_INET)) ;
-		Z.Printf("Set-Cookie: %s=%016X; path=/; expires: %s\r\n", *_hzGlobal_Dissemino->m_CookieName, m_CookieOld, *now.Str(FMT_DT_INET)) ;
+		//	Each part has a header giving its range, and the parts are followed by the closing delimiter
+		hrc = HTTPMSG_PARTIAL_CONTENT ;
+		W.Printf("hzbr%x%x", (uint32_t) RealtimeNano(), nSize) ;
+		m_RangeSep = W ;
+		W.Clear() ;
+
+		for (nLen = 0, n = 0 ; n < nRanges ; n++)
+		{
+			parts[n] << "\r\n--" << m_RangeSep << "\r\nContent-Type: " << Mimetype2Txt(type) << "\r\n" ;
+			parts[n].Printf("Content-Range: bytes %u-%u/%u\r\n\r\n", ranges[n].m_nStart, ranges[n].m_nStart + ranges[n].m_nLen - 1, nSize) ;
+			nLen += parts[n].Size() + ranges[n].m_nLen ;
+		}
+		W << "\r\n--" << m_RangeSep << "--\r\n" ;
+		nLen += W.Size() ;
 	}
 
-	//	Send a new session cookie
-	if (m_CookieNew)
+	//	Only a 200 or 206 response to a GET has a body
+	if (m_eMethod == HTTP_HEAD || (hrc != HTTPMSG_OK && hrc != HTTPMSG_PARTIAL_CONTENT))
+		{ pData = 0 ; cpPath = 0 ; }
+
+	//	Small files are read in rather than streamed
+	if (cpPath && nSize < HZ_OUT_CONN_HIGH)
 	{
-		//	If there is a cookie from the browser and it does not agree with a new cookie from the server, give the directive to the browser to delete it.
-		if (m_CookieSub && (m_CookieNew != m_CookieSub))
+		ifstream	is ;	//	Read file stream
+
+		is.open(cpPath) ;
+		if (is.fail())
 		{
-			if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-				threadLog("Expiring cookie %016X and setting cookie %016x\n", m_CookieSub, m_CookieNew) ;
-			//Z.Printf("Set-Cookie: %s=%016X; path=/; expires: %s\r\n", *_hzGlobal_HtmlApp->m_CookieName, m_CookieOld, *now.Str(FMT_DT_INET)) ;
-			Z.Printf("Set-Cookie: %s=%016X; path=/; expires: %s\r\n", *_hzGlobal_Dissemino->m_CookieName, m_CookieOld, *now.Str(FMT_DT_INET)) ;
+			m_RangeOut.Clear() ;
+			m_RangeSep.Clear() ;
+			SendError(HTTPMSG_NOTFOUND, "Could not open requested file (%s)\n", cpPath) ;
+			return E_OPENFAIL ;
 		}
-		//Z.Printf("Set-Cookie: %s=%016X; path=/\r\n", *_hzGlobal_HtmlApp->m_CookieName, m_CookieNew) ;
-		Z.Printf("Set-Cookie: %s=%016X; path=/\r\n", *_hzGlobal_Dissemino->m_CookieName, m_CookieNew) ;
+		F += is ;
+		is.close() ;
+
+		if (F.Size() != nSize)
+		{
+			m_RangeOut.Clear() ;
+			m_RangeSep.Clear() ;
+			SendError(HTTPMSG_NOTFOUND, "File (%s) changed while being read\n", cpPath) ;
+			return E_OPENFAIL ;
+		}
+
+		pData = &F ;
+		cpPath = 0 ;
 	}
 
-	//	Send the content location if app has set URI
-	if (m_Redirect)
+	//	Open the file for each range (or the whole file) before committing to the response
+	memset(files, 0, sizeof(files)) ;
+	if (cpPath)
 	{
-		if (hrc == HTTPMSG_FOUND_GOTO)
-			Z.Printf("Location: %s\r\n", *m_Redirect) ;
-		else
-			Z.Printf("Content-Location: %s\r\n", *m_Redirect) ;
+		for (n = 0 ; n < (nRanges > 0 ? nRanges : 1) ; n++)
+		{
+			files[n] = new hzOutFile() ;
+			rc = nRanges > 0 ? files[n]->Open(cpPath, ranges[n].m_nStart, ranges[n].m_nLen) : files[n]->Open(cpPath, 0, nSize) ;
+			if (rc != E_OK)
+			{
+				for (n = 0 ; n < HZ_HTTP_MAXRANGES && files[n] ; n++)
+					delete files[n] ;
+				m_RangeOut.Clear() ;
+				m_RangeSep.Clear() ;
+				SendError(HTTPMSG_NOTFOUND, "Could not open requested file (%s)\n", cpPath) ;
+				return E_OPENFAIL ;
+			}
+		}
 	}
 
-	Z << "Accept-Ranges: bytes\r\n" ;
+	//	Form the header. The validators and ranges apply to this response only.
+	m_ETagOut = tag ;
+	m_nModOut = nMtime ;
+	rc = _formhead(Z, hrc, type, nLen, nExpires, bZip) ;
+	m_ETagOut.Clear() ;
+	m_RangeOut.Clear() ;
+	m_RangeSep.Clear() ;
+	m_nModOut = 0 ;
 
-	if (bZip)
-		Z << "Content-Encoding: gzip\r\n" ;
-	Z.Printf("Content-Length: %d\r\n", nSize) ;
+	if (rc != E_OK)
+	{
+		for (n = 0 ; n < HZ_HTTP_MAXRANGES && files[n] ; n++)
+			delete files[n] ;
+		return hzerr(_fn, HZ_ERROR, rc, "Could not formulate HTTP header (sock=%d)", m_pCx->CliSocket()) ;
+	}
 
-	if (m_LangCode)
-		Z.Printf("Content-Language: %s\r\n", *m_LangCode) ;
-	else
-		Z.Printf("Content-Language: en-US\r\n") ;
+	//	Header only
+	if (!pData && !cpPath)
+		rc = m_pCx->SendData(Z) ;
 
-	if (m_HdrsResponse.Count())
+	//	Resource in memory
+	else if (pData)
 	{
-		hzList<hzPair>::Iter	ip ;	//	Resident headers iterator
-
-		for (ip = m_HdrsResponse ; ip.Valid() ; ip++)
+		if (nRanges < 0)
+			rc = m_pCx->SendData(Z, *pData) ;
+		else
 		{
-			Z << ip.Element().name ;
-			Z << ": " ;
-			Z << ip.Element().value ;
-			Z << "\r\n" ;
+			for (n = 0 ; n < nRanges ; n++)
+			{
+				if (nRanges > 1)
+					B += parts[n] ;
+				B.AppendSub(const_cast<hzChain&>(*pData), ranges[n].m_nStart, ranges[n].m_nLen) ;
+			}
+			if (nRanges > 1)
+				B += W ;
+			rc = m_pCx->SendData(Z, B) ;
 		}
 	}
 
-	if (!m_nConnection)
-		Z << "Connection: close\r\n" ;
+	//	File. Each range is a source of its own, preceeded by its part header where there are several.
+	else if (nRanges <= 1)
+		rc = m_pCx->SendStream(Z, files[0]) ;
 	else
 	{
-		//	Z.Printf("keep-alive: timeout=%d\r\n", m_nConnection) ;
-		Z << "Connection: close\r\n" ;
-		//	Z << "Connection: keep-alive\r\n" ;
+		Z += parts[0] ;
+		rc = m_pCx->SendStream(Z, files[0]) ;
+		for (n = 1 ; rc == E_OK && n < nRanges ; n++)
+			rc = m_pCx->SendStream(parts[n], files[n]) ;
+		for (; n < nRanges ; n++)
+			delete files[n] ;
+		if (rc == E_OK)
+			rc = m_pCx->SendData(W) ;
 	}
 
-	Z << "Content-Type: " << Mimetype2Txt(mtype) << "\r\n" ;
-	Z << "X-Powered-By: HadronZoo::Dissemino 9.6\r\n\r\n" ;
-
-	if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-		threadLog(Z) ;
-
-	return E_OK ;
-}
-
-hzEcode	hzHttpEvent::SendRawChain	(HttpRC hrc, hzMimetype type, const hzChain& Data, uint32_t nExpires, bool bZip)
-{
-	//	Compile a send a HTML response to the HTTP client. The HTML page content is supplied as a hzChain
-	//
-	//	Arguments:	1)	hrc			The HTTP return code to appear in the header.
-	//				2)	type		The MIME type of HTTP message
-	//				3)	Data		The page content
-	//				4)	nExpires	The expiry time for the page
-	//				5)	bZip		A boolean flag to indicate if the content has been zipped. It sets an indicator in the outgoing header.
-	//
-	//	Returns:	E_ARGUMENT	If any of the arguments are invalid
-	//				E_WRITEFAIL	If the HTTP response could not be sent to the browser.
-	//				E_OK		If the operation was successful.
-	//
-
-	_hzfunc("hzHttpEvent::SendRawChain") ;
-
-	hzChain	Z ;		//	For building header
-	hzEcode	rc ;	//	Return code
-
-	rc = _formhead(Z, hrc, type, Data.Size(), nExpires, bZip) ;
 	if (rc != E_OK)
-		return hzerr(_fn, HZ_ERROR, rc, "Could not formulate HTTP header (sock=%d)", m_pCx->CliSocket()) ;
-
-	//Z << Data ;
-	if (m_pCx->SendData(Z, Data) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Event %p Failed to send response (size=%d + %d, sock=%d)", this, Z.Size(), Data.Size(), m_pCx->CliSocket()) ;
+		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Response not sent to browser (sock=%d)", m_pCx->CliSocket()) ;
 	return E_OK ;
 }
 
-hzEcode	hzHttpEvent::SendRawString	(HttpRC hrc, hzMimetype type, const hzString& Content, uint32_t nExpires, bool bZip)
+hzEcode	hzHttpEvent::SendEntity	(hzMimetype type, const hzChain& Data, const hzString& etag, uint32_t nMtime, uint32_t nExpires, bool bZip)
 {
-	//	Compile a send a HTML response to the HTTP client. The HTML page content is supplied as a hzString
-	//
-	//	Arguments:	1)	hrc			The HTTP return code to appear in the header.
-	//				2)	type		The MIME type of HTTP message
-	//				3)	Contyent	The page content
-	//				4)	nExpires	The expiry time for the page
-	//				5)	bZip		A boolean flag to indicate if the content has been zipped. It sets an indicator in the outgoing header.
+	//	Send a static resource held in memory (such as a passive file loaded at startup), honouring conditional requests and byte ranges (see _sendEntity).
 	//
-	//	Returns:	E_ARGUMENT	If any of the arguments are invalid
-	//				E_WRITEFAIL	If the HTTP response could not be sent to the browser.
-	//				E_OK		If the operation was successful.
+	//	Arguments:	1)	type		MIME type of resource
+	//				2)	Data		Content of resource
+	//				3)	etag		Entity tag of resource (see MakeETag, may be empty)
+	//				4)	nMtime		Modification time of resource (0 if unknown)
+	//				5)	nExpires	Expiry time for the resource (for browser use only)
+	//				6)	bZip		Content is zipped
 	//
-	//	Note:		This function is deprecated. Please use hzHttpEvent::SendRawChain instead
-
-	_hzfunc("hzHttpEvent::SendRawString") ;
-
-	hzChain	Z ;		//	For building header
-	hzEcode	rc ;	//	Return code
-
-	rc = _formhead(Z, hrc, type, Content.Length(), nExpires, bZip) ;
-	if (rc != E_OK)
-		return hzerr(_fn, HZ_ERROR, rc, "Could not formulate HTTP header (sock=%d)", m_pCx->CliSocket()) ;
-
-	Z << Content ;
+	//	Returns:	E_WRITEFAIL	If the response could not be sent
+	//				E_OK		If the response was sent
 
-	if (m_pCx->SendData(Z) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "hzHttpEvent %p Failed to send response (size=%d, sock=%d)", this, Z.Size(), m_pCx->CliSocket()) ;
-	return E_OK ;
+	return _sendEntity(type, &Data, 0, Data.Size(), etag, nMtime, nExpires, bZip) ;
 }
 
 hzEcode	hzHttpEvent::SendFilePage	(const char* cpDir, const char* cpFilename, uint32_t nExpires, bool bZip)
@@ -1288,19 +2904,20 @@ hzEcode	hzHttpEvent::SendFilePage	(const char* cpDir, const char* cpFilename, ui
 	//				E_WRITEFAIL	If the HTML data could not be sent to the browser.
 	//				E_OK		If the operation was successful.
 	//
-	//	Note this function does not use OpenInputStrm to open the file as it does not need the error code detail.
+	//	Note this function does not use OpenInputStrm to open the file as it does not need the error code detail. Files of HZ_OUT_CONN_HIGH bytes or more are
+	//	not read in but streamed from disk as the client takes them (see hzIpConnex::SendStream), so large downloads to slow clients do not exhaust memory.
+	//	The file is sent with an entity tag formed from its inode, size and modification time, and conditional and byte range requests are honoured (see
+	//	_sendEntity).
 
 	_hzfunc("hzHttpEvent::SendFilePage") ;
 
-	ifstream		is ;			//	Read file stream
 	FSTAT			fs ;			//	File info
-	hzChain			Z ;				//	Response for browser is built here
+	hzChain			Z ;				//	For building the pathname
 	const char*		pEnd ;			//	Filename extension and hence type
 	hzString		Pagename ;		//	Full name (inc path) of page
 	hzMimetype		type ;			//	File's HTTP type
-	hzEcode			rc ;			//	Return code from sending function
 
- 	//	Formulate full path of page and then use lstat
+ 	//	Formulate full path of page and then use stat
 
 	if (cpDir && cpDir[0])
 		{ Z << cpDir ; Z.AddByte(CHAR_FWSLASH) ; }
@@ -1313,12 +2930,18 @@ hzEcode	hzHttpEvent::SendFilePage	(const char* cpDir, const char* cpFilename, ui
 	Pagename = Z ;
 	Z.Clear() ;
 
-	if (lstat(*Pagename, &fs) == -1)
+	if (stat(*Pagename, &fs) == -1)
 	{
 		SendError(HTTPMSG_NOTFOUND, "Could not locate %s\n", *Pagename) ;
 		return E_NOTFOUND ;
 	}
 
+	if (!fs.st_size)
+	{
+		SendError(HTTPMSG_NOTFOUND, "File (%s) of zero size\n", *Pagename) ;
+		return E_NODATA ;
+	}
+
 	//	Determine the type of file so that the correct header can be sent to the browser
 
 	pEnd = strrchr(*Pagename, CHAR_PERIOD) ;
@@ -1327,34 +2950,13 @@ hzEcode	hzHttpEvent::SendFilePage	(const char* cpDir, const char* cpFilename, ui
 	else
 		type = Filename2Mimetype(pEnd) ;
 
-	//	Read in the file
-
-	is.open(*Pagename) ;
-	if (is.fail())
-	{
-		SendError(HTTPMSG_NOTFOUND, "Could not open requested file (%s\n", *Pagename) ;
-		return E_OPENFAIL ;
-	}
-	Z += is ;
-	is.close() ;
-
-	if (!Z.Size())
-	{
-		SendError(HTTPMSG_NOTFOUND, "File (%s) of zero size\n", *Pagename) ;
-		return E_NODATA ;
-	}
-
-	//	If not a html file, no server side includes are possible so just send
-	rc = SendRawChain(HTTPMSG_OK, type, Z, nExpires, bZip) ;
-	if (rc != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Response data not sent to browser (sock=%d)", m_pCx->CliSocket()) ;
-
-	return E_OK ;
+	return _sendEntity(type, 0, *Pagename, fs.st_size, MakeETag(fs.st_ino, fs.st_size, fs.st_mtime), fs.st_mtime, nExpires, bZip) ;
 }
 
 hzEcode	hzHttpEvent::SendFileHead	(const char* cpDir, const char* cpFilename, uint32_t nExpires)
 {
-	//	Sends a HTML or other file to the browser
+	//	Sends the header only, of a HTML or other file to the browser. As with SendFilePage, the header gives the entity tag and modification time of the file
+	//	and a conditional request is answered with 304.
 	//
 	//	Arguments:	1)	cpDir		The directory of the file (can be relative to current dir)
 	//				2)	cpFilename	The file name.
@@ -1368,15 +2970,11 @@ hzEcode	hzHttpEvent::SendFileHead	(const char* cpDir, const char* cpFilename, ui
 
 	_hzfunc("hzHttpEvent::SendFileHead") ;
 
-	ifstream	is ;			//	Read file stream
 	FSTAT		fs ;			//	File info
-	hzXDate		d ;				//	Date for header lines
 	hzChain		Z ;				//	Response for browser is built here
 	const char*	pEnd ;			//	Filename extension and hence type
 	hzString	Pathname ;		//	File to load
-	uint32_t	nLen = 0 ;		//	File size
 	hzMimetype	type ;			//	File's HTTP type
-	HttpRC		hrc ;			//	HTTP return code
 	hzEcode		rc ;			//	Return code from sending function
 
 	//	Establish real filename, either cpFilename or index.htm(l)
@@ -1396,17 +2994,6 @@ hzEcode	hzHttpEvent::SendFileHead	(const char* cpDir, const char* cpFilename, ui
 		}
 	}
 
-	if (stat(*Pathname, &fs) == -1)
-	{
-		hrc = HTTPMSG_NOTFOUND ;
-		nLen = 0 ;
-	}
-	else
-	{
-		hrc = HTTPMSG_OK ;
-		nLen = fs.st_size ;
-	}
-
 	//	Determine the type of file so that the correct header can be
 	//	sent to the browser
 
@@ -1416,8 +3003,11 @@ hzEcode	hzHttpEvent::SendFileHead	(const char* cpDir, const char* cpFilename, ui
 	else
 		type = Filename2Mimetype(pEnd) ;
 
+	if (stat(*Pathname, &fs) != -1)
+		return _sendEntity(type, 0, 0, fs.st_size, MakeETag(fs.st_ino, fs.st_size, fs.st_mtime), fs.st_mtime, nExpires, false) ;
+
 	//	Send the header
-	rc = _formhead(Z, hrc, type, nLen, nExpires, false) ;
+	rc = _formhead(Z, HTTPMSG_NOTFOUND, type, 0, nExpires, false) ;
 	if (rc != E_OK)
 		return hzerr(_fn, HZ_ERROR, rc, "Could not formulate HTTP header (sock=%d)", m_pCx->CliSocket()) ;
 
@@ -1498,11 +3088,13 @@ hzEcode	hzHttpEvent::SendPageE	(const char* dir, const char* fname, uint32_t nEx
 	//				E_WRITEFAIL	If the HTML data could not be sent to the browser.
 	//				E_OK		If the operation was successful.
 	//
-	//	Note this function does not use OpenInputStrm to open the file as it does not need the error code detail.
+	//	Note this function does not use OpenInputStrm to open the file as it does not need the error code detail. The entity tag and modification time of the
+	//	file are noted when it is loaded, so conditional and byte range requests are answered from memory (see _sendEntity).
 
 	_hzfunc("hzHttpEvent::SendPageE") ;
 
 	hzChain*		pChain ;		//	Response for browser is built here
+	_pageTag		tag ;			//	Validators of page
 	const char*		pEnd ;			//	Filename extension and hence type
 	hzString		Pagename ;		//	File to load
 	hzString		Filename ;		//	File to load
@@ -1580,6 +3172,10 @@ hzEcode	hzHttpEvent::SendPageE	(const char* dir, const char* fname, uint32_t nEx
 
 		if (s_PageStore.Insert(Pagename, pChain) != E_OK)
 			return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not store file (%s)", *Pagename) ;
+
+		tag.m_ETag = MakeETag(fs.st_ino, fs.st_size, fs.st_mtime) ;
+		tag.m_nMtime = fs.st_mtime ;
+		s_PageTags.Insert(Pagename, tag) ;
 	}
 
 	//	Determine the type of file so that the correct header can be
@@ -1592,7 +3188,8 @@ hzEcode	hzHttpEvent::SendPageE	(const char* dir, const char* fname, uint32_t nEx
 		type = Filename2Mimetype(pEnd) ;
 
 	//	If not a html file, no server side includes are possible so just send
-	rc = SendRawChain(HTTPMSG_OK, type, *pChain, nExpires, bZip) ;
+	tag = s_PageTags[Pagename] ;
+	rc = _sendEntity(type, pChain, 0, pChain->Size(), tag.m_ETag, tag.m_nMtime, nExpires, bZip) ;
 
 	if (rc != E_OK)
 		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Response data not sent to browser (size=%d, sock=%d)", pChain->Size(), m_pCx->CliSocket()) ;
@@ -1781,3 +3378,99 @@ hzEcode	hzHttpEvent::SendAjaxResult (HttpRC hrc, hzChain& Z)
 		return hzerr(_fn, HZ_ERROR, E_WRITEFAIL, "Response data not sent (size=%d, sock=%d)", Z.Size(), m_pCx->CliSocket()) ;
 	return E_OK ;
 }
+
+/*
+**	WebSocket opening handshake
+*/
+
+bool	hzHttpEvent::IsWebSocket	(void) const
+{
+	//	Establish if the request is a valid WebSocket opening handshake (RFC 6455 section 4.2.1). This is a HTTP/1.1 GET request with an Upgrade header naming
+	//	websocket, a Connection header including upgrade, a key of 16 bytes in base64 and version 13.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	True	If the request is a WebSocket handshake that can be accepted
+	//				False	Otherwise
+
+	if (m_eMethod != HTTP_GET || !m_nVersion)
+		return false ;
+	if (!m_pUpgrade || !strcasestr(m_pUpgrade, "websocket"))
+		return false ;
+	if (!m_pConnection || !strcasestr(m_pConnection, "upgrade"))
+		return false ;
+	if (!m_pWsKey || strlen(m_pWsKey) != 24)
+		return false ;
+	if (!m_pWsVersion || strcmp(m_pWsVersion, "13"))
+		return false ;
+	return true ;
+}
+
+hzWebSocket*	hzHttpEvent::AcceptWebSocket	(hzTcpCode (*OnMessage)(hzWebSocket*, hzChain&, bool), void* pApp, const char* cpProtocol)
+{
+	//	Accept a WebSocket opening handshake. This is called by the application handler for a request it wishes to upgrade, and the handler should then return
+	//	TCP_KEEPALIVE. The 101 response is sent and a hzWebSocket is attached to the connection. Thereafter the input of the connection is treated as frames and
+	//	each message is passed to the supplied function (see hzWebSocket.h).
+	//
+	//	If the request is not a valid handshake, it is answered with 426 (if only the version is not supported) or 400 and no WebSocket is created.
+	//
+	//	Arguments:	1)	OnMessage	Function to be called with each message
+	//				2)	pApp		Application data to be held by the WebSocket (optional)
+	//				3)	cpProtocol	Subprotocol chosen from those offered by the client (optional, see WsProtocols)
+	//
+	//	Returns:	Pointer to the WebSocket if the handshake was accepted
+	//				NULL	If the request is not a valid handshake or the response could not be sent
+
+	_hzfunc("hzHttpEvent::AcceptWebSocket") ;
+
+	hzWebSocket*	pWs ;	//	WebSocket
+	hzChain			Z ;		//	Response
+	hzString		S ;		//	Accept key or error text
+
+	if (!m_pCx || !OnMessage)
+		{ hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No connection or no message function") ; return 0 ; }
+
+	if (!IsWebSocket())
+	{
+		if (m_pUpgrade && strcasestr(m_pUpgrade, "websocket") && (!m_pWsVersion || strcmp(m_pWsVersion, "13")))
+		{
+			S = "13" ;
+			SetHdr("Sec-WebSocket-Version", S) ;
+			S = "WebSocket version 13 required\n" ;
+			SendRawString(HTTPMSG_UPGRADE_REQUIRED, HMTYPE_TXT_PLAIN, S, 0, false) ;
+		}
+		else
+		{
+			S = "Not a WebSocket handshake\n" ;
+			SendRawString(HTTPMSG_BAD_REQUEST, HMTYPE_TXT_PLAIN, S, 0, false) ;
+		}
+		return 0 ;
+	}
+
+	S = WebSocketAccept(m_pWsKey) ;
+	if (!S)
+		{ hzerr(_fn, HZ_ERROR, E_SYSERROR, "Could not form accept key") ; return 0 ; }
+
+	Z << "HTTP/1.1 101 Switching Protocols\r\n" ;
+	Z << "Upgrade: websocket\r\n" ;
+	Z << "Connection: Upgrade\r\n" ;
+	Z << "Sec-WebSocket-Accept: " << S << "\r\n" ;
+	if (cpProtocol && cpProtocol[0])
+		Z.Printf("Sec-WebSocket-Protocol: %s\r\n", cpProtocol) ;
+	Z << "\r\n" ;
+
+	if (m_pCx->SendData(Z) != E_OK)
+		return 0 ;
+	m_eRetCode = HTTPMSG_SWITCHING_PROTOCOLS ;
+
+	//	The connection now carries frames. It is pinged if idle for the ping interval.
+	pWs = new hzWebSocket(m_pCx, OnMessage, pApp) ;
+	m_pCx->m_pWsHdl = pWs ;
+	m_pCx->m_OnIngress = HandleWsMsg ;
+	m_pCx->m_OnIdle = HandleWsIdle ;
+	m_pCx->SetTTL((uint64_t) HZ_WS_PING * 1000000000) ;
+	m_pCx->Oxygen() ;
+
+	m_pCx->m_Track.Event("AcceptWebSocket: Sock %u/%u upgraded to WebSocket", m_pCx->CliSocket(), m_pCx->CliPort()) ;
+	return pWs ;
+}
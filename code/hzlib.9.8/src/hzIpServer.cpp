@@ -29,7 +29,16 @@
 #include <arpa/inet.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
 #include <sys/epoll.h>
+#include <poll.h>
+#include <sys/resource.h>
 #include <signal.h>
 #include <pthread.h>
 
@@ -39,6 +48,8 @@
 #include "hzDirectory.h"
 #include "hzHttpServer.h"
 #include "hzIpServer.h"
+#include "hzWebSocket.h"
+#include "hzUring.h"
 #include "hzProcess.h"
 
 using namespace std ;
@@ -47,7 +58,7 @@ using namespace std ;
 **	Variables
 */
 
-global	hzMapS	<hzIpaddr,hzIpinfo>	_hzGlobal_StatusIP ;	//	Black and white listed IP addresses
+global	hzIpTable	_hzGlobal_StatusIP ;					//	Black and white listed IP addresses
 
 global	hzString	_hzGlobal_sslPvtKey ;					//	SSL Private Key
 global	hzString	_hzGlobal_sslCert ;						//	SSL Certificate
@@ -63,15 +74,28 @@ static	const SSL_METHOD*	s_svrMeth = 0 ;					//	SSL method
 
 static	int32_t	(*verify_callback)(int, X509_STORE_CTX*) ;	//	SSL callback function
 
-static	hzPacket*	s_pTcpBuffer_freelist = 0 ;				//	Freelist of IP packet holders
+static	uint32_t	s_nSessCache = HZ_TLS_SESS_CACHE ;		//	Size of server TLS session cache
+static	uint32_t	s_nSessSecs = HZ_TLS_SESS_SECS ;		//	Lifetime of TLS sessions and tickets
+static	uint32_t	s_nTicketSecs = HZ_TLS_TICKET_SECS ;	//	Session ticket key rotation interval
 
-static	ofstream	s_status_ip_os ;		//	Black and white list stream
+static	hzPacket*	s_pTcpBuffer_freelist = 0 ;				//	Freelist of IP packet holders
+static	hzLockS		s_lockTcpBuffer ;						//	Lock on the freelist (packets are queued and written by different threads under ServeEpollMT)
+static	uint32_t	s_nTcpBuffer_free = 0 ;					//	Packets in the freelist
 
-static	hzString	s_status_ip_fname ;		//	Blacklist file path
+static	uint64_t	s_nOutQueued = 0 ;						//	Bytes queued for output by all connections
+static	uint64_t	s_nOutGlobalHigh = HZ_OUT_GLOBAL_HIGH ;	//	Global high watermark
+static	uint64_t	s_nOutGlobalLow = HZ_OUT_GLOBAL_LOW ;	//	Global low watermark
+static	uint32_t	s_nOutConnHigh = HZ_OUT_CONN_HIGH ;		//	Per connection high watermark
+static	uint32_t	s_nOutConnLow = HZ_OUT_CONN_LOW ;		//	Per connection low watermark
+static	bool		s_bOutPressure = false ;				//	Set when the global high watermark is exceeded, cleared when output falls below the global low watermark
 
 static	hzString	s_str_hangup = "EPOLL HANGUP" ;			//	Epoll hangup error message
 static	hzString	s_str_error = "EPOLL ERROR" ;			//	Epoll general error message
 static	int32_t		epollSocket ;							//	The epoll 'master' socket
+static	hzUring*	s_pUring = 0 ;							//	The io_uring instance (if serving by ServeUring)
+static	uint32_t	s_nEpollET = 0 ;						//	Edge triggering of client sockets (EPOLLET under ServeEpollMT, none under ServeEpollST)
+
+static	__thread bool	s_bServing = false ;				//	Set in the serving threads, which write out queued output on return from the handlers
 
 /*
 **	System Init Functions
@@ -194,29 +218,52 @@ hzPacket*	_tcpbufAlloc	(void)
 
 	hzPacket*	pTB ;	//	Target hzPacket pointer
 
-	if (!s_pTcpBuffer_freelist)
-		pTB = new hzPacket() ;
-	else
-	{
-		pTB = s_pTcpBuffer_freelist ;
-		s_pTcpBuffer_freelist = s_pTcpBuffer_freelist->next ;
+	if (_hzGlobal_MT)
+		s_lockTcpBuffer.Lock() ;
 
-		pTB->next = 0 ;
-		pTB->m_size = 0 ;
+	pTB = s_pTcpBuffer_freelist ;
+	if (pTB)
+	{
+		s_pTcpBuffer_freelist = pTB->next ;
+		s_nTcpBuffer_free-- ;
 	}
+
+	if (_hzGlobal_MT)
+		s_lockTcpBuffer.Unlock() ;
+
+	if (!pTB)
+		return new hzPacket() ;
+
+	pTB->next = 0 ;
+	pTB->m_size = 0 ;
 	return pTB ;
 }
 
 void	_tcpbufDeleteOne	(hzPacket* pTB)
 {
-	//	Delete a single hzPacket instance after the data held in it has been successfully sent to the client.
+	//	Delete a single hzPacket instance after the data held in it has been successfully sent to the client. The packet is returned to the freelist unless the
+	//	freelist already holds enough packets to queue the global low watermark, in which case it is freed. A burst of output thus leaves no lasting footprint.
 	//
 	//	Arguments:	1)	pTB	Pointer to hzPacket instance
 	//
 	//	Returns:	None
 
-	pTB->next = s_pTcpBuffer_freelist ;
-	s_pTcpBuffer_freelist = pTB ;
+	if (_hzGlobal_MT)
+		s_lockTcpBuffer.Lock() ;
+
+	if (s_nTcpBuffer_free < (s_nOutGlobalLow / HZ_MAXPACKET))
+	{
+		pTB->next = s_pTcpBuffer_freelist ;
+		s_pTcpBuffer_freelist = pTB ;
+		s_nTcpBuffer_free++ ;
+		pTB = 0 ;
+	}
+
+	if (_hzGlobal_MT)
+		s_lockTcpBuffer.Unlock() ;
+
+	if (pTB)
+		delete pTB ;
 }
 
 void	_tcpbufDeleteAll	(hzPacket* first, hzPacket* last)
@@ -228,8 +275,14 @@ void	_tcpbufDeleteAll	(hzPacket* first, hzPacket* last)
 	//
 	//	Returns:	None
 
-	last->next = s_pTcpBuffer_freelist ;
-	s_pTcpBuffer_freelist = first ;
+	hzPacket*	pTB ;		//	Packet
+	hzPacket*	pNext ;		//	Next packet
+
+	for (pTB = first ; pTB ; pTB = pNext)
+	{
+		pNext = pTB == last ? 0 : pTB->next ;
+		_tcpbufDeleteOne(pTB) ;
+	}
 }
 
 int32_t	_hz_SSL_verify	(int32_t x, X509_STORE_CTX* pTax)
@@ -237,6 +290,201 @@ int32_t	_hz_SSL_verify	(int32_t x, X509_STORE_CTX* pTax)
 	return 1 ;
 }
 
+/*
+**	Session tickets
+*/
+
+struct	_hz_ticket_key
+{
+	//	Session ticket key. The name identifies the key in the tickets it encrypts.
+
+	uint64_t		m_nCreated ;		//	Epoch time created (0 if not yet in use)
+	unsigned char	m_Name[16] ;		//	Key name
+	unsigned char	m_Aes[32] ;			//	AES-256 key
+	unsigned char	m_Hmac[32] ;		//	HMAC-SHA256 key
+} ;
+
+static	_hz_ticket_key	s_TicketKeys[HZ_TLS_TICKET_KEYS] ;	//	Ticket keys
+static	uint32_t		s_nTicketCurr = 0 ;					//	Current ticket key (used for encryption)
+
+static	_hz_ticket_key*	_ticketKeyCurrent	(void)
+{
+	//	Return the current session ticket key, replacing it first if it has reached the rotation interval. The key it replaces remains available to decrypt
+	//	tickets until it is in turn overwritten, HZ_TLS_TICKET_KEYS rotations later. Ticket keys are held only in memory so tickets do not survive a restart.
+	//
+	//	Note that this is only called from within SSL_accept() and the TLS handshakes are all advanced by the serving thread (see hzIpConnex::Handshake), so
+	//	there is no locking.
+	//
+	//	Arguments:	None
+	//	Returns:	Pointer to the current key
+
+	_hz_ticket_key*	pKey ;	//	Ticket key
+	uint64_t		now ;	//	Time now
+
+	now = time(0) ;
+	pKey = s_TicketKeys + s_nTicketCurr ;
+
+	if (pKey->m_nCreated && (now - pKey->m_nCreated) < s_nTicketSecs)
+		return pKey ;
+
+	if (pKey->m_nCreated)
+	{
+		s_nTicketCurr = (s_nTicketCurr + 1) % HZ_TLS_TICKET_KEYS ;
+		pKey = s_TicketKeys + s_nTicketCurr ;
+	}
+
+	RAND_bytes(pKey->m_Name, 16) ;
+	RAND_bytes(pKey->m_Aes, 32) ;
+	RAND_bytes(pKey->m_Hmac, 32) ;
+	pKey->m_nCreated = now ;
+	return pKey ;
+}
+
+static	_hz_ticket_key*	_ticketKeyLookup	(const unsigned char* keyName)
+{
+	//	Find the ticket key of the given name, provided it is not too old to be accepted. A ticket issued under a key is accepted for as long as the key is held
+	//	but not beyond the session lifetime after the key was replaced.
+	//
+	//	Arguments:	1)	keyName	The key name (16 bytes) from the ticket
+	//
+	//	Returns:	Pointer to the key
+	//				NULL if the key is not found (the client will be put through a full handshake)
+
+	_hz_ticket_key*	pKey ;	//	Ticket key
+	uint64_t		now ;	//	Time now
+	uint32_t		n ;		//	Key iterator
+
+	now = time(0) ;
+	for (n = 0 ; n < HZ_TLS_TICKET_KEYS ; n++)
+	{
+		pKey = s_TicketKeys + n ;
+		if (!pKey->m_nCreated || memcmp(pKey->m_Name, keyName, 16))
+			continue ;
+		if ((now - pKey->m_nCreated) > (uint64_t) (s_nTicketSecs + s_nSessSecs))
+			return 0 ;
+		return pKey ;
+	}
+	return 0 ;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+typedef	EVP_MAC_CTX		_hz_ticket_mac ;
+#else
+typedef	HMAC_CTX		_hz_ticket_mac ;
+#endif
+
+static	bool	_ticketHmac	(_hz_ticket_mac* pMac, _hz_ticket_key* pKey)
+{
+	//	Initialize the ticket HMAC context (HMAC-SHA256) with the HMAC key of the given ticket key
+	//
+	//	Arguments:	1)	pMac	The HMAC context
+	//				2)	pKey	The ticket key
+	//
+	//	Returns:	True if the context is initialized, false otherwise
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	OSSL_PARAM	params[3] ;	//	HMAC parameters
+
+	params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, pKey->m_Hmac, 32) ;
+	params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*) "SHA256", 0) ;
+	params[2] = OSSL_PARAM_construct_end() ;
+	return EVP_MAC_CTX_set_params(pMac, params) ? true : false ;
+#else
+	return HMAC_Init_ex(pMac, pKey->m_Hmac, 32, EVP_sha256(), 0) ? true : false ;
+#endif
+}
+
+static	int32_t	_hz_SSL_ticket	(SSL* pSSL, unsigned char* keyName, unsigned char* iv, EVP_CIPHER_CTX* pCtx, _hz_ticket_mac* pMac, int32_t bEnc)
+{
+	//	Session ticket key callback, used in place of the OpenSSL default so that the ticket key is replaced at intervals. With the default, a single key is in
+	//	force for the life of the process, and its compromise would expose every session resumed under it.
+	//
+	//	Arguments:	1)	pSSL	The SSL connection
+	//				2)	keyName	The key name (to set if encrypting, to look up if decrypting)
+	//				3)	iv		The initialization vector (to set if encrypting)
+	//				4)	pCtx	The cipher context to initialize
+	//				5)	pMac	The HMAC context to initialize
+	//				6)	bEnc	True if a ticket is being issued, false if a ticket is being presented
+	//
+	//	Returns:	1	If the context has been initialized
+	//				2	If a ticket is presented under a key that has since been replaced (accept the ticket but issue a new one)
+	//				0	If a ticket is presented under an unknown or expired key (full handshake)
+	//				-1	On error
+
+	_hz_ticket_key*	pKey ;	//	Ticket key
+
+	if (bEnc)
+	{
+		pKey = _ticketKeyCurrent() ;
+		memcpy(keyName, pKey->m_Name, 16) ;
+		if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) <= 0)
+			return -1 ;
+		if (!EVP_EncryptInit_ex(pCtx, EVP_aes_256_cbc(), 0, pKey->m_Aes, iv))
+			return -1 ;
+		return _ticketHmac(pMac, pKey) ? 1 : -1 ;
+	}
+
+	pKey = _ticketKeyLookup(keyName) ;
+	if (!pKey)
+		return 0 ;
+
+	if (!_ticketHmac(pMac, pKey))
+		return -1 ;
+	if (!EVP_DecryptInit_ex(pCtx, EVP_aes_256_cbc(), 0, pKey->m_Aes, iv))
+		return -1 ;
+
+	return pKey == _ticketKeyCurrent() ? 1 : 2 ;
+}
+
+static	void	_applyResume	(void)
+{
+	//	Apply the session resumption settings to the server SSL context
+	//
+	//	Arguments:	None
+	//	Returns:	None
+
+	SSL_CTX_set_session_id_context(s_svrCTX, (const unsigned char*) "hzIpServer", 10) ;
+	SSL_CTX_set_session_cache_mode(s_svrCTX, s_nSessCache ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF) ;
+	SSL_CTX_sess_set_cache_size(s_svrCTX, s_nSessCache) ;
+	SSL_CTX_set_timeout(s_svrCTX, s_nSessSecs) ;
+
+	if (s_nTicketSecs)
+	{
+		SSL_CTX_clear_options(s_svrCTX, SSL_OP_NO_TICKET) ;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		SSL_CTX_set_tlsext_ticket_key_evp_cb(s_svrCTX, _hz_SSL_ticket) ;
+#else
+		SSL_CTX_set_tlsext_ticket_key_cb(s_svrCTX, _hz_SSL_ticket) ;
+#endif
+	}
+	else
+		SSL_CTX_set_options(s_svrCTX, SSL_OP_NO_TICKET) ;
+}
+
+void	SetServerSSLResume	(uint32_t nCacheSize, uint32_t nSessSecs, uint32_t nRotateSecs)
+{
+	//	Category:	Internet Server
+	//
+	//	Set the TLS session resumption parameters, which otherwise default to HZ_TLS_SESS_CACHE, HZ_TLS_SESS_SECS and HZ_TLS_TICKET_SECS. This may be called
+	//	either before or after InitServerSSL().
+	//
+	//	Returning clients may resume an earlier session, and so skip the certificate exchange and key agreement of a full handshake, either by session ID (the
+	//	session is held in the server session cache) or by session ticket (the session is held by the client, encrypted under a key known only to the server).
+	//
+	//	Arguments:	1)	nCacheSize	Number of sessions to hold in the server session cache (0 to disable the cache)
+	//				2)	nSessSecs	Lifetime in seconds of a session
+	//				3)	nRotateSecs	Interval in seconds at which the ticket key is replaced (0 to disable session tickets)
+	//
+	//	Returns:	None
+
+	s_nSessCache = nCacheSize ;
+	s_nSessSecs = nSessSecs ? nSessSecs : HZ_TLS_SESS_SECS ;
+	s_nTicketSecs = nRotateSecs ;
+
+	if (s_svrCTX)
+		_applyResume() ;
+}
+
 hzEcode	InitServerSSL	(const char* pvtKey, const char* sslCert, const char* sslCA, bool bVerifyClient)
 {
 	//	Category:	Internet Server
@@ -350,6 +598,16 @@ hzEcode	InitServerSSL	(const char* pvtKey, const char* sslCert, const char* sslC
 	SSL_CTX_set_verify_depth(s_svrCTX, 1);
 	threadLog("%s Returned from SSL_CTX_set_verify_depth (void)\n", *_fn) ;
 
+	//	Enable session resumption by session cache and rotating session tickets
+	_applyResume() ;
+	threadLog("%s Session cache %u, session lifetime %u, ticket key rotation %u\n", *_fn, s_nSessCache, s_nSessSecs, s_nTicketSecs) ;
+
+#ifdef SSL_OP_ENABLE_KTLS
+	//	Request kernel TLS. This only takes effect where both OpenSSL and the kernel support it (tls module loaded) and for the ciphers the kernel implements.
+	//	Otherwise, encryption remains in user space. Whether kTLS is in use is established per connection on completion of the handshake.
+	SSL_CTX_set_options(s_svrCTX, SSL_OP_ENABLE_KTLS) ;
+#endif
+
 	return E_OK ;
 }
 
@@ -360,13 +618,33 @@ hzTcpCode	HandleHttpMsg	(hzChain& Input, hzIpConnex* pCx)
 	//	While no assumptions can be made about incoming messages within the hzIpServer regime itself, for HTTP it is expedient to ensure that messages (HTTP requests), are complete
 	//	before being passed to the applicable callback function (by default hdsApp::ProcHTTP).
 	//
-	//	This is acheived by creating a hzHttpEvent instance for the connection and calling hzHttpEvent::ProcessEvent on the data recieved so far. If this sets a flag indicating the
-	//	message does constitute a complete HTTP request, then the callback function is invoked.
+	//	This is acheived by the hzHttpEvent instance of the connection, by calling hzHttpEvent::ProcessEvent on the data recieved so far. If this sets a flag indicating the message
+	//	does constitute a complete HTTP request, then the callback function is invoked.
+	//
+	//	HTTP/1.1 clients may pipeline requests, sending several without waiting for the responses, so the input may hold more than one request and the last
+	//	may be incomplete. The input is framed by the header and Content-Length of each request in turn. Each complete request is passed to the callback and
+	//	removed from the input, and the hzHttpEvent is cleared for the next. As the requests of a connection are handled in order by the one thread and each
+	//	response is appended to the output queue of the connection, responses are written back in the order of the requests. Processing stops at the first
+	//	request whose callback does not keep the connection alive, as any requests beyond it will not be answered.
+	//
+	//	A multipart form submission is parsed and removed from the input as it arrives rather than once complete (see hzHttpEvent::_multipart), so in that
+	//	case the connection is to call again once there is more to parse (AwaitSize) rather than only once the whole request is in (ExpectSize).
+	//
+	//	Under ServeEpollMT the epoll thread appends to the input while this runs on a request thread. The input lock is therefore held while each request is
+	//	framed and while it is removed from the input, but not across the callback, so the epoll thread is only held up for the framing.
+	//
+	//	Should the callback accept a WebSocket handshake (see hzHttpEvent::AcceptWebSocket), the connection no longer carries HTTP. Anything following the
+	//	handshake request is then passed on as WebSocket frames.
+	//
+	//	The connection only holds a hzHttpEvent while a request is part way through being received. The event is taken from the pool of the serving thread
+	//	when a request begins and returned once the input is exhausted, so idle persistent connections do not hold one.
 	//
 	//	Arguments:	1)	Input	The input chain (maintained by the hzIpServer instance)
 	//				2)	pCx		The TCP connection the message is being received on
 	//
-	//	Returns:	A hzTcpCode to indicate keep-alive or terminate.
+	//	Returns:	TCP_INCOMPLETE	If the input ends with an incomplete request (or is empty)
+	//				TCP_TERMINATE	If a request is malformed or its callback directs that the connection be closed
+	//				TCP_KEEPALIVE	If all requests in the input were handled and the connection is to be kept open
 	//
 	//	Notes:		This function is itself a callback function that is called every time a packet arrives on a port deemed to be using
 	//				the HTTP protocol. It is defined as static to prevent it being called directly by the application.
@@ -377,64 +655,104 @@ hzTcpCode	HandleHttpMsg	(hzChain& Input, hzIpConnex* pCx)
 
 	hzHttpEvent*	pE ;		//	The HTTP event message
 	hzTcpCode		tcp_rc ;	//	TCP return code
-
+	uint32_t		nMsg ;		//	Size of current request
+	uint32_t		nServed ;	//	Requests handled in this call
 
 	if (!pCx->m_pEventHdl)
-		hzexit(_fn, 0, E_MEMORY, "Could not allocate a HTTP Event") ;
+		pCx->m_pEventHdl = hzHttpEvent::Acquire(pCx) ;
 
 	pE = (hzHttpEvent*) pCx->m_pEventHdl ;
 
-	//	Know message complete - don't keep the pointer
-	if (pCx->MsgComplete())
-		pCx->m_pEventHdl = 0 ;
-
-	//	First process message to see if it is complete. This also populates the hzHttpEvent instance
-	if (pE->ProcessEvent(Input) != E_OK)
+	for (nServed = 0 ;; nServed++)
 	{
+		//	First process message to see if it is complete. This also populates the hzHttpEvent instance. The input is held still while it is framed.
+		pCx->LockInput() ;
+		if (pE->ProcessEvent(Input) != E_OK)
+		{
+			if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+				pCx->GetLogger()->Out("%s. case 1 About to delete the HTTP event input\n", *_fn) ;
+			pCx->DropInput(Input.Size()) ;
+			pCx->UnlockInput() ;
+			pCx->m_pEventHdl = 0 ;
+			hzHttpEvent::Release(pE) ;
+			pCx->ExpectSize(0) ;
+			return TCP_TERMINATE ;
+		}
+
+		if (!pE->MsgComplete())
+		{
+			//	Know message incomplete - await the remainder. Any responses to earlier requests are written meanwhile.
+			pCx->UnlockInput() ;
+			pCx->ExpectSize(pE->AwaitSize()) ;
+			return TCP_INCOMPLETE ;
+		}
+
+		//	Call the applcation's function. The request may be followed by pipelined requests.
+		nMsg = pE->ExpectSize() ;
+		pCx->UnlockInput() ;
+		pCx->ExpectSize(0) ;
+
+		tcp_rc = TCP_TERMINATE ;
+		if (pCx->m_appFn)
+		{
+			fnOnHttpEvent = (hzTcpCode(*)(hzHttpEvent*)) pCx->m_appFn ;
+			tcp_rc = fnOnHttpEvent(pE) ;
+		}
+
+		//	Ready the event and the input for the next request. Requests beyond one that closes the connection will not be answered.
+		pE->Clear() ;
+		pCx->LockInput() ;
+
 		if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-			pCx->GetLogger()->Out("%s. case 1 About to delete the HTTP event input\n", *_fn) ;
-		Input.Clear() ;
-		return TCP_TERMINATE ;
-	}
+			pCx->GetLogger()->Out("%s. case 2 Request %u handled (%u bytes, %u bytes follow)\n", *_fn, nServed, nMsg, Input.Size() - nMsg) ;
 
-	if (!pE->MsgComplete())
-	{
-		//	Know message incomplete - set the pointer
-		pCx->m_pEventHdl = pE ;
-		pCx->ExpectSize(pE->ExpectSize()) ;
-		return TCP_INCOMPLETE ;
-	}
+		if (pCx->m_pWsHdl && tcp_rc == TCP_KEEPALIVE && !pCx->IsCliBad())
+		{
+			//	Connection upgraded to a WebSocket
+			pCx->DropInput(nMsg) ;
+			nMsg = Input.Size() ;
+			pCx->UnlockInput() ;
+			pCx->m_pEventHdl = 0 ;
+			hzHttpEvent::Release(pE) ;
+			return nMsg ? HandleWsMsg(Input, pCx) : TCP_KEEPALIVE ;
+		}
 
-	//	Set the connection state to HZCONNEX_PROC
-	//	pCx->SetState(*_fn, HZCONNEX_PROC) ;
+		if (tcp_rc != TCP_KEEPALIVE || pCx->IsCliBad())
+		{
+			pCx->DropInput(Input.Size()) ;
+			pCx->UnlockInput() ;
+			pCx->m_pEventHdl = 0 ;
+			hzHttpEvent::Release(pE) ;
+			return tcp_rc ;
+		}
 
-	//	Call the applcation's function
-	if (pCx->m_appFn)
-	{
-		fnOnHttpEvent = (hzTcpCode(*)(hzHttpEvent*)) pCx->m_appFn ;
-		tcp_rc = fnOnHttpEvent(pE) ;
+		pCx->DropInput(nMsg) ;
+		nMsg = Input.Size() ;
+		pCx->UnlockInput() ;
+		if (!nMsg)
+		{
+			//	No further request has begun so the event goes back to the pool
+			pCx->m_pEventHdl = 0 ;
+			hzHttpEvent::Release(pE) ;
+			return tcp_rc ;
+		}
 	}
-
-	if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-		pCx->GetLogger()->Out("%s. case 2 About to delete the HTTP event input\n", *_fn) ;
-	Input.Clear() ;
-	return tcp_rc ;
 }
 
 hzEcode	InitIpInfo	(const hzString& dataDir)
 {
 	//	Category:	Internet Server
 	//
-	//	Reads in BOTH the blacklist AND whitelist file
-
-	_hzfunc(__func__) ;
+	//	Load the black and white listed IP addresses into _hzGlobal_StatusIP from the journal in the data directory, which is then kept up to date with any
+	//	changes (see hzIpTable::Load)
+	//
+	//	Arguments:	1)	dataDir	The data directory
+	//
+	//	Returns:	E_ARGUMENT	If no data directory is supplied
+	//				E_OPENFAIL	If the journal cannot be read or written
+	//				E_OK		If the IP status table is loaded
 
-	ifstream	is ;			//	For reading the lists
-	hzIpinfo	ipi ;			//	IP block info
-	hzIpaddr	ipa ;			//	IP address
-	uint32_t	nLine ;			//	Line number
-	char		buf	[24] ;		//	Line buffer
-	hzEcode		rc = E_OK ;		//	Return code
+	hzEcode		rc ;	//	Return code
 
 	if (!dataDir)
 		return E_ARGUMENT ;
@@ -443,130 +761,35 @@ hzEcode	InitIpInfo	(const hzString& dataDir)
 	if (rc != E_OK)
 		return rc ;
 
-	s_status_ip_fname = dataDir + "/status_ip.ips" ;
-
-	rc = TestFile(s_status_ip_fname) ;
-	if (rc == E_OK)
-	{
-		is.open(*s_status_ip_fname) ;
-		if (is.fail())
-			return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Cannot open file %s\n", *s_status_ip_fname) ;
-
-		for (nLine = 1 ;; nLine++)
-		{
-			is.getline(buf, 23) ;
-			if (!is.gcount())
-				break ;
-			ipa = buf ;
-			if (!ipa)
-				threadLog("%s: Line %d of file %s, is not a valid IP address\n", *_fn, nLine, *s_status_ip_fname) ;
-			else
-				_hzGlobal_StatusIP.Insert(ipa, ipi) ;
-		}
-		is.close() ;
-		is.clear() ;
-		threadLog("%s: Loaded %d IP address in WHITELIST\n", *_fn, _hzGlobal_StatusIP.Count()) ;
-	}
-	else
-	{
-		if (rc != E_NOTFOUND)
-			return hzerr(_fn, HZ_ERROR, rc, "File error %s\n", *s_status_ip_fname) ;
-	}
-
-	rc = E_OK ;
-	s_status_ip_os.open(*s_status_ip_fname, ios::app) ;
-	if (s_status_ip_os.fail())
-		{ rc = E_OPENFAIL ; threadLog("%s: Cannot open %s for writing\n", *_fn, *s_status_ip_fname) ; }
-
-	return rc ;
+	return _hzGlobal_StatusIP.Load(dataDir + "/status_ip.ips") ;
 }
 
 void	SetStatusIP	(hzIpaddr ipa, hzIpStatus reason, uint32_t nDelay)
 {
 	//	Category:	Internet Server
 	//
-	//	Set reason for noting the IP address. Add the IP address to _hzGlobal_StatusIP if not already present.
-
-	_hzfunc(__func__) ;
-
-	hzIpinfo	ipi ;		//	IP test blocker
-
-	if (ipa == IPADDR_BAD || ipa == IPADDR_NULL || ipa == IPADDR_LOCAL)
-		return ;
-
-	//threadLog("%s: Setting Status of IP %s\n", *_fn, *ipa.Str()) ;
-
-	if (!_hzGlobal_StatusIP.Exists(ipa))
-	{
-		s_status_ip_os << ipa.Str() << "\n" ;
-		if (!s_status_ip_os.fail())
-			//threadLog("BLOCKED IP ADDR NOT RECORDED %s\n", *ipa.Str()) ;
-		//else
-			s_status_ip_os.flush() ;
-
-		ipi.m_nSince = 1 ;
-		ipi.m_nTotal = 1 ;
-		ipi.m_bInfo |= (reason & 0xff) ;
-
-		if (reason & HZ_IPSTATUS_BLACK)
-			ipi.m_tBlack = time(0) ;
-		if (reason & HZ_IPSTATUS_WHITE)
-			ipi.m_tWhite = time(0) ;
-		_hzGlobal_StatusIP.Insert(ipa, ipi) ;
-			//note.Printf("BLOCKED IP ADDR ADDED TO LOCAL %s (count %u)\n", *ipa.Str(), _hzGlobal_StatusIP.Count()) ;
-	}
-	else
-	{
-		ipi = _hzGlobal_StatusIP[ipa] ;
-
-		//	If status has changed, note this in the file
-		if ((ipi.m_bInfo | reason) != ipi.m_bInfo)
-		{
-			ipi.m_bInfo |= reason ;
-			if (reason & HZ_IPSTATUS_BLACK)
-				ipi.m_tBlack = nDelay ? nDelay + time(0) : 0 ;
-			if (reason & HZ_IPSTATUS_WHITE)
-				ipi.m_tWhite = nDelay ? nDelay + time(0) : 0 ;
-		}
-
-		s_status_ip_os << ipa.Str() << "\n" ;
-		if (s_status_ip_os.fail())
-			threadLog("%s: BLOCKED IP ADDR NOT RECORDED %s\n", *_fn, *ipa.Str()) ;
-		else
-			s_status_ip_os.flush() ;
-	}
+	//	Black and/or white list the IP address for the given reason (see hzIpTable::Set)
+	//
+	//	Arguments:	1)	ipa		The IP address
+	//				2)	reason	The reason
+	//				3)	nDelay	Number of seconds the status is to remain in force (0 for indefinitely)
+	//
+	//	Returns:	None
 
-	//note.Printf("IP ADDR BLOCKED %s %u times\n", *ipa.Str(), _hzGlobal_Blacklist[ipa].m_Count++) ;
-	//_hzGlobal_Blacklist[IpTest].m_Count++ ;
+	_hzGlobal_StatusIP.Set(ipa, reason, nDelay) ;
 }
 
 hzIpStatus	GetStatusIP	(hzIpaddr ipa)
 {
 	//	Category:	Internet Server
 	//
-	//	Retrieve the record for the IP address.
-
-	_hzfunc(__func__) ;
-
-	hzIpinfo	ipi ;		//	IP test blocker
-	uint32_t	now ;		//	Epoch time
-	uint32_t	ips ;		//	IP status as it currently applies
-
-	ips = (uint32_t) HZ_IPSTATUS_NULL ;
-	if (!_hzGlobal_StatusIP.Exists(ipa))
-		return HZ_IPSTATUS_NULL ;
-
-	//	We have info on the IP address, but does it still apply?
-	now = time(0) ;
-	ipi = _hzGlobal_StatusIP[ipa] ;
-
-	if (ipi.m_bInfo & HZ_IPSTATUS_WHITE && (!ipi.m_tWhite || ipi.m_tWhite > now))
-		ips |= HZ_IPSTATUS_WHITE ;
-
-	if (ipi.m_bInfo & HZ_IPSTATUS_BLACK && (!ipi.m_tWhite || ipi.m_tBlack > now))
-		ips |= HZ_IPSTATUS_BLACK ;
+	//	Retrieve the status of the IP address as it currently applies (see hzIpTable::Status)
+	//
+	//	Arguments:	1)	ipa		The IP address
+	//
+	//	Returns:	The status
 
-	return (hzIpStatus) ips ;
+	return _hzGlobal_StatusIP.Status(ipa) ;
 }
 
 #if 0
@@ -624,6 +847,90 @@ hzEcode	hzTcpListen::Init	(	hzTcpCode	(*OnIngress)(hzChain&, hzIpConnex*),
 	return E_OK ;
 }
 
+hzEcode	hzTcpListen::SetRateLimit	(hzRateScope eScope, uint32_t nRate, uint32_t nBurst)
+{
+	//	Apply a rate limit to the listening socket. Limits may be set before or after Activate() but not changed once set.
+	//
+	//	Arguments:	1)	eScope	What is to be limited
+	//				2)	nRate	Connections or messages per second
+	//				3)	nBurst	Connections or messages allowed at once
+	//
+	//	Returns:	E_ARGUMENT	If the scope is invalid or either the rate or burst is zero
+	//				E_RANGE		If the burst exceeds 1,000,000
+	//				E_INITDUP	If the limit is already set
+	//				E_MEMORY	If the per address limit could not be allocated
+	//				E_OK		If the limit is set
+
+	_hzfunc("hzTcpListen::SetRateLimit") ;
+
+	if (!nRate || !nBurst)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Port %d: Rate (%u) and burst (%u) must both be non-zero", m_nPort, nRate, nBurst) ;
+	if (nBurst > 1000000)
+		return hzerr(_fn, HZ_ERROR, E_RANGE, "Port %d: Burst of %u exceeds the limit of 1000000", m_nPort, nBurst) ;
+
+	switch	(eScope)
+	{
+	case HZ_RATE_PORT:		if (m_nPortRate)
+								return E_INITDUP ;
+							m_nPortRate = nRate ;
+							m_nPortBurst = nBurst ;
+							return E_OK ;
+
+	case HZ_RATE_IPCONN:	return m_IpConnRate.Init(nRate, nBurst) ;
+	case HZ_RATE_IPMSG:		return m_IpMsgRate.Init(nRate, nBurst) ;
+	default:
+		break ;
+	}
+
+	return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Port %d: Invalid rate limit scope %d", m_nPort, eScope) ;
+}
+
+hzRateScope	hzTcpListen::AdmitConn	(hzIpaddr ipa)
+{
+	//	Apply the connection rate limits of the listening socket to a newly accepted connection. This is called by the serving loops before any handler runs.
+	//	A refusal by the per address limit counts as an offence against the address (see hzIpTable::Offence), so an address which persists in connecting too
+	//	fast is black listed and thereafter refused before the limits are consulted.
+	//
+	//	Arguments:	1)	ipa		The client IP address
+	//
+	//	Returns:	HZ_RATE_NONE	If the connection is admitted
+	//				HZ_RATE_PORT	If the connection is refused by the port limit
+	//				HZ_RATE_IPCONN	If the connection is refused by the per address limit
+
+	if (!m_IpConnRate.Take(ipa))
+	{
+		m_nRefusedConn++ ;
+		_hzGlobal_StatusIP.Offence(ipa, HZ_IPSTATUS_BLACK_PROT) ;
+		return HZ_RATE_IPCONN ;
+	}
+
+	if (m_nPortRate && !m_PortRate.Take(hzTokenBucket::Now(), m_nPortRate, m_nPortBurst))
+	{
+		m_nRefusedConn++ ;
+		return HZ_RATE_PORT ;
+	}
+
+	return HZ_RATE_NONE ;
+}
+
+bool	hzTcpListen::AdmitMsg	(hzIpaddr ipa)
+{
+	//	Apply the per address message rate limit of the listening socket to a complete incoming message, before it is passed to the handler. This may be called
+	//	by several request threads at once (see ServeRequests). As with AdmitConn(), a refusal counts as an offence against the address.
+	//
+	//	Arguments:	1)	ipa		The client IP address
+	//
+	//	Returns:	True	If the message is admitted
+	//				False	If the message is refused
+
+	if (m_IpMsgRate.Take(ipa))
+		return true ;
+
+	__atomic_add_fetch(&m_nRefusedMsg, 1, __ATOMIC_RELAXED) ;
+	_hzGlobal_StatusIP.Offence(ipa, HZ_IPSTATUS_BLACK_PROT) ;
+	return false ;
+}
+
 #if 0
 #endif
 
@@ -703,50 +1010,393 @@ hzEcode	hzTcpListen::Activate	(void)
 }
 
 /*
-**	hzIpConnex members
+**	hzTrack members
 */
 
-hzIpConnex::hzIpConnex	(hzLogger* pLog)
-{
-	m_ConnExpires = m_nsAccepted = m_nsRecvBeg = m_nsRecvEnd = m_nsSendBeg = m_nsSendEnd = RealtimeNano() ;
-	m_pInfo = 0 ;
-	m_nSock = 0 ;
-	m_nPort = 0 ;
-	m_nMsgno = 0 ;
-	m_nGlitch = 0 ;
-	m_nStart = 0 ;
-	m_nExpected = 0 ;
-	m_pEventHdl = 0 ;
-	m_pLog = pLog ;
-	m_pSSL = 0 ;
-	m_bState = CLIENT_STATE_NONE ;
-	memset(m_ipbuf, 0, 44) ;
-}
+uint32_t	hzTrack::s_nSample = 0 ;	//	Sample one request in this many (0 for none)
+uint32_t	hzTrack::s_nSeen = 0 ;		//	Requests seen
 
-hzIpConnex::~hzIpConnex	(void)
+hzTrack::_event*	hzTrack::_slot	(const char* fmt, const char* cpText)
 {
-	if (m_nSock)
+	//	Claim the next slot in the ring, overwriting the oldest event if the ring is full. Under ServeEpollMT both the serving thread and a request thread may
+	//	record events on the connection, so the slot is claimed atomically.
+	//
+	//	Arguments:	1)	fmt		The event format (string literal, or null for an attached chain)
+	//				2)	cpText	The text argument (if any)
+	//
+	//	Returns:	Pointer to the slot, with the time, format and text set
+
+	_event*		pEv ;	//	The slot
+	uint32_t	nSlot ;	//	Slot number
+
+	if (_hzGlobal_MT)
+		nSlot = __sync_fetch_and_add(&m_nEvents, 1) ;
+	else
+		nSlot = m_nEvents++ ;
+
+	pEv = m_Ring + (nSlot % HZ_TRACK_SLOTS) ;
+	pEv->m_nsTime = RealtimeNano() ;
+	pEv->m_pFmt = fmt ;
+
+	if (cpText)
 	{
-		if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-			threadLog("NOTE: Connection under Destruction still has a socket %d\n", m_nSock) ;
-		close(m_nSock) ;
-		m_nSock = 0 ;
+		strncpy(pEv->m_Text, cpText, HZ_TRACK_TEXT - 1) ;
+		pEv->m_Text[HZ_TRACK_TEXT - 1] = 0 ;
 	}
+	else
+		pEv->m_Text[0] = 0 ;
 
-	if (m_pSSL)			SSL_free(m_pSSL) ;
-	if (m_pInfo)		delete m_pInfo ;
-	if (m_pEventHdl)	delete (hzHttpEvent*) m_pEventHdl ;
+	return pEv ;
 }
 
-hzEcode	hzIpConnex::Initialize	(hzTcpListen* pLS, SSL* pSSL, const char* cpIPAddr, uint32_t cliSock, uint32_t cliPort, uint32_t eventNo)
+void	hzTrack::Event	(const char* fmt, uint64_t a, uint64_t b, uint64_t c, uint64_t d)
 {
-	//	Initialize a TCP client connection (hzIpConnex instance). This is called from within the select and the epoll server functions and in general, server
-	//	programs based on HadronZoo would use one of the server functions and so have no need to call this function directly.
+	//	Record an event. Nothing is formatted unless the record is reported.
 	//
-	//	Arguments:	1)	Sock	The socket file descriptor
-	//				2)	nEvent	The event number (usually Nth connection)
-	//				3)	pLS		Pointer to the listening socket (hzTcpListen instance)
-	//				4)	pSSL	The SSL connection (if applicable)
+	//	Arguments:	1)	fmt		The event format (must be a string literal)
+	//				2)	a		First numeric argument
+	//				3)	b		Second numeric argument
+	//				4)	c		Third numeric argument
+	//				5)	d		Fourth numeric argument
+	//
+	//	Returns:	None
+
+	_event*	pEv ;	//	The slot
+
+	pEv = _slot(fmt, 0) ;
+	pEv->m_Args[0] = a ;
+	pEv->m_Args[1] = b ;
+	pEv->m_Args[2] = c ;
+	pEv->m_Args[3] = d ;
+}
+
+void	hzTrack::EventS	(const char* fmt, const char* s, uint64_t a, uint64_t b, uint64_t c)
+{
+	//	Record an event with a text argument, which is copied (to within HZ_TRACK_TEXT) as it may not outlive the call.
+	//
+	//	Arguments:	1)	fmt		The event format (must be a string literal)
+	//				2)	s		The text argument
+	//				3)	a		First numeric argument
+	//				4)	b		Second numeric argument
+	//				5)	c		Third numeric argument
+	//
+	//	Returns:	None
+
+	_event*	pEv ;	//	The slot
+
+	pEv = _slot(fmt, s ? s : "") ;
+	pEv->m_Args[0] = a ;
+	pEv->m_Args[1] = b ;
+	pEv->m_Args[2] = c ;
+	pEv->m_Args[3] = 0 ;
+}
+
+void	hzTrack::Error	(const char* fmt, uint64_t a, uint64_t b, uint64_t c, uint64_t d)
+{
+	//	Record an error. As Event() but the record will be reported when the connection terminates.
+	//
+	//	Arguments:	1)	fmt		The event format (must be a string literal)
+	//				2)	a		First numeric argument
+	//				3)	b		Second numeric argument
+	//				4)	c		Third numeric argument
+	//				5)	d		Fourth numeric argument
+	//
+	//	Returns:	None
+
+	Event(fmt, a, b, c, d) ;
+	m_bReport = true ;
+}
+
+void	hzTrack::ErrorS	(const char* fmt, const char* s, uint64_t a, uint64_t b, uint64_t c)
+{
+	//	Record an error with a text argument. As EventS() but the record will be reported when the connection terminates.
+	//
+	//	Arguments:	1)	fmt		The event format (must be a string literal)
+	//				2)	s		The text argument
+	//				3)	a		First numeric argument
+	//				4)	b		Second numeric argument
+	//				5)	c		Third numeric argument
+	//
+	//	Returns:	None
+
+	EventS(fmt, s, a, b, c) ;
+	m_bReport = true ;
+}
+
+void	hzTrack::_attach	(const hzChain& Z, const char* cpTitle)
+{
+	//	Copy a chain into the next of the HZ_TRACK_ATTACH attachment slots (replacing the oldest attachment) and record an event referring to it.
+	//
+	//	Arguments:	1)	Z		The chain
+	//				2)	cpTitle	Title given to the chain when reported
+	//
+	//	Returns:	None
+
+	_event*		pEv ;	//	The slot
+	uint32_t	nSeq ;	//	Attachment sequence
+
+	if (_hzGlobal_MT)
+		nSeq = __sync_fetch_and_add(&m_nAttach, 1) ;
+	else
+		nSeq = m_nAttach++ ;
+
+	m_Attach[nSeq % HZ_TRACK_ATTACH].Clear() ;
+	m_Attach[nSeq % HZ_TRACK_ATTACH] << Z ;
+
+	pEv = _slot(0, cpTitle) ;
+	pEv->m_Args[0] = nSeq ;
+	pEv->m_Args[1] = Z.Size() ;
+	pEv->m_Args[2] = pEv->m_Args[3] = 0 ;
+}
+
+void	hzTrack::Attach	(const hzChain& Z, bool bError)
+{
+	//	Attach a chain (such as a report compiled by the application) to the record. An error report is always copied and ensures the record is reported. Any
+	//	other chain is only copied if the record is sure to be reported (see Verbose), otherwise only its size is recorded.
+	//
+	//	Arguments:	1)	Z		The chain
+	//				2)	bError	True if the chain is an error report
+	//
+	//	Returns:	None
+
+	if (!Z.Size())
+		return ;
+
+	if (bError)
+	{
+		_attach(Z, "Error report") ;
+		m_bReport = true ;
+		return ;
+	}
+
+	if (Verbose())
+		_attach(Z, "Report") ;
+	else
+		Event("Report of %u bytes (not kept)", Z.Size()) ;
+}
+
+bool	hzTrack::Sample	(void)
+{
+	//	Decide if the request now beginning on the connection is to be sampled, that is recorded in full (see SetSample).
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	True if the request is sampled
+
+	uint32_t	nSeen ;		//	Requests seen
+
+	m_bSample = false ;
+
+	if (s_nSample)
+	{
+		if (_hzGlobal_MT)
+			nSeen = __sync_add_and_fetch(&s_nSeen, 1) ;
+		else
+			nSeen = ++s_nSeen ;
+
+		if (!(nSeen % s_nSample))
+			m_bSample = true ;
+	}
+
+	return m_bSample ;
+}
+
+void	hzTrack::Payload	(const hzChain& Z)
+{
+	//	Record a request in full if it is sampled. The record will then be reported when the connection terminates.
+	//
+	//	Arguments:	1)	Z	The request
+	//
+	//	Returns:	None
+
+	if (!m_bSample)
+		return ;
+
+	_attach(Z, "Sampled request") ;
+	m_bReport = true ;
+}
+
+void	hzTrack::Printf	(const char* va_alist ...)
+{
+	//	Record a line formatted at once, for applications recording events in the manner of hzChain::Printf. The line is truncated to HZ_TRACK_TEXT. Note that
+	//	as the format is applied by vsnprintf, the HadronZoo specific directives are not available.
+	//
+	//	Arguments:	1)	va_alist	The format, followed by the arguments
+	//
+	//	Returns:	None
+
+	va_list		ap ;	//	Argument list
+	_event*		pEv ;	//	The slot
+	uint32_t	nLen ;	//	Length of line
+
+	pEv = _slot("%s", 0) ;
+	pEv->m_Args[0] = pEv->m_Args[1] = pEv->m_Args[2] = pEv->m_Args[3] = 0 ;
+
+	va_start(ap, va_alist) ;
+	vsnprintf(pEv->m_Text, HZ_TRACK_TEXT, va_alist, ap) ;
+	va_end(ap) ;
+
+	//	Each event is reported on a line of its own
+	for (nLen = strlen(pEv->m_Text) ; nLen && pEv->m_Text[nLen - 1] == CHAR_NL ; nLen--)
+		pEv->m_Text[nLen - 1] = 0 ;
+}
+
+void	hzTrack::Report	(hzChain& Z) const
+{
+	//	Format the record, oldest event first. Each event is given its time (seconds and microseconds of the Epoch) followed by its format applied to its
+	//	arguments. Attached chains are reported in full if they are still held.
+	//
+	//	Arguments:	1)	Z	The chain to which the report is appended
+	//
+	//	Returns:	None
+
+	const _event*	pEv ;		//	Current event
+	const char*		i ;			//	Format iterator
+	uint64_t		nArg ;		//	Numeric argument
+	uint32_t		nFirst ;	//	Oldest event still held
+	uint32_t		nEvent ;	//	Event iterator
+	uint32_t		nIdx ;		//	Numeric argument index
+	char			buf[32] ;	//	Numeric argument as text
+
+	nFirst = m_nEvents > HZ_TRACK_SLOTS ? m_nEvents - HZ_TRACK_SLOTS : 0 ;
+	if (nFirst)
+		Z.Printf("(%u earlier events not held)\n", nFirst) ;
+
+	for (nEvent = nFirst ; nEvent < m_nEvents ; nEvent++)
+	{
+		pEv = m_Ring + (nEvent % HZ_TRACK_SLOTS) ;
+
+		sprintf(buf, "%u.%06u ", (uint32_t) (pEv->m_nsTime / 1000000000), (uint32_t) ((pEv->m_nsTime / 1000) % 1000000)) ;
+		Z << buf ;
+
+		if (!pEv->m_pFmt)
+		{
+			//	Attached chain
+			if ((m_nAttach - pEv->m_Args[0]) <= HZ_TRACK_ATTACH)
+			{
+				Z.Printf("%s (%u bytes):\n", pEv->m_Text, (uint32_t) pEv->m_Args[1]) ;
+				Z << m_Attach[pEv->m_Args[0] % HZ_TRACK_ATTACH] ;
+				Z.AddByte(CHAR_NL) ;
+			}
+			else
+				Z.Printf("%s (%u bytes) no longer held\n", pEv->m_Text, (uint32_t) pEv->m_Args[1]) ;
+			continue ;
+		}
+
+		for (nIdx = 0, i = pEv->m_pFmt ; *i ; i++)
+		{
+			if (*i != CHAR_PERCENT)
+				{ Z.AddByte(*i) ; continue ; }
+
+			for (i++ ; *i == 'l' ; i++) ;
+
+			if (*i == 's')
+				{ Z << pEv->m_Text ; continue ; }
+
+			if (*i != 'd' && *i != 'u' && *i != 'x')
+			{
+				//	A double percent, or any other directive, is reproduced as is
+				Z.AddByte(CHAR_PERCENT) ;
+				if (!*i)
+					break ;
+				if (*i != CHAR_PERCENT)
+					Z.AddByte(*i) ;
+				continue ;
+			}
+
+			nArg = nIdx < 4 ? pEv->m_Args[nIdx++] : 0 ;
+
+			if (*i == 'd')
+				sprintf(buf, "%lld", (long long) (int64_t) nArg) ;
+			else if (*i == 'u')
+				sprintf(buf, "%llu", (unsigned long long) nArg) ;
+			else
+				sprintf(buf, "%llx", (unsigned long long) nArg) ;
+			Z << buf ;
+		}
+		Z.AddByte(CHAR_NL) ;
+	}
+}
+
+void	hzTrack::Clear	(void)
+{
+	//	Clear the record, as the connection object is to serve another connection
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	None
+
+	uint32_t	n ;		//	Attachment iterator
+
+	for (n = 0 ; n < HZ_TRACK_ATTACH ; n++)
+		m_Attach[n].Clear() ;
+
+	m_nEvents = m_nAttach = 0 ;
+	m_bReport = m_bSample = false ;
+}
+
+/*
+**	hzIpConnex members
+*/
+
+hzIpConnex::hzIpConnex	(hzLogger* pLog)
+{
+	m_ConnExpires = m_nsAccepted = m_nsRecvBeg = m_nsRecvEnd = m_nsSendBeg = m_nsSendEnd = RealtimeNano() ;
+	m_nsHandshake = 0 ;
+	m_nsTTL = 25000000000 ;
+	m_Timer.m_pObj = this ;
+	m_pInfo = 0 ;
+	m_pPoolNext = 0 ;
+	m_pListen = 0 ;
+	m_pSource = 0 ;
+	m_nEvTag = 0 ;
+	m_nSock = 0 ;
+	m_nSrcSock = 0 ;
+	m_nPort = 0 ;
+	m_nLsPort = 0 ;
+	m_nResponses = 0 ;
+	m_nUring = 0 ;
+	m_bInHeld = false ;
+	m_nReqHold = 0 ;
+	m_nMsgno = 0 ;
+	m_nGlitch = 0 ;
+	m_nStart = 0 ;
+	m_nExpected = 0 ;
+	m_pEventHdl = 0 ;
+	m_pWsHdl = 0 ;
+	m_OnIdle = 0 ;
+	m_pLog = pLog ;
+	m_pSSL = 0 ;
+	m_bState = CLIENT_STATE_NONE ;
+	memset(m_ipbuf, 0, 44) ;
+}
+
+hzIpConnex::~hzIpConnex	(void)
+{
+	if (m_nSock)
+	{
+		if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+			threadLog("NOTE: Connection under Destruction still has a socket %d\n", m_nSock) ;
+		close(m_nSock) ;
+		m_nSock = 0 ;
+	}
+
+	if (m_pSSL)			SSL_free(m_pSSL) ;
+	if (m_pInfo)		delete m_pInfo ;
+	if (m_pEventHdl)	delete (hzHttpEvent*) m_pEventHdl ;
+	if (m_pWsHdl)		delete (hzWebSocket*) m_pWsHdl ;
+	_dropSources() ;
+}
+
+hzEcode	hzIpConnex::Initialize	(hzTcpListen* pLS, SSL* pSSL, const char* cpIPAddr, uint32_t cliSock, uint32_t cliPort, uint32_t eventNo)
+{
+	//	Initialize a TCP client connection (hzIpConnex instance). This is called from within the select and the epoll server functions and in general, server
+	//	programs based on HadronZoo would use one of the server functions and so have no need to call this function directly.
+	//
+	//	Arguments:	1)	Sock	The socket file descriptor
+	//				2)	nEvent	The event number (usually Nth connection)
+	//				3)	pLS		Pointer to the listening socket (hzTcpListen instance)
+	//				4)	pSSL	The SSL connection (if applicable)
 	//				5)	cpIpa	The text representation of the client IP address
 	//
 	//	Returns:	E_ARGUMENT	If either the socket or the pointer to the listening socket is not supplied
@@ -760,26 +1410,57 @@ hzEcode	hzIpConnex::Initialize	(hzTcpListen* pLS, SSL* pSSL, const char* cpIPAdd
 	if (!pLS)
 		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No listening socket class instance provided") ;
 
+	hzPortStats*	pStats ;	//	Metrics block for the listening port
+
 	//	SetState(*_fn, HZCONNEX_ACPT) ;
 	m_nsAccepted = RealtimeNano() ;
 
 	m_nSock = cliSock ;
 	m_nPort = cliPort ;
+	m_nLsPort = pLS->GetPort() ;
+	m_pListen = pLS ;
 	m_nMsgno = eventNo ;
 
+	//	The object may have served an earlier connection (see hzConnTable) so reset the per-connection values
+	m_nsRecvBeg = m_nsRecvEnd = m_nsSendBeg = m_nsSendEnd = m_nsAccepted ;
+	m_nResponses = 0 ;
+	m_nUring = 0 ;
+	m_bInHeld = false ;
+	m_nReqHold = 0 ;
+	m_nsHandshake = 0 ;
+	m_nsTTL = 25000000000 ;
+	m_nGlitch = m_nStart = m_nExpected = 0 ;
+	m_nTotalIn = m_nTotalOut = 0 ;
+
 	m_OnIngress = pLS->m_OnIngress ;
 	m_OnConnect = pLS->m_OnConnect ;
+	m_OnIdle = 0 ;
 	m_appFn = pLS->m_appFn ;
 	m_pSSL = pSSL ;
 	m_pLog = pLS->GetLogger() ;
 
 	strcpy(m_ipbuf, cpIPAddr) ;
 	m_ClientIP = cpIPAddr ;
+	if (pLS->GetTimeout())
+		m_nsTTL = (uint64_t) pLS->GetTimeout() * 1000000000 ;
 	Oxygen() ;
 	m_bState = CLIENT_INITIALIZED ;
+	if (m_pSSL)
+		m_bState |= CLIENT_HANDSHAKE ;
+
+	//	On HTTP ports a hzHttpEvent is only attached once a request arrives (see HandleHttpMsg). Any left over from the earlier connection is returned to the pool.
+	_dropEvent() ;
+
+	//	A WebSocket of the earlier connection is only deleted now, as the application may have held on to it until notified of the closure
+	if (m_pWsHdl)
+	{
+		delete (hzWebSocket*) m_pWsHdl ;
+		m_pWsHdl = 0 ;
+	}
 
-	if (pLS->Opflags() & HZ_LISTEN_HTTP)
-		m_pEventHdl = (void*) new hzHttpEvent(m_Input, this) ;
+	pStats = hzMetrics::Stats(m_nLsPort) ;
+	if (pStats)
+		pStats->Conn() ;
 	return E_OK ;
 }
 
@@ -797,38 +1478,148 @@ void	hzIpConnex::Terminate	(void)
 	_hzfunc("hzIpConnex::Terminate") ;
 
 	struct epoll_event	epEv ;		//	Epoll event for depricated connection
+	hzChain				Z ;			//	Report of connection record
 	hzXDate				now ;		//	Time now
 
 	m_Input.Clear() ;
 	m_nExpected = 0 ;
+
+	//	Discard any request part way through being received, as this may have uploads in temporary files, and return the event to the pool. Under ServeEpollMT
+	//	the event may still be in use by a request thread. In that case it is marked as orphaned and the request thread releases it once done (ServeRequests).
+	if (!(__atomic_fetch_or(&m_nReqHold, HZ_REQ_ORPHAN, __ATOMIC_ACQ_REL) & ~HZ_REQ_ORPHAN))
+		_dropEvent() ;
 	if (m_Outgoing.Size())
 		m_Outgoing.Clear() ;
+	_dropSources() ;
+
+	//	Tell the application the WebSocket (if any) has closed
+	if (m_pWsHdl)
+		((hzWebSocket*) m_pWsHdl)->Closed() ;
+
+	if (m_Timer.m_pWheel)
+		m_Timer.m_pWheel->Cancel(&m_Timer) ;
 
 	if (!m_nSock)
-		m_Track.Printf("%s: No socket - Has Terminate already been called?\n", *_fn) ;
+		m_Track.Error("Terminate: No socket - Has Terminate already been called?") ;
 	else
 	{
-		if (epoll_ctl(epollSocket, EPOLL_CTL_DEL, m_nSock, &epEv) < 0)
-			m_Track.Printf("%s: EPOLL ERROR: Could not del client connection handler on sock %d/%d. Error=%s\n", *_fn, m_nSock, m_nPort, strerror(errno)) ;
+		//	Under ServeUring there is no epoll registration. The serving loop only calls this once all operations on the socket have completed.
+		if (!s_pUring && epoll_ctl(epollSocket, EPOLL_CTL_DEL, m_nSock, &epEv) < 0)
+			m_Track.ErrorS("Terminate: EPOLL ERROR: Could not del client connection handler on sock %u/%u. Error=%s", strerror(errno), m_nSock, m_nPort) ;
+
+		//	Unless the TLS connection is shut down, OpenSSL deems the session unfit for resumption and removes it from the session cache. So where the handshake
+		//	completed, send the close_notify if the client is still there, otherwise just mark the connection as shut down.
+		if (m_pSSL && !(m_bState & CLIENT_HANDSHAKE))
+		{
+			if (m_bState & (CLIENT_HANGUP | CLIENT_TERMINATION | CLIENT_BAD))
+				SSL_set_shutdown(m_pSSL, SSL_SENT_SHUTDOWN) ;
+			else
+				SSL_shutdown(m_pSSL) ;
+		}
 
 		if (close(m_nSock) < 0)
-			m_Track.Printf("%s: Could not close socket %d for event %d on IP %s. Errno=%s", *_fn, m_nSock, m_nMsgno, m_ipbuf, strerror(errno)) ;
+			m_Track.ErrorS("Terminate: Could not close socket %u for event %u. Errno=%s", strerror(errno), m_nSock, m_nMsgno) ;
 		else
-			m_Track.Printf("%s: Socket %d closed\n", *_fn, m_nSock) ;
+			m_Track.Event("Terminate: Socket %u closed", m_nSock) ;
 
 		m_nSock = 0 ;
 	}
 
-	if (m_Track.Size())
+	if (m_pSSL)
+	{
+		//	The connection object may be reused for a later client on the same socket so the SSL session must go with the socket
+		SSL_free(m_pSSL) ;
+		m_pSSL = 0 ;
+	}
+
+	//	The record is only formatted and logged if an error or a sampled request was recorded, or if server debugging is on
+	if (m_Track.Due())
 	{
 		now.SysDateTime() ;
 
-		m_Track.Printf("Terminated at %s\n\n", *now.Str(FMT_TIME_USEC)) ;
-		m_pLog->Out("\n-- Start -- \n") ;
-		m_pLog->Out(m_Track) ;
+		Z.Printf("\n-- Start -- Event %u IP %s port %u\n", m_nMsgno, m_ipbuf, m_nLsPort) ;
+		m_Track.Report(Z) ;
+		Z.Printf("Terminated at %s\n\n", *now.Str(FMT_TIME_USEC)) ;
+		m_pLog->Out(Z) ;
 	}
 }
 
+hzHandshake	hzIpConnex::Handshake	(void)
+{
+	//	Advance the TLS handshake on a secure connection. The client socket is non-blocking so SSL_accept() only progresses as far as the data available allows,
+	//	and returns either success, a request to be called again when the socket is readable (or writable), or a genuine failure. The epoll loop calls this
+	//	function on each event on the socket until the handshake is no longer pending. Slow or malicious clients therefore hold up only their own connection.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	HANDSHAKE_DONE			If the handshake has completed (or the connection is not secure)
+	//				HANDSHAKE_WANT_READ		If the handshake awaits data from the client
+	//				HANDSHAKE_WANT_WRITE	If the handshake awaits the socket becoming writable
+	//				HANDSHAKE_FAILED		If the handshake failed
+
+	_hzfunc("hzIpConnex::Handshake") ;
+
+	X509*		client_cert ;	//	Client certificate
+	char*		clicert_str ;	//	Client certificate string
+	int32_t		sys_rc ;		//	Return from SSL_accept
+	int32_t		err ;			//	SSL error code
+
+	if (!m_pSSL || !(m_bState & CLIENT_HANDSHAKE))
+		return HANDSHAKE_DONE ;
+
+	ERR_clear_error() ;
+	sys_rc = SSL_accept(m_pSSL) ;
+
+	if (sys_rc <= 0)
+	{
+		err = SSL_get_error(m_pSSL, sys_rc) ;
+
+		if (err == SSL_ERROR_WANT_READ)
+			return HANDSHAKE_WANT_READ ;
+		if (err == SSL_ERROR_WANT_WRITE)
+			return HANDSHAKE_WANT_WRITE ;
+
+		m_Track.Error("Handshake: Failed to accept SSL client sock %u/%u (err=%d)", m_nSock, m_nPort, err) ;
+		MetricError() ;
+		return HANDSHAKE_FAILED ;
+	}
+
+	m_bState &= ~CLIENT_HANDSHAKE ;
+
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+	//	If the kernel has taken over encryption of outgoing data, responses can be written directly to the socket
+	if (BIO_get_ktls_send(SSL_get_wbio(m_pSSL)))
+		m_bState |= CLIENT_KTLS ;
+#endif
+
+	if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+		m_Track.EventS("Handshake: SSL connection on sock %u using %s (resumed %u kTLS %u)", SSL_get_cipher(m_pSSL), m_nSock,
+			SSL_session_reused(m_pSSL) ? 1 : 0, m_bState & CLIENT_KTLS ? 1 : 0) ;
+
+	if (verify_callback)
+	{
+		//	Get the client's certificate (optional)
+		client_cert = SSL_get_peer_certificate(m_pSSL) ;
+
+		if (!client_cert)
+			m_Track.Event("Handshake: The SSL client does not have certificate") ;
+		else
+		{
+			clicert_str = X509_NAME_oneline(X509_get_subject_name(client_cert), 0, 0) ;
+			if (clicert_str)
+				{ m_Track.EventS("Handshake: Subject of Client Cert: %s", clicert_str) ; free(clicert_str) ; }
+
+			clicert_str = X509_NAME_oneline(X509_get_issuer_name(client_cert), 0, 0) ;
+			if (clicert_str)
+				{ m_Track.EventS("Handshake: Issuer of Client Cert: %s", clicert_str) ; free(clicert_str) ; }
+
+			X509_free(client_cert) ;
+		}
+	}
+
+	return HANDSHAKE_DONE ;
+}
+
 hzEcode	hzPktQue::Push	(const hzChain& Z)
 {
 	//	Send a response to the client. This function should always be called by applications rather than writing to the client socket directly as this
@@ -870,48 +1661,191 @@ hzEcode	hzPktQue::Push	(const hzChain& Z)
 			//sofar += m_pFinal->m_size ;
 			m_pFinal->m_seq = ++m_nSeq ;
 		}
+		__sync_add_and_fetch(&s_nOutQueued, Z.Size()) ;
 	}
 
 	//	SetState(*_fn, HZCONNEX_XMIT) ;
 	return E_OK ;
 }
 
-hzEcode	hzPktQue::Pull	(void)
+hzEcode	hzPktQue::Push	(const char* pData, uint32_t nLen)
 {
-	//	Remove the first block in the packet queue
-
-	_hzfunc("hzPktQue::Pull") ;
+	//	Append data to the queue, as packets of up to HZ_MAXPACKET bytes. This is for producers of outgoing data (hzOutSource) that do not assemble it in a
+	//	chain beforehand.
+	//
+	//	Arguments:	1)	pData	The data
+	//				2)	nLen	Length of data
+	//
+	//	Returns:	E_OK	In all cases
 
-	hzPacket*	pkt ;		//	Temp packet pointer
+	uint32_t	nPart ;		//	Bytes in packet
 
-	pkt = m_pStart ;
-	if (pkt)
+	for (nPart = 0 ; nLen ; nLen -= nPart, pData += nPart)
 	{
-		m_nSize -= pkt->m_size ;
-		m_pStart = m_pStart->next ;
-		_tcpbufDeleteOne(pkt) ;
-
-		if (!m_pStart)
+		if (!m_pFinal)
+			m_pFinal = m_pStart = _tcpbufAlloc() ;
+		else
 		{
-			m_pFinal = 0 ;
-			m_nSize = 0 ;
+			m_pFinal->next = _tcpbufAlloc() ;
+			m_pFinal = m_pFinal->next ;
 		}
+
+		nPart = nLen < HZ_MAXPACKET ? nLen : HZ_MAXPACKET ;
+		memcpy(m_pFinal->m_data, pData, nPart) ;
+		m_pFinal->m_size = nPart ;
+		m_pFinal->m_seq = ++m_nSeq ;
+		m_nSize += nPart ;
+		__sync_add_and_fetch(&s_nOutQueued, nPart) ;
 	}
-}
 
-hzEcode	hzPktQue::Clear	(void)
-{
-	//	Remove all packets in packet queue
+	return E_OK ;
+}
 
-	_hzfunc("hzPktQue::Clear") ;
+/*
+**	Output sources
+*/
 
-	if (m_pFinal)
-	{
-		m_pFinal->next = s_pTcpBuffer_freelist ;
-		s_pTcpBuffer_freelist = m_pStart ;
-	}
-	m_pStart = m_pFinal = 0 ;
-	m_nSize = 0 ;
+hzOutFile::~hzOutFile	(void)
+{
+	if (m_nFd >= 0)
+		close(m_nFd) ;
+}
+
+hzEcode	hzOutFile::Open	(const char* cpPath, uint64_t nOffset, uint32_t nBytes)
+{
+	//	Open a file as an output source. The data sent is the whole file from the given offset, or the given number of bytes from the offset.
+	//
+	//	Arguments:	1)	cpPath	Pathname of file
+	//				2)	nOffset	Offset of first byte to send
+	//				3)	nBytes	Number of bytes to send (0 for all to end of file)
+	//
+	//	Returns:	E_ARGUMENT	If no path is supplied
+	//				E_OPENFAIL	If the file could not be opened
+	//				E_RANGE		If the range is beyond the end of the file or the file is too large
+	//				E_OK		If the file is open
+
+	_hzfunc("hzOutFile::Open") ;
+
+	struct stat	fs ;	//	File status
+
+	if (!cpPath || !cpPath[0])
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No pathname supplied") ;
+
+	if (m_nFd >= 0)
+		close(m_nFd) ;
+
+	m_nFd = open(cpPath, O_RDONLY) ;
+	if (m_nFd < 0)
+		return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Could not open %s", cpPath) ;
+
+	if (fstat(m_nFd, &fs) < 0 || nOffset > (uint64_t) fs.st_size)
+		return hzerr(_fn, HZ_ERROR, E_RANGE, "Offset %l beyond end of %s", nOffset, cpPath) ;
+
+	if (!nBytes)
+	{
+		if (((uint64_t) fs.st_size - nOffset) > 0xffffffff)
+			return hzerr(_fn, HZ_ERROR, E_RANGE, "File %s too large", cpPath) ;
+		nBytes = fs.st_size - nOffset ;
+	}
+	else if ((nOffset + nBytes) > (uint64_t) fs.st_size)
+		return hzerr(_fn, HZ_ERROR, E_RANGE, "Range %l+%u beyond end of %s", nOffset, nBytes, cpPath) ;
+
+	m_nPosn = nOffset ;
+	m_nLeft = m_nSize = nBytes ;
+	return E_OK ;
+}
+
+hzEcode	hzOutFile::Fill	(hzPktQue& Q, uint32_t nMax)
+{
+	//	Read up to nMax bytes (limited to HZ_OUT_CHUNK) from the file and append them to the queue
+	//
+	//	Arguments:	1)	Q		The outgoing queue
+	//				2)	nMax	Bytes wanted
+	//
+	//	Returns:	E_NODATA	If the file is exhausted
+	//				E_READFAIL	If the file could not be read
+	//				E_OK		If data was queued
+
+	char	buf[HZ_OUT_CHUNK] ;		//	Read buffer
+	int32_t	nRead ;					//	Bytes read
+
+	if (!m_nLeft)
+		return E_NODATA ;
+	if (m_nFd < 0)
+		return E_READFAIL ;
+
+	if (nMax > HZ_OUT_CHUNK)	nMax = HZ_OUT_CHUNK ;
+	if (nMax > m_nLeft)			nMax = m_nLeft ;
+
+	nRead = pread(m_nFd, buf, nMax, m_nPosn) ;
+	if (nRead <= 0)
+		return E_READFAIL ;
+
+	Q.Push(buf, nRead) ;
+	m_nPosn += nRead ;
+	m_nLeft -= nRead ;
+	return m_nLeft ? E_OK : E_NODATA ;
+}
+
+hzEcode	hzOutChain::Fill	(hzPktQue& Q, uint32_t nMax)
+{
+	//	Append blocks of the chain to the queue until at least nMax bytes have been appended or the chain is exhausted
+	//
+	//	Arguments:	1)	Q		The outgoing queue
+	//				2)	nMax	Bytes wanted
+	//
+	//	Returns:	E_NODATA	If the chain is exhausted
+	//				E_OK		If data was queued
+
+	uint32_t	nDone ;		//	Bytes queued
+
+	for (nDone = 0 ; nDone < nMax && m_Blk.Data() ; m_Blk.Advance())
+	{
+		Q.Push((const char*) m_Blk.Data(), m_Blk.Size()) ;
+		nDone += m_Blk.Size() ;
+	}
+
+	return m_Blk.Data() ? E_OK : E_NODATA ;
+}
+
+hzEcode	hzPktQue::Pull	(void)
+{
+	//	Remove the first block in the packet queue
+
+	_hzfunc("hzPktQue::Pull") ;
+
+	hzPacket*	pkt ;		//	Temp packet pointer
+
+	pkt = m_pStart ;
+	if (pkt)
+	{
+		m_nSize -= pkt->m_size ;
+		__sync_sub_and_fetch(&s_nOutQueued, pkt->m_size) ;
+		m_pStart = m_pStart->next ;
+		_tcpbufDeleteOne(pkt) ;
+
+		if (!m_pStart)
+		{
+			m_pFinal = 0 ;
+			m_nSize = 0 ;
+		}
+	}
+	return E_OK ;
+}
+
+hzEcode	hzPktQue::Clear	(void)
+{
+	//	Remove all packets in packet queue
+
+	_hzfunc("hzPktQue::Clear") ;
+
+	if (m_pFinal)
+		_tcpbufDeleteAll(m_pStart, m_pFinal) ;
+
+	__sync_sub_and_fetch(&s_nOutQueued, m_nSize) ;
+	m_pStart = m_pFinal = 0 ;
+	m_nSize = 0 ;
+	return E_OK ;
 }
 
 hzEcode	hzIpConnex::SendData	(const hzChain& Hdr, const hzChain& Body)
@@ -925,39 +1859,41 @@ hzEcode	hzIpConnex::SendData	(const hzChain& Hdr, const hzChain& Body)
 	//	Arguments:	1)	Hdr		Header of outgoing response
 	//				2)	Body	Body of outgoing response
 	//
-	//	Returns:	E_OK if hzChain is accepted for the response,
-	//				False otherwise.
+	//	Returns:	E_SENDFAIL	If the connection has been terminated
+	//				E_NODATA	If there is nothing to send
+	//				E_OK		If the chains are accepted for the response
 
 	_hzfunc("hzIpConnex::SendData(1)") ;
 
-	struct epoll_event	epEventNew ;		//	Epoll event for new connections
+	if (!m_nSock)
+	{
+		//	Connection terminated while the response was being prepared. The socket may already belong to another connection.
+		m_Track.Event("SendData: Connection terminated - response discarded") ;
+		return E_SENDFAIL ;
+	}
 
 	if (!Hdr.Size() && !Body.Size())
 	{
-		m_Track.Printf("%s: No data queued for output\n", *_fn) ;
+		m_Track.Event("SendData: No data queued for output") ;
 		return E_NODATA ;
 	}
 
-	if (Hdr.Size() && Body.Size())
+	//	Output sent while an output source is in use must follow it (see hzOutSource)
+	if (m_pSource)
 	{
-		m_Outgoing.Push(Hdr) ;
-		m_Outgoing.Push(Body) ;
+		if (Hdr.Size())		_addSource(new hzOutChain(Hdr)) ;
+		if (Body.Size())	_addSource(new hzOutChain(Body)) ;
+	}
+	else
+	{
+		if (Hdr.Size())		m_Outgoing.Push(Hdr) ;
+		if (Body.Size())	m_Outgoing.Push(Body) ;
 	}
 
 	m_nTotalOut = Hdr.Size() + Body.Size() ;
 
 	m_nsSendBeg = RealtimeNano() ;
-
-	epEventNew.data.fd = m_nSock ;
-	epEventNew.events = EPOLLIN | EPOLLOUT | EPOLLET ;
-
-	if (epoll_ctl(epollSocket, EPOLL_CTL_MOD, m_nSock, &epEventNew) < 0)
-	{
-		m_Track.Printf("%s: EPOLL ERROR: Could not add client connection write handler on sock %d/%d. Error=%s\n", *_fn, m_nSock, m_nPort, strerror(errno)) ;
-		if (close(m_nSock) < 0)
-			m_Track.Printf("%s: NOTE: Could not close socket %d after epoll error. errno=%d\n", *_fn, m_nSock, errno) ;
-	}
-
+	_queued() ;
 	return E_OK ;
 }
 
@@ -973,576 +1909,2674 @@ hzEcode	hzIpConnex::SendData	(const hzChain& Z)
 
 	_hzfunc("hzIpConnex::SendData(2)") ;
 
-	struct epoll_event	epEventNew ;		//	Epoll event for new connections
+	if (!m_nSock)
+	{
+		//	Connection terminated while the response was being prepared. The socket may already belong to another connection.
+		m_Track.Event("SendData: Connection terminated - response discarded") ;
+		return E_SENDFAIL ;
+	}
 
 	m_nTotalOut = Z.Size() ;
 
 	if (!Z.Size())
 	{
-		m_Track.Printf("%s: No data queued for output\n", *_fn) ;
+		m_Track.Event("SendData: No data queued for output") ;
 		return E_NODATA ;
 	}
 
-	if (Z.Size())
+	//	Output sent while an output source is in use must follow it (see hzOutSource)
+	if (m_pSource)
+		_addSource(new hzOutChain(Z)) ;
+	else
 		m_Outgoing.Push(Z) ;
 
 	m_nsSendBeg = RealtimeNano() ;
+	_queued() ;
+	return E_OK ;
+}
 
-	epEventNew.data.fd = m_nSock ;
-	epEventNew.events = EPOLLIN | EPOLLOUT | EPOLLET ;
+hzEcode	hzIpConnex::SendStream	(const hzChain& Hdr, hzOutSource* pSrc)
+{
+	//	Send a response comprising a header, which is queued at once, and a body which is drawn from an output source as the socket drains (see synopsis in
+	//	hzIpServer.h). This is to be used in place of SendData() wherever the body may be large, as only a limited amount of it is held in memory at any one
+	//	time. The connection takes ownership of the source and deletes it when done.
+	//
+	//	Arguments:	1)	Hdr		Header of outgoing response (may be empty)
+	//				2)	pSrc	Source of the body of the response
+	//
+	//	Returns:	E_ARGUMENT	If no source is supplied
+	//				E_SENDFAIL	If the connection has been terminated
+	//				E_READFAIL	If the source failed at the outset
+	//				E_OK		If the response is accepted
+
+	_hzfunc("hzIpConnex::SendStream") ;
 
-	if (epoll_ctl(epollSocket, EPOLL_CTL_MOD, m_nSock, &epEventNew) < 0)
+	if (!pSrc)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No output source supplied") ;
+
+	if (!m_nSock)
 	{
-		m_Track.Printf("%s: EPOLL ERROR: Could not add client connection write handler on sock %d/%d. Error=%s\n", *_fn, m_nSock, m_nPort, strerror(errno)) ;
-		if (close(m_nSock) < 0)
-			m_Track.Printf("%s: NOTE: Could not close socket %d after epoll error. errno=%d\n", *_fn, m_nSock, errno) ;
+		m_Track.Event("SendStream: Connection terminated - response discarded") ;
+		delete pSrc ;
+		return E_SENDFAIL ;
+	}
+
+	if (m_pSource)
+	{
+		if (Hdr.Size())
+			_addSource(new hzOutChain(Hdr)) ;
 	}
+	else if (Hdr.Size())
+		m_Outgoing.Push(Hdr) ;
+
+	_addSource(pSrc) ;
 
+	m_nTotalOut = Hdr.Size() + pSrc->Size() ;
+	m_nsSendBeg = RealtimeNano() ;
+
+	if (_refill() < 0)
+		return E_READFAIL ;
+
+	_queued() ;
 	return E_OK ;
 }
 
-void	hzIpConnex::SendKill	(void)
+void	hzIpConnex::Flush	(void)
 {
-	//	Sent by connection handler in response to illegal message. The status is set to CLIENT_BAD but the socket is still made ready for epoll write events. As soon as the socket
-	//	is available for writes however, the connection is terminated and deleted. The client recieves no response to their request.
+	//	Write out queued output now rather than on return from the handler, so that a response sent in parts reaches the client as each part is produced.
+	//	This is only done in the serving thread of ServeEpollST, as under ServeEpollMT the output is written by another thread and under ServeUring by the
+	//	kernel. Should the socket not take all the output, the rest is written once the socket is writable as usual.
 	//
 	//	Arguments:	None
 	//	Returns:	None
 
-	_hzfunc("hzIpConnex::SendKill") ;
+	hzPacket	tbuf ;	//	Packet buffer (for _xmit)
 
-	struct epoll_event	epEventDead ;		//	Epoll event for depricated connection
+	if (!s_bServing || s_pUring || s_nEpollET || !m_nSock || IsCliBad() || !_isxmit())
+		return ;
 
-	m_Input.Clear() ;
-	m_nExpected = 0 ;
-	if (m_Outgoing.Size())
-		m_Outgoing.Clear() ;
+	if (_xmit(tbuf) < 0)
+		m_bState |= CLIENT_BAD ;
+}
 
-	m_nsSendBeg = RealtimeNano() ;
-	m_bState |= CLIENT_BAD ;
+static	bool	_outPressure	(void)
+{
+	//	Determine if output is under global pressure. This is so from when the total queued output of all connections exceeds the global high watermark, until
+	//	it falls below the global low watermark.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	True	If output is under pressure
+	//				False	Otherwise
 
-	epEventDead.data.fd = m_nSock ;
-	epEventDead.events = EPOLLOUT | EPOLLET ;
+	uint64_t	nTotal ;	//	Total queued output
 
-	if (epoll_ctl(epollSocket, EPOLL_CTL_MOD, m_nSock, &epEventDead) < 0)
-		m_Track.Printf("%s: EPOLL ERROR: Could not add client connection write handler on sock %d/%d. Error=%s\n", *_fn, m_nSock, m_nPort, strerror(errno)) ;
+	nTotal = __atomic_load_n(&s_nOutQueued, __ATOMIC_RELAXED) ;
+
+	if (s_bOutPressure)
+	{
+		if (nTotal < s_nOutGlobalLow)
+			s_bOutPressure = false ;
+	}
 	else
-		m_Track.Printf("%s: BAD CLIENT: Connection killed by app. Sock %d/%d\n", *_fn, m_nSock, m_nPort) ;
+	{
+		if (nTotal >= s_nOutGlobalHigh)
+			s_bOutPressure = true ;
+	}
 
-	//	if (close(m_nSock) < 0)
-	//		m_Track.Printf("%s: NOTE: Could not close socket %d after epoll error. errno=%d\n", *_fn, m_nSock, errno) ;
+	return s_bOutPressure ;
 }
 
-int32_t	hzIpConnex::Recv	(hzPacket& tbuf)
+bool	hzIpConnex::Writable	(void) const
 {
-	//	Category:	Internet Server
+	//	Advise handlers (or other producers of output) if more output may be queued on the connection. This is not so while the queue is at or above the high
+	//	watermark, while an output source is still being drawn on, or while output is under global pressure. The handler may queue output regardless but it is
+	//	then liable to be held in memory for as long as the client takes to read it.
 	//
-	//	Receive a packet of data from the client socket and append it to the input chain.
+	//	Arguments:	None
 	//
-	//	Arguments:	1)	tbuf		The recepticle (buffer) for reading the socket.
+	//	Returns:	True	If output may be queued
+	//				False	If the producer should hold back
+
+	return m_Outgoing.Size() < s_nOutConnHigh && !m_pSource && !_outPressure() ;
+}
+
+void	hzIpConnex::_addSource	(hzOutSource* pSrc)
+{
+	//	Add an output source to the end of the list of sources
 	//
-	//	Returns:	Total number of bytes read
+	//	Arguments:	1)	pSrc	The output source
 	//
-	//	Scope:		This function should not be called the application!
+	//	Returns:	None
 
-	_hzfunc("hzIpConnex::Recv") ;
+	hzOutSource*	pLast ;		//	Last source
 
-	int32_t		nRecv ;		//	Bytes recieved
+	pSrc->m_pNext = 0 ;
 
-	if (!m_Input.Size())
-		m_nsRecvBeg = RealtimeNano() ;
+	if (!m_pSource)
+		{ m_pSource = pSrc ; return ; }
 
-	if (m_pSSL)
-		nRecv = SSL_read(m_pSSL, tbuf.m_data, HZ_MAXPACKET) ;
-	else
-		nRecv = recv(m_nSock, tbuf.m_data, HZ_MAXPACKET, 0) ;
+	for (pLast = m_pSource ; pLast->m_pNext ; pLast = pLast->m_pNext) ;
+	pLast->m_pNext = pSrc ;
+}
 
-	if (!nRecv)
-		m_bState |= CLIENT_TERMINATION ;
+void	hzIpConnex::_dropSources	(void)
+{
+	//	Delete any output sources (connection terminated)
+	//
+	//	Arguments:	None
+	//	Returns:	None
 
-	if (nRecv > 0)
-	{
-		m_nTotalIn += nRecv ;
-		m_bState |= CLIENT_READING ;
-		m_Input.Append(tbuf.m_data, nRecv) ;
-	}
+	hzOutSource*	pNext ;		//	Next source
 
-	m_nsRecvEnd = RealtimeNano() ;
+	_dropWatch() ;
 
-	return nRecv ;
+	for (; m_pSource ; m_pSource = pNext)
+	{
+		pNext = m_pSource->m_pNext ;
+		delete m_pSource ;
+	}
 }
 
-int32_t	hzIpConnex::_xmit	(hzPacket& tbuf)
+int32_t	hzIpConnex::_refill	(void)
 {
-	//	Category:	Internet Server
-	//
-	//	Writes data to a client socket until either it cannot write (buffer full) or it has exhausted the outgoing message. This function is called in turn for
-	//	each connected socket for which there is a write event on the socket (socket becomes available for writing) and output is pending. This approach serves
-	//	to multiplex output so that no socket is left hanging during large downloads.
+	//	Top up the outgoing queue from the output source(s). Nothing is done unless the queue has fallen below the low watermark. It is then topped up to the
+	//	high watermark, or by a single chunk should output be under global pressure. Sources are deleted as they are exhausted.
 	//
-	//	Note: This function is private to the hzIpConnex class so cannot be called directly by an application. It is called only when _isxmit() returns true to
-	//	indicate there is outgoing data to transmit.
+	//	Arguments:	None
 	//
-	//	Arguments:	1)	tbuf	The hzPacket supplied by the caller to contain data to write to the socket.
+	//	A source that has no data to hand names a socket to wait on (see hzOutSource::WaitSock). This is polled for readability so the output is resumed once
+	//	it is readable, and the serving thread is not held up in the mean time.
 	//
-	//	Returns:	-1		If the write operation failed
-	//				>0		If the write operation is delayed (errno either a EAGAIN or WOULDBLOCK)
-	//				0		If the write operation completely wrote the outgoing message
+	//	Returns:	-1	If a source failed (the response cannot be completed and the connection should be terminated)
+	//				1	If the source is waiting on its socket
+	//				0	Otherwise
 
-	_hzfunc("hzIpConnex::_xmit") ;
-
-	hzPacket*	pTB ;		//	Packet buffer block
-	int32_t		nSend ;		//	Bytes to write
-	int32_t		nSent ;		//	Bytes actually written
+	_hzfunc("hzIpConnex::_refill") ;
 
-	/*
-	**	Write out outgoing packets until exhauted or we get an EWOULDBLOCK
-	*/
+	hzOutSource*	pNext ;		//	Next source
+	uint32_t		nTarget ;	//	Queue size to fill to
+	int32_t			nWait ;		//	Socket the source is waiting on
+	hzEcode			rc ;		//	Return from Fill()
 
-	for (; m_Outgoing.Size() ;)
-	{
-		pTB = m_Outgoing.Peek() ;
+	m_bState &= ~CLIENT_WANTSRC ;
 
-		nSend = pTB->m_size - m_nGlitch ;
+	if (!m_pSource || m_Outgoing.Size() >= s_nOutConnLow)
+		return 0 ;
 
-		if (m_pSSL)
-			nSent = SSL_write(m_pSSL, pTB->m_data + m_nGlitch, nSend) ;
-		else
-			nSent = write(m_nSock, pTB->m_data + m_nGlitch, nSend) ;
+	nTarget = _outPressure() ? HZ_OUT_CHUNK : s_nOutConnHigh ;
 
-		if (nSent < 0)
+	while (m_pSource && m_Outgoing.Size() < nTarget)
+	{
+		rc = m_pSource->Fill(m_Outgoing, HZ_OUT_CHUNK) ;
+		if (rc == E_OK)
 		{
-			if (errno == EAGAIN || errno == EWOULDBLOCK)
-			{
-				m_Track.Printf("%s: WBLOCK: Client %d IP %s Event %d Sock %d/%d TOTAL OUT %d (pkt %d posn %d)\n",
-					*_fn, m_nMsgno, *m_ClientIP.Str(), pTB->m_msgId, m_nSock, m_nPort, m_nTotalOut, pTB->m_size, pTB->m_seq) ;
-				return errno ;
-			}
-
-			m_Track.Printf("%s: FAILED: Client %d IP %s Event %d Sock %d/%d TOTAL OUT %d (pkt %d posn %d) Error=%s\n",
-				*_fn, m_nMsgno, *m_ClientIP.Str(), pTB->m_msgId, m_nSock, m_nPort, m_nTotalOut, pTB->m_size, pTB->m_seq, strerror(errno)) ;
-			return -1 ;
-		}
+			nWait = m_pSource->WaitSock() ;
+			if (nWait < 0)
+				continue ;
 
-		if (nSent != nSend)
-		{
-			m_nGlitch += nSent ;
-			m_Track.Printf("%s: GLITCH: Client %d IP %s Event %d Sock %d/%d Sent only %d of %d: TOTAL OUT %d (glitch %d pkt %d posn %d)\n",
-				*_fn, m_nMsgno, *m_ClientIP.Str(), pTB->m_msgId, m_nSock, m_nPort, nSent, nSend, m_nTotalOut, m_nGlitch, pTB->m_size, pTB->m_seq) ;
+			m_bState |= CLIENT_WANTSRC ;
+			_wantSource(nWait) ;
 			return 1 ;
 		}
 
-		m_nGlitch = 0 ;
-
-		if (!pTB->next)
-		{
-			m_nsSendEnd = RealtimeNano() ;
-			m_Track.Printf("%s: COMPLETE 1: Client Event %d Msg %d Sock %d Port %d Bytes (%d/%d) Times: recv %l proc %l xmit %l so total (%l ns)\n",
-				*_fn,
-				m_nMsgno,
-				pTB->m_seq,
-				m_nSock,
-				m_nPort,
-				SizeIn(),
-				TotalOut(),
-				TimeRecv(),
-				TimeProc(),
-				TimeXmit(),
-				TimeRecv() + TimeProc() + TimeXmit()) ;
-			//m_pLog->Out(m_Track) ;
+		//	The source is done with, so its socket (if polled) is no longer of interest
+		_dropWatch() ;
 
-			m_Outgoing.Pull() ;
-			break ;
-		}
+		pNext = m_pSource->m_pNext ;
+		delete m_pSource ;
+		m_pSource = pNext ;
 
-		if (pTB->next->m_msgId != pTB->m_msgId)
+		if (rc != E_NODATA)
 		{
-			m_nsSendEnd = RealtimeNano() ;
-			m_Track.Printf("%s: COMPLETE 2: Client Event %d Msg %d Sock %d Port %d Bytes IN (%d/%d) Times: recv %l proc %l xmit %l so total (%l ns)\n",
-				*_fn,
-				m_nMsgno,
-				pTB->m_seq,
-				m_nSock,
-				m_nPort,
-				SizeIn(),
-				TotalOut(),
-				TimeRecv(),
-				TimeProc(),
-				TimeXmit(),
-				TimeRecv() + TimeProc() + TimeXmit()) ;
+			m_Track.ErrorS("_refill: Output source failed on sock %u/%u (%s) - response incomplete", Err2Txt(rc), m_nSock, m_nPort) ;
+			_dropSources() ;
+			MetricError() ;
+			return -1 ;
 		}
-
-		m_Outgoing.Pull() ;
 	}
 
 	return 0 ;
 }
 
-/*
-**	hzIpServer members
-*/
-
-hzEcode	hzIpServer::AddPortTCP	(	hzTcpCode	(*OnIngress)(hzChain&, hzIpConnex*),
-									hzTcpCode	(*OnConnect)(hzIpConnex*),
-									hzTcpCode	(*OnDisconn)(hzIpConnex*),
-									uint32_t	nTimeout,
-									uint32_t	nPort,
-									uint32_t	nMaxClients,
-									bool		bSecure	)
+void	hzIpConnex::_queued	(void)
 {
-	//	Category:	Internet Server
+	//	Arrange for newly queued output to be written. In the serving threads, output is written on return from the handler (or, under ServeEpollMT, when the
+	//	connection is passed to ServeResponses) so nothing need be done. Output queued by any other thread is written once the socket is reported writable.
 	//
-	//	This function adds a listening socket operating on the assigned port, to a server. The client connections (hzIpConnex instances) call an
-	//	application specific function each time data comes in on the port. Nothing is assumed about the incoming data so it is nessesary that the
-	//	application specific function determines if the data forms a complete message or not and acts accordingly.
+	//	Arguments:	None
+	//	Returns:	None
+
+	if (s_bServing || s_pUring)
+		return ;
+	_wantWrite(true) ;
+}
+
+void	hzIpConnex::_wantWrite	(bool bWant)
+{
+	//	Start or stop polling the socket for writability. Polling is started when the socket will not take all the outgoing data and stopped once it has, so
+	//	that writability is only reported while it is of use.
 	//
-	//	Arguments:	1)	OnIngress		Application Specific 'Do Something' function to be called each time data has come in from a connected client.
-	//				2)	OnConnect		Application Specific 'Server Hello' function - only required if the protocol used dictates that the server
-	//									speaks first.
-	//				3)	nTimeout		Timeout for connections to the port in seconds
-	//				4)	nPort			Listening port number
-	//				5)	nMaxClients		Max number of connections on the port (before server blocks listening socket)
-	//				6)	bSecure			Flag to indicate SSL
+	//	Arguments:	1)	bWant	True to poll for writability, false to stop
 	//
-	//	Returns:	E_ARGUMENT	If the 'OnIngress' function pointer is null.
-	//				E_RANGE		If the port number is out of range
-	//				E_INITDUP	If there is already a listening socket on the supplied port number
-	//				E_MEMORY	If the is insufficient memory to allocate the hzTcpListen for the port
-	//				E_INITFIAL	If the hzTcpListen could not be initialized
-	//				E_OK		If the operation was successful.
-
-	_hzfunc("hzIpServer::AddPort") ;
-
-	if (!OnIngress)
-		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Each listening port must have a 'OnIngress' handler") ;
+	//	Returns:	None
 
-	if (nPort < 1 || nPort > 65535)
-		return hzerr(_fn, HZ_ERROR, E_RANGE, "Port %d out of range", nPort) ;
+	_hzfunc("hzIpConnex::_wantWrite") ;
 
-	//	Check that we are not already using port
+	struct epoll_event	epEv ;		//	Epoll event
 
-	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+	if (s_pUring || !m_nSock)
+		return ;
+	if (bWant == (m_bState & CLIENT_WANTOUT ? true : false))
+		return ;
 
-	hzTcpListen*	pLS ;				//	Listening socket
-	uint32_t		opflags ;			//	Operational flags
+	epEv.data.u64 = EventTag() ;
+	epEv.events = EPOLLIN | s_nEpollET | (bWant ? EPOLLOUT : 0) ;
 
-	for (I = m_LS ; I.Valid() ; I++)
+	if (epoll_ctl(epollSocket, EPOLL_CTL_MOD, m_nSock, &epEv) < 0)
 	{
-		pLS = I.Element() ;
-
-		if (pLS->GetPort() == nPort)
-			return hzerr(_fn, HZ_ERROR, E_INITDUP, "Socket already initialized and listening on port %d\n", pLS->GetPort()) ;
+		m_Track.ErrorS("_wantWrite: EPOLL ERROR: Could not modify events on sock %u/%u. Error=%s", strerror(errno), m_nSock, m_nPort) ;
+		return ;
 	}
 
-	if (!(pLS = new hzTcpListen(m_pLog)))
-		return hzerr(_fn, HZ_ERROR, E_MEMORY, "SERIOUS ERROR - Could not allocate an LS for server") ;
-
-	opflags = HZ_LISTEN_TCP ;
-	if (bSecure)
-		opflags |= HZ_LISTEN_SECURE ;
-
-	if (pLS->Init(OnIngress, OnConnect, OnDisconn, 0, nTimeout, nPort, nMaxClients, opflags) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not initialize an LS for server") ;
-
-	if (m_LS.Add(pLS) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not insert an LS for server") ;
-
-	return E_OK ;
+	if (bWant)
+		m_bState |= CLIENT_WANTOUT ;
+	else
+		m_bState &= ~CLIENT_WANTOUT ;
 }
 
-//hzTcpCode	HandleHttpMsg	(hzChain& Input, hzIpConnex* pCx) ;
-
-hzEcode	hzIpServer::AddPortHTTP	(	hzTcpCode	(*OnHttpReq)(hzHttpEvent*),
-									uint32_t	nTimeout,
-									uint32_t	nPort,
-									uint32_t	nMaxClients,
-									bool		bSecure	)
+void	hzIpConnex::_wantSource	(int32_t nSock)
 {
-	//	Category:	Internet Server
-	//
-	//	Purpose:	Add a listening port, customized for HTTP, to the singleton hzIpServer instance. This will allow the application
-	//				to act as a web server.
+	//	Poll the socket of the output source for readability, so the output of the connection is resumed once the source has more data. The registration is
+	//	one-shot and tagged with HZ_TAG_SOURCE so the serving loop can tell it from events on the connection itself. Under ServeUring the poll is submitted by
+	//	the serving loop (see hzIpServer::_uringFlush) so the socket is only noted here.
 	//
-	//	Arguments:	1)	OnHttpReq		Application Specific 'Do Something' function called each time a complete HTTP request has come from a connected client. 
-	//				2)	nTimeout		Timeout in seconds.
-	//				3)	nPort			Port number
-	//				4)	nMaxClients		Max number of connections on the port (before server blocks listening socket)
-	//				5)	bSecure			Flag to indicate SSL
+	//	Arguments:	1)	nSock	The socket the source is waiting on
 	//
-	//	Returns:	E_ARGUMENT	If the 'HandleHttpEvent' function pointer is null.
-	//				E_RANGE		If the port number is out of range
-	//				E_INITDUP	If there is already a listening socket on the supplied port number
-	//				E_MEMORY	If the is insufficient memory to allocate the hzTcpListen for the port
-	//				E_INITFIAL	If the hzTcpListen could not be initialized
-	//				E_OK		If the operation was successful.
+	//	Returns:	None
 
-	_hzfunc("hzIpServer::AddPortHTTP") ;
+	_hzfunc("hzIpConnex::_wantSource") ;
 
-	if (!OnHttpReq)
-		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Each listening HTTP port must have a 'HandleHttpEvent' handler") ;
+	struct epoll_event	epEv ;		//	Epoll event
+	int32_t				nOp ;		//	Epoll operation
 
-	if (nPort < 1 || nPort > 65535)
-		return hzerr(_fn, HZ_ERROR, E_RANGE, "Port %d out of range", nPort) ;
+	if (m_nSrcSock && m_nSrcSock != (uint32_t) nSock)
+		_dropWatch() ;
 
-	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+	if (s_pUring)
+		{ m_nSrcSock = nSock ; return ; }
 
-	hzTcpListen*	pLS ;				//	Listening socket
-	uint32_t		opflags ;			//	Operational flags
+	nOp = m_nSrcSock ? EPOLL_CTL_MOD : EPOLL_CTL_ADD ;
+	epEv.data.u64 = EventTag() | HZ_TAG_SOURCE ;
+	epEv.events = EPOLLIN | EPOLLONESHOT ;
 
-	//	Check that we are not already using port
-	for (I = m_LS ; I.Valid() ; I++)
+	if (epoll_ctl(epollSocket, nOp, nSock, &epEv) < 0)
 	{
-		pLS = I.Element() ;
-
-		if (pLS->GetPort() == nPort)
-			return hzerr(_fn, HZ_ERROR, E_INITDUP, "Socket already initialized and listening on port %d\n", pLS->GetPort()) ;
+		m_Track.ErrorS("_wantSource: EPOLL ERROR: Could not poll output source on sock %u/%u. Error=%s", strerror(errno), m_nSock, m_nPort) ;
+		return ;
 	}
 
-	if (!(pLS = new hzTcpListen(m_pLog)))
-		return hzerr(_fn, HZ_ERROR, E_MEMORY, "SERIOUS ERROR - Could not allocate an LS for server") ;
+	m_nSrcSock = nSock ;
+}
 
-	opflags = HZ_LISTEN_HTTP ;
-	if (bSecure)
-		opflags |= HZ_LISTEN_SECURE ;
+void	hzIpConnex::_dropWatch	(void)
+{
+	//	Stop polling the socket of the output source. This must be done before the source is deleted, as the source may close the socket or pass it on for
+	//	other use. Under ServeUring any poll still pending is cancelled by the serving loop when the connection is closed.
+	//
+	//	Arguments:	None
+	//	Returns:	None
 
-	if (pLS->Init(HandleHttpMsg, 0, 0, 0, nTimeout, nPort, nMaxClients, opflags) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not initialize an LS for server") ;
+	_hzfunc("hzIpConnex::_dropWatch") ;
 
-	pLS->m_appFn = (void*) OnHttpReq ;
+	struct epoll_event	epEv ;		//	Epoll event (not used by EPOLL_CTL_DEL)
 
-	if (m_LS.Add(pLS) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not insert an LS for server") ;
+	if (!m_nSrcSock)
+		return ;
 
-	return E_OK ;
+	if (!s_pUring && epoll_ctl(epollSocket, EPOLL_CTL_DEL, m_nSrcSock, &epEv) < 0)
+		m_Track.ErrorS("_dropWatch: EPOLL ERROR: Could not remove output source sock %u from sock %u. Error=%s", strerror(errno), m_nSrcSock, m_nSock) ;
+
+	m_nSrcSock = 0 ;
+	m_bState &= ~CLIENT_WANTSRC ;
 }
 
-hzEcode	hzIpServer::AddPortSess	(void* (*HandleSession)(void*), uint32_t nTimeout, uint32_t	nPort, uint32_t	nMaxClients, bool bSecure)
+void	hzIpConnex::SendKill	(void)
 {
-	//	Category:	Internet Server
-	//
-	//	This provides a listening socket for connections that are to be handled in a separate thread.
-	//
-	//	Arguments:	1)	HandleSession	Application Specific thread habdler function called each time a complete HTTP request has come from a connected client. 
-	//				2)	nTimeout		Timeout in seconds.
-	//				3)	nPort			Port number
-	//				4)	nMaxClients		Max number of connections on the port (before server blocks listening socket)
-	//				5)	bSecure			Flag to indicate SSL
+	//	Sent by connection handler in response to illegal message. The status is set to CLIENT_BAD but the socket is still made ready for epoll write events. As soon as the socket
+	//	is available for writes however, the connection is terminated and deleted. The client recieves no response to their request.
 	//
-	//	Returns:	E_ARGUMENT	If an event handler has not been supplied
-	//				E_RANGE		If the port number does not fall within range 1-65536
-	//				E_INITDUP	If the port is in use (another AddPort call)
-	//				E_INITFAIL	If the listening socket cannot be added or initialized
-	//				E_OK		If the listening port is assigned
-
-	_hzfunc("hzIpServer::AddPortSess") ;
+	//	Arguments:	None
+	//	Returns:	None
 
-	if (!HandleSession)
-		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Each listening HTTP port must have a 'HandleHttpEvent' handler") ;
+	_hzfunc("hzIpConnex::SendKill") ;
 
-	if (nPort < 1 || nPort > 65535)
-		return hzerr(_fn, HZ_ERROR, E_RANGE, "Port %d out of range", nPort) ;
+	struct epoll_event	epEventDead ;		//	Epoll event for depricated connection
 
-	//	Check that we are not already using port
+	m_Input.Clear() ;
+	m_nExpected = 0 ;
+	if (m_Outgoing.Size())
+		m_Outgoing.Clear() ;
+	_dropSources() ;
 
-	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+	m_nsSendBeg = RealtimeNano() ;
+	m_bState |= CLIENT_BAD ;
 
-	hzTcpListen*	pLS ;				//	Listening socket
-	uint32_t		opflags ;			//	Operational flags
+	if (s_pUring)
+		{ m_Track.Error("SendKill: BAD CLIENT: Connection killed by app. Sock %u/%u", m_nSock, m_nPort) ; return ; }
 
-	for (I = m_LS ; I.Valid() ; I++)
-	{
-		pLS = I.Element() ;
+	epEventDead.data.u64 = EventTag() ;
+	epEventDead.events = EPOLLOUT | EPOLLET ;
 
-		if (pLS->GetPort() == nPort)
-			return hzerr(_fn, HZ_ERROR, E_INITDUP, "Socket already initialized and listening on port %d\n", pLS->GetPort()) ;
-	}
+	if (epoll_ctl(epollSocket, EPOLL_CTL_MOD, m_nSock, &epEventDead) < 0)
+		m_Track.ErrorS("SendKill: EPOLL ERROR: Could not add client connection write handler on sock %u/%u. Error=%s", strerror(errno), m_nSock, m_nPort) ;
+	else
+		m_Track.Error("SendKill: BAD CLIENT: Connection killed by app. Sock %u/%u", m_nSock, m_nPort) ;
 
-	if (!(pLS = new hzTcpListen(m_pLog)))
-		hzexit(_fn, 0, E_MEMORY, "SERIOUS ERROR - Could not allocate an LS for server") ;
+	//	if (close(m_nSock) < 0)
+	//		m_Track.Error("SendKill: NOTE: Could not close socket %u after epoll error. errno=%d", m_nSock, errno) ;
+}
 
-	opflags = HZ_LISTEN_SESSION ;
-	if (bSecure)
-		opflags |= HZ_LISTEN_SECURE ;
+int32_t	hzIpConnex::Recv	(hzPacket& tbuf)
+{
+	//	Category:	Internet Server
+	//
+	//	Receive a packet of data from the client socket and append it to the input chain.
+	//
+	//	Arguments:	1)	tbuf		The recepticle (buffer) for reading the socket.
+	//
+	//	Returns:	Total number of bytes read
+	//
+	//	Scope:		This function should not be called the application!
 
-	if (pLS->Init(0, 0, 0, HandleSession, nTimeout, nPort, nMaxClients, opflags) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not initialize an LS for server") ;
+	_hzfunc("hzIpConnex::Recv") ;
 
-	pLS->m_appFn = (void*) HandleSession ;
+	int32_t		nRecv ;		//	Bytes recieved
 
-	if (m_LS.Add(pLS) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not insert an LS for server") ;
+	if (m_pSSL)
+		nRecv = SSL_read(m_pSSL, tbuf.m_data, HZ_MAXPACKET) ;
+	else
+		nRecv = recv(m_nSock, tbuf.m_data, HZ_MAXPACKET, 0) ;
 
-	return E_OK ;
+	_ingest(tbuf.m_data, nRecv) ;
+	return nRecv ;
 }
 
-hzEcode	hzIpServer::AddPortUDP	(	hzTcpCode	(*OnIngress)(hzChain&, hzIpConnex*),
-									hzTcpCode	(*OnConnect)(hzIpConnex*),
-									hzTcpCode	(*OnDisconn)(hzIpConnex*),
-									uint32_t	nTimeout,
-									uint32_t	nPort,
-									uint32_t	nMaxClients,
-									bool		bSecure	)
+void	hzIpConnex::_ingest	(const char* pBuf, int32_t nRecv)
 {
 	//	Category:	Internet Server
 	//
-	//	This function adds a listening socket operating on the assigned port, to a server. The client connections (hzIpConnex instances) call an
-	//	application specific function each time data comes in on the port. Nothing is assumed about the incoming data so it is nessesary that the
-	//	application specific function determines if the data forms a complete message or not and acts accordingly.
+	//	Account for the outcome of a read from the client socket, appending any data to the input chain. This is called by Recv() and by ServeUring() where the
+	//	read is performed by the kernel into a provided buffer.
 	//
-	//	Arguments:	1)	OnIngress		Application Specific 'Do Something' function to be called each time data has come in from a connected client.
-	//				2)	OnConnect		Application Specific 'Server Hello' function - only required if the protocol used dictates that the server
-	//									speaks first.
-	//				3)	nTimeout		Timeout for connections to the port in seconds
-	//				4)	nPort			Listening port number
-	//				5)	nMaxClients		Max number of connections on the port (before server blocks listening socket)
-	//				6)	bSecure			Flag to indicate SSL
+	//	Arguments:	1)	pBuf	The data read
+	//				2)	nRecv	The number of bytes read (0 if the client has closed its side of the connection, -1 if the read failed)
 	//
-	//	Returns:	E_ARGUMENT	If the 'OnIngress' function pointer is null.
-	//				E_RANGE		If the port number is out of range
-	//				E_INITDUP	If there is already a listening socket on the supplied port number
-	//				E_MEMORY	If the is insufficient memory to allocate the hzTcpListen for the port
-	//				E_INITFIAL	If the hzTcpListen could not be initialized
-	//				E_OK		If the operation was successful.
+	//	Returns:	None
 
-	_hzfunc("hzIpServer::AddUdpPort") ;
+	hzPortStats*	pStats ;	//	Metrics block for the listening port
 
-	if (!OnIngress)
-		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Each listening port must have a 'OnIngress' handler") ;
+	if (!m_Input.Size())
+		m_nsRecvBeg = RealtimeNano() ;
 
-	if (nPort < 1 || nPort > 65535)
-		return hzerr(_fn, HZ_ERROR, E_RANGE, "Port %d out of range", nPort) ;
+	if (!nRecv)
+		m_bState |= CLIENT_TERMINATION ;
 
-	//	Check that we are not already using port
+	m_nsRecvEnd = RealtimeNano() ;
 
-	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+	if (nRecv > 0)
+	{
+		m_nTotalIn += nRecv ;
+		m_bState |= CLIENT_READING ;
 
-	hzTcpListen*	pLS ;				//	Listening socket
-	uint32_t		opflags ;			//	Operational flags
+		if (_hzGlobal_MT)
+			m_lockIn.Lock() ;
+		m_Input.Append(pBuf, nRecv) ;
+		if (_hzGlobal_MT)
+			m_lockIn.Unlock() ;
+		m_ConnExpires = m_nsRecvEnd + m_nsTTL ;
 
-	for (I = m_LS ; I.Valid() ; I++)
-	{
-		pLS = I.Element() ;
+		pStats = hzMetrics::Stats(m_nLsPort) ;
+		if (pStats)
+			pStats->BytesIn(nRecv) ;
+	}
+}
 
-		if (pLS->GetPort() == nPort)
-			return hzerr(_fn, HZ_ERROR, E_INITDUP, "Socket already initialized and listening on port %d\n", pLS->GetPort()) ;
+void	hzIpConnex::_dropEvent	(void)
+{
+	//	Return the HTTP event of the connection (if any) to the pool. Anything of a request part way through being received, such as uploads in temporary files,
+	//	is discarded.
+	//
+	//	Arguments:	None
+	//	Returns:	None
+
+	if (m_pEventHdl)
+	{
+		hzHttpEvent::Release((hzHttpEvent*) m_pEventHdl) ;
+		m_pEventHdl = 0 ;
 	}
+}
 
-	if (!(pLS = new hzTcpListen(m_pLog)))
-		return hzerr(_fn, HZ_ERROR, E_MEMORY, "SERIOUS ERROR - Could not allocate an LS for server") ;
+void	hzIpConnex::DropInput	(uint32_t nBytes)
+{
+	//	Category:	Internet Server
+	//
+	//	Remove bytes from the start of the input chain once they have been processed, leaving whatever follows (such as pipelined requests). Under ServeEpollMT
+	//	the epoll thread may append to the input while a request thread is processing it, so this is done under the input lock lest the appended data be lost.
+	//	Where the caller already holds the input lock (see LockInput), as HandleHttpMsg does while a request is framed, the lock is not taken again.
+	//
+	//	Arguments:	1)	nBytes	Number of bytes to remove (all input if this is the input size or more)
+	//
+	//	Returns:	None
 
-	opflags = HZ_LISTEN_UDP ;
-	if (bSecure)
-		opflags |= HZ_LISTEN_SECURE ;
+	_hzfunc("hzIpConnex::DropInput") ;
 
-	if (pLS->Init(OnIngress, OnConnect, OnDisconn, 0, nTimeout, nPort, nMaxClients, opflags) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not initialize an LS for server") ;
+	hzChain		Rest ;		//	Input beyond the bytes removed
 
-	if (m_LS.Add(pLS) != E_OK)
-		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not insert an LS for server") ;
+	if (_hzGlobal_MT && !m_bInHeld)
+		m_lockIn.Lock() ;
 
-	return E_OK ;
+	if (nBytes < m_Input.Size())
+		Rest.AppendSub(m_Input, nBytes, m_Input.Size() - nBytes) ;
+	m_Input = Rest ;
+
+	if (_hzGlobal_MT && !m_bInHeld)
+		m_lockIn.Unlock() ;
 }
 
-hzEcode	hzIpServer::Activate	(void)
+bool	hzIpConnex::_admit	(void)
 {
-	//	Purpose:	Activates all listening sockets added to the server by AddPort(). This must only be called once.
+	//	Category:	Internet Server
+	//
+	//	Apply the message rate limit of the listening socket to the message now complete in the input chain. This is called by the serving loops (and request
+	//	threads) immediately before the message is passed to the OnIngress function. Where the message is refused, the caller terminates the connection.
 	//
 	//	Arguments:	None
 	//
-	//	Returns:	E_INITDUP	If this has already been called
-	//				E_INITFAIL	If one or more listening sockets fail to activate
-	//				E_OK		If the operation was successful.
+	//	Returns:	True	If the message may be processed
+	//				False	If the message is refused
 
-	_hzfunc("hzIpServer::Activate") ;
+	_hzfunc("hzIpConnex::_admit") ;
 
-	if (m_bActive)
-		return hzerr(_fn, HZ_ERROR, E_INITDUP, "All ports already active") ;
+	if (!m_pListen || m_pListen->AdmitMsg(m_ClientIP))
+		return true ;
 
-	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+	m_Track.Error("_admit: RATE LIMIT: Message refused on sock %u/%u", m_nSock, m_nPort) ;
+	MetricError() ;
+	return false ;
+}
+
+int32_t	hzIpConnex::_xmit	(hzPacket& tbuf)
+{
+	//	Category:	Internet Server
+	//
+	//	Writes data to a client socket until either it cannot write (buffer full) or it has exhausted the outgoing message. This function is called in turn for
+	//	each connected socket for which there is a write event on the socket (socket becomes available for writing) and output is pending. This approach serves
+	//	to multiplex output so that no socket is left hanging during large downloads.
+	//
+	//	Note: This function is private to the hzIpConnex class so cannot be called directly by an application. It is called only when _isxmit() returns true to
+	//	indicate there is outgoing data to transmit.
+	//
+	//	Arguments:	1)	tbuf	The hzPacket supplied by the caller to contain data to write to the socket.
+	//
+	//	Where the response is drawn from an output source (see SendStream), the outgoing queue is topped up from the source as it drains. Should the socket not
+	//	take all the data, it is polled for writability and this function is called again once it is writable. Should the source have nothing to hand, its own
+	//	socket is polled instead (see _refill).
+	//
+	//	Returns:	-1		If the write operation failed
+	//				>0		If the write operation is delayed (errno either a EAGAIN or WOULDBLOCK, or the output source is waiting)
+	//				0		If the write operation completely wrote the outgoing message
+
+	_hzfunc("hzIpConnex::_xmit") ;
+
+	hzPacket*	pTB ;		//	Packet buffer block
+	int32_t		nSend ;		//	Bytes to write
+	int32_t		nSent ;		//	Bytes actually written
+	int32_t		nFill ;		//	Return from _refill()
+
+	/*
+	**	Write out outgoing packets until exhauted or we get an EWOULDBLOCK
+	*/
+
+	for (;;)
+	{
+		nFill = _refill() ;
+		if (nFill < 0)
+			return -1 ;
+		if (!m_Outgoing.Size())
+		{
+			if (nFill > 0)
+			{
+				//	Nothing more can be written until the output source has more
+				if (m_bState & CLIENT_WANTOUT)
+					_wantWrite(false) ;
+				return 1 ;
+			}
+			break ;
+		}
+
+		pTB = m_Outgoing.Peek() ;
+
+		nSend = pTB->m_size - m_nGlitch ;
+
+		if (m_pSSL && !(m_bState & CLIENT_KTLS))
+			nSent = SSL_write(m_pSSL, pTB->m_data + m_nGlitch, nSend) ;
+		else
+			nSent = write(m_nSock, pTB->m_data + m_nGlitch, nSend) ;
+
+		if (nSent < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				m_Track.Event("_xmit: WBLOCK: Event %u TOTAL OUT %u (pkt %u posn %u)", pTB->m_msgId, m_nTotalOut, pTB->m_size, pTB->m_seq) ;
+				_wantWrite(true) ;
+				return errno ;
+			}
+
+			m_Track.ErrorS("_xmit: FAILED: Event %u TOTAL OUT %u (pkt %u) Error=%s", strerror(errno), pTB->m_msgId, m_nTotalOut, pTB->m_size) ;
+			MetricError() ;
+			return -1 ;
+		}
+
+		//	Progress on the write renews the time to live, so only a stalled write expires
+		Oxygen() ;
+
+		if (nSent != nSend)
+		{
+			m_nGlitch += nSent ;
+			m_Track.Event("_xmit: GLITCH: Event %u Sent only %d of %d: TOTAL OUT %u", pTB->m_msgId, nSent, nSend, m_nTotalOut) ;
+			_wantWrite(true) ;
+			return 1 ;
+		}
+
+		m_nGlitch = 0 ;
+
+		if (!pTB->next && !m_pSource)
+		{
+			m_nsSendEnd = RealtimeNano() ;
+			m_Track.Event("_xmit: COMPLETE 1: Event %u bytes (%u/%u) in %u ns", m_nMsgno, SizeIn(), TotalOut(), TimeRecv() + TimeProc() + TimeXmit()) ;
+			_metricsDone() ;
+
+			m_Outgoing.Pull() ;
+			break ;
+		}
+
+		if (pTB->next && pTB->next->m_msgId != pTB->m_msgId)
+		{
+			m_nsSendEnd = RealtimeNano() ;
+			m_Track.Event("_xmit: COMPLETE 2: Event %u bytes (%u/%u) in %u ns", m_nMsgno, SizeIn(), TotalOut(), TimeRecv() + TimeProc() + TimeXmit()) ;
+		}
+
+		m_Outgoing.Pull() ;
+	}
+
+	if (m_bState & CLIENT_WANTOUT)
+		_wantWrite(false) ;
+	return 0 ;
+}
+
+uint32_t	hzIpConnex::_xmitPrep	(struct iovec* pIov, uint32_t nMax)
+{
+	//	Category:	Internet Server
+	//
+	//	Describe the outgoing data, from the current position onwards, as an array of iovec structures for a vectored write. One iovec is used per packet. The
+	//	packets are not removed from the outgoing queue. This is done by _xmitDone() once the kernel reports how much was written.
+	//
+	//	Arguments:	1)	pIov	The iovec array to populate
+	//				2)	nMax	The number of entries in the array
+	//
+	//	Returns:	Number of iovec structures populated (0 if there is no outgoing data)
+
+	hzPacket*	pTB ;		//	Packet buffer block
+	uint32_t	nIov ;		//	Iovec count
+
+	for (nIov = 0, pTB = m_Outgoing.Peek() ; pTB && nIov < nMax ; pTB = pTB->next, nIov++)
+	{
+		pIov[nIov].iov_base = pTB->m_data ;
+		pIov[nIov].iov_len = pTB->m_size ;
+	}
+
+	if (nIov)
+	{
+		pIov[0].iov_base = m_Outgoing.Peek()->m_data + m_nGlitch ;
+		pIov[0].iov_len -= m_nGlitch ;
+	}
+
+	return nIov ;
+}
+
+void	hzIpConnex::_xmitDone	(uint32_t nSent)
+{
+	//	Category:	Internet Server
+	//
+	//	Remove the packets written by a vectored write from the outgoing queue. A packet that was only partly written remains at the head of the queue with the
+	//	extent written noted, as with _xmit(). The queue is then topped up from the output source if there is one. Should the source fail the connection is
+	//	marked for closure as the response cannot be completed.
+	//
+	//	Arguments:	1)	nSent	Number of bytes written
+	//
+	//	Returns:	None
+
+	_hzfunc("hzIpConnex::_xmitDone") ;
+
+	hzPacket*	pTB ;		//	Packet buffer block
+	uint32_t	nSend ;		//	Bytes remaining in packet
+
+	if (nSent)
+		Oxygen() ;
+
+	for (; nSent && (pTB = m_Outgoing.Peek()) ;)
+	{
+		nSend = pTB->m_size - m_nGlitch ;
+
+		if (nSent < nSend)
+			{ m_nGlitch += nSent ; break ; }
+
+		nSent -= nSend ;
+		m_nGlitch = 0 ;
+		m_Outgoing.Pull() ;
+	}
+
+	if (_refill() < 0)
+		m_bState |= CLIENT_CLOSING ;
+
+	if (!m_Outgoing.Size() && !m_pSource)
+	{
+		m_nsSendEnd = RealtimeNano() ;
+		m_Track.Event("_xmitDone: COMPLETE: Event %u bytes (%u/%u) in %u ns", m_nMsgno, SizeIn(), TotalOut(), TimeRecv() + TimeProc() + TimeXmit()) ;
+		_metricsDone() ;
+	}
+}
+
+void	hzIpConnex::MetricError	(void)
+{
+	//	Category:	Internet Server
+	//
+	//	Count a failed connection (read or write error, failed TLS handshake, invalid request) against the listening port, if metrics are active
+	//
+	//	Arguments:	None
+	//	Returns:	None
+
+	hzPortStats*	pStats ;	//	Metrics block for the listening port
+
+	pStats = hzMetrics::Stats(m_nLsPort) ;
+	if (pStats)
+		pStats->Error() ;
+}
+
+void	hzIpConnex::MetricExpired	(void)
+{
+	//	Category:	Internet Server
+	//
+	//	Count an expired connection against the listening port, if metrics are active
+	//
+	//	Arguments:	None
+	//	Returns:	None
+
+	hzPortStats*	pStats ;	//	Metrics block for the listening port
+
+	pStats = hzMetrics::Stats(m_nLsPort) ;
+	if (pStats)
+		pStats->Expired() ;
+}
+
+void	hzIpConnex::_metricsDone	(void)
+{
+	//	Category:	Internet Server
+	//
+	//	Record the completion of a response, if metrics are active. This is called when the outgoing queue has been written out in full. The phase times are
+	//	those of TimeAcpt(), TimeRecv(), TimeProc() and TimeXmit(). The accept phase is only recorded for the first response on the connection and the recv and
+	//	proc phases are only recorded if the response was to a request (and not say, a server hello).
+	//
+	//	Arguments:	None
+	//	Returns:	None
+
+	hzPortStats*	pStats ;	//	Metrics block for the listening port
+
+	pStats = hzMetrics::Stats(m_nLsPort) ;
+	if (!pStats)
+		return ;
+
+	pStats->Request() ;
+	pStats->BytesOut(m_nTotalOut) ;
+
+	if (m_nTotalIn && m_nsRecvBeg > m_nsAccepted)
+	{
+		if (!m_nResponses)
+			pStats->m_Phase[HZ_PHASE_ACPT].Record(TimeAcpt()) ;
+		if (m_nsRecvEnd >= m_nsRecvBeg)
+			pStats->m_Phase[HZ_PHASE_RECV].Record(TimeRecv()) ;
+		if (m_nsSendBeg >= m_nsRecvEnd)
+			pStats->m_Phase[HZ_PHASE_PROC].Record(TimeProc()) ;
+	}
+
+	if (m_nsSendEnd >= m_nsSendBeg)
+		pStats->m_Phase[HZ_PHASE_XMIT].Record(TimeXmit()) ;
+	m_nResponses++ ;
+}
+
+/*
+**	hzIpServer members
+*/
+
+void	hzIpServer::_tlsDone	(hzIpConnex* pCC)
+{
+	//	Count a completed TLS handshake, noting whether the session was resumed and whether kernel TLS is in use
+	//
+	//	Arguments:	1)	pCC		The connection
+	//
+	//	Returns:	None
+
+	__atomic_add_fetch(&m_nTlsDone, 1, __ATOMIC_RELAXED) ;
+	if (pCC->IsResumed())
+		__atomic_add_fetch(&m_nTlsResumed, 1, __ATOMIC_RELAXED) ;
+	if (pCC->IsKtls())
+		__atomic_add_fetch(&m_nTlsKtls, 1, __ATOMIC_RELAXED) ;
+}
+
+hzEcode	hzIpServer::AddPortTCP	(	hzTcpCode	(*OnIngress)(hzChain&, hzIpConnex*),
+									hzTcpCode	(*OnConnect)(hzIpConnex*),
+									hzTcpCode	(*OnDisconn)(hzIpConnex*),
+									uint32_t	nTimeout,
+									uint32_t	nPort,
+									uint32_t	nMaxClients,
+									bool		bSecure	)
+{
+	//	Category:	Internet Server
+	//
+	//	This function adds a listening socket operating on the assigned port, to a server. The client connections (hzIpConnex instances) call an
+	//	application specific function each time data comes in on the port. Nothing is assumed about the incoming data so it is nessesary that the
+	//	application specific function determines if the data forms a complete message or not and acts accordingly.
+	//
+	//	Arguments:	1)	OnIngress		Application Specific 'Do Something' function to be called each time data has come in from a connected client.
+	//				2)	OnConnect		Application Specific 'Server Hello' function - only required if the protocol used dictates that the server
+	//									speaks first.
+	//				3)	nTimeout		Timeout for connections to the port in seconds
+	//				4)	nPort			Listening port number
+	//				5)	nMaxClients		Max number of connections on the port (before server blocks listening socket)
+	//				6)	bSecure			Flag to indicate SSL
+	//
+	//	Returns:	E_ARGUMENT	If the 'OnIngress' function pointer is null.
+	//				E_RANGE		If the port number is out of range
+	//				E_INITDUP	If there is already a listening socket on the supplied port number
+	//				E_MEMORY	If the is insufficient memory to allocate the hzTcpListen for the port
+	//				E_INITFIAL	If the hzTcpListen could not be initialized
+	//				E_OK		If the operation was successful.
+
+	_hzfunc("hzIpServer::AddPort") ;
+
+	if (!OnIngress)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Each listening port must have a 'OnIngress' handler") ;
+
+	if (nPort < 1 || nPort > 65535)
+		return hzerr(_fn, HZ_ERROR, E_RANGE, "Port %d out of range", nPort) ;
+
+	//	Check that we are not already using port
+
+	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
 
 	hzTcpListen*	pLS ;				//	Listening socket
+	uint32_t		opflags ;			//	Operational flags
 
 	for (I = m_LS ; I.Valid() ; I++)
 	{
 		pLS = I.Element() ;
 
-		//	Activate port
-		if (pLS->Activate() != E_OK)
-			return hzerr(_fn, HZ_ERROR, E_INITFAIL, "Could not activate listening port (sock %d)", pLS->GetPort()) ;
+		if (pLS->GetPort() == nPort)
+			return hzerr(_fn, HZ_ERROR, E_INITDUP, "Socket already initialized and listening on port %d\n", pLS->GetPort()) ;
 	}
 
-	m_bActive = true ;
+	if (!(pLS = new hzTcpListen(m_pLog)))
+		return hzerr(_fn, HZ_ERROR, E_MEMORY, "SERIOUS ERROR - Could not allocate an LS for server") ;
+
+	opflags = HZ_LISTEN_TCP ;
+	if (bSecure)
+		opflags |= HZ_LISTEN_SECURE ;
+
+	if (pLS->Init(OnIngress, OnConnect, OnDisconn, 0, nTimeout, nPort, nMaxClients, opflags) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not initialize an LS for server") ;
+
+	if (m_LS.Add(pLS) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not insert an LS for server") ;
+
 	return E_OK ;
 }
 
-/*
-**	Slow loris defence
-*/
+//hzTcpCode	HandleHttpMsg	(hzChain& Input, hzIpConnex* pCx) ;
 
-struct	_loris
+hzEcode	hzIpServer::AddPortHTTP	(	hzTcpCode	(*OnHttpReq)(hzHttpEvent*),
+									uint32_t	nTimeout,
+									uint32_t	nPort,
+									uint32_t	nMaxClients,
+									bool		bSecure	)
 {
-	//	Recording of IP address of client and port client used to connect
-
-	hzIpaddr	ip ;		//	IP address of rogue client
-	uint32_t	port ;		//	Port rogue client connected on
+	//	Category:	Internet Server
+	//
+	//	Purpose:	Add a listening port, customized for HTTP, to the singleton hzIpServer instance. This will allow the application
+	//				to act as a web server.
+	//
+	//	Arguments:	1)	OnHttpReq		Application Specific 'Do Something' function called each time a complete HTTP request has come from a connected client. 
+	//				2)	nTimeout		Timeout in seconds.
+	//				3)	nPort			Port number
+	//				4)	nMaxClients		Max number of connections on the port (before server blocks listening socket)
+	//				5)	bSecure			Flag to indicate SSL
+	//
+	//	Returns:	E_ARGUMENT	If the 'HandleHttpEvent' function pointer is null.
+	//				E_RANGE		If the port number is out of range
+	//				E_INITDUP	If there is already a listening socket on the supplied port number
+	//				E_MEMORY	If the is insufficient memory to allocate the hzTcpListen for the port
+	//				E_INITFIAL	If the hzTcpListen could not be initialized
+	//				E_OK		If the operation was successful.
+
+	_hzfunc("hzIpServer::AddPortHTTP") ;
+
+	if (!OnHttpReq)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Each listening HTTP port must have a 'HandleHttpEvent' handler") ;
+
+	if (nPort < 1 || nPort > 65535)
+		return hzerr(_fn, HZ_ERROR, E_RANGE, "Port %d out of range", nPort) ;
+
+	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+
+	hzTcpListen*	pLS ;				//	Listening socket
+	uint32_t		opflags ;			//	Operational flags
+
+	//	Check that we are not already using port
+	for (I = m_LS ; I.Valid() ; I++)
+	{
+		pLS = I.Element() ;
+
+		if (pLS->GetPort() == nPort)
+			return hzerr(_fn, HZ_ERROR, E_INITDUP, "Socket already initialized and listening on port %d\n", pLS->GetPort()) ;
+	}
+
+	if (!(pLS = new hzTcpListen(m_pLog)))
+		return hzerr(_fn, HZ_ERROR, E_MEMORY, "SERIOUS ERROR - Could not allocate an LS for server") ;
+
+	opflags = HZ_LISTEN_HTTP ;
+	if (bSecure)
+		opflags |= HZ_LISTEN_SECURE ;
+
+	if (pLS->Init(HandleHttpMsg, 0, 0, 0, nTimeout, nPort, nMaxClients, opflags) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not initialize an LS for server") ;
+
+	pLS->m_appFn = (void*) OnHttpReq ;
+
+	if (m_LS.Add(pLS) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not insert an LS for server") ;
+
+	return E_OK ;
+}
+
+static	hzTcpCode	_metricsRequest	(hzHttpEvent* pE)
+{
+	//	Category:	Internet Server
+	//
+	//	HTTP request handler for the metrics port. Whatever the request, the response is the current metrics in Prometheus text format.
+	//
+	//	Arguments:	1)	pE	The HTTP event
+	//
+	//	Returns:	TCP_KEEPALIVE
+
+	hzChain		Z ;		//	Response content
+
+	hzMetrics::Export(Z) ;
+	pE->SendRawChain(HTTPMSG_OK, HMTYPE_TXT_PLAIN, Z, 0, false) ;
+	return TCP_KEEPALIVE ;
+}
+
+hzEcode	hzIpServer::AddPortMetrics	(uint32_t nPort, uint32_t nMaxClients)
+{
+	//	Category:	Internet Server
+	//
+	//	Add an HTTP listening port on which the server metrics are served (see hzMetrics.h), for the use of a monitoring system such as Prometheus. The port is
+	//	plain HTTP so it should be firewalled from the outside world. If metrics are not already active, they are activated in process memory.
+	//
+	//	Arguments:	1)	nPort			Port number
+	//				2)	nMaxClients		Max number of connections on the port
+	//
+	//	Returns:	E_MEMORY	If the metrics region could not be allocated
+	//				E_RANGE		If the port number is out of range
+	//				E_INITDUP	If there is already a listening socket on the supplied port number
+	//				E_INITFAIL	If the listening socket could not be initialized
+	//				E_OK		If the operation was successful.
+
+	hzEcode		rc ;	//	Return code
+
+	if (!hzMetrics::Active())
+	{
+		rc = hzMetrics::Init() ;
+		if (rc != E_OK)
+			return rc ;
+	}
+
+	return AddPortHTTP(_metricsRequest, 30, nPort, nMaxClients, false) ;
+}
+
+hzEcode	hzIpServer::AddPortSess	(void* (*HandleSession)(void*), uint32_t nTimeout, uint32_t	nPort, uint32_t	nMaxClients, bool bSecure)
+{
+	//	Category:	Internet Server
+	//
+	//	This provides a listening socket for connections that are to be handled in a separate thread.
+	//
+	//	Arguments:	1)	HandleSession	Application Specific thread habdler function called each time a complete HTTP request has come from a connected client. 
+	//				2)	nTimeout		Timeout in seconds.
+	//				3)	nPort			Port number
+	//				4)	nMaxClients		Max number of connections on the port (before server blocks listening socket)
+	//				5)	bSecure			Flag to indicate SSL
+	//
+	//	Returns:	E_ARGUMENT	If an event handler has not been supplied
+	//				E_RANGE		If the port number does not fall within range 1-65536
+	//				E_INITDUP	If the port is in use (another AddPort call)
+	//				E_INITFAIL	If the listening socket cannot be added or initialized
+	//				E_OK		If the listening port is assigned
+
+	_hzfunc("hzIpServer::AddPortSess") ;
+
+	if (!HandleSession)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Each listening HTTP port must have a 'HandleHttpEvent' handler") ;
+
+	if (nPort < 1 || nPort > 65535)
+		return hzerr(_fn, HZ_ERROR, E_RANGE, "Port %d out of range", nPort) ;
+
+	//	Check that we are not already using port
+
+	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+
+	hzTcpListen*	pLS ;				//	Listening socket
+	uint32_t		opflags ;			//	Operational flags
+
+	for (I = m_LS ; I.Valid() ; I++)
+	{
+		pLS = I.Element() ;
+
+		if (pLS->GetPort() == nPort)
+			return hzerr(_fn, HZ_ERROR, E_INITDUP, "Socket already initialized and listening on port %d\n", pLS->GetPort()) ;
+	}
+
+	if (!(pLS = new hzTcpListen(m_pLog)))
+		hzexit(_fn, 0, E_MEMORY, "SERIOUS ERROR - Could not allocate an LS for server") ;
+
+	opflags = HZ_LISTEN_SESSION ;
+	if (bSecure)
+		opflags |= HZ_LISTEN_SECURE ;
+
+	if (pLS->Init(0, 0, 0, HandleSession, nTimeout, nPort, nMaxClients, opflags) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not initialize an LS for server") ;
+
+	pLS->m_appFn = (void*) HandleSession ;
+
+	if (m_LS.Add(pLS) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not insert an LS for server") ;
+
+	return E_OK ;
+}
+
+hzEcode	hzIpServer::AddPortUDP	(	hzTcpCode	(*OnIngress)(hzChain&, hzIpConnex*),
+									hzTcpCode	(*OnConnect)(hzIpConnex*),
+									hzTcpCode	(*OnDisconn)(hzIpConnex*),
+									uint32_t	nTimeout,
+									uint32_t	nPort,
+									uint32_t	nMaxClients,
+									bool		bSecure	)
+{
+	//	Category:	Internet Server
+	//
+	//	This function adds a listening socket operating on the assigned port, to a server. The client connections (hzIpConnex instances) call an
+	//	application specific function each time data comes in on the port. Nothing is assumed about the incoming data so it is nessesary that the
+	//	application specific function determines if the data forms a complete message or not and acts accordingly.
+	//
+	//	Arguments:	1)	OnIngress		Application Specific 'Do Something' function to be called each time data has come in from a connected client.
+	//				2)	OnConnect		Application Specific 'Server Hello' function - only required if the protocol used dictates that the server
+	//									speaks first.
+	//				3)	nTimeout		Timeout for connections to the port in seconds
+	//				4)	nPort			Listening port number
+	//				5)	nMaxClients		Max number of connections on the port (before server blocks listening socket)
+	//				6)	bSecure			Flag to indicate SSL
+	//
+	//	Returns:	E_ARGUMENT	If the 'OnIngress' function pointer is null.
+	//				E_RANGE		If the port number is out of range
+	//				E_INITDUP	If there is already a listening socket on the supplied port number
+	//				E_MEMORY	If the is insufficient memory to allocate the hzTcpListen for the port
+	//				E_INITFIAL	If the hzTcpListen could not be initialized
+	//				E_OK		If the operation was successful.
+
+	_hzfunc("hzIpServer::AddUdpPort") ;
+
+	if (!OnIngress)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Each listening port must have a 'OnIngress' handler") ;
+
+	if (nPort < 1 || nPort > 65535)
+		return hzerr(_fn, HZ_ERROR, E_RANGE, "Port %d out of range", nPort) ;
+
+	//	Check that we are not already using port
+
+	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+
+	hzTcpListen*	pLS ;				//	Listening socket
+	uint32_t		opflags ;			//	Operational flags
+
+	for (I = m_LS ; I.Valid() ; I++)
+	{
+		pLS = I.Element() ;
+
+		if (pLS->GetPort() == nPort)
+			return hzerr(_fn, HZ_ERROR, E_INITDUP, "Socket already initialized and listening on port %d\n", pLS->GetPort()) ;
+	}
+
+	if (!(pLS = new hzTcpListen(m_pLog)))
+		return hzerr(_fn, HZ_ERROR, E_MEMORY, "SERIOUS ERROR - Could not allocate an LS for server") ;
+
+	opflags = HZ_LISTEN_UDP ;
+	if (bSecure)
+		opflags |= HZ_LISTEN_SECURE ;
+
+	if (pLS->Init(OnIngress, OnConnect, OnDisconn, 0, nTimeout, nPort, nMaxClients, opflags) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not initialize an LS for server") ;
+
+	if (m_LS.Add(pLS) != E_OK)
+		return hzerr(_fn, HZ_ERROR, E_INITFAIL, "SERIOUS ERROR - Could not insert an LS for server") ;
+
+	return E_OK ;
+}
+
+hzEcode	hzIpServer::SetRateLimit	(uint32_t nPort, hzRateScope eScope, uint32_t nRate, uint32_t nBurst)
+{
+	//	Category:	Internet Server
+	//
+	//	Apply a rate limit to a listening port, as added by one of the AddPort functions. Each port may have a limit on connections from all addresses, a limit
+	//	on connections from any one address and a limit on messages (such as HTTP requests or SMTP commands, as delimited by the port's OnIngress function)
+	//	from any one address. Each limit is a token bucket of the given burst, refilled at the given rate. Connections and messages in excess of a limit are
+	//	refused before any handler runs and the per address limits are held in fixed memory (see hzRateLimit.h).
+	//
+	//	Arguments:	1)	nPort	Port number
+	//				2)	eScope	What is to be limited
+	//				3)	nRate	Connections or messages per second
+	//				4)	nBurst	Connections or messages allowed at once
+	//
+	//	Returns:	E_NOTFOUND	If there is no listening socket on the port
+	//				E_ARGUMENT	If the scope is invalid or either the rate or burst is zero
+	//				E_RANGE		If the burst exceeds 1,000,000
+	//				E_INITDUP	If the limit is already set
+	//				E_MEMORY	If the per address limit could not be allocated
+	//				E_OK		If the limit is set
+
+	_hzfunc("hzIpServer::SetRateLimit") ;
+
+	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+
+	hzTcpListen*	pLS ;				//	Listening socket
+
+	for (I = m_LS ; I.Valid() ; I++)
+	{
+		pLS = I.Element() ;
+
+		if (pLS->GetPort() == nPort)
+			return pLS->SetRateLimit(eScope, nRate, nBurst) ;
+	}
+
+	return hzerr(_fn, HZ_ERROR, E_NOTFOUND, "No listening socket on port %d", nPort) ;
+}
+
+hzEcode	hzIpServer::SetOutputLimits	(uint32_t nConnHigh, uint32_t nConnLow, uint64_t nGlobalHigh, uint64_t nGlobalLow)
+{
+	//	Category:	Internet Server
+	//
+	//	Set the output watermarks (see synopsis in hzIpServer.h). Connections whose outgoing queue is at or above the per connection high watermark are not
+	//	writable (see hzIpConnex::Writable) and output sources are only drawn on when the queue falls below the low watermark. Once the total output queued by
+	//	all connections reaches the global high watermark, no connection is writable and sources are drawn on one chunk at a time, until the total falls below
+	//	the global low watermark. The global low watermark also bounds the memory retained for reuse by freed packets.
+	//
+	//	Arguments:	1)	nConnHigh	Per connection high watermark (bytes)
+	//				2)	nConnLow	Per connection low watermark (bytes)
+	//				3)	nGlobalHigh	Global high watermark (bytes)
+	//				4)	nGlobalLow	Global low watermark (bytes)
+	//
+	//	Returns:	E_ARGUMENT	If a low watermark is not below its high watermark
+	//				E_OK		If the limits are set
+
+	_hzfunc("hzIpServer::SetOutputLimits") ;
+
+	if (nConnLow >= nConnHigh || nGlobalLow >= nGlobalHigh)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Low watermarks must be below high watermarks") ;
+
+	s_nOutConnHigh = nConnHigh ;
+	s_nOutConnLow = nConnLow ;
+	s_nOutGlobalHigh = nGlobalHigh ;
+	s_nOutGlobalLow = nGlobalLow ;
+	return E_OK ;
+}
+
+uint64_t	hzIpServer::OutputQueued	(void) const
+{
+	//	Category:	Internet Server
+	//
+	//	Report the total output queued by all connections, in bytes
+	//
+	//	Arguments:	None
+	//	Returns:	Number of bytes queued
+
+	return __atomic_load_n(&s_nOutQueued, __ATOMIC_RELAXED) ;
+}
+
+hzEcode	hzIpServer::Activate	(void)
+{
+	//	Purpose:	Activates all listening sockets added to the server by AddPort(). This must only be called once.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	E_INITDUP	If this has already been called
+	//				E_INITFAIL	If one or more listening sockets fail to activate
+	//				E_OK		If the operation was successful.
+
+	_hzfunc("hzIpServer::Activate") ;
+
+	if (m_bActive)
+		return hzerr(_fn, HZ_ERROR, E_INITDUP, "All ports already active") ;
+
+	hzList<hzTcpListen*>::Iter	I ;		//	Listening socket iterator
+
+	hzTcpListen*	pLS ;				//	Listening socket
+
+	for (I = m_LS ; I.Valid() ; I++)
+	{
+		pLS = I.Element() ;
+
+		//	Activate port
+		if (pLS->Activate() != E_OK)
+			return hzerr(_fn, HZ_ERROR, E_INITFAIL, "Could not activate listening port (sock %d)", pLS->GetPort()) ;
+	}
+
+	m_bActive = true ;
+	return E_OK ;
+}
+
+/*
+**	Slow loris defence
+*/
+
+struct	_loris
+{
+	//	Recording of IP address of client and port client used to connect
+
+	hzIpaddr	ip ;		//	IP address of rogue client
+	uint32_t	port ;		//	Port rogue client connected on
+
+	_loris	()	{ port = 0 ; }
+
+	bool	operator<	(const _loris op) const
+	{
+		if (port < op.port)	return true ;
+		if (port > op.port)	return false ;
+		if (ip > op.ip)		return false ;
+		return true ;
+	}
+
+	bool	operator>	(const _loris op) const
+	{
+		if (port > op.port)	return true ;
+		if (port < op.port)	return false ;
+		if (ip < op.ip)		return false ;
+		return true ;
+	}
+} ;
+
+hzMapS<_loris,uint32_t>	s_black ;	//	Monitor for slow lorris attacks
+
+static	bool	_ipcheck	(const char* addr, uint32_t port)
+{
+	_loris		I ;		//	Client IP address and connected port
+	uint32_t	t ;		//	Time of last connect
+	uint32_t	x ;		//	Time before next connection allowed
+
+	I.ip = addr ;
+	I.port = port ;
+	t = time(0) ;
+
+	if (s_black.Exists(I))
+	{
+		x = s_black[I] ;
+		x -= 15 ;
+		return x <= t ? true : false ;
+	}
+
+	s_black.Insert(I,t) ;
+	return false ;
+}
+
+/*
+**	SECTION X:	Connection Table
+*/
+
+hzConnTable::hzConnTable	(void)
+{
+	m_pSlots = 0 ;
+	m_pPool = 0 ;
+	m_pLog = 0 ;
+	m_nSize = m_nCount = m_nPooled = 0 ;
+	m_nPoolMax = 0 ;
+}
+
+hzConnTable::~hzConnTable	(void)
+{
+	//	Delete the pooled connection objects. Connections still occupying slots belong to the serving loop.
+
+	hzIpConnex*	pCC ;	//	Pooled connection
+
+	for (; m_pPool ; m_pPool = pCC)
+	{
+		pCC = m_pPool->m_pPoolNext ;
+		delete m_pPool ;
+	}
+
+	delete [] m_pSlots ;
+}
+
+hzEcode	hzConnTable::Init	(hzLogger* pLog, uint32_t nPoolMax)
+{
+	//	Size the table from the limit on open file descriptors. The soft limit is raised to the hard limit first, so the process can hold as many sockets as
+	//	the system allows. The table is not allocated beyond 64K slots at this stage as it grows on demand.
+	//
+	//	Arguments:	1)	pLog		Log channel (for new connection objects)
+	//				2)	nPoolMax	Maximum number of free connection objects to retain
+	//
+	//	Returns:	E_MEMORY	If the slot array could not be allocated
+	//				E_OK		If the table is ready
+
+	_hzfunc("hzConnTable::Init") ;
+
+	struct rlimit	rl ;		//	Open file limit
+	uint32_t		nSize ;		//	Initial size
+
+	m_pLog = pLog ;
+	m_nPoolMax = nPoolMax ;
+
+	nSize = 1024 ;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0)
+	{
+		if (rl.rlim_cur < rl.rlim_max)
+		{
+			rl.rlim_cur = rl.rlim_max ;
+			if (setrlimit(RLIMIT_NOFILE, &rl) < 0)
+				getrlimit(RLIMIT_NOFILE, &rl) ;
+		}
+
+		if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > 65536)
+			nSize = 65536 ;
+		else if (rl.rlim_cur > nSize)
+			nSize = rl.rlim_cur ;
+
+		if (m_pLog)
+			m_pLog->Log(_fn, "Open file limit %lu, connection table of %u slots\n", (unsigned long) rl.rlim_cur, nSize) ;
+	}
+
+	if (nSize <= m_nSize)
+		return E_OK ;
+	return _grow(nSize - 1) ;
+}
+
+hzEcode	hzConnTable::_grow	(uint32_t nSock)
+{
+	//	Enlarge the slot array (by doubling) so that it includes the supplied socket. The generations of existing slots are preserved.
+	//
+	//	Arguments:	1)	nSock	The socket to be accommodated
+	//
+	//	Returns:	E_MEMORY	If the new array could not be allocated
+	//				E_OK		If the table now includes the socket
+
+	_slot*		pNew ;		//	New slot array
+	uint32_t	nSize ;		//	New size
+
+	for (nSize = m_nSize ? m_nSize : 1024 ; nSize <= nSock ; nSize *= 2) ;
+
+	pNew = new _slot[nSize] ;
+	if (!pNew)
+		return E_MEMORY ;
+
+	if (m_nSize)
+		memcpy(pNew, m_pSlots, m_nSize * sizeof(_slot)) ;
+	memset(pNew + m_nSize, 0, (nSize - m_nSize) * sizeof(_slot)) ;
+
+	delete [] m_pSlots ;
+	m_pSlots = pNew ;
+	m_nSize = nSize ;
+	return E_OK ;
+}
+
+hzIpConnex*	hzConnTable::Acquire	(void)
+{
+	//	Obtain a connection object, from the pool if possible
+	//
+	//	Arguments:	None
+	//	Returns:	Pointer to connection object (not yet in any slot)
+
+	hzIpConnex*	pCC ;	//	Connection object
+
+	if (!m_pPool)
+		return new hzIpConnex(m_pLog) ;
+
+	pCC = m_pPool ;
+	m_pPool = pCC->m_pPoolNext ;
+	pCC->m_pPoolNext = 0 ;
+	m_nPooled-- ;
+	return pCC ;
+}
+
+void	hzConnTable::Release	(hzIpConnex* pCC)
+{
+	//	Return a connection object to the pool. The connection must have been terminated and removed from its slot. Anything particular to the client it
+	//	served (tracking text, session info) is discarded so nothing can leak to the next client. If the pool is full the object is deleted.
+	//
+	//	Arguments:	1)	pCC		The connection object
+	//
+	//	Returns:	None
+
+	if (!pCC)
+		return ;
+
+	if (m_nPooled >= m_nPoolMax)
+		{ delete pCC ; return ; }
+
+	pCC->m_Track.Clear() ;
+	if (pCC->m_pInfo)
+	{
+		delete pCC->m_pInfo ;
+		pCC->m_pInfo = 0 ;
+	}
+	pCC->m_nEvTag = 0 ;
+
+	pCC->m_pPoolNext = m_pPool ;
+	m_pPool = pCC ;
+	m_nPooled++ ;
+}
+
+uint64_t	hzConnTable::Insert	(uint32_t nSock, hzIpConnex* pCC)
+{
+	//	Place a connection in the slot for its socket and advance the generation of the slot. The connection may already occupy the slot (in the multithreaded
+	//	server, connection objects stay in their slots after termination and are reused by the next client on the same socket).
+	//
+	//	Arguments:	1)	nSock	The client socket
+	//				2)	pCC		The connection
+	//
+	//	Returns:	0			If the table could not be grown to include the socket
+	//				The epoll event tag for the connection (generation in the upper 32 bits, socket in the lower)
+
+	_slot*	pSlot ;		//	Slot for socket
+
+	if (!pCC)
+		return 0 ;
+
+	if (nSock >= m_nSize && _grow(nSock) != E_OK)
+		return 0 ;
+
+	pSlot = m_pSlots + nSock ;
+	if (!pSlot->m_pCC)
+		m_nCount++ ;
+	pSlot->m_pCC = pCC ;
+
+	//	Generation 0 is reserved for tags that are not generation checked (listening sockets)
+	pSlot->m_nGen++ ;
+	if (!pSlot->m_nGen)
+		pSlot->m_nGen = 1 ;
+
+	pCC->m_nEvTag = ((uint64_t) pSlot->m_nGen << 32) | nSock ;
+	return pCC->m_nEvTag ;
+}
+
+void	hzConnTable::Remove	(uint32_t nSock)
+{
+	//	Vacate the slot for the socket. The generation is left as is so late events for the departed connection remain recognizably stale.
+	//
+	//	Arguments:	1)	nSock	The client socket
+	//
+	//	Returns:	None
+
+	if (nSock < m_nSize && m_pSlots[nSock].m_pCC)
+	{
+		m_pSlots[nSock].m_pCC = 0 ;
+		m_nCount-- ;
+	}
+}
+
+hzIpConnex*	hzConnTable::Lookup	(uint64_t nTag) const
+{
+	//	Find the connection an epoll event tag refers to
+	//
+	//	Arguments:	1)	nTag	The event tag
+	//
+	//	Returns:	Pointer to the connection
+	//				NULL if the slot is vacant or the tag is stale
+
+	uint32_t	nSock ;		//	Socket
+
+	nSock = Socket(nTag) ;
+	if (nSock >= m_nSize || m_pSlots[nSock].m_nGen != (uint32_t) (nTag >> 32))
+		return 0 ;
+	return m_pSlots[nSock].m_pCC ;
+}
+
+bool	hzConnTable::Stale	(uint64_t nTag) const
+{
+	//	Determine if an epoll event tag is from an earlier connection on the socket. Tags of generation 0 are never stale.
+	//
+	//	Arguments:	1)	nTag	The event tag
+	//
+	//	Returns:	True	If the tag generation differs from that of the slot
+	//				False	Otherwise
+
+	uint32_t	nSock ;		//	Socket
+	uint32_t	nGen ;		//	Generation
+
+	nSock = Socket(nTag) ;
+	nGen = (uint32_t) (nTag >> 32) ;
+
+	if (!nGen || nSock >= m_nSize)
+		return false ;
+	return m_pSlots[nSock].m_nGen != nGen ? true : false ;
+}
+
+/*
+**	SECTION X:	Epoll Method (Single Threaded)
+*/
+
+#define MAXEVENTS	100
+
+void	hzIpServer::ServeEpollST	(void)
+{
+	//	Category:	Internet Server
+	//
+	//	This is executed in a single thread and acts as server using epoll in edge-triggered mode. The thread must be dedicated for the purpose as it is blocked
+	//	if there is no incoming requests to contend with. In edge-triggered mode, notification that a socket has data to be read, is only given at the point the
+	//	data arrives and so must always be read in full.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	None
+	//
+	//	Note:		Call only once for all listening sockets! This function will not return until the server is shut down
+
+	_hzfunc("hzIpServer::ServeEpollST") ;
+
+	//	Here we stay in a loop consiting of three stages:-
+	//	1)	Setup all array of all active entities for the epoll system call
+	//	2)	Call epoll to wait for something to come in.
+	//	3)	Go through all active entries to see which one recieved a message
+
+	hzMapS	<hzIpaddr,hzIpConnex*>		udpClients ;	//	Map of UDP clients by IP address
+	hzMapS	<uint32_t,hzIpConnex*>		ConnInError ;	//	Map of TCP clients in error
+	hzMapS	<uint32_t,hzTcpListen*>		Listen ;		//	Listening sockets map
+	hzList	<hzTcpListen*>::Iter		I ;				//	Listening sockets iterator
+
+	struct epoll_event	eventAr[MAXEVENTS] ;			//	Epoll event array
+	struct epoll_event	epEventNew ;					//	Epoll event for new connections
+
+	hzTimerWheel	wheel ;				//	Connection expiry timers
+	hzTimer*		pTm ;				//	Expired timer
+	hzTimer*		pTmNext ;			//	Next expired timer
+
+	hzPacket		tbuf ;				//	Fixed buffer for single IP packet
+	SOCKADDR		cliAddr ;			//	Client address
+	SOCKADDRIN		cliAddrIn ;			//	Client address
+	socklen_t		cliLen ;			//	Client address length
+	hzTcpListen*	pLS ;				//	Listening socket
+	hzIpConnex*		pCC ;				//	Connected client
+	SSL*			pSSL ;				//	SSL session (if applicable)
+	hzProcInfo		proc_data ;			//	Process data (Client socket & IP address, must be destructed by the called thread function)
+	uint32_t		nAttempts ;			//	Connection attempts by a blocked IP address
+	hzXDate			now ;				//	Time now (used to log connections)
+	pthread_attr_t	tattr ;				//	Thread attribute (to support thread invokation)
+	pthread_t		tid ;				//	Needed for multi-threading
+	timeval			tv ;				//	Time limit for epoll call
+	uint64_t		nsThen ;			//	Before the wait
+	uint64_t		nsNow ;				//	After the wait
+	uint64_t		nTag ;				//	Epoll event tag of new connection
+	hzIpaddr		ipa ;				//	IP address
+	uint32_t		nCliSeq ;			//	Client connection id allocator
+	uint32_t		nLoop ;				//	Number of times round the epoll event loop
+	uint32_t		nSlot ;				//	Connections iterator
+	uint32_t		nEpollEvents ;		//	Result of the epoll call
+	uint32_t		nError ;			//	Errno of the epoll call
+	uint32_t		cSock ;				//	Client socket (from accept)
+	uint32_t		cPort ;				//	Client socket (from accept)
+	uint32_t		prc ;				//	Return from pthread_create
+	uint32_t		nBannedAttempts ;	//	Connection attempts by blocked IP address
+	int32_t			aSock ;				//	Client socket (validated)
+	int32_t			nWait ;				//	Epoll timeout (milliseconds until next connection deadline)
+	int32_t			flags ;				//	Flags to mak socket non-blocking
+	int32_t			nRecv ;				//	No bytes read from client socket after epoll (in one read)
+	int32_t			nRecvTotal ;		//	No bytes read from client socket after epoll (in a series of reads)
+	int32_t			sys_rc ;			//	Return from system library calls
+	int32_t			xmitState ;			//	Return from _xmit() call
+	hzTcpCode		trc ;				//	Return code
+	hzHandshake		hsr ;				//	Return from TLS handshake
+	char			sbuf[24] ;			//	Client IP address textform buffer
+	char			ipbuf[44] ;			//	Client IP address textform buffer
+
+	//	Pre-define thread attributes
+	pthread_attr_init(&tattr) ;
+	pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED) ;
+
+	//	Set list default
+	//Listen.SetDefaultObj((hzTcpListen*)0) ;
+
+	//	Init connected client regime
+	if (m_Conns.Init(m_pLog) != E_OK)
+		Fatal("%s. Could not allocate connection table\n", *_fn) ;
+	cliLen = sizeof(cliAddrIn) ;
+
+	//	Create epoll socket and and listening sockets to the controller
+	epollSocket = epoll_create1(0) ;
+	if (epollSocket == -1)
+		Fatal("%s. Could not create epoll socket\n", *_fn) ;
+	m_pLog->Log(_fn, "Epoll socket is %d\n", epollSocket) ;
+
+	for (I = m_LS ; I.Valid() ; I++)
+	{
+		pLS = I.Element() ;
+
+		epEventNew.data.u64 = pLS->GetSocket() ;
+		epEventNew.events = EPOLLIN ;	//| EPOLLET ;
+		if (epoll_ctl(epollSocket, EPOLL_CTL_ADD, pLS->GetSocket(), &epEventNew) < 0)
+			Fatal("%s. Could not add listening socket %d to the epoll controller\n", *_fn, pLS->GetSocket()) ;
+
+		m_pLog->Log(_fn, "Added listening socket is %d\n", pLS->GetSocket()) ;
+		Listen.Insert(pLS->GetSocket(), pLS) ;
+	}
+
+	//	Client sockets are level-triggered and output queued by the handlers is written out on return from them
+	s_nEpollET = 0 ;
+	s_bServing = true ;
+
+	//	Main loop - waiting for events
+	nLoop = nCliSeq = nBannedAttempts = 0 ;
+	wheel.Init(RealtimeNano()) ;
+
+	for (;;)
+	{
+		//	Check for shutdown condition
+		if (m_bShutdown)
+		{
+			//	Check for outstanding connections
+			if (!m_Conns.Count())
+				break ;
+		}
+
+		//	Check for expired connections
+		for (nSlot = 0 ; nSlot < ConnInError.Count() ; nSlot++)
+		{
+			pCC = ConnInError.GetObj(nSlot) ;
+		}
+
+		//	Expire connections whose deadlines have passed. Timers are re-armed lazily: activity on a connection only moves its deadline, so when a timer falls
+		//	due the deadline is checked and if it has moved, the timer is simply re-armed. The cost is thus proportional to the number of timers falling due
+		//	rather than the number of connections.
+		nsNow = RealtimeNano() ;
+		for (pTm = wheel.Expire(nsNow) ; pTm ; pTm = pTmNext)
+		{
+			pTmNext = pTm->m_pNext ;
+			pCC = (hzIpConnex*) pTm->m_pObj ;
+
+			if (nsNow < pCC->Deadline())
+				{ wheel.Arm(pTm, pCC->Deadline()) ; continue ; }
+
+			cSock = pCC->CliSocket() ;
+
+			if (pCC->IsHandshake())
+				{ __atomic_add_fetch(&m_nTlsExpired, 1, __ATOMIC_RELAXED) ; pCC->m_Track.Error("ServeEpollST: Loop %u: TLS handshake time limit exceeded on socket %u/%u - removed", nLoop, cSock, pCC->CliPort()) ; }
+			else if (pCC->_isxmit())
+				{ m_nExpWrite++ ; pCC->m_Track.Error("ServeEpollST: Loop %u: Response stalled on socket %u/%u - removed", nLoop, cSock, pCC->CliPort()) ; }
+			else if (pCC->SizeIn())
+				{ m_nExpRead++ ; pCC->m_Track.Error("ServeEpollST: Loop %u: Request incomplete on socket %u/%u - removed", nLoop, cSock, pCC->CliPort()) ; }
+			else if (pCC->m_OnIdle && pCC->m_OnIdle(pCC) == TCP_KEEPALIVE)
+			{
+				//	Idle function has queued output (such as a WebSocket ping) to keep the connection open
+				pCC->_wantWrite(true) ;
+				wheel.Arm(pTm, pCC->Deadline()) ;
+				continue ;
+			}
+			else
+				{ m_nExpIdle++ ; pCC->m_Track.Event("ServeEpollST: Loop %u: Connection idle on socket %u/%u - removed", nLoop, cSock, pCC->CliPort()) ; }
+
+			pCC->MetricExpired() ;
+			pCC->Terminate() ;
+			m_Conns.Remove(cSock) ;
+			m_Conns.Release(pCC) ;
+		}
+
+		//	Wait for events
+		nsThen = RealtimeNano() ;
+		nWait = wheel.NextTimeout(nsThen) ;
+		if (nWait < 0 || nWait > 60000)
+			nWait = 60000 ;
+		nEpollEvents = epoll_wait(epollSocket, eventAr, MAXEVENTS, nWait) ;
+		nsNow = RealtimeNano() ;
+		nLoop++ ;
+
+		if (!nEpollEvents && !wheel.Count())
+			m_pLog->Log(_fn, "No action\n") ;
+
+		for (nSlot = 0 ; nSlot < nEpollEvents ; nSlot++)
+		{
+			if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+			{
+				if (nSlot)
+					m_pLog->Log(_fn, "Loop %u slot %u: Event on socket %u\n", nLoop, nSlot, hzConnTable::Socket(eventAr[nSlot].data.u64)) ;
+				else
+					m_pLog->Log(_fn, "Loop %u: Waited %lu nanoseconds for %d events: 1st sock %u\n", nLoop, nsNow - nsThen, nEpollEvents, hzConnTable::Socket(eventAr[0].data.u64)) ;
+			}
+
+			//	Ignore events tagged with an earlier generation of the socket. These belong to a connection that has since closed.
+			if (m_Conns.Stale(eventAr[nSlot].data.u64))
+			{
+				m_pLog->Log(_fn, "Loop %u slot %u: Stale event on socket %u ignored\n", nLoop, nSlot, hzConnTable::Socket(eventAr[nSlot].data.u64)) ;
+				continue ;
+			}
+
+			/*
+			**	Check for output sources that were waiting on their own sockets (see hzIpConnex::_refill). These now have more data (or have failed, which
+			**	the next Fill() will report), so resume the output.
+			*/
+
+			if (hzConnTable::IsSource(eventAr[nSlot].data.u64))
+			{
+				pCC = m_Conns.Lookup(eventAr[nSlot].data.u64) ;
+				if (!pCC || !pCC->CliSocket() || !pCC->_isxmit())
+					continue ;
+
+				cSock = pCC->CliSocket() ;
+				xmitState = pCC->_xmit(tbuf) ;
+				if (xmitState < 0 || (!pCC->_isxmit() && pCC->m_bState & CLIENT_CLOSING))
+				{
+					if (xmitState < 0)
+						pCC->m_Track.Error("ServeEpollST: Loop %u: Output source failed, connection on socket %u/%u to be removed", nLoop, cSock, pCC->CliPort()) ;
+					pCC->Terminate() ;
+					m_Conns.Remove(cSock) ;
+					m_Conns.Release(pCC) ;
+				}
+				continue ;
+			}
+
+			/*
+			**	Check for hangups and other connection errors
+			*/
+
+			if (eventAr[nSlot].events & EPOLLHUP)
+			{
+				//	Hangup signal
+				cSock = hzConnTable::Socket(eventAr[nSlot].data.u64) ;
+				pCC = m_Conns[cSock] ;
+				nError = 0 ;
+
+				if (!pCC)				{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: HANGUP CORRUPT Sock %d No connector\n", nLoop, nSlot, cSock) ; continue ; }
+				if (!pCC->CliSocket())	{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: HANGUP CORRUPT Sock %d Connector defunct\n", nLoop, nSlot, cSock) ; continue ; }
+
+				if (getsockopt(cSock, SOL_SOCKET, SO_ERROR, (void *)&nError, &cliLen) == 0)
+					pCC->m_Track.EventS("ServeEpollST: Loop %u: HANGUP on socket %u (%s)", strerror(nError), nLoop, cSock) ;
+				else
+					pCC->m_Track.Event("ServeEpollST: Loop %u: HANGUP on socket %u (no details)", nLoop, cSock) ;
+			}
+
+			if (eventAr[nSlot].events & EPOLLERR)
+			{
+				//	An error has occured on this fd, or the socket is not ready for reading
+				cSock = hzConnTable::Socket(eventAr[nSlot].data.u64) ;
+				pCC = m_Conns[cSock] ;
+				nError = 0 ;
+
+				if (!pCC)				{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: EPOLLERR CORRUPT Sock %d No connector\n", nLoop, nSlot, cSock) ; continue ; }
+				if (!pCC->CliSocket())	{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: EPOLLERR CORRUPT Sock %d Connector defunct\n", nLoop, nSlot, cSock) ; continue ; }
+
+				if (getsockopt(cSock, SOL_SOCKET, SO_ERROR, (void *)&nError, &cliLen) == 0)
+					pCC->m_Track.ErrorS("ServeEpollST: Loop %u: EPOLLERR on socket %u (%s)", strerror(nError), nLoop, cSock) ;
+				else
+					pCC->m_Track.Error("ServeEpollST: Loop %u: EPOLLERR on socket %u (no details)", nLoop, cSock) ;
+			}
+
+			/*
+			**	Check for events on listening sockets
+			*/
+
+			if (Listen.Exists(hzConnTable::Socket(eventAr[nSlot].data.u64)))
+			{
+				//	We have a notification on the listening socket so either a new incoming connection or if the listening socket is UDP, an incoming UDP packet.
+
+				pLS = Listen[hzConnTable::Socket(eventAr[nSlot].data.u64)] ;
+				pSSL = 0 ;
+
+				if (pLS->UseUDP())
+				{
+					/*
+					**	Packet is UDP
+					*/
+
+					cSock = pLS->GetSocket() ;
+					flags = fcntl(pLS->GetSocket(), F_GETFL, 0) ;
+					if (flags == -1)
+					{
+						m_pLog->Log(_fn, "UDP: Loop %u: NOTE: Could not make client socket %d non blocking (case 1)\n", nLoop, pLS->GetSocket()) ;
+						if (close(pLS->GetSocket()) < 0)
+							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after non_block_fail(1) errno=%d\n", nLoop, pLS->GetSocket(), errno) ;
+						continue ;
+					}
+					flags |= O_NONBLOCK ;
+					if (fcntl(pLS->GetSocket(), F_SETFL, flags) == -1)
+					{
+						m_pLog->Log(_fn, "UDP: Loop %u: NOTE: Could not make client socket %d non blocking (case 2)\n", nLoop, pLS->GetSocket()) ;
+						if (close(pLS->GetSocket()) < 0)
+							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after non_block_fail(2) errno=%d\n", nLoop, pLS->GetSocket(), errno) ;
+						continue ;
+					}
+
+					cliLen = sizeof(cliAddrIn) ;
+					if ((nRecv = recvfrom(pLS->GetSocket(), tbuf.m_data, HZ_MAXPACKET, 0, (SOCKADDR*) &cliAddrIn, &cliLen)) < 0)
+					{
+						m_pLog->Log(_fn, "UDP: Loop %u: NOTE: Could not read from UDP client\n", nLoop) ;
+						continue ;
+					}
+
+					ipa = (uint32_t) cliAddrIn.sin_addr.s_addr ;
+					cPort = ntohs(cliAddrIn.sin_port) ;
+					tbuf.m_data[nRecv] = 0 ;
+
+					pCC = udpClients[ipa] ;
+					if (!pCC)
+					{
+						pCC = new hzIpConnex(m_pLog) ;
+						udpClients.Insert(ipa, pCC) ;
+
+						//	Initialize and oxygenate the connection
+						pCC->Initialize(pLS, pSSL, ipbuf, cSock, cPort, nCliSeq++) ;
+						if (pCC->m_OnConnect)
+							pCC->m_OnConnect(pCC) ;
+					}
+
+					m_pLog->Out("Received UDP message %s from port %d internet address %s\n", tbuf.m_data, cPort, *ipa.Str()) ;
+
+					if (pCC->MsgReady())
+						trc = pCC->_admit() ? pCC->m_OnIngress(pCC->InputZone(), pCC) : TCP_TERMINATE ;
+					else
+						trc = TCP_INCOMPLETE ;
+
+					switch (trc)
+					{
+					case TCP_TERMINATE:
+
+						if (pCC->_isxmit())
+						{
+							//	If outgoing data not complete, transmit some more.
+							xmitState = pCC->_xmit(tbuf) ;
+							if (xmitState < 0)
+							{
+								m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_TERMINATE: Write error - Sock %d/%d to be removed\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
+								pCC->Terminate() ;
+								udpClients.Delete(ipa) ;
+								delete pCC ;
+								break ;
+							}
+
+							if (xmitState > 0)
+							{
+								//	We have EAGAIN or EWOULDBLOCK and so now we make epoll entry to look for write event (when ocket becomes writable)
+								m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_TERMINATE: Write delay - Sock %d /%d, looking for write event\n",
+									nLoop, nSlot, cSock, pCC->CliPort()) ;
+								break ;
+							}
+						}
+	
+						//	No more outgoing data so close
+						m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_TERMINATE: Normal termination, sock %d/%d to be removed\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
+						pCC->Terminate() ;
+						udpClients.Delete(ipa) ;
+						delete pCC ;
+						break ;
+
+					case TCP_KEEPALIVE:
+
+						m_pLog->Log(_fn, "UDP: Client %d SERVER - data processed, awaiting further messages\n", pCC->EventNo()) ;
+						pCC->Oxygen() ;
+						if (pCC->_isxmit())
+						{
+							xmitState = pCC->_xmit(tbuf) ;
+							if (xmitState < 0)
+							{
+								m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_KEEPALIVE: Write error, sock %d/%d to be removed\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
+								pCC->Terminate() ;
+								udpClients.Delete(ipa) ;
+								delete pCC ;
+								break ;
+							}
+
+							if (xmitState > 0)
+							{
+								//	We have EAGAIN or EWOULDBLOCK and so now we make epoll entry to look for write event (when ocket becomes writable)
+								m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_KEEPALIVE: Write delay - Sock %d/%d retained\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
+								break ;
+							}
+
+							//	We have xmitState of 0 which means the message was written in full to the socket
+							m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_KEEPALIVE: Write OK, sock %d/%d retained\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
+						}
+
+						if (pCC->IsCliTerm())
+						{
+							//	No longer any incoming requests and as we have finished writing, close
+							m_pLog->Log(_fn, "UDP: Loop %u loop %u: TCP_KEEPALIVE: Client done so sock %d/%d to be removed\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
+							pCC->Terminate() ;
+							udpClients.Delete(ipa) ;
+							delete pCC ;
+							break ;
+						}
+						break ;
+
+					case TCP_INCOMPLETE:
+
+						m_pLog->Log(_fn, "UDP: Client %d SERVER - data incomplete\n", pCC->EventNo()) ;
+						pCC->Oxygen() ;
+						break ;
+
+					case TCP_INVALID:		//	The message processor cannot dechipher the message. Kill the connection
+
+						if (m_pLog)
+							m_pLog->Log(_fn, "UDP: Loop %u: Sock %d/%d INVALID TCP code\n", nLoop, cSock, pCC->CliPort()) ;
+						pCC->Terminate() ;
+						udpClients.Delete(ipa) ;
+						delete pCC ;
+						break ;
+					}
+
+					continue ;
+					//	End of UDP section
+				}
+
+				/*
+				**	Now the TCP case: Firstly accept the client no matter what, if there is a problem close the connection.
+				*/
+
+				aSock = accept(pLS->GetSocket(), &cliAddr, &cliLen) ;
+				if (aSock < 0)
+				{
+					m_pLog->Log(_fn, "Loop %u: NOTE: Listening socket %d ignored client on port %d\n", nLoop, pLS->GetSocket(), pLS->GetPort()) ;
+
+					if (errno && errno != EAGAIN && errno != EWOULDBLOCK)
+					{
+						m_bShutdown = true ;
+						m_pLog->Log(_fn, "Loop %u: SHUTDOWN: Listening socket %d failure: Port %d (errno=%d)\n", nLoop, pLS->GetSocket(), pLS->GetPort(), errno) ;
+					}
+					continue ;
+				}
+
+				sys_rc = getnameinfo(&cliAddr, cliLen, ipbuf, 24, sbuf, 24, NI_NUMERICHOST | NI_NUMERICSERV) ;
+                if (sys_rc)
+				{
+					m_pLog->Log(_fn, "Loop %u: Accepted connection on socket %d port %d but no name info - closing connection\n", nLoop, aSock, pLS->GetPort()) ;
+					if (close(cSock) < 0)
+						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after name info fail. errno=%d\n", nLoop, cSock, errno) ;
+					continue ;
+				}
+
+				cSock = aSock ;
+				cPort = atoi(sbuf) ;
+				ipa = ipbuf ;
+
+				//	Check if client is blocked. Note this does not work when connections are coming via Apache proxypass because getnameinfo will give the IP address as 127.0.0.1
+				if (_hzGlobal_StatusIP.Blocked(ipa, &nAttempts))
+				{
+					if (!(nAttempts%100))		m_pLog->Log(_fn, "BLOCKED IP %s reaches %u attempts\n", ipbuf, nAttempts) ;
+					if (close(cSock) < 0)		m_pLog->Log(_fn, "ERROR: Could not close socket %d after blocked IP address detected. errno=%d\n", cSock, errno) ;
+
+					nBannedAttempts++ ;
+					if (!(nBannedAttempts%10000))
+						m_pLog->Log(_fn, "BLOCKED IP TOTAL reaches %u attempts\n", nBannedAttempts) ;
+					continue ;
+				}
+
+				//	Apply the connection rate limits of the port
+				if (pLS->AdmitConn(ipa) != HZ_RATE_NONE)
+				{
+					if ((pLS->RefusedConns()%100) == 1)	m_pLog->Log(_fn, "RATE LIMIT: Port %d has refused %u connections (latest from %s)\n", pLS->GetPort(), pLS->RefusedConns(), ipbuf) ;
+					if (close(cSock) < 0)				m_pLog->Log(_fn, "ERROR: Could not close socket %d after rate limit refusal. errno=%d\n", cSock, errno) ;
+					continue ;
+				}
+
+				if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+					m_pLog->Log(_fn, "Loop %u: Accepted connection (1): socket %d/%s host %s port %d\n", nLoop, aSock, sbuf, ipbuf, pLS->GetPort()) ;
+
+				if (m_Conns[cSock])
+					m_pLog->Log(_fn, "WARNING: Loop %u: New connection on socket %d does not have a clean slot %p\n", nLoop, cSock, m_Conns[cSock]) ;
+
+				if (!pLS->m_OnSession)
+				{
+					//	If the connection is not to be handled by a designated session, make the incoming socket non-blocking (to be handled by epoll)
+					flags = fcntl(cSock, F_GETFL, 0) ;
+					if (flags == -1)
+					{
+						m_pLog->Log(_fn, "Loop %u: NOTE: Could not make client socket %d non blocking (case 1)\n", nLoop, cSock) ;
+						if (close(cSock) < 0)
+							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after non_block_fail(1) errno=%d\n", nLoop, cSock, errno) ;
+						continue ;
+					}
+					flags |= O_NONBLOCK ;
+					if (fcntl(cSock, F_SETFL, flags) == -1)
+					{
+						m_pLog->Log(_fn, "Loop %u: NOTE: Could not make client socket %d non blocking (case 2)\n", nLoop, cSock) ;
+						if (close(cSock) < 0)
+							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after non_block_fail(2) errno=%d\n", nLoop, cSock, errno) ;
+						continue ;
+					}
+				}
+
+				//	Deal with the case where we have too many connections or we are shutting down.
+				if (m_bShutdown || pLS->GetCurConnections() >= pLS->GetMaxConnections())
+				{
+					m_pLog->Log(_fn, "Loop %u: NOTE: System too busy: Curr %d Max %d stat %d\n",
+						nLoop, pLS->GetCurConnections(), m_nMaxClients, m_bShutdown ? 1 : 0) ;
+					if (close(cSock) < 0)
+						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after sys_too_busy errno=%d\n", nLoop, cSock, errno) ;
+					continue ;
+				}
+
+				//	Client is already connected. Do we allow further connections?
+				if (_ipcheck(ipbuf, pLS->GetPort()))
+				{
+					m_pLog->Log(_fn, "Loop %u: NOTE: Lorris Attack from IP %s port %d\n", ipbuf, pLS->GetPort()) ;
+					if (close(cSock) < 0)
+						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after lorris_attack errno=%d\n", nLoop, cSock, errno) ;
+					continue ;
+				}
+
+				//	All is well so set socket options
+				tv.tv_sec = 20 ;
+				tv.tv_usec = 0 ;
+				if (setsockopt(cSock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
+				{
+					m_pLog->Log(_fn, "Loop %u: NOTE: Could not set send socket options\n", nLoop) ;
+					if (close(cSock) < 0)
+						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after setop_send errno=%d\n", nLoop, cSock, errno) ;
+					continue ;
+				}
+				if (setsockopt(cSock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+				{
+					m_pLog->Log(_fn, "Loop %u: NOTE: Could not set recv socket options\n", nLoop) ;
+					if (close(cSock) < 0)
+						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after setop_recv errno=%d\n", cSock, errno) ;
+					continue ;
+				}
+
+				//	Do we have SSL on top of connection? If so create the SSL session now but do not attempt the handshake here. This is driven by the epoll loop
+				//	as the client sends the handshake data, so that a slow or malicious client cannot stall the server. Connections handed to a session thread
+				//	perform the handshake implicitly on the first SSL_read() within the thread.
+				if (pLS->UseSSL())
+				{
+					pSSL = SSL_new(s_svrCTX) ;
+					if (!pSSL)
+					{
+						m_pLog->Log(_fn, "Loop %u: NOTE: Failed to allocate an SSL instance on port %d\n", nLoop, pLS->GetPort()) ;
+						if (close(cSock) < 0)
+							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after SSL no_alloc errno=%d\n", nLoop, cSock, errno) ;
+						continue ;
+					}
+
+					if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+						m_pLog->Log(_fn, "Loop %u: Allocated SSL instance on port %d\n", nLoop, pLS->GetPort()) ;
+
+					SSL_set_accept_state(pSSL) ;
+					SSL_set_fd(pSSL, cSock) ;
+				}
+
+				/*
+				**	If the listening socket is for a session handler, i.e. the connection is to be handled by a separate thread, deal with this here
+				*/
+
+				if (pLS->m_OnSession)
+				{
+					//	Call the session handler in it's own thread
+					proc_data.SetParams(pSSL, cSock, ipa) ;
+					prc = pthread_create(&tid, &tattr, pLS->m_OnSession, &proc_data) ;
+					if (prc == 0)
+					{
+						m_pLog->Log(_fn, "Thread %u accepted connection from %s on socket %d\n", tid, ipbuf, cSock) ;
+						if (cSock >= m_nMaxSocket)
+							m_nMaxSocket = cSock + 1 ;
+					}
+					else
+					{
+						m_pLog->Log(_fn, "NOTE: Could not create thread for client %s on socket %d. Closing conection\n", ipbuf, cSock) ;
+						if (close(cSock) < 0)
+							m_pLog->Log(_fn, "NOTE: Could not close socket %d after SSL fail_thread_create. errno=%d\n", cSock, errno) ;
+						//delete pPD ;
+					}
+
+					continue ;
+				}
+
+				/*
+				**	Allocate the connected client object
+				*/
+
+				pCC = m_Conns[cSock] ;
+				if (pCC)
+				{
+					m_pLog->Log(_fn, "Loop %u slot %u: CORRUPT: Existing client connection handler on sock %d/%d.\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
+					if (close(cSock) < 0)
+						m_pLog->Log(_fn, "NOTE: Could not close socket %d after memory allocation failure. errno=%d\n", cSock, errno) ;
+					m_bShutdown = true ;
+					continue ;
+				}
+
+				pCC = m_Conns.Acquire() ;
+				nTag = pCC ? m_Conns.Insert(cSock, pCC) : 0 ;
+				if (!nTag)
+				{
+					m_pLog->Log(_fn, "ERROR: No memory for client %s on socket %d. Closing conection\n", ipbuf, cSock) ;
+					if (close(cSock) < 0)
+						m_pLog->Log(_fn, "NOTE: Could not close socket %d after memory allocation failure. errno=%d\n", cSock, errno) ;
+					m_Conns.Release(pCC) ;
+					m_bShutdown = true ;
+					continue ;
+				}
+
+				//	Add new client socket to the epoll control, tagged with the slot generation
+				epEventNew.data.u64 = nTag ;
+				epEventNew.events = EPOLLIN ;	//| EPOLLET ;
+
+				if (epoll_ctl(epollSocket, EPOLL_CTL_ADD, cSock, &epEventNew) < 0)
+				{
+					m_pLog->Log(_fn, "Loop %u slot %u: EPOLL ERROR: Could not add client connection handler on sock %d/%d. Error=%s\n",
+						nLoop, nSlot, cSock, cPort, strerror(errno)) ;
+					if (close(cSock) < 0)
+						m_pLog->Log(_fn, "NOTE: Could not close socket %d after memory allocation failure. errno=%d\n", cSock, errno) ;
+					m_bShutdown = true ;
+					m_Conns.Remove(cSock) ;
+					m_Conns.Release(pCC) ;
+					continue ;
+				}
+
+				//	Initialize and oxygenate the connection
+				pCC->Initialize(pLS, pSSL, ipbuf, cSock, cPort, nCliSeq++) ;
+				pCC->m_Track.Event("ServeEpollST: Loop %u: NEW Connection on socket %u/%u port %u", nLoop, cSock, pCC->CliPort(), pLS->GetPort()) ;
+
+				//	On a secure connection, the server hello (if any) must wait for the TLS handshake
+				if (pCC->IsHandshake())
+				{
+					__atomic_add_fetch(&m_nTlsBegun, 1, __ATOMIC_RELAXED) ;
+					pCC->SetHandshakeLimit(RealtimeNano() + (uint64_t) m_nTlsTimeout * 1000000000) ;
+					wheel.Arm(&pCC->m_Timer, pCC->Deadline()) ;
+					continue ;
+				}
+
+				wheel.Arm(&pCC->m_Timer, pCC->Deadline()) ;
+
+				if (pCC->m_OnConnect)
+				{
+					pCC->m_OnConnect(pCC) ;
+					if (pCC->_isxmit() && pCC->_xmit(tbuf) < 0)
+					{
+						pCC->Terminate() ;
+						m_Conns.Remove(cSock) ;
+						m_Conns.Release(pCC) ;
+					}
+				}
+				continue ;
+
+				//	End of TCP Listen stuff
+			}
+
+			/*
+			**	Advance TLS handshakes in progress
+			*/
+
+			cSock = hzConnTable::Socket(eventAr[nSlot].data.u64) ;
+			pCC = m_Conns[cSock] ;
+			if (pCC && pCC->IsHandshake())
+			{
+				hsr = pCC->Handshake() ;
+
+				//	Only look for writability while the handshake needs it, otherwise the level-triggered EPOLLOUT would fire continuously
+				if (hsr == HANDSHAKE_WANT_WRITE || (eventAr[nSlot].events & EPOLLOUT))
+				{
+					epEventNew.data.u64 = pCC->EventTag() ;
+					epEventNew.events = hsr == HANDSHAKE_WANT_WRITE ? EPOLLIN | EPOLLOUT : EPOLLIN ;
+					if (epoll_ctl(epollSocket, EPOLL_CTL_MOD, cSock, &epEventNew) < 0)
+						pCC->m_Track.ErrorS("ServeEpollST: Loop %u: EPOLL ERROR: Could not modify handshake events on sock %u. Error=%s", strerror(errno), nLoop, cSock) ;
+				}
+
+				if (hsr == HANDSHAKE_WANT_READ || hsr == HANDSHAKE_WANT_WRITE)
+					continue ;
+
+				if (hsr == HANDSHAKE_FAILED)
+				{
+					__atomic_add_fetch(&m_nTlsFailed, 1, __ATOMIC_RELAXED) ;
+					pCC->Terminate() ;
+					m_Conns.Remove(cSock) ;
+					m_Conns.Release(pCC) ;
+					continue ;
+				}
+
+				_tlsDone(pCC) ;
+				if (pCC->m_OnConnect)
+				{
+					pCC->m_OnConnect(pCC) ;
+					if (pCC->_isxmit() && pCC->_xmit(tbuf) < 0)
+					{
+						pCC->Terminate() ;
+						m_Conns.Remove(cSock) ;
+						m_Conns.Release(pCC) ;
+						continue ;
+					}
+				}
+
+				//	Application data that arrived with the final handshake flight is already held by SSL and would not be reported by epoll, so read it now
+				if (!pCC->SslPending())
+					continue ;
+				eventAr[nSlot].events = EPOLLIN ;
+			}
+
+			if (eventAr[nSlot].events & EPOLLOUT)
+			{
+				//	The socket is only monitored for writability while there is output it would not take (see hzIpConnex::_wantWrite), so we now have notification
+				//	that the socket has become writable and more of the output can be written.
+
+				cSock = hzConnTable::Socket(eventAr[nSlot].data.u64) ;
+				pCC = m_Conns[cSock] ;
+				if (!pCC)
+				{
+					m_pLog->Log(_fn, "Loop %u slot %u: CORRUPT: Write event on socket %d/%d but no connector!\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
+					m_bShutdown = true ;
+					continue ;
+				}
+
+				if (cSock != pCC->CliSocket())
+				{
+					m_pLog->Log(_fn, "Loop %u slot %u: CORRUPT: Write event on sock %d/%d but attached client object has socket of %d\n",
+						nLoop, nSlot, cSock, pCC->CliPort(), pCC->CliSocket()) ;
+					m_bShutdown = true ;
+					continue ;
+				}
+
+				if (pCC->IsCliBad())
+				{
+					pCC->m_Track.Error("ServeEpollST: Loop %u: BAD Client, connection on socket %u/%u to be removed", nLoop, cSock, pCC->CliPort()) ;
+					pCC->Terminate() ;
+					m_Conns.Remove(cSock) ;
+					m_Conns.Release(pCC) ;
+					continue ;
+				}
+
+				if (!pCC->_isxmit())
+				{
+					if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+						pCC->m_Track.Event("ServeEpollST: Loop %u: Write event with nothin socket %u/%u", nLoop, cSock, pCC->CliPort()) ;
+					pCC->_wantWrite(false) ;
+				}
+
+				if (pCC->_isxmit())
+				{
+					pCC->m_Track.Event("ServeEpollST: Loop %u: Write event with output on socket %u/%u", nLoop, cSock, pCC->CliPort()) ;
+
+					xmitState = pCC->_xmit(tbuf) ;
+					if (xmitState < 0 || (!pCC->_isxmit() && pCC->m_bState & CLIENT_CLOSING))
+					{
+						if (xmitState < 0)
+							pCC->m_Track.Error("ServeEpollST: Loop %u: EPOLLOUT Write error, connection on socket %u/%u to be removed", nLoop, cSock, pCC->CliPort()) ;
+						pCC->Terminate() ;
+						m_Conns.Remove(cSock) ;
+						m_Conns.Release(pCC) ;
+						continue ;
+					}
+				}
+			}
+
+			if (eventAr[nSlot].events & EPOLLIN)
+			{
+				//	At this point we have data on the socket to be read
+
+				cSock = hzConnTable::Socket(eventAr[nSlot].data.u64) ;
+				pCC = m_Conns[cSock] ;
+				if (!pCC)
+				{
+					m_pLog->Log(_fn, "Loop %u: CORRUPT: Read event on socket %d/%d but no connector!\n", nLoop, cSock, pCC->CliPort()) ;
+					m_bShutdown = true ;
+					continue ;
+				}
+
+				if (cSock != pCC->CliSocket())
+				{
+					m_pLog->Log(_fn, "Loop %u slot %u: CORRUPT: Read event on sock %d/%d but attached client object has socket of %d\n",
+						nLoop, nSlot, cSock, pCC->CliPort(), pCC->CliSocket()) ;
+					m_bShutdown = true ;
+					continue ;
+				}
+
+				//	Now because we are in edge-triggered mode, continue reading from the socket until we get -1
+				for (nRecvTotal = 0 ;; nRecvTotal += nRecv)
+				{
+					nRecv = pCC->Recv(tbuf) ;
+					if (nRecv <= 0)
+						break ;
+				}
+
+				if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+				{
+					if (!pCC->IsCliTerm())
+						pCC->m_Track.Event("ServeEpollST: Loop %u: Client LIVE sock %u. Recv %u Have %u", nLoop, cSock, nRecvTotal, pCC->SizeIn()) ;
+					else
+						pCC->m_Track.Event("ServeEpollST: Loop %u: Client DONE sock %u. Revc %u Have %u", nLoop, cSock, nRecvTotal, pCC->SizeIn()) ;
+				}
+
+				//	Data to be processed has come in
+				if (!nRecvTotal)
+				{
+					pCC->m_Track.Event("ServeEpollST: Loop %u: Read event with zero data on socket %u - disconnecting", nLoop, cSock) ;
+					if (!pCC->_isxmit())
+					{
+						//	Nothing has come in and nothing is due to go out so clear off the connection
+						pCC->m_Track.Event("ServeEpollST: Loop %u: Terminating unused connection on socket %u", nLoop, cSock) ;
+						pCC->Terminate() ;
+						m_Conns.Remove(cSock) ;
+						m_Conns.Release(pCC) ;
+					}
+				}
+				else
+				{
+					if (pCC->MsgReady())
+						trc = pCC->_admit() ? pCC->m_OnIngress(pCC->InputZone(), pCC) : TCP_TERMINATE ;
+					else
+					{
+						pCC->m_Track.Event("ServeEpollST: Loop %u: NOTE: Client message not yet complete on socket %u/%u", nLoop, cSock, pCC->CliPort()) ;
+						trc = TCP_INCOMPLETE ;
+					}
+
+					switch (trc)
+					{
+					case TCP_TERMINATE:	//	Directive is to close after outgoing message is complete
+
+						if (pCC->_isxmit())
+						{
+							//	If outgoing data not complete, transmit some more.
+							xmitState = pCC->_xmit(tbuf) ;
+							if (xmitState < 0)
+							{
+								pCC->m_Track.Error("ServeEpollST: Loop %u: TCP_TERMINATE: Write error - Sock %u/%u doomed", nLoop, cSock, pCC->CliPort()) ;
+								pCC->Terminate() ;
+								m_Conns.Remove(cSock) ;
+								m_Conns.Release(pCC) ;
+								break ;
+							}
+						}
+
+						if (!pCC->_isxmit())
+						{
+							//	No longer any outgoing data so close
+							pCC->m_Track.Event("ServeEpollST: Loop %u: TCP_TERMINATE: Normal termination, sock %u/%u to be removed", nLoop, cSock, pCC->CliPort()) ;
+							pCC->Terminate() ;
+							m_Conns.Remove(cSock) ;
+							m_Conns.Release(pCC) ;
+							break ;
+						}
+
+						pCC->m_Track.Event("ServeEpollST: Loop %u: TCP_TERMINATE: Write delay - Sock %u/%u", nLoop, cSock, pCC->CliPort()) ;
+						pCC->m_bState |= CLIENT_CLOSING ;
+						break ;
+
+					case TCP_KEEPALIVE:	//	Directive is to keep open after outgoing message is complete
+
+						if (pCC->_isxmit())
+						{
+							xmitState = pCC->_xmit(tbuf) ;
+							if (xmitState < 0)
+							{
+								pCC->m_Track.Error("ServeEpollST: Loop %u: TCP_KEEPALIVE: Write error, sock %u/%u doomed", nLoop, cSock, pCC->CliPort()) ;
+								pCC->Terminate() ;
+								m_Conns.Remove(cSock) ;
+								m_Conns.Release(pCC) ;
+								break ;
+							}
+
+							if (xmitState > 0)
+							{
+								//	We have EAGAIN or EWOULDBLOCK and so now we make epoll entry to look for write event (when ocket becomes writable)
+								pCC->m_Track.Event("ServeEpollST: Loop %u: TCP_KEEPALIVE: Write delay - Sock %u/%u", nLoop, cSock, pCC->CliPort()) ;
+							}
+						}
+
+						if (pCC->IsCliTerm())
+						{
+							//	No longer any outgoing data so close
+							pCC->m_Track.Event("ServeEpollST: Loop %u: TCP_KEEPALIVE: Client terminated so sock %u/%u to be removed", nLoop, cSock, pCC->CliPort()) ;
+							pCC->Terminate() ;
+							m_Conns.Remove(cSock) ;
+							m_Conns.Release(pCC) ;
+							break ;
+						}
+
+						pCC->Oxygen() ;
+						break ;
+
+					case TCP_INCOMPLETE:	//	The message processor has indicated it is still waiting for more imput
+
+						//	The handler may nonetheless have queued output (e.g. an interim response)
+						if (pCC->_isxmit() && pCC->_xmit(tbuf) < 0)
+						{
+							pCC->Terminate() ;
+							m_Conns.Remove(cSock) ;
+							m_Conns.Release(pCC) ;
+							break ;
+						}
+
+						pCC->Oxygen() ;
+						break ;
+
+					case TCP_INVALID:		//	The message processor cannot dechipher the message. Kill the connection
+
+						pCC->m_Track.Error("ServeEpollST: Loop %u: Sock %u/%u INVALID TCP code", nLoop, cSock, pCC->CliPort()) ;
+						pCC->MetricError() ;
+						pCC->Terminate() ;
+						m_Conns.Remove(cSock) ;
+						m_Conns.Release(pCC) ;
+						break ;
+					}
+				}
+			}
+		}
+	}
+
+	threadLog("%s. SHUTDOWN COMPLETE\n", *_fn) ;
+}
+
+/*
+**	SECTION X:	io_uring Method (Single Threaded)
+*/
+
+#define	URING_ENTRIES	1024		//	Submission queue size
+#define	URING_BUFFERS	4096		//	Provided receive buffers (each of HZ_MAXPACKET bytes)
+#define	URING_LINKS		4			//	Maximum number of linked writes (each of up to HZ_URING_IOV packets) submitted per connection
+
+#define	URING_TAG		0x00ffffffffffffffULL	//	User data bits holding the connection tag (generation and socket)
+
+enum	hzUringOp
+{
+	//	Category:	Internet
+	//
+	//	Operation codes held in the top byte of the user data of each io_uring submission, so the serving loop can tell what a completion is for. The rest of
+	//	the user data is the connection tag, less the top 8 bits of the generation.
+
+	URING_OP_NONE,			//	Completion to be ignored
+	URING_OP_ACCEPT,		//	Multishot accept on a listening socket
+	URING_OP_RECV,			//	Multishot receive on a plain connection
+	URING_OP_POLLIN,		//	Multishot poll for readability on a TLS connection
+	URING_OP_POLLOUT,		//	Single poll for writability on a TLS connection
+	URING_OP_SEND,			//	Write of outgoing data (not the last of a linked set)
+	URING_OP_SENDLAST,		//	Write of outgoing data (the last of a linked set)
+	URING_OP_SOURCE,		//	Single poll for readability on the socket of an output source
+	URING_OP_CANCEL			//	Cancellation of the operations on a connection being closed
+} ;
+
+static	inline	uint64_t	_uring_data	(uint32_t nOp, uint64_t nTag)	{ return ((uint64_t) nOp << 56) | (nTag & URING_TAG) ; }
+
+static	struct io_uring_sqe*	_uring_sqe	(void)
+{
+	//	Obtain a submission queue entry, passing those already prepared to the kernel if the queue is full
+	//
+	//	Arguments:	None
+	//	Returns:	Pointer to the SQE
+
+	struct io_uring_sqe*	pSqe ;	//	Submission entry
+
+	pSqe = s_pUring->GetSqe() ;
+	if (!pSqe)
+	{
+		s_pUring->Submit(0, 0) ;
+		pSqe = s_pUring->GetSqe() ;
+	}
+	if (!pSqe)
+		Fatal("_uring_sqe: Submission queue remains full\n") ;
+	return pSqe ;
+}
+
+static	inline	struct io_uring_sqe*	_uring_sqe	(uint32_t& nInFlight)
+{
+	//	Obtain a submission queue entry for an operation on a connection, counting the operation as in flight on the connection until its final completion
+	//
+	//	Arguments:	1)	nInFlight	The count of operations in flight on the connection
+	//
+	//	Returns:	Pointer to the SQE
+
+	nInFlight++ ;
+	return _uring_sqe() ;
+}
+
+void	hzIpServer::_uringArm	(hzIpConnex* pCC)
+{
+	//	Submit the standing read operation for a connection. For plain connections this is a multishot receive into the provided buffers. For TLS connections
+	//	the data must pass through the SSL library so the kernel only reports readability, with a multishot poll, and the data is read by Recv().
+	//
+	//	Arguments:	1)	pCC		The connection
+	//
+	//	Returns:	None
+
+	if (pCC->IsRemoved())
+		return ;
+
+	if (pCC->IsSecure())
+		s_pUring->PrepPoll(_uring_sqe(pCC->m_nUring), pCC->CliSocket(), POLLIN | POLLRDHUP, true, _uring_data(URING_OP_POLLIN, pCC->EventTag())) ;
+	else
+		s_pUring->PrepRecvMulti(_uring_sqe(pCC->m_nUring), pCC->CliSocket(), _uring_data(URING_OP_RECV, pCC->EventTag())) ;
+}
+
+void	hzIpServer::_uringFlush	(hzIpConnex* pCC)
+{
+	//	Start the writing of any outgoing data on a connection. For plain connections, the outgoing packets are written by up to URING_LINKS vectored writes,
+	//	linked so the kernel performs them in order. Only the last of these is marked as such, so that on its completion the loop can submit the next set or
+	//	close the connection. Only one set of writes is in flight per connection at any one time (indicated by CLIENT_WRITING).
+	//
+	//	For TLS connections the data is written by _xmit() as with ServeEpollST() and should the socket not accept it all, a poll for writability is submitted.
+	//
+	//	Where there is nothing to write as the output source is waiting on its socket, a poll for readability of that socket is submitted instead. This counts
+	//	as a write in flight (CLIENT_WRITING) as on its completion the output is resumed.
+	//
+	//	Arguments:	1)	pCC		The connection
+	//
+	//	Returns:	None
+
+	_hzfunc("hzIpServer::_uringFlush") ;
+
+	struct iovec			iov[HZ_URING_IOV * URING_LINKS] ;	//	Outgoing data
+	struct io_uring_sqe*	pSqe ;								//	Submission entry
+	hzPacket				tbuf ;								//	Packet buffer (for _xmit)
+	uint32_t				nIov ;								//	Total iovecs
+	uint32_t				nPart ;								//	Iovecs in this write
+	uint32_t				nDone ;								//	Iovecs in writes so far
+	int32_t					xmitState ;							//	Return from _xmit()
+
+	if (pCC->m_bState & (CLIENT_WRITING | CLIENT_REMOVED))
+		return ;
+
+	if (!pCC->_isxmit())
+	{
+		if (pCC->m_bState & CLIENT_CLOSING || pCC->IsCliBad())
+			_uringClose(pCC) ;
+		return ;
+	}
+
+	if (pCC->IsSecure() && !pCC->IsKtls())
+	{
+		xmitState = pCC->_xmit(tbuf) ;
+		if (xmitState < 0)
+			{ pCC->m_Track.Error("_uringFlush: Write error, connection on socket %u/%u to be removed", pCC->CliSocket(), pCC->CliPort()) ; _uringClose(pCC) ; return ; }
+
+		if (xmitState > 0)
+		{
+			pCC->m_bState |= CLIENT_WRITING ;
+			if (pCC->m_bState & CLIENT_WANTSRC && !pCC->m_Outgoing.Size())
+				s_pUring->PrepPoll(_uring_sqe(pCC->m_nUring), pCC->m_nSrcSock, POLLIN, false, _uring_data(URING_OP_SOURCE, pCC->EventTag())) ;
+			else
+				s_pUring->PrepPoll(_uring_sqe(pCC->m_nUring), pCC->CliSocket(), POLLOUT, false, _uring_data(URING_OP_POLLOUT, pCC->EventTag())) ;
+			return ;
+		}
+
+		if (pCC->m_bState & CLIENT_CLOSING)
+			_uringClose(pCC) ;
+		return ;
+	}
+
+	//	Top up the outgoing queue if the response is drawn from an output source
+	if (pCC->_refill() < 0)
+		{ _uringClose(pCC) ; return ; }
+
+	nIov = pCC->_xmitPrep(iov, HZ_URING_IOV * URING_LINKS) ;
+	if (!nIov)
+	{
+		if (pCC->m_bState & CLIENT_WANTSRC)
+		{
+			pCC->m_bState |= CLIENT_WRITING ;
+			s_pUring->PrepPoll(_uring_sqe(pCC->m_nUring), pCC->m_nSrcSock, POLLIN, false, _uring_data(URING_OP_SOURCE, pCC->EventTag())) ;
+		}
+		return ;
+	}
+
+	for (nDone = 0 ; nDone < nIov ; nDone += nPart)
+	{
+		nPart = nIov - nDone ;
+		if (nPart > HZ_URING_IOV)
+			nPart = HZ_URING_IOV ;
+
+		pSqe = _uring_sqe(pCC->m_nUring) ;
+		memcpy(s_pUring->SqeIov(pSqe), iov + nDone, nPart * sizeof(struct iovec)) ;
+
+		if ((nDone + nPart) < nIov)
+		{
+			s_pUring->PrepWritev(pSqe, pCC->CliSocket(), nPart, _uring_data(URING_OP_SEND, pCC->EventTag())) ;
+			pSqe->flags |= IOSQE_IO_LINK ;
+		}
+		else
+			s_pUring->PrepWritev(pSqe, pCC->CliSocket(), nPart, _uring_data(URING_OP_SENDLAST, pCC->EventTag())) ;
+	}
+
+	pCC->m_bState |= CLIENT_WRITING ;
+}
+
+void	hzIpServer::_uringClose	(hzIpConnex* pCC)
+{
+	//	Close a connection by cancelling all operations pending on it. The connection cannot be terminated and released at this point as operations still in
+	//	flight refer to it, and writes refer to its outgoing data. So it is marked as removed and remains in the connection table until the completions of
+	//	all its operations (including those of the cancellations) have arrived, whereupon the serving loop calls _uringFree(). Calls on a connection already
+	//	removed have no effect.
+	//
+	//	Arguments:	1)	pCC		The connection
+	//
+	//	Returns:	None
+
+	uint32_t	cSock ;		//	Client socket
 
-	_loris	()	{ port = 0 ; }
+	if (pCC->IsRemoved())
+		return ;
+	pCC->m_bState |= CLIENT_REMOVED ;
 
-	bool	operator<	(const _loris op) const
-	{
-		if (port < op.port)	return true ;
-		if (port > op.port)	return false ;
-		if (ip > op.ip)		return false ;
-		return true ;
-	}
+	//	The connection can no longer expire
+	if (pCC->m_Timer.m_pWheel)
+		pCC->m_Timer.m_pWheel->Cancel(&pCC->m_Timer) ;
 
-	bool	operator>	(const _loris op) const
+	cSock = pCC->CliSocket() ;
+	if (pCC->m_nUring)
 	{
-		if (port > op.port)	return true ;
-		if (port < op.port)	return false ;
-		if (ip < op.ip)		return false ;
-		return true ;
+		s_pUring->PrepCancelFd(_uring_sqe(pCC->m_nUring), cSock, _uring_data(URING_OP_CANCEL, pCC->EventTag())) ;
+		if (pCC->m_nSrcSock)
+			s_pUring->PrepCancelFd(_uring_sqe(pCC->m_nUring), pCC->m_nSrcSock, _uring_data(URING_OP_CANCEL, pCC->EventTag())) ;
+		return ;
 	}
-} ;
 
-hzMapS<_loris,uint32_t>	s_black ;	//	Monitor for slow lorris attacks
+	_uringFree(pCC) ;
+}
 
-static	bool	_ipcheck	(const char* addr, uint32_t port)
+void	hzIpServer::_uringFree	(hzIpConnex* pCC)
 {
-	_loris		I ;		//	Client IP address and connected port
-	uint32_t	t ;		//	Time of last connect
-	uint32_t	x ;		//	Time before next connection allowed
+	//	Terminate and release a connection closed by _uringClose(), once no io_uring operations remain in flight on it
+	//
+	//	Arguments:	1)	pCC		The connection
+	//
+	//	Returns:	None
 
-	I.ip = addr ;
-	I.port = port ;
-	t = time(0) ;
+	uint32_t	cSock ;		//	Client socket
 
-	if (s_black.Exists(I))
+	cSock = pCC->CliSocket() ;
+	pCC->Terminate() ;
+	m_Conns.Remove(cSock) ;
+	m_Conns.Release(pCC) ;
+}
+
+void	hzIpServer::_uringIngress	(hzIpConnex* pCC)
+{
+	//	Process data that has come in on a connection. This calls the OnIngress function (if the message is ready) and acts on the directive returned, as is
+	//	done in ServeEpollST(), except that outgoing data is handed to _uringFlush() rather than written directly.
+	//
+	//	Arguments:	1)	pCC		The connection
+	//
+	//	Returns:	None
+
+	_hzfunc("hzIpServer::_uringIngress") ;
+
+	hzTcpCode	trc ;		//	Return code
+
+	if (pCC->IsRemoved())
+		return ;
+
+	if (pCC->MsgReady())
+		trc = pCC->_admit() ? pCC->m_OnIngress(pCC->InputZone(), pCC) : TCP_TERMINATE ;
+	else
 	{
-		x = s_black[I] ;
-		x -= 15 ;
-		return x <= t ? true : false ;
+		pCC->m_Track.Event("_uringIngress: NOTE: Client message not yet complete on socket %u/%u", pCC->CliSocket(), pCC->CliPort()) ;
+		trc = TCP_INCOMPLETE ;
 	}
 
-	s_black.Insert(I,t) ;
-	return false ;
-}
+	//	The handler may have called SendKill()
+	if (pCC->IsCliBad())
+		{ _uringClose(pCC) ; return ; }
 
-/*
-**	SECTION X:	Epoll Method (Single Threaded)
-*/
+	switch (trc)
+	{
+	case TCP_TERMINATE:		//	Directive is to close after outgoing message is complete
+		pCC->m_bState |= CLIENT_CLOSING ;
+		_uringFlush(pCC) ;
+		break ;
 
-#define MAXEVENTS	100
+	case TCP_KEEPALIVE:		//	Directive is to keep open after outgoing message is complete
+		if (pCC->IsCliTerm())
+		{
+			pCC->m_Track.Event("_uringIngress: TCP_KEEPALIVE: Client terminated so sock %u/%u to be removed", pCC->CliSocket(), pCC->CliPort()) ;
+			pCC->m_bState |= CLIENT_CLOSING ;
+		}
+		pCC->Oxygen() ;
+		_uringFlush(pCC) ;
+		break ;
 
-hzIpConnex*	currCC[2000] ;		//	Connected clients
+	case TCP_INCOMPLETE:	//	The message processor has indicated it is still waiting for more imput
+		pCC->Oxygen() ;
+		if (pCC->_isxmit())
+			_uringFlush(pCC) ;
+		break ;
 
-void	hzIpServer::ServeEpollST	(void)
+	case TCP_INVALID:		//	The message processor cannot dechipher the message. Kill the connection
+		pCC->m_Track.Error("_uringIngress: Sock %u/%u INVALID TCP code", pCC->CliSocket(), pCC->CliPort()) ;
+		pCC->MetricError() ;
+		_uringClose(pCC) ;
+		break ;
+	}
+}
+
+void	hzIpServer::ServeUring	(void)
 {
 	//	Category:	Internet Server
 	//
-	//	This is executed in a single thread and acts as server using epoll in edge-triggered mode. The thread must be dedicated for the purpose as it is blocked
-	//	if there is no incoming requests to contend with. In edge-triggered mode, notification that a socket has data to be read, is only given at the point the
-	//	data arrives and so must always be read in full.
+	//	This is executed in a single thread and acts as server using io_uring. As with ServeEpollST(), the thread must be dedicated for the purpose.
+	//
+	//	Each listening socket has a multishot accept and each plain connection a multishot receive, so these operations are submitted once and thereafter post
+	//	a completion for each new connection or each buffer of data received. The data is received into a ring of provided buffers, each the size of a hzChain
+	//	block, from which it is appended to the input chain of the connection before the buffer is returned to the ring. Responses are written by vectored
+	//	writes directly from the packets of the outgoing queue. All submissions made while processing one batch of completions are passed to the kernel in the
+	//	same io_uring_enter call that waits for the next batch, so the number of system calls no longer rises with the number of reads and writes.
+	//
+	//	TLS connections are handled by polling for readiness, with the handshake, reads and writes performed by the SSL library as in ServeEpollST(). Session
+	//	ports are supported (the connection is handed to a thread as before) but UDP ports are not.
 	//
 	//	Arguments:	None
 	//
@@ -1550,654 +4584,391 @@ void	hzIpServer::ServeEpollST	(void)
 	//
 	//	Note:		Call only once for all listening sockets! This function will not return until the server is shut down
 
-	_hzfunc("hzIpServer::ServeEpollST") ;
-
-	//	Here we stay in a loop consiting of three stages:-
-	//	1)	Setup all array of all active entities for the epoll system call
-	//	2)	Call epoll to wait for something to come in.
-	//	3)	Go through all active entries to see which one recieved a message
+	_hzfunc("hzIpServer::ServeUring") ;
 
-	hzMapS	<hzIpaddr,hzIpConnex*>		udpClients ;	//	Map of UDP clients by IP address
-	hzMapS	<uint32_t,hzIpConnex*>		ConnInError ;	//	Map of TCP clients in error
 	hzMapS	<uint32_t,hzTcpListen*>		Listen ;		//	Listening sockets map
 	hzList	<hzTcpListen*>::Iter		I ;				//	Listening sockets iterator
 
-	struct epoll_event	eventAr[MAXEVENTS] ;			//	Epoll event array
-	struct epoll_event	epEventNew ;					//	Epoll event for new connections
+	hzUring			ring ;				//	The io_uring instance
+	hzTimerWheel	wheel ;				//	Connection expiry timers
+	hzTimer*		pTm ;				//	Expired timer
+	hzTimer*		pTmNext ;			//	Next expired timer
 
-	hzPacket		tbuf ;				//	Fixed buffer for single IP packet
+	struct io_uring_cqe*	pCqe ;		//	Completion entry
+	hzPacket		tbuf ;				//	Fixed buffer for single IP packet (TLS reads)
 	SOCKADDR		cliAddr ;			//	Client address
-	SOCKADDRIN		cliAddrIn ;			//	Client address
 	socklen_t		cliLen ;			//	Client address length
 	hzTcpListen*	pLS ;				//	Listening socket
 	hzIpConnex*		pCC ;				//	Connected client
 	SSL*			pSSL ;				//	SSL session (if applicable)
- 	X509*			client_cert ;		//	Client certificate
 	hzProcInfo		proc_data ;			//	Process data (Client socket & IP address, must be destructed by the called thread function)
-	char*			clicert_str ;		//	Client certificate string
-	hzIpinfo*		ipi ;				//	IP address for testing against black/white lists
+	uint32_t		nAttempts ;			//	Connection attempts by a blocked IP address
 	hzXDate			now ;				//	Time now (used to log connections)
 	pthread_attr_t	tattr ;				//	Thread attribute (to support thread invokation)
 	pthread_t		tid ;				//	Needed for multi-threading
-	timeval			tv ;				//	Time limit for epoll call
-	uint64_t		nsThen ;			//	Before the wait
-	uint64_t		nsNow ;				//	After the wait
+	uint64_t		nsNow ;				//	Time now
+	uint64_t		nData ;				//	User data of completion
+	uint64_t		nTag ;				//	Connection tag
 	hzIpaddr		ipa ;				//	IP address
 	uint32_t		nCliSeq ;			//	Client connection id allocator
-	uint32_t		nLoop ;				//	Number of times round the epoll event loop
-	uint32_t		nSlot ;				//	Connections iterator
-	uint32_t		nEpollEvents ;		//	Result of the epoll call
-	uint32_t		nError ;			//	Errno of the epoll call
-	uint32_t		cSock ;				//	Client socket (from accept)
-	uint32_t		cPort ;				//	Client socket (from accept)
-	uint32_t		prc ;				//	Return from pthread_create
+	uint32_t		nLoop ;				//	Number of times round the event loop
+	uint32_t		nOp ;				//	Operation of completion
+	uint32_t		nFlags ;			//	Flags of completion
+	uint32_t		cSock ;				//	Client socket
+	uint32_t		cPort ;				//	Client port
 	uint32_t		nBannedAttempts ;	//	Connection attempts by blocked IP address
-	int32_t			aSock ;				//	Client socket (validated)
-	int32_t			flags ;				//	Flags to mak socket non-blocking
-	int32_t			nRecv ;				//	No bytes read from client socket after epoll (in one read)
-	int32_t			nRecvTotal ;		//	No bytes read from client socket after epoll (in a series of reads)
+	int32_t			nRes ;				//	Result of completion
+	int32_t			nRecv ;				//	Bytes read (TLS)
+	int32_t			nRecvTotal ;		//	Bytes read (TLS)
+	int32_t			nWait ;				//	Wait limit (milliseconds until next connection deadline)
+	int32_t			flags ;				//	Socket flags
 	int32_t			sys_rc ;			//	Return from system library calls
-	int32_t			xmitState ;			//	Return from _xmit() call
-	hzTcpCode		trc ;				//	Return code
-	char			sbuf[24] ;			//	Client IP address textform buffer
+	hzHandshake		hsr ;				//	Return from TLS handshake
+	char			sbuf[24] ;			//	Client port textform buffer
 	char			ipbuf[44] ;			//	Client IP address textform buffer
 
-	//	Pre-define thread attributes
 	pthread_attr_init(&tattr) ;
 	pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED) ;
 
-	//	Set list default
-	//Listen.SetDefaultObj((hzTcpListen*)0) ;
-
-	//	Init connected client regime
-	for (nSlot = 0 ; nSlot < 1024 ; nSlot++)
-		currCC[nSlot] = 0 ;
-	cliLen = sizeof(cliAddrIn) ;
+	//	Init connected client regime and the ring
+	if (m_Conns.Init(m_pLog) != E_OK)
+		Fatal("%s. Could not allocate connection table\n", *_fn) ;
 
-	//	Create epoll socket and and listening sockets to the controller
-	epollSocket = epoll_create1(0) ;
-	if (epollSocket == -1)
-		Fatal("%s. Could not create epoll socket\n", *_fn) ;
-	m_pLog->Log(_fn, "Epoll socket is %d\n", epollSocket) ;
+	if (ring.Init(URING_ENTRIES, URING_BUFFERS) != E_OK)
+		Fatal("%s. Could not create io_uring instance\n", *_fn) ;
+	s_pUring = &ring ;
+	m_pLog->Log(_fn, "io_uring is %d\n", ring.Fd()) ;
 
 	for (I = m_LS ; I.Valid() ; I++)
 	{
 		pLS = I.Element() ;
 
-		epEventNew.data.fd = pLS->GetSocket() ;
-		epEventNew.events = EPOLLIN ;	//| EPOLLET ;
-		if (epoll_ctl(epollSocket, EPOLL_CTL_ADD, pLS->GetSocket(), &epEventNew) < 0)
-			Fatal("%s. Could not add listening socket %d to the epoll controller\n", *_fn, pLS->GetSocket()) ;
-
-		m_pLog->Log(_fn, "Added listening socket is %d\n", pLS->GetSocket()) ;
-		Listen.Insert(pLS->GetSocket(), pLS) ;
-	}
-
-	//	Main loop - waiting for events
-	nLoop = nCliSeq = nBannedAttempts = 0 ;
-
-	for (;;)
-	{
-		//	Check for shutdown condition
-		if (m_bShutdown)
-		{
-			//	Check for outstanding connections
-			for (nSlot = 0 ; nSlot < 1024 ; nSlot++)
-			{
-				if (currCC[nSlot])
-					break ;
-			}
-
-			if (nSlot == 1024)
-				break ;
-		}
-
-		//	Check for expired connections
-		for (nSlot = 0 ; nSlot < ConnInError.Count() ; nSlot++)
-		{
-			pCC = ConnInError.GetObj(nSlot) ;
-		}
-
-		//	Wait for events
-		nsThen = RealtimeNano() ;
-		nEpollEvents = epoll_wait(epollSocket, eventAr, MAXEVENTS, 60000) ;
-		nsNow = RealtimeNano() ;
-		nLoop++ ;
-
-		if (!nEpollEvents)
-			m_pLog->Log(_fn, "No action\n") ;
-
-		for (nSlot = 0 ; nSlot < nEpollEvents ; nSlot++)
+		if (pLS->UseUDP())
 		{
-			if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-			{
-				if (nSlot)
-					m_pLog->Log(_fn, "Loop %u slot %u: Event on socket %d\n", nLoop, nSlot, eventAr[nSlot].data.fd) ;
-				else
-					m_pLog->Log(_fn, "Loop %u: Waited %lu nanoseconds for %d events: 1st sock %u\n", nLoop, nsNow - nsThen, nEpollEvents, eventAr[0].data.fd) ;
-			}
-
-			/*
-			**	Check for hangups and other connection errors
-			*/
-
-			if (eventAr[nSlot].events & EPOLLHUP)
-			{
-				//	Hangup signal
-				cSock = eventAr[nSlot].data.fd ;
-				pCC = currCC[cSock] ;
-				nError = 0 ;
-
-				if (!pCC)				{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: HANGUP CORRUPT Sock %d No connector\n", nLoop, nSlot, cSock) ; continue ; }
-				if (!pCC->CliSocket())	{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: HANGUP CORRUPT Sock %d Connector defunct\n", nLoop, nSlot, cSock) ; continue ; }
-
-				if (getsockopt(cSock, SOL_SOCKET, SO_ERROR, (void *)&nError, &cliLen) == 0)
-					pCC->m_Track.Printf("Loop %u slot %u: HANGUP on socket %d (%s)\n", nLoop, nSlot, cSock, strerror(nError)) ;
-				else
-					pCC->m_Track.Printf("Loop %u slot %u: HANGUP on socket %d (no details)\n", nLoop, nSlot, cSock) ;
-			}
-
-			if (eventAr[nSlot].events & EPOLLERR)
-			{
-				//	An error has occured on this fd, or the socket is not ready for reading
-				cSock = eventAr[nSlot].data.fd ;
-				pCC = currCC[cSock] ;
-				nError = 0 ;
-
-				if (!pCC)				{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: EPOLLERR CORRUPT Sock %d No connector\n", nLoop, nSlot, cSock) ; continue ; }
-				if (!pCC->CliSocket())	{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: EPOLLERR CORRUPT Sock %d Connector defunct\n", nLoop, nSlot, cSock) ; continue ; }
-
-				if (getsockopt(cSock, SOL_SOCKET, SO_ERROR, (void *)&nError, &cliLen) == 0)
-					pCC->m_Track.Printf("Loop %u slot %u: EPOLLERR on socket %d (%s)\n", nLoop, nSlot, cSock, strerror(nError)) ;
-				else
-					pCC->m_Track.Printf("Loop %u slot %u: EPOLLERR on socket %d (no details)\n", nLoop, nSlot, cSock) ;
-			}
-
-			/*
-			**	Check for events on listening sockets
-			*/
-
-			if (Listen.Exists(eventAr[nSlot].data.fd))
-			{
-				//	We have a notification on the listening socket so either a new incoming connection or if the listening socket is UDP, an incoming UDP packet.
-
-				pLS = Listen[eventAr[nSlot].data.fd] ;
-				pSSL = 0 ;
-
-				if (pLS->UseUDP())
-				{
-					/*
-					**	Packet is UDP
-					*/
-
-					cSock = pLS->GetSocket() ;
-					flags = fcntl(pLS->GetSocket(), F_GETFL, 0) ;
-					if (flags == -1)
-					{
-						m_pLog->Log(_fn, "UDP: Loop %u: NOTE: Could not make client socket %d non blocking (case 1)\n", nLoop, pLS->GetSocket()) ;
-						if (close(pLS->GetSocket()) < 0)
-							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after non_block_fail(1) errno=%d\n", nLoop, pLS->GetSocket(), errno) ;
-						continue ;
-					}
-					flags |= O_NONBLOCK ;
-					if (fcntl(pLS->GetSocket(), F_SETFL, flags) == -1)
-					{
-						m_pLog->Log(_fn, "UDP: Loop %u: NOTE: Could not make client socket %d non blocking (case 2)\n", nLoop, pLS->GetSocket()) ;
-						if (close(pLS->GetSocket()) < 0)
-							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after non_block_fail(2) errno=%d\n", nLoop, pLS->GetSocket(), errno) ;
-						continue ;
-					}
-
-					if ((nRecv = recvfrom(pLS->GetSocket(), tbuf.m_data, HZ_MAXPACKET, 0, (SOCKADDR*) &cliAddr, &cliLen)) < 0)
-					{
-						m_pLog->Log(_fn, "UDP: Loop %u: NOTE: Could not read from UDP client\n", nLoop) ;
-						continue ;
-					}
-
-					ipa = (uint32_t) cliAddrIn.sin_addr.s_addr ;
-					cPort = ntohs(cliAddrIn.sin_port) ;
-					tbuf.m_data[nRecv] = 0 ;
-
-					pCC = udpClients[ipa] ;
-					if (!pCC)
-					{
-						pCC = new hzIpConnex(m_pLog) ;
-						udpClients.Insert(ipa, pCC) ;
-
-						//	Initialize and oxygenate the connection
-						pCC->Initialize(pLS, pSSL, ipbuf, cSock, cPort, nCliSeq++) ;
-						if (pCC->m_OnConnect)
-							pCC->m_OnConnect(pCC) ;
-					}
-
-					m_pLog->Out("Received UDP message %s from port %d internet address %s\n", tbuf.m_data, cPort, *ipa.Str()) ;
-
-					if (pCC->MsgReady())
-						trc = pCC->m_OnIngress(pCC->InputZone(), pCC) ;
-					else
-						trc = TCP_INCOMPLETE ;
-
-					switch (trc)
-					{
-					case TCP_TERMINATE:
-
-						if (pCC->_isxmit())
-						{
-							//	If outgoing data not complete, transmit some more.
-							xmitState = pCC->_xmit(tbuf) ;
-							if (xmitState < 0)
-							{
-								m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_TERMINATE: Write error - Sock %d/%d to be removed\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
-								pCC->Terminate() ;
-								udpClients.Delete(ipa) ;
-								delete pCC ;
-								break ;
-							}
+			m_pLog->Log(_fn, "NOTE: UDP socket %d (port %d) is not served by this method\n", pLS->GetSocket(), pLS->GetPort()) ;
+			continue ;
+		}
 
-							if (xmitState > 0)
-							{
-								//	We have EAGAIN or EWOULDBLOCK and so now we make epoll entry to look for write event (when ocket becomes writable)
-								m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_TERMINATE: Write delay - Sock %d /%d, looking for write event\n",
-									nLoop, nSlot, cSock, pCC->CliPort()) ;
-								break ;
-							}
-						}
-	
-						//	No more outgoing data so close
-						m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_TERMINATE: Normal termination, sock %d/%d to be removed\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
-						pCC->Terminate() ;
-						udpClients.Delete(ipa) ;
-						delete pCC ;
-						break ;
+		s_pUring->PrepAcceptMulti(_uring_sqe(), pLS->GetSocket(), _uring_data(URING_OP_ACCEPT, pLS->GetSocket())) ;
+		m_pLog->Log(_fn, "Added listening socket is %d\n", pLS->GetSocket()) ;
+		Listen.Insert(pLS->GetSocket(), pLS) ;
+	}
 
-					case TCP_KEEPALIVE:
+	//	Output queued by the handlers is submitted on return from them
+	s_bServing = true ;
 
-						m_pLog->Log(_fn, "UDP: Client %d SERVER - data processed, awaiting further messages\n", pCC->EventNo()) ;
-						pCC->Oxygen() ;
-						if (pCC->_isxmit())
-						{
-							xmitState = pCC->_xmit(tbuf) ;
-							if (xmitState < 0)
-							{
-								m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_KEEPALIVE: Write error, sock %d/%d to be removed\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
-								pCC->Terminate() ;
-								udpClients.Delete(ipa) ;
-								delete pCC ;
-								break ;
-							}
+	//	Main loop - waiting for completions
+	nLoop = nCliSeq = nBannedAttempts = 0 ;
+	wheel.Init(RealtimeNano()) ;
 
-							if (xmitState > 0)
-							{
-								//	We have EAGAIN or EWOULDBLOCK and so now we make epoll entry to look for write event (when ocket becomes writable)
-								m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_KEEPALIVE: Write delay - Sock %d/%d retained\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
-								break ;
-							}
+	for (;;)
+	{
+		//	Check for shutdown condition
+		if (m_bShutdown && !m_Conns.Count())
+			break ;
 
-							//	We have xmitState of 0 which means the message was written in full to the socket
-							m_pLog->Log(_fn, "UDP: Loop %u slot %u: TCP_KEEPALIVE: Write OK, sock %d/%d retained\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
-						}
+		//	Expire connections whose deadlines have passed (as in ServeEpollST)
+		nsNow = RealtimeNano() ;
+		for (pTm = wheel.Expire(nsNow) ; pTm ; pTm = pTmNext)
+		{
+			pTmNext = pTm->m_pNext ;
+			pCC = (hzIpConnex*) pTm->m_pObj ;
 
-						if (pCC->IsCliTerm())
-						{
-							//	No longer any incoming requests and as we have finished writing, close
-							m_pLog->Log(_fn, "UDP: Loop %u loop %u: TCP_KEEPALIVE: Client done so sock %d/%d to be removed\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
-							pCC->Terminate() ;
-							udpClients.Delete(ipa) ;
-							delete pCC ;
-							break ;
-						}
-						break ;
+			if (nsNow < pCC->Deadline())
+				{ wheel.Arm(pTm, pCC->Deadline()) ; continue ; }
 
-					case TCP_INCOMPLETE:
+			cSock = pCC->CliSocket() ;
 
-						m_pLog->Log(_fn, "UDP: Client %d SERVER - data incomplete\n", pCC->EventNo()) ;
-						pCC->Oxygen() ;
-						break ;
+			if (pCC->IsHandshake())
+				{ __atomic_add_fetch(&m_nTlsExpired, 1, __ATOMIC_RELAXED) ; pCC->m_Track.Error("ServeUring: Loop %u: TLS handshake time limit exceeded on socket %u/%u - removed", nLoop, cSock, pCC->CliPort()) ; }
+			else if (pCC->_isxmit())
+				{ m_nExpWrite++ ; pCC->m_Track.Error("ServeUring: Loop %u: Response stalled on socket %u/%u - removed", nLoop, cSock, pCC->CliPort()) ; }
+			else if (pCC->SizeIn())
+				{ m_nExpRead++ ; pCC->m_Track.Error("ServeUring: Loop %u: Request incomplete on socket %u/%u - removed", nLoop, cSock, pCC->CliPort()) ; }
+			else if (pCC->m_OnIdle && pCC->m_OnIdle(pCC) == TCP_KEEPALIVE)
+			{
+				//	Idle function has queued output (such as a WebSocket ping) to keep the connection open
+				_uringFlush(pCC) ;
+				if (!pCC->IsRemoved())
+					wheel.Arm(pTm, pCC->Deadline()) ;
+				continue ;
+			}
+			else
+				{ m_nExpIdle++ ; pCC->m_Track.Event("ServeUring: Loop %u: Connection idle on socket %u/%u - removed", nLoop, cSock, pCC->CliPort()) ; }
 
-					case TCP_INVALID:		//	The message processor cannot dechipher the message. Kill the connection
+			pCC->MetricExpired() ;
+			_uringClose(pCC) ;
+		}
 
-						if (m_pLog)
-							m_pLog->Log(_fn, "UDP: Loop %u: Sock %d/%d INVALID TCP code\n", nLoop, cSock, pCC->CliPort()) ;
-						pCC->Terminate() ;
-						udpClients.Delete(ipa) ;
-						delete pCC ;
-						break ;
-					}
+		//	Submit everything prepared since the last time round and wait for completions
+		nWait = wheel.NextTimeout(RealtimeNano()) ;
+		if (nWait < 0 || nWait > 60000)
+			nWait = 60000 ;
+		if (s_pUring->Submit(1, nWait) < 0)
+			Fatal("%s. io_uring_enter failed (%s)\n", *_fn, strerror(errno)) ;
+		nLoop++ ;
 
-					continue ;
-					//	End of UDP section
-				}
+		for (; (pCqe = s_pUring->PeekCqe()) ;)
+		{
+			nData = pCqe->user_data ;
+			nRes = pCqe->res ;
+			nFlags = pCqe->flags ;
+			s_pUring->SeenCqe() ;
 
-				/*
-				**	Now the TCP case: Firstly accept the client no matter what, if there is a problem close the connection.
-				*/
+			nOp = (uint32_t) (nData >> 56) ;
+			nTag = nData & URING_TAG ;
+			cSock = hzConnTable::Socket(nTag) ;
 
-				aSock = accept(pLS->GetSocket(), &cliAddr, &cliLen) ;
-				if (aSock < 0)
-				{
-					m_pLog->Log(_fn, "Loop %u: NOTE: Listening socket %d ignored client on port %d\n", nLoop, pLS->GetSocket(), pLS->GetPort()) ;
+			if (nOp == URING_OP_NONE)
+				continue ;
 
-					if (errno && errno != EAGAIN && errno != EWOULDBLOCK)
-					{
-						m_bShutdown = true ;
-						m_pLog->Log(_fn, "Loop %u: SHUTDOWN: Listening socket %d failure: Port %d (errno=%d)\n", nLoop, pLS->GetSocket(), pLS->GetPort(), errno) ;
-					}
+			/*
+			**	New connections
+			*/
+
+			if (nOp == URING_OP_ACCEPT)
+			{
+				pLS = Listen[cSock] ;
+
+				//	The accept remains armed unless the kernel says otherwise
+				if (!(nFlags & IORING_CQE_F_MORE) && !m_bShutdown)
+					s_pUring->PrepAcceptMulti(_uring_sqe(), pLS->GetSocket(), _uring_data(URING_OP_ACCEPT, pLS->GetSocket())) ;
+
+				if (nRes < 0)
+				{
+					m_pLog->Log(_fn, "Loop %u: NOTE: Listening socket %d ignored client on port %d (%s)\n", nLoop, pLS->GetSocket(), pLS->GetPort(), strerror(-nRes)) ;
 					continue ;
 				}
 
-				sys_rc = getnameinfo(&cliAddr, cliLen, ipbuf, 24, sbuf, 24, NI_NUMERICHOST | NI_NUMERICSERV) ;
-                if (sys_rc)
+				cSock = nRes ;
+				pSSL = 0 ;
+
+				cliLen = sizeof(cliAddr) ;
+				if (getpeername(cSock, &cliAddr, &cliLen) < 0
+						|| getnameinfo(&cliAddr, cliLen, ipbuf, 24, sbuf, 24, NI_NUMERICHOST | NI_NUMERICSERV))
 				{
-					m_pLog->Log(_fn, "Loop %u: Accepted connection on socket %d port %d but no name info - closing connection\n", nLoop, aSock, pLS->GetPort()) ;
-					if (close(cSock) < 0)
-						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after name info fail. errno=%d\n", nLoop, cSock, errno) ;
+					m_pLog->Log(_fn, "Loop %u: Accepted connection on socket %d port %d but no name info - closing connection\n", nLoop, cSock, pLS->GetPort()) ;
+					close(cSock) ;
 					continue ;
 				}
 
-				cSock = aSock ;
 				cPort = atoi(sbuf) ;
 				ipa = ipbuf ;
 
-				//	Check if client is blocked. Note this does not work when connections are coming via Apache proxypass because getnameinfo will give the IP address as 127.0.0.1
-				if (_hzGlobal_StatusIP.Exists(ipa))
+				//	Check if client is blocked
+				if (_hzGlobal_StatusIP.Blocked(ipa, &nAttempts))
 				{
-					ipi = &(_hzGlobal_StatusIP[ipa]) ;
-
-					if (!(ipi->m_bInfo & HZ_IPSTATUS_WHITE) || ipi->m_tWhite < time(0))
-					{
-						if (!(ipi->m_nSince%100))	m_pLog->Log(_fn, "BLOCKED IP %s reaches %u attempts\n", ipbuf, ipi->m_nSince) ;
-						if (close(cSock) < 0)		m_pLog->Log(_fn, "ERROR: Could not close socket %d after blocked IP address detected. errno=%d\n", cSock, errno) ;
+					if (!(nAttempts%100))		m_pLog->Log(_fn, "BLOCKED IP %s reaches %u attempts\n", ipbuf, nAttempts) ;
+					if (close(cSock) < 0)		m_pLog->Log(_fn, "ERROR: Could not close socket %d after blocked IP address detected. errno=%d\n", cSock, errno) ;
 
-						ipi->m_nSince++ ;
-						ipi->m_nTotal++ ;
-
-						nBannedAttempts++ ;
-						if (!(nBannedAttempts%10000))
-							m_pLog->Log(_fn, "BLOCKED IP TOTAL reaches %u attempts\n", nBannedAttempts) ;
-						continue ;
-					}
+					nBannedAttempts++ ;
+					if (!(nBannedAttempts%10000))
+						m_pLog->Log(_fn, "BLOCKED IP TOTAL reaches %u attempts\n", nBannedAttempts) ;
+					continue ;
 				}
 
-				if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-					m_pLog->Log(_fn, "Loop %u: Accepted connection (1): socket %d/%s host %s port %d\n", nLoop, aSock, sbuf, ipbuf, pLS->GetPort()) ;
-
-				if (currCC[cSock])
-					m_pLog->Log(_fn, "WARNING: Loop %u: New connection on socket %d does not have a clean slot %p\n", nLoop, cSock, currCC[cSock]) ;
-
-				if (!pLS->m_OnSession)
+				//	Apply the connection rate limits of the port
+				if (pLS->AdmitConn(ipa) != HZ_RATE_NONE)
 				{
-					//	If the connection is not to be handled by a designated session, make the incoming socket non-blocking (to be handled by epoll)
-					flags = fcntl(cSock, F_GETFL, 0) ;
-					if (flags == -1)
-					{
-						m_pLog->Log(_fn, "Loop %u: NOTE: Could not make client socket %d non blocking (case 1)\n", nLoop, cSock) ;
-						if (close(cSock) < 0)
-							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after non_block_fail(1) errno=%d\n", nLoop, cSock, errno) ;
-						continue ;
-					}
-					flags |= O_NONBLOCK ;
-					if (fcntl(cSock, F_SETFL, flags) == -1)
-					{
-						m_pLog->Log(_fn, "Loop %u: NOTE: Could not make client socket %d non blocking (case 2)\n", nLoop, cSock) ;
-						if (close(cSock) < 0)
-							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after non_block_fail(2) errno=%d\n", nLoop, cSock, errno) ;
-						continue ;
-					}
+					if ((pLS->RefusedConns()%100) == 1)	m_pLog->Log(_fn, "RATE LIMIT: Port %d has refused %u connections (latest from %s)\n", pLS->GetPort(), pLS->RefusedConns(), ipbuf) ;
+					if (close(cSock) < 0)				m_pLog->Log(_fn, "ERROR: Could not close socket %d after rate limit refusal. errno=%d\n", cSock, errno) ;
+					continue ;
 				}
 
+				if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
+					m_pLog->Log(_fn, "Loop %u: Accepted connection: socket %d/%s host %s port %d\n", nLoop, cSock, sbuf, ipbuf, pLS->GetPort()) ;
+
 				//	Deal with the case where we have too many connections or we are shutting down.
 				if (m_bShutdown || pLS->GetCurConnections() >= pLS->GetMaxConnections())
 				{
-					m_pLog->Log(_fn, "Loop %u: NOTE: System too busy: Curr %d Max %d stat %d\n",
-						nLoop, pLS->GetCurConnections(), m_nMaxClients, m_bShutdown ? 1 : 0) ;
-					if (close(cSock) < 0)
-						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after sys_too_busy errno=%d\n", nLoop, cSock, errno) ;
+					m_pLog->Log(_fn, "Loop %u: NOTE: System too busy: Curr %d Max %d stat %d\n", nLoop, pLS->GetCurConnections(), m_nMaxClients, m_bShutdown ? 1 : 0) ;
+					close(cSock) ;
 					continue ;
 				}
 
-				//	Client is already connected. Do we allow further connections?
 				if (_ipcheck(ipbuf, pLS->GetPort()))
 				{
-					m_pLog->Log(_fn, "Loop %u: NOTE: Lorris Attack from IP %s port %d\n", ipbuf, pLS->GetPort()) ;
-					if (close(cSock) < 0)
-						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after lorris_attack errno=%d\n", nLoop, cSock, errno) ;
-					continue ;
-				}
-
-				//	All is well so set socket options
-				tv.tv_sec = 20 ;
-				tv.tv_usec = 0 ;
-				if (setsockopt(cSock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
-				{
-					m_pLog->Log(_fn, "Loop %u: NOTE: Could not set send socket options\n", nLoop) ;
-					if (close(cSock) < 0)
-						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after setop_send errno=%d\n", nLoop, cSock, errno) ;
-					continue ;
-				}
-				if (setsockopt(cSock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
-				{
-					m_pLog->Log(_fn, "Loop %u: NOTE: Could not set recv socket options\n", nLoop) ;
-					if (close(cSock) < 0)
-						m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after setop_recv errno=%d\n", cSock, errno) ;
+					m_pLog->Log(_fn, "Loop %u: NOTE: Lorris Attack from IP %s port %d\n", nLoop, ipbuf, pLS->GetPort()) ;
+					close(cSock) ;
 					continue ;
 				}
 
-				//	Do we have SSL on top of connection?
 				if (pLS->UseSSL())
 				{
-					//	Create a new SSL session instance
-					m_pLog->Log(_fn, "Loop %u: NOTE: SSL instance on port %d\n", nLoop, pLS->GetPort()) ;
 					pSSL = SSL_new(s_svrCTX) ;
 					if (!pSSL)
 					{
 						m_pLog->Log(_fn, "Loop %u: NOTE: Failed to allocate an SSL instance on port %d\n", nLoop, pLS->GetPort()) ;
+						close(cSock) ;
 						continue ;
 					}
 
-					//if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-						m_pLog->Log(_fn, "Loop %u: Allocated SSL instance on port %d\n", nLoop, pLS->GetPort()) ;
-
-					//	Set the SSL session socket
 					SSL_set_accept_state(pSSL) ;
 					SSL_set_fd(pSSL, cSock) ;
-
-					sys_rc = SSL_accept(pSSL) ;
-					if (sys_rc <= 0)
-					{
-						m_pLog->Log(_fn, "Loop %u: NOTE: Failed to accept SSL client port %d sock %d (err=%d)\n",
-							nLoop, pLS->GetPort(), cSock, SSL_get_error(pSSL, sys_rc)) ;
-						SSL_free(pSSL) ;
-						if (close(cSock) < 0)
-							m_pLog->Log(_fn, "Loop %u: NOTE: Could not close socket %d after SSL no_alloc errno=%d\n", nLoop, cSock, errno) ;
-						continue ;
-					}
-
-					if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-						m_pLog->Log(_fn, "Loop %u: SSL connection using %s\n", nLoop, SSL_get_cipher(pSSL)) ;
-
-					if (verify_callback)
-					{
-  						//	Get the client's certificate (optional)
-  						client_cert = SSL_get_peer_certificate(pSSL);
-
-						if (client_cert == NULL)
-							m_pLog->Log(_fn, "Loop %u: The SSL client does not have certificate.\n", nLoop) ;
-						else
-						{
-							clicert_str = X509_NAME_oneline(X509_get_subject_name(client_cert), 0, 0);
-							if (!clicert_str)
-							{
-								m_pLog->Log(_fn, "Loop %u: No Client Certificate found\n", nLoop) ;
-								continue ;
-							}
-
-							m_pLog->Log(_fn, "Loop %u: Subject of Client Cert: %s\n", nLoop, clicert_str) ;
-							free(clicert_str) ;
-
-							clicert_str = X509_NAME_oneline(X509_get_issuer_name(client_cert), 0, 0);
-							if (!clicert_str)
-							{
-								m_pLog->Log(_fn, "Loop %u: No Client Cert Issuer found\n") ;
-								continue ;
-							}
-
-							m_pLog->Log(_fn, "Loop %u: Issuer of Client Cert: %s\n", nLoop, clicert_str) ;
-							free(clicert_str) ;
-							X509_free(client_cert);
-						}
-					}
 				}
 
-				/*
-				**	If the listening socket is for a session handler, i.e. the connection is to be handled by a separate thread, deal with this here
-				*/
-
 				if (pLS->m_OnSession)
 				{
-					//	Call the session handler in it's own thread
+					//	The session thread expects a blocking socket (the accept makes it non-blocking)
+					flags = fcntl(cSock, F_GETFL, 0) ;
+					if (flags != -1)
+						fcntl(cSock, F_SETFL, flags & ~O_NONBLOCK) ;
+
 					proc_data.SetParams(pSSL, cSock, ipa) ;
-					prc = pthread_create(&tid, &tattr, pLS->m_OnSession, &proc_data) ;
-					if (prc == 0)
-					{
+					sys_rc = pthread_create(&tid, &tattr, pLS->m_OnSession, &proc_data) ;
+					if (sys_rc == 0)
 						m_pLog->Log(_fn, "Thread %u accepted connection from %s on socket %d\n", tid, ipbuf, cSock) ;
-						if (cSock >= m_nMaxSocket)
-							m_nMaxSocket = cSock + 1 ;
-					}
 					else
 					{
 						m_pLog->Log(_fn, "NOTE: Could not create thread for client %s on socket %d. Closing conection\n", ipbuf, cSock) ;
-						if (close(cSock) < 0)
-							m_pLog->Log(_fn, "NOTE: Could not close socket %d after SSL fail_thread_create. errno=%d\n", cSock, errno) ;
-						//delete pPD ;
+						close(cSock) ;
 					}
-
 					continue ;
 				}
 
-				/*
-				**	Allocate the connected client object
-				*/
-
-				pCC = currCC[cSock] ;
-				if (pCC)
+				//	Allocate the connected client object
+				if (m_Conns[cSock])
 				{
-					m_pLog->Log(_fn, "Loop %u slot %u: CORRUPT: Existing client connection handler on sock %d/%d.\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
-					if (close(cSock) < 0)
-						m_pLog->Log(_fn, "NOTE: Could not close socket %d after memory allocation failure. errno=%d\n", cSock, errno) ;
+					m_pLog->Log(_fn, "Loop %u: CORRUPT: Existing client connection handler on sock %d.\n", nLoop, cSock) ;
+					close(cSock) ;
 					m_bShutdown = true ;
 					continue ;
 				}
 
-				pCC = new hzIpConnex(m_pLog) ;
-				if (!pCC)
+				pCC = m_Conns.Acquire() ;
+				nTag = pCC ? m_Conns.Insert(cSock, pCC) : 0 ;
+				if (!nTag)
 				{
 					m_pLog->Log(_fn, "ERROR: No memory for client %s on socket %d. Closing conection\n", ipbuf, cSock) ;
-					if (close(cSock) < 0)
-						m_pLog->Log(_fn, "NOTE: Could not close socket %d after memory allocation failure. errno=%d\n", cSock, errno) ;
+					close(cSock) ;
+					m_Conns.Release(pCC) ;
 					m_bShutdown = true ;
 					continue ;
 				}
 
-				//	Add new client socket to the epoll control
-				epEventNew.data.fd = cSock ;
-				epEventNew.events = EPOLLIN ;	//| EPOLLET ;
+				pCC->Initialize(pLS, pSSL, ipbuf, cSock, cPort, nCliSeq++) ;
+				pCC->m_Track.Event("ServeUring: Loop %u: NEW Connection on socket %u/%u port %u", nLoop, cSock, pCC->CliPort(), pLS->GetPort()) ;
 
-				if (epoll_ctl(epollSocket, EPOLL_CTL_ADD, cSock, &epEventNew) < 0)
+				_uringArm(pCC) ;
+
+				if (pCC->IsHandshake())
 				{
-					m_pLog->Log(_fn, "Loop %u slot %u: EPOLL ERROR: Could not add client connection handler on sock %d/%d. Error=%s\n",
-						nLoop, nSlot, cSock, pCC->CliPort(), strerror(errno)) ;
-					if (close(cSock) < 0)
-						m_pLog->Log(_fn, "NOTE: Could not close socket %d after memory allocation failure. errno=%d\n", cSock, errno) ;
-					m_bShutdown = true ;
-					delete pCC ;
+					__atomic_add_fetch(&m_nTlsBegun, 1, __ATOMIC_RELAXED) ;
+					pCC->SetHandshakeLimit(RealtimeNano() + (uint64_t) m_nTlsTimeout * 1000000000) ;
+					wheel.Arm(&pCC->m_Timer, pCC->Deadline()) ;
 					continue ;
 				}
 
-				//	Initialize and oxygenate the connection
-				currCC[cSock] = pCC ;
-				pCC->Initialize(pLS, pSSL, ipbuf, cSock, cPort, nCliSeq++) ;
+				wheel.Arm(&pCC->m_Timer, pCC->Deadline()) ;
+
 				if (pCC->m_OnConnect)
+				{
 					pCC->m_OnConnect(pCC) ;
-				now.SysDateTime() ;
-				pCC->m_Track.Printf("%s %s: Loop %u slot %u: NEW Connection on socket %d/%d from %s:%u\n",
-					*_fn, *now.Str(FMT_TIME_USEC), nLoop, nSlot, cSock, pCC->CliPort(), ipbuf, pLS->GetPort()) ;
+					_uringFlush(pCC) ;
+				}
 				continue ;
+			}
 
-				//	End of TCP Listen stuff
+			/*
+			**	Connection events. Any bearing the tag of an earlier connection on the socket are ignored, but buffers they hold must go back to the ring.
+			*/
+
+			pCC = m_Conns[cSock] ;
+			if (!pCC || (pCC->EventTag() & URING_TAG) != nTag)
+			{
+				if (nOp == URING_OP_RECV && nFlags & IORING_CQE_F_BUFFER)
+					s_pUring->ReturnBuffer(nFlags >> IORING_CQE_BUFFER_SHIFT) ;
+				continue ;
 			}
 
-			if (eventAr[nSlot].events & EPOLLOUT)
+			//	The operation is complete unless it is a multishot operation that remains armed. A connection that has been closed is freed once the last of
+			//	its operations has completed, and until then its completions are ignored.
+			if (!(nFlags & IORING_CQE_F_MORE) && pCC->m_nUring)
+				pCC->m_nUring-- ;
+
+			if (pCC->IsRemoved())
 			{
-				//	Subsequent to a call to hzIpConnex::SendData to place a response in the output queue and to modify the epoll entry for the connection so the socket is monitored
-				//	for writability, we now have notification that the socket is writable.
+				if (nOp == URING_OP_RECV && nFlags & IORING_CQE_F_BUFFER)
+					s_pUring->ReturnBuffer(nFlags >> IORING_CQE_BUFFER_SHIFT) ;
+				if (!pCC->m_nUring)
+					_uringFree(pCC) ;
+				continue ;
+			}
 
-				cSock = eventAr[nSlot].data.fd ;
-				pCC = currCC[cSock] ;
-				if (!pCC)
+			switch (nOp)
+			{
+			case URING_OP_RECV:
+
+				if (nRes > 0)
 				{
-					m_pLog->Log(_fn, "Loop %u slot %u: CORRUPT: Write event on socket %d/%d but no connector!\n", nLoop, nSlot, cSock, pCC->CliPort()) ;
-					m_bShutdown = true ;
-					continue ;
+					pCC->_ingest(s_pUring->Buffer(nFlags >> IORING_CQE_BUFFER_SHIFT), nRes) ;
+					s_pUring->ReturnBuffer(nFlags >> IORING_CQE_BUFFER_SHIFT) ;
 				}
-
-				if (cSock != pCC->CliSocket())
+				else if (nRes == -ENOBUFS)
 				{
-					m_pLog->Log(_fn, "Loop %u slot %u: CORRUPT: Write event on sock %d/%d but attached client object has socket of %d\n",
-						nLoop, nSlot, cSock, pCC->CliPort(), pCC->CliSocket()) ;
-					m_bShutdown = true ;
-					continue ;
+					//	All buffers are in use. The receive is re-armed and will proceed as buffers are returned.
+					_uringArm(pCC) ;
+					break ;
+				}
+				else if (nRes == 0)
+					pCC->_ingest(0, 0) ;
+				else
+				{
+					pCC->m_Track.ErrorS("ServeUring: Loop %u: Read error on socket %u/%u (%s) - removed", strerror(-nRes), nLoop, cSock, pCC->CliPort()) ;
+					pCC->MetricError() ;
+					_uringClose(pCC) ;
+					break ;
 				}
 
-				if (pCC->IsCliBad())
+				if (nRes == 0)
 				{
-					pCC->m_Track.Printf("%s: Loop %u slot %u: BAD Client, connection on socket %d/%d to be removed\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
-					pCC->Terminate() ;
-					delete pCC ;
-					currCC[cSock] = 0 ;
-					continue ;
+					//	Client has closed its side. Close now unless a response is still to go out.
+					if (!pCC->_isxmit())
+						{ _uringClose(pCC) ; break ; }
+					pCC->m_bState |= CLIENT_CLOSING ;
+					break ;
 				}
 
-				if (!pCC->_isxmit() && _hzGlobal_Debug & HZ_DEBUG_SERVER)
-					pCC->m_Track.Printf("%s: Loop %u slot %u: Write event with nothin socket %d/%d\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
+				if (!(nFlags & IORING_CQE_F_MORE))
+					_uringArm(pCC) ;
 
-				if (pCC->_isxmit())
-				{
-					pCC->m_Track.Printf("%s: Loop %u slot %u: Write event with output on socket %d/%d\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
-
-					xmitState = pCC->_xmit(tbuf) ;
-					if (xmitState < 0)
-					{
-						pCC->m_Track.Printf("%s: Loop %u slot %u: EPOLLOUT Write error, connection on socket %d/%d to be removed\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
-						pCC->Terminate() ;
-						delete pCC ;
-						currCC[cSock] = 0 ;
-						continue ;
-					}
-				}
-			}
+				_uringIngress(pCC) ;
+				break ;
 
-			if (eventAr[nSlot].events & EPOLLIN)
-			{
-				//	At this point we have data on the socket to be read
+			case URING_OP_POLLIN:
 
-				cSock = eventAr[nSlot].data.fd ;
-				pCC = currCC[cSock] ;
-				if (!pCC)
+				if (nRes < 0)
 				{
-					m_pLog->Log(_fn, "Loop %u: CORRUPT: Read event on socket %d/%d but no connector!\n", nLoop, cSock, pCC->CliPort()) ;
-					m_bShutdown = true ;
-					continue ;
+					pCC->m_Track.ErrorS("ServeUring: Loop %u: Poll error on socket %u/%u (%s) - removed", strerror(-nRes), nLoop, cSock, pCC->CliPort()) ;
+					pCC->MetricError() ;
+					_uringClose(pCC) ;
+					break ;
 				}
 
-				if (cSock != pCC->CliSocket())
+				if (!(nFlags & IORING_CQE_F_MORE))
+					_uringArm(pCC) ;
+
+				if (pCC->IsHandshake())
 				{
-					m_pLog->Log(_fn, "Loop %u slot %u: CORRUPT: Read event on sock %d/%d but attached client object has socket of %d\n",
-						nLoop, nSlot, cSock, pCC->CliPort(), pCC->CliSocket()) ;
-					m_bShutdown = true ;
-					continue ;
+					hsr = pCC->Handshake() ;
+
+					if (hsr == HANDSHAKE_FAILED)
+						{ __atomic_add_fetch(&m_nTlsFailed, 1, __ATOMIC_RELAXED) ; _uringClose(pCC) ; break ; }
+
+					if (hsr == HANDSHAKE_WANT_WRITE)
+						s_pUring->PrepPoll(_uring_sqe(pCC->m_nUring), cSock, POLLOUT, false, _uring_data(URING_OP_POLLOUT, pCC->EventTag())) ;
+					if (hsr != HANDSHAKE_DONE)
+						break ;
+
+					_tlsDone(pCC) ;
+					if (pCC->m_OnConnect)
+						pCC->m_OnConnect(pCC) ;
+					_uringFlush(pCC) ;
+
+					if (pCC->IsRemoved() || !pCC->SslPending())
+						break ;
 				}
 
-				//	Now because we are in edge-triggered mode, continue reading from the socket until we get -1
 				for (nRecvTotal = 0 ;; nRecvTotal += nRecv)
 				{
 					nRecv = pCC->Recv(tbuf) ;
@@ -2205,120 +4976,79 @@ void	hzIpServer::ServeEpollST	(void)
 						break ;
 				}
 
-				if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-				{
-					if (!pCC->IsCliTerm())
-						pCC->m_Track.Printf("%s: Loop %u slot %u: Client LIVE sock %d/%d. Recv %d Have %d\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort(), nRecvTotal, pCC->SizeIn()) ;
-					else
-						pCC->m_Track.Printf("%s: Loop %u slot %u: Client DONE sock %d/%d. Revc %d Have %d\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort(), nRecvTotal, pCC->SizeIn()) ;
-				}
-
-				//	Data to be processed has come in
 				if (!nRecvTotal)
 				{
-					pCC->m_Track.Printf("%s: Loop %u slot %u: Read event with zero data on socket %d - disconnecting\n", *_fn, nLoop, nSlot, cSock) ;
+					if (!pCC->IsCliTerm() && (nRes & (POLLRDHUP | POLLHUP | POLLERR)) == 0)
+						break ;
 					if (!pCC->_isxmit())
-					{
-						//	Nothing has come in and nothing is due to go out so clear off the connection
-						pCC->m_Track.Printf("%s: Loop %u slot %u: Terminating unused connection on socket %d\n", *_fn, nLoop, nSlot, cSock) ;
-						pCC->Terminate() ;
-						delete pCC ;
-						currCC[cSock] = 0 ;
-					}
+						{ _uringClose(pCC) ; break ; }
+					pCC->m_bState |= CLIENT_CLOSING ;
+					break ;
 				}
-				else
-				{
-					if (pCC->MsgReady())
-						trc = pCC->m_OnIngress(pCC->InputZone(), pCC) ;
-					else
-					{
-						pCC->m_Track.Printf("%s: Loop %u slot %u: NOTE: Client message not yet complete on socket %d/%d\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
-						trc = TCP_INCOMPLETE ;
-					}
 
-					switch (trc)
-					{
-					case TCP_TERMINATE:	//	Directive is to close after outgoing message is complete
+				_uringIngress(pCC) ;
+				break ;
 
-						if (pCC->_isxmit())
-						{
-							//	If outgoing data not complete, transmit some more.
-							xmitState = pCC->_xmit(tbuf) ;
-							if (xmitState < 0)
-							{
-								pCC->m_Track.Printf("%s: Loop %u slot %u: TCP_TERMINATE: Write error - Sock %d/%d doomed\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
-								pCC->Terminate() ;
-								delete pCC ;
-								currCC[cSock] = 0 ;
-								break ;
-							}
-						}
+			case URING_OP_POLLOUT:
 
-						if (!pCC->_isxmit())
-						{
-							//	No longer any outgoing data so close
-							pCC->m_Track.Printf("%s: Loop %u slot %u: TCP_TERMINATE: Normal termination, sock %d/%d to be removed\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
-							pCC->Terminate() ;
-							delete pCC ;
-							currCC[cSock] = 0 ;
-							break ;
-						}
+				//	TLS connection is writable, either to advance the handshake or for the remaining outgoing data
+				pCC->m_bState &= ~CLIENT_WRITING ;
 
-						pCC->m_Track.Printf("%s: Loop %u slot %u: TCP_TERMINATE: Write delay - Sock %d/%d\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
+				if (pCC->IsHandshake())
+				{
+					hsr = pCC->Handshake() ;
+					if (hsr == HANDSHAKE_FAILED)
+						{ __atomic_add_fetch(&m_nTlsFailed, 1, __ATOMIC_RELAXED) ; _uringClose(pCC) ; break ; }
+					if (hsr == HANDSHAKE_WANT_WRITE)
+						s_pUring->PrepPoll(_uring_sqe(pCC->m_nUring), cSock, POLLOUT, false, _uring_data(URING_OP_POLLOUT, pCC->EventTag())) ;
+					if (hsr != HANDSHAKE_DONE)
 						break ;
 
-					case TCP_KEEPALIVE:	//	Directive is to keep open after outgoing message is complete
+					_tlsDone(pCC) ;
+					if (pCC->m_OnConnect)
+						pCC->m_OnConnect(pCC) ;
+				}
 
-						if (pCC->_isxmit())
-						{
-							xmitState = pCC->_xmit(tbuf) ;
-							if (xmitState < 0)
-							{
-								pCC->m_Track.Printf("%s: Loop %u slot %u: TCP_KEEPALIVE: Write error, sock %d/%d doomed\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
-								pCC->Terminate() ;
-								delete pCC ;
-								currCC[cSock] = 0 ;
-								break ;
-							}
+				_uringFlush(pCC) ;
+				break ;
 
-							if (xmitState > 0)
-							{
-								//	We have EAGAIN or EWOULDBLOCK and so now we make epoll entry to look for write event (when ocket becomes writable)
-								pCC->m_Track.Printf("%s: Loop %u slot %u: TCP_KEEPALIVE: Write delay - Sock %d/%d\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
-							}
-						}
+			case URING_OP_SOURCE:
 
-						if (pCC->IsCliTerm())
-						{
-							//	No longer any outgoing data so close
-							pCC->m_Track.Printf("%s: Loop %u slot %u: TCP_KEEPALIVE: Client terminated so sock %d/%d to be removed\n", *_fn, nLoop, nSlot, cSock, pCC->CliPort()) ;
-							pCC->Terminate() ;
-							delete pCC ;
-							currCC[cSock] = 0 ;
-							break ;
-						}
+				//	The output source has more data (or has failed, which the next Fill() will report)
+				pCC->m_bState &= ~CLIENT_WRITING ;
+				_uringFlush(pCC) ;
+				break ;
 
-						pCC->Oxygen() ;
-						break ;
+			case URING_OP_SEND:
 
-					case TCP_INCOMPLETE:	//	The message processor has indicated it is still waiting for more imput
+				if (nRes > 0)
+					pCC->_xmitDone(nRes) ;
+				break ;
 
-						pCC->Oxygen() ;
-						break ;
+			case URING_OP_SENDLAST:
 
-					case TCP_INVALID:		//	The message processor cannot dechipher the message. Kill the connection
+				//	The last (or only) write of a set has completed. Earlier writes in the set that failed cause the later ones to be cancelled.
+				pCC->m_bState &= ~CLIENT_WRITING ;
 
-						pCC->m_Track.Printf("%s: Loop %u: Sock %d/%d INVALID TCP code\n", *_fn, nLoop, cSock, pCC->CliPort()) ;
-						pCC->Terminate() ;
-						delete pCC ;
-						currCC[cSock] = 0 ;
-						break ;
-					}
+				if (nRes > 0)
+					pCC->_xmitDone(nRes) ;
+				else if (nRes < 0 && nRes != -ECANCELED)
+				{
+					pCC->m_Track.ErrorS("ServeUring: Loop %u: Write error on socket %u/%u (%s) - removed", strerror(-nRes), nLoop, cSock, pCC->CliPort()) ;
+					pCC->MetricError() ;
+					_uringClose(pCC) ;
+					break ;
 				}
+
+				_uringFlush(pCC) ;
+				break ;
 			}
 		}
 	}
 
+	m_pLog->Log(_fn, "io_uring: %u loops, %u calls to io_uring_enter\n", nLoop, s_pUring->Submits()) ;
+	s_pUring = 0 ;
+
 	threadLog("%s. SHUTDOWN COMPLETE\n", *_fn) ;
 }
 
@@ -2336,6 +5066,21 @@ static	pthread_cond_t  s_response_cond = PTHREAD_COND_INITIALIZER ;	//	Response
 
 static	uint32_t	s_nReqThreads ;			//	Number of request server threads
 
+static	void	_respond	(hzIpConnex* pCC)
+{
+	//	Pass a connection with output to write to the response thread. This is done under the response mutex so that the response thread, which only waits if
+	//	it finds the queue empty while holding the mutex, cannot miss the signal.
+	//
+	//	Arguments:	1)	pCC		The connection
+	//
+	//	Returns:	None
+
+	pthread_mutex_lock(&s_response_mutex) ;
+	s_queResponses.Push(pCC) ;
+	pthread_cond_signal(&s_response_cond) ;
+	pthread_mutex_unlock(&s_response_mutex) ;
+}
+
 void	hzIpServer::ServeRequests	(void)
 {
 	//	Calculate number of request server thread as this will serve as the divisor
@@ -2351,6 +5096,7 @@ void	hzIpServer::ServeRequests	(void)
 	hzTcpCode		rc ;		//	Return code from event handler
 
 	pLog = GetThreadLogger() ;
+	s_bServing = true ;
 
     pthread_mutex_lock(&s_request_mutex);
 	s_nReqThreads++ ;
@@ -2367,25 +5113,30 @@ void	hzIpServer::ServeRequests	(void)
 			if (!pCC)
 				break ;
 
-			//	Handle the request
-			rc = pCC->m_OnIngress(pCC->InputZone(), pCC) ;
+			//	Handle the request (unless refused by the message rate limit)
+			rc = pCC->_admit() ? pCC->m_OnIngress(pCC->InputZone(), pCC) : TCP_TERMINATE ;
 
 			switch	(rc)
 			{
 			case TCP_TERMINATE:		pCC->Hypoxia() ;
-									s_queResponses.Push(pCC) ;
-									pthread_cond_signal(&s_response_cond) ;
+									pCC->m_bState |= CLIENT_CLOSING ;
+									_respond(pCC) ;
 									break ;
 
 			case TCP_KEEPALIVE:		pCC->Oxygen() ;
-									s_queResponses.Push(pCC) ;
-									pthread_cond_signal(&s_response_cond) ;
+									_respond(pCC) ;
 									break ;
 
 			case TCP_INCOMPLETE:	pCC->Oxygen() ;
 									pLog->Log(_fn, "Client %d (sock %d): Data incomplete\n", pCC->EventNo(), pCC->CliSocket()) ;
+									if (pCC->_isxmit())
+										_respond(pCC) ;
 									break ;
 			}
+
+			//	Where the connection was terminated while in the hands of the request threads, the last of them to be done with it releases the HTTP event
+			if (__atomic_sub_fetch(&pCC->m_nReqHold, 1, __ATOMIC_ACQ_REL) == HZ_REQ_ORPHAN)
+				pCC->_dropEvent() ;
 		}
 
         pthread_mutex_unlock(&s_request_mutex);
@@ -2394,48 +5145,41 @@ void	hzIpServer::ServeRequests	(void)
 
 void	hzIpServer::ServeResponses	(void)
 {
-	_hzfunc("hzIpServer::ServeResponses") ;
+	//	Write out output queued on connections passed by the request threads (after handling a request) or by the epoll thread (when a socket that would not
+	//	take all its output becomes writable). Each connection is written to until it is either done or its socket would block. In the latter case the socket
+	//	is polled for writability so the connection is passed here again once the socket drains, rather than being retried continuously.
+	//
+	//	Arguments:	None
+	//	Returns:	None
 
-	hzList<hzIpConnex*>		lc ;	//	List of connections with outgoing matter remaining
-	hzList<hzIpConnex*>::Iter	ic ;	//	List iterator of connections with outgoing matter remaining
+	_hzfunc("hzIpServer::ServeResponses") ;
 
 	hzPacket		tbuf ;				//	Fixed buffer for single IP packet
-	hzIpConnex*	pCC ;				//	Connected client
+	hzIpConnex*		pCC ;				//	Connected client
+
+	s_bServing = true ;
 
 	for (; !m_bShutdown ;)
     {
         pthread_mutex_lock(&s_response_mutex);
-        pthread_cond_wait(&s_response_cond, &s_response_mutex);
-
-		for (;;)
-		{
-			pCC = (hzIpConnex*) s_queResponses.Pull() ;
-			if (pCC)
-				lc.Add(pCC) ;
-
-			if (!lc.Count())
-				break ;
+		pCC = (hzIpConnex*) s_queResponses.Pull() ;
+		if (!pCC)
+			pthread_cond_wait(&s_response_cond, &s_response_mutex);
+        pthread_mutex_unlock(&s_response_mutex);
 
-			for (ic = lc ; ic.Valid() ;)
-			{
-				pCC = ic.Element() ;
+		if (!pCC)
+			continue ;
 
-				//	Write out
-				if (pCC->_isxmit())
-				{
-					pCC->_xmit(tbuf) ;
+		if (pCC->_isxmit())
+			pCC->_xmit(tbuf) ;
 
-					if (!pCC->_isxmit())
-					{
-						ic.Delete() ;
-						continue ;
-					}
-				}
-				ic++ ;
-			}
+		//	Where the connection is to close once the response is out, end the sending side. The epoll thread removes the connection when the client then
+		//	closes its side, rather than only when the connection expires.
+		if (!pCC->_isxmit() && (pCC->m_bState & CLIENT_CLOSING) && !(pCC->m_bState & CLIENT_SHUTWR))
+		{
+			pCC->m_bState |= CLIENT_SHUTWR ;
+			shutdown(pCC->CliSocket(), SHUT_WR) ;
 		}
-
-        pthread_mutex_unlock(&s_response_mutex);
 	}
 }
 
@@ -2461,24 +5205,24 @@ void	hzIpServer::ServeEpollMT	(void)
 	//	3)	Go through all active entries to see which one recieved a message
 
 	hzMapS<uint32_t,hzTcpListen*>	ls ;	//	Listening sockets map
-	hzMapS<uint32_t,hzIpConnex*>	allCC ;	//	Connected clients
 	hzMapS<uint32_t,hzIpConnex*>	duff ;	//	Failed clients
 	hzList<hzTcpListen*>::Iter		I ;		//	Listening sockets iterator
 
 	struct epoll_event	eventAr[100] ;		//	Array of epoll events
 	struct epoll_event	epEventNew ;		//	Epoll event for new connections
+
+	hzTimerWheel	wheel ;					//	Connection expiry timers
+	hzTimer*		pTm ;					//	Expired timer
+	hzTimer*		pTmNext ;				//	Next expired timer
 	//struct epoll_event	epEventDead ;		//	Epoll event for dead connections
 
 	hzPacket		tbuf ;					//	Fixed buffer for single IP packet
-	SOCKADDR		cliAddr ;				//	Client address
 	SOCKADDRIN		cliAddrIn ;				//	Client address
 	socklen_t		cliLen ;				//	Client address length
 	hzTcpListen*	pLS ;					//	Listening socket
 	hzIpConnex*	pCC ;						//	Connected client
 	hzProcInfo*		pPD ;					//	Process data (Client socket & IP address, must be destructed by the called thread function)
 	SSL*			pSSL ;					//	SSL session (if applicable)
- 	X509*			client_cert ;			//	Client certificate
-	char*			clicert_str ;			//	Client certificate string
 	//const char*		errstr ;				//	Either 'hangup' or 'error'
 	timeval			tv ;					//	Time limit for epoll call
 	pthread_attr_t	tattr ;					//	Thread attribute (to support thread invokation)
@@ -2487,27 +5231,26 @@ void	hzIpServer::ServeEpollMT	(void)
 	//uint64_t		now ;					//	After the wait
 	uint64_t		nsThen ;				//	Before the wait
 	uint64_t		nsNow ;					//	After the wait
+	uint64_t		nTag ;					//	Epoll event tag of new connection
 	hzIpaddr		ipa ;					//	IP address
 	uint32_t		nBannedAttempts ;		//	Total connection attempts by banned IP addresses
 	uint32_t		nCliSeq = 1 ;			//	Client connection id allocator
-	uint32_t		nX ;					//	Dead/failed connections counter
 	uint32_t		nLoop ;					//	Number of times round the epoll event loop
 	uint32_t		nSlot ;					//	Connections iterator
 	uint32_t		nError ;				//	Errno of the epoll call
 	uint32_t		cSock ;					//	Client socket (from accept)
 	uint32_t		cPort ;					//	Client socket (from accept)
+	uint32_t		nAttempts ;				//	Connection attempts by a blocked IP address
 	int32_t			aSock ;					//	Client socket (validated)
-	int32_t			epollSocket ;			//	The epoll 'master' socket
 	int32_t			flags ;					//	Flags to mak socket non-blocking
 	int32_t			nC ;					//	Connections iterator
 	int32_t			nRecv ;					//	No bytes read from client socket after epoll
 	int32_t			nEpollEvents ;			//	Result of the epoll call
-	int32_t			sys_rc ;				//	Return from system library calls
-	hzEcode			err ;					//	Returns by called functions
+	int32_t			nWait ;					//	Epoll timeout (milliseconds until next connection deadline)
+	hzHandshake		hsr ;					//	Return from TLS handshake
 	char			ipbuf[44] ;				//	Client IP address textform buffer
 
 	//ls.SetDefaultObj(0) ;
-	//allCC.SetDefaultObj(0) ;
 
 	//	Pre-define thread attributes
 	pthread_attr_init(&tattr) ;
@@ -2523,7 +5266,7 @@ void	hzIpServer::ServeEpollMT	(void)
 	{
 		pLS = I.Element() ;
 
-		epEventNew.data.fd = pLS->GetSocket() ;
+		epEventNew.data.u64 = pLS->GetSocket() ;
 		epEventNew.events = EPOLLIN ;
 		if (epoll_ctl(epollSocket, EPOLL_CTL_ADD, pLS->GetSocket(), &epEventNew) < 0)
 			Fatal("%s. Could not add listening socket %d to the epoll controller\n", *_fn, pLS->GetSocket()) ;
@@ -2532,23 +5275,61 @@ void	hzIpServer::ServeEpollMT	(void)
 		ls.Insert(pLS->GetSocket(), pLS) ;
 	}
 
+	//	Client sockets are edge-triggered and output queued by the handlers is written out by ServeResponses
+	s_nEpollET = EPOLLET ;
+	s_bServing = true ;
+
 	//	Main loop - waiting for events
 	nLoop = nCliSeq = nBannedAttempts = 0 ;
+	wheel.Init(RealtimeNano()) ;
 
 	for (;;)
 	{
 		nsThen = RealtimeNano() ;
-		nEpollEvents = epoll_wait(epollSocket, eventAr, MAXEVENTS, 30000) ;
+		nWait = wheel.NextTimeout(nsThen) ;
+		if (nWait < 0 || nWait > 30000)
+			nWait = 30000 ;
+		nEpollEvents = epoll_wait(epollSocket, eventAr, MAXEVENTS, nWait) ;
 		nsNow = RealtimeNano() ;
 
 		for (nC = 0 ; nC < nEpollEvents ; nC++)
 		{
+			nSlot = nC ;
+
 			if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
 			{
 				if (nSlot)
-					m_pLog->Log(_fn, "Loop %u slot %u: Event on socket %d\n", nLoop, nSlot, eventAr[nSlot].data.fd) ;
+					m_pLog->Log(_fn, "Loop %u slot %u: Event on socket %u\n", nLoop, nSlot, hzConnTable::Socket(eventAr[nSlot].data.u64)) ;
 				else
-					m_pLog->Log(_fn, "Loop %u: Waited %lu nanoseconds for %d events: 1st sock %u\n", nLoop, nsNow - nsThen, nEpollEvents, eventAr[0].data.fd) ;
+					m_pLog->Log(_fn, "Loop %u: Waited %lu nanoseconds for %d events: 1st sock %u\n", nLoop, nsNow - nsThen, nEpollEvents, hzConnTable::Socket(eventAr[0].data.u64)) ;
+			}
+
+			//	Ignore events tagged with an earlier generation of the socket. These belong to a connection that has since closed, but one that was still in the
+			//	hands of the request or response threads when the socket was reused. If the socket has a live connection, restore its registration as _wantWrite
+			//	would have it, including writability if the connection has output held up.
+			if (m_Conns.Stale(eventAr[nSlot].data.u64))
+			{
+				cSock = hzConnTable::Socket(eventAr[nSlot].data.u64) ;
+				m_pLog->Log(_fn, "Loop %u slot %u: Stale event on socket %u ignored\n", nLoop, nSlot, cSock) ;
+
+				pCC = m_Conns[cSock] ;
+				if (pCC && pCC->CliSocket() && !hzConnTable::IsSource(eventAr[nSlot].data.u64))
+				{
+					epEventNew.data.u64 = pCC->EventTag() ;
+					epEventNew.events = EPOLLIN | s_nEpollET | (pCC->m_bState & CLIENT_WANTOUT ? EPOLLOUT : 0) ;
+					if (epoll_ctl(epollSocket, EPOLL_CTL_MOD, cSock, &epEventNew) < 0)
+						m_pLog->Log(_fn, "Could not restore events on socket %d. Error=%s\n", cSock, strerror(errno)) ;
+				}
+				continue ;
+			}
+
+			//	Output sources that were waiting on their own sockets now have more data, so the connection is passed to ServeResponses to resume the output
+			if (hzConnTable::IsSource(eventAr[nSlot].data.u64))
+			{
+				pCC = m_Conns.Lookup(eventAr[nSlot].data.u64) ;
+				if (pCC && pCC->CliSocket() && pCC->_isxmit())
+					_respond(pCC) ;
+				continue ;
 			}
 
 			/*
@@ -2558,49 +5339,49 @@ void	hzIpServer::ServeEpollMT	(void)
 			if (eventAr[nSlot].events & EPOLLHUP)
 			{
 				//	Hangup signal
-				cSock = eventAr[nSlot].data.fd ;
-				pCC = currCC[cSock] ;
+				cSock = hzConnTable::Socket(eventAr[nSlot].data.u64) ;
+				pCC = m_Conns[cSock] ;
 				nError = 0 ;
 
 				if (!pCC)				{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: HANGUP CORRUPT Sock %d No connector\n", nLoop, nSlot, cSock) ; continue ; }
 				if (!pCC->CliSocket())	{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: HANGUP CORRUPT Sock %d Connector defunct\n", nLoop, nSlot, cSock) ; continue ; }
 
 				if (getsockopt(cSock, SOL_SOCKET, SO_ERROR, (void *)&nError, &cliLen) == 0)
-					pCC->m_Track.Printf("Loop %u slot %u: HANGUP on socket %d (%s)\n", nLoop, nSlot, cSock, strerror(nError)) ;
+					pCC->m_Track.EventS("ServeEpollMT: Loop %u: HANGUP on socket %u (%s)", strerror(nError), nLoop, cSock) ;
 				else
-					pCC->m_Track.Printf("Loop %u slot %u: HANGUP on socket %d (no details)\n", nLoop, nSlot, cSock) ;
+					pCC->m_Track.Event("ServeEpollMT: Loop %u: HANGUP on socket %u (no details)", nLoop, cSock) ;
 			}
 
 			if (eventAr[nSlot].events & EPOLLERR)
 			{
 				//	An error has occured on this fd, or the socket is not ready for reading
-				cSock = eventAr[nSlot].data.fd ;
-				pCC = currCC[cSock] ;
+				cSock = hzConnTable::Socket(eventAr[nSlot].data.u64) ;
+				pCC = m_Conns[cSock] ;
 				nError = 0 ;
 
 				if (!pCC)				{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: EPOLLERR CORRUPT Sock %d No connector\n", nLoop, nSlot, cSock) ; continue ; }
 				if (!pCC->CliSocket())	{ m_bShutdown = true ; m_pLog->Log(_fn, "Loop %u slot %u: EPOLLERR CORRUPT Sock %d Connector defunct\n", nLoop, nSlot, cSock) ; continue ; }
 
 				if (getsockopt(cSock, SOL_SOCKET, SO_ERROR, (void *)&nError, &cliLen) == 0)
-					pCC->m_Track.Printf("Loop %u slot %u: EPOLLERR on socket %d (%s)\n", nLoop, nSlot, cSock, strerror(nError)) ;
+					pCC->m_Track.ErrorS("ServeEpollMT: Loop %u: EPOLLERR on socket %u (%s)", strerror(nError), nLoop, cSock) ;
 				else
-					pCC->m_Track.Printf("Loop %u slot %u: EPOLLERR on socket %d (no details)\n", nLoop, nSlot, cSock) ;
+					pCC->m_Track.Error("ServeEpollMT: Loop %u: EPOLLERR on socket %u (no details)", nLoop, cSock) ;
 			}
 
 			/*
 			**	Check for events on listening sockets
 			*/
 
-			if (ls.Exists(eventAr[nC].data.fd))
+			if (ls.Exists(hzConnTable::Socket(eventAr[nC].data.u64)))
 			{
 				//	We have a notification on the listening socket, which means one or more incoming connections.
 				//	Firstly accept the client no matter what. If there is a problem we will imeadiately close the connection.
 
-				pLS = ls[eventAr[nC].data.fd] ;
+				pLS = ls[hzConnTable::Socket(eventAr[nC].data.u64)] ;
 				pSSL = 0 ;
 				cliLen = sizeof(SOCKADDRIN) ;
 
-				if ((aSock = accept(pLS->GetSocket(), &cliAddr, &cliLen)) < 0)
+				if ((aSock = accept(pLS->GetSocket(), (SOCKADDR*) &cliAddrIn, &cliLen)) < 0)
 				{
 					m_pLog->Log(_fn, "Listening socket %d will not accept client on port %d\n", aSock, pLS->GetPort()) ;
 					continue ;
@@ -2615,15 +5396,30 @@ void	hzIpServer::ServeEpollMT	(void)
 				if (fcntl(cSock, F_SETFL, flags) == -1)
 					Fatal("%s. Could not make client socket %d non blocking (case 2)\n", *_fn, cSock) ;
 
-				//	Add client socker to the epoll control
-				epEventNew.data.fd = cSock ;
-				epEventNew.events = EPOLLIN | EPOLLET ;
-				if (epoll_ctl(epollSocket, EPOLL_CTL_ADD, cSock, &epEventNew) < 0)
-					Fatal("%s. Could not add client socket %d to control\n", *_fn, cSock) ;
-
-				//	Get the IP address
+				//	Get the IP address and port
 				inet_ntop(AF_INET, &cliAddrIn.sin_addr, ipbuf, 16) ;
 				ipa = ipbuf ;
+				cPort = ntohs(cliAddrIn.sin_port) ;
+
+				//	Check if client is blocked
+				if (_hzGlobal_StatusIP.Blocked(ipa, &nAttempts))
+				{
+					if (!(nAttempts%100))		m_pLog->Log(_fn, "BLOCKED IP %s reaches %u attempts\n", ipbuf, nAttempts) ;
+					if (close(cSock) < 0)		m_pLog->Log(_fn, "ERROR: Could not close socket %d after blocked IP address detected. errno=%d\n", cSock, errno) ;
+
+					nBannedAttempts++ ;
+					if (!(nBannedAttempts%10000))
+						m_pLog->Log(_fn, "BLOCKED IP TOTAL reaches %u attempts\n", nBannedAttempts) ;
+					continue ;
+				}
+
+				//	Apply the connection rate limits of the port
+				if (pLS->AdmitConn(ipa) != HZ_RATE_NONE)
+				{
+					if ((pLS->RefusedConns()%100) == 1)	m_pLog->Log(_fn, "RATE LIMIT: Port %d has refused %u connections (latest from %s)\n", pLS->GetPort(), pLS->RefusedConns(), ipbuf) ;
+					if (close(cSock) < 0)				m_pLog->Log(_fn, "ERROR: Could not close socket %d after rate limit refusal. errno=%d\n", cSock, errno) ;
+					continue ;
+				}
 
 				//	Deal with the case where we have too many connections or we are shutting down.
 				if (m_bShutdown || (pLS->GetCurConnections() >= pLS->GetMaxConnections()))
@@ -2652,56 +5448,20 @@ void	hzIpServer::ServeEpollMT	(void)
 				if (setsockopt(cSock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
 					{ m_pLog->Log(_fn, "Could not set recv socket options\n") ; continue ; }
 
-				//	Do we have SSL on top of connection?
+				//	Do we have SSL on top of connection? If so create the SSL session now but leave the handshake to be driven by the epoll loop
 				if (pLS->UseSSL())
 				{
-					//	Create a new SSL session instance
 					pSSL = SSL_new(s_svrCTX) ;
 					if (!pSSL)
-						{ m_pLog->Log(_fn, "Failed to allocate an SSL instance on port %d\n", pLS->GetPort()) ; continue ; }
-					m_pLog->Log(_fn, "Allocated SSL instance on port %d\n", pLS->GetPort()) ;
-
-					//	Set the SSL session socket
-					SSL_set_fd(pSSL, cSock) ;
-
-					sys_rc = SSL_accept(pSSL) ;
-					if (sys_rc <= 0)
 					{
-						m_pLog->Log(_fn, "NOTE: Failed to accept SSL client on port %d socket %d (error=%d,%d)\n",
-							pLS->GetPort(), cSock, sys_rc, SSL_get_error(pSSL, sys_rc)) ;
-						SSL_free(pSSL) ;
+						m_pLog->Log(_fn, "Failed to allocate an SSL instance on port %d\n", pLS->GetPort()) ;
 						if (close(cSock) < 0)
-							m_pLog->Log(_fn, "NOTE: Could not close socket %d after SSL fail_accept\n", cSock) ;
-						m_pLog->Log(_fn, "Closed socket\n") ;
+							m_pLog->Log(_fn, "NOTE: Could not close socket %d after SSL no_alloc\n", cSock) ;
 						continue ;
 					}
 
-					m_pLog->Log(_fn, "SSL connection using %s\n", SSL_get_cipher(pSSL)) ;
-
-					if (verify_callback)
-					{
-  						//	Get the client's certificate (optional)
-  						client_cert = SSL_get_peer_certificate(pSSL);
-
-						if (client_cert != NULL)
-						{
-							clicert_str = X509_NAME_oneline(X509_get_subject_name(client_cert), 0, 0);
-							if (!clicert_str)
-								{ m_pLog->Log(_fn, "No Client Certificate found\n") ; continue ; }
-							m_pLog->Log(_fn, "Subject of Client Cert: %s\n", clicert_str) ;
-							free(clicert_str) ;
-
-							clicert_str = X509_NAME_oneline(X509_get_issuer_name(client_cert), 0, 0);
-							if (!clicert_str)
-								{ m_pLog->Log(_fn, "No Client Cert Issuer found\n") ; continue ; }
-							m_pLog->Log(_fn, "Issuer of Client Cert: %s\n", clicert_str) ;
-							free(clicert_str) ;
-
-							X509_free(client_cert);
-						}
-						else
-							printf("The SSL client does not have certificate.\n");
-					}
+					SSL_set_accept_state(pSSL) ;
+					SSL_set_fd(pSSL, cSock) ;
 				}
 
 				//	If the listening socket is for a session handler, deal with this here
@@ -2726,47 +5486,109 @@ void	hzIpServer::ServeEpollMT	(void)
 				**	Allocate the connected client object
 				*/
 
-				pCC = allCC[cSock] ;
+				pCC = m_Conns[cSock] ;
 				if (!pCC)
 				{
-					pCC = new hzIpConnex(m_pLog) ;
+					pCC = m_Conns.Acquire() ;
 					if (!pCC)
 						hzexit(_fn, 0, E_MEMORY, "No memory for new client connection\n") ;
-					allCC.Insert(cSock, pCC) ;
 				}
 
+				nTag = m_Conns.Insert(cSock, pCC) ;
+				if (!nTag)
+					hzexit(_fn, 0, E_MEMORY, "No memory for connection table (socket %d)\n", cSock) ;
+
+				//	Add client socket to the epoll control, tagged with the slot generation
+				epEventNew.data.u64 = nTag ;
+				epEventNew.events = EPOLLIN | EPOLLET ;
+				if (epoll_ctl(epollSocket, EPOLL_CTL_ADD, cSock, &epEventNew) < 0)
+					Fatal("%s. Could not add client socket %d to control\n", *_fn, cSock) ;
+
 				m_pLog->Log(_fn, "New client connection on socket %d\n", cSock) ;
 
 				//	Initialize and oxygenate the connection
 				pCC->Initialize(pLS, pSSL, ipbuf, cSock, cPort, nCliSeq++) ;
 
+				//	On a secure connection, the server hello (if any) must wait for the TLS handshake
+				if (pCC->IsHandshake())
+				{
+					__atomic_add_fetch(&m_nTlsBegun, 1, __ATOMIC_RELAXED) ;
+					pCC->SetHandshakeLimit(nsNow + (uint64_t) m_nTlsTimeout * 1000000000) ;
+					wheel.Arm(&pCC->m_Timer, pCC->Deadline()) ;
+					continue ;
+				}
+
+				wheel.Arm(&pCC->m_Timer, pCC->Deadline()) ;
+
 				if (pCC->m_OnConnect)
 				{
 					if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
 						m_pLog->Log(_fn, "Client %d (sock %d): Issuing server hello\n", pCC->EventNo(), pCC->CliSocket()) ;
 					pCC->m_OnConnect(pCC) ;
+					if (pCC->_isxmit())
+						_respond(pCC) ;
 				}
 
 				continue ;
 			}
 
-			//	Deal with connected clients here.
+			//	Deal with connected clients here. Firstly advance any TLS handshake in progress.
+
+			cSock = hzConnTable::Socket(eventAr[nC].data.u64) ;
+			pCC = m_Conns[cSock] ;
+			if (pCC && pCC->IsHandshake())
+			{
+				hsr = pCC->Handshake() ;
+
+				if (hsr == HANDSHAKE_WANT_WRITE || (eventAr[nC].events & EPOLLOUT))
+				{
+					epEventNew.data.u64 = pCC->EventTag() ;
+					epEventNew.events = hsr == HANDSHAKE_WANT_WRITE ? EPOLLIN | EPOLLOUT | EPOLLET : EPOLLIN | EPOLLET ;
+					if (epoll_ctl(epollSocket, EPOLL_CTL_MOD, cSock, &epEventNew) < 0)
+						m_pLog->Log(_fn, "Could not modify handshake events on socket %d. Error=%s\n", cSock, strerror(errno)) ;
+				}
+
+				if (hsr == HANDSHAKE_WANT_READ || hsr == HANDSHAKE_WANT_WRITE)
+					continue ;
+
+				if (hsr == HANDSHAKE_FAILED)
+				{
+					__atomic_add_fetch(&m_nTlsFailed, 1, __ATOMIC_RELAXED) ;
+					pCC->Terminate() ;
+					continue ;
+				}
+
+				_tlsDone(pCC) ;
+				if (pCC->m_OnConnect)
+				{
+					pCC->m_OnConnect(pCC) ;
+					if (pCC->_isxmit())
+						_respond(pCC) ;
+				}
+
+				//	In edge-triggered mode, data that arrived with the final handshake flight will not be notified again so always attempt a read
+				eventAr[nC].events = EPOLLIN ;
+			}
 
 			if (eventAr[nC].events & EPOLLOUT)
 			{
-				//	Should not get this as we are not asking for these notifications
-				cSock = eventAr[nC].data.fd ;
+				//	Writability is only polled for while a connection has output its socket would not take (see hzIpConnex::_wantWrite), so pass the connection
+				//	to the response thread to write more
+				cSock = hzConnTable::Socket(eventAr[nC].data.u64) ;
 
-				m_pLog->Log(_fn, "WHAT??? write event on socket %d\n", cSock) ;
-				continue ;
+				pCC = m_Conns[cSock] ;
+				if (!pCC)
+					m_pLog->Log(_fn, "WHAT??? write event on socket %d but no connector!\n", cSock) ;
+				else if (pCC->_isxmit())
+					_respond(pCC) ;
 			}
 
 			if (eventAr[nC].events & EPOLLIN)
 			{
 				//	At this point we have date on the socket to be read, at least in theory
-				cSock = eventAr[nC].data.fd ;
+				cSock = hzConnTable::Socket(eventAr[nC].data.u64) ;
 
-				pCC = allCC[cSock] ;
+				pCC = m_Conns[cSock] ;
 				if (!pCC)
 				{
 					m_pLog->Log(_fn, "WHAT??? read event on socket %d but no connector!\n", cSock) ;
@@ -2806,60 +5628,38 @@ void	hzIpServer::ServeEpollMT	(void)
 					//		m_pLog->Out("]\n") ;
 					//	}
 
+					__atomic_add_fetch(&pCC->m_nReqHold, 1, __ATOMIC_ACQ_REL) ;
 					s_queRequests.Push(pCC) ;
 					pthread_cond_signal(&s_request_cond) ;
 				}
 			}
 		}
 
-		//	Kill off any inactive and out of date keep-alive connections - but only if there is a delay between polls
-		if ((nsNow - nsThen) > 100000000)
+		//	Expire connections whose deadlines have passed (see ServeEpollST). Connections with a request or response in the hands of the request and response
+		//	threads are left to those threads and checked again a second later.
+		for (pTm = wheel.Expire(nsNow) ; pTm ; pTm = pTmNext)
 		{
-			if (_hzGlobal_Debug & HZ_DEBUG_SERVER)
-				m_pLog->Log(_fn, "Purging ...\n") ;
-
-			for (nX = 0 ; nX < allCC.Count() ; nX++)
-			{
-				pCC = allCC.GetObj(nX) ;
-
-				if (!pCC)
-					continue ;
-
-				if (!pCC->CliSocket())
-					continue ;
-
-				if (pCC->_isxmit())
-				{
-					err = pCC->_xmit(tbuf) ;
-					continue ;
-				}
+			pTmNext = pTm->m_pNext ;
+			pCC = (hzIpConnex*) pTm->m_pObj ;
 
-				/*
-				if (pCC->State() == HZCONNEX_FAIL)
-				{
-					if (now < pCC->Expires())
-						continue ;
-					
-					//pCC->StateDone() ;
-					pCC->SetState(*_fn, HZCONNEX_DONE) ;
-					if (m_pLog)
-						m_pLog->Log(_fn, "Client (ev %d sock %d state %d) vgn %d: Failed, removed\n",
-							pCC->EventNo(), pCC->CliSocket(), pCC->State(), pCC->IsVirgin() ? 1 : 0) ;
-					pCC->Terminate() ;
-					continue ;
-				}
-				*/
+			if (nsNow < pCC->Deadline())
+				{ wheel.Arm(pTm, pCC->Deadline()) ; continue ; }
 
-				if (!pCC->SizeIn() && (nsNow > pCC->Expires()))
-				{
-					//pCC->StateDone() ;
-					//pCC->SetState(*_fn, HZCONNEX_DONE) ;
-					//m_pLog->Log(_fn, "Client (ev %d sock %d state %d) vgn %d: Inactive, removed\n",
-					//	pCC->EventNo(), pCC->CliSocket(), pCC->State(), pCC->IsVirgin() ? 1 : 0) ;
-					m_pLog->Log(_fn, "Client (ev %d sock %d) vgn %d: Inactive, removed\n", pCC->EventNo(), pCC->CliSocket(), pCC->IsVirgin() ? 1 : 0) ;
-					pCC->Terminate() ;
-				}
+			if (pCC->IsHandshake())
+				__atomic_add_fetch(&m_nTlsExpired, 1, __ATOMIC_RELAXED) ;
+			else
+			{
+				if (pCC->SizeIn() || pCC->_isxmit())
+					{ wheel.Arm(pTm, nsNow + 1000000000) ; continue ; }
+				if (pCC->m_OnIdle && pCC->m_OnIdle(pCC) == TCP_KEEPALIVE)
+					{ _respond(pCC) ; wheel.Arm(pTm, pCC->Deadline()) ; continue ; }
+				m_nExpIdle++ ;
 			}
+
+			m_pLog->Log(_fn, "Client (ev %d sock %d) vgn %d: %s, removed\n",
+				pCC->EventNo(), pCC->CliSocket(), pCC->IsVirgin() ? 1 : 0, pCC->IsHandshake() ? "TLS handshake time limit exceeded" : "Inactive") ;
+			pCC->MetricExpired() ;
+			pCC->Terminate() ;
 		}
 	}
 
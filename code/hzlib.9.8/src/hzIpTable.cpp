@@ -0,0 +1,862 @@
+//
+//	File:	hzIpTable.cpp
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hzErrcode.h"
+#include "hzKeyhash.h"
+#include "hzDirectory.h"
+#include "hzProcess.h"
+#include "hzIpTable.h"
+
+using namespace std ;
+
+/*
+**	Non member functions
+*/
+
+static	uint32_t	_decay	(const _hz_ipslot& slot, uint32_t now)
+{
+	//	Return the offence score of the slot as it stands at the given time, having halved for each HZ_IPTAB_HALFLIFE elapsed since it was last decayed
+	//
+	//	Arguments:	1)	slot	The slot
+	//				2)	now		Epoch time
+	//
+	//	Returns:	The decayed score
+
+	uint32_t	nHalves ;	//	Half lives elapsed
+
+	if (!slot.m_nScore || now <= slot.m_tScore)
+		return slot.m_nScore ;
+
+	nHalves = (now - slot.m_tScore) / HZ_IPTAB_HALFLIFE ;
+	return nHalves >= 16 ? 0 : slot.m_nScore >> nHalves ;
+}
+
+static	bool	_black	(const _hz_ipslot& slot, uint32_t now)	{ return slot.m_bInfo & HZ_IPSTATUS_BLACK && (!slot.m_tBlack || slot.m_tBlack > now) ; }
+static	bool	_white	(const _hz_ipslot& slot, uint32_t now)	{ return slot.m_bInfo & HZ_IPSTATUS_WHITE && (!slot.m_tWhite || slot.m_tWhite > now) ; }
+
+static	bool	_lapsed	(const _hz_ipslot& slot, uint32_t now)
+{
+	//	Return true if the slot is unused or if the address it holds has no status in force and no offence score, so that the slot may be taken by another address
+
+	return !slot.m_nAddr || (!_black(slot, now) && !_white(slot, now) && !_decay(slot, now)) ;
+}
+
+/*
+**	hzIpTable members
+*/
+
+hzIpTable::hzIpTable	(void)
+{
+	m_pSlots = 0 ;
+	m_pRanges = 0 ;
+	m_nSlots = m_nMask = m_nCount = 0 ;
+	m_nThreshold = HZ_IPTAB_THRESHOLD ;
+	m_nBlockSecs = HZ_IPTAB_BLOCKSECS ;
+}
+
+hzIpTable::~hzIpTable	(void)
+{
+	_hz_iprange_set*	pSet ;	//	Range array
+	_hz_iprange_set*	pPrev ;	//	Replaced range array
+
+	if (m_Journal.is_open())
+		m_Journal.close() ;
+
+	for (pSet = m_pRanges ; pSet ; pSet = pPrev)
+		{ pPrev = pSet->m_pPrev ; free(pSet) ; }
+
+	delete [] m_pSlots ;
+}
+
+hzEcode	hzIpTable::Init	(uint32_t nSlots)
+{
+	//	Allocate the slots. This need only be called if a size other than the default is required, as the slots are otherwise allocated on first update.
+	//
+	//	Arguments:	1)	nSlots	Number of slots (rounded up to a power of 2, minimum 1024)
+	//
+	//	Returns:	E_INITDUP	If the slots are already allocated
+	//				E_MEMORY	If the slots could not be allocated
+	//				E_OK		If the table is ready
+
+	_hzfunc("hzIpTable::Init") ;
+
+	_hz_ipslot*	pSlots ;	//	The slots
+	uint32_t	nSize ;		//	Number of slots
+
+	if (m_pSlots)
+		return E_INITDUP ;
+
+	for (nSize = 1024 ; nSize < nSlots && nSize < 0x40000000 ; nSize <<= 1) ;
+
+	pSlots = new _hz_ipslot[nSize] ;
+	if (!pSlots)
+		return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not allocate %u slots", nSize) ;
+	memset(pSlots, 0, nSize * sizeof(_hz_ipslot)) ;
+
+	m_nSlots = nSize ;
+	m_nMask = nSize - 1 ;
+	__atomic_store_n(&m_pSlots, pSlots, __ATOMIC_RELEASE) ;
+	return E_OK ;
+}
+
+_hz_ipslot*	hzIpTable::_find	(uint32_t nAddr) const
+{
+	//	Find the slot holding the address. No lock is taken so the slot may be taken by another address at any time. Readers must use _read().
+	//
+	//	Arguments:	1)	nAddr	The IP address
+	//
+	//	Returns:	Pointer to the slot
+	//				NULL if the address is not in the table
+
+	_hz_ipslot*	pSlots ;	//	The slots
+	uint32_t	nHash ;		//	Start of probe
+	uint32_t	nAt ;		//	Slot address
+	uint32_t	n ;			//	Probe iterator
+
+	pSlots = __atomic_load_n(&m_pSlots, __ATOMIC_ACQUIRE) ;
+	if (!pSlots || !nAddr)
+		return 0 ;
+
+	nHash = _hz_hashmix(nAddr) ;
+	for (n = 0 ; n < HZ_IPTAB_PROBE ; n++)
+	{
+		nAt = __atomic_load_n(&pSlots[(nHash + n) & m_nMask].m_nAddr, __ATOMIC_ACQUIRE) ;
+		if (nAt == nAddr)
+			return pSlots + ((nHash + n) & m_nMask) ;
+		if (!nAt)
+			break ;
+	}
+	return 0 ;
+}
+
+bool	hzIpTable::_read	(const _hz_ipslot* pSlot, uint32_t nAddr, _hz_ipslot& copy) const
+{
+	//	Take a consistent copy of the slot, retrying should a writer change it meanwhile.
+	//
+	//	Arguments:	1)	pSlot	The slot
+	//				2)	nAddr	The address expected in the slot
+	//				3)	copy	The copy
+	//
+	//	Returns:	True if the copy is of the expected address
+	//				False if the slot has been taken by another address
+
+	uint32_t	nSeq ;		//	Sequence at start
+
+	for (;;)
+	{
+		nSeq = __atomic_load_n(&pSlot->m_nSeq, __ATOMIC_ACQUIRE) ;
+		if (nSeq & 1)
+			continue ;
+
+		copy.m_nAddr = __atomic_load_n(&pSlot->m_nAddr, __ATOMIC_RELAXED) ;
+		copy.m_tBlack = __atomic_load_n(&pSlot->m_tBlack, __ATOMIC_RELAXED) ;
+		copy.m_tWhite = __atomic_load_n(&pSlot->m_tWhite, __ATOMIC_RELAXED) ;
+		copy.m_tScore = __atomic_load_n(&pSlot->m_tScore, __ATOMIC_RELAXED) ;
+		copy.m_nTotal = __atomic_load_n(&pSlot->m_nTotal, __ATOMIC_RELAXED) ;
+		copy.m_nSince = __atomic_load_n(&pSlot->m_nSince, __ATOMIC_RELAXED) ;
+		copy.m_nScore = __atomic_load_n(&pSlot->m_nScore, __ATOMIC_RELAXED) ;
+		copy.m_bInfo = __atomic_load_n(&pSlot->m_bInfo, __ATOMIC_RELAXED) ;
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE) ;
+		if (__atomic_load_n(&pSlot->m_nSeq, __ATOMIC_RELAXED) == nSeq)
+			break ;
+	}
+
+	copy.m_nSeq = nSeq ;
+	return copy.m_nAddr == nAddr ;
+}
+
+void	hzIpTable::_write	(_hz_ipslot* pSlot, const _hz_ipslot& value)
+{
+	//	Update the slot. The sequence is odd for the duration so that readers retry. The caller must hold the writer lock.
+	//
+	//	Arguments:	1)	pSlot	The slot
+	//				2)	value	The new value
+	//
+	//	Returns:	None
+
+	__atomic_store_n(&pSlot->m_nSeq, pSlot->m_nSeq + 1, __ATOMIC_RELAXED) ;
+	__atomic_thread_fence(__ATOMIC_RELEASE) ;
+
+	__atomic_store_n(&pSlot->m_tBlack, value.m_tBlack, __ATOMIC_RELAXED) ;
+	__atomic_store_n(&pSlot->m_tWhite, value.m_tWhite, __ATOMIC_RELAXED) ;
+	__atomic_store_n(&pSlot->m_tScore, value.m_tScore, __ATOMIC_RELAXED) ;
+	__atomic_store_n(&pSlot->m_nTotal, value.m_nTotal, __ATOMIC_RELAXED) ;
+	__atomic_store_n(&pSlot->m_nSince, value.m_nSince, __ATOMIC_RELAXED) ;
+	__atomic_store_n(&pSlot->m_nScore, value.m_nScore, __ATOMIC_RELAXED) ;
+	__atomic_store_n(&pSlot->m_bInfo, value.m_bInfo, __ATOMIC_RELAXED) ;
+	__atomic_store_n(&pSlot->m_nAddr, value.m_nAddr, __ATOMIC_RELEASE) ;
+
+	__atomic_store_n(&pSlot->m_nSeq, pSlot->m_nSeq + 1, __ATOMIC_RELEASE) ;
+}
+
+_hz_ipslot*	hzIpTable::_claim	(uint32_t nAddr, uint32_t now)
+{
+	//	Find the slot holding the address or failing that, claim a slot for it. An unused slot is preferred but a slot whose address has lapsed will do. The
+	//	caller must hold the writer lock.
+	//
+	//	Arguments:	1)	nAddr	The IP address
+	//				2)	now		Epoch time
+	//
+	//	Returns:	Pointer to the slot
+	//				NULL if there is no slot available within the probe length
+
+	_hz_ipslot*	pSlot ;		//	Current slot
+	_hz_ipslot*	pFree ;		//	First lapsed slot
+	_hz_ipslot	value ;		//	Value of new slot
+	uint32_t	nHash ;		//	Start of probe
+	uint32_t	n ;			//	Probe iterator
+
+	if (!m_pSlots && Init(HZ_IPTAB_SLOTS) != E_OK)
+		return 0 ;
+
+	nHash = _hz_hashmix(nAddr) ;
+	for (pFree = 0, n = 0 ; n < HZ_IPTAB_PROBE ; n++)
+	{
+		pSlot = m_pSlots + ((nHash + n) & m_nMask) ;
+
+		if (pSlot->m_nAddr == nAddr)
+			return pSlot ;
+
+		if (!pSlot->m_nAddr)
+		{
+			if (!pFree)
+				{ pFree = pSlot ; m_nCount++ ; }
+			break ;
+		}
+
+		if (!pFree && _lapsed(*pSlot, now))
+			pFree = pSlot ;
+	}
+
+	if (!pFree)
+		return 0 ;
+
+	memset(&value, 0, sizeof(value)) ;
+	value.m_nAddr = nAddr ;
+	value.m_tScore = now ;
+	_write(pFree, value) ;
+	return pFree ;
+}
+
+void	hzIpTable::_journal	(const _hz_ipslot& slot)
+{
+	//	Append the slot to the journal (if there is one). The caller must hold the writer lock.
+	//
+	//	Arguments:	1)	slot	The slot
+	//
+	//	Returns:	None
+
+	hzIpaddr	ipa ;		//	IP address
+	hzRecep16	r16 ;		//	IP address text
+	char		buf[96] ;	//	Line
+
+	if (!m_Journal.is_open())
+		return ;
+
+	ipa = slot.m_nAddr ;
+	sprintf(buf, "%s %x %u %u %u %u %u\n", ipa.Txt(r16), slot.m_bInfo, slot.m_tBlack, slot.m_tWhite, slot.m_nTotal, slot.m_nScore, slot.m_tScore) ;
+	m_Journal << buf ;
+	m_Journal.flush() ;
+}
+
+void	hzIpTable::_journal	(const _hz_iprange& range)
+{
+	//	Append the range to the journal (if there is one). The caller must hold the writer lock.
+	//
+	//	Arguments:	1)	range	The range
+	//
+	//	Returns:	None
+
+	hzIpaddr	a ;			//	First IP address
+	hzIpaddr	b ;			//	Last IP address
+	hzRecep16	ra ;		//	First IP address text
+	hzRecep16	rb ;		//	Last IP address text
+	char		buf[64] ;	//	Line
+
+	if (!m_Journal.is_open())
+		return ;
+
+	a = range.m_nStart ;
+	b = range.m_nEnd ;
+	sprintf(buf, "R %s %s %u\n", a.Txt(ra), b.Txt(rb), range.m_tExpire) ;
+	m_Journal << buf ;
+	m_Journal.flush() ;
+}
+
+void	hzIpTable::Set	(hzIpaddr ipa, hzIpStatus reason, uint32_t nDelay)
+{
+	//	Black and/or white list the IP address for the given reason(s). The localhost, null and invalid addresses are ignored.
+	//
+	//	Arguments:	1)	ipa		The IP address
+	//				2)	reason	The reason(s), being one or more of the HZ_IPSTATUS_BLACK_* and HZ_IPSTATUS_WHITE_* values
+	//				3)	nDelay	Number of seconds the status is to remain in force (0 for indefinitely)
+	//
+	//	Returns:	None
+
+	_hzfunc("hzIpTable::Set") ;
+
+	_hz_ipslot*	pSlot ;		//	The slot
+	_hz_ipslot	value ;		//	New value
+	uint32_t	now ;		//	Epoch time
+
+	if (ipa == IPADDR_BAD || ipa == IPADDR_NULL || ipa == IPADDR_LOCAL)
+		return ;
+
+	now = time(0) ;
+	m_Lock.Lock() ;
+
+	pSlot = _claim(ipa, now) ;
+	if (!pSlot)
+		threadLog("%s: No slot available for IP %s\n", *_fn, *ipa.Str()) ;
+	else
+	{
+		value = *pSlot ;
+		if (reason & HZ_IPSTATUS_BLACK)
+		{
+			value.m_bInfo |= (reason & HZ_IPSTATUS_BLACK) ;
+			value.m_tBlack = nDelay ? now + nDelay : 0 ;
+			value.m_nSince = 0 ;
+		}
+		if (reason & HZ_IPSTATUS_WHITE)
+		{
+			value.m_bInfo |= (reason & HZ_IPSTATUS_WHITE) ;
+			value.m_tWhite = nDelay ? now + nDelay : 0 ;
+		}
+		_write(pSlot, value) ;
+		_journal(value) ;
+	}
+
+	m_Lock.Unlock() ;
+}
+
+void	hzIpTable::Lift	(hzIpaddr ipa, hzIpStatus reason)
+{
+	//	Remove the given reason(s) from the status of the IP address. Lifting all black listing reasons also clears the offence score.
+	//
+	//	Arguments:	1)	ipa		The IP address
+	//				2)	reason	The reason(s) to remove
+	//
+	//	Returns:	None
+
+	_hz_ipslot*	pSlot ;		//	The slot
+	_hz_ipslot	value ;		//	New value
+
+	m_Lock.Lock() ;
+
+	pSlot = _find(ipa) ;
+	if (pSlot)
+	{
+		value = *pSlot ;
+		value.m_bInfo &= ~reason ;
+		if (!(value.m_bInfo & HZ_IPSTATUS_BLACK))
+			value.m_nScore = 0 ;
+		_write(pSlot, value) ;
+		_journal(value) ;
+	}
+
+	m_Lock.Unlock() ;
+}
+
+uint32_t	hzIpTable::Offence	(hzIpaddr ipa, hzIpStatus reason, uint32_t nWeight)
+{
+	//	Add to the offence score of the IP address. If the (decayed) score reaches the threshold, the address is black listed for the given reason.
+	//
+	//	Arguments:	1)	ipa		The IP address
+	//				2)	reason	The black listing reason
+	//				3)	nWeight	Amount to add to the score
+	//
+	//	Returns:	The offence score
+
+	_hz_ipslot*	pSlot ;		//	The slot
+	_hz_ipslot	value ;		//	New value
+	uint32_t	now ;		//	Epoch time
+	uint32_t	nScore ;	//	Offence score
+
+	if (ipa == IPADDR_BAD || ipa == IPADDR_NULL || ipa == IPADDR_LOCAL)
+		return 0 ;
+
+	now = time(0) ;
+	nScore = 0 ;
+	m_Lock.Lock() ;
+
+	pSlot = _claim(ipa, now) ;
+	if (pSlot)
+	{
+		value = *pSlot ;
+		nScore = _decay(value, now) + nWeight ;
+		if (nScore > 0xffff)
+			nScore = 0xffff ;
+		value.m_nScore = nScore ;
+		value.m_tScore = now ;
+
+		if (nScore >= m_nThreshold && (reason & HZ_IPSTATUS_BLACK) && !_black(value, now))
+		{
+			value.m_bInfo |= (reason & HZ_IPSTATUS_BLACK) ;
+			value.m_tBlack = now + m_nBlockSecs ;
+			value.m_nSince = 0 ;
+		}
+		_write(pSlot, value) ;
+		_journal(value) ;
+	}
+
+	m_Lock.Unlock() ;
+	return nScore ;
+}
+
+void	hzIpTable::_setRanges	(_hz_iprange_set* pSet)
+{
+	//	Compute the running maximum of the range ends and publish the range array. The replaced array is retained (as a reader may still be using it). The
+	//	caller must hold the writer lock.
+	//
+	//	Arguments:	1)	pSet	The new range array
+	//
+	//	Returns:	None
+
+	uint32_t	nMax ;	//	Running maximum
+	uint32_t	n ;		//	Range iterator
+
+	for (nMax = 0, n = 0 ; n < pSet->m_nCount ; n++)
+	{
+		if (pSet->m_Ranges[n].m_nEnd > nMax)
+			nMax = pSet->m_Ranges[n].m_nEnd ;
+		pSet->m_Ranges[n].m_nMaxEnd = nMax ;
+	}
+
+	pSet->m_pPrev = m_pRanges ;
+	__atomic_store_n(&m_pRanges, pSet, __ATOMIC_RELEASE) ;
+}
+
+hzEcode	hzIpTable::BlockRange	(const hzIpRange& range, uint32_t nDelay)
+{
+	//	Black list a range of IP addresses. If the range is already black listed, its expiry is updated.
+	//
+	//	Arguments:	1)	range	The range
+	//				2)	nDelay	Number of seconds the black listing is to remain in force (0 for indefinitely)
+	//
+	//	Returns:	E_ARGUMENT	If the range is invalid
+	//				E_MEMORY	If the range array could not be allocated
+	//				E_OK		If the range is black listed
+
+	_hzfunc("hzIpTable::BlockRange") ;
+
+	_hz_iprange_set*	pOld ;		//	Current range array
+	_hz_iprange_set*	pNew ;		//	New range array
+	_hz_iprange			rng ;		//	New range
+	uint32_t			now ;		//	Epoch time
+	uint32_t			nMax ;		//	Capacity of new array
+	uint32_t			n ;			//	Range iterator
+
+	if (!range.m_Start || range.m_End < range.m_Start)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Invalid range") ;
+
+	now = time(0) ;
+	rng.m_nStart = range.m_Start ;
+	rng.m_nEnd = range.m_End ;
+	rng.m_nMaxEnd = 0 ;
+	rng.m_tExpire = nDelay ? now + nDelay : 0 ;
+
+	m_Lock.Lock() ;
+
+	pOld = m_pRanges ;
+	nMax = (pOld ? pOld->m_nCount : 0) + 1 ;
+	pNew = (_hz_iprange_set*) malloc(sizeof(_hz_iprange_set) + nMax * sizeof(_hz_iprange)) ;
+	if (!pNew)
+		{ m_Lock.Unlock() ; return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not allocate %u ranges", nMax) ; }
+
+	//	Copy the ranges still in force, inserting the new range in order of first address
+	pNew->m_nCount = 0 ;
+	for (n = 0 ; pOld && n < pOld->m_nCount ; n++)
+	{
+		if (pOld->m_Ranges[n].m_tExpire && pOld->m_Ranges[n].m_tExpire <= now)
+			continue ;
+		if (pOld->m_Ranges[n].m_nStart == rng.m_nStart && pOld->m_Ranges[n].m_nEnd == rng.m_nEnd)
+			continue ;
+		if (rng.m_nStart && pOld->m_Ranges[n].m_nStart > rng.m_nStart)
+			{ pNew->m_Ranges[pNew->m_nCount++] = rng ; rng.m_nStart = 0 ; }
+		pNew->m_Ranges[pNew->m_nCount++] = pOld->m_Ranges[n] ;
+	}
+	if (rng.m_nStart)
+		pNew->m_Ranges[pNew->m_nCount++] = rng ;
+
+	_setRanges(pNew) ;
+
+	rng.m_nStart = range.m_Start ;
+	_journal(rng) ;
+	m_Lock.Unlock() ;
+	return E_OK ;
+}
+
+hzEcode	hzIpTable::UnblockRange	(const hzIpRange& range)
+{
+	//	Remove a black listed range of IP addresses
+	//
+	//	Arguments:	1)	range	The range (which must match a range supplied to BlockRange)
+	//
+	//	Returns:	E_NOTFOUND	If the range is not black listed
+	//				E_MEMORY	If the range array could not be allocated
+	//				E_OK		If the range is removed
+
+	_hzfunc("hzIpTable::UnblockRange") ;
+
+	_hz_iprange_set*	pOld ;		//	Current range array
+	_hz_iprange_set*	pNew ;		//	New range array
+	_hz_iprange			rng ;		//	Range (as journaled)
+	uint32_t			n ;			//	Range iterator
+
+	m_Lock.Lock() ;
+
+	pOld = m_pRanges ;
+	for (n = 0 ; pOld && n < pOld->m_nCount ; n++)
+	{
+		if (pOld->m_Ranges[n].m_nStart == (uint32_t) range.m_Start && pOld->m_Ranges[n].m_nEnd == (uint32_t) range.m_End)
+			break ;
+	}
+
+	if (!pOld || n == pOld->m_nCount)
+		{ m_Lock.Unlock() ; return E_NOTFOUND ; }
+
+	pNew = (_hz_iprange_set*) malloc(sizeof(_hz_iprange_set) + pOld->m_nCount * sizeof(_hz_iprange)) ;
+	if (!pNew)
+		{ m_Lock.Unlock() ; return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not allocate %u ranges", pOld->m_nCount) ; }
+
+	pNew->m_nCount = 0 ;
+	for (n = 0 ; n < pOld->m_nCount ; n++)
+	{
+		if (pOld->m_Ranges[n].m_nStart == (uint32_t) range.m_Start && pOld->m_Ranges[n].m_nEnd == (uint32_t) range.m_End)
+			continue ;
+		pNew->m_Ranges[pNew->m_nCount++] = pOld->m_Ranges[n] ;
+	}
+	_setRanges(pNew) ;
+
+	//	An expiry in the past marks the range as removed in the journal
+	rng.m_nStart = range.m_Start ;
+	rng.m_nEnd = range.m_End ;
+	rng.m_tExpire = 1 ;
+	_journal(rng) ;
+
+	m_Lock.Unlock() ;
+	return E_OK ;
+}
+
+bool	hzIpTable::_inRange	(uint32_t nAddr, uint32_t now) const
+{
+	//	Determine if the address falls within a black listed range that is in force. This is a binary search for the last range starting at or below the
+	//	address, followed by a backwards scan for as long as earlier ranges could still reach the address.
+	//
+	//	Arguments:	1)	nAddr	The IP address
+	//				2)	now		Epoch time
+	//
+	//	Returns:	True if the address is in a black listed range
+
+	const _hz_iprange_set*	pSet ;	//	Range array
+	const _hz_iprange*		pRng ;	//	Range
+	int32_t		nLo ;		//	Search low
+	int32_t		nHi ;		//	Search high
+	int32_t		nMid ;		//	Search mid
+
+	pSet = __atomic_load_n(&m_pRanges, __ATOMIC_ACQUIRE) ;
+	if (!pSet || !pSet->m_nCount)
+		return false ;
+
+	for (nLo = 0, nHi = pSet->m_nCount - 1 ; nLo <= nHi ;)
+	{
+		nMid = (nLo + nHi) / 2 ;
+		if (pSet->m_Ranges[nMid].m_nStart <= nAddr)
+			nLo = nMid + 1 ;
+		else
+			nHi = nMid - 1 ;
+	}
+
+	for (; nHi >= 0 ; nHi--)
+	{
+		pRng = pSet->m_Ranges + nHi ;
+		if (pRng->m_nMaxEnd < nAddr)
+			break ;
+		if (pRng->m_nEnd >= nAddr && (!pRng->m_tExpire || pRng->m_tExpire > now))
+			return true ;
+	}
+	return false ;
+}
+
+bool	hzIpTable::Blocked	(hzIpaddr ipa, uint32_t* pAttempts)
+{
+	//	Determine if a connection from the IP address is to be refused. This is the case if the address is black listed (either in its own right or by range)
+	//	and is not white listed. If the address is refused, the count of its refused attempts is incremented. No lock is taken.
+	//
+	//	Arguments:	1)	ipa			The IP address
+	//				2)	pAttempts	Optional pointer to the number of attempts refused since the address was last black listed
+	//
+	//	Returns:	True if the connection is to be refused
+	//				False otherwise
+
+	_hz_ipslot*	pSlot ;		//	The slot
+	_hz_ipslot	value ;		//	Copy of slot
+	uint32_t	now ;		//	Epoch time
+	uint32_t	nSince ;	//	Attempts refused
+
+	if (pAttempts)
+		*pAttempts = 0 ;
+
+	now = time(0) ;
+	pSlot = _find(ipa) ;
+	if (pSlot && _read(pSlot, ipa, value))
+	{
+		if (_white(value, now))
+			return false ;
+
+		if (_black(value, now))
+		{
+			nSince = __atomic_add_fetch(&pSlot->m_nSince, 1, __ATOMIC_RELAXED) ;
+			__atomic_add_fetch(&pSlot->m_nTotal, 1, __ATOMIC_RELAXED) ;
+			if (pAttempts)
+				*pAttempts = nSince ;
+			return true ;
+		}
+	}
+
+	return _inRange(ipa, now) ;
+}
+
+hzIpStatus	hzIpTable::Status	(hzIpaddr ipa) const
+{
+	//	Return the status of the IP address as it currently applies (expired black and white listings are omitted). No lock is taken.
+	//
+	//	Arguments:	1)	ipa		The IP address
+	//
+	//	Returns:	The status
+
+	_hz_ipslot*	pSlot ;		//	The slot
+	_hz_ipslot	value ;		//	Copy of slot
+	uint32_t	now ;		//	Epoch time
+	uint32_t	ips ;		//	IP status
+
+	now = time(0) ;
+	ips = HZ_IPSTATUS_NULL ;
+
+	pSlot = _find(ipa) ;
+	if (pSlot && _read(pSlot, ipa, value))
+	{
+		if (_white(value, now))
+			ips |= (value.m_bInfo & HZ_IPSTATUS_WHITE) ;
+		if (_black(value, now))
+			ips |= (value.m_bInfo & HZ_IPSTATUS_BLACK) ;
+	}
+
+	if (_inRange(ipa, now))
+		ips |= HZ_IPSTATUS_BLACK_RANGE ;
+
+	return (hzIpStatus) ips ;
+}
+
+bool	hzIpTable::Lookup	(hzIpaddr ipa, hzIpinfo& info) const
+{
+	//	Obtain the record of the IP address. No lock is taken.
+	//
+	//	Arguments:	1)	ipa		The IP address
+	//				2)	info	The record to populate
+	//
+	//	Returns:	True if the address is in the table
+	//				False otherwise
+
+	_hz_ipslot*	pSlot ;		//	The slot
+	_hz_ipslot	value ;		//	Copy of slot
+
+	pSlot = _find(ipa) ;
+	if (!pSlot || !_read(pSlot, ipa, value))
+		return false ;
+
+	info.m_tBlack = value.m_tBlack ;
+	info.m_tWhite = value.m_tWhite ;
+	info.m_nTotal = value.m_nTotal ;
+	info.m_nSince = value.m_nSince ;
+	info.m_nScore = _decay(value, time(0)) ;
+	info.m_bInfo = value.m_bInfo ;
+	return true ;
+}
+
+bool	hzIpTable::GetSlot	(uint32_t nSlot, hzIpaddr& ipa, hzIpinfo& info) const
+{
+	//	Obtain the record held in a given slot, for enumeration of the table
+	//
+	//	Arguments:	1)	nSlot	The slot number (0 to Slots()-1)
+	//				2)	ipa		The IP address
+	//				3)	info	The record to populate
+	//
+	//	Returns:	True if the slot is in use
+	//				False otherwise
+
+	_hz_ipslot*	pSlots ;	//	The slots
+	uint32_t	nAddr ;		//	IP address
+
+	pSlots = __atomic_load_n(&m_pSlots, __ATOMIC_ACQUIRE) ;
+	if (!pSlots || nSlot >= m_nSlots)
+		return false ;
+
+	nAddr = __atomic_load_n(&pSlots[nSlot].m_nAddr, __ATOMIC_ACQUIRE) ;
+	if (!nAddr)
+		return false ;
+
+	ipa = nAddr ;
+	return Lookup(ipa, info) ;
+}
+
+hzEcode	hzIpTable::Load	(const hzString& path)
+{
+	//	Replay the journal, then rewrite it with only the entries still in force and open it for appending, so that subsequent changes are persisted. This is
+	//	called once at startup (see InitIpInfo).
+	//
+	//	Arguments:	1)	path	The journal file
+	//
+	//	Returns:	E_ARGUMENT	If no path is supplied
+	//				E_OPENFAIL	If the journal cannot be read or written
+	//				E_OK		If the journal is loaded and open
+
+	_hzfunc("hzIpTable::Load") ;
+
+	ifstream	is ;			//	Journal (reading)
+	_hz_ipslot*	pSlot ;			//	The slot
+	_hz_ipslot	value ;			//	Slot value
+	_hz_iprange	rng ;			//	Range value
+	hzIpRange	range ;			//	Range
+	hzString	tmpPath ;		//	Compacted journal path
+	hzIpaddr	ipa ;			//	IP address
+	uint32_t	now ;			//	Epoch time
+	uint32_t	nLine ;			//	Line number
+	uint32_t	nFlags ;		//	Line value: status
+	uint32_t	tBlack ;		//	Line value: black listing expiry
+	uint32_t	tWhite ;		//	Line value: white listing expiry
+	uint32_t	nTotal ;		//	Line value: attempts
+	uint32_t	nScore ;		//	Line value: offence score
+	uint32_t	tScore ;		//	Line value: offence score time
+	uint32_t	nItems ;		//	Values found on line
+	uint32_t	n ;				//	Slot iterator
+	char		ipbuf[24] ;		//	Line value: IP address
+	char		ipend[24] ;		//	Line value: end of range
+	char		buf[128] ;		//	Line buffer
+	hzEcode		rc ;			//	Return code
+
+	if (!path)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "No journal path") ;
+
+	now = time(0) ;
+
+	rc = TestFile(path) ;
+	if (rc == E_OK)
+	{
+		is.open(*path) ;
+		if (is.fail())
+			return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Cannot open file %s", *path) ;
+
+		m_Lock.Lock() ;
+		for (nLine = 1 ;; nLine++)
+		{
+			is.getline(buf, 127) ;
+			if (!is.gcount())
+				break ;
+
+			if (buf[0] == 'R' && buf[1] == ' ')
+			{
+				//	Range
+				tBlack = 0 ;
+				if (sscanf(buf + 2, "%23s %23s %u", ipbuf, ipend, &tBlack) < 2)
+					{ threadLog("%s: Line %u of file %s, is not a valid range\n", *_fn, nLine, *path) ; continue ; }
+
+				range.m_Start = ipbuf ;
+				range.m_End = ipend ;
+				m_Lock.Unlock() ;
+				if (tBlack == 1)
+					UnblockRange(range) ;
+				else if (!tBlack || tBlack > now)
+					BlockRange(range, tBlack ? tBlack - now : 0) ;
+				m_Lock.Lock() ;
+				continue ;
+			}
+
+			nFlags = tBlack = tWhite = nTotal = nScore = tScore = 0 ;
+			nItems = sscanf(buf, "%23s %x %u %u %u %u %u", ipbuf, &nFlags, &tBlack, &tWhite, &nTotal, &nScore, &tScore) ;
+			ipa = ipbuf ;
+			if (!nItems || !ipa)
+				{ threadLog("%s: Line %u of file %s, is not a valid IP address\n", *_fn, nLine, *path) ; continue ; }
+
+			//	A line with just the address is of the earlier format, under which all listed addresses were refused
+			if (nItems == 1)
+				nFlags = HZ_IPSTATUS_BLACK_PROT ;
+
+			pSlot = _claim(ipa, now) ;
+			if (!pSlot)
+				continue ;
+
+			value = *pSlot ;
+			value.m_bInfo = nFlags ;
+			value.m_tBlack = tBlack ;
+			value.m_tWhite = tWhite ;
+			value.m_nTotal = nTotal ;
+			value.m_nScore = nScore ;
+			value.m_tScore = tScore ;
+			_write(pSlot, value) ;
+		}
+		is.close() ;
+		m_Lock.Unlock() ;
+	}
+	else if (rc != E_NOTFOUND)
+		return hzerr(_fn, HZ_ERROR, rc, "File error %s", *path) ;
+
+	//	Rewrite the journal with the entries still in force
+	m_Lock.Lock() ;
+	tmpPath = path + ".tmp" ;
+	if (m_Journal.is_open())
+		m_Journal.close() ;
+	m_Journal.clear() ;
+	m_Journal.open(*tmpPath) ;
+	if (m_Journal.fail())
+		{ m_Lock.Unlock() ; return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Cannot open %s for writing", *tmpPath) ; }
+
+	for (n = 0 ; m_pSlots && n < m_nSlots ; n++)
+	{
+		if (!_lapsed(m_pSlots[n], now))
+			_journal(m_pSlots[n]) ;
+	}
+	for (n = 0 ; m_pRanges && n < m_pRanges->m_nCount ; n++)
+	{
+		rng = m_pRanges->m_Ranges[n] ;
+		if (!rng.m_tExpire || rng.m_tExpire > now)
+			_journal(rng) ;
+	}
+	m_Journal.close() ;
+
+	if (rename(*tmpPath, *path) < 0)
+		{ m_Lock.Unlock() ; return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Cannot replace %s", *path) ; }
+
+	m_Journal.clear() ;
+	m_Journal.open(*path, ios::app) ;
+	m_Lock.Unlock() ;
+
+	if (m_Journal.fail())
+		return hzerr(_fn, HZ_ERROR, E_OPENFAIL, "Cannot open %s for writing", *path) ;
+
+	threadLog("%s: Loaded %u IP addresses from %s\n", *_fn, m_nCount, *path) ;
+	return E_OK ;
+}
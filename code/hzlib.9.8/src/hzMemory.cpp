@@ -29,6 +29,8 @@
 #include "hzDate.h"
 #include "hzDocument.h"
 #include "hzUnixacc.h"
+#include "hzArena.h"
+#include "hzHttpServer.h"
 
 using namespace std ;
 
@@ -366,6 +368,7 @@ void*	hz_mem_allocate	(uint32_t size)
 	//	Arguments:	1)	size	Requested number of bytes for allocation
 	//	Returns:	Pointer to the allocated memory
 
+	__atomic_add_fetch(&_hzGlobal_Memstats.m_numNew, 1, __ATOMIC_RELAXED) ;
 	return fnptr_Alloc(size) ;
 }
 
@@ -378,6 +381,8 @@ void	hz_mem_release	(void* ptr)
 	//	Arguments:	1)	ptr	Pointer to object to be freed
 	//	Returns:	None
 
+	if (ptr)
+		__atomic_add_fetch(&_hzGlobal_Memstats.m_numDelete, 1, __ATOMIC_RELAXED) ;
 	fnptr_Free(ptr) ;
 }
 
@@ -718,8 +723,11 @@ static	void	_report_objects	(hzChain& Z, const hzMeminfo& cms, const hzMeminfo&
 	U = cms.m_numSmaps * 64 ;		total += U ;	_report_mem_itemA(Z, "Maps(S)",			cms.m_numSmaps,		pms.m_numSmaps,		U) ;
 	U = cms.m_numMmaps * 64 ;		total += U ;	_report_mem_itemA(Z, "Maps(M)",			cms.m_numMmaps,		pms.m_numMmaps,		U) ;
 	U = cms.m_numSets * 64 ;		total += U ;	_report_mem_itemA(Z, "Sets",			cms.m_numSets,		pms.m_numSets,		U) ;
+	U = cms.m_numCmaps * 64 ;		total += U ;	_report_mem_itemA(Z, "Maps(C)",			cms.m_numCmaps,		pms.m_numCmaps,		U) ;
+	U = cms.m_numHmaps * 64 ;		total += U ;	_report_mem_itemA(Z, "Maps(H)",			cms.m_numHmaps,		pms.m_numHmaps,		U) ;
 	U = cms.m_numArrays * 64 ;		total += U ;	_report_mem_itemA(Z, "Arrays",			cms.m_numArrays,	pms.m_numArrays,	U) ;
 	U = cms.m_numVectors * 64 ;		total += U ;	_report_mem_itemA(Z, "Vectors",			cms.m_numVectors,	pms.m_numVectors,	U) ;
+	U = cms.m_numNodeSlabs * 1024 ;	total += U ;	_report_mem_itemA(Z, "Node Slabs",		cms.m_numNodeSlabs,	pms.m_numNodeSlabs,	U) ;
 	U = cms.m_numIsams * 64 ;		total += U ;	_report_mem_itemA(Z, "ISAMS",			cms.m_numIsams,		pms.m_numIsams,		U) ;
 	U = cms.m_numIsamIndx * 64 ;	total += U ;	_report_mem_itemA(Z, "ISAM Blk Index",	cms.m_numIsamIndx,	pms.m_numIsamIndx,	U) ;
 	U = cms.m_numIsamData * 64 ;	total += U ;	_report_mem_itemA(Z, "ISAM Blk Data",	cms.m_numIsamData,	pms.m_numIsamData,	U) ;
@@ -730,6 +738,19 @@ static	void	_report_objects	(hzChain& Z, const hzMeminfo& cms, const hzMeminfo&
 	U = cms.m_numBincron * 64 ;		total += U ;	_report_mem_itemA(Z, "BinCrons",		cms.m_numBincron,	pms.m_numBincron,	U) ;
 	U = cms.m_numBinstore * 64 ;	total += U ;	_report_mem_itemA(Z, "BinStores",		cms.m_numBinstore,	pms.m_numBinstore,	U) ;
 
+	//	ARENAS AND HTTP EVENTS. In steady state neither the arena blocks nor the HTTP events should increase in number, as both are reused.
+	U = cms.m_numArenaBlks * HZ_ARENA_BLKSIZE ;		total += U ;	_report_mem_itemA(Z, "Arena Blks",	cms.m_numArenaBlks,	pms.m_numArenaBlks,	U) ;
+	_report_mem_itemA(Z, "Arena Oversize",	cms.m_numArenaOver,		pms.m_numArenaOver,		0) ;
+	_report_mem_itemA(Z, "Arena Allocs",	cms.m_numArenaAllocs,	pms.m_numArenaAllocs,	0) ;
+
+	U = cms.m_numHttpEvents * sizeof(hzHttpEvent) ;	total += U ;
+	_report_mem_itemC(Z, "HTTP Events", cms.m_numHttpEvents - cms.m_numHttpEvPool, pms.m_numHttpEvents - pms.m_numHttpEvPool, cms.m_numHttpEvPool, pms.m_numHttpEvPool,
+		cms.m_numHttpEvents, pms.m_numHttpEvents, U) ;
+
+	//	HEAP CALLS. The difference between the current and previous counts is the number of calls made since the last report.
+	_report_mem_itemA(Z, "Calls to new",	cms.m_numNew,		pms.m_numNew,		0) ;
+	_report_mem_itemA(Z, "Calls to delete",	cms.m_numDelete,	pms.m_numDelete,	0) ;
+
 	//	TOTAL
 	Z << "<tr><td>TOTAL EST:</td><td></td><td></td><td></td><td></td><td></td><td></td>" ;
 	Z.Printf("<td align=\"right\">%s</td></tr>\n", _sn(b1,total)) ;
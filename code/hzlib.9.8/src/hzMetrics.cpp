@@ -0,0 +1,408 @@
+//
+//	File:	hzMetrics.cpp
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+//
+//	Implementation of the server metrics (latency histograms and counters)
+//
+
+#include <cstdio>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "hzProcess.h"
+#include "hzMetrics.h"
+
+/*
+**	Variables
+*/
+
+hzMetricsHdr*	hzMetrics::s_pHdr = 0 ;			//	Start of region
+hzPortStats*	hzMetrics::s_pBlocks = 0 ;		//	Blocks
+
+static	hzShmem			s_metricShm ;			//	Shared memory segment (if used)
+static	__thread int32_t		s_nRow = -1 ;	//	Row claimed by this thread
+static	__thread hzPortStats*	s_pLast = 0 ;	//	Block last used by this thread
+
+static	const char*	s_phaseNames[HZ_PHASE_COUNT] = { "accept", "recv", "proc", "xmit" } ;
+
+//	Histogram bucket boundaries given in the Prometheus export (in nanoseconds and as the label value in seconds)
+static	const uint64_t	s_promBounds[] = { 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000, 50000000,
+											100000000, 250000000, 500000000, 1000000000, 2500000000ULL, 5000000000ULL, 10000000000ULL, 0 } ;
+static	const char*		s_promLabels[] = { "1e-05", "2.5e-05", "5e-05", "0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05",
+											"0.1", "0.25", "0.5", "1", "2.5", "5", "10", 0 } ;
+
+//	Quantiles given in the Prometheus export
+static	const double	s_promQuant[] = { 0.5, 0.9, 0.99, 0.999, 1.0 } ;
+static	const char*		s_quantLabels[] = { "0.5", "0.9", "0.99", "0.999", "1", 0 } ;
+
+static	const char*	_secs	(char* buf, uint64_t nsVal)
+{
+	//	Format a nanosecond value in seconds (hzChain::Printf has no floating point directive)
+
+	sprintf(buf, "%lu.%09lu", nsVal / 1000000000, nsVal % 1000000000) ;
+	return buf ;
+}
+
+/*
+**	hzLatencyHist members
+*/
+
+uint64_t	hzLatencyHist::Lower	(uint32_t nBucket)
+{
+	//	Lowest value that is placed in the given bucket
+	//
+	//	Arguments:	1)	nBucket	The bucket
+	//
+	//	Returns:	Value in nanoseconds
+
+	uint32_t	nExp ;		//	Power of 2
+
+	if (nBucket < (2 << HZ_METRIC_SUBBITS))
+		return nBucket ;
+
+	nExp = (nBucket >> HZ_METRIC_SUBBITS) + HZ_METRIC_SUBBITS - 1 ;
+	return (1ULL << nExp) + ((uint64_t) (nBucket & ((1 << HZ_METRIC_SUBBITS) - 1)) << (nExp - HZ_METRIC_SUBBITS)) ;
+}
+
+void	hzLatencyHist::Merge	(const hzLatencyHist& op)
+{
+	//	Add the values of another histogram to this one
+	//
+	//	Arguments:	1)	op	The other histogram
+	//
+	//	Returns:	None
+
+	uint32_t	n ;		//	Bucket iterator
+
+	m_nCount += __atomic_load_n(&op.m_nCount, __ATOMIC_ACQUIRE) ;
+	m_nSum += op.m_nSum ;
+	if (op.m_nMax > m_nMax)
+		m_nMax = op.m_nMax ;
+
+	for (n = 0 ; n < HZ_METRIC_BUCKETS ; n++)
+		m_Buckets[n] += op.m_Buckets[n] ;
+}
+
+uint64_t	hzLatencyHist::Quantile	(double q) const
+{
+	//	Estimate the value at the given quantile. This is the upper bound of the bucket in which the quantile falls, so the estimate errs on the high side by
+	//	no more than the width of one bucket.
+	//
+	//	Arguments:	1)	q	The quantile (0.5 for the median, 0.99 for the 99th percentile and so on)
+	//
+	//	Returns:	Value in nanoseconds (0 if nothing has been recorded)
+
+	uint64_t	nTarget ;	//	Number of values at or below the quantile
+	uint64_t	nSofar ;	//	Running count
+	uint32_t	n ;			//	Bucket iterator
+
+	if (!m_nCount)
+		return 0 ;
+
+	nTarget = (uint64_t) (q * m_nCount + 0.5) ;
+	if (!nTarget)
+		nTarget = 1 ;
+
+	for (nSofar = n = 0 ; n < HZ_METRIC_BUCKETS ; n++)
+	{
+		nSofar += m_Buckets[n] ;
+		if (nSofar >= nTarget)
+			break ;
+	}
+
+	if (n >= HZ_METRIC_BUCKETS - 1)
+		return m_nMax ;
+	return Lower(n + 1) < m_nMax ? Lower(n + 1) : m_nMax ;
+}
+
+uint64_t	hzLatencyHist::CountBelow	(uint64_t nsLimit) const
+{
+	//	Count the values known to be at or below the limit, i.e. those in buckets that lie wholly at or below it
+	//
+	//	Arguments:	1)	nsLimit	The limit in nanoseconds
+	//
+	//	Returns:	Number of values
+
+	uint64_t	nCount ;	//	Running count
+	uint32_t	n ;			//	Bucket iterator
+
+	for (nCount = n = 0 ; n < HZ_METRIC_BUCKETS - 1 && Lower(n + 1) <= nsLimit + 1 ; n++)
+		nCount += m_Buckets[n] ;
+	return nCount ;
+}
+
+/*
+**	hzMetrics members
+*/
+
+hzEcode	hzMetrics::Init	(const char* shmName)
+{
+	//	Create the metrics region, either in private memory or in a named shared memory segment. Nothing is recorded until this is called.
+	//
+	//	Arguments:	1)	shmName	Name of shared memory segment (e.g. "/myapp_metrics") or NULL for private memory
+	//
+	//	Returns:	E_INITDUP	If the region already exists
+	//				E_MEMORY	If the region could not be allocated
+	//				E_OK		If metrics are now being recorded
+
+	_hzfunc("hzMetrics::Init") ;
+
+	hzMetricsHdr*	pHdr ;		//	New region
+	uint64_t		nSize ;		//	Size of region
+
+	if (s_pHdr)
+		return E_INITDUP ;
+
+	nSize = sizeof(hzMetricsHdr) + ((uint64_t) HZ_METRIC_ROWS * HZ_METRIC_PORTS * sizeof(hzPortStats)) ;
+
+	if (shmName)
+	{
+		if (s_metricShm.Init(shmName, nSize, 0666) != E_OK)
+			return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not create shared memory segment %s", shmName) ;
+		pHdr = (hzMetricsHdr*) s_metricShm.GetMem() ;
+
+		//	The segment may remain from an earlier run
+		memset(pHdr, 0, nSize) ;
+	}
+	else
+	{
+		//	Anonymous pages are zero and are only committed as blocks come into use
+		pHdr = (hzMetricsHdr*) mmap(0, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ;
+		if ((void*) pHdr == MAP_FAILED)
+			return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not allocate metrics region of %u bytes", (uint32_t) nSize) ;
+	}
+
+	memcpy(pHdr->m_Magic, HZ_METRIC_MAGIC, 8) ;
+	pHdr->m_nVersion = 1 ;
+	pHdr->m_nRows = HZ_METRIC_ROWS ;
+	pHdr->m_nPorts = HZ_METRIC_PORTS ;
+	pHdr->m_nBuckets = HZ_METRIC_BUCKETS ;
+	pHdr->m_nBlockSize = sizeof(hzPortStats) ;
+	pHdr->m_nRowsUsed = 0 ;
+	pHdr->m_nsStarted = RealtimeNano() ;
+
+	s_pBlocks = (hzPortStats*) (pHdr + 1) ;
+	__atomic_store_n(&s_pHdr, pHdr, __ATOMIC_RELEASE) ;
+	return E_OK ;
+}
+
+hzPortStats*	hzMetrics::_claim	(uint32_t nPort)
+{
+	//	Find or claim the block for the port in the row of the calling thread. The thread claims a row on first use.
+	//
+	//	Arguments:	1)	nPort	The port
+	//
+	//	Returns:	Pointer to the block
+	//				NULL if all rows are taken or the row has no free block
+
+	hzPortStats*	pRow ;		//	First block in row
+	uint32_t		n ;			//	Block iterator
+
+	if (s_nRow < 0)
+	{
+		s_nRow = __sync_fetch_and_add(&s_pHdr->m_nRowsUsed, 1) ;
+		if (s_nRow >= HZ_METRIC_ROWS)
+			threadLog("hzMetrics: More than %d threads - thread %d not recorded\n", HZ_METRIC_ROWS, (int32_t) syscall(SYS_gettid)) ;
+	}
+	if (s_nRow >= HZ_METRIC_ROWS)
+		return 0 ;
+
+	pRow = s_pBlocks + (s_nRow * HZ_METRIC_PORTS) ;
+
+	for (n = 0 ; n < HZ_METRIC_PORTS ; n++)
+	{
+		if (pRow[n].m_nPort == nPort)
+			return pRow + n ;
+
+		if (!pRow[n].m_nPort)
+		{
+			//	The port is set last so a reader does not see a block before it is ready
+			pRow[n].m_nThread = (uint32_t) syscall(SYS_gettid) ;
+			__atomic_store_n(&pRow[n].m_nPort, nPort, __ATOMIC_RELEASE) ;
+			return pRow + n ;
+		}
+	}
+
+	return 0 ;
+}
+
+hzPortStats*	hzMetrics::Stats	(uint32_t nPort)
+{
+	//	Obtain the block in which the calling thread is to record values for the given port
+	//
+	//	Arguments:	1)	nPort	The (listening) port
+	//
+	//	Returns:	Pointer to the block
+	//				NULL if metrics are not active (or the thread cannot record)
+
+	if (!s_pHdr || !nPort)
+		return 0 ;
+
+	if (s_pLast && s_pLast->m_nPort == nPort)
+		return s_pLast ;
+
+	s_pLast = _claim(nPort) ;
+	return s_pLast ;
+}
+
+void	hzMetrics::Totals	(hzPortStats& tot, uint32_t nPort)
+{
+	//	Sum the blocks of all threads for the given port
+	//
+	//	Arguments:	1)	tot		The block to populate
+	//				2)	nPort	The port
+	//
+	//	Returns:	None
+
+	hzPortStats*	pBlk ;		//	Block
+	uint32_t		nRows ;		//	Rows in use
+	uint32_t		n ;			//	Block iterator
+	uint32_t		p ;			//	Phase iterator
+
+	memset(&tot, 0, sizeof(hzPortStats)) ;
+	tot.m_nPort = nPort ;
+
+	if (!s_pHdr)
+		return ;
+
+	nRows = __atomic_load_n(&s_pHdr->m_nRowsUsed, __ATOMIC_ACQUIRE) ;
+	if (nRows > HZ_METRIC_ROWS)
+		nRows = HZ_METRIC_ROWS ;
+
+	for (n = 0 ; n < nRows * HZ_METRIC_PORTS ; n++)
+	{
+		pBlk = s_pBlocks + n ;
+		if (__atomic_load_n(&pBlk->m_nPort, __ATOMIC_ACQUIRE) != nPort)
+			continue ;
+
+		tot.m_nConns += pBlk->m_nConns ;
+		tot.m_nRequests += pBlk->m_nRequests ;
+		tot.m_nBytesIn += pBlk->m_nBytesIn ;
+		tot.m_nBytesOut += pBlk->m_nBytesOut ;
+		tot.m_nErrors += pBlk->m_nErrors ;
+		tot.m_nExpired += pBlk->m_nExpired ;
+
+		for (p = 0 ; p < HZ_PHASE_COUNT ; p++)
+			tot.m_Phase[p].Merge(pBlk->m_Phase[p]) ;
+	}
+}
+
+void	hzMetrics::Export	(hzChain& Z)
+{
+	//	Write out the metrics of all ports in the Prometheus text exposition format. The per-thread blocks are summed so each series is labelled by port only.
+	//	Latencies are given both as histograms (with fixed bucket boundaries from 10us to 10s) and as gauges of the 50th, 90th, 99th and 99.9th percentiles
+	//	and the maximum.
+	//
+	//	Arguments:	1)	Z	The chain to append to
+	//
+	//	Returns:	None
+
+	hzPortStats*	pTot ;						//	Totals for a port
+	uint32_t		ports[HZ_METRIC_PORTS * 4] ;	//	Distinct ports
+	uint32_t		nPorts ;					//	Number of distinct ports
+	uint32_t		nRows ;						//	Rows in use
+	uint32_t		nPort ;						//	Port of block
+	uint32_t		n ;							//	Block/port iterator
+	uint32_t		x ;							//	Port iterator
+	uint32_t		p ;							//	Phase iterator
+	uint32_t		b ;							//	Boundary iterator
+	char			nbuf[32] ;					//	Seconds as text
+
+	if (!s_pHdr)
+		return ;
+
+	//	Find the distinct ports
+	nRows = __atomic_load_n(&s_pHdr->m_nRowsUsed, __ATOMIC_ACQUIRE) ;
+	if (nRows > HZ_METRIC_ROWS)
+		nRows = HZ_METRIC_ROWS ;
+
+	for (nPorts = n = 0 ; n < nRows * HZ_METRIC_PORTS ; n++)
+	{
+		nPort = __atomic_load_n(&s_pBlocks[n].m_nPort, __ATOMIC_ACQUIRE) ;
+		if (!nPort)
+			continue ;
+
+		for (x = 0 ; x < nPorts && ports[x] != nPort ; x++) ;
+		if (x == nPorts && nPorts < HZ_METRIC_PORTS * 4)
+			ports[nPorts++] = nPort ;
+	}
+
+	if (!nPorts)
+		return ;
+
+	pTot = new hzPortStats[nPorts] ;
+	for (x = 0 ; x < nPorts ; x++)
+		Totals(pTot[x], ports[x]) ;
+
+	//	Counters
+	Z << "# HELP hz_connections_total Connections accepted\n# TYPE hz_connections_total counter\n" ;
+	for (x = 0 ; x < nPorts ; x++)
+		Z.Printf("hz_connections_total{port=\"%u\"} %L\n", ports[x], pTot[x].m_nConns) ;
+
+	Z << "# HELP hz_requests_total Responses completed\n# TYPE hz_requests_total counter\n" ;
+	for (x = 0 ; x < nPorts ; x++)
+		Z.Printf("hz_requests_total{port=\"%u\"} %L\n", ports[x], pTot[x].m_nRequests) ;
+
+	Z << "# HELP hz_received_bytes_total Bytes received\n# TYPE hz_received_bytes_total counter\n" ;
+	for (x = 0 ; x < nPorts ; x++)
+		Z.Printf("hz_received_bytes_total{port=\"%u\"} %L\n", ports[x], pTot[x].m_nBytesIn) ;
+
+	Z << "# HELP hz_sent_bytes_total Bytes sent\n# TYPE hz_sent_bytes_total counter\n" ;
+	for (x = 0 ; x < nPorts ; x++)
+		Z.Printf("hz_sent_bytes_total{port=\"%u\"} %L\n", ports[x], pTot[x].m_nBytesOut) ;
+
+	Z << "# HELP hz_errors_total Connections failed\n# TYPE hz_errors_total counter\n" ;
+	for (x = 0 ; x < nPorts ; x++)
+		Z.Printf("hz_errors_total{port=\"%u\"} %L\n", ports[x], pTot[x].m_nErrors) ;
+
+	Z << "# HELP hz_expired_total Connections expired\n# TYPE hz_expired_total counter\n" ;
+	for (x = 0 ; x < nPorts ; x++)
+		Z.Printf("hz_expired_total{port=\"%u\"} %L\n", ports[x], pTot[x].m_nExpired) ;
+
+	//	Latency histograms
+	Z << "# HELP hz_latency_seconds Request latency by phase\n# TYPE hz_latency_seconds histogram\n" ;
+	for (x = 0 ; x < nPorts ; x++)
+	{
+		for (p = 0 ; p < HZ_PHASE_COUNT ; p++)
+		{
+			hzLatencyHist&	h = pTot[x].m_Phase[p] ;
+
+			for (b = 0 ; s_promBounds[b] ; b++)
+				Z.Printf("hz_latency_seconds_bucket{port=\"%u\",phase=\"%s\",le=\"%s\"} %L\n", ports[x], s_phaseNames[p], s_promLabels[b], h.CountBelow(s_promBounds[b])) ;
+
+			Z.Printf("hz_latency_seconds_bucket{port=\"%u\",phase=\"%s\",le=\"+Inf\"} %L\n", ports[x], s_phaseNames[p], h.m_nCount) ;
+			Z.Printf("hz_latency_seconds_sum{port=\"%u\",phase=\"%s\"} %s\n", ports[x], s_phaseNames[p], _secs(nbuf, h.m_nSum)) ;
+			Z.Printf("hz_latency_seconds_count{port=\"%u\",phase=\"%s\"} %L\n", ports[x], s_phaseNames[p], h.m_nCount) ;
+		}
+	}
+
+	//	Latency quantiles
+	Z << "# HELP hz_latency_quantile_seconds Request latency percentiles by phase (since start)\n# TYPE hz_latency_quantile_seconds gauge\n" ;
+	for (x = 0 ; x < nPorts ; x++)
+	{
+		for (p = 0 ; p < HZ_PHASE_COUNT ; p++)
+		{
+			for (b = 0 ; s_quantLabels[b] ; b++)
+				Z.Printf("hz_latency_quantile_seconds{port=\"%u\",phase=\"%s\",quantile=\"%s\"} %s\n",
+					ports[x], s_phaseNames[p], s_quantLabels[b], _secs(nbuf, pTot[x].m_Phase[p].Quantile(s_promQuant[b]))) ;
+		}
+	}
+
+	delete [] pTot ;
+}
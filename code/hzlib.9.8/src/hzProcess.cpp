@@ -795,9 +795,23 @@ hzDiode::_bkt*	hzDiode::_alloc  (void)
 
     _bkt*   pB ;    //  Current bucket
 
-    pB = m_pFree ;
+    //  Buckets are put on the freelist by the reader thread (in Pull) and taken from it here by the writer thread, so the freelist head must be swapped
+    //  atomically. As there is only the one thread taking buckets, a bucket cannot be taken and put back between reading the head and the swap.
+    for (;;)
+    {
+        pB = m_pFree ;
+        if (!pB)
+            break ;
+        if (__sync_bool_compare_and_swap(&m_pFree, pB, pB->next))
+            break ;
+    }
+
     if (pB)
-        m_pFree = m_pFree->next ;
+    {
+        //  A recycled bucket is full and has been fully read so must be reset
+        pB->next = 0 ;
+        pB->usage = pB->count = 0 ;
+    }
     else
         pB = new _bkt() ;
 
@@ -815,8 +829,9 @@ void	hzDiode::_free   (hzDiode::_bkt* pB)
 	//	Arguments:	1)	pB	Diode bucket to be released to the free list
 	//	Returns:	None
 
-    pB->next = m_pFree ;
-    m_pFree = pB ;
+    do
+        pB->next = m_pFree ;
+    while (!__sync_bool_compare_and_swap(&m_pFree, pB->next, pB)) ;
 }
 
 hzDiode::~hzDiode	(void)
@@ -0,0 +1,188 @@
+//
+//	File:	hzRateLimit.cpp
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <string.h>
+#include <time.h>
+
+#include "hzErrcode.h"
+#include "hzProcess.h"
+#include "hzRateLimit.h"
+
+using namespace std ;
+
+/*
+**	hzTokenBucket members
+*/
+
+uint32_t	hzTokenBucket::Now	(void)
+{
+	//	Return the time in milliseconds by the coarse monotonic clock, as used to refill buckets. This wraps after 49 days, which is of no consequence as only
+	//	differences are taken.
+
+	struct timespec	ts ;	//	Time
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) ;
+	return (uint32_t) (ts.tv_sec * 1000 + ts.tv_nsec / 1000000) ;
+}
+
+bool	hzTokenBucket::Take	(uint32_t msNow, uint32_t nRate, uint32_t nBurst, uint32_t nCost)
+{
+	//	Refill the bucket for the time elapsed since it was last refilled and then take the given number of tokens from it, if it has them.
+	//
+	//	Arguments:	1)	msNow	Time now (as per Now())
+	//				2)	nRate	Tokens added per second
+	//				3)	nBurst	Capacity of the bucket
+	//				4)	nCost	Tokens to take
+	//
+	//	Returns:	True	If the tokens were taken (the event is allowed)
+	//				False	If the bucket has insufficient tokens (the event is to be refused)
+
+	uint64_t	nOld ;		//	State as read
+	uint64_t	nNew ;		//	State to write
+	uint64_t	nHeld ;		//	Milli-tokens held after refill
+	uint64_t	nCap ;		//	Capacity in milli-tokens
+	uint64_t	nWant ;		//	Milli-tokens to take
+	uint32_t	msLast ;	//	Time of last refill
+	int32_t		msGone ;	//	Milliseconds elapsed since last refill
+
+	nCap = (uint64_t) nBurst * 1000 ;
+	nWant = (uint64_t) nCost * 1000 ;
+
+	nOld = __atomic_load_n(&m_nState, __ATOMIC_RELAXED) ;
+	for (;;)
+	{
+		if (!nOld)
+			{ nHeld = nCap ; msLast = msNow ; }
+		else
+		{
+			//	Another thread may have refilled the bucket with a later time than msNow. The elapsed time is then taken as zero and the later time is kept,
+			//	as an unsigned difference would be huge and fill the bucket.
+			msLast = (uint32_t) (nOld >> 32) ;
+			msGone = (int32_t) (msNow - msLast) ;
+			if (msGone < 0)
+				msGone = 0 ;
+			else
+				msLast = msNow ;
+
+			//	A rate of N tokens per second is N milli-tokens per millisecond
+			nHeld = (nOld & 0xffffffff) + (uint64_t) msGone * nRate ;
+		}
+
+		//	The burst may have been lowered since the bucket was filled
+		if (nHeld > nCap)
+			nHeld = nCap ;
+
+		if (nHeld < nWant)
+			return false ;
+
+		nNew = ((uint64_t) msLast << 32) | (nHeld - nWant) ;
+		if (!nNew)
+			nNew = 1 ;
+
+		if (__atomic_compare_exchange_n(&m_nState, &nOld, nNew, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return true ;
+	}
+}
+
+/*
+**	hzRateLimit members
+*/
+
+hzRateLimit::hzRateLimit	(void)
+{
+	m_pCells = 0 ;
+	m_nWidth = m_nShift = m_nRate = m_nBurst = 0 ;
+}
+
+hzRateLimit::~hzRateLimit	(void)
+{
+	delete [] m_pCells ;
+}
+
+hzEcode	hzRateLimit::Init	(uint32_t nRate, uint32_t nBurst, uint32_t nWidth)
+{
+	//	Allocate the sketch and set the rate and burst applying to every key
+	//
+	//	Arguments:	1)	nRate	Tokens per second
+	//				2)	nBurst	Capacity of each bucket (the number of events a key may make at once)
+	//				3)	nWidth	Buckets per row (rounded up to a power of 2, minimum 64)
+	//
+	//	Returns:	E_ARGUMENT	If the rate or burst is zero
+	//				E_INITDUP	If the sketch is already allocated
+	//				E_MEMORY	If the sketch could not be allocated
+	//				E_OK		If the rate limit is ready
+
+	_hzfunc("hzRateLimit::Init") ;
+
+	uint32_t	nSize ;		//	Buckets per row
+	uint32_t	nBits ;		//	Log2 of buckets per row
+
+	if (!nRate || !nBurst)
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Rate (%u) and burst (%u) must both be non-zero", nRate, nBurst) ;
+
+	if (m_pCells)
+		return E_INITDUP ;
+
+	for (nSize = 64, nBits = 6 ; nSize < nWidth && nBits < 24 ; nSize <<= 1, nBits++) ;
+
+	m_pCells = new hzTokenBucket[nSize * HZ_RATE_DEPTH] ;
+	if (!m_pCells)
+		return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not allocate %u buckets", nSize * HZ_RATE_DEPTH) ;
+
+	m_nWidth = nSize ;
+	m_nShift = 32 - nBits ;
+	m_nRate = nRate ;
+	m_nBurst = nBurst ;
+	return E_OK ;
+}
+
+bool	hzRateLimit::Take	(uint32_t nKey, uint32_t nCost)
+{
+	//	Take tokens for the key from each of its buckets. Should a bucket have insufficient tokens, the event is refused and any tokens already taken from the
+	//	key's other buckets are forfeit. This errs on the side of limiting, as a count-min sketch errs on the side of overcounting.
+	//
+	//	Arguments:	1)	nKey	The key (IP address)
+	//				2)	nCost	Tokens to take
+	//
+	//	Returns:	True	If the event is allowed (including where the limit is not in use)
+	//				False	If the event is to be refused
+
+	//	Multiplicative hash constants, one per row (odd and with well mixed bits)
+	static	const uint32_t	s_Mult[HZ_RATE_DEPTH] = { 0x9e3779b1, 0x85ebca77 } ;
+
+	uint32_t	msNow ;		//	Time now
+	uint32_t	nRow ;		//	Row iterator
+	uint32_t	nCol ;		//	Bucket within row
+
+	if (!m_pCells)
+		return true ;
+
+	msNow = hzTokenBucket::Now() ;
+
+	for (nRow = 0 ; nRow < HZ_RATE_DEPTH ; nRow++)
+	{
+		nCol = (nKey * s_Mult[nRow]) >> m_nShift ;
+		if (!m_pCells[(nRow * m_nWidth) + nCol].Take(msNow, m_nRate, m_nBurst, nCost))
+			return false ;
+	}
+
+	return true ;
+}
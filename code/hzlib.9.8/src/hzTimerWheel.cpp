@@ -0,0 +1,292 @@
+//
+//	File:	hzTimerWheel.cpp
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+//
+//	Implementation of the hierarchical timer wheel
+//
+
+#include <cstdio>
+#include <string.h>
+
+#include "hzTimerWheel.h"
+
+/*
+**	hzTimer members
+*/
+
+hzTimer::~hzTimer	(void)
+{
+	if (m_pWheel)
+		m_pWheel->Cancel(this) ;
+}
+
+/*
+**	hzTimerWheel members
+*/
+
+hzTimerWheel::hzTimerWheel	(void)
+{
+	memset(m_Slots, 0, sizeof(m_Slots)) ;
+	m_nNow = 0 ;
+	m_nCount = 0 ;
+}
+
+hzTimerWheel::~hzTimerWheel	(void)
+{
+	//	Disarm any remaining timers so they do not later try to remove themselves from a wheel that no longer exists
+
+	hzTimer*	pTm ;		//	Timer
+	uint32_t	nLevel ;	//	Level iterator
+	uint32_t	nSlot ;		//	Slot iterator
+
+	for (nLevel = 0 ; nLevel < HZ_TWHEEL_LEVELS ; nLevel++)
+	{
+		for (nSlot = 0 ; nSlot < HZ_TWHEEL_SLOTS ; nSlot++)
+		{
+			for (pTm = m_Slots[nLevel][nSlot] ; pTm ; pTm = pTm->m_pNext)
+				pTm->m_pWheel = 0 ;
+		}
+	}
+}
+
+void	hzTimerWheel::Init	(uint64_t nsNow)
+{
+	//	Set the current time of an empty wheel. This should be called before any timers are armed.
+	//
+	//	Arguments:	1)	nsNow	Current time as nanosecond epoch
+	//
+	//	Returns:	None
+
+	m_nNow = nsNow >> HZ_TWHEEL_SHIFT ;
+}
+
+void	hzTimerWheel::_place	(hzTimer* pTm)
+{
+	//	Link a timer into the slot appropriate to how far its tick is from the current tick. A timer that is already due goes into the slot for the current
+	//	tick so it will be returned by the next call to Expire(). A timer beyond the span of the wheel is parked in level 3 and re-placed when cascaded.
+	//
+	//	Arguments:	1)	pTm		The timer
+	//
+	//	Returns:	None
+
+	uint64_t	nTick ;		//	Tick the timer is placed by
+	uint64_t	nDelta ;	//	Ticks until due
+	uint32_t	nLevel ;	//	Level
+	uint32_t	nSlot ;		//	Slot within level
+
+	nTick = pTm->m_nTick < m_nNow ? m_nNow : pTm->m_nTick ;
+	nDelta = nTick - m_nNow ;
+
+	for (nLevel = 0 ; nLevel < HZ_TWHEEL_LEVELS - 1 ; nLevel++)
+	{
+		if (nDelta < (1ULL << (HZ_TWHEEL_BITS * (nLevel + 1))))
+			break ;
+	}
+
+	if (nLevel == HZ_TWHEEL_LEVELS - 1 && nDelta >= (1ULL << (HZ_TWHEEL_BITS * HZ_TWHEEL_LEVELS)))
+		nTick = m_nNow + (1ULL << (HZ_TWHEEL_BITS * HZ_TWHEEL_LEVELS)) - 1 ;
+
+	nSlot = (nTick >> (HZ_TWHEEL_BITS * nLevel)) & (HZ_TWHEEL_SLOTS - 1) ;
+
+	pTm->m_nSlot = (nLevel * HZ_TWHEEL_SLOTS) + nSlot ;
+	pTm->m_pPrev = 0 ;
+	pTm->m_pNext = m_Slots[nLevel][nSlot] ;
+	if (pTm->m_pNext)
+		pTm->m_pNext->m_pPrev = pTm ;
+	m_Slots[nLevel][nSlot] = pTm ;
+}
+
+void	hzTimerWheel::_cascade	(uint32_t nLevel)
+{
+	//	Redistribute the timers in the current slot of the given level, to the levels below.
+	//
+	//	Arguments:	1)	nLevel	The level (1 or above)
+	//
+	//	Returns:	None
+
+	hzTimer*	pTm ;		//	Timer
+	hzTimer*	pNext ;		//	Next timer
+	uint32_t	nSlot ;		//	Current slot of level
+
+	nSlot = (m_nNow >> (HZ_TWHEEL_BITS * nLevel)) & (HZ_TWHEEL_SLOTS - 1) ;
+
+	pTm = m_Slots[nLevel][nSlot] ;
+	m_Slots[nLevel][nSlot] = 0 ;
+
+	for (; pTm ; pTm = pNext)
+	{
+		pNext = pTm->m_pNext ;
+		_place(pTm) ;
+	}
+}
+
+void	hzTimerWheel::Arm	(hzTimer* pTm, uint64_t nsWhen)
+{
+	//	Arm a timer to fall due at the given time. If the timer is already armed, it is moved.
+	//
+	//	Arguments:	1)	pTm		The timer
+	//				2)	nsWhen	Deadline as nanosecond epoch
+	//
+	//	Returns:	None
+
+	if (!pTm)
+		return ;
+
+	if (pTm->m_pWheel)
+		pTm->m_pWheel->Cancel(pTm) ;
+
+	//	Round up so the timer never falls due before its deadline
+	pTm->m_nTick = (nsWhen + (1ULL << HZ_TWHEEL_SHIFT) - 1) >> HZ_TWHEEL_SHIFT ;
+	pTm->m_pWheel = this ;
+	_place(pTm) ;
+	m_nCount++ ;
+}
+
+void	hzTimerWheel::Cancel	(hzTimer* pTm)
+{
+	//	Disarm a timer. This has no effect if the timer is not armed in this wheel.
+	//
+	//	Arguments:	1)	pTm		The timer
+	//
+	//	Returns:	None
+
+	if (!pTm || pTm->m_pWheel != this)
+		return ;
+
+	if (pTm->m_pPrev)
+		pTm->m_pPrev->m_pNext = pTm->m_pNext ;
+	else
+		m_Slots[pTm->m_nSlot / HZ_TWHEEL_SLOTS][pTm->m_nSlot % HZ_TWHEEL_SLOTS] = pTm->m_pNext ;
+
+	if (pTm->m_pNext)
+		pTm->m_pNext->m_pPrev = pTm->m_pPrev ;
+
+	pTm->m_pNext = pTm->m_pPrev = 0 ;
+	pTm->m_pWheel = 0 ;
+	m_nCount-- ;
+}
+
+hzTimer*	hzTimerWheel::Expire	(uint64_t nsNow)
+{
+	//	Advance the wheel to the given time and collect all timers that have fallen due.
+	//
+	//	Arguments:	1)	nsNow	Current time as nanosecond epoch
+	//
+	//	Returns:	Pointer to the first of a chain of due timers (linked by m_pNext), none of which remain armed
+	//				NULL if no timers are due
+
+	hzTimer*	pDue = 0 ;	//	Chain of due timers
+	hzTimer*	pTm ;		//	Timer
+	hzTimer*	pNext ;		//	Next timer
+	uint64_t	nTarget ;	//	Tick to advance to
+	uint32_t	nLevel ;	//	Level iterator
+	uint32_t	nSlot ;		//	Slot in level 0
+
+	nTarget = nsNow >> HZ_TWHEEL_SHIFT ;
+
+	for (; m_nNow <= nTarget ; m_nNow++)
+	{
+		if (!m_nCount)
+		{
+			//	Nothing armed so just catch up
+			m_nNow = nTarget + 1 ;
+			break ;
+		}
+
+		nSlot = m_nNow & (HZ_TWHEEL_SLOTS - 1) ;
+
+		//	On wrap of each level, cascade the next slot of the level above
+		for (nLevel = 1 ; nLevel < HZ_TWHEEL_LEVELS ; nLevel++)
+		{
+			if ((m_nNow >> (HZ_TWHEEL_BITS * (nLevel - 1))) & (HZ_TWHEEL_SLOTS - 1))
+				break ;
+			_cascade(nLevel) ;
+		}
+
+		pTm = m_Slots[0][nSlot] ;
+		m_Slots[0][nSlot] = 0 ;
+
+		for (; pTm ; pTm = pNext)
+		{
+			pNext = pTm->m_pNext ;
+
+			pTm->m_pWheel = 0 ;
+			pTm->m_pPrev = 0 ;
+			pTm->m_pNext = pDue ;
+			pDue = pTm ;
+			m_nCount-- ;
+		}
+	}
+
+	return pDue ;
+}
+
+int32_t	hzTimerWheel::NextTimeout	(uint64_t nsNow) const
+{
+	//	Determine how long a serving loop may sleep before it must call Expire(). For level 0 this is the time until the first occupied slot. For the higher
+	//	levels it is the time until the first occupied slot is cascaded, at which point the timers in it are placed more precisely.
+	//
+	//	Arguments:	1)	nsNow	Current time as nanosecond epoch
+	//
+	//	Returns:	-1	If there are no armed timers
+	//				Number of milliseconds until the next timer could fall due (0 if one is already due)
+
+	uint64_t	nTick ;		//	Earliest tick found
+	uint64_t	nCand ;		//	Candidate tick
+	uint64_t	nBase ;		//	Current tick at level
+	uint64_t	nsWhen ;	//	Earliest tick as nanosecond epoch
+	uint32_t	nLevel ;	//	Level iterator
+	uint32_t	nOset ;		//	Slot offset from current
+
+	if (!m_nCount)
+		return -1 ;
+
+	nTick = 0xffffffffffffffffULL ;
+
+	for (nOset = 0 ; nOset < HZ_TWHEEL_SLOTS ; nOset++)
+	{
+		if (m_Slots[0][(m_nNow + nOset) & (HZ_TWHEEL_SLOTS - 1)])
+			{ nTick = m_nNow + nOset ; break ; }
+	}
+
+	for (nLevel = 1 ; nLevel < HZ_TWHEEL_LEVELS ; nLevel++)
+	{
+		//	The current slot of the level is still to be cascaded if the next tick is the first of the slot, otherwise it holds timers for the next round
+		nBase = m_nNow >> (HZ_TWHEEL_BITS * nLevel) ;
+		nOset = (m_nNow & ((1ULL << (HZ_TWHEEL_BITS * nLevel)) - 1)) ? 1 : 0 ;
+
+		for (; nOset <= HZ_TWHEEL_SLOTS ; nOset++)
+		{
+			if (m_Slots[nLevel][(nBase + nOset) & (HZ_TWHEEL_SLOTS - 1)])
+			{
+				nCand = (nBase + nOset) << (HZ_TWHEEL_BITS * nLevel) ;
+				if (nCand < nTick)
+					nTick = nCand ;
+				break ;
+			}
+		}
+	}
+
+	nsWhen = nTick << HZ_TWHEEL_SHIFT ;
+	if (nsWhen <= nsNow)
+		return 0 ;
+
+	nsWhen -= nsNow ;
+	if (nsWhen > 0x7fffffffULL * 1000000)
+		return 0x7fffffff ;
+	return (int32_t) ((nsWhen + 999999) / 1000000) ;
+}
@@ -218,6 +218,7 @@ hzEcode	TokenizeWords	(hzVect<hzToken>& toks, hzChain& C)
 	uint32_t	nLine ;		//	For assigning line numbers to tokens
 
 	toks.Clear() ;
+	toks.SetMode(HZ_STORE_CONTIG) ;
 	if (!C.Size())
 		return E_NODATA ;
 
@@ -324,6 +325,7 @@ hzEcode	TokenizeFreetext	(hzVect<hzToken>& toks, hzChain& C)
 	uint32_t	nLine ;		//	Line number (at start of raw sequence)
 
 	toks.Clear() ;
+	toks.SetMode(HZ_STORE_CONTIG) ;
 	if (!C.Size())
 		return E_NODATA ;
 
@@ -414,6 +416,7 @@ hzEcode	TokenizeBool	(hzVect<hzToken>& toks, hzChain& C)
 	char		tmp	[4] ;		//	For operator
 
 	toks.Clear() ;
+	toks.SetMode(HZ_STORE_CONTIG) ;
 	if (!C.Size())
 		return E_NODATA ;
 
@@ -23,6 +23,7 @@
 #include "hzProcess.h"
 #include "hzTextproc.h"
 #include "hzDissemino.h"
+#include "hzTmplMapH.h"
 
 /*
 **	Text form of internal and external data types
@@ -189,9 +190,11 @@ struct	_mimeType
 	}
 } ;
 
-static	hzMapS<hzString,_mimeType>	s_mimesFile ;	//	MIME types by file ending
-static	hzMapS<hzString,_mimeType>	s_mimesDesc ;	//	MIME types by description
-static	hzMapS<int32_t,_mimeType>	s_mimesEnum ;	//	MIME types by enumerated value
+//	The MIME type maps are only used for point lookups, so are hash maps. Note that s_mimesEnum is then iterated in the order the types are inserted below,
+//	which is also the order of the enumerated values.
+static	hzHashMap<hzString,_mimeType>	s_mimesFile ;	//	MIME types by file ending
+static	hzHashMap<hzString,_mimeType>	s_mimesDesc ;	//	MIME types by description
+static	hzHashMap<int32_t,_mimeType>	s_mimesEnum ;	//	MIME types by enumerated value
 
 void	HadronZooInitMimes	(void)
 {
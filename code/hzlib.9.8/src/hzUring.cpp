@@ -0,0 +1,382 @@
+//
+//	File:	hzUring.cpp
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+//
+//	Implementation of the io_uring wrapper used by hzIpServer::ServeUring()
+//
+
+#include <cstdio>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "hzProcess.h"
+#include "hzUring.h"
+
+/*
+**	System call shims (glibc provides no wrappers for the io_uring calls)
+*/
+
+static	int32_t	_uring_setup	(uint32_t nEntries, struct io_uring_params* p)
+{
+	return (int32_t) syscall(__NR_io_uring_setup, nEntries, p) ;
+}
+
+static	int32_t	_uring_enter	(int32_t fd, uint32_t nSubmit, uint32_t nWait, uint32_t flags, void* pArg, size_t nArg)
+{
+	return (int32_t) syscall(__NR_io_uring_enter, fd, nSubmit, nWait, flags, pArg, nArg) ;
+}
+
+static	int32_t	_uring_register	(int32_t fd, uint32_t opcode, void* pArg, uint32_t nArgs)
+{
+	return (int32_t) syscall(__NR_io_uring_register, fd, opcode, pArg, nArgs) ;
+}
+
+/*
+**	hzUring members
+*/
+
+hzUring::hzUring	(void)
+{
+	m_pSqes = 0 ;
+	m_pCqes = 0 ;
+	m_pBufRing = 0 ;
+	m_pIov = 0 ;
+	m_pBufs = 0 ;
+	m_pSqMap = m_pCqMap = 0 ;
+	m_pSqHead = m_pSqTail = m_pSqArray = 0 ;
+	m_pCqHead = m_pCqTail = 0 ;
+	m_nSqMap = m_nCqMap = m_nSqeMap = m_nBufMap = 0 ;
+	m_nSqMask = m_nSqEntries = m_nCqMask = m_nSqLocal = 0 ;
+	m_nBufs = m_nBufTail = 0 ;
+	m_nFeatures = m_nSubmits = 0 ;
+	m_nFd = -1 ;
+}
+
+hzUring::~hzUring	(void)
+{
+	Close() ;
+}
+
+void	hzUring::Close	(void)
+{
+	//	Release the ring and all associated memory
+	//
+	//	Arguments:	None
+	//	Returns:	None
+
+	if (m_nFd >= 0)
+		close(m_nFd) ;
+	m_nFd = -1 ;
+
+	if (m_pBufRing)	munmap(m_pBufRing, m_nBufMap) ;
+	if (m_pSqes)	munmap(m_pSqes, m_nSqeMap) ;
+	if (m_pCqMap)	munmap(m_pCqMap, m_nCqMap) ;
+	if (m_pSqMap)	munmap(m_pSqMap, m_nSqMap) ;
+
+	delete [] m_pBufs ;
+	delete [] m_pIov ;
+
+	m_pBufRing = 0 ;
+	m_pSqes = 0 ;
+	m_pCqMap = m_pSqMap = 0 ;
+	m_pBufs = 0 ;
+	m_pIov = 0 ;
+}
+
+hzEcode	hzUring::Init	(uint32_t nEntries, uint32_t nBufs)
+{
+	//	Create the ring, map the shared queues and register the provided buffer ring.
+	//
+	//	Arguments:	1)	nEntries	Submission queue size (rounded up to a power of 2 by the kernel). The completion queue is four times this.
+	//				2)	nBufs		Number of provided buffers for multishot receives (must be a power of 2, max 32768)
+	//
+	//	Returns:	E_INITDUP	If the ring already exists
+	//				E_ARGUMENT	If the buffer count is not a power of 2
+	//				E_NOINIT	If the kernel does not support io_uring or the features needed (kernel 6.0 or later is required)
+	//				E_MEMORY	If the ring or buffers could not be mapped or allocated
+	//				E_OK		If the ring is ready
+
+	_hzfunc("hzUring::Init") ;
+
+	struct io_uring_params	p ;		//	Setup parameters
+	struct io_uring_buf_reg	reg ;	//	Buffer ring registration
+	uint32_t	n ;					//	Buffer iterator
+
+	if (m_nFd >= 0)
+		return E_INITDUP ;
+	if (!nBufs || nBufs > 32768 || (nBufs & (nBufs - 1)))
+		return hzerr(_fn, HZ_ERROR, E_ARGUMENT, "Buffer count %u is not a power of 2 (max 32768)", nBufs) ;
+
+	memset(&p, 0, sizeof(p)) ;
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL ;
+	p.cq_entries = nEntries * 4 ;
+
+	m_nFd = _uring_setup(nEntries, &p) ;
+	if (m_nFd < 0)
+		return hzerr(_fn, HZ_ERROR, E_NOINIT, "io_uring_setup failed (%s)", strerror(errno)) ;
+
+	m_nFeatures = p.features ;
+	if (!(m_nFeatures & IORING_FEAT_EXT_ARG) || !(m_nFeatures & IORING_FEAT_SUBMIT_STABLE))
+		{ Close() ; return hzerr(_fn, HZ_ERROR, E_NOINIT, "Kernel io_uring lacks required features (0x%x)", m_nFeatures) ; }
+
+	//	Map the rings. With IORING_FEAT_SINGLE_MMAP the two rings share a single mapping.
+	m_nSqMap = p.sq_off.array + p.sq_entries * sizeof(uint32_t) ;
+	m_nCqMap = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe) ;
+	if (m_nFeatures & IORING_FEAT_SINGLE_MMAP && m_nCqMap > m_nSqMap)
+		m_nSqMap = m_nCqMap ;
+
+	m_pSqMap = mmap(0, m_nSqMap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_nFd, IORING_OFF_SQ_RING) ;
+	if (m_pSqMap == MAP_FAILED)
+		{ m_pSqMap = 0 ; Close() ; return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not map submission ring") ; }
+
+	if (m_nFeatures & IORING_FEAT_SINGLE_MMAP)
+		m_pCqMap = 0 ;
+	else
+	{
+		m_pCqMap = mmap(0, m_nCqMap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_nFd, IORING_OFF_CQ_RING) ;
+		if (m_pCqMap == MAP_FAILED)
+			{ m_pCqMap = 0 ; Close() ; return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not map completion ring") ; }
+	}
+
+	m_nSqeMap = p.sq_entries * sizeof(struct io_uring_sqe) ;
+	m_pSqes = (struct io_uring_sqe*) mmap(0, m_nSqeMap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_nFd, IORING_OFF_SQES) ;
+	if ((void*) m_pSqes == MAP_FAILED)
+		{ m_pSqes = 0 ; Close() ; return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not map submission entries") ; }
+
+	m_pSqHead = (uint32_t*) ((char*) m_pSqMap + p.sq_off.head) ;
+	m_pSqTail = (uint32_t*) ((char*) m_pSqMap + p.sq_off.tail) ;
+	m_pSqArray = (uint32_t*) ((char*) m_pSqMap + p.sq_off.array) ;
+	m_nSqMask = *(uint32_t*) ((char*) m_pSqMap + p.sq_off.ring_mask) ;
+	m_nSqEntries = p.sq_entries ;
+	m_nSqLocal = *m_pSqTail ;
+
+	{
+		char*	pCq = m_pCqMap ? (char*) m_pCqMap : (char*) m_pSqMap ;
+
+		m_pCqHead = (uint32_t*) (pCq + p.cq_off.head) ;
+		m_pCqTail = (uint32_t*) (pCq + p.cq_off.tail) ;
+		m_nCqMask = *(uint32_t*) (pCq + p.cq_off.ring_mask) ;
+		m_pCqes = (struct io_uring_cqe*) (pCq + p.cq_off.cqes) ;
+	}
+
+	m_pIov = new struct iovec[m_nSqEntries * HZ_URING_IOV] ;
+	if (!m_pIov)
+		{ Close() ; return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not allocate iovec arrays") ; }
+
+	//	Provided buffers. The ring of buffer descriptors must be page aligned and is shared with the kernel. The buffers themselves are ordinary memory.
+	m_nBufs = nBufs ;
+	m_nBufMap = nBufs * sizeof(struct io_uring_buf) ;
+	m_pBufRing = (struct io_uring_buf_ring*) mmap(0, m_nBufMap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ;
+	if ((void*) m_pBufRing == MAP_FAILED)
+		{ m_pBufRing = 0 ; Close() ; return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not map buffer ring") ; }
+
+	m_pBufs = new char[(uint64_t) nBufs * HZ_MAXPACKET] ;
+	if (!m_pBufs)
+		{ Close() ; return hzerr(_fn, HZ_ERROR, E_MEMORY, "Could not allocate %u provided buffers", nBufs) ; }
+
+	memset(&reg, 0, sizeof(reg)) ;
+	reg.ring_addr = (uint64_t) m_pBufRing ;
+	reg.ring_entries = nBufs ;
+	reg.bgid = HZ_URING_BGID ;
+
+	if (_uring_register(m_nFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+		{ Close() ; return hzerr(_fn, HZ_ERROR, E_NOINIT, "Could not register buffer ring (%s)", strerror(errno)) ; }
+
+	m_nBufTail = 0 ;
+	for (n = 0 ; n < nBufs ; n++)
+		ReturnBuffer(n) ;
+
+	return E_OK ;
+}
+
+struct io_uring_sqe*	hzUring::GetSqe	(void)
+{
+	//	Obtain the next free submission queue entry. This is cleared ready for one of the Prep functions.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	Pointer to the SQE
+	//				NULL if the submission queue is full (call Submit and try again)
+
+	struct io_uring_sqe*	pSqe ;	//	Submission entry
+	uint32_t	nHead ;				//	Kernel head
+
+	nHead = __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE) ;
+	if (m_nSqLocal - nHead >= m_nSqEntries)
+		return 0 ;
+
+	pSqe = m_pSqes + (m_nSqLocal & m_nSqMask) ;
+	m_pSqArray[m_nSqLocal & m_nSqMask] = m_nSqLocal & m_nSqMask ;
+	m_nSqLocal++ ;
+
+	memset(pSqe, 0, sizeof(struct io_uring_sqe)) ;
+	return pSqe ;
+}
+
+int32_t	hzUring::Submit	(uint32_t nWait, int32_t nMillisecs)
+{
+	//	Pass all SQEs obtained since the last call to the kernel and optionally wait for completions.
+	//
+	//	Arguments:	1)	nWait		Minimum number of completions to wait for (0 to not wait)
+	//				2)	nMillisecs	Time limit on the wait in milliseconds (-1 for no limit)
+	//
+	//	Returns:	-1	If the io_uring_enter call failed (other than by interruption or timeout)
+	//				Number of SQEs consumed by the kernel
+
+	struct io_uring_getevents_arg	arg ;	//	Extended argument (for the time limit)
+	struct __kernel_timespec		ts ;	//	Time limit
+	uint32_t	nSubmit ;					//	Number to submit
+	uint32_t	flags ;						//	Enter flags
+	int32_t		rc ;						//	Return from io_uring_enter
+
+	nSubmit = m_nSqLocal - *m_pSqTail ;
+	__atomic_store_n(m_pSqTail, m_nSqLocal, __ATOMIC_RELEASE) ;
+
+	if (!nSubmit && !nWait)
+		return 0 ;
+
+	flags = nWait ? IORING_ENTER_GETEVENTS : 0 ;
+	m_nSubmits++ ;
+
+	if (nWait && nMillisecs >= 0)
+	{
+		memset(&arg, 0, sizeof(arg)) ;
+		ts.tv_sec = nMillisecs / 1000 ;
+		ts.tv_nsec = (nMillisecs % 1000) * 1000000 ;
+		arg.ts = (uint64_t) &ts ;
+		rc = _uring_enter(m_nFd, nSubmit, nWait, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)) ;
+	}
+	else
+		rc = _uring_enter(m_nFd, nSubmit, nWait, flags, 0, 0) ;
+
+	if (rc < 0)
+	{
+		if (errno == ETIME || errno == EINTR || errno == EBUSY)
+			return 0 ;
+		return -1 ;
+	}
+
+	return rc ;
+}
+
+struct io_uring_cqe*	hzUring::PeekCqe	(void)
+{
+	//	Return the next completion queue entry (if any) without consuming it
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	Pointer to the CQE
+	//				NULL if there are no completions
+
+	uint32_t	nHead ;		//	Our head
+
+	nHead = *m_pCqHead ;
+	if (nHead == __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE))
+		return 0 ;
+	return m_pCqes + (nHead & m_nCqMask) ;
+}
+
+void	hzUring::SeenCqe	(void)
+{
+	//	Consume the CQE returned by the last call to PeekCqe()
+
+	__atomic_store_n(m_pCqHead, *m_pCqHead + 1, __ATOMIC_RELEASE) ;
+}
+
+void	hzUring::ReturnBuffer	(uint32_t nBid)
+{
+	//	Place a provided buffer (back) in the buffer ring so the kernel can fill it
+	//
+	//	Arguments:	1)	nBid	Buffer ID
+	//
+	//	Returns:	None
+
+	struct io_uring_buf*	pBuf ;	//	Buffer descriptor
+
+	if (nBid >= m_nBufs)
+		return ;
+
+	//	The descriptors overlay the ring header (the tail occupies the reserved field of the first), so they are addressed from the start of the ring. Note
+	//	the bufs member of io_uring_buf_ring is not used for this as under C++ the flexible array is offset by the empty struct that precedes it.
+	pBuf = (struct io_uring_buf*) m_pBufRing + (m_nBufTail & (m_nBufs - 1)) ;
+	pBuf->addr = (uint64_t) (m_pBufs + ((uint64_t) nBid * HZ_MAXPACKET)) ;
+	pBuf->len = HZ_MAXPACKET ;
+	pBuf->bid = nBid ;
+
+	m_nBufTail++ ;
+	__atomic_store_n(&m_pBufRing->tail, (uint16_t) m_nBufTail, __ATOMIC_RELEASE) ;
+}
+
+void	hzUring::PrepAcceptMulti	(struct io_uring_sqe* pSqe, int32_t nSock, uint64_t nData)
+{
+	//	Prepare a multishot accept on a listening socket. A CQE (with the new socket as the result) is posted for each connection. The new sockets are set to
+	//	be non-blocking.
+
+	pSqe->opcode = IORING_OP_ACCEPT ;
+	pSqe->fd = nSock ;
+	pSqe->ioprio = IORING_ACCEPT_MULTISHOT ;
+	pSqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC ;
+	pSqe->user_data = nData ;
+}
+
+void	hzUring::PrepRecvMulti	(struct io_uring_sqe* pSqe, int32_t nSock, uint64_t nData)
+{
+	//	Prepare a multishot receive drawing on the provided buffer ring. A CQE is posted for each buffer filled.
+
+	pSqe->opcode = IORING_OP_RECV ;
+	pSqe->fd = nSock ;
+	pSqe->ioprio = IORING_RECV_MULTISHOT ;
+	pSqe->flags = IOSQE_BUFFER_SELECT ;
+	pSqe->buf_group = HZ_URING_BGID ;
+	pSqe->user_data = nData ;
+}
+
+void	hzUring::PrepWritev	(struct io_uring_sqe* pSqe, int32_t nSock, uint32_t nIov, uint64_t nData)
+{
+	//	Prepare a vectored write of the first nIov entries of the SQE's iovec array (see SqeIov)
+
+	pSqe->opcode = IORING_OP_WRITEV ;
+	pSqe->fd = nSock ;
+	pSqe->addr = (uint64_t) SqeIov(pSqe) ;
+	pSqe->len = nIov ;
+	pSqe->user_data = nData ;
+}
+
+void	hzUring::PrepPoll	(struct io_uring_sqe* pSqe, int32_t nSock, uint32_t nMask, bool bMulti, uint64_t nData)
+{
+	//	Prepare a poll for readiness (used where the data is not read by the ring itself, as with TLS)
+
+	pSqe->opcode = IORING_OP_POLL_ADD ;
+	pSqe->fd = nSock ;
+	pSqe->poll32_events = nMask ;
+	pSqe->len = bMulti ? IORING_POLL_ADD_MULTI : 0 ;
+	pSqe->user_data = nData ;
+}
+
+void	hzUring::PrepCancelFd	(struct io_uring_sqe* pSqe, int32_t nSock, uint64_t nData)
+{
+	//	Prepare the cancellation of all outstanding operations on a socket. This must precede closing the socket as pending operations hold a reference to it.
+
+	pSqe->opcode = IORING_OP_ASYNC_CANCEL ;
+	pSqe->fd = nSock ;
+	pSqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL ;
+	pSqe->user_data = nData ;
+}
@@ -0,0 +1,579 @@
+//
+//	File:	hzWebSocket.cpp
+//
+//	Legal Notice: This file is part of the HadronZoo C++ Class Library.
+//
+//	Copyright 1998, 2020 HadronZoo Project (http://www.hadronzoo.com)
+//
+//	The HadronZoo C++ Class Library is free software: you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+//	as published by the Free Software Foundation, either version 3 of the License, or any later version.
+//
+//	The HadronZoo C++ Class Library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+//	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License along with the HadronZoo C++ Class Library. If not, see
+//	http://www.gnu.org/licenses.
+//
+
+//
+//	WebSocket framing (see synopsis in hzWebSocket.h)
+//
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include "hzChars.h"
+#include "hzProcess.h"
+#include "hzWebSocket.h"
+
+using namespace std ;
+
+/*
+**	Definitions
+*/
+
+#define	WS_GUID		"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"	//	Appended to the client key to form the accept key (RFC 6455 section 1.3)
+#define	WS_MAXHDR	14		//	Maximum size of the header of a client frame (2 bytes, 8 byte length and 4 byte mask)
+#define	WS_MAXCTL	125		//	Maximum payload of a control frame
+
+struct	_utf8state
+{
+	//	State of UTF-8 validation between blocks of a message
+
+	uint32_t	m_nNeed ;	//	Continuation bytes still needed by the current character
+	uchar		m_nLo ;		//	Lowest value allowed for the next continuation byte
+	uchar		m_nHi ;		//	Highest value allowed for the next continuation byte
+} ;
+
+/*
+**	Functions
+*/
+
+static	bool	_utf8scan	(_utf8state& S, const uchar* pBuf, uint32_t nLen)
+{
+	//	Validate a block of UTF-8. Overlong forms, surrogates and values above 0x10FFFF are rejected by narrowing the range allowed for the byte following the
+	//	lead byte. A character may straddle blocks, in which case S carries the bytes still needed.
+	//
+	//	Arguments:	1)	S		Validation state (carried between blocks)
+	//				2)	pBuf	The block
+	//				3)	nLen	Length of block
+	//
+	//	Returns:	True	If the block is valid so far
+	//				False	If the block contains an invalid sequence
+
+	uchar	c ;		//	Byte
+
+	for (; nLen ; nLen--, pBuf++)
+	{
+		c = *pBuf ;
+
+		if (S.m_nNeed)
+		{
+			if (c < S.m_nLo || c > S.m_nHi)
+				return false ;
+			S.m_nLo = 0x80 ;
+			S.m_nHi = 0xbf ;
+			S.m_nNeed-- ;
+			continue ;
+		}
+
+		if (c < 0x80)
+			continue ;
+
+		S.m_nLo = 0x80 ;
+		S.m_nHi = 0xbf ;
+
+		if (c < 0xc2)
+			return false ;
+		if (c < 0xe0)
+			{ S.m_nNeed = 1 ; continue ; }
+		if (c < 0xf0)
+		{
+			S.m_nNeed = 2 ;
+			if (c == 0xe0)	S.m_nLo = 0xa0 ;
+			if (c == 0xed)	S.m_nHi = 0x9f ;
+			continue ;
+		}
+		if (c < 0xf5)
+		{
+			S.m_nNeed = 3 ;
+			if (c == 0xf0)	S.m_nLo = 0x90 ;
+			if (c == 0xf4)	S.m_nHi = 0x8f ;
+			continue ;
+		}
+		return false ;
+	}
+
+	return true ;
+}
+
+static	bool	_utf8valid	(const hzChain& Z)
+{
+	//	Establish if a message is valid UTF-8, by validating the blocks of the chain in place
+	//
+	//	Arguments:	1)	Z	The message
+	//
+	//	Returns:	True	If the message is valid UTF-8
+	//				False	Otherwise
+
+	hzChain::BlkIter	bi ;	//	Block iterator
+	_utf8state			S ;		//	Validation state
+
+	S.m_nNeed = 0 ;
+	S.m_nLo = 0x80 ;
+	S.m_nHi = 0xbf ;
+
+	for (bi = Z ; bi.Data() ; bi.Advance())
+	{
+		if (!_utf8scan(S, (const uchar*) bi.Data(), bi.Size()))
+			return false ;
+	}
+
+	return S.m_nNeed ? false : true ;
+}
+
+hzString	WebSocketAccept	(const char* cpKey)
+{
+	//	Category:	Internet
+	//
+	//	Form the value of the Sec-WebSocket-Accept header from that of the Sec-WebSocket-Key header of the opening handshake. This is the base64 encoded SHA-1
+	//	digest of the key with the WebSocket GUID appended.
+	//
+	//	Arguments:	1)	cpKey	The key sent by the client
+	//
+	//	Returns:	Instance of hzString by value being the accept key (empty if no key is supplied)
+
+	hzString	S ;				//	Accept key
+	uchar		buf[128] ;		//	Key and GUID
+	uchar		dig[EVP_MAX_MD_SIZE] ;	//	SHA-1 digest
+	char		b64[64] ;		//	Base64 of digest
+	uint32_t	nKey ;			//	Length of key
+	uint32_t	nDig ;			//	Length of digest
+
+	if (!cpKey || !cpKey[0])
+		return S ;
+
+	nKey = strlen(cpKey) ;
+	if ((nKey + sizeof(WS_GUID)) > sizeof(buf))
+		return S ;
+
+	memcpy(buf, cpKey, nKey) ;
+	memcpy(buf + nKey, WS_GUID, sizeof(WS_GUID) - 1) ;
+
+	if (!EVP_Digest(buf, nKey + sizeof(WS_GUID) - 1, dig, &nDig, EVP_sha1(), 0))
+		return S ;
+
+	EVP_EncodeBlock((uchar*) b64, dig, nDig) ;
+	S = b64 ;
+	return S ;
+}
+
+/*
+**	hzWebSocket members
+*/
+
+hzWebSocket::hzWebSocket	(hzIpConnex* pCx, hzTcpCode (*OnMessage)(hzWebSocket*, hzChain&, bool), void* pApp)
+{
+	m_pCx = pCx ;
+	m_pApp = pApp ;
+	m_nsPing = 0 ;
+	m_nMaxMsg = HZ_WS_MAXMSG ;
+	m_eMsgOp = 0 ;
+	m_bCloseSent = false ;
+	m_bClosed = false ;
+	m_OnMessage = OnMessage ;
+	m_OnClose = 0 ;
+}
+
+hzWebSocket::~hzWebSocket	(void)
+{
+	m_Msg.Clear() ;
+}
+
+hzEcode	hzWebSocket::_send	(hzWsOpcode eOp, const char* pData, uint32_t nLen, const hzChain* pMsg)
+{
+	//	Send a frame. Frames sent by the server are not masked and messages are not fragmented, so a frame is a header of 2 to 10 bytes followed by the payload.
+	//	The payload is either the supplied buffer (which is copied to follow the header) or the supplied chain.
+	//
+	//	Arguments:	1)	eOp		Opcode
+	//				2)	pData	Payload buffer (if no chain)
+	//				3)	nLen	Length of payload buffer
+	//				4)	pMsg	Payload chain (if any)
+	//
+	//	Returns:	E_SEQUENCE	If a close frame has already been sent
+	//				E_SENDFAIL	If the connection has been terminated
+	//				E_OK		If the frame is queued for output
+
+	_hzfunc("hzWebSocket::_send") ;
+
+	hzChain		Hdr ;			//	Frame header (and payload if from a buffer)
+	uint64_t	nSize ;			//	Payload size
+	uint32_t	nHdr ;			//	Header size
+	uint32_t	n ;				//	Length byte iterator
+	uchar		hdr[10] ;		//	Frame header
+	hzEcode		rc ;			//	Return code
+
+	if (m_bCloseSent)
+		return E_SEQUENCE ;
+
+	nSize = pMsg ? pMsg->Size() : nLen ;
+
+	hdr[0] = 0x80 | eOp ;
+	if (nSize < 126)
+		{ hdr[1] = nSize ; nHdr = 2 ; }
+	else if (nSize < 65536)
+		{ hdr[1] = 126 ; hdr[2] = nSize >> 8 ; hdr[3] = nSize & 0xff ; nHdr = 4 ; }
+	else
+	{
+		hdr[1] = 127 ;
+		for (n = 0 ; n < 8 ; n++)
+			hdr[2 + n] = (nSize >> (56 - (n * 8))) & 0xff ;
+		nHdr = 10 ;
+	}
+
+	Hdr.Append(hdr, nHdr) ;
+	if (pData && nLen)
+		Hdr.Append(pData, nLen) ;
+
+	if (_hzGlobal_MT)
+		m_lockOut.Lock() ;
+	if (eOp == WS_OP_CLOSE)
+		m_bCloseSent = true ;
+	rc = pMsg && nSize ? m_pCx->SendData(Hdr, *pMsg) : m_pCx->SendData(Hdr) ;
+	if (_hzGlobal_MT)
+		m_lockOut.Unlock() ;
+
+	return rc ;
+}
+
+hzEcode	hzWebSocket::SendPing	(void)
+{
+	//	Send a ping. The client must answer with a pong, though any frame from the client will do as evidence it is still there.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	E_SEQUENCE	If a close frame has already been sent
+	//				E_SENDFAIL	If the connection has been terminated
+	//				E_OK		If the ping is queued for output
+
+	m_nsPing = RealtimeNano() ;
+	return _send(WS_OP_PING, 0, 0, 0) ;
+}
+
+hzEcode	hzWebSocket::Close	(hzWsStatus eCode, const char* cpReason)
+{
+	//	Begin the closing handshake by sending a close frame. No further messages may be sent. The connection is closed once the client echoes the close frame
+	//	or failing that, when the ping interval next expires.
+	//
+	//	Arguments:	1)	eCode		Status code
+	//				2)	cpReason	Reason (optional, truncated to fit a control frame)
+	//
+	//	Returns:	E_SEQUENCE	If a close frame has already been sent
+	//				E_SENDFAIL	If the connection has been terminated
+	//				E_OK		If the close frame is queued for output
+
+	char		buf[WS_MAXCTL] ;	//	Payload
+	uint32_t	nLen ;				//	Payload length
+
+	buf[0] = (eCode >> 8) & 0xff ;
+	buf[1] = eCode & 0xff ;
+	nLen = 2 ;
+
+	if (cpReason)
+	{
+		for (; *cpReason && nLen < WS_MAXCTL ; nLen++)
+			buf[nLen] = *cpReason++ ;
+	}
+
+	return _send(WS_OP_CLOSE, buf, nLen, 0) ;
+}
+
+hzTcpCode	hzWebSocket::_fail	(hzWsStatus eCode, const char* cpReason)
+{
+	//	Fail the WebSocket connection on a protocol error. The client is sent a close frame stating the error and the connection is closed once it is written.
+	//	Remaining input is discarded.
+	//
+	//	Arguments:	1)	eCode		Status code
+	//				2)	cpReason	Reason
+	//
+	//	Returns:	TCP_TERMINATE
+
+	m_pCx->m_Track.ErrorS("WebSocket on sock %u/%u failed (%u): %s", cpReason, m_pCx->CliSocket(), m_pCx->CliPort(), eCode) ;
+
+	Close(eCode, cpReason) ;
+	m_pCx->DropInput(m_pCx->InputZone().Size()) ;
+	m_pCx->ExpectSize(0) ;
+	m_Msg.Clear() ;
+	m_eMsgOp = 0 ;
+	return TCP_TERMINATE ;
+}
+
+hzTcpCode	hzWebSocket::ProcessFrames	(hzChain& Input)
+{
+	//	Decode the frames in the input. Each complete frame is unmasked and acted on according to its opcode, and removed from the input. Data frames are added
+	//	to the message being received and once it is complete (the frame has the FIN bit set), it is passed to the message function. Should the input end with
+	//	an incomplete frame, the connection is told the size at which the frame will be complete, so that it is not called again until then.
+	//
+	//	Arguments:	1)	Input	The input of the connection
+	//
+	//	Returns:	TCP_TERMINATE	If the connection is to be closed (on a close frame, a protocol error or as directed by the message function)
+	//				TCP_INCOMPLETE	If the input ends with an incomplete frame
+	//				TCP_KEEPALIVE	If all frames in the input were processed
+
+	_hzfunc("hzWebSocket::ProcessFrames") ;
+
+	hzChain::Iter	zi ;			//	Input iterator
+
+	uint64_t	nLen ;				//	Payload length
+	uint32_t	nAvail ;			//	Input available beyond the frames processed
+	uint32_t	nUsed ;				//	Input used by the frames processed
+	uint32_t	nHdr ;				//	Header length
+	uint32_t	nDone ;				//	Payload unmasked so far
+	uint32_t	nPart ;				//	Payload unmasked in this part
+	uint32_t	n ;					//	Byte iterator
+	uint16_t	nCode ;				//	Close status
+	uint16_t	eOp ;				//	Opcode
+	hzTcpCode	rc ;				//	Return from message function
+	uchar		hdr[WS_MAXHDR] ;	//	Frame header
+	uchar		mask[4] ;			//	Masking key
+	char		buf[4096] ;			//	Unmasked payload
+	bool		bFin ;				//	Final frame of message
+
+	for (nUsed = 0 ;; nUsed += nHdr + nLen)
+	{
+		nAvail = Input.Size() - nUsed ;
+		nLen = 0 ;
+		if (nAvail < 2)
+			{ nHdr = 0 ; break ; }
+
+		zi = Input ;
+		zi.Advance(nUsed) ;
+		zi.Write(hdr, nAvail < WS_MAXHDR ? nAvail : WS_MAXHDR) ;
+
+		bFin = hdr[0] & 0x80 ? true : false ;
+		eOp = hdr[0] & 0x0f ;
+
+		if (hdr[0] & 0x70)
+			return _fail(WS_CLOSE_PROTOCOL, "Reserved bits set") ;
+		if (!(hdr[1] & 0x80))
+			return _fail(WS_CLOSE_PROTOCOL, "Frame not masked") ;
+
+		//	Establish header and payload lengths
+		nLen = hdr[1] & 0x7f ;
+		nHdr = 6 ;
+		if (nLen == 126)
+			nHdr = 8 ;
+		else if (nLen == 127)
+			nHdr = 14 ;
+		if (nAvail < nHdr)
+			{ nHdr = 0 ; break ; }
+
+		if (nLen == 126)
+			nLen = (hdr[2] << 8) | hdr[3] ;
+		else if (nLen == 127)
+		{
+			for (nLen = 0, n = 2 ; n < 10 ; n++)
+				nLen = (nLen << 8) | hdr[n] ;
+		}
+		memcpy(mask, hdr + nHdr - 4, 4) ;
+
+		//	Check the frame before awaiting the payload, so that an oversized message is refused before it is received
+		if (eOp >= WS_OP_CLOSE)
+		{
+			if (eOp > WS_OP_PONG)
+				return _fail(WS_CLOSE_PROTOCOL, "Unknown opcode") ;
+			if (!bFin || nLen > WS_MAXCTL)
+				return _fail(WS_CLOSE_PROTOCOL, "Control frame fragmented or too long") ;
+		}
+		else
+		{
+			if (eOp > WS_OP_BINARY)
+				return _fail(WS_CLOSE_PROTOCOL, "Unknown opcode") ;
+			if (eOp == WS_OP_CONT && !m_eMsgOp)
+				return _fail(WS_CLOSE_PROTOCOL, "Continuation without a message") ;
+			if (eOp != WS_OP_CONT && m_eMsgOp)
+				return _fail(WS_CLOSE_PROTOCOL, "New message before the last was complete") ;
+			if ((m_Msg.Size() + nLen) > m_nMaxMsg)
+				return _fail(WS_CLOSE_TOOBIG, "Message too big") ;
+		}
+
+		if (nAvail < (nHdr + nLen))
+			break ;
+
+		//	Frame complete. Any frame is evidence the client is still there.
+		m_nsPing = 0 ;
+		zi.Advance(nHdr) ;
+
+		if (eOp < WS_OP_CLOSE)
+		{
+			//	Data frame: unmask the payload into the message
+			if (eOp != WS_OP_CONT)
+				m_eMsgOp = eOp ;
+
+			for (nDone = 0 ; nDone < nLen ; nDone += nPart)
+			{
+				nPart = (nLen - nDone) < sizeof(buf) ? nLen - nDone : sizeof(buf) ;
+				nPart = zi.Write(buf, nPart) ;
+				for (n = 0 ; n < nPart ; n++)
+					buf[n] ^= mask[(nDone + n) & 3] ;
+				if (!m_bCloseSent)
+					m_Msg.Append(buf, nPart) ;
+				zi.Advance(nPart) ;
+			}
+
+			if (!bFin || m_bCloseSent)
+			{
+				if (bFin)
+					{ m_Msg.Clear() ; m_eMsgOp = 0 ; }
+				continue ;
+			}
+
+			//	Message complete
+			if (m_eMsgOp == WS_OP_TEXT && !_utf8valid(m_Msg))
+				return _fail(WS_CLOSE_BADDATA, "Text message not UTF-8") ;
+
+			rc = m_OnMessage ? m_OnMessage(this, m_Msg, m_eMsgOp == WS_OP_BINARY) : TCP_KEEPALIVE ;
+			m_Msg.Clear() ;
+			m_eMsgOp = 0 ;
+
+			if (rc != TCP_KEEPALIVE && rc != TCP_INCOMPLETE)
+			{
+				Close(WS_CLOSE_NORMAL) ;
+				m_pCx->DropInput(Input.Size()) ;
+				m_pCx->ExpectSize(0) ;
+				return TCP_TERMINATE ;
+			}
+			continue ;
+		}
+
+		//	Control frame
+		nPart = zi.Write(buf, nLen) ;
+		for (n = 0 ; n < nPart ; n++)
+			buf[n] ^= mask[n & 3] ;
+
+		if (eOp == WS_OP_PING)
+		{
+			//	Answer with a pong bearing the same payload
+			if (!m_bCloseSent)
+				_send(WS_OP_PONG, buf, nPart, 0) ;
+			continue ;
+		}
+
+		if (eOp == WS_OP_PONG)
+			continue ;
+
+		//	Close frame. If the server began the closing handshake this completes it, otherwise the close is echoed with the status sent by the client.
+		m_pCx->DropInput(Input.Size()) ;
+		m_pCx->ExpectSize(0) ;
+
+		if (!m_bCloseSent)
+		{
+			if (nPart == 1)
+				return _fail(WS_CLOSE_PROTOCOL, "Close frame with truncated status") ;
+
+			if (nPart >= 2)
+			{
+				nCode = ((uchar) buf[0] << 8) | (uchar) buf[1] ;
+				if (nCode < 1000 || (nCode >= 1004 && nCode <= 1006) || (nCode >= 1015 && nCode < 3000) || nCode >= 5000)
+					return _fail(WS_CLOSE_PROTOCOL, "Invalid close status") ;
+			}
+
+			_send(WS_OP_CLOSE, buf, nPart < 2 ? 0 : 2, 0) ;
+		}
+
+		m_pCx->m_Track.Event("ProcessFrames: WebSocket on sock %u/%u closed by client", m_pCx->CliSocket(), m_pCx->CliPort()) ;
+		return TCP_TERMINATE ;
+	}
+
+	//	Remove the frames processed and await the remainder of any incomplete frame
+	if (nUsed)
+		m_pCx->DropInput(nUsed) ;
+
+	if (Input.Size())
+	{
+		m_pCx->ExpectSize(nHdr + nLen) ;
+		return TCP_INCOMPLETE ;
+	}
+
+	m_pCx->ExpectSize(0) ;
+	return TCP_KEEPALIVE ;
+}
+
+hzTcpCode	hzWebSocket::Idle	(void)
+{
+	//	Called when the connection has been idle for the ping interval. Unless the client has gone, has failed to answer the last ping, or a close frame has been
+	//	sent and not echoed, the client is pinged and the connection kept alive for another interval.
+	//
+	//	Arguments:	None
+	//
+	//	Returns:	TCP_KEEPALIVE	If the client has been pinged
+	//				TCP_TERMINATE	If the connection is to be closed
+
+	_hzfunc("hzWebSocket::Idle") ;
+
+	if (m_bCloseSent || m_pCx->IsCliTerm())
+		return TCP_TERMINATE ;
+
+	if (m_nsPing)
+	{
+		m_pCx->m_Track.Event("Idle: WebSocket on sock %u/%u: No answer to ping", m_pCx->CliSocket(), m_pCx->CliPort()) ;
+		return TCP_TERMINATE ;
+	}
+
+	if (SendPing() != E_OK)
+		return TCP_TERMINATE ;
+
+	m_pCx->Oxygen() ;
+	return TCP_KEEPALIVE ;
+}
+
+void	hzWebSocket::Closed	(void)
+{
+	//	Notify the application that the connection has closed (once only)
+	//
+	//	Arguments:	None
+	//	Returns:	None
+
+	if (m_bClosed)
+		return ;
+	m_bClosed = true ;
+
+	if (m_OnClose)
+		m_OnClose(this) ;
+}
+
+hzTcpCode	HandleWsMsg	(hzChain& Input, hzIpConnex* pCx)
+{
+	//	Category:	Internet Server
+	//
+	//	Ingress function of a connection that has been upgraded to a WebSocket (see hzHttpEvent::AcceptWebSocket). This supplants HandleHttpMsg.
+	//
+	//	Arguments:	1)	Input	The input chain (maintained by the hzIpServer instance)
+	//				2)	pCx		The TCP connection the frames are being received on
+	//
+	//	Returns:	As hzWebSocket::ProcessFrames
+
+	if (!pCx->m_pWsHdl)
+		return TCP_TERMINATE ;
+	return ((hzWebSocket*) pCx->m_pWsHdl)->ProcessFrames(Input) ;
+}
+
+hzTcpCode	HandleWsIdle	(hzIpConnex* pCx)
+{
+	//	Category:	Internet Server
+	//
+	//	Idle function of a connection that has been upgraded to a WebSocket. This is called by the serving loop when the connection expires while idle.
+	//
+	//	Arguments:	1)	pCx		The TCP connection
+	//
+	//	Returns:	As hzWebSocket::Idle
+
+	if (!pCx->m_pWsHdl)
+		return TCP_TERMINATE ;
+	return ((hzWebSocket*) pCx->m_pWsHdl)->Idle() ;
+}
@@ -69,7 +69,7 @@ extern	hzIpServer*		g_pTheServer ;	//	The server instance for HTTP
 extern	hzMapS	<hzString,hdsInfo*>	g_sessCookie ;		//	Mapping of cookie value to cookie
 extern	hzMapS	<hzString,hdsInfo*>	g_sessMember ;		//	Mapping of usernames to cookie
 extern	hzMapS	<hzString,mqItem*>	g_TheMailQue ;		//	List of outstanding relay tasks
-extern	hzSet	<hzEmaddr>			g_setBanned ;		//	Globally banned senders (users may also ban senders)
+extern	hzSetC	<hzEmaddr>			g_setBanned ;		//	Globally banned senders (users may also ban senders)
 extern	hzSet	<hzString>			g_setMboxLocks ;	//	Mail box locks (for POP3 deletes)
 
 extern	hzVect<epAccount*>	g_vecAccount ;		//	All epistula ordinary users (by uid)
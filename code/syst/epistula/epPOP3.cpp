@@ -86,7 +86,7 @@ extern	pthread_mutex_t	g_LockRS ;		//	Lock for relay task schedule
 extern	hzMapS	<hzString,hdsInfo*>	g_sessCookie ;		//	Mapping of cookie value to cookie
 extern	hzMapS	<hzString,hdsInfo*>	g_sessMember ;		//	Mapping of usernames to cookie
 extern	hzMapS	<hzString,mqItem*>	g_TheMailQue ;		//	List of outstanding relay tasks
-extern	hzSet	<hzEmaddr>			g_setBanned ;		//	Globally banned senders (users may also ban senders)
+extern	hzSetC	<hzEmaddr>			g_setBanned ;		//	Globally banned senders (users may also ban senders)
 
 extern	hzVect<epAccount*>	g_vecAccount ;			//	All epistula ordinary users (by uid)
 
@@ -676,14 +676,15 @@ hzTcpCode	ProcPOP3		(hzChain& Input, hzIpConnex* pCC)
 				pCC->SendData(R) ; Input.Clear() ; return TCP_KEEPALIVE ;
 			}
 
+			//	The message is passed to the connection as an output source rather than copied into the response, so only as much of it as the client
+			//	can take is queued at any one time
 			R << "+OK\r\n" ;
-			R << Z ;
-			R << "\r\n.\r\n" ;
+			Z << "\r\n.\r\n" ;
 
 			bLog = false ;
-			pCC->m_Track.Printf("Sent message %d (%d bytes)\n", nMsgNo, R.Size()) ;
+			pCC->m_Track.Printf("Sent message %d (%d bytes)\n", nMsgNo, R.Size() + Z.Size()) ;
 
-			pCC->SendData(R) ; Input.Clear() ; return TCP_KEEPALIVE ;
+			pCC->SendStream(R, new hzOutChain(Z)) ; Input.Clear() ; return TCP_KEEPALIVE ;
 		}
 
 		if (zi == "DELE ")
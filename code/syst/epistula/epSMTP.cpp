@@ -151,7 +151,7 @@ extern	pthread_mutex_t		g_LockRS ;			//	Lock for relay task schedule
 extern	hzIpServer*			g_pTheServer ;		//	The server instance for HTTP
 
 //	Working (temp) maps and sets
-extern	hzSet<hzEmaddr>		g_setBanned ;		//	Globally banned senders (users may also ban senders)
+extern	hzSetC<hzEmaddr>		g_setBanned ;		//	Globally banned senders (users may also ban senders)
 extern	hzVect<epAccount*>	g_vecAccount ;		//	All epistula ordinary users (by uid)
 
 //	Ports and limits (set in main)
@@ -301,6 +301,7 @@ hzTcpCode	FinishSMTP	(hzIpConnex* pCC)
 {
 	//	This will ensure a POP3 file is saved
 
+	hzChain			Z ;					//	Report of connection record
 	SmtpSession*	pInfo ;				//	SMTP Session Info
 
 	pInfo = (SmtpSession*) pCC->GetInfo() ;
@@ -315,7 +316,8 @@ hzTcpCode	FinishSMTP	(hzIpConnex* pCC)
 		SetStatusIP(pInfo->ipa, (hzIpStatus) pInfo->m_eBlock, pInfo->m_nBlocktime) ;
 	}
 
-	slog.Out(pCC->m_Track) ;
+	pCC->m_Track.Report(Z) ;
+	slog.Out(Z) ;
 }
 
 /*
@@ -484,6 +486,7 @@ hzTcpCode	_smtpExpectRcpt		(hzChain& Input, hzIpConnex* pCC)
 
 	hzChain			R ;						//	Response to client
 	hzChain			Z ;						//	For helping to write mail que file
+	hzChain			E ;						//	Error report
 	chIter			zi ;					//	Input chain iterator
 	SmtpSession*	pInfo ;					//	SMTP Session info
 	epAccount*		pAcc ;					//	Affected accounts
@@ -505,8 +508,9 @@ hzTcpCode	_smtpExpectRcpt		(hzChain& Input, hzIpConnex* pCC)
 	//	Expect list of recipients or the DATA command.
 	if (zi.Equiv("RCPT TO"))
 	{
-		if (ExtractEmailAddr(pInfo->Recipient, zi, pCC->m_Track) != E_OK)
+		if (ExtractEmailAddr(pInfo->Recipient, zi, E) != E_OK)
 		{
+			pCC->m_Track.Attach(E, true) ;
 			R.Printf("550 Malformed recipient address\r\n") ;
 			pCC->m_Track << R ;
 
@@ -765,14 +769,14 @@ hzTcpCode	_smtpExpectData		(hzChain& Input, hzIpConnex* pCC)
 				pCC->m_Track.Printf("Hdr %d: %s:\t%s\n", n, *pair.name, *pair.value) ;
 			}
 
-			pCC->m_Track << pInfo->theMsg.m_Err ;
+			pCC->m_Track.Attach(pInfo->theMsg.m_Err, true) ;
 			R.Printf("421 Internal Fault\r\n") ;
 			pCC->m_Track.Printf("Mail item MALFORMED so rejected\n") ;
 			pInfo->m_eState = SMTP_EXPECT_QUIT ;
 
 			pCC->SendData(R) ; Input.Clear() ; return TCP_KEEPALIVE ;
 		}
-		pCC->m_Track << pInfo->theMsg.m_Err ;
+		pCC->m_Track.Attach(pInfo->theMsg.m_Err, true) ;
 	}
 }
 
@@ -810,6 +814,7 @@ hzEcode	_smtpCoreCommit	(hzIpConnex* pCC)
 
 	_hzfunc(__func__) ;
 
+	hzChain			E ;				//	Error report
 	SmtpSession*	pInfo ;			//	SMTP Session info
 	hzEcode			rc = E_OK ;		//	Return code
 
@@ -826,7 +831,8 @@ hzEcode	_smtpCoreCommit	(hzIpConnex* pCC)
 										pInfo->m_Realname,
 										pInfo->theMsg.m_Subject,
 										pInfo->msgBody,
-										pCC->m_Track	) ;
+										E	) ;
+		pCC->m_Track.Attach(E, rc != E_OK) ;
 		if (rc != E_OK)
 			pInfo->m_bAccError = true ;
 	}
@@ -841,6 +847,7 @@ hzEcode	_smtpPOP3Commit	(hzIpConnex* pCC)
 	_hzfunc(__func__) ;
 
 	hzChain			Z ;				//	For helping to write mail que file
+	hzChain			E ;				//	Error report
 	SmtpSession*	pInfo ;			//	SMTP Session info
 	epAccount*		pAcc ;			//	Affected accounts
 	epFolder*		pFolder ;		//	Target automatic folder
@@ -872,8 +879,9 @@ hzEcode	_smtpPOP3Commit	(hzIpConnex* pCC)
 
 		//	UPDATE the Central Repository of Correspondents. Check if the sender is present, if not insert. Then the same for each recipient.
 		for (nIndex = 0 ; nIndex < pInfo->allRcpts.Count() ; nIndex++)
-			theEP->UpdateCorres(pInfo->m_CorresId, pInfo->allRcpts[nIndex], _hzGlobal_nullString, pCC->m_Track) ;
-		theEP->UpdateCorres(pInfo->m_CorresId, pInfo->theMsg.m_AddrSender, pInfo->m_Realname, pCC->m_Track) ;
+			theEP->UpdateCorres(pInfo->m_CorresId, pInfo->allRcpts[nIndex], _hzGlobal_nullString, E) ;
+		theEP->UpdateCorres(pInfo->m_CorresId, pInfo->theMsg.m_AddrSender, pInfo->m_Realname, E) ;
+		pCC->m_Track.Attach(E, false) ;
 
 		//	Deliver to all mailboxes
 		for (nIndex = 0 ; nIndex < pInfo->mailboxes.Count() ; nIndex++)
@@ -1030,6 +1038,7 @@ hzTcpCode	ProcAlienSMTP		(hzChain& Input, hzIpConnex* pCC)
 	_hzfunc(__func__) ;
 
 	hzChain			R ;						//	Response to client
+	hzChain			E ;						//	Error report
 	chIter			zi ;					//	Input chain iterator
 	SmtpSession*	pInfo ;					//	SMTP Session info
 	hzRecep16		recepA ;				//	Used in reporting of IP addresses
@@ -1107,8 +1116,9 @@ hzTcpCode	ProcAlienSMTP		(hzChain& Input, hzIpConnex* pCC)
 		}
 
 		//	Extract sender from message of the form "realname <email@address>"
-		if (ExtractEmailAddr(pInfo->m_Sender, zi, pCC->m_Track) != E_OK)
+		if (ExtractEmailAddr(pInfo->m_Sender, zi, E) != E_OK)
 		{
+			pCC->m_Track.Attach(E, true) ;
 			pInfo->m_eState = SMTP_EXPECT_QUIT ;
 			R.Printf("501 Sender email address could not be deciphered.\r\n") ;
 			pCC->m_Track << R ;
@@ -1144,7 +1154,7 @@ hzTcpCode	ProcAlienSMTP		(hzChain& Input, hzIpConnex* pCC)
 				pInfo->m_eState = SMTP_EXPECT_QUIT ;
 				R.Printf("550 <%s>... Sender not accepted. terminated\r\n", *pInfo->m_Sender) ;
 				pCC->m_Track << R ;
-				pCC->m_Track << "Sender is banned\n" ;
+				pCC->m_Track.Event("Sender is banned") ;
 
 				pCC->SendData(R) ; Input.Clear() ; return TCP_KEEPALIVE ;
 			}
@@ -1351,6 +1361,7 @@ hzTcpCode	ProcLocalSMTP		(hzChain& Input, hzIpConnex* pCC)
 
 	SmtpSession*	pInfo ;			//	SMTP Session info
 	hzChain			R ;				//	Response to client
+	hzChain			E ;				//	Error report
 	chIter			zi ;			//	Input chain iterator
 	hzFxDomain		tmpDom ;		//	Domain of sender
 	hzFxEmaddr		tmpFro ;		//	Address of sender
@@ -1422,8 +1433,9 @@ hzTcpCode	ProcLocalSMTP		(hzChain& Input, hzIpConnex* pCC)
 			pCC->SendData(R) ; Input.Clear() ; return TCP_KEEPALIVE ;
 		}
 
-		if (ExtractEmailAddr(pInfo->m_Sender, zi, pCC->m_Track) != E_OK)
+		if (ExtractEmailAddr(pInfo->m_Sender, zi, E) != E_OK)
 		{
+			pCC->m_Track.Attach(E, true) ;
 			pInfo->m_eState = SMTP_EXPECT_QUIT ;
 			R.Printf("501 Sender email address could not be deciphered.\r\n") ;
 			pCC->m_Track << R ;
@@ -1461,7 +1473,7 @@ hzTcpCode	ProcLocalSMTP		(hzChain& Input, hzIpConnex* pCC)
 				pInfo->m_eState = SMTP_EXPECT_QUIT ;
 				R.Printf("550 <%s>... Sender not accepted. terminated\r\n", *pInfo->m_Sender) ;
 				pCC->m_Track << R ;
-				pCC->m_Track << "Sender is banned\n" ;
+				pCC->m_Track.Event("Sender is banned") ;
 
 				pCC->SendData(R) ; Input.Clear() ; return TCP_KEEPALIVE ;
 			}
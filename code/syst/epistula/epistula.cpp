@@ -74,7 +74,7 @@ global	hzIpServer*		g_pTheServer ;	//	The server instance for HTTP
 global	hzMapS	<hzString,hdsInfo*>	g_sessCookie("mtxCookie") ;		//	Mapping of cookie value to cookie
 global	hzMapS	<hzString,hdsInfo*>	g_sessMember("mtxMember") ;		//	Mapping of usernames to cookie
 global	hzMapS	<hzString,mqItem*>	g_TheMailQue("mtxMailque") ;	//	List of outstanding relay tasks
-global	hzSet	<hzEmaddr>			g_setBanned("mtxBanned") ;		//	Globally banned senders (users may also ban senders)
+global	hzSetC	<hzEmaddr>			g_setBanned("mtxBanned") ;		//	Globally banned senders (users may also ban senders)
 global	hzSet	<hzString>			g_setMboxLocks ;				//	Mail box locks (for POP3 deletes)
 
 global	hzVect<epAccount*>	g_vecAccount ;		//	All epistula ordinary users (by uid)
@@ -32,6 +32,7 @@ using namespace std ;
 #include "hzTmplSet.h"
 #include "hzTmplMapS.h"
 #include "hzTmplMapM.h"
+#include "hzTmplMapC.h"
 #include "hzString.h"
 #include "hzMailer.h"
 #include "hzDissemino.h"